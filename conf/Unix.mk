@@ -53,6 +53,16 @@ LD = cc
 LDFLAGS = 
 LDOUT = -o 
 
+# Host compiler and linker, for tools that are run during the build
+# (bsgen). They default to the target tools; set them explicitly when
+# cross-compiling.
+HOSTCC = $(CC)
+HOSTCFLAGS = $(CFLAGS)
+HOSTCCOUT = $(CCOUT)
+HOSTLD = $(LD)
+HOSTLDFLAGS = $(LDFLAGS)
+HOSTLDOUT = $(LDOUT)
+
 # Set the values to 'no' to disable building of the corresponding element
 # by default. Building can still be invoked with an explicit target call
 # (e.g. 'make dll' to force build the DLL).
@@ -30,6 +30,8 @@
 #include <string.h>
 #include <limits.h>
 
+#include "cttk_config.h"
+
 /*
  * On MSVC, disable the warning about applying unary minus on an
  * unsigned type: it is standard, we do it all the time, and for
@@ -1127,6 +1129,158 @@ cttk_u32_bitlength(uint32_t x)
 	return r + x - ((x + 1) >> 2);
 }
 
+/* ==================================================================== */
+/*
+ * CPU features.
+ *
+ * Some functions have several implementations, using SIMD instructions
+ * when available (SSE2 or AVX2 on x86). The implementation is selected
+ * at runtime, upon first use, from the features of the current CPU;
+ * thus, a single binary can use AVX2 on the systems that support it. Features that are not compiled in (see config.h) are
+ * never reported.
+ */
+
+/** \brief CPU feature flag: SSE2. */
+#define CTTK_CPU_SSE2   ((uint32_t)0x00000001)
+/** \brief CPU feature flag: AVX2. */
+#define CTTK_CPU_AVX2   ((uint32_t)0x00000002)
+
+/**
+ * \brief Get the CPU features used by the library.
+ *
+ * The returned value is a combination of the `CTTK_CPU_*` flags. The
+ * CPU is probed on the first call; the result is then cached.
+ *
+ * \return  the used CPU features.
+ */
+uint32_t cttk_cpu_features(void);
+
+/**
+ * \brief Restrict the CPU features used by the library.
+ *
+ * The used CPU features are set to those supported by the CPU and
+ * present in `mask`, and all implementations are selected again.
+ * Setting `mask` to 0 forces use of the portable code; setting it to
+ * `(uint32_t)-1` restores the default behaviour. This is meant for
+ * testing and benchmarking. It is valid only before the library is
+ * used by more than one thread, i.e. normally at program start-up,
+ * before any other call; calling it while other threads may use the
+ * library can make them use a mix of implementations from different
+ * feature sets.
+ *
+ * \param mask   allowed CPU features.
+ */
+void cttk_cpu_set_features(uint32_t mask);
+
+/* ==================================================================== */
+/*
+ * Statistics.
+ *
+ * When the library is compiled with CTTK_STATS (see config.h), it
+ * maintains a few counters: calls to the i31 functions (by group),
+ * results set to NaN because of size mismatches or missing temporary
+ * space, heap allocations of temporaries, and linear array scans
+ * (`cttk_array_read()` and related functions). Counters are kept per
+ * thread (with thread-local storage, when the compiler supports it),
+ * so that they can be updated without locking; each thread obtains and
+ * resets its own counters, and the application may aggregate them.
+ * Calls made internally by the library are counted as well; e.g. a
+ * decimal conversion also shows up as multiplications and additions.
+ *
+ * Without CTTK_STATS (the default), the instrumentation compiles to
+ * nothing; the functions below are still present, but
+ * `cttk_stats_snapshot()` reports only zeros.
+ *
+ * The counters are updated without data-dependent branches, and count
+ * only events that depend on public values (sizes, lengths, memory
+ * allocation results). NaN results caused by secret values (overflows,
+ * division by zero, NaN operands) are not counted.
+ */
+
+/** \brief i31 call group: init, conversions from/to native integers. */
+#define CTTK_STATS_I31_SET     0
+/** \brief i31 call group: binary encoding and decoding. */
+#define CTTK_STATS_I31_CODEC   1
+/** \brief i31 call group: comparisons and sign. */
+#define CTTK_STATS_I31_CMP     2
+/** \brief i31 call group: copy, swap and mux (conditional or not). */
+#define CTTK_STATS_I31_COPY    3
+/** \brief i31 call group: addition, subtraction, negation. */
+#define CTTK_STATS_I31_ADD     4
+/** \brief i31 call group: multiplications and squarings. */
+#define CTTK_STATS_I31_MUL     5
+/** \brief i31 call group: divisions (including `cttk_d31_*()`). */
+#define CTTK_STATS_I31_DIV     6
+/** \brief i31 call group: shifts. */
+#define CTTK_STATS_I31_SHIFT   7
+/** \brief i31 call group: boolean bitwise operations. */
+#define CTTK_STATS_I31_BOOL    8
+/** \brief i31 call group: GCD and modular inversion. */
+#define CTTK_STATS_I31_GCD     9
+/** \brief i31 call group: conversions to/from decimal, hex and Base64. */
+#define CTTK_STATS_I31_TEXT   10
+/** \brief i31 call group: batch operations (`cttk_i31_batch_*()`). */
+#define CTTK_STATS_I31_BATCH  11
+/** \brief Number of i31 call groups. */
+#define CTTK_STATS_I31_NUM    12
+
+/**
+ * \brief Statistics counters.
+ */
+typedef struct {
+	/** \brief Calls to i31 functions, by group (`CTTK_STATS_I31_*`). */
+	uint64_t i31_calls[CTTK_STATS_I31_NUM];
+	/** \brief Results set to NaN because of mismatched operand sizes. */
+	uint64_t nan_size;
+	/** \brief Results set to NaN because temporary space was missing. */
+	uint64_t nan_scratch;
+	/** \brief Heap allocations for temporaries. */
+	uint64_t scratch_allocs;
+	/** \brief Total size of the heap allocations for temporaries. */
+	uint64_t scratch_bytes;
+	/** \brief Heap allocations for temporaries that failed. */
+	uint64_t scratch_failures;
+	/** \brief Linear array accesses (one per index). */
+	uint64_t array_accesses;
+	/** \brief Array bytes scanned by linear array accesses (whole
+	    array size, once per index). */
+	uint64_t array_bytes;
+	/** \brief Time spent in linear array accesses (see
+	    `cttk_stats_set_clock()`). */
+	uint64_t array_time;
+} cttk_stats;
+
+/**
+ * \brief Get the statistics counters of the calling thread.
+ *
+ * The current values of the counters of the calling thread are copied
+ * into `*st`. If the library was not compiled with CTTK_STATS, then
+ * `*st` is filled with zeros and 0 is returned.
+ *
+ * \param st   destination structure.
+ * \return  1 if statistics are supported, 0 otherwise.
+ */
+int cttk_stats_snapshot(cttk_stats *st);
+
+/**
+ * \brief Reset the statistics counters of the calling thread.
+ */
+void cttk_stats_reset(void);
+
+/**
+ * \brief Set the clock used to measure time in linear array accesses.
+ *
+ * If `clock_fn` is not `NULL`, then it is called at the start and at
+ * the end of each linear array access function, and the differences
+ * are accumulated in the `array_time` counter, in the unit of that
+ * clock. By default, no clock is set, and `array_time` remains zero.
+ * This setting is global; it MUST NOT be changed while other threads
+ * are using the library. It has no effect without CTTK_STATS.
+ *
+ * \param clock_fn   clock function (or `NULL`).
+ */
+void cttk_stats_set_clock(uint64_t (*clock_fn)(void));
+
 /* ==================================================================== */
 
 /**
@@ -1211,6 +1365,98 @@ void cttk_array_read(void *d,
 void cttk_array_write(void *a, size_t elt_len, size_t num_len,
 	size_t index, const void *s);
 
+/**
+ * \brief Constant-time array look-up (batch read).
+ *
+ * This function is equivalent to `num_index` calls to
+ * `cttk_array_read()`: for all `k` from 0 to `num_index-1`, element
+ * `index[k]` of the array is written at offset `k*elt_len` in `d`.
+ * The array values _and_ the indices are protected. The cost is still
+ * proportional to the total array size for each index, but the array
+ * is read only once from memory (it is processed by cache-sized
+ * blocks), which is substantially faster than separate calls for large
+ * arrays.
+ *
+ * If an index is out of range, then the corresponding output element
+ * is filled with zeros. `d` MUST NOT overlap with the array.
+ *
+ * \param d           destination buffer (`num_index*elt_len` bytes).
+ * \param a           pointer to first array element.
+ * \param elt_len     individual element length (in bytes).
+ * \param num_len     number of elements in the array.
+ * \param index       indices of the elements to read.
+ * \param num_index   number of indices.
+ */
+void cttk_array_read_many(void *d, const void *a, size_t elt_len,
+	size_t num_len, const size_t *index, size_t num_index);
+
+/**
+ * \brief Constant-time array look-up (batch write).
+ *
+ * This function is equivalent to `num_index` calls to
+ * `cttk_array_write()`, in ascending order of `k`: for all `k` from 0
+ * to `num_index-1`, the `elt_len` bytes at offset `k*elt_len` in `s`
+ * are written into element `index[k]` of the array. If several indices
+ * are equal, then the last corresponding value is kept. The array
+ * values _and_ the indices are protected. As with
+ * `cttk_array_read_many()`, the array goes through memory only once.
+ *
+ * Out-of-range indices are ignored. `s` MUST NOT overlap with the
+ * array.
+ *
+ * \param a           pointer to first array element.
+ * \param elt_len     individual element length (in bytes).
+ * \param num_len     number of elements in the array.
+ * \param index       indices of the elements to write.
+ * \param num_index   number of indices.
+ * \param s           source values (`num_index*elt_len` bytes).
+ */
+void cttk_array_write_many(void *a, size_t elt_len, size_t num_len,
+	const size_t *index, size_t num_index, const void *s);
+
+/**
+ * \brief Executor for parallel jobs.
+ *
+ * An executor is a caller-provided function that runs `num` jobs: it
+ * must call `job(arg, i)` for all `i` from 0 to `num-1`, in any order,
+ * possibly concurrently from several threads, and return only when all
+ * calls have completed. `exec_ctx` is the opaque pointer that was
+ * provided along with the executor.
+ */
+typedef void (*cttk_executor)(void *exec_ctx,
+	void (*job)(void *arg, size_t idx), void *arg, size_t num);
+
+/**
+ * \brief Constant-time array look-up (read, multi-threaded).
+ *
+ * This function is similar to `cttk_array_read()`, and produces the
+ * same result; the array is split into up to `num_threads` ranges of
+ * consecutive elements, which are scanned by independent jobs run with
+ * the executor `exec` (see `cttk_executor`). Each job computes a masked
+ * partial result (zero, unless the index is in its range), and the
+ * partial results are then combined with a bitwise OR. The number of
+ * jobs and the ranges depend only on the array size, not on the index.
+ * If `exec` is `NULL`, or `num_threads` is lower than 2, then the read
+ * runs in the calling thread.
+ *
+ * Partial results need `elt_len` bytes each; if they cannot be
+ * allocated (on the stack, or on the heap unless `CTTK_NO_MALLOC` is
+ * set), then fewer jobs are used. This is worthwhile only for large
+ * arrays (typically at least a few megabytes).
+ *
+ * \param d             destination buffer (`elt_len` bytes).
+ * \param a             pointer to first array element.
+ * \param elt_len       individual element length (in bytes).
+ * \param num_len       number of elements in the array.
+ * \param index         index of the element to read.
+ * \param num_threads   maximum number of jobs.
+ * \param exec          executor (or `NULL`).
+ * \param exec_ctx      opaque context for the executor.
+ */
+void cttk_array_read_mt(void *d, const void *a, size_t elt_len,
+	size_t num_len, size_t index,
+	unsigned num_threads, cttk_executor exec, void *exec_ctx);
+
 /**
  * \brief Constant-time comparison (equality).
  *
@@ -1268,6 +1514,418 @@ cttk_array_neq(const void *src1, const void *src2, size_t len)
  */
 int32_t cttk_array_cmp(const void *src1, const void *src2, size_t len);
 
+/*
+ * Oblivious sort.
+ *
+ * Records are sorted with a sorting network (bitonic sort), whose
+ * sequence of comparisons and memory accesses depends only on the
+ * number and size of records, not on their contents. The cost is
+ * O(N log^2 N) compare-exchanges for N records.
+ */
+
+/**
+ * \brief Oblivious sort of fixed-size records.
+ *
+ * The `count` records of `elt_len` bytes each, starting at address
+ * `base`, are sorted in ascending order of their keys. The key of a
+ * record consists of the `key_len` bytes at offset `key_off` within
+ * the record (`key_off + key_len` MUST NOT exceed `elt_len`); keys are
+ * compared in lexicographic order of their unsigned byte values, as
+ * with `cttk_array_cmp()`. The sort is not stable: the relative order
+ * of records with equal keys is not preserved.
+ *
+ * The keys and the record contents are protected; the count and the
+ * sizes are not.
+ *
+ * \param base      pointer to the first record.
+ * \param count     number of records.
+ * \param elt_len   record length (in bytes).
+ * \param key_off   key offset within each record (in bytes).
+ * \param key_len   key length (in bytes).
+ */
+void cttk_oblivious_sort(void *base, size_t count, size_t elt_len,
+	size_t key_off, size_t key_len);
+
+/**
+ * \brief Oblivious sort of fixed-size records (multi-threaded).
+ *
+ * This function is similar to `cttk_oblivious_sort()`, and produces
+ * the same result; in addition, each stage of the sorting network is
+ * split into up to `num_threads` independent jobs, which are run with
+ * the executor `exec` (see `cttk_executor`). Jobs of the same stage
+ * access disjoint records. If `exec` is `NULL`, or `num_threads` is
+ * lower than 2, then the sort runs in the calling thread.
+ *
+ * \param base          pointer to the first record.
+ * \param count         number of records.
+ * \param elt_len       record length (in bytes).
+ * \param key_off       key offset within each record (in bytes).
+ * \param key_len       key length (in bytes).
+ * \param num_threads   maximum number of jobs per stage.
+ * \param exec          executor (or `NULL`).
+ * \param exec_ctx      opaque context for the executor.
+ */
+void cttk_oblivious_sort_mt(void *base, size_t count, size_t elt_len,
+	size_t key_off, size_t key_len,
+	unsigned num_threads, cttk_executor exec, void *exec_ctx);
+
+/*
+ * Path ORAM.
+ *
+ * The cttk_array_read() and cttk_array_write() functions have a cost
+ * proportional to the array size. The `cttk_oram` object implements
+ * an array of `num_len` elements of `elt_len` bytes each, with an
+ * access cost that grows only as O(log^2 N) (for N elements), using
+ * the Path ORAM algorithm with a recursive position map. Elements are
+ * initially all-zero.
+ *
+ * The memory for the array is provided by the caller, and should have
+ * the size returned by `cttk_oram_mem_len()`; that memory is several
+ * times larger than the plain array (about 4 slots per element, each
+ * slot having an 8-byte header). The ORAM also needs a source of random
+ * bytes, provided as a callback: it should be a cryptographically secure
+ * random generator, since the security of the ORAM relies on the
+ * unpredictability of these values.
+ *
+ * Element values and access indices are protected: the sequence of
+ * memory accesses depends only on random values independent of these
+ * indices, and on the array dimensions. The ORAM uses a fixed-size stash;
+ * if the stash overflows (with a negligible probability), some data is
+ * lost and the ORAM reports a failure (which is sticky) on all
+ * subsequent accesses.
+ *
+ * The `cttk_oram` structure contents are private and should not be
+ * accessed directly. An ORAM object is not thread-safe: concurrent
+ * accesses must be serialised by the caller.
+ */
+
+/**
+ * \brief Maximum number of recursive levels for a Path ORAM.
+ */
+#define CTTK_ORAM_MAX_LEVELS   8
+
+/**
+ * \brief Parameters for one Path ORAM level (private).
+ */
+typedef struct {
+	unsigned char *tree;
+	unsigned char *work;
+	size_t data_len;
+	size_t slot_len;
+	uint32_t num;
+	unsigned depth;
+} cttk_oram_level;
+
+/**
+ * \brief Path ORAM object.
+ *
+ * Contents are private.
+ */
+typedef struct {
+	cttk_oram_level levels[CTTK_ORAM_MAX_LEVELS];
+	unsigned num_levels;
+	unsigned char *posmap;
+	unsigned char *zero;
+	size_t elt_len;
+	size_t num_len;
+	void (*rng)(void *rng_ctx, void *dst, size_t len);
+	void *rng_ctx;
+	uint32_t fail;
+} cttk_oram;
+
+/**
+ * \brief Get the memory size needed by a Path ORAM.
+ *
+ * The returned value is the size (in bytes) of the memory area that
+ * must be provided to `cttk_oram_init()` for an array of `num_len`
+ * elements of `elt_len` bytes each. If the parameters are not
+ * supported (zero element size or count, more than 2^31-1 elements,
+ * or a total size that does not fit in a `size_t`), then 0 is returned.
+ *
+ * \param elt_len   individual element length (in bytes).
+ * \param num_len   number of elements.
+ * \return  the memory size (in bytes), or 0.
+ */
+size_t cttk_oram_mem_len(size_t elt_len, size_t num_len);
+
+/**
+ * \brief Initialise a Path ORAM.
+ *
+ * The ORAM object `o` is initialised to use the memory area `mem`
+ * (of length `mem_len` bytes), for an array of `num_len` elements of
+ * `elt_len` bytes each. All elements are set to zero. The provided
+ * memory area must remain valid, and must not be modified by the
+ * caller, as long as the ORAM is used; it needs no specific alignment.
+ *
+ * The `rng` callback is invoked to obtain random bytes: it must fill
+ * the `len` bytes at `dst` with random bytes; `rng_ctx` is passed as
+ * first parameter. A few bytes per recursive level are obtained for
+ * every access.
+ *
+ * Returned value is 1 on success, 0 on error (unsupported parameters,
+ * memory area too small, or `rng` is `NULL`).
+ *
+ * \param o         ORAM object to initialise.
+ * \param mem       memory area for the ORAM contents.
+ * \param mem_len   memory area length (in bytes).
+ * \param elt_len   individual element length (in bytes).
+ * \param num_len   number of elements.
+ * \param rng       random source callback.
+ * \param rng_ctx   context parameter for the random source.
+ * \return  1 on success, 0 on error.
+ */
+int cttk_oram_init(cttk_oram *o, void *mem, size_t mem_len,
+	size_t elt_len, size_t num_len,
+	void (*rng)(void *rng_ctx, void *dst, size_t len), void *rng_ctx);
+
+/**
+ * \brief Read an element from a Path ORAM.
+ *
+ * Element `index` is read and written into `d` (`elt_len` bytes). The
+ * value and the index are protected. If `index` is out of range, then
+ * `d` is filled with zeros (this is not distinguishable from an access
+ * to a valid index).
+ *
+ * Returned value is false if the ORAM has failed (stash overflow, at
+ * any previous point) and some data may have been lost.
+ *
+ * \param o       ORAM object.
+ * \param d       destination buffer (`elt_len` bytes).
+ * \param index   index of the element to read.
+ * \return  true on success.
+ */
+cttk_bool cttk_oram_read(cttk_oram *o, void *d, size_t index);
+
+/**
+ * \brief Write an element into a Path ORAM.
+ *
+ * Element `index` is set to the `elt_len` bytes from `s`. The value
+ * and the index are protected. If `index` is out of range, then
+ * nothing is written (this is not distinguishable from an access to a
+ * valid index).
+ *
+ * Returned value is false if the ORAM has failed (stash overflow, at
+ * any previous point) and some data may have been lost.
+ *
+ * \param o       ORAM object.
+ * \param index   index of the element to write.
+ * \param s       source value (`elt_len` bytes).
+ * \return  true on success.
+ */
+cttk_bool cttk_oram_write(cttk_oram *o, size_t index, const void *s);
+
+/*
+ * Oblivious map.
+ *
+ * The `cttk_omap` object is a key-value map with fixed-size keys and
+ * values, and a maximum number of entries set at initialisation. Lookups,
+ * insertions and deletions hide the keys, the values, and whether the
+ * key was present or not: the memory access pattern depends only on
+ * random values and on the map dimensions. The type of operation
+ * (lookup, or insertion/deletion) is not hidden.
+ *
+ * Internally, entries are stored in buckets, in a Path ORAM (see
+ * `cttk_oram`); each key is mapped to two buckets with a keyed hash
+ * function (SipHash-2-4, with a random key obtained at initialisation).
+ * Each operation costs two ORAM reads (and two ORAM writes for
+ * insertions and deletions).
+ *
+ * As for `cttk_oram`, memory is provided by the caller, along with a
+ * source of random bytes (which should be cryptographically secure).
+ * The `cttk_omap` structure contents are private.
+ */
+
+/**
+ * \brief Oblivious map object.
+ *
+ * Contents are private.
+ */
+typedef struct {
+	cttk_oram oram;
+	unsigned char *buf1;
+	unsigned char *buf2;
+	unsigned char *zero;
+	size_t key_len;
+	size_t val_len;
+	size_t num_buckets;
+	uint64_t k0, k1;
+} cttk_omap;
+
+/**
+ * \brief Get the memory size needed by an oblivious map.
+ *
+ * The returned value is the size (in bytes) of the memory area that
+ * must be provided to `cttk_omap_init()` for a map with keys of
+ * `key_len` bytes, values of `val_len` bytes, and up to `num` entries.
+ * If the parameters are not supported (zero key size, zero map capacity,
+ * or sizes too large), then 0 is returned. Values may have length 0.
+ *
+ * \param key_len   key length (in bytes).
+ * \param val_len   value length (in bytes).
+ * \param num       maximum number of entries.
+ * \return  the memory size (in bytes), or 0.
+ */
+size_t cttk_omap_mem_len(size_t key_len, size_t val_len, size_t num);
+
+/**
+ * \brief Initialise an oblivious map.
+ *
+ * The map `m` is initialised, empty, using the memory area `mem` (of
+ * length `mem_len` bytes). The map accepts keys of `key_len` bytes and
+ * values of `val_len` bytes, and is dimensioned for up to `num` entries.
+ * The memory area must remain valid, and must not be modified by the
+ * caller, as long as the map is used.
+ *
+ * The `rng` callback is used to obtain random bytes, as with
+ * `cttk_oram_init()`.
+ *
+ * Returned value is 1 on success, 0 on error (unsupported parameters,
+ * memory area too small, or `rng` is `NULL`).
+ *
+ * \param m         map to initialise.
+ * \param mem       memory area for the map contents.
+ * \param mem_len   memory area length (in bytes).
+ * \param key_len   key length (in bytes).
+ * \param val_len   value length (in bytes).
+ * \param num       maximum number of entries.
+ * \param rng       random source callback.
+ * \param rng_ctx   context parameter for the random source.
+ * \return  1 on success, 0 on error.
+ */
+int cttk_omap_init(cttk_omap *m, void *mem, size_t mem_len,
+	size_t key_len, size_t val_len, size_t num,
+	void (*rng)(void *rng_ctx, void *dst, size_t len), void *rng_ctx);
+
+/**
+ * \brief Look up a key in an oblivious map.
+ *
+ * If the key is present in the map, then the associated value is
+ * written into `val` (`val_len` bytes) and true is returned. Otherwise,
+ * `val` is filled with zeros, and false is returned. False is also
+ * returned if the underlying ORAM has failed.
+ *
+ * \param m     map.
+ * \param key   key to look up (`key_len` bytes).
+ * \param val   destination for the value (`val_len` bytes).
+ * \return  true if the key was found.
+ */
+cttk_bool cttk_omap_lookup(cttk_omap *m, const void *key, void *val);
+
+/**
+ * \brief Insert an entry in an oblivious map.
+ *
+ * If the key is already present in the map, then its value is replaced
+ * with `val`; otherwise, a new entry is added. Returned value is true
+ * on success, false if there was no room for the new entry (which is
+ * possible, though improbable, even if the map contains fewer than the
+ * maximum number of entries), or the underlying ORAM has failed.
+ *
+ * \param m     map.
+ * \param key   key (`key_len` bytes).
+ * \param val   value (`val_len` bytes).
+ * \return  true on success.
+ */
+cttk_bool cttk_omap_insert(cttk_omap *m, const void *key, const void *val);
+
+/**
+ * \brief Delete an entry from an oblivious map.
+ *
+ * If the key is present in the map, then the corresponding entry is
+ * removed and true is returned. If the key is not present, then the
+ * map is unchanged and false is returned. False is also returned if
+ * the underlying ORAM has failed.
+ *
+ * \param m     map.
+ * \param key   key (`key_len` bytes).
+ * \return  true if the key was found and removed.
+ */
+cttk_bool cttk_omap_delete(cttk_omap *m, const void *key);
+
+/* ==================================================================== */
+/*
+ * Bitslicing.
+ *
+ * A lookup table (e.g. a cipher S-box) accessed with secret indices
+ * can be made constant-time with cttk_array_read(), but each lookup
+ * then costs as much as reading the whole table. Bitslicing evaluates
+ * the table as a boolean circuit instead, over many inputs in
+ * parallel: with W-bit words, a batch of W values is split into
+ * "slices", one per bit position, and each gate of the circuit is a
+ * single word operation (AND, OR, XOR, NOT), whose cost is shared by
+ * the W values.
+ *
+ * The 'bsgen' tool (see tools/bsgen.c) produces, at build time, the C
+ * code for such a circuit, from a lookup table or from a description
+ * of the circuit itself; it can use 32-bit or 64-bit words, or SSE2
+ * and AVX2 registers. The functions below convert batches of
+ * values to and from the bitsliced representation used by that code.
+ *
+ * A batch consists of `width` values, where `width` is a multiple of
+ * 32 (usually the word or register size: 32, 64, 128 or 256). Values
+ * of `nbits` bits are represented as `nbits` slices of `width/32`
+ * 32-bit words each, stored consecutively; slice j holds bit j of each
+ * value, value i being at bit `i mod 32` of word `i / 32` of the
+ * slice. This layout is independent of the platform endianness.
+ *
+ * All these functions are constant-time.
+ */
+
+/**
+ * \brief Convert values to bitsliced representation.
+ *
+ * The `width` values `v[0]` to `v[width-1]` are converted into `nbits`
+ * slices, written into `q` (`nbits * width / 32` words). Only the
+ * `nbits` low bits of each value are used. `width` MUST be a multiple
+ * of 32, and `nbits` MUST be at most 32.
+ *
+ * \param q       destination slices.
+ * \param v       source values.
+ * \param width   number of values in the batch.
+ * \param nbits   number of bits per value.
+ */
+void cttk_bitslice_in(uint32_t *q, const uint32_t *v,
+	size_t width, unsigned nbits);
+
+/**
+ * \brief Convert values from bitsliced representation.
+ *
+ * This is the inverse of `cttk_bitslice_in()`: the `nbits` slices in
+ * `q` are converted back into `width` values, written in `v`; the
+ * upper bits of each value (beyond `nbits`) are set to zero.
+ *
+ * \param v       destination values.
+ * \param q       source slices.
+ * \param width   number of values in the batch.
+ * \param nbits   number of bits per value.
+ */
+void cttk_bitslice_out(uint32_t *v, const uint32_t *q,
+	size_t width, unsigned nbits);
+
+/**
+ * \brief Convert bytes to bitsliced representation.
+ *
+ * This function is equivalent to `cttk_bitslice_in()` with 8-bit
+ * values, which are read as `width` bytes from `src`; the eight
+ * slices are written into `q` (`width / 4` words).
+ *
+ * \param q       destination slices.
+ * \param src     source bytes.
+ * \param width   number of bytes in the batch (multiple of 32).
+ */
+void cttk_bitslice_in8(uint32_t *q, const void *src, size_t width);
+
+/**
+ * \brief Convert bytes from bitsliced representation.
+ *
+ * This is the inverse of `cttk_bitslice_in8()`: the eight slices in
+ * `q` are converted back into `width` bytes, written in `dst`.
+ *
+ * \param dst     destination bytes.
+ * \param q       source slices.
+ * \param width   number of bytes in the batch (multiple of 32).
+ */
+void cttk_bitslice_out8(void *dst, const uint32_t *q, size_t width);
+
 /* ==================================================================== */
 
 /**
@@ -1360,7 +2018,9 @@ size_t cttk_hexscan(const char *src, size_t src_len, int skipws);
  *   - If `CTTK_HEX_SKIP_WS` is set, then "whitespace" characters are
  *     simply skipped and do not trigger an error. For the purposes of
  *     this function, "whitespace" consists in bytes of value 32 or less
- *     (i.e. ASCII space, and all ASCII control characters).
+ *     (i.e. ASCII space, and all ASCII control characters). Decoding
+ *     is faster when this flag is not set, since digits can then be
+ *     processed in blocks of 8 to 32 characters.
  *
  * Constant-time behaviour: the values of hex digits are protected, but
  * not their number or location. Side channels may leak the total number
@@ -1387,6 +2047,94 @@ size_t cttk_hextobin_gen(void *dst, size_t dst_len,
  */
 #define CTTK_HEX_SKIP_WS       0x0002
 
+/**
+ * \brief Context for streaming hexadecimal decoding.
+ *
+ * A streaming decoder processes a hexadecimal string provided in
+ * several chunks of arbitrary lengths; a half-byte may be split
+ * across two chunks. The concatenation of the outputs of all calls
+ * matches the output of `cttk_hextobin_gen()` on the concatenation of
+ * the chunks, with the same flags.
+ *
+ * Contents are private.
+ */
+typedef struct {
+	unsigned flags;
+	int acc;
+	int fail;
+} cttk_hexdec_context;
+
+/**
+ * \brief Initialise a streaming hexadecimal decoder.
+ *
+ * The `flags` have the same meaning as for `cttk_hextobin_gen()`.
+ *
+ * \param hc      context to initialise.
+ * \param flags   behavioural flags.
+ */
+void cttk_hexdec_init(cttk_hexdec_context *hc, unsigned flags);
+
+/**
+ * \brief Inject a chunk of hexadecimal string in a streaming decoder.
+ *
+ * The `src_len` characters starting at `src` are decoded; produced
+ * bytes are written in `dst`, and their number is returned. If `dst`
+ * is `NULL`, then `dst_len` is ignored, and nothing is written (but
+ * the number of bytes is still returned).
+ *
+ * If the whole chunk could be processed, and `err` is not `NULL`,
+ * then `*err` is set to `NULL`. Otherwise, if `err` is not `NULL`,
+ * then `*err` is set to point to the first character that was not
+ * processed; this is either an invalid character, or a hex digit
+ * that would exceed the capacity of the output buffer:
+ *
+ *   - In the case of an invalid character, the context is marked as
+ *     failed: further calls will process no character, and
+ *     `cttk_hexdec_final()` will report the failure. If an odd number
+ *     of hex digits was read and `CTTK_HEX_PAD_ODD` is set, then the
+ *     padded byte is produced (if the output buffer has room for it).
+ *
+ *   - If the output buffer is full, then decoding may resume with
+ *     another call, starting at the character pointed to by `*err`.
+ *
+ * Constant-time behaviour is the same as for `cttk_hextobin_gen()`.
+ *
+ * \param hc        decoder context.
+ * \param dst       destination buffer (or `NULL`).
+ * \param dst_len   maximum size of the destination buffer (in bytes).
+ * \param src       source chunk (can be `NULL` if `src_len` is zero).
+ * \param src_len   source chunk length (in characters).
+ * \param err       receiver for error character pointer, or `NULL`.
+ * \return  number of decoded bytes.
+ */
+size_t cttk_hexdec_update(cttk_hexdec_context *hc, void *dst, size_t dst_len,
+	const char *src, size_t src_len, const char **err);
+
+/**
+ * \brief Finish a streaming hexadecimal decoding.
+ *
+ * If a pending half-byte remains and `CTTK_HEX_PAD_ODD` is set, then
+ * the padded byte is written in `dst` (if not `NULL`). `*len` is set
+ * to the number of bytes produced by this call (0 or 1). Returned
+ * value is `cttk_true` if the whole string was correct (no invalid
+ * character, and no odd number of digits unless `CTTK_HEX_PAD_ODD` is
+ * set), `cttk_false` otherwise. The context is then reset, and may be
+ * reused for a new string with the same flags.
+ *
+ * If a padded byte must be produced but `dst_len` is zero (and `dst`
+ * is not `NULL`), then `cttk_false` is returned and the context is
+ * left unchanged; this function may then be called again with a
+ * larger buffer.
+ *
+ * \param hc        decoder context.
+ * \param dst       destination buffer (or `NULL`).
+ * \param dst_len   maximum size of the destination buffer (in bytes).
+ * \param len       receiver for the number of produced bytes.
+ * \return  `cttk_true` on success, `cttk_false` on error.
+ */
+cttk_bool cttk_hexdec_final(cttk_hexdec_context *hc,
+	void *dst, size_t dst_len, size_t *len);
+
 /**
  * \brief Encode bytes into hexadecimal.
  *
@@ -1503,6 +2251,82 @@ size_t cttk_b64tobin_gen(void *dst, size_t dst_len,
  */
 #define CTTK_B64DEC_NO_WS      0x0002
 
+/**
+ * \brief Context for streaming Base64 decoding.
+ *
+ * A streaming decoder processes a Base64 string provided in several
+ * chunks of arbitrary lengths. The concatenation of the outputs of all
+ * calls matches the output of `cttk_b64tobin_gen()` on the
+ * concatenation of the chunks, with the same flags.
+ *
+ * Contents are private.
+ */
+typedef struct {
+	unsigned flags;
+	unsigned acc;
+	int lc;
+	int pad;
+	int fail;
+} cttk_b64dec_context;
+
+/**
+ * \brief Initialise a streaming Base64 decoder.
+ *
+ * The `flags` have the same meaning as for `cttk_b64tobin_gen()`.
+ *
+ * \param bc      context to initialise.
+ * \param flags   behavioural flags.
+ */
+void cttk_b64dec_init(cttk_b64dec_context *bc, unsigned flags);
+
+/**
+ * \brief Inject a chunk of Base64 string in a streaming decoder.
+ *
+ * The `src_len` characters starting at `src` are decoded; produced
+ * bytes are written in `dst`, and their number is returned. If `dst`
+ * is `NULL`, then `dst_len` is ignored, and nothing is written (but
+ * the number of bytes is still returned).
+ *
+ * If the whole chunk could be processed, and `err` is not `NULL`,
+ * then `*err` is set to `NULL`. Otherwise, if `err` is not `NULL`,
+ * then `*err` is set to point to the first character that was not
+ * processed; this is either an invalid character, or a character that
+ * could not be processed because the output buffer is full (with the
+ * same rules as `cttk_b64tobin_gen()`):
+ *
+ *   - In the case of an invalid character, the context is marked as
+ *     failed: further calls will process no character, and
+ *     `cttk_b64dec_final()` will report the failure.
+ *
+ *   - If the output buffer is full, then decoding may resume with
+ *     another call, starting at the character pointed to by `*err`.
+ *
+ * Constant-time behaviour is the same as for `cttk_b64tobin_gen()`.
+ *
+ * \param bc        decoder context.
+ * \param dst       destination buffer (or `NULL`).
+ * \param dst_len   maximum size of the destination buffer (in bytes).
+ * \param src       source chunk (can be `NULL` if `src_len` is zero).
+ * \param src_len   source chunk length (in characters).
+ * \param err       receiver for error character pointer, or `NULL`.
+ * \return  number of decoded bytes.
+ */
+size_t cttk_b64dec_update(cttk_b64dec_context *bc, void *dst, size_t dst_len,
+	const char *src, size_t src_len, const char **err);
+
+/**
+ * \brief Finish a streaming Base64 decoding.
+ *
+ * Returned value is `cttk_true` if the whole string was correct (no
+ * invalid character, and proper termination with regards to padding
+ * and extra bits), `cttk_false` otherwise. The context is then reset,
+ * and may be reused for a new string with the same flags.
+ *
+ * \param bc   decoder context.
+ * \return  `cttk_true` on success, `cttk_false` on error.
+ */
+cttk_bool cttk_b64dec_final(cttk_b64dec_context *bc);
+
 /**
  * \brief Encode bytes into Base64.
  *
@@ -1569,28 +2393,98 @@ size_t cttk_bintob64_gen(char *dst, size_t dst_len,
  */
 #define CTTK_B64ENC_LINE64     0x0008
 
-/* ==================================================================== */
-
 /**
- * \brief Multiplication unsigned 32x32 -> 32.
+ * \brief Context for streaming Base64 encoding.
  *
- * Result is computed modulo 2^32 (no undefined behaviour on overflow).
+ * A streaming encoder processes data provided in several chunks of
+ * arbitrary lengths; up to two bytes, and the position within the
+ * current output line, are kept in the context between calls. The
+ * concatenation of the outputs of all calls matches the output of
+ * `cttk_bintob64_gen()` on the concatenation of the chunks, with the
+ * same flags (but without any terminating null byte).
  *
- * \param x   first operand.
- * \param y   second operand.
- * \return  the result.
+ * Contents are private.
  */
-uint32_t cttk_mulu32(uint32_t x, uint32_t y);
+typedef struct {
+	unsigned flags;
+	unsigned char pbuf[3];
+	size_t plen;
+	size_t n;
+} cttk_b64enc_context;
 
 /**
- * \brief Multiplication signed 32x32 -> 32.
+ * \brief Initialise a streaming Base64 encoder.
  *
- * This function guarantees two's complement behaviour with truncation
- * to the low 32 bits (no undefined behaviour on overflow/underflow).
+ * The `flags` have the same meaning as for `cttk_bintob64_gen()`.
  *
- * \param x   first operand.
- * \param y   second operand.
- * \return  the result.
+ * \param ec      context to initialise.
+ * \param flags   behavioural flags.
+ */
+void cttk_b64enc_init(cttk_b64enc_context *ec, unsigned flags);
+
+/**
+ * \brief Inject a chunk of data in a streaming Base64 encoder.
+ *
+ * If `dst` is `NULL`, then `dst_len` is ignored, the context is not
+ * modified, and the returned value is the number of characters that
+ * this call would produce. Otherwise, if `dst_len` is lower than that
+ * number, then nothing is done, and 0 is returned. Otherwise, the
+ * characters are written in `dst` (no terminating null byte is added),
+ * and their number is returned.
+ *
+ * Constant-time behaviour: the source byte values are protected, but not
+ * the source or destination lengths.
+ *
+ * \param ec        encoder context.
+ * \param dst       destination buffer, or `NULL`.
+ * \param dst_len   destination buffer length (in characters).
+ * \param src       source bytes (may be `NULL` if `src_len` is zero).
+ * \param src_len   source length (in bytes).
+ * \return  the number of characters produced.
+ */
+size_t cttk_b64enc_update(cttk_b64enc_context *ec, char *dst, size_t dst_len,
+	const void *src, size_t src_len);
+
+/**
+ * \brief Finish a streaming Base64 encoding.
+ *
+ * The final partial chunk (with padding, unless `CTTK_B64ENC_NO_PAD`
+ * is set), and the final line break (if `CTTK_B64ENC_NEWLINE` is set
+ * and the last line is not empty), are produced. Rules for `dst` and
+ * `dst_len` are the same as for `cttk_b64enc_update()`; at most six
+ * characters are produced. After a successful call (with `dst` not
+ * `NULL`), the context is reset, and may be reused for new data with
+ * the same flags.
+ *
+ * \param ec        encoder context.
+ * \param dst       destination buffer, or `NULL`.
+ * \param dst_len   destination buffer length (in characters).
+ * \return  the number of characters produced.
+ */
+size_t cttk_b64enc_final(cttk_b64enc_context *ec, char *dst, size_t dst_len);
+
+/* ==================================================================== */
+
+/**
+ * \brief Multiplication unsigned 32x32 -> 32.
+ *
+ * Result is computed modulo 2^32 (no undefined behaviour on overflow).
+ *
+ * \param x   first operand.
+ * \param y   second operand.
+ * \return  the result.
+ */
+uint32_t cttk_mulu32(uint32_t x, uint32_t y);
+
+/**
+ * \brief Multiplication signed 32x32 -> 32.
+ *
+ * This function guarantees two's complement behaviour with truncation
+ * to the low 32 bits (no undefined behaviour on overflow/underflow).
+ *
+ * \param x   first operand.
+ * \param y   second operand.
+ * \return  the result.
  */
 int32_t cttk_muls32(int32_t x, int32_t y);
 
@@ -2365,6 +3259,149 @@ void cti_mul(cti_elt *d, const cti_elt *a, const cti_elt *b);
  */
 void cti_mul_trunc(cti_elt *d, const cti_elt *a, const cti_elt *b);
 
+/**
+ * \brief Multiplication of two big integers, with a caller-provided
+ * temporary buffer.
+ *
+ * This function is equivalent to `cti_mul()`, except that the
+ * temporary space needed by the computation is taken from `tmp`, which
+ * has room for `tmp_len` elements, instead of the stack or the heap.
+ * This function never allocates memory. If `tmp_len` is at least the
+ * value returned by `cti_ws_len()` for the operand size, then the
+ * result is the same as with `cti_mul()`, and the fastest method is
+ * used. Otherwise, a slower method may be used, or, if `tmp_len` is
+ * too small even for that, the result is set to NaN.
+ *
+ * `tmp` MUST NOT overlap with any of the operands.
+ *
+ * \param d         result recipient.
+ * \param a         first source operand.
+ * \param b         second source operand.
+ * \param tmp       temporary buffer.
+ * \param tmp_len   temporary buffer length (in elements).
+ */
+void cti_mul_ws(cti_elt *d, const cti_elt *a, const cti_elt *b,
+	cti_elt *tmp, size_t tmp_len);
+
+/**
+ * \brief Squaring of a big integer.
+ *
+ * This function computes the same value as `cti_mul(d, a, a)`, but each
+ * cross product of words is computed only once, which makes it faster.
+ * If the operands do not match in size, or the source operand is NaN,
+ * or the result overflows, then the result is set to NaN. Operands need
+ * not be distinct.
+ *
+ * \param d   result recipient.
+ * \param a   source operand.
+ */
+void cti_sqr(cti_elt *d, const cti_elt *a);
+
+/**
+ * \brief Squaring of a big integer (truncating).
+ *
+ * This function computes the same value as `cti_mul_trunc(d, a, a)`.
+ * If the operands do not match in size, or the source operand is NaN,
+ * then the result is set to NaN. On overflow, the result is truncated.
+ * Operands need not be distinct.
+ *
+ * \param d   result recipient.
+ * \param a   source operand.
+ */
+void cti_sqr_trunc(cti_elt *d, const cti_elt *a);
+
+/**
+ * \brief Fused multiplication and addition of big integers.
+ *
+ * This function computes `a*b+c` into `d`, with a single pass over the
+ * destination. If the operands do not match in size, or one of the
+ * source operands is NaN, or the result overflows/underflows, then the
+ * result is set to NaN. Overflows are detected on the final result:
+ * the intermediate product may exceed the representable range, as long
+ * as the sum does not. Operands need not be distinct.
+ *
+ * \param d   result recipient.
+ * \param a   first multiplication operand.
+ * \param b   second multiplication operand.
+ * \param c   addend.
+ */
+void cti_muladd(cti_elt *d, const cti_elt *a, const cti_elt *b,
+	const cti_elt *c);
+
+/**
+ * \brief Fused multiplication and addition of big integers (truncating).
+ *
+ * This function computes `a*b+c` into `d`. If the operands do not match
+ * in size, or one of the source operands is NaN, then the result is set
+ * to NaN. On overflow or underflow, the result is truncated. Operands
+ * need not be distinct.
+ *
+ * \param d   result recipient.
+ * \param a   first multiplication operand.
+ * \param b   second multiplication operand.
+ * \param c   addend.
+ */
+void cti_muladd_trunc(cti_elt *d, const cti_elt *a, const cti_elt *b,
+	const cti_elt *c);
+
+/**
+ * \brief Multiplication of a big integer by a small scalar.
+ *
+ * This function computes `a*x` into `d`; `x` is an unsigned 32-bit
+ * integer. If the operands do not match in size, or the source operand
+ * is NaN, or the result overflows/underflows, then the result is set
+ * to NaN. Operands need not be distinct. The value of `x` is not
+ * leaked.
+ *
+ * \param d   result recipient.
+ * \param a   source operand.
+ * \param x   scalar multiplier.
+ */
+void cti_mul_u32(cti_elt *d, const cti_elt *a, uint32_t x);
+
+/**
+ * \brief Multiplication of a big integer by a small scalar (truncating).
+ *
+ * This function computes `a*x` into `d`. If the operands do not match
+ * in size, or the source operand is NaN, then the result is set to NaN.
+ * On overflow or underflow, the result is truncated. Operands need not
+ * be distinct.
+ *
+ * \param d   result recipient.
+ * \param a   source operand.
+ * \param x   scalar multiplier.
+ */
+void cti_mul_u32_trunc(cti_elt *d, const cti_elt *a, uint32_t x);
+
+/**
+ * \brief Multiply-accumulate of a big integer by a small scalar.
+ *
+ * This function adds `a*x` to `d`; `x` is an unsigned 32-bit integer.
+ * If the operands do not match in size, or one of the operands is NaN,
+ * or the result overflows/underflows, then the result is set to NaN.
+ * Operands need not be distinct.
+ *
+ * \param d   accumulator.
+ * \param a   source operand.
+ * \param x   scalar multiplier.
+ */
+void cti_addmul_u32(cti_elt *d, const cti_elt *a, uint32_t x);
+
+/**
+ * \brief Multiply-accumulate of a big integer by a small scalar
+ * (truncating).
+ *
+ * This function adds `a*x` to `d`. If the operands do not match in
+ * size, or one of the operands is NaN, then the result is set to NaN.
+ * On overflow or underflow, the result is truncated. Operands need not
+ * be distinct.
+ *
+ * \param d   accumulator.
+ * \param a   source operand.
+ * \param x   scalar multiplier.
+ */
+void cti_addmul_u32_trunc(cti_elt *d, const cti_elt *a, uint32_t x);
+
 /**
  * \brief Big integer left-shift.
  *
@@ -2595,6 +3632,63 @@ cti_rem(cti_elt *r, const cti_elt *a, const cti_elt *b)
  */
 void cti_mod(cti_elt *m, const cti_elt *a, const cti_elt *b);
 
+/**
+ * \brief Division of two integers, with a caller-provided temporary
+ * buffer.
+ *
+ * This function is equivalent to `cti_divrem()`, except that the
+ * temporary space is taken from `tmp` (`tmp_len` elements) instead of
+ * the stack or the heap; it never allocates memory. If `tmp_len` is
+ * lower than the value returned by `cti_ws_len()` for the operand
+ * size, then the quotient and remainder are set to NaN.
+ *
+ * `tmp` MUST NOT overlap with any of the operands.
+ *
+ * \param q         recipient for the quotient (or `NULL`).
+ * \param r         recipient for the remainer (or `NULL`).
+ * \param a         dividend.
+ * \param b         divisor.
+ * \param tmp       temporary buffer.
+ * \param tmp_len   temporary buffer length (in elements).
+ */
+void cti_divrem_ws(cti_elt *q, cti_elt *r,
+	const cti_elt *a, const cti_elt *b, cti_elt *tmp, size_t tmp_len);
+
+/**
+ * \brief Modular reduction, with a caller-provided temporary buffer.
+ *
+ * This function is equivalent to `cti_mod()`, except that the
+ * temporary space is taken from `tmp` (`tmp_len` elements) instead of
+ * the stack or the heap; it never allocates memory. If `tmp_len` is
+ * lower than the value returned by `cti_ws_len()` for the operand
+ * size, then the result is set to NaN.
+ *
+ * `tmp` MUST NOT overlap with any of the operands.
+ *
+ * \param m         recipient for the modular reduction result.
+ * \param a         dividend.
+ * \param b         divisor.
+ * \param tmp       temporary buffer.
+ * \param tmp_len   temporary buffer length (in elements).
+ */
+void cti_mod_ws(cti_elt *m, const cti_elt *a, const cti_elt *b,
+	cti_elt *tmp, size_t tmp_len);
+
+/**
+ * \brief Get the temporary buffer length for the `_ws` functions.
+ *
+ * This function returns the minimal length (in elements) of the
+ * temporary buffer for `cti_mul_ws()`, `cti_divrem_ws()` and
+ * `cti_mod_ws()`, with operands of the provided size (as used with
+ * `cti_def()` or `cti_init()`). With a buffer of that length, these
+ * functions never fail for lack of temporary space. A single buffer
+ * may be reused for successive calls.
+ *
+ * \param size   operand size (in bits).
+ * \return  the temporary buffer length (in elements).
+ */
+size_t cti_ws_len(unsigned size);
+
 /**
  * \brief Bitwise AND.
  *
@@ -2682,8 +3776,212 @@ void cti_not(cti_elt *d, const cti_elt *a);
 #else
 
 /*
- * Default big integer implementation is "i31".
- */
+ * Default big integer implementation is "i63" on 64-bit architectures
+ * with a native 64x64->128 multiplication, when CTTK_CTMUL64 is set
+ * (which is the default on such architectures, see cttk_config.h);
+ * "i31" is used otherwise, since i63 with the emulated 64x64->128
+ * multiplication is slower than i31. This can be overridden by defining
+ * CTTK_I63 to 1 (use i63) or 0 (use i31) before including this header.
+ * All implementations are always compiled in the library, and they may
+ * be used directly with their explicit names.
+ *
+ * The "i15" implementation is selected instead if CTTK_I15 is defined
+ * to 1. If neither CTTK_I15 nor CTTK_I63 is defined, then i15 is the
+ * default when the 32x32->64 multiplication is declared not constant-time,
+ * i.e. when CTTK_CTMULU32W (or CTTK_CTMUL, if CTTK_CTMULU32W is not
+ * defined) is explicitly defined to 0 in cttk_config.h (or on the
+ * command line, for both the library and the application).
+ */
+#if !defined CTTK_I15 && !defined CTTK_I63
+#if defined CTTK_CTMULU32W && !CTTK_CTMULU32W
+#define CTTK_I15   1
+#endif
+#endif
+#ifndef CTTK_I15
+#define CTTK_I15   0
+#endif
+#ifndef CTTK_I63
+#if CTTK_CTMUL64 \
+	&& (defined __SIZEOF_INT128__ || (defined _MSC_VER && defined _M_X64))
+#define CTTK_I63   1
+#else
+#define CTTK_I63   0
+#endif
+#endif
+
+#if CTTK_I15
+#define cti_def                    cttk_i15_def
+#define cti_definit                cttk_i15_definit
+#define cti_elt                    cttk_i15_elt
+#define cti_init                   cttk_i15_init
+#define cti_set_u32                cttk_i15_set_u32
+#define cti_set_u32_trunc          cttk_i15_set_u32_trunc
+#define cti_set_u64                cttk_i15_set_u64
+#define cti_set_u64_trunc          cttk_i15_set_u64_trunc
+#define cti_set_s32                cttk_i15_set_s32
+#define cti_set_s64                cttk_i15_set_s64
+#define cti_set                    cttk_i15_set
+#define cti_set_trunc              cttk_i15_set_trunc
+#define cti_isnan                  cttk_i15_isnan
+#define cti_to_u32_trunc           cttk_i15_to_u32_trunc
+#define cti_to_s32_trunc           cttk_i15_to_s32_trunc
+#define cti_to_u64_trunc           cttk_i15_to_u64_trunc
+#define cti_to_s64_trunc           cttk_i15_to_s64_trunc
+#define cti_to_u32                 cttk_i15_to_u32
+#define cti_to_s32                 cttk_i15_to_s32
+#define cti_to_u64                 cttk_i15_to_u64
+#define cti_to_s64                 cttk_i15_to_s64
+#define cti_decbe_signed           cttk_i15_decbe_signed
+#define cti_decbe_unsigned         cttk_i15_decbe_unsigned
+#define cti_decbe_signed_trunc     cttk_i15_decbe_signed_trunc
+#define cti_decbe_unsigned_trunc   cttk_i15_decbe_unsigned_trunc
+#define cti_decle_signed           cttk_i15_decle_signed
+#define cti_decle_unsigned         cttk_i15_decle_unsigned
+#define cti_decle_signed_trunc     cttk_i15_decle_signed_trunc
+#define cti_decle_unsigned_trunc   cttk_i15_decle_unsigned_trunc
+#define cti_encbe                  cttk_i15_encbe
+#define cti_encle                  cttk_i15_encle
+#define cti_eq0                    cttk_i15_eq0
+#define cti_neq0                   cttk_i15_neq0
+#define cti_gt0                    cttk_i15_gt0
+#define cti_lt0                    cttk_i15_lt0
+#define cti_geq0                   cttk_i15_geq0
+#define cti_leq0                   cttk_i15_leq0
+#define cti_eq                     cttk_i15_eq
+#define cti_neq                    cttk_i15_neq
+#define cti_lt                     cttk_i15_lt
+#define cti_leq                    cttk_i15_leq
+#define cti_gt                     cttk_i15_gt
+#define cti_geq                    cttk_i15_geq
+#define cti_sign                   cttk_i15_sign
+#define cti_cmp                    cttk_i15_cmp
+#define cti_copy                   cttk_i15_copy
+#define cti_cond_copy              cttk_i15_cond_copy
+#define cti_swap                   cttk_i15_swap
+#define cti_cond_swap              cttk_i15_cond_swap
+#define cti_mux                    cttk_i15_mux
+#define cti_add                    cttk_i15_add
+#define cti_add_trunc              cttk_i15_add_trunc
+#define cti_sub                    cttk_i15_sub
+#define cti_sub_trunc              cttk_i15_sub_trunc
+#define cti_neg                    cttk_i15_neg
+#define cti_neg_trunc              cttk_i15_neg_trunc
+#define cti_mul                    cttk_i15_mul
+#define cti_mul_trunc              cttk_i15_mul_trunc
+#define cti_mul_ws                 cttk_i15_mul_ws
+#define cti_sqr                    cttk_i15_sqr
+#define cti_sqr_trunc              cttk_i15_sqr_trunc
+#define cti_muladd                 cttk_i15_muladd
+#define cti_muladd_trunc           cttk_i15_muladd_trunc
+#define cti_mul_u32                cttk_i15_mul_u32
+#define cti_mul_u32_trunc          cttk_i15_mul_u32_trunc
+#define cti_addmul_u32             cttk_i15_addmul_u32
+#define cti_addmul_u32_trunc       cttk_i15_addmul_u32_trunc
+#define cti_lsh                    cttk_i15_lsh
+#define cti_lsh_prot               cttk_i15_lsh_prot
+#define cti_lsh_trunc              cttk_i15_lsh_trunc
+#define cti_lsh_trunc_prot         cttk_i15_lsh_trunc_prot
+#define cti_rsh                    cttk_i15_rsh
+#define cti_rsh_prot               cttk_i15_rsh_prot
+#define cti_divrem                 cttk_i15_divrem
+#define cti_div                    cttk_i15_div
+#define cti_rem                    cttk_i15_rem
+#define cti_mod                    cttk_i15_mod
+#define cti_divrem_ws              cttk_i15_divrem_ws
+#define cti_mod_ws                 cttk_i15_mod_ws
+#define cti_ws_len                 cttk_i15_ws_len
+#define cti_and                    cttk_i15_and
+#define cti_or                     cttk_i15_or
+#define cti_xor                    cttk_i15_xor
+#define cti_eqv                    cttk_i15_eqv
+#define cti_not                    cttk_i15_not
+#elif CTTK_I63
+#define cti_def                    cttk_i63_def
+#define cti_definit                cttk_i63_definit
+#define cti_elt                    cttk_i63_elt
+#define cti_init                   cttk_i63_init
+#define cti_set_u32                cttk_i63_set_u32
+#define cti_set_u32_trunc          cttk_i63_set_u32_trunc
+#define cti_set_u64                cttk_i63_set_u64
+#define cti_set_u64_trunc          cttk_i63_set_u64_trunc
+#define cti_set_s32                cttk_i63_set_s32
+#define cti_set_s64                cttk_i63_set_s64
+#define cti_set                    cttk_i63_set
+#define cti_set_trunc              cttk_i63_set_trunc
+#define cti_isnan                  cttk_i63_isnan
+#define cti_to_u32_trunc           cttk_i63_to_u32_trunc
+#define cti_to_s32_trunc           cttk_i63_to_s32_trunc
+#define cti_to_u64_trunc           cttk_i63_to_u64_trunc
+#define cti_to_s64_trunc           cttk_i63_to_s64_trunc
+#define cti_to_u32                 cttk_i63_to_u32
+#define cti_to_s32                 cttk_i63_to_s32
+#define cti_to_u64                 cttk_i63_to_u64
+#define cti_to_s64                 cttk_i63_to_s64
+#define cti_decbe_signed           cttk_i63_decbe_signed
+#define cti_decbe_unsigned         cttk_i63_decbe_unsigned
+#define cti_decbe_signed_trunc     cttk_i63_decbe_signed_trunc
+#define cti_decbe_unsigned_trunc   cttk_i63_decbe_unsigned_trunc
+#define cti_decle_signed           cttk_i63_decle_signed
+#define cti_decle_unsigned         cttk_i63_decle_unsigned
+#define cti_decle_signed_trunc     cttk_i63_decle_signed_trunc
+#define cti_decle_unsigned_trunc   cttk_i63_decle_unsigned_trunc
+#define cti_encbe                  cttk_i63_encbe
+#define cti_encle                  cttk_i63_encle
+#define cti_eq0                    cttk_i63_eq0
+#define cti_neq0                   cttk_i63_neq0
+#define cti_gt0                    cttk_i63_gt0
+#define cti_lt0                    cttk_i63_lt0
+#define cti_geq0                   cttk_i63_geq0
+#define cti_leq0                   cttk_i63_leq0
+#define cti_eq                     cttk_i63_eq
+#define cti_neq                    cttk_i63_neq
+#define cti_lt                     cttk_i63_lt
+#define cti_leq                    cttk_i63_leq
+#define cti_gt                     cttk_i63_gt
+#define cti_geq                    cttk_i63_geq
+#define cti_sign                   cttk_i63_sign
+#define cti_cmp                    cttk_i63_cmp
+#define cti_copy                   cttk_i63_copy
+#define cti_cond_copy              cttk_i63_cond_copy
+#define cti_swap                   cttk_i63_swap
+#define cti_cond_swap              cttk_i63_cond_swap
+#define cti_mux                    cttk_i63_mux
+#define cti_add                    cttk_i63_add
+#define cti_add_trunc              cttk_i63_add_trunc
+#define cti_sub                    cttk_i63_sub
+#define cti_sub_trunc              cttk_i63_sub_trunc
+#define cti_neg                    cttk_i63_neg
+#define cti_neg_trunc              cttk_i63_neg_trunc
+#define cti_mul                    cttk_i63_mul
+#define cti_mul_trunc              cttk_i63_mul_trunc
+#define cti_mul_ws                 cttk_i63_mul_ws
+#define cti_sqr                    cttk_i63_sqr
+#define cti_sqr_trunc              cttk_i63_sqr_trunc
+#define cti_muladd                 cttk_i63_muladd
+#define cti_muladd_trunc           cttk_i63_muladd_trunc
+#define cti_mul_u32                cttk_i63_mul_u32
+#define cti_mul_u32_trunc          cttk_i63_mul_u32_trunc
+#define cti_addmul_u32             cttk_i63_addmul_u32
+#define cti_addmul_u32_trunc       cttk_i63_addmul_u32_trunc
+#define cti_lsh                    cttk_i63_lsh
+#define cti_lsh_prot               cttk_i63_lsh_prot
+#define cti_lsh_trunc              cttk_i63_lsh_trunc
+#define cti_lsh_trunc_prot         cttk_i63_lsh_trunc_prot
+#define cti_rsh                    cttk_i63_rsh
+#define cti_rsh_prot               cttk_i63_rsh_prot
+#define cti_divrem                 cttk_i63_divrem
+#define cti_div                    cttk_i63_div
+#define cti_rem                    cttk_i63_rem
+#define cti_mod                    cttk_i63_mod
+#define cti_divrem_ws              cttk_i63_divrem_ws
+#define cti_mod_ws                 cttk_i63_mod_ws
+#define cti_ws_len                 cttk_i63_ws_len
+#define cti_and                    cttk_i63_and
+#define cti_or                     cttk_i63_or
+#define cti_xor                    cttk_i63_xor
+#define cti_eqv                    cttk_i63_eqv
+#define cti_not                    cttk_i63_not
+#else
 #define cti_def                    cttk_i31_def
 #define cti_definit                cttk_i31_definit
 #define cti_elt                    cttk_i31_elt
@@ -2742,6 +4040,15 @@ void cti_not(cti_elt *d, const cti_elt *a);
 #define cti_neg_trunc              cttk_i31_neg_trunc
 #define cti_mul                    cttk_i31_mul
 #define cti_mul_trunc              cttk_i31_mul_trunc
+#define cti_mul_ws                 cttk_i31_mul_ws
+#define cti_sqr                    cttk_i31_sqr
+#define cti_sqr_trunc              cttk_i31_sqr_trunc
+#define cti_muladd                 cttk_i31_muladd
+#define cti_muladd_trunc           cttk_i31_muladd_trunc
+#define cti_mul_u32                cttk_i31_mul_u32
+#define cti_mul_u32_trunc          cttk_i31_mul_u32_trunc
+#define cti_addmul_u32             cttk_i31_addmul_u32
+#define cti_addmul_u32_trunc       cttk_i31_addmul_u32_trunc
 #define cti_lsh                    cttk_i31_lsh
 #define cti_lsh_prot               cttk_i31_lsh_prot
 #define cti_lsh_trunc              cttk_i31_lsh_trunc
@@ -2752,11 +4059,15 @@ void cti_not(cti_elt *d, const cti_elt *a);
 #define cti_div                    cttk_i31_div
 #define cti_rem                    cttk_i31_rem
 #define cti_mod                    cttk_i31_mod
+#define cti_divrem_ws              cttk_i31_divrem_ws
+#define cti_mod_ws                 cttk_i31_mod_ws
+#define cti_ws_len                 cttk_i31_ws_len
 #define cti_and                    cttk_i31_and
 #define cti_or                     cttk_i31_or
 #define cti_xor                    cttk_i31_xor
 #define cti_eqv                    cttk_i31_eqv
 #define cti_not                    cttk_i31_not
+#endif
 
 /*
  * The "i31" implementation of big integer represents values as
@@ -2829,6 +4140,18 @@ void cttk_i31_neg(uint32_t *d, const uint32_t *x);
 void cttk_i31_neg_trunc(uint32_t *d, const uint32_t *x);
 void cttk_i31_mul(uint32_t *d, const uint32_t *a, const uint32_t *b);
 void cttk_i31_mul_trunc(uint32_t *d, const uint32_t *a, const uint32_t *b);
+void cttk_i31_mul_ws(uint32_t *d, const uint32_t *a, const uint32_t *b,
+	uint32_t *tmp, size_t tmp_len);
+void cttk_i31_sqr(uint32_t *d, const uint32_t *a);
+void cttk_i31_sqr_trunc(uint32_t *d, const uint32_t *a);
+void cttk_i31_muladd(uint32_t *d, const uint32_t *a, const uint32_t *b,
+	const uint32_t *c);
+void cttk_i31_muladd_trunc(uint32_t *d, const uint32_t *a, const uint32_t *b,
+	const uint32_t *c);
+void cttk_i31_mul_u32(uint32_t *d, const uint32_t *a, uint32_t x);
+void cttk_i31_mul_u32_trunc(uint32_t *d, const uint32_t *a, uint32_t x);
+void cttk_i31_addmul_u32(uint32_t *d, const uint32_t *a, uint32_t x);
+void cttk_i31_addmul_u32_trunc(uint32_t *d, const uint32_t *a, uint32_t x);
 void cttk_i31_lsh(uint32_t *d, const uint32_t *a, uint32_t n);
 void cttk_i31_lsh_prot(uint32_t *d, const uint32_t *a, uint32_t n);
 void cttk_i31_lsh_trunc(uint32_t *d, const uint32_t *a, uint32_t n);
@@ -2848,13 +4171,1078 @@ cttk_i31_rem(uint32_t *r, const uint32_t *a, const uint32_t *b)
 	cttk_i31_divrem(NULL, r, a, b);
 }
 void cttk_i31_mod(uint32_t *d, const uint32_t *a, const uint32_t *b);
+void cttk_i31_divrem_ws(uint32_t *q, uint32_t *r,
+	const uint32_t *a, const uint32_t *b, uint32_t *tmp, size_t tmp_len);
+void cttk_i31_mod_ws(uint32_t *d, const uint32_t *a, const uint32_t *b,
+	uint32_t *tmp, size_t tmp_len);
+size_t cttk_i31_ws_len(unsigned size);
 void cttk_i31_and(uint32_t *d, const uint32_t *a, const uint32_t *b);
 void cttk_i31_or(uint32_t *d, const uint32_t *a, const uint32_t *b);
 void cttk_i31_xor(uint32_t *d, const uint32_t *a, const uint32_t *b);
 void cttk_i31_eqv(uint32_t *d, const uint32_t *a, const uint32_t *b);
 void cttk_i31_not(uint32_t *d, const uint32_t *a);
 
+/**
+ * \brief Greatest common divisor (i31 only).
+ *
+ * This function computes the GCD of `a` and `b`; the result is written
+ * in `d`. Operands may have any sign and parity; the GCD is always
+ * nonnegative, and the GCD of 0 and 0 is 0. The computation uses the
+ * "safegcd" algorithm of Bernstein and Yang, with a number of
+ * iterations that depends only on the operand size.
+ *
+ * If the operands do not match in size, or one of the source operands
+ * is NaN, then the result is set to NaN. An overflow (also reported as
+ * a NaN) occurs only when the GCD is the opposite of the minimal
+ * representable value, i.e. when each operand is either 0 or that
+ * minimal value (but not both 0). Operands need not be distinct.
+ *
+ * \param d   recipient for the GCD.
+ * \param a   first operand.
+ * \param b   second operand.
+ */
+void cttk_i31_gcd(uint32_t *d, const uint32_t *a, const uint32_t *b);
+
+/**
+ * \brief Modular inversion (i31 only).
+ *
+ * This function computes the inverse of `a` modulo `m`; the result is
+ * written in `d`, and is in the 0 to `m-1` range. The value `a` has
+ * any sign and need not be reduced modulo `m`. The computation uses
+ * the "safegcd" algorithm of Bernstein and Yang, with a number of
+ * iterations that depends only on the operand size; it is much faster
+ * than an exponentiation with Fermat's little theorem.
+ *
+ * If the operands do not match in size, or one of the source operands
+ * is NaN, or `m` is not odd and positive, or `a` is not invertible
+ * modulo `m` (i.e. `a` and `m` are not coprime), then the result is
+ * set to NaN. Operands need not be distinct.
+ *
+ * \param d   recipient for the inverse.
+ * \param a   value to invert.
+ * \param m   modulus (odd, positive).
+ */
+void cttk_i31_modinv(uint32_t *d, const uint32_t *a, const uint32_t *m);
+
+/**
+ * \brief Encode an integer in decimal (i31 only).
+ *
+ * The value `x` is written in decimal into `dst`. The destination
+ * buffer length (`dst_len`) must be large enough to accommodate the
+ * characters _and_ a terminating null byte.
+ *
+ * By default, the output has a fixed length that depends only on the
+ * size of `x`: a sign character (`+` or `-`), followed by as many
+ * digits as needed for the largest absolute value of that size, with
+ * leading zeros (a size of `size` bits yields 1+floor((size-1)*log10(2))
+ * digits, occasionally one more). A NaN is encoded as zero.
+ *
+ * If `CTTK_DEC_TRIM` is set in `flags`, then leading zeros are removed
+ * (a zero value still yields one digit), and the sign character is
+ * produced only for negative values. This leaks the number of digits
+ * of the value, through both the output length and timing.
+ *
+ * If `dst` is `NULL`, then `dst_len` is ignored, and the returned value
+ * is the number of characters that would be produced. Without
+ * `CTTK_DEC_TRIM`, this is computed from the size of `x` only, and is
+ * cheap.
+ *
+ * Returned value is the number of characters written, excluding the
+ * terminating null byte. The terminating null byte will still be
+ * written, except if `dst` is `NULL`, or `dst_len` is 0. If the output
+ * buffer is too small, then output is truncated, but still with a
+ * terminating 0.
+ *
+ * The value is split recursively with divisions by powers of 10^9, with
+ * divisor contexts (`cttk_d31_init()`), instead of one division per
+ * digit group. The cost is nonetheless quadratic in the size of `x`
+ * (the contexts are rebuilt on each call, and divisor context
+ * operations use schoolbook algorithms): about 4 times more per
+ * doubling of the size, e.g. several hundred milliseconds for 32768
+ * bits on a modern x86 CPU. Temporary space is up to about 30 times
+ * the size of `x`; if it exceeds `CTTK_MAX_INT_BUF` bytes, then a temporary
+ * buffer is dynamically allocated. If that allocation, or an allocation
+ * within one of the divisor contexts, fails, then an empty string is
+ * produced, and 0 is returned.
+ *
+ * Constant-time behaviour: without `CTTK_DEC_TRIM`, the value of `x`
+ * (including its sign) is protected; only its size may leak.
+ *
+ * \param dst       destination buffer, or `NULL`.
+ * \param dst_len   destination buffer length (in characters).
+ * \param x         value to encode.
+ * \param flags     behavioural flags.
+ * \return  the number of characters produced.
+ */
+size_t cttk_i31_encdec(char *dst, size_t dst_len,
+	const uint32_t *x, unsigned flags);
+
+/**
+ * \brief Decimal encoding flag: remove leading zeros and the `+` sign.
+ */
+#define CTTK_DEC_TRIM   0x0001
+
+/**
+ * \brief Decode an integer from decimal (i31 only).
+ *
+ * The `len` characters starting at `src` are parsed as an optional sign
+ * character (`+` or `-`) followed by at least one decimal digit; this
+ * is the format produced by `cttk_i31_encdec()`, and leading zeros are
+ * allowed. The value is written in `x`, which must have been
+ * initialised with the target size. If the string is not well-formed,
+ * or the value does not fit in the size of `x`, then `x` is set to NaN.
+ *
+ * The string is processed by recursive splits, with multiplications by
+ * powers of 10^9 (`cttk_i31_mul()`). Temporary space is up to about 12
+ * times the size of a value with `len` digits; if it exceeds
+ * `CTTK_MAX_INT_BUF` bytes, then a temporary buffer is dynamically
+ * allocated; if that allocation fails, then `x` is set to NaN.
+ *
+ * Constant-time behaviour: the digit values and the sign value (`+`
+ * or `-`) are protected, but not the string length, nor the presence
+ * of a sign character.
+ *
+ * \param x     destination integer.
+ * \param src   source string (may be `NULL` if `len` is zero).
+ * \param len   source string length (in characters).
+ */
+void cttk_i31_decdec(uint32_t *x, const char *src, size_t len);
+
+/**
+ * \brief Decode an integer from hexadecimal (i31 only).
+ *
+ * The `src_len` characters starting at `src` are parsed as with
+ * `cttk_hextobin_gen()`, and the resulting bytes are interpreted as a
+ * big-endian integer, as with `cttk_i31_decbe_*()`. The digit bits are
+ * written directly in the words of `x`, which must have been
+ * initialised with the target size; there is no intermediate buffer.
+ *
+ * The `flags` combine the hexadecimal decoding flags
+ * (`CTTK_HEX_PAD_ODD` and `CTTK_HEX_SKIP_WS`) with the following:
+ *
+ *   - If `CTTK_I31_SIGNED` is set, then the value is signed (two's
+ *     complement); otherwise, it is unsigned.
+ *
+ *   - If `CTTK_I31_TRUNC` is set, then the value is truncated to the
+ *     size of `x`; otherwise, `x` is set to NaN if the value does not
+ *     fit.
+ *
+ * These four combinations match, respectively,
+ * `cttk_i31_decbe_signed()`, `cttk_i31_decbe_unsigned()`,
+ * `cttk_i31_decbe_signed_trunc()` and `cttk_i31_decbe_unsigned_trunc()`
+ * (in particular, a signed decoding of an empty string yields NaN).
+ *
+ * If the string is not valid, then `x` is set to NaN. If `err` is not
+ * `NULL`, then `*err` is set as by `cttk_hextobin_gen()` (with an
+ * unlimited output buffer): it points to the first invalid character,
+ * or is `NULL` if the string is valid.
+ *
+ * Constant-time behaviour: as for `cttk_hextobin_gen()`; the value of
+ * `x` is protected.
+ *
+ * \param x         destination integer.
+ * \param src       source string (can be `NULL` if `src_len` is zero).
+ * \param src_len   source string length (in characters).
+ * \param err       receiver for error character pointer, or `NULL`.
+ * \param flags     behavioural flags.
+ */
+void cttk_i31_dechex(uint32_t *x, const char *src, size_t src_len,
+	const char **err, unsigned flags);
+
+/**
+ * \brief Text decoding flag: the source value is signed.
+ */
+#define CTTK_I31_SIGNED   0x0100
+
+/**
+ * \brief Text decoding flag: truncate the value to the integer size.
+ */
+#define CTTK_I31_TRUNC    0x0200
+
+/**
+ * \brief Decode an integer from Base64 (i31 only).
+ *
+ * This function is similar to `cttk_i31_dechex()`, except that the
+ * source string is parsed as with `cttk_b64tobin_gen()`; the Base64
+ * decoding flags (`CTTK_B64DEC_NO_PAD` and `CTTK_B64DEC_NO_WS`) can
+ * be combined with `CTTK_I31_SIGNED` and `CTTK_I31_TRUNC`.
+ *
+ * \param x         destination integer.
+ * \param src       source string (can be `NULL` if `src_len` is zero).
+ * \param src_len   source string length (in characters).
+ * \param err       receiver for error character pointer, or `NULL`.
+ * \param flags     behavioural flags.
+ */
+void cttk_i31_decb64(uint32_t *x, const char *src, size_t src_len,
+	const char **err, unsigned flags);
+
+/**
+ * \brief Encode an integer into hexadecimal (i31 only).
+ *
+ * The value `x` is encoded over `len` bytes, as with `cttk_i31_encbe()`,
+ * and these bytes are converted to hexadecimal, as with
+ * `cttk_bintohex_gen()` (with the same flags, output truncation, and
+ * returned value). Bytes are extracted by small blocks, so that there
+ * is no full-size intermediate buffer.
+ *
+ * Constant-time behaviour: the value of `x` is protected.
+ *
+ * \param dst       destination buffer, or `NULL`.
+ * \param dst_len   destination buffer length (in characters).
+ * \param x         value to encode.
+ * \param len       encoding length (in bytes).
+ * \param flags     behavioural flags.
+ * \return  the number of hexadecimal digits produced.
+ */
+size_t cttk_i31_enchex(char *dst, size_t dst_len,
+	const uint32_t *x, size_t len, unsigned flags);
+
+/**
+ * \brief Encode an integer into Base64 (i31 only).
+ *
+ * This function is similar to `cttk_i31_enchex()`, except that the
+ * bytes are converted to Base64, as with `cttk_bintob64_gen()` (with
+ * the same flags, output truncation, and returned value).
+ *
+ * \param dst       destination buffer, or `NULL`.
+ * \param dst_len   destination buffer length (in characters).
+ * \param x         value to encode.
+ * \param len       encoding length (in bytes).
+ * \param flags     behavioural flags.
+ * \return  the number of characters produced.
+ */
+size_t cttk_i31_encb64(char *dst, size_t dst_len,
+	const uint32_t *x, size_t len, unsigned flags);
+
+/*
+ * Fixed-size i31 functions.
+ *
+ * For each size (in bits) listed in CTTK_I31_FIXED_SIZES, the
+ * following functions are provided, with the size appended to their
+ * name (e.g. `cttk_i31_add_256()`):
+ *
+ *   cttk_i31_add_<size>()         cttk_i31_add_trunc_<size>()
+ *   cttk_i31_sub_<size>()         cttk_i31_sub_trunc_<size>()
+ *   cttk_i31_mul_<size>()         cttk_i31_mul_trunc_<size>()
+ *   cttk_i31_cmp_<size>()
+ *
+ * They work on normal i31 integers (defined with `cttk_i31_def()` and
+ * initialised with `cttk_i31_init()`), and have the same semantics as
+ * the generic functions of the same name; but the size is fixed at
+ * compile time, which allows the compiler to unroll the loops. If an
+ * operand or the destination does not have exactly the function size,
+ * then the result is NaN (or 0, for comparisons). For multiplications,
+ * sizes that reach the Karatsuba threshold (`CTTK_KARATSUBA_THRESHOLD`
+ * words) use the generic implementation.
+ *
+ * The list of sizes may be overridden by defining the macro
+ * CTTK_I31_FIXED_SIZES(X) as a sequence of X(size) elements; the
+ * same definition must then be used when compiling the library.
+ */
+#ifndef CTTK_I31_FIXED_SIZES
+#define CTTK_I31_FIXED_SIZES(X)   X(255) X(256) X(384) X(521) X(2048) X(3072)
 #endif
+#define CTTK_I31_FIXED_DECL(size) \
+	void cttk_i31_add_ ## size(uint32_t *d, \
+		const uint32_t *a, const uint32_t *b); \
+	void cttk_i31_add_trunc_ ## size(uint32_t *d, \
+		const uint32_t *a, const uint32_t *b); \
+	void cttk_i31_sub_ ## size(uint32_t *d, \
+		const uint32_t *a, const uint32_t *b); \
+	void cttk_i31_sub_trunc_ ## size(uint32_t *d, \
+		const uint32_t *a, const uint32_t *b); \
+	void cttk_i31_mul_ ## size(uint32_t *d, \
+		const uint32_t *a, const uint32_t *b); \
+	void cttk_i31_mul_trunc_ ## size(uint32_t *d, \
+		const uint32_t *a, const uint32_t *b); \
+	int32_t cttk_i31_cmp_ ## size(const uint32_t *x, const uint32_t *y);
+CTTK_I31_FIXED_SIZES(CTTK_I31_FIXED_DECL)
+
+/*
+ * The "i63" implementation is similar to "i31", but with 64-bit words
+ * (uint64_t): the first word contains the integer size and the "NaN
+ * flag" (top bit), and subsequent words encode the value with 63 bits
+ * per word (the top bit is always 0). It is meant for architectures
+ * with efficient 64x64->128 multiplications.
+ */
+
+#define cttk_i63_def(name, size)       uint64_t name[((size) + 125) / 63]
+#define cttk_i63_definit(name, size)   cttk_i63_def(name, size) = { ((size) + ((size) / 63)) + 0x8000000000000000 }
+#define cttk_i63_elt   uint64_t
+void cttk_i63_init(uint64_t *x, unsigned size);
+void cttk_i63_set_u32(uint64_t *x, uint32_t v);
+void cttk_i63_set_u32_trunc(uint64_t *x, uint32_t v);
+void cttk_i63_set_u64(uint64_t *x, uint64_t v);
+void cttk_i63_set_u64_trunc(uint64_t *x, uint64_t v);
+void cttk_i63_set_s32(uint64_t *x, int32_t v);
+void cttk_i63_set_s64(uint64_t *x, int64_t v);
+void cttk_i63_set(uint64_t *d, const uint64_t *a);
+void cttk_i63_set_trunc(uint64_t *d, const uint64_t *a);
+static inline cttk_bool
+cttk_i63_isnan(const uint64_t *x)
+{
+	return cttk_bool_of_u32((uint32_t)(x[0] >> 63));
+}
+uint32_t cttk_i63_to_u32_trunc(const uint64_t *x);
+int32_t cttk_i63_to_s32_trunc(const uint64_t *x);
+uint64_t cttk_i63_to_u64_trunc(const uint64_t *x);
+int64_t cttk_i63_to_s64_trunc(const uint64_t *x);
+uint32_t cttk_i63_to_u32(const uint64_t *x);
+int32_t cttk_i63_to_s32(const uint64_t *x);
+uint64_t cttk_i63_to_u64(const uint64_t *x);
+int64_t cttk_i63_to_s64(const uint64_t *x);
+void cttk_i63_decbe_signed(uint64_t *x, const void *src, size_t len);
+void cttk_i63_decbe_unsigned(uint64_t *x, const void *src, size_t len);
+void cttk_i63_decbe_signed_trunc(uint64_t *x, const void *src, size_t len);
+void cttk_i63_decbe_unsigned_trunc(uint64_t *x, const void *src, size_t len);
+void cttk_i63_decle_signed(uint64_t *x, const void *src, size_t len);
+void cttk_i63_decle_unsigned(uint64_t *x, const void *src, size_t len);
+void cttk_i63_decle_signed_trunc(uint64_t *x, const void *src, size_t len);
+void cttk_i63_decle_unsigned_trunc(uint64_t *x, const void *src, size_t len);
+void cttk_i63_encbe(void *dst, size_t len, const uint64_t *x);
+void cttk_i63_encle(void *dst, size_t len, const uint64_t *x);
+cttk_bool cttk_i63_eq0(const uint64_t *x);
+cttk_bool cttk_i63_neq0(const uint64_t *x);
+cttk_bool cttk_i63_gt0(const uint64_t *x);
+cttk_bool cttk_i63_lt0(const uint64_t *x);
+cttk_bool cttk_i63_geq0(const uint64_t *x);
+cttk_bool cttk_i63_leq0(const uint64_t *x);
+cttk_bool cttk_i63_eq(const uint64_t *x, const uint64_t *y);
+cttk_bool cttk_i63_neq(const uint64_t *x, const uint64_t *y);
+cttk_bool cttk_i63_lt(const uint64_t *x, const uint64_t *y);
+cttk_bool cttk_i63_leq(const uint64_t *x, const uint64_t *y);
+cttk_bool cttk_i63_gt(const uint64_t *x, const uint64_t *y);
+cttk_bool cttk_i63_geq(const uint64_t *x, const uint64_t *y);
+int cttk_i63_sign(const uint64_t *x);
+int32_t cttk_i63_cmp(const uint64_t *x, const uint64_t *y);
+void cttk_i63_copy(uint64_t *d, const uint64_t *s);
+void cttk_i63_cond_copy(cttk_bool ctl, uint64_t *d, const uint64_t *s);
+void cttk_i63_swap(uint64_t *a, uint64_t *b);
+void cttk_i63_cond_swap(cttk_bool ctl, uint64_t *a, uint64_t *b);
+void cttk_i63_mux(cttk_bool ctl, uint64_t *d,
+	const uint64_t *a, const uint64_t *b);
+void cttk_i63_add(uint64_t *d, const uint64_t *a, const uint64_t *b);
+void cttk_i63_add_trunc(uint64_t *d, const uint64_t *a, const uint64_t *b);
+void cttk_i63_sub(uint64_t *d, const uint64_t *a, const uint64_t *b);
+void cttk_i63_sub_trunc(uint64_t *d, const uint64_t *a, const uint64_t *b);
+void cttk_i63_neg(uint64_t *d, const uint64_t *x);
+void cttk_i63_neg_trunc(uint64_t *d, const uint64_t *x);
+void cttk_i63_mul(uint64_t *d, const uint64_t *a, const uint64_t *b);
+void cttk_i63_mul_trunc(uint64_t *d, const uint64_t *a, const uint64_t *b);
+void cttk_i63_mul_ws(uint64_t *d, const uint64_t *a, const uint64_t *b,
+	uint64_t *tmp, size_t tmp_len);
+void cttk_i63_sqr(uint64_t *d, const uint64_t *a);
+void cttk_i63_sqr_trunc(uint64_t *d, const uint64_t *a);
+void cttk_i63_muladd(uint64_t *d, const uint64_t *a, const uint64_t *b,
+	const uint64_t *c);
+void cttk_i63_muladd_trunc(uint64_t *d, const uint64_t *a, const uint64_t *b,
+	const uint64_t *c);
+void cttk_i63_mul_u32(uint64_t *d, const uint64_t *a, uint32_t x);
+void cttk_i63_mul_u32_trunc(uint64_t *d, const uint64_t *a, uint32_t x);
+void cttk_i63_addmul_u32(uint64_t *d, const uint64_t *a, uint32_t x);
+void cttk_i63_addmul_u32_trunc(uint64_t *d, const uint64_t *a, uint32_t x);
+void cttk_i63_lsh(uint64_t *d, const uint64_t *a, uint32_t n);
+void cttk_i63_lsh_prot(uint64_t *d, const uint64_t *a, uint32_t n);
+void cttk_i63_lsh_trunc(uint64_t *d, const uint64_t *a, uint32_t n);
+void cttk_i63_lsh_trunc_prot(uint64_t *d, const uint64_t *a, uint32_t n);
+void cttk_i63_rsh(uint64_t *d, const uint64_t *a, uint32_t n);
+void cttk_i63_rsh_prot(uint64_t *d, const uint64_t *a, uint32_t n);
+void cttk_i63_divrem(uint64_t *q, uint64_t *r,
+	const uint64_t *a, const uint64_t *b);
+static inline void
+cttk_i63_div(uint64_t *q, const uint64_t *a, const uint64_t *b)
+{
+	cttk_i63_divrem(q, NULL, a, b);
+}
+static inline void
+cttk_i63_rem(uint64_t *r, const uint64_t *a, const uint64_t *b)
+{
+	cttk_i63_divrem(NULL, r, a, b);
+}
+void cttk_i63_mod(uint64_t *d, const uint64_t *a, const uint64_t *b);
+void cttk_i63_divrem_ws(uint64_t *q, uint64_t *r,
+	const uint64_t *a, const uint64_t *b, uint64_t *tmp, size_t tmp_len);
+void cttk_i63_mod_ws(uint64_t *d, const uint64_t *a, const uint64_t *b,
+	uint64_t *tmp, size_t tmp_len);
+size_t cttk_i63_ws_len(unsigned size);
+void cttk_i63_and(uint64_t *d, const uint64_t *a, const uint64_t *b);
+void cttk_i63_or(uint64_t *d, const uint64_t *a, const uint64_t *b);
+void cttk_i63_xor(uint64_t *d, const uint64_t *a, const uint64_t *b);
+void cttk_i63_eqv(uint64_t *d, const uint64_t *a, const uint64_t *b);
+void cttk_i63_not(uint64_t *d, const uint64_t *a);
+
+/*
+ * The "i15" implementation is similar to "i31", but with 16-bit words
+ * (uint16_t): the first word contains the integer size and the "NaN
+ * flag" (top bit), and subsequent words encode the value with 15 bits
+ * per word (the top bit is always 0). It only uses 15x15->30
+ * multiplications, and is meant for architectures where the 32x32->64
+ * multiplication is not constant-time. Since the size is encoded in
+ * the 16-bit header word, i15 integers are limited to 30719 bits.
+ */
+
+#define cttk_i15_def(name, size)       uint16_t name[((size) + 29) / 15]
+#define cttk_i15_definit(name, size)   cttk_i15_def(name, size) = { ((size) + ((size) / 15)) + 0x8000 }
+#define cttk_i15_elt   uint16_t
+void cttk_i15_init(uint16_t *x, unsigned size);
+void cttk_i15_set_u32(uint16_t *x, uint32_t v);
+void cttk_i15_set_u32_trunc(uint16_t *x, uint32_t v);
+void cttk_i15_set_u64(uint16_t *x, uint64_t v);
+void cttk_i15_set_u64_trunc(uint16_t *x, uint64_t v);
+void cttk_i15_set_s32(uint16_t *x, int32_t v);
+void cttk_i15_set_s64(uint16_t *x, int64_t v);
+void cttk_i15_set(uint16_t *d, const uint16_t *a);
+void cttk_i15_set_trunc(uint16_t *d, const uint16_t *a);
+static inline cttk_bool
+cttk_i15_isnan(const uint16_t *x)
+{
+	return cttk_bool_of_u32((uint32_t)x[0] >> 15);
+}
+uint32_t cttk_i15_to_u32_trunc(const uint16_t *x);
+int32_t cttk_i15_to_s32_trunc(const uint16_t *x);
+uint64_t cttk_i15_to_u64_trunc(const uint16_t *x);
+int64_t cttk_i15_to_s64_trunc(const uint16_t *x);
+uint32_t cttk_i15_to_u32(const uint16_t *x);
+int32_t cttk_i15_to_s32(const uint16_t *x);
+uint64_t cttk_i15_to_u64(const uint16_t *x);
+int64_t cttk_i15_to_s64(const uint16_t *x);
+void cttk_i15_decbe_signed(uint16_t *x, const void *src, size_t len);
+void cttk_i15_decbe_unsigned(uint16_t *x, const void *src, size_t len);
+void cttk_i15_decbe_signed_trunc(uint16_t *x, const void *src, size_t len);
+void cttk_i15_decbe_unsigned_trunc(uint16_t *x, const void *src, size_t len);
+void cttk_i15_decle_signed(uint16_t *x, const void *src, size_t len);
+void cttk_i15_decle_unsigned(uint16_t *x, const void *src, size_t len);
+void cttk_i15_decle_signed_trunc(uint16_t *x, const void *src, size_t len);
+void cttk_i15_decle_unsigned_trunc(uint16_t *x, const void *src, size_t len);
+void cttk_i15_encbe(void *dst, size_t len, const uint16_t *x);
+void cttk_i15_encle(void *dst, size_t len, const uint16_t *x);
+cttk_bool cttk_i15_eq0(const uint16_t *x);
+cttk_bool cttk_i15_neq0(const uint16_t *x);
+cttk_bool cttk_i15_gt0(const uint16_t *x);
+cttk_bool cttk_i15_lt0(const uint16_t *x);
+cttk_bool cttk_i15_geq0(const uint16_t *x);
+cttk_bool cttk_i15_leq0(const uint16_t *x);
+cttk_bool cttk_i15_eq(const uint16_t *x, const uint16_t *y);
+cttk_bool cttk_i15_neq(const uint16_t *x, const uint16_t *y);
+cttk_bool cttk_i15_lt(const uint16_t *x, const uint16_t *y);
+cttk_bool cttk_i15_leq(const uint16_t *x, const uint16_t *y);
+cttk_bool cttk_i15_gt(const uint16_t *x, const uint16_t *y);
+cttk_bool cttk_i15_geq(const uint16_t *x, const uint16_t *y);
+int cttk_i15_sign(const uint16_t *x);
+int32_t cttk_i15_cmp(const uint16_t *x, const uint16_t *y);
+void cttk_i15_copy(uint16_t *d, const uint16_t *s);
+void cttk_i15_cond_copy(cttk_bool ctl, uint16_t *d, const uint16_t *s);
+void cttk_i15_swap(uint16_t *a, uint16_t *b);
+void cttk_i15_cond_swap(cttk_bool ctl, uint16_t *a, uint16_t *b);
+void cttk_i15_mux(cttk_bool ctl, uint16_t *d,
+	const uint16_t *a, const uint16_t *b);
+void cttk_i15_add(uint16_t *d, const uint16_t *a, const uint16_t *b);
+void cttk_i15_add_trunc(uint16_t *d, const uint16_t *a, const uint16_t *b);
+void cttk_i15_sub(uint16_t *d, const uint16_t *a, const uint16_t *b);
+void cttk_i15_sub_trunc(uint16_t *d, const uint16_t *a, const uint16_t *b);
+void cttk_i15_neg(uint16_t *d, const uint16_t *x);
+void cttk_i15_neg_trunc(uint16_t *d, const uint16_t *x);
+void cttk_i15_mul(uint16_t *d, const uint16_t *a, const uint16_t *b);
+void cttk_i15_mul_trunc(uint16_t *d, const uint16_t *a, const uint16_t *b);
+void cttk_i15_mul_ws(uint16_t *d, const uint16_t *a, const uint16_t *b,
+	uint16_t *tmp, size_t tmp_len);
+void cttk_i15_sqr(uint16_t *d, const uint16_t *a);
+void cttk_i15_sqr_trunc(uint16_t *d, const uint16_t *a);
+void cttk_i15_muladd(uint16_t *d, const uint16_t *a, const uint16_t *b,
+	const uint16_t *c);
+void cttk_i15_muladd_trunc(uint16_t *d, const uint16_t *a, const uint16_t *b,
+	const uint16_t *c);
+void cttk_i15_mul_u32(uint16_t *d, const uint16_t *a, uint32_t x);
+void cttk_i15_mul_u32_trunc(uint16_t *d, const uint16_t *a, uint32_t x);
+void cttk_i15_addmul_u32(uint16_t *d, const uint16_t *a, uint32_t x);
+void cttk_i15_addmul_u32_trunc(uint16_t *d, const uint16_t *a, uint32_t x);
+void cttk_i15_lsh(uint16_t *d, const uint16_t *a, uint32_t n);
+void cttk_i15_lsh_prot(uint16_t *d, const uint16_t *a, uint32_t n);
+void cttk_i15_lsh_trunc(uint16_t *d, const uint16_t *a, uint32_t n);
+void cttk_i15_lsh_trunc_prot(uint16_t *d, const uint16_t *a, uint32_t n);
+void cttk_i15_rsh(uint16_t *d, const uint16_t *a, uint32_t n);
+void cttk_i15_rsh_prot(uint16_t *d, const uint16_t *a, uint32_t n);
+void cttk_i15_divrem(uint16_t *q, uint16_t *r,
+	const uint16_t *a, const uint16_t *b);
+static inline void
+cttk_i15_div(uint16_t *q, const uint16_t *a, const uint16_t *b)
+{
+	cttk_i15_divrem(q, NULL, a, b);
+}
+static inline void
+cttk_i15_rem(uint16_t *r, const uint16_t *a, const uint16_t *b)
+{
+	cttk_i15_divrem(NULL, r, a, b);
+}
+void cttk_i15_mod(uint16_t *d, const uint16_t *a, const uint16_t *b);
+void cttk_i15_divrem_ws(uint16_t *q, uint16_t *r,
+	const uint16_t *a, const uint16_t *b, uint16_t *tmp, size_t tmp_len);
+void cttk_i15_mod_ws(uint16_t *d, const uint16_t *a, const uint16_t *b,
+	uint16_t *tmp, size_t tmp_len);
+size_t cttk_i15_ws_len(unsigned size);
+void cttk_i15_and(uint16_t *d, const uint16_t *a, const uint16_t *b);
+void cttk_i15_or(uint16_t *d, const uint16_t *a, const uint16_t *b);
+void cttk_i15_xor(uint16_t *d, const uint16_t *a, const uint16_t *b);
+void cttk_i15_eqv(uint16_t *d, const uint16_t *a, const uint16_t *b);
+void cttk_i15_not(uint16_t *d, const uint16_t *a);
+
+#endif
+
+/* ==================================================================== */
+/*
+ * Modular integers (odd modulus).
+ *
+ * Modular integers are big integers (in the i31 representation) whose
+ * value is kept in the 0 to m-1 range, for a given odd modulus m > 1,
+ * in Montgomery representation: the value x is stored as x*R mod m,
+ * where R = 2^(31*len), and len is the number of 31-bit words used by
+ * the modulus. A modulus context holds the modulus and some precomputed
+ * values; all modular operations use such a context.
+ *
+ * Modular integers have the same size as the modulus (i.e. they are
+ * initialised with `cttk_i31_init()` with the same size parameter as
+ * the modulus). If an operand does not have that size, or is NaN, or
+ * the modulus context is NaN, then the result is set to NaN. Operands
+ * are assumed to be in Montgomery representation and in the 0 to m-1
+ * range; this is not verified (values obtained from these functions
+ * always fulfill that property). On operands out of that range, the
+ * results are unspecified, but the functions still run safely (with no
+ * out-of-bounds memory access).
+ *
+ * All operations are constant-time; only the sizes may leak. Unless
+ * specified otherwise, operands need not be distinct.
+ */
+
+/**
+ * \brief Define a modulus context variable or field.
+ *
+ * This macro defines a local variable or a structure field for a
+ * modulus context that can accommodate a modulus of size at most
+ * `size` bits (i.e. a modulus that is an i31 integer defined with
+ * `cttk_i31_def()` with the same `size` parameter). `size` MUST NOT be
+ * zero, and MUST be a constant expression. The context is not
+ * initialised; `cttk_m31_init()` must be used for that.
+ *
+ * \param name   name of the variable or field.
+ * \param size   maximum modulus size (in bits).
+ */
+#define cttk_m31_def(name, size)   uint32_t name[(((size) + 61) / 31) << 1]
+
+/**
+ * \brief Initialise a modulus context.
+ *
+ * The context `mc` is initialised for the modulus `m`. The context
+ * size is set to that of `m`; it must have been defined with a size
+ * parameter at least equal to that of `m`. The modulus must be odd,
+ * greater than 1, and not NaN; otherwise, the context is set to NaN.
+ *
+ * The context contains a copy of `m`: `mc` can be used with the i31
+ * functions as a read-only integer equal to `m` (with the NaN flag set
+ * if `m` was not a valid modulus).
+ *
+ * Initialisation costs about as much as a few dozen modular
+ * multiplications; context should be reused whenever possible.
+ *
+ * \param mc   modulus context to initialise.
+ * \param m    modulus.
+ */
+void cttk_m31_init(uint32_t *mc, const uint32_t *m);
+
+/**
+ * \brief Check whether a modulus context is NaN.
+ *
+ * A context is NaN if it was initialised with an invalid modulus.
+ *
+ * \param mc   modulus context.
+ * \return  true if the context is NaN.
+ */
+static inline cttk_bool
+cttk_m31_isnan(const uint32_t *mc)
+{
+	return cttk_bool_of_u32(mc[0] >> 31);
+}
+
+/**
+ * \brief Convert an integer into Montgomery representation.
+ *
+ * The integer `a`, which may have any value (including negative
+ * values) is reduced modulo m and converted to Montgomery
+ * representation; the result is written in `d`.
+ *
+ * \param d    destination modular integer.
+ * \param a    source integer.
+ * \param mc   modulus context.
+ */
+void cttk_m31_encode(uint32_t *d, const uint32_t *a, const uint32_t *mc);
+
+/**
+ * \brief Convert an integer from Montgomery representation.
+ *
+ * The modular integer `a` is converted back to normal representation;
+ * the result (in the 0 to m-1 range) is written in `d`.
+ *
+ * \param d    destination integer.
+ * \param a    source modular integer.
+ * \param mc   modulus context.
+ */
+void cttk_m31_decode(uint32_t *d, const uint32_t *a, const uint32_t *mc);
+
+/**
+ * \brief Modular addition.
+ *
+ * This function computes `a+b` modulo m, and writes the result in `d`.
+ *
+ * \param d    destination modular integer.
+ * \param a    first operand.
+ * \param b    second operand.
+ * \param mc   modulus context.
+ */
+void cttk_m31_add(uint32_t *d,
+	const uint32_t *a, const uint32_t *b, const uint32_t *mc);
+
+/**
+ * \brief Modular subtraction.
+ *
+ * This function computes `a-b` modulo m, and writes the result in `d`.
+ *
+ * \param d    destination modular integer.
+ * \param a    first operand.
+ * \param b    second operand.
+ * \param mc   modulus context.
+ */
+void cttk_m31_sub(uint32_t *d,
+	const uint32_t *a, const uint32_t *b, const uint32_t *mc);
+
+/**
+ * \brief Modular negation.
+ *
+ * This function computes `-a` modulo m, and writes the result in `d`.
+ *
+ * \param d    destination modular integer.
+ * \param a    operand.
+ * \param mc   modulus context.
+ */
+void cttk_m31_neg(uint32_t *d, const uint32_t *a, const uint32_t *mc);
+
+/**
+ * \brief Modular multiplication.
+ *
+ * This function computes `a*b` modulo m, and writes the result in `d`.
+ * This uses Montgomery multiplication, which does not involve any
+ * division.
+ *
+ * If the modulus exceeds `CTTK_MAX_INT_BUF` bytes, then a temporary
+ * buffer is dynamically allocated; if that allocation fails, then the
+ * result is set to NaN.
+ *
+ * \param d    destination modular integer.
+ * \param a    first operand.
+ * \param b    second operand.
+ * \param mc   modulus context.
+ */
+void cttk_m31_mul(uint32_t *d,
+	const uint32_t *a, const uint32_t *b, const uint32_t *mc);
+
+/**
+ * \brief Modular squaring.
+ *
+ * This function computes `a*a` modulo m, and writes the result in `d`.
+ * Rules for temporary buffers are the same as for `cttk_m31_mul()`.
+ *
+ * \param d    destination modular integer.
+ * \param a    operand.
+ * \param mc   modulus context.
+ */
+void cttk_m31_sqr(uint32_t *d, const uint32_t *a, const uint32_t *mc);
+
+/**
+ * \brief Modular exponentiation.
+ *
+ * This function computes `a^e` modulo m, and writes the result in `d`.
+ * The base `a` and the result `d` are modular integers (in Montgomery
+ * representation). The exponent `e` is a big integer (in the i31
+ * representation) of any size; it need not have the same size as the
+ * modulus. If the exponent is negative or NaN, then the result is set
+ * to NaN. By convention, `a^0 = 1` (including when `a` is zero).
+ *
+ * A fixed 4-bit window is used: the memory access pattern and the
+ * sequence of operations depend only on the sizes of the modulus and
+ * of the exponent, not on their values. The window table needs about
+ * 19 times the modulus size in temporary space; if that exceeds
+ * `CTTK_MAX_INT_BUF` bytes, then a temporary buffer is dynamically
+ * allocated. If that allocation fails (or is disabled), then a
+ * smaller window is used; if even the smallest window does not fit,
+ * then the result is set to NaN.
+ *
+ * \param d    destination modular integer.
+ * \param a    base (modular integer).
+ * \param e    exponent (big integer).
+ * \param mc   modulus context.
+ */
+void cttk_m31_pow(uint32_t *d,
+	const uint32_t *a, const uint32_t *e, const uint32_t *mc);
+
+/**
+ * \brief Modular exponentiation (exponent as bytes).
+ *
+ * This function is similar to `cttk_m31_pow()`, except that the
+ * exponent is provided as a sequence of `elen` bytes, which encode an
+ * unsigned integer in big-endian convention. The exponent bits are
+ * read directly from the buffer (this is equivalent to, but faster
+ * than, decoding the exponent with `cttk_i31_decbe_unsigned()` and
+ * calling `cttk_m31_pow()`). The exponent length (`elen`) may leak,
+ * but not the exponent value.
+ *
+ * \param d      destination modular integer.
+ * \param a      base (modular integer).
+ * \param e      exponent (unsigned big-endian).
+ * \param elen   exponent length (in bytes).
+ * \param mc     modulus context.
+ */
+void cttk_m31_pow_be(uint32_t *d,
+	const uint32_t *a, const void *e, size_t elen, const uint32_t *mc);
+
+/* ==================================================================== */
+/*
+ * Divisor contexts.
+ *
+ * A divisor context holds a divisor b (an i31 integer) and precomputed
+ * values for Barrett reduction; it is meant for repeated divisions by
+ * the same value. Contrary to modulus contexts, the divisor may have
+ * any sign and parity (but not be zero). Dividends, quotients and
+ * remainders have the same size as the divisor, and the results match
+ * those of `cttk_i31_divrem()` and `cttk_i31_mod()` exactly (same
+ * signs, same NaN rules). Each division costs about as much as two
+ * multiplications of integers of that size.
+ *
+ * All operations are constant-time; only the sizes may leak.
+ */
+
+/**
+ * \brief Define a divisor context variable or field.
+ *
+ * This macro defines a local variable or a structure field for a
+ * divisor context that can accommodate a divisor of size at most
+ * `size` bits (i.e. an i31 integer defined with `cttk_i31_def()` with
+ * the same `size` parameter). `size` MUST NOT be zero, and MUST be a
+ * constant expression. The context is not initialised;
+ * `cttk_d31_init()` must be used for that.
+ *
+ * \param name   name of the variable or field.
+ * \param size   maximum divisor size (in bits).
+ */
+#define cttk_d31_def(name, size)   uint32_t name[(((size) + 61) / 31) << 2]
+
+/**
+ * \brief Initialise a divisor context.
+ *
+ * The context `dc` is initialised for the divisor `b`. The context size
+ * is set to that of `b`; it must have been defined with a size
+ * parameter at least equal to that of `b`. If `b` is zero or NaN, then
+ * the context is set to NaN (all divisions with that context then
+ * yield NaN). `dc` and `b` MUST NOT overlap.
+ *
+ * The context contains a copy of `b`: `dc` can be used with the i31
+ * functions as a read-only integer equal to `b` (with the NaN flag set
+ * if `b` was not a valid divisor).
+ *
+ * Initialisation performs a generic division (`cttk_i31_divrem()`) of
+ * a value twice as large as the divisor, and thus costs about as much
+ * as several divisions with the context; the context should be reused
+ * as much as possible. The temporary space is about six times the
+ * divisor size; if it exceeds `CTTK_MAX_INT_BUF` bytes, then a
+ * temporary buffer is dynamically allocated; if that allocation fails,
+ * then the context is set to NaN.
+ *
+ * \param dc   divisor context to initialise.
+ * \param b    divisor.
+ */
+void cttk_d31_init(uint32_t *dc, const uint32_t *b);
+
+/**
+ * \brief Check whether a divisor context is NaN.
+ *
+ * A context is NaN if it was initialised with an invalid divisor.
+ *
+ * \param dc   divisor context.
+ * \return  true if the context is NaN.
+ */
+static inline cttk_bool
+cttk_d31_isnan(const uint32_t *dc)
+{
+	return cttk_bool_of_u32(dc[0] >> 31);
+}
+
+/**
+ * \brief Division by a divisor context.
+ *
+ * This function divides `a` by the divisor of context `dc`; quotient
+ * is written in `q`, and remainder in `r`. Either `q` or `r` may be
+ * `NULL`, but not both. Semantics are those of `cttk_i31_divrem()`:
+ * the quotient is rounded towards zero, and the remainder has the sign
+ * of the dividend. The quotient is NaN for the division of the
+ * minimal value by -1.
+ *
+ * If `a`, `q` or `r` does not have the size of the divisor, or if `a`
+ * or the context is NaN, then the results are set to NaN. `q` and `r`
+ * MUST be distinct, and distinct from the context; either may be the
+ * same array as `a`. The temporary space is about ten times the divisor
+ * size; if it exceeds `CTTK_MAX_INT_BUF` bytes, then a temporary buffer
+ * is dynamically allocated; if that allocation fails, then the results
+ * are set to NaN.
+ *
+ * \param q    recipient for the quotient (or `NULL`).
+ * \param r    recipient for the remainder (or `NULL`).
+ * \param a    dividend.
+ * \param dc   divisor context.
+ */
+void cttk_d31_divrem(uint32_t *q, uint32_t *r,
+	const uint32_t *a, const uint32_t *dc);
+
+/**
+ * \brief Division by a divisor context (quotient-only).
+ *
+ * This function simply calls `cttk_d31_divrem()` with a remainder set
+ * to `NULL`.
+ *
+ * \param q    recipient for the quotient.
+ * \param a    dividend.
+ * \param dc   divisor context.
+ */
+static inline void
+cttk_d31_div(uint32_t *q, const uint32_t *a, const uint32_t *dc)
+{
+	cttk_d31_divrem(q, NULL, a, dc);
+}
+
+/**
+ * \brief Division by a divisor context (remainder-only).
+ *
+ * This function simply calls `cttk_d31_divrem()` with a quotient set
+ * to `NULL`.
+ *
+ * \param r    recipient for the remainder.
+ * \param a    dividend.
+ * \param dc   divisor context.
+ */
+static inline void
+cttk_d31_rem(uint32_t *r, const uint32_t *a, const uint32_t *dc)
+{
+	cttk_d31_divrem(NULL, r, a, dc);
+}
+
+/**
+ * \brief Modular reduction by a divisor context.
+ *
+ * This function reduces `a` modulo the divisor of context `dc`; the
+ * result is written in `d`, and is always nonnegative and lower than
+ * the absolute value of the divisor, as with `cttk_i31_mod()`. Rules
+ * for sizes, NaN and temporary buffers are those of `cttk_d31_divrem()`.
+ *
+ * \param d    recipient for the modular reduction result.
+ * \param a    dividend.
+ * \param dc   divisor context.
+ */
+void cttk_d31_mod(uint32_t *d, const uint32_t *a, const uint32_t *dc);
+
+/* ==================================================================== */
+/*
+ * Batches of big integers.
+ *
+ * A batch holds `num` big integers ("lanes") of the same size, in the
+ * i31 representation, with a "structure of arrays" layout: the words
+ * of the same rank of all lanes are consecutive in memory. This allows
+ * processing several lanes in parallel with SIMD instructions (AVX2 on
+ * x86), which makes batches faster than individual i31
+ * integers when many independent, identical computations must be
+ * performed.
+ *
+ * Each lane has its own NaN flag, with the same semantics as those of
+ * individual i31 integers. Operations apply to all lanes of their
+ * operands, which must have the same size and the same number of
+ * lanes as the destination; otherwise, all lanes of the destination
+ * are set to NaN. Contents of a batch can be transferred to and from
+ * individual i31 integers with `cttk_i31_batch_set()` and
+ * `cttk_i31_batch_get()`.
+ *
+ * All operations are constant-time; only the sizes and the number of
+ * lanes may leak. Operands need not be distinct.
+ */
+
+/**
+ * \brief Define a batch variable or field.
+ *
+ * This macro defines a local variable or a structure field for a batch
+ * of `num` big integers of size `size` bits. `size` MUST NOT be zero;
+ * `size` and `num` MUST be constant expressions. The batch is not
+ * initialised; `cttk_i31_batch_init()` must be used for that.
+ *
+ * For dynamically allocated batches, the needed number of 32-bit words
+ * is `2 + num * ((size + 61) / 31)`.
+ *
+ * \param name   name of the variable or field.
+ * \param size   lane size (in bits).
+ * \param num    number of lanes.
+ */
+#define cttk_i31_batch_def(name, size, num) \
+	uint32_t name[2 + (num) * (((size) + 61) / 31)]
+
+/**
+ * \brief Initialise a batch.
+ *
+ * The batch `b` is set to contain `num` lanes of size `size` bits. All
+ * lanes are set to NaN. `size` MUST NOT be zero.
+ *
+ * \param b      batch to initialise.
+ * \param size   lane size (in bits).
+ * \param num    number of lanes.
+ */
+void cttk_i31_batch_init(uint32_t *b, unsigned size, size_t num);
+
+/**
+ * \brief Set a batch lane from an integer.
+ *
+ * The integer `x` (in the i31 representation) is copied into lane
+ * `idx` of the batch `b`, including its NaN flag. If `x` does not
+ * have the lane size, then the lane is set to NaN. If `idx` is not
+ * lower than the number of lanes, then nothing happens.
+ *
+ * \param b     batch to modify.
+ * \param idx   lane index.
+ * \param x     source integer.
+ */
+void cttk_i31_batch_set(uint32_t *b, size_t idx, const uint32_t *x);
+
+/**
+ * \brief Get a batch lane into an integer.
+ *
+ * Lane `idx` of the batch `b` is copied into the integer `x`, which
+ * must have been initialised with the lane size. If `x` does not have
+ * the lane size, or `idx` is not lower than the number of lanes, then
+ * `x` is set to NaN.
+ *
+ * \param x     destination integer.
+ * \param b     source batch.
+ * \param idx   lane index.
+ */
+void cttk_i31_batch_get(uint32_t *x, const uint32_t *b, size_t idx);
+
+/**
+ * \brief Lane-wise addition.
+ *
+ * Each lane of `d` receives the sum of the corresponding lanes of `a`
+ * and `b`; on overflow, the lane is set to NaN (as with
+ * `cttk_i31_add()`).
+ *
+ * \param d   destination batch.
+ * \param a   first operand.
+ * \param b   second operand.
+ */
+void cttk_i31_batch_add(uint32_t *d, const uint32_t *a, const uint32_t *b);
+
+/**
+ * \brief Lane-wise addition (with truncation).
+ *
+ * This function is similar to `cttk_i31_batch_add()`, except that
+ * results are truncated to the lane size (as with
+ * `cttk_i31_add_trunc()`).
+ *
+ * \param d   destination batch.
+ * \param a   first operand.
+ * \param b   second operand.
+ */
+void cttk_i31_batch_add_trunc(uint32_t *d,
+	const uint32_t *a, const uint32_t *b);
+
+/**
+ * \brief Lane-wise subtraction.
+ *
+ * Each lane of `d` receives the difference of the corresponding lanes
+ * of `a` and `b`; on overflow, the lane is set to NaN (as with
+ * `cttk_i31_sub()`).
+ *
+ * \param d   destination batch.
+ * \param a   first operand.
+ * \param b   second operand.
+ */
+void cttk_i31_batch_sub(uint32_t *d, const uint32_t *a, const uint32_t *b);
+
+/**
+ * \brief Lane-wise subtraction (with truncation).
+ *
+ * This function is similar to `cttk_i31_batch_sub()`, except that
+ * results are truncated to the lane size (as with
+ * `cttk_i31_sub_trunc()`).
+ *
+ * \param d   destination batch.
+ * \param a   first operand.
+ * \param b   second operand.
+ */
+void cttk_i31_batch_sub_trunc(uint32_t *d,
+	const uint32_t *a, const uint32_t *b);
+
+/**
+ * \brief Lane-wise multiplication.
+ *
+ * Each lane of `d` receives the product of the corresponding lanes of
+ * `a` and `b`; on overflow, the lane is set to NaN (as with
+ * `cttk_i31_mul()`).
+ *
+ * A temporary buffer of about 16 bytes per 31 bits of lane size is
+ * used. If it exceeds `CTTK_MAX_INT_BUF` bytes, then it is dynamically
+ * allocated; if that allocation fails, then lanes are processed one by
+ * one (without SIMD), or set to NaN if the lane size exceeds about
+ * `CTTK_MAX_INT_BUF*31/4` bits.
+ *
+ * \param d   destination batch.
+ * \param a   first operand.
+ * \param b   second operand.
+ */
+void cttk_i31_batch_mul(uint32_t *d, const uint32_t *a, const uint32_t *b);
+
+/**
+ * \brief Lane-wise multiplication (with truncation).
+ *
+ * This function is similar to `cttk_i31_batch_mul()`, except that
+ * results are truncated to the lane size (as with
+ * `cttk_i31_mul_trunc()`).
+ *
+ * \param d   destination batch.
+ * \param a   first operand.
+ * \param b   second operand.
+ */
+void cttk_i31_batch_mul_trunc(uint32_t *d,
+	const uint32_t *a, const uint32_t *b);
+
+/**
+ * \brief Lane-wise comparison.
+ *
+ * For each lane index `i`, `r[i]` is set to -1, 0 or 1, depending on
+ * whether lane `i` of `a` is lower than, equal to, or greater than lane
+ * `i` of `b`. If either lane is NaN, then `r[i]` is set to 0. If the
+ * batches do not have the same size or number of lanes, then all
+ * values are set to 0. `r` must have room for as many values as `a` has
+ * lanes.
+ *
+ * \param r   destination array for the comparison results.
+ * \param a   first operand.
+ * \param b   second operand.
+ */
+void cttk_i31_batch_cmp(int32_t *r, const uint32_t *a, const uint32_t *b);
+
+/**
+ * \brief Lane-wise conditional copy.
+ *
+ * For each lane index `i`, if `ctl[i]` is true, then lane `i` of `s`
+ * is copied into lane `i` of `d`; otherwise, that lane of `d` is
+ * unmodified. `ctl` must contain as many values as `d` has lanes.
+ *
+ * \param ctl   copy control values.
+ * \param d     destination batch.
+ * \param s     source batch.
+ */
+void cttk_i31_batch_cond_copy(const cttk_bool *ctl,
+	uint32_t *d, const uint32_t *s);
 
 /* ==================================================================== */
 
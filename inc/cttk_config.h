@@ -0,0 +1,121 @@
+/*
+ * Copyright (c) 2018 Thomas Pornin <pornin@bolet.org>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining 
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be 
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, 
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND 
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef CTTK_CONFIG_H__
+#define CTTK_CONFIG_H__
+
+/*
+ * This file contains the compile-time flags that must have the same
+ * value in the library and in the application code: they are used by
+ * the library internals, and by cttk.h (which includes this file) to
+ * select the big integer implementation behind the generic cti_*
+ * macros. The other options are in src/config.h.
+ *
+ * These macros are "flags" which have three settings:
+ *
+ *  - Enabled: value should be defined to 1.
+ *  - Disabled: value should be defined to 0.
+ *  - Autodetection: value should be undefined, allowing the default
+ *    behaviour to take place.
+ *
+ * They may be set in this file, or on the command line; in the latter
+ * case, the same setting must be used when compiling the library and
+ * when compiling the application.
+ */
+
+/*
+ * If CTTK_CTMUL is set, then this is equivalent to setting all
+ * of the following flags to the same value:
+ *    CTTK_CTMUL32
+ *    CTTK_CTMULU32W
+ *    CTTK_CTMULS32W
+ *    CTTK_CTMUL64
+ * These flags can still be set individually, and will then override
+ * the CTTK_CTMUL value.
+ *
+#define CTTK_CTMUL   1
+ */
+
+/*
+ * If CTTK_CTMUL32 is set, then the 32-bit multiplication opcode (with
+ * 32-bit result) is assumed to be constant-time.
+ *
+#define CTTK_CTMUL32   1
+ */
+
+/*
+ * If CTTK_CTMULU32W is set, then the 32x32->64 unsigned multiplication
+ * is assumed to be constant-time.
+ * If it is explicitly disabled (defined to 0), then the generic big
+ * integer macros (cti_*) use the "i15" implementation by default, which
+ * needs only the 32x32->32 multiplication (see CTTK_CTMUL32).
+ *
+#define CTTK_CTMULU32W   1
+ */
+
+/*
+ * If CTTK_CTMULS32W is set, then the 32x32->64 signed multiplication
+ * is assumed to be constant-time.
+ *
+#define CTTK_CTMULS32W   1
+ */
+
+/*
+ * If CTTK_CTMUL64 is set, then the 64-bit multiplication opcode (with
+ * 64-bit result) is assumed to be constant-time. The 64x64->128
+ * multiplication (used by the i63 big integers) is then also assumed
+ * to be constant-time, when the compiler provides it (with the
+ * 'unsigned __int128' type, or the _umul128() intrinsic on MSVC/x64).
+ *
+ * When neither CTTK_CTMUL64 nor CTTK_CTMUL is defined, CTTK_CTMUL64
+ * defaults to 1 on 64-bit targets where the compiler provides the
+ * native 64x64->128 multiplication; the cti_* macros then use the
+ * "i63" implementation. Define it to 0 to use the emulated (slower,
+ * but safe) multiplications, and the "i31" implementation, instead.
+ *
+#define CTTK_CTMUL64   1
+ */
+
+#ifdef CTTK_CTMUL
+#ifndef CTTK_CTMUL32
+#define CTTK_CTMUL32     CTTK_CTMUL
+#endif
+#ifndef CTTK_CTMULU32W
+#define CTTK_CTMULU32W   CTTK_CTMUL
+#endif
+#ifndef CTTK_CTMULS32W
+#define CTTK_CTMULS32W   CTTK_CTMUL
+#endif
+#ifndef CTTK_CTMUL64
+#define CTTK_CTMUL64     CTTK_CTMUL
+#endif
+#endif
+
+#ifndef CTTK_CTMUL64
+#if defined __SIZEOF_INT128__ || (defined _MSC_VER && defined _M_X64)
+#define CTTK_CTMUL64   1
+#endif
+#endif
+
+#endif
@@ -30,6 +30,9 @@ OBJDIR = $(BUILD)$Pobj
 CTTKLIB = $(BUILD)$P$(LP)cttk$L
 CTTKDLL = $(BUILD)$P$(DP)cttk$D
 TESTCTTK = $(BUILD)$Ptestcttk$E
+SPEEDCTTK = $(BUILD)$Pspeedcttk$E
+CTCHECK = $(BUILD)$Pctcheck$E
+BSGEN = $(BUILD)$Pbsgen$E
 INCFLAGS = -Isrc -Iinc
 STATICLIB = lib
 DLL = dll
@@ -2,13 +2,39 @@
 
 OBJ = \
  $(OBJDIR)$Pbase64$O \
+ $(OBJDIR)$Pbatch31$O \
+ $(OBJDIR)$Pbitslice$O \
+ $(OBJDIR)$Pcpu$O \
+ $(OBJDIR)$Pdiv31$O \
  $(OBJDIR)$Phex$O \
+ $(OBJDIR)$Pint15$O \
  $(OBJDIR)$Pint31$O \
+ $(OBJDIR)$Pint31dec$O \
+ $(OBJDIR)$Pint31fx$O \
+ $(OBJDIR)$Pint31gcd$O \
+ $(OBJDIR)$Pint63$O \
+ $(OBJDIR)$Pmod31$O \
  $(OBJDIR)$Pmul$O \
- $(OBJDIR)$Poram1$O
+ $(OBJDIR)$Pomap$O \
+ $(OBJDIR)$Poram1$O \
+ $(OBJDIR)$Poram2$O \
+ $(OBJDIR)$Psort$O \
+ $(OBJDIR)$Pstats$O
 OBJTESTCTTK = \
  $(OBJDIR)$Ptestcttk$O
-HEADERSPUB = inc$Pcttk.h
+OBJSPEEDCTTK = \
+ $(OBJDIR)$Pspeedcttk$O
+OBJCTCHECK = \
+ $(OBJDIR)$Pctcheck$O
+OBJBSGEN = \
+ $(OBJDIR)$Pbsgen$O
+OBJBSTEST = \
+ $(OBJDIR)$Pbs_add4_64$O \
+ $(OBJDIR)$Pbs_aes_sbox_32$O \
+ $(OBJDIR)$Pbs_aes_sbox_64$O \
+ $(OBJDIR)$Pbs_aes_sbox_128$O \
+ $(OBJDIR)$Pbs_aes_sbox_256$O
+HEADERSPUB = inc$Pcttk.h inc$Pcttk_config.h
 HEADERSPRIV = $(HEADERSPUB) src$Pconfig.h src$Pinner.h
 
 all: $(STATICLIB) $(DLL) $(TESTS)
@@ -19,11 +45,19 @@ lib: $(CTTKLIB)
 
 dll: $(CTTKDLL)
 
-tests: $(TESTCTTK)
+tests: $(TESTCTTK) $(SPEEDCTTK) $(CTCHECK)
+
+bsgen: $(BSGEN)
+
+speed: $(SPEEDCTTK)
+
+ctcheck: $(CTCHECK)
+	$(CTCHECK)
 
 clean:
-	-$(RM) $(OBJDIR)$P*$O
-	-$(RM) $(CTTKLIB) $(CTTKDLL) $(TESTCTTK)
+	-$(RM) $(OBJDIR)$P*$O $(OBJDIR)$P*.c
+	-$(RM) $(CTTKLIB) $(CTTKDLL) $(TESTCTTK) $(SPEEDCTTK) $(CTCHECK)
+	-$(RM) $(BSGEN)
 
 $(OBJDIR):
 	-$(MKDIR) $(OBJDIR)
@@ -34,23 +68,113 @@ $(CTTKLIB): $(OBJDIR) $(OBJ)
 $(CTTKDLL): $(OBJDIR) $(OBJ)
 	$(LDDLL) $(LDDLLFLAGS) $(LDDLLOUT)$(CTTKDLL) $(OBJ)
 
-$(TESTCTTK): $(CTTKLIB) $(OBJTESTCTTK)
-	$(LD) $(LDFLAGS) $(LDOUT)$(TESTCTTK) $(OBJTESTCTTK) $(CTTKLIB)
+$(TESTCTTK): $(CTTKLIB) $(OBJTESTCTTK) $(OBJBSTEST)
+	$(LD) $(LDFLAGS) $(LDOUT)$(TESTCTTK) $(OBJTESTCTTK) $(OBJBSTEST) $(CTTKLIB)
+
+$(SPEEDCTTK): $(CTTKLIB) $(OBJSPEEDCTTK) $(OBJBSTEST)
+	$(LD) $(LDFLAGS) $(LDOUT)$(SPEEDCTTK) $(OBJSPEEDCTTK) $(OBJBSTEST) $(CTTKLIB)
+
+$(CTCHECK): $(CTTKLIB) $(OBJCTCHECK)
+	$(LD) $(LDFLAGS) $(LDOUT)$(CTCHECK) $(OBJCTCHECK) $(CTTKLIB)
+
+$(BSGEN): $(OBJDIR) $(OBJBSGEN)
+	$(HOSTLD) $(HOSTLDFLAGS) $(HOSTLDOUT)$(BSGEN) $(OBJBSGEN)
 
 $(OBJDIR)$Pbase64$O: src$Pbase64.c $(HEADERSPRIV)
 	$(CC) $(CFLAGS) $(INCFLAGS) $(CCOUT)$(OBJDIR)$Pbase64$O src$Pbase64.c
 
+$(OBJDIR)$Pbatch31$O: src$Pbatch31.c $(HEADERSPRIV)
+	$(CC) $(CFLAGS) $(INCFLAGS) $(CCOUT)$(OBJDIR)$Pbatch31$O src$Pbatch31.c
+
+$(OBJDIR)$Pbitslice$O: src$Pbitslice.c $(HEADERSPRIV)
+	$(CC) $(CFLAGS) $(INCFLAGS) $(CCOUT)$(OBJDIR)$Pbitslice$O src$Pbitslice.c
+
+$(OBJDIR)$Pcpu$O: src$Pcpu.c $(HEADERSPRIV)
+	$(CC) $(CFLAGS) $(INCFLAGS) $(CCOUT)$(OBJDIR)$Pcpu$O src$Pcpu.c
+
+$(OBJDIR)$Pdiv31$O: src$Pdiv31.c $(HEADERSPRIV)
+	$(CC) $(CFLAGS) $(INCFLAGS) $(CCOUT)$(OBJDIR)$Pdiv31$O src$Pdiv31.c
+
 $(OBJDIR)$Phex$O: src$Phex.c $(HEADERSPRIV)
 	$(CC) $(CFLAGS) $(INCFLAGS) $(CCOUT)$(OBJDIR)$Phex$O src$Phex.c
 
+$(OBJDIR)$Pint15$O: src$Pint15.c $(HEADERSPRIV)
+	$(CC) $(CFLAGS) $(INCFLAGS) $(CCOUT)$(OBJDIR)$Pint15$O src$Pint15.c
+
 $(OBJDIR)$Pint31$O: src$Pint31.c $(HEADERSPRIV)
 	$(CC) $(CFLAGS) $(INCFLAGS) $(CCOUT)$(OBJDIR)$Pint31$O src$Pint31.c
 
+$(OBJDIR)$Pint31dec$O: src$Pint31dec.c $(HEADERSPRIV)
+	$(CC) $(CFLAGS) $(INCFLAGS) $(CCOUT)$(OBJDIR)$Pint31dec$O src$Pint31dec.c
+
+$(OBJDIR)$Pint31fx$O: src$Pint31fx.c $(HEADERSPRIV)
+	$(CC) $(CFLAGS) $(INCFLAGS) $(CCOUT)$(OBJDIR)$Pint31fx$O src$Pint31fx.c
+
+$(OBJDIR)$Pint31gcd$O: src$Pint31gcd.c $(HEADERSPRIV)
+	$(CC) $(CFLAGS) $(INCFLAGS) $(CCOUT)$(OBJDIR)$Pint31gcd$O src$Pint31gcd.c
+
+$(OBJDIR)$Pint63$O: src$Pint63.c $(HEADERSPRIV)
+	$(CC) $(CFLAGS) $(INCFLAGS) $(CCOUT)$(OBJDIR)$Pint63$O src$Pint63.c
+
+$(OBJDIR)$Pmod31$O: src$Pmod31.c $(HEADERSPRIV)
+	$(CC) $(CFLAGS) $(INCFLAGS) $(CCOUT)$(OBJDIR)$Pmod31$O src$Pmod31.c
+
 $(OBJDIR)$Pmul$O: src$Pmul.c $(HEADERSPRIV)
 	$(CC) $(CFLAGS) $(INCFLAGS) $(CCOUT)$(OBJDIR)$Pmul$O src$Pmul.c
 
+$(OBJDIR)$Pomap$O: src$Pomap.c $(HEADERSPRIV)
+	$(CC) $(CFLAGS) $(INCFLAGS) $(CCOUT)$(OBJDIR)$Pomap$O src$Pomap.c
+
 $(OBJDIR)$Poram1$O: src$Poram1.c $(HEADERSPRIV)
 	$(CC) $(CFLAGS) $(INCFLAGS) $(CCOUT)$(OBJDIR)$Poram1$O src$Poram1.c
 
+$(OBJDIR)$Poram2$O: src$Poram2.c $(HEADERSPRIV)
+	$(CC) $(CFLAGS) $(INCFLAGS) $(CCOUT)$(OBJDIR)$Poram2$O src$Poram2.c
+
+$(OBJDIR)$Psort$O: src$Psort.c $(HEADERSPRIV)
+	$(CC) $(CFLAGS) $(INCFLAGS) $(CCOUT)$(OBJDIR)$Psort$O src$Psort.c
+
+$(OBJDIR)$Pstats$O: src$Pstats.c $(HEADERSPRIV)
+	$(CC) $(CFLAGS) $(INCFLAGS) $(CCOUT)$(OBJDIR)$Pstats$O src$Pstats.c
+
 $(OBJDIR)$Ptestcttk$O: test$Ptestcttk.c $(HEADERSPRIV)
 	$(CC) $(CFLAGS) $(INCFLAGS) $(CCOUT)$(OBJDIR)$Ptestcttk$O test$Ptestcttk.c
+
+$(OBJDIR)$Pspeedcttk$O: test$Pspeedcttk.c $(HEADERSPRIV)
+	$(CC) $(CFLAGS) $(INCFLAGS) $(CCOUT)$(OBJDIR)$Pspeedcttk$O test$Pspeedcttk.c
+
+$(OBJDIR)$Pctcheck$O: test$Pctcheck.c $(HEADERSPRIV)
+	$(CC) $(CFLAGS) $(INCFLAGS) $(CCOUT)$(OBJDIR)$Pctcheck$O test$Pctcheck.c
+
+$(OBJDIR)$Pbsgen$O: tools$Pbsgen.c
+	$(HOSTCC) $(HOSTCFLAGS) $(HOSTCCOUT)$(OBJDIR)$Pbsgen$O tools$Pbsgen.c
+
+$(OBJDIR)$Pbs_add4_64.c: $(BSGEN) test$Padd4.bs
+	$(BSGEN) -w 64 -n bs_add4_64 -o $(OBJDIR)$Pbs_add4_64.c test$Padd4.bs
+
+$(OBJDIR)$Pbs_add4_64$O: $(OBJDIR)$Pbs_add4_64.c $(HEADERSPUB)
+	$(CC) $(CFLAGS) $(INCFLAGS) $(CCOUT)$(OBJDIR)$Pbs_add4_64$O $(OBJDIR)$Pbs_add4_64.c
+
+$(OBJDIR)$Pbs_aes_sbox_32.c: $(BSGEN) test$Paes_sbox.bs
+	$(BSGEN) -w 32 -n bs_aes_sbox_32 -o $(OBJDIR)$Pbs_aes_sbox_32.c test$Paes_sbox.bs
+
+$(OBJDIR)$Pbs_aes_sbox_32$O: $(OBJDIR)$Pbs_aes_sbox_32.c $(HEADERSPUB)
+	$(CC) $(CFLAGS) $(INCFLAGS) $(CCOUT)$(OBJDIR)$Pbs_aes_sbox_32$O $(OBJDIR)$Pbs_aes_sbox_32.c
+
+$(OBJDIR)$Pbs_aes_sbox_64.c: $(BSGEN) test$Paes_sbox.bs
+	$(BSGEN) -w 64 -n bs_aes_sbox_64 -o $(OBJDIR)$Pbs_aes_sbox_64.c test$Paes_sbox.bs
+
+$(OBJDIR)$Pbs_aes_sbox_64$O: $(OBJDIR)$Pbs_aes_sbox_64.c $(HEADERSPUB)
+	$(CC) $(CFLAGS) $(INCFLAGS) $(CCOUT)$(OBJDIR)$Pbs_aes_sbox_64$O $(OBJDIR)$Pbs_aes_sbox_64.c
+
+$(OBJDIR)$Pbs_aes_sbox_128.c: $(BSGEN) test$Paes_sbox.bs
+	$(BSGEN) -w 128 -n bs_aes_sbox_128 -o $(OBJDIR)$Pbs_aes_sbox_128.c test$Paes_sbox.bs
+
+$(OBJDIR)$Pbs_aes_sbox_128$O: $(OBJDIR)$Pbs_aes_sbox_128.c $(HEADERSPUB)
+	$(CC) $(CFLAGS) $(INCFLAGS) $(CCOUT)$(OBJDIR)$Pbs_aes_sbox_128$O $(OBJDIR)$Pbs_aes_sbox_128.c
+
+$(OBJDIR)$Pbs_aes_sbox_256.c: $(BSGEN) test$Paes_sbox.bs
+	$(BSGEN) -w 256 -n bs_aes_sbox_256 -o $(OBJDIR)$Pbs_aes_sbox_256.c test$Paes_sbox.bs
+
+$(OBJDIR)$Pbs_aes_sbox_256$O: $(OBJDIR)$Pbs_aes_sbox_256.c $(HEADERSPUB)
+	$(CC) $(CFLAGS) $(INCFLAGS) $(CCOUT)$(OBJDIR)$Pbs_aes_sbox_256$O $(OBJDIR)$Pbs_aes_sbox_256.c
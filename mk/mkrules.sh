@@ -50,18 +50,55 @@ set -e
 # Source files. Please keep in alphabetical order.
 coresrc=" \
 	src/base64.c \
+	src/batch31.c \
+	src/bitslice.c \
+	src/cpu.c \
+	src/div31.c \
 	src/hex.c \
+	src/int15.c \
 	src/int31.c \
+	src/int31dec.c \
+	src/int31fx.c \
+	src/int31gcd.c \
+	src/int63.c \
+	src/mod31.c \
 	src/mul.c \
-	src/oram1.c"
+	src/omap.c \
+	src/oram1.c \
+	src/oram2.c \
+	src/sort.c \
+	src/stats.c"
 
 # Source files the the 'testcttk' command-line tool.
 testcttksrc=" \
 	test/testcttk.c"
 
+# Source files for the 'speedcttk' command-line tool.
+speedcttksrc=" \
+	test/speedcttk.c"
+
+# Source files for the 'ctcheck' command-line tool.
+ctchecksrc=" \
+	test/ctcheck.c"
+
+# Source files for the 'bsgen' command-line tool.
+bsgensrc=" \
+	tools/bsgen.c"
+
+# Bitsliced functions generated with 'bsgen' for the test tools. Each
+# entry is 'file:width'; for 'test/foo.bs', the generated function is
+# 'bs_foo_<width>'.
+bstest=" \
+	test/add4.bs:64 \
+	test/aes_sbox.bs:32 \
+	test/aes_sbox.bs:64 \
+	test/aes_sbox.bs:128 \
+	test/aes_sbox.bs:256"
+
 # Public header files.
 headerspub=" \
-	inc/cttk.h"
+	inc/cttk.h \
+	inc/cttk_config.h"
 
 # Private header files.
 headerspriv=" \
@@ -87,6 +124,22 @@ printf "\nOBJTESTCTTK ="
 for f in $testcttksrc ; do
 	printf ' \\\n $(OBJDIR)$P%s' "$(basename "$f" .c)\$O"
 done
+printf "\nOBJSPEEDCTTK ="
+for f in $speedcttksrc ; do
+	printf ' \\\n $(OBJDIR)$P%s' "$(basename "$f" .c)\$O"
+done
+printf "\nOBJCTCHECK ="
+for f in $ctchecksrc ; do
+	printf ' \\\n $(OBJDIR)$P%s' "$(basename "$f" .c)\$O"
+done
+printf "\nOBJBSGEN ="
+for f in $bsgensrc ; do
+	printf ' \\\n $(OBJDIR)$P%s' "$(basename "$f" .c)\$O"
+done
+printf "\nOBJBSTEST ="
+for e in $bstest ; do
+	printf ' \\\n $(OBJDIR)$P%s' "bs_$(basename "${e%:*}" .bs)_${e##*:}\$O"
+done
 printf "\nHEADERSPUB ="
 for f in $headerspub ; do
 	printf " %s" "$(escsep "$f")"
@@ -107,11 +160,19 @@ lib: \$(CTTKLIB)
 
 dll: \$(CTTKDLL)
 
-tests: \$(TESTCTTK)
+tests: \$(TESTCTTK) \$(SPEEDCTTK) \$(CTCHECK)
+
+bsgen: \$(BSGEN)
+
+speed: \$(SPEEDCTTK)
+
+ctcheck: \$(CTCHECK)
+	\$(CTCHECK)
 
 clean:
-	-\$(RM) \$(OBJDIR)\$P*\$O
-	-\$(RM) \$(CTTKLIB) \$(CTTKDLL) \$(TESTCTTK)
+	-\$(RM) \$(OBJDIR)\$P*\$O \$(OBJDIR)\$P*.c
+	-\$(RM) \$(CTTKLIB) \$(CTTKDLL) \$(TESTCTTK) \$(SPEEDCTTK) \$(CTCHECK)
+	-\$(RM) \$(BSGEN)
 
 \$(OBJDIR):
 	-\$(MKDIR) \$(OBJDIR)
@@ -122,8 +183,17 @@ clean:
 \$(CTTKDLL): \$(OBJDIR) \$(OBJ)
 	\$(LDDLL) \$(LDDLLFLAGS) \$(LDDLLOUT)\$(CTTKDLL) \$(OBJ)
 
-\$(TESTCTTK): \$(CTTKLIB) \$(OBJTESTCTTK)
-	\$(LD) \$(LDFLAGS) \$(LDOUT)\$(TESTCTTK) \$(OBJTESTCTTK) \$(CTTKLIB)
+\$(TESTCTTK): \$(CTTKLIB) \$(OBJTESTCTTK) \$(OBJBSTEST)
+	\$(LD) \$(LDFLAGS) \$(LDOUT)\$(TESTCTTK) \$(OBJTESTCTTK) \$(OBJBSTEST) \$(CTTKLIB)
+
+\$(SPEEDCTTK): \$(CTTKLIB) \$(OBJSPEEDCTTK) \$(OBJBSTEST)
+	\$(LD) \$(LDFLAGS) \$(LDOUT)\$(SPEEDCTTK) \$(OBJSPEEDCTTK) \$(OBJBSTEST) \$(CTTKLIB)
+
+\$(CTCHECK): \$(CTTKLIB) \$(OBJCTCHECK)
+	\$(LD) \$(LDFLAGS) \$(LDOUT)\$(CTCHECK) \$(OBJCTCHECK) \$(CTTKLIB)
+
+\$(BSGEN): \$(OBJDIR) \$(OBJBSGEN)
+	\$(HOSTLD) \$(HOSTLDFLAGS) \$(HOSTLDOUT)\$(BSGEN) \$(OBJBSGEN)
 EOF
 
 (for f in $coresrc ; do
@@ -132,8 +202,24 @@ EOF
 	printf '\n$(OBJDIR)$P%s: %s $(HEADERSPRIV)\n\t$(CC) $(CFLAGS) $(INCFLAGS) $(CCOUT)$(OBJDIR)$P%s %s\n' "$b" "$g" "$b" "$g"
 done
 
-for f in $testcttksrc ; do
+for f in $testcttksrc $speedcttksrc $ctchecksrc ; do
 	b="$(basename "$f" .c)\$O"
 	g="$(escsep "$f")"
 	printf '\n$(OBJDIR)$P%s: %s $(HEADERSPRIV)\n\t$(CC) $(CFLAGS) $(INCFLAGS) $(CCOUT)$(OBJDIR)$P%s %s\n' "$b" "$g" "$b" "$g"
+done
+
+# 'bsgen' runs during the build, hence it is compiled for the host.
+for f in $bsgensrc ; do
+	b="$(basename "$f" .c)\$O"
+	g="$(escsep "$f")"
+	printf '\n$(OBJDIR)$P%s: %s\n\t$(HOSTCC) $(HOSTCFLAGS) $(HOSTCCOUT)$(OBJDIR)$P%s %s\n' "$b" "$g" "$b" "$g"
+done
+
+for e in $bstest ; do
+	f="${e%:*}"
+	w="${e##*:}"
+	n="bs_$(basename "$f" .bs)_$w"
+	g="$(escsep "$f")"
+	printf '\n$(OBJDIR)$P%s.c: $(BSGEN) %s\n\t$(BSGEN) -w %s -n %s -o $(OBJDIR)$P%s.c %s\n' "$n" "$g" "$w" "$n" "$n" "$g"
+	printf '\n$(OBJDIR)$P%s$O: $(OBJDIR)$P%s.c $(HEADERSPUB)\n\t$(CC) $(CFLAGS) $(INCFLAGS) $(CCOUT)$(OBJDIR)$P%s$O $(OBJDIR)$P%s.c\n' "$n" "$n" "$n" "$n"
 done) >> Rules.mk
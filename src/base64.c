@@ -45,40 +45,778 @@ b64val(char c)
 	return (int)z - 1;
 }
 
-/* see cttk.h */
-size_t
-cttk_b64tobin_gen(void *dst, size_t dst_len,
-	const char *src, size_t src_len, const char **err, unsigned flags)
+static char
+b64char(uint32_t x)
+{
+	/*
+	 * Values 0 to 25 map to 0x41..0x5A ('A' to 'Z')
+	 * Values 26 to 51 map to 0x61..0x7A ('a' to 'z')
+	 * Values 52 to 61 map to 0x30..0x39 ('0' to '9')
+	 * Value 62 maps to 0x2B ('+')
+	 * Value 63 maps to 0x2F ('/')
+	 */
+	uint32_t a, b, c;
+
+	a = x - 26;
+	b = x - 52;
+	c = x - 62;
+
+	/*
+	 * Looking at bits 8..15 of values a, b and c:
+	 *
+	 *     x       a   b   c
+	 *  ---------------------
+	 *   0..25    FF  FF  FF
+	 *   26..51   00  FF  FF
+	 *   52..61   00  00  FF
+	 *   62..63   00  00  00
+	 */
+	return (char)(((x + 0x41) & ((a & b & c) >> 8))
+		| ((x + (0x61 - 26)) & ((~a & b & c) >> 8))
+		| ((x - (52 - 0x30)) & ((~a & ~b & c) >> 8))
+		| ((0x2B + ((x & 1) << 2)) & (~(a | b | c) >> 8)));
+}
+
+/*
+ * Bulk encoding and decoding.
+ *
+ * Most of the data goes through kernels that process full chunks
+ * (3 bytes <-> 4 characters) in blocks, with the same arithmetic
+ * classification and mapping as b64val() and b64char() (no table
+ * lookup):
+ *
+ *  - A portable path processes two chunks (8 characters) at a time in
+ *    a 64-bit word, with one character per byte lane.
+ *
+ *  - Vector paths (SSE2, AVX2) process blocks of 4 or 8 chunks, with
+ *    unaligned accesses.
+ *
+ * Encoding kernels convert exactly the requested number of chunks;
+ * the generic code in cttk_bintob64_gen() handles line breaks, the
+ * final partial chunk, and truncation to the output buffer length.
+ *
+ * Decoding kernels stop before the first block that contains a
+ * character which is not a Base64 digit (whitespace, '=' sign, or
+ * invalid character); the generic loop in cttk_b64tobin_gen() then
+ * processes such characters one by one, and thus handles all flags
+ * and error conditions. The only data-dependent decision made by a
+ * decoding kernel is whether a whole block consists of Base64 digits,
+ * which reveals no more than the generic loop does (position of
+ * non-data characters).
+ */
+
+/*
+ * Portable helpers: for a 64-bit word with byte lanes of value lower
+ * than 0x80, lane_ge(x, k) sets the top bit of each lane whose value
+ * is at least k (0 < k <= 0x80), and lane_eq(x, k) sets the top bit of
+ * each lane whose value is equal to k. Since lanes are lower than
+ * 0x80, additions of constants lower than 0x80 never carry into the
+ * next lane. lane_mask(h) expands top bits into full lane masks.
+ */
+#define LANES(k)   ((uint64_t)(k) * 0x0101010101010101)
+
+static inline uint64_t
+lane_ge(uint64_t x, unsigned k)
+{
+	return (x + LANES(0x80 - k)) & LANES(0x80);
+}
+
+static inline uint64_t
+lane_eq(uint64_t x, unsigned k)
+{
+	return ~((x ^ LANES(k)) + LANES(0x7F)) & LANES(0x80);
+}
+
+static inline uint64_t
+lane_mask(uint64_t h)
+{
+	return h | (h - (h >> 7));
+}
+
+/*
+ * Bytewise addition modulo 256 in each lane (x must have lanes lower
+ * than 0x80).
+ */
+static inline uint64_t
+lane_add(uint64_t x, uint64_t y)
+{
+	return (x + (y & LANES(0x7F))) ^ (y & LANES(0x80));
+}
+
+/*
+ * Apply b64char() on all 8 lanes (values 0 to 63) of x. The character
+ * is obtained by adding an offset (modulo 256) to the value:
+ *
+ *   value    offset
+ *   0..25     0x41
+ *   26..51    0x47
+ *   52..61    0xFC
+ *   62        0xED
+ *   63        0xF0
+ *
+ * The offset is assembled by XORing the differences between
+ * consecutive offsets under the relevant masks. The vector paths use
+ * the same constants.
+ */
+static inline uint64_t
+b64char_words(uint64_t x)
+{
+	uint64_t off;
+
+	off = LANES(0x41)
+		^ (lane_mask(lane_ge(x, 26)) & LANES(0x41 ^ 0x47))
+		^ (lane_mask(lane_ge(x, 52)) & LANES(0x47 ^ 0xFC))
+		^ (lane_mask(lane_ge(x, 62)) & LANES(0xFC ^ 0xED))
+		^ (lane_mask(lane_ge(x, 63)) & LANES(0xED ^ 0xF0));
+	return lane_add(x, off);
+}
+
+/*
+ * Split a 24-bit chunk value into four 6-bit values, in the four low
+ * bytes of a 32-bit word (first character in the least significant
+ * byte).
+ */
+static inline uint32_t
+b64split(uint32_t x)
+{
+	return (x >> 18)
+		| ((x >> 4) & 0x00003F00)
+		| ((x << 10) & 0x003F0000)
+		| ((x << 24) & 0x3F000000);
+}
+
+static inline uint32_t
+b64chunk(const unsigned char *src)
+{
+	return ((uint32_t)src[0] << 16)
+		| ((uint32_t)src[1] << 8)
+		| (uint32_t)src[2];
+}
+
+static void
+b64enc_words(char *dst, const unsigned char *src, size_t num)
+{
+	size_t u;
+	int i;
+
+	for (u = 0; (num - u) >= 2; u += 2) {
+		uint64_t x;
+
+		x = (uint64_t)b64split(b64chunk(src + 3 * u))
+			| ((uint64_t)b64split(b64chunk(src + 3 * u + 3)) << 32);
+		x = b64char_words(x);
+		for (i = 0; i < 8; i ++) {
+			dst[(u << 2) + i] = (char)(x >> (i << 3));
+		}
+	}
+	if (u < num) {
+		uint32_t x;
+
+		x = (uint32_t)b64char_words(b64split(b64chunk(src + 3 * u)));
+		for (i = 0; i < 4; i ++) {
+			dst[(u << 2) + i] = (char)(x >> (i << 3));
+		}
+	}
+}
+
+/*
+ * Decode 8 characters (lanes of x) into 6 bytes, of which the first
+ * 'len' are written. Returned value is 0 (and nothing is written) if
+ * one of the characters is not a Base64 digit, 1 otherwise.
+ */
+static int
+b64dec_word(unsigned char *dst, uint64_t x, int len)
+{
+	uint64_t hu, hl, hd, hp, hs, off, w;
+	int i;
+
+	hu = lane_ge(x, 0x41) & ~lane_ge(x, 0x5B);
+	hl = lane_ge(x, 0x61) & ~lane_ge(x, 0x7B);
+	hd = lane_ge(x, 0x30) & ~lane_ge(x, 0x3A);
+	hp = lane_eq(x, 0x2B);
+	hs = lane_eq(x, 0x2F);
+	if (((hu | hl | hd | hp | hs) & ~x) != LANES(0x80)) {
+		return 0;
+	}
+	off = (lane_mask(hu) & LANES(0xBF))
+		| (lane_mask(hl) & LANES(0xB9))
+		| (lane_mask(hd) & LANES(0x04))
+		| (lane_mask(hp) & LANES(0x13))
+		| (lane_mask(hs) & LANES(0x10));
+	x = lane_add(x, off);
+
+	/*
+	 * Assemble pairs of 6-bit values into 12-bit values, then
+	 * pairs of 12-bit values into 24-bit values.
+	 */
+	w = ((x & 0x00FF00FF00FF00FF) << 6)
+		| ((x >> 8) & 0x00FF00FF00FF00FF);
+	w = ((w & 0x0000FFFF0000FFFF) << 12)
+		| ((w >> 16) & 0x0000FFFF0000FFFF);
+	if (dst != NULL) {
+		for (i = 0; i < 3; i ++) {
+			dst[i] = (unsigned char)(w >> (16 - (i << 3)));
+			if (len > 3) {
+				dst[3 + i] = (unsigned char)
+					(w >> (48 - (i << 3)));
+			}
+		}
+	}
+	return 1;
+}
+
+static size_t
+b64dec_words(unsigned char *dst, const unsigned char *src, size_t num)
+{
+	size_t u;
+	uint64_t x;
+	int i;
+
+	for (u = 0; (num - u) >= 2; u += 2) {
+		x = 0;
+		for (i = 7; i >= 0; i --) {
+			x = (x << 8) | (uint64_t)src[(u << 2) + i];
+		}
+		if (!b64dec_word(dst == NULL ? NULL : dst + 3 * u, x, 6)) {
+			return u;
+		}
+	}
+
+	/*
+	 * A final lone chunk is completed with 'A' characters (value 0)
+	 * in the upper lanes.
+	 */
+	if (u < num) {
+		x = LANES(0x41) << 32;
+		for (i = 3; i >= 0; i --) {
+			x |= (uint64_t)src[(u << 2) + i] << (i << 3);
+		}
+		if (b64dec_word(dst == NULL ? NULL : dst + 3 * u, x, 3)) {
+			u ++;
+		}
+	}
+	return u;
+}
+
+#if CTTK_SSE2 || CTTK_AVX2
+
+/*
+ * Given the mask of Base64 digits in a block (one bit per character),
+ * return the number of full chunks of digits at the start of the block.
+ * This depends only on the position of the first non-Base64 character.
+ */
+static inline unsigned
+lead_chunks(uint32_t m, unsigned size)
+{
+	unsigned k;
+
+	k = 0;
+	while (k < size && ((m >> (k << 2)) & 0x0F) == 0x0F) {
+		k ++;
+	}
+	return k;
+}
+
+#endif
+
+#if CTTK_SSE2 || CTTK_AVX2
+
+/*
+ * Decoding kernels find the end of the run of full chunks of Base64
+ * digits; when it is not a multiple of the block size, the last block
+ * is decoded again at an overlapping offset (if there is enough data
+ * before it). DEC_KERNEL(name, block, size) defines such a kernel from
+ * the block decoding function.
+ */
+#define DEC_KERNEL(name, block, size) \
+static size_t \
+name(unsigned char *dst, const unsigned char *src, size_t num) \
+{ \
+	size_t u, e; \
+	unsigned k; \
+ \
+	if (num < (size)) { \
+		return b64dec_words(dst, src, num); \
+	} \
+	for (u = 0; (num - u) >= (size); u += (size)) { \
+		k = block(dst == NULL ? NULL : dst + 3 * u, src + (u << 2)); \
+		if (k < (size)) { \
+			e = u + k; \
+			goto partial; \
+		} \
+	} \
+	if (u == num) { \
+		return num; \
+	} \
+	u = num - (size); \
+	k = block(dst == NULL ? NULL : dst + 3 * u, src + (u << 2)); \
+	if (k == (size)) { \
+		return num; \
+	} \
+	e = u + k; \
+partial: \
+	if (e >= (size)) { \
+		u = e - (size); \
+		block(dst == NULL ? NULL : dst + 3 * u, src + (u << 2)); \
+	} else { \
+		b64dec_words(dst, src, e); \
+	} \
+	return e; \
+}
+
+#endif
+
+#if CTTK_SSE2
+
+static inline __m128i
+b64char_sse2(__m128i x)
+{
+	__m128i off;
+
+	off = _mm_set1_epi8(0x41);
+	off = _mm_xor_si128(off, _mm_and_si128(
+		_mm_cmpgt_epi8(x, _mm_set1_epi8(25)),
+		_mm_set1_epi8(0x41 ^ 0x47)));
+	off = _mm_xor_si128(off, _mm_and_si128(
+		_mm_cmpgt_epi8(x, _mm_set1_epi8(51)),
+		_mm_set1_epi8((char)(0x47 ^ 0xFC))));
+	off = _mm_xor_si128(off, _mm_and_si128(
+		_mm_cmpgt_epi8(x, _mm_set1_epi8(61)),
+		_mm_set1_epi8(0xFC ^ 0xED)));
+	off = _mm_xor_si128(off, _mm_and_si128(
+		_mm_cmpgt_epi8(x, _mm_set1_epi8(62)),
+		_mm_set1_epi8(0xED ^ 0xF0)));
+	return _mm_add_epi8(x, off);
+}
+
+/*
+ * Encode 4 chunks. SSE2 has no byte shuffle, so chunks are gathered
+ * with plain loads, then split into 6-bit values (same layout as
+ * b64split()).
+ */
+static inline void
+b64enc_block_sse2(char *dst, const unsigned char *src)
+{
+	__m128i x;
+
+	x = _mm_setr_epi32((int)b64chunk(src), (int)b64chunk(src + 3),
+		(int)b64chunk(src + 6), (int)b64chunk(src + 9));
+	x = _mm_or_si128(
+		_mm_or_si128(_mm_srli_epi32(x, 18),
+			_mm_and_si128(_mm_srli_epi32(x, 4),
+				_mm_set1_epi32(0x00003F00))),
+		_mm_or_si128(
+			_mm_and_si128(_mm_slli_epi32(x, 10),
+				_mm_set1_epi32(0x003F0000)),
+			_mm_and_si128(_mm_slli_epi32(x, 24),
+				_mm_set1_epi32(0x3F000000))));
+	_mm_storeu_si128((__m128i *)dst, b64char_sse2(x));
+}
+
+/*
+ * Vector kernels process full blocks; if the number of chunks is not
+ * a multiple of the block size, then the last block overlaps with the
+ * previous one (the overlapping part is converted again, yielding the
+ * same output). This avoids processing a few chunks per line with the
+ * slower word-wise code.
+ */
+static void
+b64enc_sse2(char *dst, const unsigned char *src, size_t num)
+{
+	size_t u;
+
+	if (num < 4) {
+		b64enc_words(dst, src, num);
+		return;
+	}
+	for (u = 0; (num - u) >= 4; u += 4) {
+		b64enc_block_sse2(dst + (u << 2), src + 3 * u);
+	}
+	if (u < num) {
+		u = num - 4;
+		b64enc_block_sse2(dst + (u << 2), src + 3 * u);
+	}
+}
+
+/*
+ * Decode 4 chunks (16 characters). Signed comparisons reject bytes of
+ * value 0x80 and more. If all characters are Base64 digits, then the
+ * chunks are decoded, and 4 is returned. Otherwise, nothing is written,
+ * and the returned value is the number of full chunks before the first
+ * non-Base64 character.
+ */
+static inline unsigned
+b64dec_block_sse2(unsigned char *dst, const unsigned char *src)
+{
+	__m128i x, mu, ml, md, mp, ms, off;
+	unsigned m;
+	int i;
+
+	x = _mm_loadu_si128((const __m128i *)src);
+	mu = _mm_and_si128(_mm_cmpgt_epi8(x, _mm_set1_epi8(0x40)),
+		_mm_cmpgt_epi8(_mm_set1_epi8(0x5B), x));
+	ml = _mm_and_si128(_mm_cmpgt_epi8(x, _mm_set1_epi8(0x60)),
+		_mm_cmpgt_epi8(_mm_set1_epi8(0x7B), x));
+	md = _mm_and_si128(_mm_cmpgt_epi8(x, _mm_set1_epi8(0x2F)),
+		_mm_cmpgt_epi8(_mm_set1_epi8(0x3A), x));
+	mp = _mm_cmpeq_epi8(x, _mm_set1_epi8(0x2B));
+	ms = _mm_cmpeq_epi8(x, _mm_set1_epi8(0x2F));
+	m = (unsigned)_mm_movemask_epi8(_mm_or_si128(_mm_or_si128(mu, ml),
+		_mm_or_si128(_mm_or_si128(md, mp), ms)));
+	if (m != 0xFFFF) {
+		return lead_chunks(m, 4);
+	}
+	if (dst == NULL) {
+		return 4;
+	}
+	off = _mm_or_si128(
+		_mm_or_si128(
+			_mm_and_si128(mu, _mm_set1_epi8((char)0xBF)),
+			_mm_and_si128(ml, _mm_set1_epi8((char)0xB9))),
+		_mm_or_si128(
+			_mm_or_si128(
+				_mm_and_si128(md, _mm_set1_epi8(0x04)),
+				_mm_and_si128(mp, _mm_set1_epi8(0x13))),
+			_mm_and_si128(ms, _mm_set1_epi8(0x10))));
+	x = _mm_add_epi8(x, off);
+
+	/*
+	 * Assemble 6-bit values into 24-bit chunk values, one per
+	 * 32-bit lane, then write them out.
+	 */
+	x = _mm_or_si128(
+		_mm_slli_epi16(_mm_and_si128(x, _mm_set1_epi16(0x00FF)), 6),
+		_mm_srli_epi16(x, 8));
+	x = _mm_or_si128(
+		_mm_slli_epi32(_mm_and_si128(x, _mm_set1_epi32(0xFFFF)), 12),
+		_mm_srli_epi32(x, 16));
+	for (i = 0; i < 4; i ++) {
+		uint32_t w;
+
+		w = (uint32_t)_mm_cvtsi128_si32(x);
+		x = _mm_srli_si128(x, 4);
+		dst[3 * i + 0] = (unsigned char)(w >> 16);
+		dst[3 * i + 1] = (unsigned char)(w >> 8);
+		dst[3 * i + 2] = (unsigned char)w;
+	}
+	return 4;
+}
+
+DEC_KERNEL(b64dec_sse2, b64dec_block_sse2, 4)
+
+#endif
+
+#if CTTK_AVX2
+
+/*
+ * The AVX2 kernels use the word-wise code (not the SSE2 code) for
+ * short inputs, to avoid transitions between VEX and legacy SSE
+ * encodings, which are expensive on some CPUs.
+ */
+
+TARGET_AVX2
+static inline __m256i
+b64char_avx2(__m256i x)
+{
+	__m256i off;
+
+	off = _mm256_set1_epi8(0x41);
+	off = _mm256_xor_si256(off, _mm256_and_si256(
+		_mm256_cmpgt_epi8(x, _mm256_set1_epi8(25)),
+		_mm256_set1_epi8(0x41 ^ 0x47)));
+	off = _mm256_xor_si256(off, _mm256_and_si256(
+		_mm256_cmpgt_epi8(x, _mm256_set1_epi8(51)),
+		_mm256_set1_epi8((char)(0x47 ^ 0xFC))));
+	off = _mm256_xor_si256(off, _mm256_and_si256(
+		_mm256_cmpgt_epi8(x, _mm256_set1_epi8(61)),
+		_mm256_set1_epi8(0xFC ^ 0xED)));
+	off = _mm256_xor_si256(off, _mm256_and_si256(
+		_mm256_cmpgt_epi8(x, _mm256_set1_epi8(62)),
+		_mm256_set1_epi8(0xED ^ 0xF0)));
+	return _mm256_add_epi8(x, off);
+}
+
+/*
+ * Encode 8 chunks (24 bytes). The two 128-bit halves are loaded from
+ * offsets 0 and 8, so that no byte beyond the 24 source bytes is read;
+ * a byte shuffle then puts each chunk in a 32-bit lane.
+ */
+TARGET_AVX2
+static inline void
+b64enc_block_avx2(char *dst, const unsigned char *src)
+{
+	__m256i x;
+
+	x = _mm256_inserti128_si256(_mm256_castsi128_si256(
+		_mm_loadu_si128((const __m128i *)src)),
+		_mm_loadu_si128((const __m128i *)(src + 8)), 1);
+	x = _mm256_shuffle_epi8(x, _mm256_setr_epi8(
+		2, 1, 0, -1, 5, 4, 3, -1, 8, 7, 6, -1, 11, 10, 9, -1,
+		6, 5, 4, -1, 9, 8, 7, -1, 12, 11, 10, -1, 15, 14, 13, -1));
+	x = _mm256_or_si256(
+		_mm256_or_si256(_mm256_srli_epi32(x, 18),
+			_mm256_and_si256(_mm256_srli_epi32(x, 4),
+				_mm256_set1_epi32(0x00003F00))),
+		_mm256_or_si256(
+			_mm256_and_si256(_mm256_slli_epi32(x, 10),
+				_mm256_set1_epi32(0x003F0000)),
+			_mm256_and_si256(_mm256_slli_epi32(x, 24),
+				_mm256_set1_epi32(0x3F000000))));
+	_mm256_storeu_si256((__m256i *)dst, b64char_avx2(x));
+}
+
+TARGET_AVX2
+static void
+b64enc_avx2(char *dst, const unsigned char *src, size_t num)
+{
+	size_t u;
+
+	if (num < 8) {
+		b64enc_words(dst, src, num);
+		return;
+	}
+	for (u = 0; (num - u) >= 8; u += 8) {
+		b64enc_block_avx2(dst + (u << 2), src + 3 * u);
+	}
+	if (u < num) {
+		u = num - 8;
+		b64enc_block_avx2(dst + (u << 2), src + 3 * u);
+	}
+}
+
+/*
+ * Decode 8 chunks (32 characters); same conventions as
+ * b64dec_block_sse2().
+ */
+TARGET_AVX2
+static inline unsigned
+b64dec_block_avx2(unsigned char *dst, const unsigned char *src)
+{
+	__m256i x, mu, ml, md, mp, ms, off;
+	uint32_t m;
+
+	x = _mm256_loadu_si256((const __m256i *)src);
+	mu = _mm256_and_si256(
+		_mm256_cmpgt_epi8(x, _mm256_set1_epi8(0x40)),
+		_mm256_cmpgt_epi8(_mm256_set1_epi8(0x5B), x));
+	ml = _mm256_and_si256(
+		_mm256_cmpgt_epi8(x, _mm256_set1_epi8(0x60)),
+		_mm256_cmpgt_epi8(_mm256_set1_epi8(0x7B), x));
+	md = _mm256_and_si256(
+		_mm256_cmpgt_epi8(x, _mm256_set1_epi8(0x2F)),
+		_mm256_cmpgt_epi8(_mm256_set1_epi8(0x3A), x));
+	mp = _mm256_cmpeq_epi8(x, _mm256_set1_epi8(0x2B));
+	ms = _mm256_cmpeq_epi8(x, _mm256_set1_epi8(0x2F));
+	m = (uint32_t)_mm256_movemask_epi8(_mm256_or_si256(
+		_mm256_or_si256(mu, ml),
+		_mm256_or_si256(_mm256_or_si256(md, mp), ms)));
+	if (m != 0xFFFFFFFF) {
+		return lead_chunks(m, 8);
+	}
+	if (dst == NULL) {
+		return 8;
+	}
+	off = _mm256_or_si256(
+		_mm256_or_si256(
+			_mm256_and_si256(mu, _mm256_set1_epi8((char)0xBF)),
+			_mm256_and_si256(ml, _mm256_set1_epi8((char)0xB9))),
+		_mm256_or_si256(
+			_mm256_or_si256(
+				_mm256_and_si256(md, _mm256_set1_epi8(0x04)),
+				_mm256_and_si256(mp, _mm256_set1_epi8(0x13))),
+			_mm256_and_si256(ms, _mm256_set1_epi8(0x10))));
+	x = _mm256_add_epi8(x, off);
+	x = _mm256_or_si256(
+		_mm256_slli_epi16(_mm256_and_si256(x,
+			_mm256_set1_epi16(0x00FF)), 6),
+		_mm256_srli_epi16(x, 8));
+	x = _mm256_or_si256(
+		_mm256_slli_epi32(_mm256_and_si256(x,
+			_mm256_set1_epi32(0xFFFF)), 12),
+		_mm256_srli_epi32(x, 16));
+
+	/*
+	 * Gather the 12 output bytes of each 128-bit half, then make
+	 * the 24 bytes contiguous.
+	 */
+	x = _mm256_shuffle_epi8(x, _mm256_setr_epi8(
+		2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1,
+		2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1));
+	x = _mm256_permutevar8x32_epi32(x,
+		_mm256_setr_epi32(0, 1, 2, 4, 5, 6, 3, 7));
+	_mm_storeu_si128((__m128i *)dst, _mm256_castsi256_si128(x));
+	_mm_storel_epi64((__m128i *)(dst + 16),
+		_mm256_extracti128_si256(x, 1));
+	return 8;
+}
+
+TARGET_AVX2
+DEC_KERNEL(b64dec_avx2, b64dec_block_avx2, 8)
+
+#endif
+
+/*
+ * Below this number of chunks, the word-wise code is used directly.
+ */
+#define VEC_MIN   4
+
+typedef void (*b64enc_fn)(char *dst, const unsigned char *src, size_t num);
+typedef size_t (*b64dec_fn)(unsigned char *dst,
+	const unsigned char *src, size_t num);
+
+static void b64enc_first(char *dst, const unsigned char *src, size_t num);
+static size_t b64dec_first(unsigned char *dst,
+	const unsigned char *src, size_t num);
+
+/*
+ * Selected implementations, set on first use (see oram1.c).
+ */
+static b64enc_fn DISPATCH_VAR b64enc_impl = &b64enc_first;
+static b64dec_fn DISPATCH_VAR b64dec_impl = &b64dec_first;
+
+/* see inner.h */
+void
+cttk_base64_select(void)
+{
+	uint32_t f;
+	b64enc_fn fe;
+	b64dec_fn fd;
+
+	f = cttk_cpu_features();
+	fe = &b64enc_words;
+	fd = &b64dec_words;
+#if CTTK_SSE2
+	if (f & CTTK_CPU_SSE2) {
+		fe = &b64enc_sse2;
+		fd = &b64dec_sse2;
+	}
+#endif
+#if CTTK_AVX2
+	if (f & CTTK_CPU_AVX2) {
+		fe = &b64enc_avx2;
+		fd = &b64dec_avx2;
+	}
+#endif
+	(void)f;
+	DISPATCH_STORE(b64enc_impl, fe);
+	DISPATCH_STORE(b64dec_impl, fd);
+}
+
+static void
+b64enc_first(char *dst, const unsigned char *src, size_t num)
+{
+	cttk_base64_select();
+	DISPATCH_LOAD(b64enc_impl)(dst, src, num);
+}
+
+static size_t
+b64dec_first(unsigned char *dst, const unsigned char *src, size_t num)
+{
+	cttk_base64_select();
+	return DISPATCH_LOAD(b64dec_impl)(dst, src, num);
+}
+
+/*
+ * Status codes for b64dec_run().
+ */
+#define DEC_OK     0
+#define DEC_BAD    1
+#define DEC_FULL   2
+
+/*
+ * Decode Base64 characters. This is the common code of the one-shot
+ * and streaming decoders; the decoding state (accumulator, position
+ * in the current chunk, padding) is read from and written back into
+ * the context. The number of produced bytes is written in '*out', and
+ * the index of the first unprocessed character in '*pos'.
+ *
+ * Returned value is DEC_OK if all characters were processed, DEC_BAD
+ * if the character at index '*pos' is invalid, or DEC_FULL if the
+ * Base64 digit at index '*pos' could not be processed because the
+ * output buffer is full.
+ */
+static int
+b64dec_run(cttk_b64dec_context *bc, unsigned char *buf, size_t dst_len,
+	const unsigned char *src, size_t src_len, size_t *pos, size_t *out)
 {
-	unsigned char *buf;
 	unsigned acc;
 	size_t u, v;
-	int lc;
-	int nows;
+	int lc, pad, r;
+	int nows, fast;
 
-	buf = dst;
-	acc = 0;
-	lc = 0;
-	nows = (flags & CTTK_B64DEC_NO_WS) != 0;
+	acc = bc->acc;
+	lc = bc->lc;
+	pad = bc->pad;
+	nows = (bc->flags & CTTK_B64DEC_NO_WS) != 0;
+	fast = 1;
+	r = DEC_OK;
 	for (u = 0, v = 0; u < src_len; u ++) {
 		int c, d;
 
 		/*
-		 * We want source characters in the 0x00..0xFF range,
-		 * hence the cast to unsigned char.
+		 * After an '=' sign, only a second '=' sign (if the
+		 * chunk had two characters only) and whitespace may
+		 * appear.
 		 */
-		c = *((const unsigned char *)src + u);
+		if (pad) {
+			c = src[u];
+			if (lc == 2 && c == 0x3D) {
+				lc ++;
+				continue;
+			}
+			if (c > 32 || nows) {
+				r = DEC_BAD;
+				break;
+			}
+			continue;
+		}
+
+		/*
+		 * At a chunk boundary, full chunks are decoded in bulk
+		 * (within the output buffer capacity), until a non-Base64
+		 * character is reached. The bulk decoder is then invoked
+		 * again only after some whitespace was skipped (e.g. a
+		 * line break), so that the remaining characters of an
+		 * incomplete block are processed only once.
+		 */
+		if (fast && lc == 0) {
+			size_t n, k;
+
+			fast = 0;
+			n = (src_len - u) >> 2;
+			if (buf != NULL && n > (dst_len - v) / 3) {
+				n = (dst_len - v) / 3;
+			}
+			if (n < VEC_MIN) {
+				k = b64dec_words(buf == NULL ? NULL : buf + v,
+					src + u, n);
+			} else {
+				k = DISPATCH_LOAD(b64dec_impl)(
+					buf == NULL ? NULL : buf + v, src + u, n);
+			}
+			u += k << 2;
+			v += 3 * k;
+			if (u == src_len) {
+				break;
+			}
+		}
+
+		/*
+		 * Source characters are in the 0x00..0xFF range.
+		 */
+		c = src[u];
 		d = b64val(c);
 
 		/*
-		 * If the character is not an hex digit, then it may be
+		 * If the character is not a Base64 digit, then it may be
 		 * whitespace to be ignored.
 		 */
 		if (d < 0) {
 			if (!nows && c <= 32) {
+				fast = 1;
 				continue;
 			}
-			if (c == 0x3D && !(flags & CTTK_B64DEC_NO_PAD)) {
+			if (c == 0x3D && !(bc->flags & CTTK_B64DEC_NO_PAD)) {
 				/*
 				 * We found an '=' sign.
 				 *
@@ -87,34 +825,16 @@ cttk_b64tobin_gen(void *dst, size_t dst_len,
 				 * erroneous, hence we allow them to leak.
 				 */
 				if (lc < 2 || acc != 0) {
-					goto b64dec_err;
-				}
-				for (u ++; u < src_len; u ++) {
-					c = *((const unsigned char *)src + u);
-					if (lc == 2 && c == 0x3D) {
-						lc ++;
-						continue;
-					}
-					if (c > 32 || nows) {
-						goto b64dec_err;
-					}
-				}
-				if (lc == 2) {
-					goto b64dec_err;
-				}
-				if (err != NULL) {
-					*err = NULL;
+					r = DEC_BAD;
+					break;
 				}
-				return v;
+				pad = 1;
+				continue;
 			}
-			goto b64dec_err;
+			r = DEC_BAD;
+			break;
 		}
 
-		/*
-		 * Accumulate extra character.
-		 */
-		acc = (acc << 6) | (unsigned)d;
-
 		/*
 		 * Output a byte, if possible.
 		 *
@@ -159,95 +879,141 @@ cttk_b64tobin_gen(void *dst, size_t dst_len,
 		 * systematically.
 		 */
 		if (buf != NULL && v >= dst_len) {
-			goto b64dec_err;
+			r = DEC_FULL;
+			break;
 		}
+
+		/*
+		 * Accumulate extra character.
+		 */
+		acc = (acc << 6) | (unsigned)d;
 		if (lc != 0) {
-			unsigned out;
+			unsigned z;
 
 			if (lc == 1) {
-				out = acc >> 4;
+				z = acc >> 4;
 				acc &= 0x0F;
 			} else if (lc == 2) {
-				out = acc >> 2;
+				z = acc >> 2;
 				acc &= 0x03;
 			} else {
-				out = acc;
+				z = acc;
 				acc = 0;
 			}
 			if (buf != NULL) {
-				buf[v] = out;
+				buf[v] = z;
 			}
 			v ++;
 		}
 		lc = (lc + 1) & 3;
 	}
+	bc->acc = acc;
+	bc->lc = lc;
+	bc->pad = pad;
+	*pos = u;
+	*out = v;
+	return r;
+}
 
-	/*
-	 * Reached end of source string. Whether this is OK depends on
-	 * the state and flags:
-	 *
-	 *  - If padding is expected, then this is correct only if we
-	 *    processed an integral number of chunks.
-	 *
-	 *  - If padding is not expected, then this is correct only if
-	 *    the current chunk is not 1 lone character, and there are
-	 *    no non-zero extra bits.
-	 *
-	 * In that case, we can test for the value of the extra bits,
-	 * since they are erroenous, thus not part of the actually secret
-	 * data.
-	 */
-	if (flags & CTTK_B64DEC_NO_PAD) {
-		if (lc == 1 || acc != 0) {
-			goto b64dec_err;
-		}
+/*
+ * Check whether the decoding state is acceptable at the end of the
+ * source string:
+ *
+ *  - If an '=' sign was read, then a second one was needed if the
+ *    last chunk had only two characters.
+ *
+ *  - If padding is expected, then this is correct only if we
+ *    processed an integral number of chunks.
+ *
+ *  - If padding is not expected, then this is correct only if
+ *    the current chunk is not 1 lone character, and there are
+ *    no non-zero extra bits.
+ *
+ * In that case, we can test for the value of the extra bits,
+ * since they are erroneous, thus not part of the actually secret
+ * data.
+ */
+static int
+b64dec_done(const cttk_b64dec_context *bc)
+{
+	if (bc->pad) {
+		return bc->lc != 2;
+	}
+	if (bc->flags & CTTK_B64DEC_NO_PAD) {
+		return bc->lc != 1 && bc->acc == 0;
 	} else {
-		if (lc != 0) {
-			goto b64dec_err;
+		return bc->lc == 0;
+	}
+}
+
+/* see cttk.h */
+size_t
+cttk_b64tobin_gen(void *dst, size_t dst_len,
+	const char *src, size_t src_len, const char **err, unsigned flags)
+{
+	cttk_b64dec_context bc;
+	size_t u, v;
+
+	cttk_b64dec_init(&bc, flags);
+	if (b64dec_run(&bc, dst, dst_len, (const unsigned char *)src,
+		src_len, &u, &v) != DEC_OK)
+	{
+		if (err != NULL) {
+			*err = src + u;
 		}
+		return v;
 	}
 	if (err != NULL) {
-		*err = NULL;
+		*err = b64dec_done(&bc) ? NULL : src + src_len;
 	}
 	return v;
+}
 
-b64dec_err:
+/* see cttk.h */
+void
+cttk_b64dec_init(cttk_b64dec_context *bc, unsigned flags)
+{
+	bc->flags = flags;
+	bc->acc = 0;
+	bc->lc = 0;
+	bc->pad = 0;
+	bc->fail = 0;
+}
+
+/* see cttk.h */
+size_t
+cttk_b64dec_update(cttk_b64dec_context *bc, void *dst, size_t dst_len,
+	const char *src, size_t src_len, const char **err)
+{
+	size_t u, v;
+	int r;
+
+	if (bc->fail) {
+		if (err != NULL) {
+			*err = (src_len == 0) ? NULL : src;
+		}
+		return 0;
+	}
+	r = b64dec_run(bc, dst, dst_len, (const unsigned char *)src,
+		src_len, &u, &v);
+	if (r == DEC_BAD) {
+		bc->fail = 1;
+	}
 	if (err != NULL) {
-		*err = src + u;
+		*err = (r == DEC_OK) ? NULL : src + u;
 	}
 	return v;
 }
 
-static char
-b64char(uint32_t x)
+/* see cttk.h */
+cttk_bool
+cttk_b64dec_final(cttk_b64dec_context *bc)
 {
-	/*
-	 * Values 0 to 25 map to 0x41..0x5A ('A' to 'Z')
-	 * Values 26 to 51 map to 0x61..0x7A ('a' to 'z')
-	 * Values 52 to 61 map to 0x30..0x39 ('0' to '9')
-	 * Value 62 maps to 0x2B ('+')
-	 * Value 63 maps to 0x2F ('/')
-	 */
-	uint32_t a, b, c;
+	int ok;
 
-	a = x - 26;
-	b = x - 52;
-	c = x - 62;
-
-	/*
-	 * Looking at bits 8..15 of values a, b and c:
-	 *
-	 *     x       a   b   c
-	 *  ---------------------
-	 *   0..25    FF  FF  FF
-	 *   26..51   00  FF  FF
-	 *   52..61   00  00  FF
-	 *   62..63   00  00  00
-	 */
-	return (char)(((x + 0x41) & ((a & b & c) >> 8))
-		| ((x + (0x61 - 26)) & ((~a & b & c) >> 8))
-		| ((x - (52 - 0x30)) & ((~a & ~b & c) >> 8))
-		| ((0x2B + ((x & 1) << 2)) & (~(a | b | c) >> 8)));
+	ok = !bc->fail && b64dec_done(bc);
+	cttk_b64dec_init(bc, bc->flags);
+	return cttk_bool_of_u32(ok);
 }
 
 /* see cttk.h */
@@ -320,17 +1086,47 @@ cttk_bintob64_gen(char *dst, size_t dst_len,
 		dst[v ++] = (z); \
 	} while (0)
 
-	for (u = 0, v = 0, n = 0; u < num; u += 3) {
-		uint32_t x;
+	u = 0;
+	v = 0;
+	n = 0;
+	while (u < num) {
+		size_t k;
 
-		x = ((uint32_t)buf[u] << 16)
-			| ((uint32_t)buf[u + 1] << 8)
-			| (uint32_t)buf[u + 2];
-		OUTC(b64char(x >> 18));
-		OUTC(b64char((x >> 12) & 0x3F));
-		OUTC(b64char((x >> 6) & 0x3F));
-		OUTC(b64char(x & 0x3F));
-		if (++ n == line_len) {
+		/*
+		 * Full chunks up to the end of the current line are
+		 * encoded in bulk, as long as they fit in the output
+		 * buffer. If the output buffer cannot receive a full
+		 * chunk, then the chunk is produced character by
+		 * character, until truncation.
+		 */
+		k = (num - u) / 3;
+		if (line_len != 0 && k > line_len - n) {
+			k = line_len - n;
+		}
+		if (k > ((dst_len - v) >> 2)) {
+			k = (dst_len - v) >> 2;
+		}
+		if (k > 0) {
+			if (k < VEC_MIN) {
+				b64enc_words(dst + v, buf + u, k);
+			} else {
+				DISPATCH_LOAD(b64enc_impl)(dst + v, buf + u, k);
+			}
+			u += 3 * k;
+			v += k << 2;
+			n += k;
+		} else {
+			uint32_t x;
+
+			x = b64chunk(buf + u);
+			OUTC(b64char(x >> 18));
+			OUTC(b64char((x >> 12) & 0x3F));
+			OUTC(b64char((x >> 6) & 0x3F));
+			OUTC(b64char(x & 0x3F));
+			u += 3;
+			n ++;
+		}
+		if (n == line_len) {
 			if (flags & CTTK_B64ENC_CRLF) {
 				OUTC(0x0D);
 			}
@@ -374,3 +1170,275 @@ b64enc_exit:
 	dst[v] = 0;
 	return v;
 }
+
+/*
+ * Encode 'num' full chunks, with line breaks as specified by the flags
+ * (line_len is the line length in chunks, or 0 for no line break).
+ * '*n' is the number of chunks already in the current line; it is
+ * updated. Returned value is the number of produced characters.
+ */
+static size_t
+b64enc_lines(char *dst, const unsigned char *src, size_t num,
+	size_t line_len, size_t *n, unsigned flags)
+{
+	size_t u, v;
+
+	u = 0;
+	v = 0;
+	while (u < num) {
+		size_t k;
+
+		k = num - u;
+		if (line_len != 0 && k > line_len - *n) {
+			k = line_len - *n;
+		}
+		if (k < VEC_MIN) {
+			b64enc_words(dst + v, src + 3 * u, k);
+		} else {
+			DISPATCH_LOAD(b64enc_impl)(dst + v, src + 3 * u, k);
+		}
+		u += k;
+		v += k << 2;
+		*n += k;
+		if (*n == line_len) {
+			if (flags & CTTK_B64ENC_CRLF) {
+				dst[v ++] = 0x0D;
+			}
+			dst[v ++] = 0x0A;
+			*n = 0;
+		}
+	}
+	return v;
+}
+
+static size_t
+b64enc_line_len(unsigned flags)
+{
+	if (flags & CTTK_B64ENC_NEWLINE) {
+		return (flags & CTTK_B64ENC_LINE64) ? 16 : 19;
+	} else {
+		return 0;
+	}
+}
+
+/* see cttk.h */
+void
+cttk_b64enc_init(cttk_b64enc_context *ec, unsigned flags)
+{
+	ec->flags = flags;
+	ec->plen = 0;
+	ec->n = 0;
+}
+
+/* see cttk.h */
+size_t
+cttk_b64enc_update(cttk_b64enc_context *ec, char *dst, size_t dst_len,
+	const void *src, size_t src_len)
+{
+	const unsigned char *buf;
+	size_t num, dlen, line_len, v;
+
+	/*
+	 * Compute output length.
+	 */
+	buf = src;
+	line_len = b64enc_line_len(ec->flags);
+	num = (ec->plen + src_len) / 3;
+	dlen = num << 2;
+	if (line_len != 0) {
+		size_t nl;
+
+		nl = (ec->n + num) / line_len;
+		if (ec->flags & CTTK_B64ENC_CRLF) {
+			nl <<= 1;
+		}
+		dlen += nl;
+	}
+	if (dst == NULL) {
+		return dlen;
+	}
+	if (dst_len < dlen) {
+		return 0;
+	}
+
+	/*
+	 * Complete the pending chunk, if any.
+	 */
+	v = 0;
+	if (ec->plen != 0) {
+		while (ec->plen < 3 && src_len > 0) {
+			ec->pbuf[ec->plen ++] = *buf ++;
+			src_len --;
+		}
+		if (ec->plen < 3) {
+			return 0;
+		}
+		v = b64enc_lines(dst, ec->pbuf, 1, line_len, &ec->n, ec->flags);
+		ec->plen = 0;
+	}
+
+	/*
+	 * Encode all full chunks, and keep the remaining bytes.
+	 */
+	num = src_len / 3;
+	v += b64enc_lines(dst + v, buf, num, line_len, &ec->n, ec->flags);
+	buf += 3 * num;
+	src_len -= 3 * num;
+	while (src_len -- > 0) {
+		ec->pbuf[ec->plen ++] = *buf ++;
+	}
+	return v;
+}
+
+/* see cttk.h */
+size_t
+cttk_b64enc_final(cttk_b64enc_context *ec, char *dst, size_t dst_len)
+{
+	size_t dlen, v;
+	int pad, nl;
+
+	pad = (ec->flags & CTTK_B64ENC_NO_PAD) == 0;
+	nl = (ec->flags & CTTK_B64ENC_NEWLINE) != 0
+		&& (ec->plen != 0 || ec->n != 0);
+	dlen = 0;
+	if (ec->plen != 0) {
+		dlen = pad ? 4 : ec->plen + 1;
+	}
+	if (nl) {
+		dlen += (ec->flags & CTTK_B64ENC_CRLF) ? 2 : 1;
+	}
+	if (dst == NULL) {
+		return dlen;
+	}
+	if (dst_len < dlen) {
+		return 0;
+	}
+	v = 0;
+	if (ec->plen == 1) {
+		uint32_t x;
+
+		x = ec->pbuf[0];
+		dst[v ++] = b64char(x >> 2);
+		dst[v ++] = b64char((x << 4) & 0x3F);
+	} else if (ec->plen == 2) {
+		uint32_t x;
+
+		x = ((uint32_t)ec->pbuf[0] << 8) | (uint32_t)ec->pbuf[1];
+		dst[v ++] = b64char(x >> 10);
+		dst[v ++] = b64char((x >> 4) & 0x3F);
+		dst[v ++] = b64char((x << 2) & 0x3F);
+	}
+	if (ec->plen != 0 && pad) {
+		while (v < 4) {
+			dst[v ++] = 0x3D;
+		}
+	}
+	if (nl) {
+		if (ec->flags & CTTK_B64ENC_CRLF) {
+			dst[v ++] = 0x0D;
+		}
+		dst[v ++] = 0x0A;
+	}
+	cttk_b64enc_init(ec, ec->flags);
+	return v;
+}
+
+/* see cttk.h */
+void
+cttk_i31_decb64(uint32_t *x, const char *src, size_t src_len,
+	const char **err, unsigned flags)
+{
+	cttk_i31_sink sk;
+	cttk_b64dec_context bc;
+	unsigned char tmp[48];
+	const char *e;
+	size_t n, u;
+
+	STATS_I31(TEXT);
+	/*
+	 * As in cttk_i31_dechex(), a first pass validates the string
+	 * and gives the number of bytes, then the string is decoded
+	 * again by chunks. A chunk of 60 characters, with up to three
+	 * pending characters from the previous chunk, yields at most
+	 * 47 bytes.
+	 */
+	n = cttk_b64tobin_gen(NULL, 0, src, src_len, &e, flags);
+	if (err != NULL) {
+		*err = e;
+	}
+	cttk_i31_sink_init(&sk, x, n << 3);
+	if (e != NULL) {
+		x[0] |= 0x80000000;
+		return;
+	}
+	cttk_b64dec_init(&bc, flags);
+	for (u = 0; u < src_len; u += n) {
+		size_t m;
+
+		n = (src_len - u) < 60 ? (src_len - u) : 60;
+		m = cttk_b64dec_update(&bc, tmp, sizeof tmp, src + u, n, NULL);
+		cttk_i31_sink_bytes(&sk, tmp, m);
+	}
+	memset(tmp, 0, sizeof tmp);
+	cttk_i31_sink_finish(&sk,
+		(flags & CTTK_I31_SIGNED) != 0, (flags & CTTK_I31_TRUNC) != 0);
+}
+
+/* see cttk.h */
+size_t
+cttk_i31_encb64(char *dst, size_t dst_len,
+	const uint32_t *x, size_t len, unsigned flags)
+{
+	STATS_I31(TEXT);
+	cttk_b64enc_context ec;
+	unsigned char tmp[48];
+	char cbuf[96];
+	size_t u, v, k;
+
+	/*
+	 * Output is the same as cttk_bintob64_gen() over the output of
+	 * cttk_i31_encbe(); bytes are extracted by small blocks, and
+	 * encoded with the streaming encoder. Each block is encoded
+	 * directly in dst if it fits; otherwise, it goes through cbuf
+	 * and the output is truncated.
+	 */
+	if (dst == NULL) {
+		return cttk_bintob64_gen(NULL, 0, NULL, len, flags);
+	}
+	if (dst_len == 0) {
+		return 0;
+	}
+	dst_len --;
+	cttk_b64enc_init(&ec, flags);
+	v = 0;
+	for (u = 0; u < len && v < dst_len; u += k) {
+		size_t m;
+
+		k = (len - u) < sizeof tmp ? (len - u) : sizeof tmp;
+		cttk_i31_encbe_part(tmp, x, len, u, k);
+		m = cttk_b64enc_update(&ec, NULL, 0, tmp, k);
+		if (m <= dst_len - v) {
+			v += cttk_b64enc_update(&ec, dst + v, m, tmp, k);
+		} else {
+			cttk_b64enc_update(&ec, cbuf, sizeof cbuf, tmp, k);
+			memcpy(dst + v, cbuf, dst_len - v);
+			v = dst_len;
+		}
+	}
+	if (v < dst_len) {
+		size_t m;
+
+		m = cttk_b64enc_final(&ec, NULL, 0);
+		if (m <= dst_len - v) {
+			v += cttk_b64enc_final(&ec, dst + v, m);
+		} else {
+			cttk_b64enc_final(&ec, cbuf, sizeof cbuf);
+			memcpy(dst + v, cbuf, dst_len - v);
+			v = dst_len;
+		}
+	}
+	dst[v] = 0;
+	memset(tmp, 0, sizeof tmp);
+	memset(cbuf, 0, sizeof cbuf);
+	return v;
+}
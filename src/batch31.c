@@ -0,0 +1,780 @@
+/*
+ * Copyright (c) 2018 Thomas Pornin <pornin@bolet.org>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "inner.h"
+
+/*
+ * A batch holds num big integers of the same size, in the i31
+ * representation (see int31.c), in a "structure of arrays" layout:
+ *
+ *    b[0]                  header word h (size only, no NaN flag)
+ *    b[1]                  number of lanes (num)
+ *    b[2+k*num+i]          word k of lane i (0 <= k <= len)
+ *
+ * where len = (h + 31) >> 5 is the number of value words. Thus, word 0
+ * of each lane is the lane header (h, with the lane NaN flag), and
+ * lane i, read with a stride of num words, is a normal i31 integer.
+ *
+ * All lanes are processed with the same sequence of operations, so
+ * that consecutive lanes can be handled with SIMD instructions; only
+ * the size and the number of lanes may leak.
+ */
+
+/*
+ * Verify that batches a and b (b may be NULL) have the same size and
+ * number of lanes as batch d. On mismatch, all lanes of d are set to
+ * NaN, and 0 is returned.
+ */
+static int
+batch_check(uint32_t *d, const uint32_t *a, const uint32_t *b)
+{
+	if (d[0] != a[0] || d[1] != a[1]
+		|| (b != NULL && (d[0] != b[0] || d[1] != b[1])))
+	{
+		size_t i, n;
+
+		STATS_NAN_SIZE();
+		n = d[1];
+		for (i = 0; i < n; i ++) {
+			d[2 + i] |= 0x80000000;
+		}
+		return 0;
+	}
+	return 1;
+}
+
+/* ==================================================================== */
+/*
+ * Lane kernels. Each kernel processes lanes i0 to i1-1 of batches with
+ * n lanes and header h; pointers designate word 0 of lane 0 (i.e. b+2
+ * for batch b). The SIMD kernels process groups of consecutive lanes,
+ * and use the generic kernels for the remaining lanes.
+ *
+ * For additions and subtractions, the overflow rules are those of
+ * cttk_i31_add() and cttk_i31_sub() (see int31.c). Since each word is
+ * written after the corresponding source words have been read,
+ * operands need not be distinct. The op parameter combines OP_SUB
+ * (subtraction instead of addition) and OP_TRUNC (truncating variant).
+ */
+
+#define OP_TRUNC   1
+#define OP_SUB     2
+
+typedef void (*addsub_fn)(uint32_t *d, const uint32_t *a, const uint32_t *b,
+	size_t n, uint32_t h, size_t i0, size_t i1, int op);
+typedef void (*mul_fn)(uint32_t *d, const uint32_t *a, const uint32_t *b,
+	size_t n, uint32_t h, size_t i0, size_t i1, uint32_t *t, int trunc);
+typedef void (*cmp_fn)(int32_t *r, const uint32_t *a, const uint32_t *b,
+	size_t n, uint32_t h, size_t i0, size_t i1);
+typedef void (*cond_copy_fn)(const cttk_bool *ctl,
+	uint32_t *d, const uint32_t *s, size_t n, uint32_t h,
+	size_t i0, size_t i1);
+
+static void
+addsub_lanes(uint32_t *d, const uint32_t *a, const uint32_t *b,
+	size_t n, uint32_t h, size_t i0, size_t i1, int op)
+{
+	size_t i, k, len;
+	unsigned ti;
+
+	len = (h + 31) >> 5;
+	ti = top_index(h);
+	for (i = i0; i < i1; i ++) {
+		uint32_t cc, tt, hd, wd;
+
+		hd = a[i] | b[i];
+		tt = a[len * n + i] ^ b[len * n + i];
+		cc = 0;
+		wd = 0;
+		for (k = 1; k <= len; k ++) {
+			uint32_t wa, wb, w;
+
+			wa = a[k * n + i];
+			wb = b[k * n + i];
+			if (op & OP_SUB) {
+				w = wa - wb - cc;
+			} else {
+				w = wa + wb + cc;
+			}
+			wd = w & 0x7FFFFFFF;
+			d[k * n + i] = wd;
+			cc = w >> 31;
+		}
+		if (op & OP_TRUNC) {
+			d[len * n + i] = signext(wd, ti + 1) & 0x7FFFFFFF;
+		} else {
+			hd |= (((tt ^ wd) >> ti) ^ cc) << 31;
+		}
+		d[i] = hd;
+	}
+}
+
+/*
+ * Finish a multiplication for lane i: the len low words of the product
+ * are in t (with stride ts), and or0, and1 and wt are the OR and the
+ * AND of the high words, and the top word of the 2*len-word product.
+ * As in genmul_separate() (see int31.c), the result is correct if and
+ * only if all high bits are copies of the sign bit of the product.
+ */
+static void
+mul_finish(uint32_t *d, const uint32_t *a, const uint32_t *b,
+	size_t n, uint32_t h, size_t i, const uint32_t *t, size_t ts,
+	uint32_t or0, uint32_t and1, uint32_t wt, int trunc)
+{
+	size_t k, len;
+	unsigned ti;
+	uint32_t hd, ssd, wd;
+	cttk_bool ok;
+
+	len = (h + 31) >> 5;
+	ti = top_index(h);
+	hd = a[i] | b[i];
+	for (k = 0; k < len; k ++) {
+		d[(k + 1) * n + i] = t[k * ts];
+	}
+	wd = t[(len - 1) * ts];
+	if (trunc) {
+		d[len * n + i] = signext(wd, ti + 1) & 0x7FFFFFFF;
+	} else {
+		ssd = -(wt >> 30) >> 1;
+		ok = cttk_and(
+			cttk_bool_of_u32(cttk_u32_mux(
+				cttk_bool_of_u32(ssd & 1),
+				cttk_u32_eq0(and1 ^ 0x7FFFFFFF).v,
+				cttk_u32_eq0(or0).v)),
+			cttk_u32_eq0((wd ^ ssd) >> ti));
+		hd |= (ok.v ^ 1) << 31;
+	}
+	d[i] = hd;
+}
+
+/*
+ * Multiplication: the unsigned product of the two's complement
+ * representations over len words is computed column by column, and
+ * the signed product modulo 2^(62*len) is obtained by subtracting
+ * b*2^(31*len) (if a < 0) and a*2^(31*len) (if b < 0). Subtraction of
+ * x*2^(31*len) is done by adding (~x)*2^(31*len) + 2^(31*len), which
+ * is equivalent modulo 2^(62*len); this is done unconditionally, with
+ * x replaced with 0 when no correction is needed. Thus, only len^2
+ * word products are computed per lane. The temporary t receives the
+ * low words (len words per lane); destination may be equal to a or b.
+ */
+static void
+mul_lanes(uint32_t *d, const uint32_t *a, const uint32_t *b,
+	size_t n, uint32_t h, size_t i0, size_t i1, uint32_t *t, int trunc)
+{
+	size_t i, len;
+
+	len = (h + 31) >> 5;
+	for (i = i0; i < i1; i ++) {
+		uint32_t ssa, ssb, or0, and1, wd;
+		size_t u, v;
+		uint64_t cc;
+
+		ssa = -(a[len * n + i] >> 30) >> 1;
+		ssb = -(b[len * n + i] >> 30) >> 1;
+		or0 = 0;
+		and1 = 0x7FFFFFFF;
+		cc = 0;
+		wd = 0;
+		for (u = 0; u < (len << 1); u ++) {
+			size_t vlo, vhi;
+			uint64_t zd;
+
+			zd = cc;
+			cc = 0;
+			vlo = u < len ? 0 : u + 1 - len;
+			vhi = u < len ? u : len - 1;
+			for (v = vlo; v <= vhi; v ++) {
+				uint64_t zr;
+
+				zr = mulu32w(a[(v + 1) * n + i],
+					b[(u - v + 1) * n + i]);
+				zd += zr & 0x7FFFFFFF;
+				cc += zr >> 31;
+			}
+			if (u >= len) {
+				zd += (~(b[(u - len + 1) * n + i] & ssa)
+					& 0x7FFFFFFF);
+				zd += (~(a[(u - len + 1) * n + i] & ssb)
+					& 0x7FFFFFFF);
+				zd += (u == len) << 1;
+			}
+			cc += zd >> 31;
+			wd = (uint32_t)zd & 0x7FFFFFFF;
+			if (u < len) {
+				t[u] = wd;
+			} else {
+				or0 |= wd;
+				and1 &= wd;
+			}
+		}
+		mul_finish(d, a, b, n, h, i, t, 1, or0, and1, wd, trunc);
+	}
+}
+
+/*
+ * Comparison, as val_cmp() in int31.c; lanes for which an operand is
+ * NaN yield 0.
+ */
+static void
+cmp_lanes(int32_t *r, const uint32_t *a, const uint32_t *b,
+	size_t n, uint32_t h, size_t i0, size_t i1)
+{
+	size_t i, k, len;
+
+	len = (h + 31) >> 5;
+	for (i = i0; i < i1; i ++) {
+		uint32_t cc, t, w;
+
+		cc = 0;
+		t = 0;
+		for (k = 1; k <= len; k ++) {
+			uint32_t wz;
+
+			wz = a[k * n + i] - b[k * n + i] - cc;
+			cc = wz >> 31;
+			t |= wz;
+		}
+		cc ^= (a[len * n + i] ^ b[len * n + i]) >> 30;
+		w = (cttk_u32_neq0(t).v | -cc)
+			& (((a[i] | b[i]) >> 31) - 1);
+		r[i] = *(int32_t *)&w;
+	}
+}
+
+static void
+cond_copy_lanes(const cttk_bool *ctl, uint32_t *d, const uint32_t *s,
+	size_t n, uint32_t h, size_t i0, size_t i1)
+{
+	size_t i, k, len;
+
+	len = (h + 31) >> 5;
+	for (i = i0; i < i1; i ++) {
+		uint32_t m;
+
+		m = -ctl[i].v;
+		for (k = 0; k <= len; k ++) {
+			d[k * n + i] ^= (d[k * n + i] ^ s[k * n + i]) & m;
+		}
+	}
+}
+
+#if CTTK_AVX2
+
+/*
+ * AVX2 kernels: additions, subtractions, comparisons and conditional
+ * copies handle 8 lanes at a time; for multiplications, products are
+ * 64-bit wide and lanes are processed by groups of 4. SIMD
+ * multiplication opcodes are constant-time on all CPUs that support
+ * AVX2, hence they are used regardless of CTTK_CTMULU32W.
+ */
+
+#define LD8(p)     _mm256_loadu_si256((const __m256i *)(const void *)(p))
+#define ST8(p, x)  _mm256_storeu_si256((__m256i *)(void *)(p), (x))
+#define LD4W(p)    _mm256_cvtepu32_epi64( \
+                   _mm_loadu_si128((const __m128i *)(const void *)(p)))
+
+TARGET_AVX2
+static void
+addsub_avx2(uint32_t *d, const uint32_t *a, const uint32_t *b,
+	size_t n, uint32_t h, size_t i0, size_t i1, int op)
+{
+	size_t i, k, len;
+	unsigned ti;
+	__m256i m31;
+	__m128i sc1, sc2;
+
+	len = (h + 31) >> 5;
+	ti = top_index(h);
+	m31 = _mm256_set1_epi32(0x7FFFFFFF);
+	sc1 = _mm_cvtsi32_si128((int)ti);
+	sc2 = _mm_cvtsi32_si128((int)(31 - ti));
+	for (i = i0; i + 8 <= i1; i += 8) {
+		__m256i hd, tt, cc, wd;
+
+		hd = _mm256_or_si256(LD8(a + i), LD8(b + i));
+		tt = _mm256_xor_si256(LD8(a + len * n + i), LD8(b + len * n + i));
+		cc = _mm256_setzero_si256();
+		wd = cc;
+		for (k = 1; k <= len; k ++) {
+			__m256i wa, wb, w;
+
+			wa = LD8(a + k * n + i);
+			wb = LD8(b + k * n + i);
+			if (op & OP_SUB) {
+				w = _mm256_sub_epi32(_mm256_sub_epi32(wa, wb), cc);
+			} else {
+				w = _mm256_add_epi32(_mm256_add_epi32(wa, wb), cc);
+			}
+			wd = _mm256_and_si256(w, m31);
+			ST8(d + k * n + i, wd);
+			cc = _mm256_srli_epi32(w, 31);
+		}
+		if (op & OP_TRUNC) {
+			wd = _mm256_and_si256(m31, _mm256_sra_epi32(
+				_mm256_sll_epi32(wd, sc2), sc2));
+			ST8(d + len * n + i, wd);
+		} else {
+			hd = _mm256_or_si256(hd, _mm256_slli_epi32(
+				_mm256_xor_si256(_mm256_srl_epi32(
+				_mm256_xor_si256(tt, wd), sc1), cc), 31));
+		}
+		ST8(d + i, hd);
+	}
+	addsub_lanes(d, a, b, n, h, i, i1, op);
+}
+
+TARGET_AVX2
+static void
+mul_avx2(uint32_t *d, const uint32_t *a, const uint32_t *b,
+	size_t n, uint32_t h, size_t i0, size_t i1, uint32_t *t, int trunc)
+{
+	size_t i, len;
+	__m256i m31, idx;
+
+	len = (h + 31) >> 5;
+	m31 = _mm256_set1_epi64x(0x7FFFFFFF);
+	idx = _mm256_setr_epi32(0, 2, 4, 6, 1, 3, 5, 7);
+	for (i = i0; i + 4 <= i1; i += 4) {
+		__m256i ssa, ssb, or0, and1, cc, wd;
+		size_t u, v, j;
+		uint64_t xo[4], xa[4], xw[4];
+
+		ssa = _mm256_srli_epi64(_mm256_sub_epi64(_mm256_setzero_si256(),
+			_mm256_srli_epi64(LD4W(a + len * n + i), 30)), 33);
+		ssb = _mm256_srli_epi64(_mm256_sub_epi64(_mm256_setzero_si256(),
+			_mm256_srli_epi64(LD4W(b + len * n + i), 30)), 33);
+		or0 = _mm256_setzero_si256();
+		and1 = m31;
+		cc = or0;
+		wd = or0;
+		for (u = 0; u < (len << 1); u ++) {
+			size_t vlo, vhi;
+			__m256i zd;
+
+			zd = cc;
+			cc = _mm256_setzero_si256();
+			vlo = u < len ? 0 : u + 1 - len;
+			vhi = u < len ? u : len - 1;
+			for (v = vlo; v <= vhi; v ++) {
+				__m256i zr;
+
+				zr = _mm256_mul_epu32(LD4W(a + (v + 1) * n + i),
+					LD4W(b + (u - v + 1) * n + i));
+				zd = _mm256_add_epi64(zd,
+					_mm256_and_si256(zr, m31));
+				cc = _mm256_add_epi64(cc,
+					_mm256_srli_epi64(zr, 31));
+			}
+			if (u >= len) {
+				zd = _mm256_add_epi64(zd, _mm256_andnot_si256(
+					_mm256_and_si256(ssa,
+					LD4W(b + (u - len + 1) * n + i)), m31));
+				zd = _mm256_add_epi64(zd, _mm256_andnot_si256(
+					_mm256_and_si256(ssb,
+					LD4W(a + (u - len + 1) * n + i)), m31));
+				if (u == len) {
+					zd = _mm256_add_epi64(zd,
+						_mm256_set1_epi64x(2));
+				}
+			}
+			cc = _mm256_add_epi64(cc, _mm256_srli_epi64(zd, 31));
+			wd = _mm256_and_si256(zd, m31);
+			if (u < len) {
+				_mm_storeu_si128((__m128i *)(void *)(t + (u << 2)),
+					_mm256_castsi256_si128(
+					_mm256_permutevar8x32_epi32(wd, idx)));
+			} else {
+				or0 = _mm256_or_si256(or0, wd);
+				and1 = _mm256_and_si256(and1, wd);
+			}
+		}
+		_mm256_storeu_si256((__m256i *)(void *)xo, or0);
+		_mm256_storeu_si256((__m256i *)(void *)xa, and1);
+		_mm256_storeu_si256((__m256i *)(void *)xw, wd);
+		for (j = 0; j < 4; j ++) {
+			mul_finish(d, a, b, n, h, i + j, t + j, 4,
+				(uint32_t)xo[j], (uint32_t)xa[j],
+				(uint32_t)xw[j], trunc);
+		}
+	}
+	mul_lanes(d, a, b, n, h, i, i1, t, trunc);
+}
+
+TARGET_AVX2
+static void
+cmp_avx2(int32_t *r, const uint32_t *a, const uint32_t *b,
+	size_t n, uint32_t h, size_t i0, size_t i1)
+{
+	size_t i, k, len;
+	__m256i one;
+
+	len = (h + 31) >> 5;
+	one = _mm256_set1_epi32(1);
+	for (i = i0; i + 8 <= i1; i += 8) {
+		__m256i cc, t, w, z;
+
+		cc = _mm256_setzero_si256();
+		t = cc;
+		for (k = 1; k <= len; k ++) {
+			__m256i wz;
+
+			wz = _mm256_sub_epi32(_mm256_sub_epi32(
+				LD8(a + k * n + i), LD8(b + k * n + i)), cc);
+			cc = _mm256_srli_epi32(wz, 31);
+			t = _mm256_or_si256(t, wz);
+		}
+		cc = _mm256_xor_si256(cc, _mm256_srli_epi32(_mm256_xor_si256(
+			LD8(a + len * n + i), LD8(b + len * n + i)), 30));
+		z = _mm256_setzero_si256();
+		w = _mm256_or_si256(
+			_mm256_andnot_si256(_mm256_cmpeq_epi32(t, z), one),
+			_mm256_sub_epi32(z, cc));
+		w = _mm256_and_si256(w, _mm256_sub_epi32(_mm256_srli_epi32(
+			_mm256_or_si256(LD8(a + i), LD8(b + i)), 31), one));
+		ST8(r + i, w);
+	}
+	cmp_lanes(r, a, b, n, h, i, i1);
+}
+
+TARGET_AVX2
+static void
+cond_copy_avx2(const cttk_bool *ctl, uint32_t *d, const uint32_t *s,
+	size_t n, uint32_t h, size_t i0, size_t i1)
+{
+	size_t i, k, len;
+
+	len = (h + 31) >> 5;
+	for (i = i0; i + 8 <= i1; i += 8) {
+		uint32_t mm[8];
+		__m256i m;
+		size_t j;
+
+		for (j = 0; j < 8; j ++) {
+			mm[j] = -ctl[i + j].v;
+		}
+		m = LD8(mm);
+		for (k = 0; k <= len; k ++) {
+			__m256i x;
+
+			x = LD8(d + k * n + i);
+			x = _mm256_xor_si256(x, _mm256_and_si256(
+				_mm256_xor_si256(x, LD8(s + k * n + i)), m));
+			ST8(d + k * n + i, x);
+		}
+	}
+	cond_copy_lanes(ctl, d, s, n, h, i, i1);
+}
+
+#undef LD8
+#undef ST8
+#undef LD4W
+
+#endif
+
+static void addsub_first(uint32_t *d, const uint32_t *a, const uint32_t *b,
+	size_t n, uint32_t h, size_t i0, size_t i1, int op);
+static void mul_first(uint32_t *d, const uint32_t *a, const uint32_t *b,
+	size_t n, uint32_t h, size_t i0, size_t i1, uint32_t *t, int trunc);
+static void cmp_first(int32_t *r, const uint32_t *a, const uint32_t *b,
+	size_t n, uint32_t h, size_t i0, size_t i1);
+static void cond_copy_first(const cttk_bool *ctl,
+	uint32_t *d, const uint32_t *s, size_t n, uint32_t h,
+	size_t i0, size_t i1);
+
+/*
+ * Selected implementations (see oram1.c).
+ */
+static addsub_fn DISPATCH_VAR addsub_impl = &addsub_first;
+static mul_fn DISPATCH_VAR mul_impl = &mul_first;
+static cmp_fn DISPATCH_VAR cmp_impl = &cmp_first;
+static cond_copy_fn DISPATCH_VAR cond_copy_impl = &cond_copy_first;
+
+/* see inner.h */
+void
+cttk_batch31_select(void)
+{
+	uint32_t f;
+	addsub_fn fa;
+	mul_fn fm;
+	cmp_fn fk;
+	cond_copy_fn fc;
+
+	f = cttk_cpu_features();
+	fa = &addsub_lanes;
+	fm = &mul_lanes;
+	fk = &cmp_lanes;
+	fc = &cond_copy_lanes;
+#if CTTK_AVX2
+	if (f & CTTK_CPU_AVX2) {
+		fa = &addsub_avx2;
+		fm = &mul_avx2;
+		fk = &cmp_avx2;
+		fc = &cond_copy_avx2;
+	}
+#endif
+	(void)f;
+	DISPATCH_STORE(addsub_impl, fa);
+	DISPATCH_STORE(mul_impl, fm);
+	DISPATCH_STORE(cmp_impl, fk);
+	DISPATCH_STORE(cond_copy_impl, fc);
+}
+
+static void
+addsub_first(uint32_t *d, const uint32_t *a, const uint32_t *b,
+	size_t n, uint32_t h, size_t i0, size_t i1, int op)
+{
+	cttk_batch31_select();
+	DISPATCH_LOAD(addsub_impl)(d, a, b, n, h, i0, i1, op);
+}
+
+static void
+mul_first(uint32_t *d, const uint32_t *a, const uint32_t *b,
+	size_t n, uint32_t h, size_t i0, size_t i1, uint32_t *t, int trunc)
+{
+	cttk_batch31_select();
+	DISPATCH_LOAD(mul_impl)(d, a, b, n, h, i0, i1, t, trunc);
+}
+
+static void
+cmp_first(int32_t *r, const uint32_t *a, const uint32_t *b,
+	size_t n, uint32_t h, size_t i0, size_t i1)
+{
+	cttk_batch31_select();
+	DISPATCH_LOAD(cmp_impl)(r, a, b, n, h, i0, i1);
+}
+
+static void
+cond_copy_first(const cttk_bool *ctl,
+	uint32_t *d, const uint32_t *s, size_t n, uint32_t h,
+	size_t i0, size_t i1)
+{
+	cttk_batch31_select();
+	DISPATCH_LOAD(cond_copy_impl)(ctl, d, s, n, h, i0, i1);
+}
+
+/* ==================================================================== */
+
+/* see cttk.h */
+void
+cttk_i31_batch_init(uint32_t *b, unsigned size, size_t num)
+{
+	uint32_t h;
+	size_t i, len;
+
+	STATS_I31(BATCH);
+	h = (uint32_t)size + ((uint32_t)size / 31);
+	len = (h + 31) >> 5;
+	b[0] = h;
+	b[1] = (uint32_t)num;
+	for (i = 0; i < num; i ++) {
+		b[2 + i] = h | 0x80000000;
+	}
+	memset(b + 2 + num, 0, len * num * sizeof(uint32_t));
+}
+
+/* see cttk.h */
+void
+cttk_i31_batch_set(uint32_t *b, size_t idx, const uint32_t *x)
+{
+	size_t k, n, len;
+	uint32_t h;
+
+	STATS_I31(BATCH);
+	h = b[0];
+	n = b[1];
+	if (idx >= n) {
+		return;
+	}
+	if (((x[0] ^ h) & 0x7FFFFFFF) != 0) {
+		b[2 + idx] = h | 0x80000000;
+		return;
+	}
+	len = (h + 31) >> 5;
+	for (k = 0; k <= len; k ++) {
+		b[2 + k * n + idx] = x[k];
+	}
+}
+
+/* see cttk.h */
+void
+cttk_i31_batch_get(uint32_t *x, const uint32_t *b, size_t idx)
+{
+	size_t k, n, len;
+	uint32_t h;
+
+	STATS_I31(BATCH);
+	h = b[0];
+	n = b[1];
+	if (idx >= n || ((x[0] ^ h) & 0x7FFFFFFF) != 0) {
+		STATS_NAN_SIZE();
+		x[0] |= 0x80000000;
+		return;
+	}
+	len = (h + 31) >> 5;
+	for (k = 0; k <= len; k ++) {
+		x[k] = b[2 + k * n + idx];
+	}
+}
+
+static void
+batch_addsub(uint32_t *d, const uint32_t *a, const uint32_t *b, int op)
+{
+	if (!batch_check(d, a, b)) {
+		return;
+	}
+	DISPATCH_LOAD(addsub_impl)(d + 2, a + 2, b + 2,
+		d[1], d[0], 0, d[1], op);
+}
+
+/* see cttk.h */
+void
+cttk_i31_batch_add(uint32_t *d, const uint32_t *a, const uint32_t *b)
+{
+	STATS_I31(BATCH);
+	batch_addsub(d, a, b, 0);
+}
+
+/* see cttk.h */
+void
+cttk_i31_batch_add_trunc(uint32_t *d, const uint32_t *a, const uint32_t *b)
+{
+	STATS_I31(BATCH);
+	batch_addsub(d, a, b, OP_TRUNC);
+}
+
+/* see cttk.h */
+void
+cttk_i31_batch_sub(uint32_t *d, const uint32_t *a, const uint32_t *b)
+{
+	STATS_I31(BATCH);
+	batch_addsub(d, a, b, OP_SUB);
+}
+
+/* see cttk.h */
+void
+cttk_i31_batch_sub_trunc(uint32_t *d, const uint32_t *a, const uint32_t *b)
+{
+	STATS_I31(BATCH);
+	batch_addsub(d, a, b, OP_SUB | OP_TRUNC);
+}
+
+/*
+ * Maximum number of lanes processed jointly by a multiplication
+ * kernel; the temporary buffer must have room for MUL_GROUP*len words.
+ */
+#define MUL_GROUP   4
+
+static void
+batch_mul(uint32_t *d, const uint32_t *a, const uint32_t *b, int trunc)
+{
+	uint32_t t[CTTK_MAX_INT_BUF / sizeof(uint32_t)];
+	size_t len, tlen, n;
+	uint32_t h;
+
+	if (!batch_check(d, a, b)) {
+		return;
+	}
+	h = d[0];
+	n = d[1];
+	len = (h + 31) >> 5;
+
+	/*
+	 * If the temporary does not fit on the stack, then we try to
+	 * allocate it. If that fails, we process lanes one by one, which
+	 * needs only len words.
+	 */
+	tlen = MUL_GROUP * len;
+	if (tlen <= (sizeof t / sizeof t[0])) {
+		DISPATCH_LOAD(mul_impl)(d + 2, a + 2, b + 2,
+			n, h, 0, n, t, trunc);
+		return;
+	}
+#if !CTTK_NO_MALLOC
+	{
+		uint32_t *tt;
+
+		tt = cttk_scratch_alloc(tlen * sizeof *tt);
+		if (tt != NULL) {
+			DISPATCH_LOAD(mul_impl)(d + 2, a + 2, b + 2,
+				n, h, 0, n, tt, trunc);
+			free(tt);
+			return;
+		}
+	}
+#endif
+	if (len <= (sizeof t / sizeof t[0])) {
+		mul_lanes(d + 2, a + 2, b + 2, n, h, 0, n, t, trunc);
+	} else {
+		size_t i;
+
+		STATS_NAN_SCRATCH();
+		for (i = 0; i < n; i ++) {
+			d[2 + i] |= 0x80000000;
+		}
+	}
+}
+
+/* see cttk.h */
+void
+cttk_i31_batch_mul(uint32_t *d, const uint32_t *a, const uint32_t *b)
+{
+	STATS_I31(BATCH);
+	batch_mul(d, a, b, 0);
+}
+
+/* see cttk.h */
+void
+cttk_i31_batch_mul_trunc(uint32_t *d, const uint32_t *a, const uint32_t *b)
+{
+	STATS_I31(BATCH);
+	batch_mul(d, a, b, 1);
+}
+
+/* see cttk.h */
+void
+cttk_i31_batch_cmp(int32_t *r, const uint32_t *a, const uint32_t *b)
+{
+	size_t n;
+
+	STATS_I31(BATCH);
+	n = a[1];
+	if (a[0] != b[0] || n != b[1]) {
+		memset(r, 0, n * sizeof *r);
+		return;
+	}
+	DISPATCH_LOAD(cmp_impl)(r, a + 2, b + 2, n, a[0], 0, n);
+}
+
+/* see cttk.h */
+void
+cttk_i31_batch_cond_copy(const cttk_bool *ctl, uint32_t *d, const uint32_t *s)
+{
+	STATS_I31(BATCH);
+	if (!batch_check(d, s, NULL)) {
+		return;
+	}
+	DISPATCH_LOAD(cond_copy_impl)(ctl, d + 2, s + 2, d[1], d[0], 0, d[1]);
+}
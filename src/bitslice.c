@@ -0,0 +1,187 @@
+/*
+ * Copyright (c) 2018 Thomas Pornin <pornin@bolet.org>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining 
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be 
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, 
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND 
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "inner.h"
+
+/*
+ * Conversions to and from bitsliced representation.
+ *
+ * A batch of 'width' values of 'nbits' bits each is represented as
+ * 'nbits' slices; each slice consists of width/32 consecutive 32-bit
+ * words, and slice j holds bit j of all the values: bit j of value i
+ * is bit (i mod 32) of word (i / 32) of the slice. This layout does
+ * not depend on the endianness of the platform; 64-bit lanes are
+ * assembled from pairs of words, and SIMD registers (SSE2, AVX2)
+ * can be loaded directly from a slice.
+ *
+ * Each group of 32 values is converted with a 32x32 bit matrix
+ * transposition (five "swapmove" passes). Bytes use 8x8 transpositions
+ * over 64-bit words, which is cheaper.
+ */
+
+/*
+ * Transpose a 32x32 bit matrix: bit j of a[i] is exchanged with bit i
+ * of a[j].
+ */
+static void
+transpose32(uint32_t *a)
+{
+	static const uint32_t masks[] = {
+		0x0000FFFF, 0x00FF00FF, 0x0F0F0F0F, 0x33333333, 0x55555555
+	};
+	int s, j, k;
+
+	for (s = 0, j = 16; j != 0; s ++, j >>= 1) {
+		uint32_t m;
+
+		m = masks[s];
+		for (k = 0; k < 32; k = (k + j + 1) & ~j) {
+			uint32_t t;
+
+			t = ((a[k] >> j) ^ a[k + j]) & m;
+			a[k] ^= t << j;
+			a[k + j] ^= t;
+		}
+	}
+}
+
+/*
+ * Transpose an 8x8 bit matrix: byte i of the value is row i, and bit
+ * j of each byte is column j.
+ */
+static uint64_t
+transpose8(uint64_t x)
+{
+	uint64_t t;
+
+	t = (x ^ (x >> 7)) & (uint64_t)0x00AA00AA00AA00AA;
+	x ^= t ^ (t << 7);
+	t = (x ^ (x >> 14)) & (uint64_t)0x0000CCCC0000CCCC;
+	x ^= t ^ (t << 14);
+	t = (x ^ (x >> 28)) & (uint64_t)0x00000000F0F0F0F0;
+	x ^= t ^ (t << 28);
+	return x;
+}
+
+/* see cttk.h */
+void
+cttk_bitslice_in(uint32_t *q, const uint32_t *v,
+	size_t width, unsigned nbits)
+{
+	size_t nw, g;
+
+	nw = width >> 5;
+	for (g = 0; g < nw; g ++) {
+		uint32_t a[32];
+		unsigned j;
+
+		memcpy(a, v + (g << 5), sizeof a);
+		transpose32(a);
+		for (j = 0; j < nbits; j ++) {
+			q[j * nw + g] = a[j];
+		}
+	}
+}
+
+/* see cttk.h */
+void
+cttk_bitslice_out(uint32_t *v, const uint32_t *q,
+	size_t width, unsigned nbits)
+{
+	size_t nw, g;
+
+	nw = width >> 5;
+	for (g = 0; g < nw; g ++) {
+		uint32_t a[32];
+		unsigned j;
+
+		for (j = 0; j < 32; j ++) {
+			a[j] = j < nbits ? q[j * nw + g] : 0;
+		}
+		transpose32(a);
+		memcpy(v + (g << 5), a, sizeof a);
+	}
+}
+
+/* see cttk.h */
+void
+cttk_bitslice_in8(uint32_t *q, const void *src, size_t width)
+{
+	const unsigned char *buf;
+	size_t nw, g;
+
+	buf = src;
+	nw = width >> 5;
+	for (g = 0; g < nw; g ++) {
+		uint32_t w[8];
+		int i, j;
+
+		memset(w, 0, sizeof w);
+		for (i = 0; i < 4; i ++) {
+			uint64_t x;
+
+			x = 0;
+			for (j = 7; j >= 0; j --) {
+				x = (x << 8) | buf[j];
+			}
+			buf += 8;
+			x = transpose8(x);
+			for (j = 0; j < 8; j ++) {
+				w[j] |= (uint32_t)((x >> (8 * j)) & 0xFF)
+					<< (8 * i);
+			}
+		}
+		for (j = 0; j < 8; j ++) {
+			q[j * nw + g] = w[j];
+		}
+	}
+}
+
+/* see cttk.h */
+void
+cttk_bitslice_out8(void *dst, const uint32_t *q, size_t width)
+{
+	unsigned char *buf;
+	size_t nw, g;
+
+	buf = dst;
+	nw = width >> 5;
+	for (g = 0; g < nw; g ++) {
+		int i, j;
+
+		for (i = 0; i < 4; i ++) {
+			uint64_t x;
+
+			x = 0;
+			for (j = 7; j >= 0; j --) {
+				x = (x << 8) | ((q[j * nw + g] >> (8 * i)) & 0xFF);
+			}
+			x = transpose8(x);
+			for (j = 0; j < 8; j ++) {
+				buf[j] = (unsigned char)(x >> (8 * j));
+			}
+			buf += 8;
+		}
+	}
+}
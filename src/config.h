@@ -38,42 +38,22 @@
  */
 
 /*
- * If CTTK_CTMUL is set, then this is equivalent to setting all
- * of the following flags to the same value:
- *    CTTK_CTMUL32
- *    CTTK_CTMULU32W
- *    CTTK_CTMULS32W
- *    CTTK_CTMUL64
- * These flags can still be set individually, and will then override
- * the CTTK_CTMUL value.
+ * The flags that describe which multiplication opcodes are constant-time
+ * (CTTK_CTMUL, CTTK_CTMUL32, CTTK_CTMULU32W, CTTK_CTMULS32W and
+ * CTTK_CTMUL64) are in inc/cttk_config.h, since they must also be
+ * visible to the application code.
  */
 
 /*
- * If CTTK_CTMUL32 is set, then the 32-bit multiplication opcode (with
- * 32-bit result) is assumed to be constant-time.
+ * CTTK_SSE2 and CTTK_AVX2 control the use of the corresponding vector
+ * instructions (e.g. for conditional copies). SSE2 is used when the
+ * target architecture guarantees its availability; AVX2 code is
+ * compiled in when the compiler supports it, and used only if the CPU
+ * supports it (runtime test). Setting a flag to 0 disables the
+ * relevant code.
  *
-#define CTTK_CTMUL32   1
- */
-
-/*
- * If CTTK_CTMULU32W is set, then the 32x32->64 unsigned multiplication
- * is assumed to be constant-time.
- *
-#define CTTK_CTMULU32W   1
- */
-
-/*
- * If CTTK_CTMULS32W is set, then the 32x32->64 signed multiplication
- * is assumed to be constant-time.
- *
-#define CTTK_CTMULS32W   1
- */
-
-/*
- * If CTTK_CTMUL64 is set, then the 64-bit multiplication opcode (with
- * 64-bit result) is assumed to be constant-time.
- *
-#define CTTK_CTMUL64   1
+#define CTTK_SSE2   1
+#define CTTK_AVX2   1
  */
 
 /*
@@ -100,4 +80,26 @@
 #define CTTK_MAX_INT_BUF   4096
  */
 
+/*
+ * The CTTK_KARATSUBA_THRESHOLD macro defines the minimum length of big
+ * integer operands, in words (31-bit words for the i31 implementation),
+ * for which multiplications use Karatsuba's method instead of the
+ * schoolbook method. Both methods are constant-time; this setting only
+ * impacts performance, and the best value depends on the platform.
+ *
+ * Don't define this value to less than 4. Default is 16.
+ *
+#define CTTK_KARATSUBA_THRESHOLD   16
+ */
+
+/*
+ * If CTTK_STATS is set, then the library maintains per-thread
+ * statistics counters (calls to i31 functions, NaN results from size
+ * mismatches, heap allocations of temporaries, linear array scans),
+ * which can be obtained with cttk_stats_snapshot(). This has a small
+ * runtime cost. When not set (the default), no such code is compiled.
+ *
+#define CTTK_STATS   1
+ */
+
 #endif
@@ -0,0 +1,149 @@
+/*
+ * Copyright (c) 2018 Thomas Pornin <pornin@bolet.org>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "inner.h"
+
+#if CTTK_AVX2 && !defined _MSC_VER
+#include <cpuid.h>
+#endif
+
+/*
+ * Runtime selection of implementations. Modules with several code
+ * paths (oram1.c, hex.c, base64.c, batch31.c) keep function pointers
+ * that initially reference a function which selects the implementation
+ * (from cttk_cpu_features()) and then forwards the call. The probe
+ * result is cached in 'features'; CPU_UNKNOWN means "not probed yet".
+ * Concurrent first calls from several threads may all probe and store
+ * the (same) value, hence the atomic accesses (see inner.h).
+ *
+ * The big integer code (i15, i31, i63) has no entry here: it has no
+ * vector kernels, and its only platform-dependent choice is whether
+ * the multiplication opcodes are constant-time (CTTK_CTMUL*), which
+ * cannot be probed at runtime and remains a build-time setting.
+ */
+
+#define CPU_UNKNOWN   ((uint32_t)0x80000000)
+
+static uint32_t DISPATCH_VAR features = CPU_UNKNOWN;
+
+#if CTTK_AVX2
+
+/*
+ * Return 1 if the CPU and the OS support AVX2, 0 otherwise.
+ */
+static int
+has_avx2(void)
+{
+	uint32_t ecx, ebx, xcr0;
+
+#if defined _MSC_VER
+	int r[4];
+
+	__cpuid(r, 0);
+	if (r[0] < 7) {
+		return 0;
+	}
+	__cpuid(r, 1);
+	ecx = (uint32_t)r[2];
+	__cpuidex(r, 7, 0);
+	ebx = (uint32_t)r[1];
+	if (((ecx >> 27) & 1) == 0) {
+		return 0;
+	}
+	xcr0 = (uint32_t)_xgetbv(0);
+#else
+	unsigned eax, b, c, edx, xhi;
+
+	if (__get_cpuid_max(0, NULL) < 7) {
+		return 0;
+	}
+	__cpuid(1, eax, b, c, edx);
+	ecx = c;
+	__cpuid_count(7, 0, eax, b, c, edx);
+	ebx = b;
+	if (((ecx >> 27) & 1) == 0) {
+		return 0;
+	}
+	/* xgetbv, encoded as bytes for older assemblers */
+	__asm__ __volatile__ (".byte 0x0f, 0x01, 0xd0"
+		: "=a" (xcr0), "=d" (xhi) : "c" (0));
+	(void)xhi;
+#endif
+
+	/*
+	 * We need AVX (ECX bit 28 of leaf 1), AVX2 (EBX bit 5 of leaf 7),
+	 * and the OS must save the SSE and AVX states (XCR0 bits 1 and 2).
+	 */
+	return ((ecx >> 28) & 1) != 0
+		&& ((ebx >> 5) & 1) != 0
+		&& (xcr0 & 6) == 6;
+}
+
+#endif
+
+/*
+ * Get the features supported by the current CPU and used by this
+ * build.
+ */
+static uint32_t
+cpu_probe(void)
+{
+	uint32_t f;
+
+	f = 0;
+#if CTTK_SSE2
+	f |= CTTK_CPU_SSE2;
+#endif
+#if CTTK_AVX2
+	if (has_avx2()) {
+		f |= CTTK_CPU_AVX2;
+	}
+#endif
+	return f;
+}
+
+/* see cttk.h */
+uint32_t
+cttk_cpu_features(void)
+{
+	uint32_t f;
+
+	f = DISPATCH_LOAD(features);
+	if (f == CPU_UNKNOWN) {
+		f = cpu_probe();
+		DISPATCH_STORE(features, f);
+	}
+	return f;
+}
+
+/* see cttk.h */
+void
+cttk_cpu_set_features(uint32_t mask)
+{
+	DISPATCH_STORE(features, cpu_probe() & mask);
+	cttk_oram1_select();
+	cttk_hex_select();
+	cttk_base64_select();
+	cttk_batch31_select();
+}
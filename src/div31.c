@@ -0,0 +1,411 @@
+/*
+ * Copyright (c) 2018 Thomas Pornin <pornin@bolet.org>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "inner.h"
+
+/*
+ * Divisor contexts: division of i31 integers by a fixed divisor b,
+ * with Barrett reduction. Let len be the number of value words of b,
+ * and L = 31*len. The absolute values of all operands are lower than
+ * 2^L. With mu = floor((2^(2*L) - 1) / |b|), the estimate
+ *
+ *    q' = floor(|a| * mu / 2^(2*L))
+ *
+ * is equal to floor(|a| / |b|) or to floor(|a| / |b|) - 1, regardless
+ * of the size of |b|; thus, a single conditional correction is needed.
+ * Signs are then applied so as to match the semantics of
+ * cttk_i31_divrem() and cttk_i31_mod().
+ *
+ * The divisor context layout is the following:
+ *
+ *    dc[0]                  header word of b (NaN flag set if invalid)
+ *    dc[1..len]             value words of b
+ *    dc[len+1..2*len]       |b| (unsigned, 31-bit words)
+ *    dc[2*len+1..4*len]     mu (unsigned, 31-bit words)
+ *
+ * Thus, the context starts with a copy of b, as a normal i31 integer.
+ */
+
+/*
+ * Set d to the absolute value of the len words of a, interpreted as a
+ * signed integer (two's complement) if neg = 0xFFFFFFFF, unchanged if
+ * neg = 0.
+ */
+static void
+cond_neg_words(uint32_t *d, const uint32_t *a, size_t len, uint32_t neg)
+{
+	size_t u;
+	uint32_t cc;
+
+	cc = neg & 1;
+	for (u = 0; u < len; u ++) {
+		uint32_t w;
+
+		w = (a[u] ^ (neg >> 1)) + cc;
+		d[u] = w & 0x7FFFFFFF;
+		cc = w >> 31;
+	}
+}
+
+/*
+ * Subtract m from x (len words) if c = 1, or if x >= m. The returned
+ * value is 1 if the subtraction was performed, 0 otherwise.
+ */
+static uint32_t
+cond_sub(uint32_t *x, uint32_t c, const uint32_t *m, size_t len)
+{
+	size_t u;
+	uint32_t cc, mask;
+
+	cc = 0;
+	for (u = 0; u < len; u ++) {
+		cc = (x[u] - m[u] - cc) >> 31;
+	}
+	mask = c | (cc ^ 1);
+	cc = 0;
+	for (u = 0; u < len; u ++) {
+		uint32_t w;
+
+		w = x[u] - (m[u] & -mask) - cc;
+		x[u] = w & 0x7FFFFFFF;
+		cc = w >> 31;
+	}
+	return mask;
+}
+
+/*
+ * Length of the temporary buffer for computing mu (len value words).
+ */
+static size_t
+mu_tmp_len(size_t len)
+{
+	return 3 * (2 * len + 2);
+}
+
+/*
+ * Compute mu (2*len words) from |b| (len words, nonzero), with a generic
+ * division of 2^(2*L) - 1 by |b|; t is a temporary of mu_tmp_len(len)
+ * words. The division is schoolbook (quadratic), and dominates the
+ * cost of cttk_d31_init(). Returned value is 1 on success, 0 on error (the division could
+ * not obtain its own temporaries).
+ */
+static uint32_t
+compute_mu(uint32_t *mu, const uint32_t *bm, size_t len, uint32_t *t)
+{
+	uint32_t *x, *y, *q;
+	size_t xlen, u;
+	unsigned size;
+
+	/*
+	 * Operands have 62*len+1 bits, i.e. 2*len+1 value words.
+	 */
+	xlen = 2 * len + 1;
+	size = (unsigned)(62 * len + 1);
+	x = t;
+	y = x + xlen + 1;
+	q = y + xlen + 1;
+	cttk_i31_init(x, size);
+	cttk_i31_init(y, size);
+	cttk_i31_init(q, size);
+	x[0] &= 0x7FFFFFFF;
+	y[0] &= 0x7FFFFFFF;
+	for (u = 0; u < 2 * len; u ++) {
+		x[u + 1] = 0x7FFFFFFF;
+	}
+	memcpy(y + 1, bm, len * sizeof *bm);
+	cttk_i31_div(q, x, y);
+	memcpy(mu, q + 1, 2 * len * sizeof *mu);
+	return (q[0] >> 31) ^ 1;
+}
+
+static uint32_t
+compute_mu_stack(uint32_t *mu, const uint32_t *bm, size_t len)
+{
+	uint32_t t[CTTK_MAX_INT_BUF / sizeof(uint32_t)];
+
+	return compute_mu(mu, bm, len, t);
+}
+
+/* see cttk.h */
+void
+cttk_d31_init(uint32_t *dc, const uint32_t *b)
+{
+	uint32_t h, nz, ok;
+	size_t len, u;
+	uint32_t *bm, *mu;
+
+	STATS_I31(DIV);
+	h = b[0] & 0x7FFFFFFF;
+	len = (h + 31) >> 5;
+	memmove(dc, b, (len + 1) * sizeof *b);
+	bm = dc + len + 1;
+	mu = dc + 2 * len + 1;
+
+	/*
+	 * The divisor must not be zero. For a zero divisor, the
+	 * context is NaN, and |b| is replaced with 1 (so that the
+	 * context contents remain consistent).
+	 */
+	cond_neg_words(bm, dc + 1, len, -(dc[len] >> 30));
+	nz = 0;
+	for (u = 0; u < len; u ++) {
+		nz |= bm[u];
+	}
+	ok = ((dc[0] >> 31) ^ 1) & ((nz | -nz) >> 31);
+	bm[0] |= ((nz | -nz) >> 31) ^ 1;
+
+	if (mu_tmp_len(len) <= (CTTK_MAX_INT_BUF / sizeof(uint32_t))) {
+		ok &= compute_mu_stack(mu, bm, len);
+	} else {
+#if CTTK_NO_MALLOC
+		ok = 0;
+#else
+		uint32_t *t;
+
+		t = cttk_scratch_alloc(mu_tmp_len(len) * sizeof(uint32_t));
+		if (t == NULL) {
+			ok = 0;
+		} else {
+			ok &= compute_mu(mu, bm, len, t);
+			free(t);
+		}
+#endif
+	}
+	dc[0] = h | ((ok ^ 1) << 31);
+}
+
+/*
+ * Length of the temporary buffer for division (len value words).
+ */
+static size_t
+divrem_tmp_len(size_t len)
+{
+	return 6 * len + cttk_i31_umul_tmp_len(len);
+}
+
+/*
+ * Division by a divisor context, with a temporary buffer of
+ * divrem_tmp_len(len) words. Sizes have been verified. Either q or r
+ * may be NULL. If mod is non-zero, then the remainder is made
+ * nonnegative.
+ */
+static void
+divrem_buf(uint32_t *q, uint32_t *r, const uint32_t *a, const uint32_t *dc,
+	uint32_t *t, int mod)
+{
+	uint32_t h, nan, sa, sq, cc, ctl;
+	size_t len, u, v;
+	const uint32_t *bm, *mu;
+	uint32_t *am, *z, *y, *qm;
+
+	h = dc[0] & 0x7FFFFFFF;
+	len = (h + 31) >> 5;
+	bm = dc + len + 1;
+	mu = dc + 2 * len + 1;
+	am = t;
+	z = am + len;
+	qm = z + 2 * len;
+	y = qm + len;
+	t = y + 2 * len;
+	nan = (a[0] | dc[0]) >> 31;
+	sa = -(a[len] >> 30);
+	sq = sa ^ -(dc[len] >> 30);
+
+	/*
+	 * |a| is computed in place after a plain copy, so that the
+	 * compiler sees am as initialised when it is read through
+	 * cttk_i31_umul_words() (GCC may otherwise warn when this
+	 * function is inlined into divrem_stack()).
+	 */
+	memcpy(am, a + 1, len * sizeof *a);
+	cond_neg_words(am, am, len, sa);
+
+	/*
+	 * z <- |a|*mu (3*len words), as two products of len words; the
+	 * quotient estimate qm is the upper len words.
+	 */
+	cttk_i31_umul_words(z, am, mu, len, t);
+	memset(qm, 0, len * sizeof *qm);
+	cttk_i31_umul_words(y, am, mu + len, len, t);
+	cc = 0;
+	for (u = 0; u < 2 * len; u ++) {
+		uint32_t w;
+
+		w = z[len + u] + y[u] + cc;
+		z[len + u] = w & 0x7FFFFFFF;
+		cc = w >> 31;
+	}
+
+	/*
+	 * Remainder estimate: |a| - qm*|b|, which is lower than 2*|b|,
+	 * hence lower than 2^L (since |b| <= 2^(size-1)); it is computed
+	 * over len words (in z, low words).
+	 */
+	memset(z, 0, len * sizeof *z);
+	for (u = 0; u < len; u ++) {
+		uint32_t qu;
+		uint64_t w;
+
+		qu = qm[u];
+		w = 0;
+		for (v = 0; u + v < len; v ++) {
+			w += (uint64_t)z[u + v] + mulu32w(qu, bm[v]);
+			z[u + v] = (uint32_t)w & 0x7FFFFFFF;
+			w >>= 31;
+		}
+	}
+	cc = 0;
+	for (u = 0; u < len; u ++) {
+		uint32_t w;
+
+		w = am[u] - z[u] - cc;
+		z[u] = w & 0x7FFFFFFF;
+		cc = w >> 31;
+	}
+
+	/*
+	 * Correction step: if the remainder is not lower than |b|,
+	 * subtract |b| and increment the quotient.
+	 */
+	ctl = cond_sub(z, 0, bm, len);
+	cc = ctl;
+	for (u = 0; u < len; u ++) {
+		uint32_t w;
+
+		w = qm[u] + cc;
+		qm[u] = w & 0x7FFFFFFF;
+		cc = w >> 31;
+	}
+
+	if (q != NULL) {
+		uint32_t over;
+
+		/*
+		 * The quotient absolute value is at most 2^(size-1); it
+		 * is representable unless it is positive and equal to
+		 * that value (MinValue divided by -1).
+		 */
+		over = (qm[len - 1] >> top_index(h)) & ~sq & 1;
+		cond_neg_words(q + 1, qm, len, sq);
+		q[0] = h | ((nan | over) << 31);
+	}
+	if (r != NULL) {
+		if (mod) {
+			/*
+			 * For a negative dividend and a non-zero remainder,
+			 * the result is |b| - |r|.
+			 */
+			uint32_t nz, w;
+
+			nz = 0;
+			for (u = 0; u < len; u ++) {
+				nz |= z[u];
+			}
+			ctl = sa & -((nz | -nz) >> 31);
+			cc = 0;
+			for (u = 0; u < len; u ++) {
+				w = bm[u] - z[u] - cc;
+				cc = w >> 31;
+				w = (z[u] & ~ctl) | (w & ctl);
+				r[u + 1] = w & 0x7FFFFFFF;
+			}
+		} else {
+			cond_neg_words(r + 1, z, len, sa);
+		}
+		r[0] = h | (nan << 31);
+	}
+}
+
+static void
+divrem_stack(uint32_t *q, uint32_t *r, const uint32_t *a, const uint32_t *dc,
+	int mod)
+{
+	uint32_t t[CTTK_MAX_INT_BUF / sizeof(uint32_t)];
+
+	divrem_buf(q, r, a, dc, t, mod);
+}
+
+/*
+ * Generic division by a divisor context: sizes are checked (on
+ * mismatch, q and r are set to NaN), and temporaries are obtained from
+ * the stack or the heap.
+ */
+static void
+divrem_gen(uint32_t *q, uint32_t *r, const uint32_t *a, const uint32_t *dc,
+	int mod)
+{
+	uint32_t h;
+	size_t len;
+
+	h = dc[0] & 0x7FFFFFFF;
+	len = (h + 31) >> 5;
+	if (h != (a[0] & 0x7FFFFFFF)
+		|| (q != NULL && h != (q[0] & 0x7FFFFFFF))
+		|| (r != NULL && h != (r[0] & 0x7FFFFFFF)))
+	{
+		STATS_NAN_SIZE();
+		goto fail;
+	}
+	if (divrem_tmp_len(len) <= (CTTK_MAX_INT_BUF / sizeof(uint32_t))) {
+		divrem_stack(q, r, a, dc, mod);
+		return;
+	}
+#if !CTTK_NO_MALLOC
+	{
+		uint32_t *t;
+
+		t = cttk_scratch_alloc(divrem_tmp_len(len) * sizeof(uint32_t));
+		if (t != NULL) {
+			divrem_buf(q, r, a, dc, t, mod);
+			free(t);
+			return;
+		}
+	}
+#endif
+
+fail:
+	if (q != NULL) {
+		q[0] |= 0x80000000;
+	}
+	if (r != NULL) {
+		r[0] |= 0x80000000;
+	}
+}
+
+/* see cttk.h */
+void
+cttk_d31_divrem(uint32_t *q, uint32_t *r,
+	const uint32_t *a, const uint32_t *dc)
+{
+	STATS_I31(DIV);
+	divrem_gen(q, r, a, dc, 0);
+}
+
+/* see cttk.h */
+void
+cttk_d31_mod(uint32_t *d, const uint32_t *a, const uint32_t *dc)
+{
+	STATS_I31(DIV);
+	divrem_gen(NULL, d, a, dc, 1);
+}
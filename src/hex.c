@@ -94,21 +94,288 @@ cttk_hexscan(const char *src, size_t src_len, int skipws)
 	return u;
 }
 
-/* see cttk.h */
-size_t
-cttk_hextobin_gen(void *dst, size_t dst_len,
-	const char *src, size_t src_len, const char **err, unsigned flags)
+/*
+ * Fast decoding path for hexadecimal strings with no whitespace. The
+ * kernels below decode as many full blocks as possible; each block of
+ * source characters is completely classified and converted with
+ * constant-time arithmetic (no table lookup, no data-dependent branch),
+ * and the only decision taken is whether the whole block consists of
+ * valid hexadecimal digits. When an invalid character is found, the
+ * kernel stops before that block, and the generic loop in
+ * cttk_hextobin_gen() processes the rest, so that error reporting is
+ * unchanged. As with the generic loop, timing leaks only the position
+ * of the first invalid character.
+ *
+ * Each kernel decodes up to 'len' bytes from '2*len' characters, and
+ * returns the number of decoded bytes. If 'dst' is NULL, then nothing
+ * is written, but the conversion is still performed (we need it to
+ * find the extent of the valid digits).
+ *
+ * Digit values are obtained as follows:
+ *
+ *  - For a decimal digit c (0x30 to 0x39), the value is c & 0x0F.
+ *  - Setting bit 5 maps uppercase letters to lowercase; for c | 0x20
+ *    in 0x61..0x66, the value is (c & 0x0F) + 9.
+ */
+
+/*
+ * Portable path: 8 characters are processed in a 64-bit word, with
+ * one character per byte lane. Range checks rely on the lane values
+ * being lower than 0x80, so that additions of constants lower than
+ * 0x80 never carry into the next lane; characters with the top bit
+ * set make the block invalid anyway.
+ */
+static size_t
+hexdec_words(unsigned char *dst, const unsigned char *src, size_t len)
+{
+	size_t v;
+
+	for (v = 0; (len - v) >= 4; v += 4) {
+		uint64_t x, l, dig, let, bad, m, w;
+		int i;
+
+		x = 0;
+		for (i = 7; i >= 0; i --) {
+			x = (x << 8) | (uint64_t)src[(v << 1) + i];
+		}
+
+		/*
+		 * In each lane, the top bit of 'dig' is set if the
+		 * character is in '0'..'9', and the top bit of 'let' is
+		 * set if it is in 'A'..'F' or 'a'..'f'.
+		 */
+		dig = (x + 0x5050505050505050) & ~(x + 0x4646464646464646);
+		l = x | 0x2020202020202020;
+		let = (l + 0x1F1F1F1F1F1F1F1F) & ~(l + 0x1919191919191919);
+		bad = (~(dig | let) | x) & 0x8080808080808080;
+		if (bad != 0) {
+			break;
+		}
+		m = (let >> 7) & 0x0101010101010101;
+		x = (x & 0x0F0F0F0F0F0F0F0F) + (m << 3) + m;
+
+		/*
+		 * Assemble pairs of digits into bytes, then gather the
+		 * four bytes in the low 32 bits.
+		 */
+		w = ((x & 0x000F000F000F000F) << 4)
+			| ((x >> 8) & 0x000F000F000F000F);
+		w = (w | (w >> 8)) & 0x0000FFFF0000FFFF;
+		w = (w | (w >> 16)) & 0xFFFFFFFF;
+		if (dst != NULL) {
+			dst[v + 0] = (unsigned char)w;
+			dst[v + 1] = (unsigned char)(w >> 8);
+			dst[v + 2] = (unsigned char)(w >> 16);
+			dst[v + 3] = (unsigned char)(w >> 24);
+		}
+	}
+	return v;
+}
+
+#if CTTK_SSE2
+
+/*
+ * SSE2 path: 16 characters per step. Signed byte comparisons
+ * automatically reject characters with the top bit set.
+ */
+static size_t
+hexdec_sse2(unsigned char *dst, const unsigned char *src, size_t len)
+{
+	size_t v;
+	__m128i c2F, c3A, c20, c60, c67, c0F, c09, cFF;
+
+	c2F = _mm_set1_epi8(0x2F);
+	c3A = _mm_set1_epi8(0x3A);
+	c20 = _mm_set1_epi8(0x20);
+	c60 = _mm_set1_epi8(0x60);
+	c67 = _mm_set1_epi8(0x67);
+	c0F = _mm_set1_epi8(0x0F);
+	c09 = _mm_set1_epi8(0x09);
+	cFF = _mm_set1_epi16(0x00FF);
+	for (v = 0; (len - v) >= 8; v += 8) {
+		__m128i x, l, dig, let, w;
+
+		x = _mm_loadu_si128((const __m128i *)(src + (v << 1)));
+		dig = _mm_and_si128(
+			_mm_cmpgt_epi8(x, c2F), _mm_cmpgt_epi8(c3A, x));
+		l = _mm_or_si128(x, c20);
+		let = _mm_and_si128(
+			_mm_cmpgt_epi8(l, c60), _mm_cmpgt_epi8(c67, l));
+		if (_mm_movemask_epi8(_mm_or_si128(dig, let)) != 0xFFFF) {
+			break;
+		}
+		x = _mm_add_epi8(_mm_and_si128(x, c0F),
+			_mm_and_si128(let, c09));
+		w = _mm_or_si128(
+			_mm_slli_epi16(_mm_and_si128(x, cFF), 4),
+			_mm_srli_epi16(x, 8));
+		if (dst != NULL) {
+			_mm_storel_epi64((__m128i *)(dst + v),
+				_mm_packus_epi16(w, w));
+		}
+	}
+	return v + hexdec_words(dst == NULL ? NULL : dst + v,
+		src + (v << 1), len - v);
+}
+
+#endif
+
+#if CTTK_AVX2
+
+/*
+ * AVX2 path: 32 characters per step.
+ */
+TARGET_AVX2
+static size_t
+hexdec_avx2(unsigned char *dst, const unsigned char *src, size_t len)
+{
+	size_t v;
+	__m256i c2F, c3A, c20, c60, c67, c0F, c09, cFF;
+
+	c2F = _mm256_set1_epi8(0x2F);
+	c3A = _mm256_set1_epi8(0x3A);
+	c20 = _mm256_set1_epi8(0x20);
+	c60 = _mm256_set1_epi8(0x60);
+	c67 = _mm256_set1_epi8(0x67);
+	c0F = _mm256_set1_epi8(0x0F);
+	c09 = _mm256_set1_epi8(0x09);
+	cFF = _mm256_set1_epi16(0x00FF);
+	for (v = 0; (len - v) >= 16; v += 16) {
+		__m256i x, l, dig, let, w;
+
+		x = _mm256_loadu_si256((const __m256i *)(src + (v << 1)));
+		dig = _mm256_and_si256(
+			_mm256_cmpgt_epi8(x, c2F), _mm256_cmpgt_epi8(c3A, x));
+		l = _mm256_or_si256(x, c20);
+		let = _mm256_and_si256(
+			_mm256_cmpgt_epi8(l, c60), _mm256_cmpgt_epi8(c67, l));
+		if (_mm256_movemask_epi8(_mm256_or_si256(dig, let)) != -1) {
+			break;
+		}
+		x = _mm256_add_epi8(_mm256_and_si256(x, c0F),
+			_mm256_and_si256(let, c09));
+		w = _mm256_or_si256(
+			_mm256_slli_epi16(_mm256_and_si256(x, cFF), 4),
+			_mm256_srli_epi16(x, 8));
+
+		/*
+		 * Packing works within each 128-bit lane; the two
+		 * relevant 64-bit quarters are then brought together.
+		 */
+		w = _mm256_permute4x64_epi64(_mm256_packus_epi16(w, w), 0x08);
+		if (dst != NULL) {
+			_mm_storeu_si128((__m128i *)(dst + v),
+				_mm256_castsi256_si128(w));
+		}
+	}
+	return v + hexdec_words(dst == NULL ? NULL : dst + v,
+		src + (v << 1), len - v);
+}
+
+#endif
+
+/*
+ * Below this length (in decoded bytes), the word-wise code is used
+ * directly.
+ */
+#define VEC_MIN   16
+
+typedef size_t (*hexdec_fn)(unsigned char *dst,
+	const unsigned char *src, size_t len);
+
+static size_t hexdec_first(unsigned char *dst,
+	const unsigned char *src, size_t len);
+
+/*
+ * Selected implementation, set on first use (see oram1.c).
+ */
+static hexdec_fn DISPATCH_VAR hexdec_impl = &hexdec_first;
+
+/* see inner.h */
+void
+cttk_hex_select(void)
+{
+	uint32_t f;
+	hexdec_fn fd;
+
+	f = cttk_cpu_features();
+	fd = &hexdec_words;
+#if CTTK_SSE2
+	if (f & CTTK_CPU_SSE2) {
+		fd = &hexdec_sse2;
+	}
+#endif
+#if CTTK_AVX2
+	if (f & CTTK_CPU_AVX2) {
+		fd = &hexdec_avx2;
+	}
+#endif
+	(void)f;
+	DISPATCH_STORE(hexdec_impl, fd);
+}
+
+static size_t
+hexdec_first(unsigned char *dst, const unsigned char *src, size_t len)
+{
+	cttk_hex_select();
+	return DISPATCH_LOAD(hexdec_impl)(dst, src, len);
+}
+
+/*
+ * Status codes for hexdec_run().
+ */
+#define DEC_OK     0
+#define DEC_BAD    1
+#define DEC_FULL   2
+
+/*
+ * Decode hexadecimal digits. This is the common code of the one-shot
+ * and streaming decoders. '*acc' contains the pending first digit of a
+ * byte (shifted by 4 bits), or -1 if there is none; it is updated.
+ * The number of produced bytes is written in '*out', and the index of
+ * the first unprocessed character in '*pos'.
+ *
+ * Returned value is DEC_OK if all characters were processed, DEC_BAD
+ * if the character at index '*pos' is invalid, or DEC_FULL if the
+ * hex digit at index '*pos' cannot be processed because the output
+ * buffer is full. The output buffer is considered full when receiving
+ * the first digit of a new byte, so that the byte (possibly padded)
+ * will fit when the second digit (or an invalid character) arrives
+ * in the same call. The second digit of a byte may still find a full
+ * buffer when the first digit was received in a previous call.
+ */
+static int
+hexdec_run(unsigned char *buf, size_t dst_len,
+	const unsigned char *src, size_t src_len, unsigned flags,
+	int *acc, size_t *pos, size_t *out)
 {
 	size_t u, v;
-	unsigned char *buf;
-	int halfbyte;
-	int acc;
+	int a, r;
 
-	buf = dst;
-	halfbyte = 0;
-	acc = 0;
+	a = *acc;
 	v = 0;
-	for (u = 0; u < src_len; u ++) {
+
+	/*
+	 * If whitespace is not tolerated, then we may use the fast
+	 * path for all full bytes that fit in the output buffer; it
+	 * stops before any invalid character, which the loop below
+	 * then handles.
+	 */
+	if ((flags & CTTK_HEX_SKIP_WS) == 0 && a < 0) {
+		size_t n;
+
+		n = src_len >> 1;
+		if (buf != NULL && n > dst_len) {
+			n = dst_len;
+		}
+		if (n < VEC_MIN) {
+			v = hexdec_words(buf, src, n);
+		} else {
+			v = DISPATCH_LOAD(hexdec_impl)(buf, src, n);
+		}
+	}
+	r = DEC_OK;
+	for (u = v << 1; u < src_len; u ++) {
 		int c, d;
 
 		/*
@@ -116,55 +383,78 @@ cttk_hextobin_gen(void *dst, size_t dst_len,
 		 * values are positive and bytes beyond 0x7F are not
 		 * considered whitespace.
 		 */
-		c = *((const unsigned char *)src + u);
+		c = src[u];
 		d = cttk_hexval(c);
 
 		/*
 		 * If the character is not an hex digit, it may be
 		 * whitespace to be ignored; otherwise, this is an
-		 * error to report. Padding of half-bytes must be applied
-		 * where necessary (in such a case, output buffer capacity
-		 * was already checked).
+		 * error to report.
 		 */
 		if (d < 0) {
 			if ((flags & CTTK_HEX_SKIP_WS) != 0 && c <= 32) {
 				continue;
 			}
-			if (err != NULL) {
-				*err = src + u;
-			}
-			if (halfbyte && (flags & CTTK_HEX_PAD_ODD) != 0) {
-				if (buf != NULL) {
-					buf[v] = acc;
-				}
-				v ++;
-			}
-			return v;
+			r = DEC_BAD;
+			break;
 		}
 
 		/*
 		 * We have a new digit. We either keep it in the accumulator
 		 * (first digit of the next byte) or store it into the output
 		 * buffer.
-		 *
-		 * Output buffer overflow is detected on the first digit,
-		 * not the second.
 		 */
-		if (halfbyte) {
+		if (buf != NULL && v == dst_len) {
+			r = DEC_FULL;
+			break;
+		}
+		if (a >= 0) {
 			if (buf != NULL) {
-				buf[v] = acc + d;
+				buf[v] = a + d;
 			}
 			v ++;
+			a = -1;
 		} else {
-			if (buf != NULL && v == dst_len) {
-				if (err != NULL) {
-					*err = src + u;
-				}
-				return v;
+			a = d << 4;
+		}
+	}
+	*acc = a;
+	*pos = u;
+	*out = v;
+	return r;
+}
+
+/* see cttk.h */
+size_t
+cttk_hextobin_gen(void *dst, size_t dst_len,
+	const char *src, size_t src_len, const char **err, unsigned flags)
+{
+	unsigned char *buf;
+	size_t u, v;
+	int acc;
+
+	buf = dst;
+	acc = -1;
+	switch (hexdec_run(buf, dst_len, (const unsigned char *)src,
+		src_len, flags, &acc, &u, &v))
+	{
+	case DEC_BAD:
+		/*
+		 * Padding of half-bytes must be applied where necessary
+		 * (output buffer capacity was already checked).
+		 */
+		if (acc >= 0 && (flags & CTTK_HEX_PAD_ODD) != 0) {
+			if (buf != NULL) {
+				buf[v] = acc;
 			}
-			acc = d << 4;
+			v ++;
 		}
-		halfbyte = !halfbyte;
+		/* fall through */
+	case DEC_FULL:
+		if (err != NULL) {
+			*err = src + u;
+		}
+		return v;
 	}
 
 	/*
@@ -174,7 +464,7 @@ cttk_hextobin_gen(void *dst, size_t dst_len,
 	 * depending on the relevant flag. Note that output buffer
 	 * capacity was already checked when that first digit was read.
 	 */
-	if (halfbyte) {
+	if (acc >= 0) {
 		if ((flags & CTTK_HEX_PAD_ODD) != 0) {
 			if (buf != NULL) {
 				buf[v] = acc;
@@ -193,6 +483,84 @@ cttk_hextobin_gen(void *dst, size_t dst_len,
 	return v;
 }
 
+/* see cttk.h */
+void
+cttk_hexdec_init(cttk_hexdec_context *hc, unsigned flags)
+{
+	hc->flags = flags;
+	hc->acc = -1;
+	hc->fail = 0;
+}
+
+/* see cttk.h */
+size_t
+cttk_hexdec_update(cttk_hexdec_context *hc, void *dst, size_t dst_len,
+	const char *src, size_t src_len, const char **err)
+{
+	unsigned char *buf;
+	size_t u, v;
+
+	if (hc->fail) {
+		if (err != NULL) {
+			*err = (src_len == 0) ? NULL : src;
+		}
+		return 0;
+	}
+	buf = dst;
+	switch (hexdec_run(buf, dst_len, (const unsigned char *)src,
+		src_len, hc->flags, &hc->acc, &u, &v))
+	{
+	case DEC_BAD:
+		hc->fail = 1;
+		if (hc->acc >= 0 && (hc->flags & CTTK_HEX_PAD_ODD) != 0
+			&& (buf == NULL || v < dst_len))
+		{
+			if (buf != NULL) {
+				buf[v] = hc->acc;
+			}
+			v ++;
+		}
+		hc->acc = -1;
+		/* fall through */
+	case DEC_FULL:
+		if (err != NULL) {
+			*err = src + u;
+		}
+		return v;
+	}
+	if (err != NULL) {
+		*err = NULL;
+	}
+	return v;
+}
+
+/* see cttk.h */
+cttk_bool
+cttk_hexdec_final(cttk_hexdec_context *hc,
+	void *dst, size_t dst_len, size_t *len)
+{
+	unsigned char *buf;
+	int fail;
+
+	buf = dst;
+	*len = 0;
+	fail = hc->fail;
+	if (hc->acc >= 0) {
+		if ((hc->flags & CTTK_HEX_PAD_ODD) == 0) {
+			fail = 1;
+		} else if (buf == NULL || dst_len > 0) {
+			if (buf != NULL) {
+				buf[0] = hc->acc;
+			}
+			*len = 1;
+		} else {
+			return cttk_false;
+		}
+	}
+	cttk_hexdec_init(hc, hc->flags);
+	return cttk_bool_of_u32(!fail);
+}
+
 /* see cttk.h */
 size_t
 cttk_bintohex_gen(char *dst, size_t dst_len,
@@ -252,3 +620,93 @@ cttk_bintohex_gen(char *dst, size_t dst_len,
 	dst[v] = 0;
 	return v;
 }
+
+/* see cttk.h */
+void
+cttk_i31_dechex(uint32_t *x, const char *src, size_t src_len,
+	const char **err, unsigned flags)
+{
+	cttk_i31_sink sk;
+	cttk_hexdec_context hc;
+	unsigned char tmp[65];
+	const char *e;
+	size_t n, u;
+
+	STATS_I31(TEXT);
+	/*
+	 * A first pass, without output, validates the string and gives
+	 * the number of bytes; it leaks nothing more than the decoding
+	 * itself. The string is then decoded again with the streaming
+	 * decoder, by chunks of 128 characters, and the bytes go
+	 * directly to their place in x. A chunk yields at most 64 bytes;
+	 * the extra byte in tmp[] is needed because the decoder reports
+	 * a full buffer upon the first digit of a byte that would not
+	 * fit.
+	 */
+	n = cttk_hextobin_gen(NULL, 0, src, src_len, &e, flags);
+	if (err != NULL) {
+		*err = e;
+	}
+	cttk_i31_sink_init(&sk, x, n << 3);
+	if (e != NULL) {
+		x[0] |= 0x80000000;
+		return;
+	}
+	cttk_hexdec_init(&hc, flags);
+	for (u = 0; u < src_len; u += n) {
+		size_t m;
+
+		n = (src_len - u) < 128 ? (src_len - u) : 128;
+		m = cttk_hexdec_update(&hc, tmp, sizeof tmp, src + u, n, NULL);
+		cttk_i31_sink_bytes(&sk, tmp, m);
+	}
+	cttk_hexdec_final(&hc, tmp, sizeof tmp, &n);
+	cttk_i31_sink_bytes(&sk, tmp, n);
+	memset(tmp, 0, sizeof tmp);
+	cttk_i31_sink_finish(&sk,
+		(flags & CTTK_I31_SIGNED) != 0, (flags & CTTK_I31_TRUNC) != 0);
+}
+
+/* see cttk.h */
+size_t
+cttk_i31_enchex(char *dst, size_t dst_len,
+	const uint32_t *x, size_t len, unsigned flags)
+{
+	unsigned char tmp[32];
+	size_t nd, u, v;
+	int uppercase;
+
+	STATS_I31(TEXT);
+	/*
+	 * Output is the same as cttk_bintohex_gen() over the output of
+	 * cttk_i31_encbe(); bytes are extracted by small blocks.
+	 */
+	if (dst == NULL) {
+		return len << 1;
+	}
+	if (dst_len == 0) {
+		return 0;
+	}
+	nd = len << 1;
+	if (nd > dst_len - 1) {
+		nd = dst_len - 1;
+	}
+	uppercase = (flags & CTTK_HEX_UPPERCASE) != 0;
+	for (u = 0, v = 0; v < nd; u += sizeof tmp) {
+		size_t k, j;
+
+		k = ((nd - v + 1) >> 1) < sizeof tmp
+			? ((nd - v + 1) >> 1) : sizeof tmp;
+		cttk_i31_encbe_part(tmp, x, len, u, k);
+		for (j = 0; j < k; j ++) {
+			dst[v ++] = cttk_hexdigit(tmp[j] >> 4, uppercase);
+			if (v < nd) {
+				dst[v ++] = cttk_hexdigit(tmp[j] & 15,
+					uppercase);
+			}
+		}
+	}
+	dst[v] = 0;
+	memset(tmp, 0, sizeof tmp);
+	return v;
+}
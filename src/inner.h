@@ -37,6 +37,59 @@
 #include <stdlib.h>
 #endif
 
+/*
+ * Statistics (see cttk_stats_snapshot() in cttk.h). The STATS_*()
+ * macros update the counters of the current thread; without CTTK_STATS,
+ * they expand to nothing. STATS_SCAN_BEGIN() and STATS_SCAN_END() frame
+ * linear array accesses; nested frames (a scan function that calls
+ * another one) are counted only once.
+ *
+ * Temporaries allocated on the heap go through cttk_scratch_alloc(),
+ * which is plain malloc() without CTTK_STATS; they are released with
+ * free().
+ */
+#ifndef CTTK_STATS
+#define CTTK_STATS   0
+#endif
+
+#if CTTK_STATS
+#if defined __STDC_VERSION__ && __STDC_VERSION__ >= 201112L
+#define CTTK_TLS   _Thread_local
+#elif defined __GNUC__ || defined __clang__
+#define CTTK_TLS   __thread
+#elif defined _MSC_VER
+#define CTTK_TLS   __declspec(thread)
+#else
+#define CTTK_TLS
+#endif
+
+extern CTTK_TLS cttk_stats cttk_stats_tls;
+
+void cttk_stats_scan_begin(size_t num, size_t bytes);
+void cttk_stats_scan_end(void);
+
+#define STATS_I31(group)     ((void)cttk_stats_tls.i31_calls[ \
+                             CTTK_STATS_I31_ ## group] ++)
+#define STATS_NAN_SIZE()     ((void)cttk_stats_tls.nan_size ++)
+#define STATS_NAN_SCRATCH()  ((void)cttk_stats_tls.nan_scratch ++)
+#define STATS_SCAN_BEGIN(num, bytes)   cttk_stats_scan_begin(num, bytes)
+#define STATS_SCAN_END()     cttk_stats_scan_end()
+
+#if !CTTK_NO_MALLOC
+void *cttk_scratch_alloc(size_t len);
+#endif
+#else
+#define STATS_I31(group)     ((void)0)
+#define STATS_NAN_SIZE()     ((void)0)
+#define STATS_NAN_SCRATCH()  ((void)0)
+#define STATS_SCAN_BEGIN(num, bytes)   ((void)0)
+#define STATS_SCAN_END()     ((void)0)
+
+#if !CTTK_NO_MALLOC
+#define cttk_scratch_alloc   malloc
+#endif
+#endif
+
 /*
  * We allow stack-based temporaries to use up to 4 kB of stack. With the i31
  * implementation, this is good for one integer up to 31713 bits.
@@ -45,21 +98,133 @@
 #define CTTK_MAX_INT_BUF   4096
 #endif
 
-#ifdef CTTK_CTMUL
-#ifndef CTTK_CTMUL32
-#define CTTK_CTMUL32     CTTK_CTMUL
+/*
+ * Multiplications of big integers switch to Karatsuba's method when
+ * operands have at least that many 31-bit words.
+ */
+#if !defined CTTK_KARATSUBA_THRESHOLD
+#define CTTK_KARATSUBA_THRESHOLD   16
 #endif
-#ifndef CTTK_CTMULU32W
-#define CTTK_CTMULU32W   CTTK_CTMUL
+
+/*
+ * SIMD support. CTTK_SSE2 is enabled when the target architecture
+ * guarantees the corresponding instructions. CTTK_AVX2 is enabled when
+ * the compiler can produce AVX2 code for individual functions; actual
+ * use is then conditioned on a runtime test.
+ */
+#ifndef CTTK_SSE2
+#if defined __SSE2__ || defined _M_X64 \
+	|| (defined _M_IX86_FP && _M_IX86_FP >= 2)
+#define CTTK_SSE2   1
+#else
+#define CTTK_SSE2   0
 #endif
-#ifndef CTTK_CTMULS32W
-#define CTTK_CTMULS32W   CTTK_CTMUL
 #endif
-#ifndef CTTK_CTMUL64
-#define CTTK_CTMUL64     CTTK_CTMUL
+
+#ifndef CTTK_AVX2
+#if (defined __x86_64__ || defined __i386__) && (defined __clang__ \
+	|| (defined __GNUC__ && (__GNUC__ > 4 \
+	|| (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))))
+#define CTTK_AVX2   1
+#elif (defined _M_X64 || defined _M_IX86) && _MSC_VER >= 1900
+#define CTTK_AVX2   1
+#else
+#define CTTK_AVX2   0
+#endif
+#endif
+
+#if CTTK_AVX2
+#include <immintrin.h>
+#if defined _MSC_VER
+#include <intrin.h>
 #endif
+#elif CTTK_SSE2
+#include <emmintrin.h>
 #endif
 
+#if CTTK_AVX2
+/*
+ * AVX2 code is compiled only in functions tagged with TARGET_AVX2.
+ * Such functions must be used only if cttk_cpu_features() reports
+ * CTTK_CPU_AVX2.
+ */
+#if defined __GNUC__ || defined __clang__
+#define TARGET_AVX2   __attribute__((target("avx2")))
+#else
+#define TARGET_AVX2
+#endif
+#endif
+
+/*
+ * Implementation selection for modules with several code paths: each
+ * function sets the module function pointers from the current value
+ * of cttk_cpu_features(). They are called upon first use, and by
+ * cttk_cpu_set_features().
+ */
+void cttk_oram1_select(void);
+void cttk_hex_select(void);
+void cttk_base64_select(void);
+void cttk_batch31_select(void);
+
+/*
+ * The selection state (cached CPU features, module function pointers)
+ * is set lazily, so it may be written and read concurrently by several
+ * threads; all accesses go through DISPATCH_LOAD() and DISPATCH_STORE().
+ * Only the values themselves are shared (nothing else is published
+ * through them), hence relaxed ordering is sufficient. Without the
+ * GCC/Clang atomic builtins, the variables are qualified volatile
+ * (DISPATCH_VAR); aligned pointer-sized accesses are then atomic on
+ * all supported platforms.
+ */
+#if defined __GNUC__ || defined __clang__
+#define DISPATCH_VAR
+#define DISPATCH_LOAD(x)       __atomic_load_n(&(x), __ATOMIC_RELAXED)
+#define DISPATCH_STORE(x, v)   __atomic_store_n(&(x), (v), __ATOMIC_RELAXED)
+#else
+#define DISPATCH_VAR           volatile
+#define DISPATCH_LOAD(x)       (x)
+#define DISPATCH_STORE(x, v)   ((x) = (v))
+#endif
+
+/*
+ * Unsigned product of two sequences of n 31-bit words (no header), with
+ * Karatsuba's method above CTTK_KARATSUBA_THRESHOLD words (see int31.c).
+ * The 2*n result words are written in d, which must not overlap with a
+ * or b; t is a temporary area of cttk_i31_umul_tmp_len(n) words.
+ */
+void cttk_i31_umul_words(uint32_t *d, const uint32_t *a, const uint32_t *b,
+	size_t n, uint32_t *t);
+size_t cttk_i31_umul_tmp_len(size_t n);
+
+/*
+ * Incremental decoding into an i31 integer (see int31.c); this is used
+ * by the text decoders. The sink is initialised over x (which keeps
+ * its size but loses its value) for a big-endian source of num bits,
+ * which are then provided by chunks of bytes, most significant first.
+ * cttk_i31_sink_finish() applies the same rules as cttk_i31_decbe_*():
+ * sig is non-zero for a signed source, and trunc is non-zero for
+ * truncating decoding.
+ */
+typedef struct {
+	uint32_t *x;
+	size_t len;
+	size_t num, pos;
+	uint32_t sign;
+	cttk_bool ext0, ext1;
+} cttk_i31_sink;
+
+void cttk_i31_sink_init(cttk_i31_sink *sk, uint32_t *x, size_t num);
+void cttk_i31_sink_bytes(cttk_i31_sink *sk,
+	const unsigned char *buf, size_t len);
+void cttk_i31_sink_finish(cttk_i31_sink *sk, int sig, int trunc);
+
+/*
+ * Write in dst the bytes off to off+num-1 of the len-byte big-endian
+ * encoding of x, as produced by cttk_i31_encbe(dst, len, x).
+ */
+void cttk_i31_encbe_part(void *dst, const uint32_t *x,
+	size_t len, size_t off, size_t num);
+
 /* ==================================================================== */
 
 #if CTTK_CTMUL32
@@ -90,6 +255,31 @@ muls32(int32_t x, int32_t y)
 	return *(int32_t *)&r;
 }
 
+/*
+ * Product of two 15-bit unsigned values (used by the i15 big integers).
+ * The result fits on 30 bits, so the 32-bit multiplication opcode is
+ * sufficient; without CTTK_CTMUL32, the emulation loop only needs 15
+ * iterations.
+ */
+#if CTTK_CTMUL32
+#define mulu15(x, y)   ((uint32_t)((uint32_t)(x) * (uint32_t)(y)))
+#else
+static inline uint32_t
+mulu15(uint32_t x, uint32_t y)
+{
+	int i;
+	uint32_t z;
+
+	z = 0;
+	for (i = 0; i < 15; i ++) {
+		z += x & -(y & 1);
+		x <<= 1;
+		y >>= 1;
+	}
+	return z;
+}
+#endif
+
 #if CTTK_CTMULU32W
 #define mulu32w(x, y)   ((uint64_t)((uint64_t)(uint32_t)(x) \
                         * (uint64_t)(uint32_t)(y)))
@@ -162,6 +352,78 @@ muls64(int64_t x, int64_t y)
 	return *(int64_t *)&r;
 }
 
+/*
+ * mulu64w() computes the 128-bit product of two 64-bit unsigned integers;
+ * the low 64 bits are returned, and the high 64 bits are written in *hi.
+ * If CTTK_CTMUL64 is set, then the native 64x64->128 multiplication
+ * (when available) is assumed to be constant-time as well. Otherwise,
+ * the product is assembled from four 32x32->64 products.
+ */
+#if CTTK_CTMUL64 && defined __SIZEOF_INT128__
+static inline uint64_t
+mulu64w(uint64_t x, uint64_t y, uint64_t *hi)
+{
+	__extension__ unsigned __int128 z;
+
+	z = (unsigned __int128)x * (unsigned __int128)y;
+	*hi = (uint64_t)(z >> 64);
+	return (uint64_t)z;
+}
+#elif CTTK_CTMUL64 && defined _MSC_VER && defined _M_X64
+#include <intrin.h>
+static inline uint64_t
+mulu64w(uint64_t x, uint64_t y, uint64_t *hi)
+{
+	return _umul128(x, y, hi);
+}
+#else
+static inline uint64_t
+mulu64w(uint64_t x, uint64_t y, uint64_t *hi)
+{
+	uint32_t x0, x1, y0, y1;
+	uint64_t z00, z01, z10, z11, t;
+
+	x0 = (uint32_t)x;
+	x1 = (uint32_t)(x >> 32);
+	y0 = (uint32_t)y;
+	y1 = (uint32_t)(y >> 32);
+	z00 = mulu32w(x0, y0);
+	z01 = mulu32w(x0, y1);
+	z10 = mulu32w(x1, y0);
+	z11 = mulu32w(x1, y1);
+	t = (z00 >> 32) + (uint64_t)(uint32_t)z01 + (uint64_t)(uint32_t)z10;
+	*hi = z11 + (z01 >> 32) + (z10 >> 32) + (t >> 32);
+	return (t << 32) | (uint64_t)(uint32_t)z00;
+}
+#endif
+
+/* ==================================================================== */
+
+/*
+ * Get index of the top bit (sign bit) of an i31 integer, given its
+ * encoded size (header word, without the "NaN" flag). The returned
+ * index is relative to the top word.
+ */
+static inline unsigned
+top_index(uint32_t h)
+{
+	h = (h & 31) - 1;
+	return h + (31 & (h >> 5));
+}
+
+/*
+ * Sign-extend an n-bit value to 32 bits (1 <= n <= 32).
+ */
+static inline uint32_t
+signext(uint32_t v, unsigned n)
+{
+	uint32_t hi, lo;
+
+	hi = -(uint32_t)((v >> (n - 1)) & 1) << (n - 1);
+	lo = v & ((uint32_t)-1 >> (32 - n));
+	return hi | lo;
+}
+
 /* ==================================================================== */
 
 #endif
@@ -0,0 +1,3048 @@
+/*
+ * Copyright (c) 2018 Thomas Pornin <pornin@bolet.org>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "inner.h"
+
+/*
+ * Memory layout: a big integer is a sequence of 16 bit words.
+ * First word (header) contains (least to most significant order):
+ *
+ *    size % 15      4 bits, value is 0 to 14
+ *    size / 15      11 bits
+ *    NaN flag       1 bit (1 = NaN, 0 = not NaN)
+ *
+ * Further words contain the value, 15 bits per word, little-endian.
+ * The upper bit of each uint16_t is always 0. The sign bit is extended
+ * over the complete last word (excluding bit 15).
+ *
+ * If the NaN flag is set, then words may contain any value, with
+ * the following constraints:
+ *   - The top bit of each word (except the header word) is still 0.
+ *   - The header word is still fully defined.
+ *
+ * Size is not secret, so we can make conditional jumps based on that
+ * size. Since the header is a 16-bit word, the maximum size is 30719
+ * bits.
+ *
+ *
+ * Let h be the value of the header word, with the NaN flag masked out.
+ * Then:
+ *
+ *   - The number of value words is equal to: (h + 15) >> 4
+ *   - The bit length is: h - (h >> 4)
+ *
+ * This implementation mirrors the i31 code (int31.c); it is meant for
+ * architectures where the 32x32->64 multiplication is not constant-time
+ * (or not available), but the 32x32->32 multiplication is: products of
+ * 15-bit words fit on 30 bits. All computations use uint32_t
+ * temporaries; words are read as uint16_t and converted before any
+ * arithmetic operation, to avoid promotions to (signed) int. Column
+ * sums in products never exceed 2^32 since operands have at most 2048
+ * value words.
+ */
+
+/*
+ * Get index of the top bit (sign bit) given the encoded size (header
+ * word, without the "NaN" flag). The returned index is relative to
+ * the top word.
+ */
+static inline unsigned
+top_index15(uint32_t h)
+{
+	h = (h & 15) - 1;
+	return h + (15 & (h >> 4));
+}
+
+/*
+ * Product of two 15-bit values (the result fits on 30 bits).
+ */
+#define mul15(x, y)   mulu15((uint32_t)(x), (uint32_t)(y))
+
+/* see cttk.h */
+void
+cttk_i15_init(uint16_t *x, unsigned size)
+{
+	uint32_t h;
+
+	h = (uint32_t)size + ((uint32_t)size / 15);
+	*x = (uint16_t)(h | 0x8000);
+	memset(x + 1, 0, ((h + 15) >> 4) * sizeof *x);
+}
+
+/*
+ * Set the value words of x from the 64-bit value v, extended with
+ * copies of sx (0 or 1) beyond bit 63. The NaN flag of x must have been
+ * cleared. The value is truncated to the size of x; returned value is
+ * 1 if that truncation changed the value, 0 otherwise.
+ *
+ * A 64-bit value spans up to five 15-bit words; this generic routine
+ * is used by all the set_*() functions (the i31 code has a specialised
+ * version for each).
+ */
+static uint32_t
+set_w64(uint16_t *x, uint64_t v, uint32_t sx)
+{
+	uint32_t h, size;
+	size_t u, len;
+	uint64_t m;
+
+	h = x[0];
+	len = (h + 15) >> 4;
+	size = h - (h >> 4);
+	for (u = 0; u < len; u ++) {
+		uint32_t w;
+
+		if (u < 4) {
+			w = (uint32_t)(v >> (15 * u));
+		} else if (u == 4) {
+			w = (uint32_t)(v >> 60) | (-sx << 4);
+		} else {
+			w = -sx;
+		}
+		x[1 + u] = w & 0x7FFF;
+	}
+	x[len] = signext(x[len], top_index15(h) + 1) & 0x7FFF;
+
+	/*
+	 * The value fits if and only if all bits from the sign bit of x
+	 * upwards are equal to sx.
+	 */
+	if (size > 64) {
+		return 0;
+	}
+	m = (uint64_t)-1 << (size - 1);
+	return cttk_u64_neq0((v & m) ^ (m & -(uint64_t)sx)).v;
+}
+
+/*
+ * Get the low 64 bits of the value of x (extended with the sign bit,
+ * if x is smaller). This function ignores the NaN flag.
+ */
+static uint64_t
+get_w64(const uint16_t *x)
+{
+	uint32_t h;
+	size_t u, len;
+	uint64_t r;
+
+	h = x[0] & 0x7FFF;
+	len = (h + 15) >> 4;
+	r = 0;
+	for (u = 0; u < len && u < 5; u ++) {
+		r |= (uint64_t)x[1 + u] << (15 * u);
+	}
+	if (len < 5) {
+		r |= -(uint64_t)((uint32_t)x[len] >> 14) << (15 * len);
+	}
+	return r;
+}
+
+/* see cttk.h */
+void
+cttk_i15_set_u32(uint16_t *x, uint32_t v)
+{
+	x[0] &= 0x7FFF;
+	x[0] |= set_w64(x, v, 0) << 15;
+}
+
+/* see cttk.h */
+void
+cttk_i15_set_u32_trunc(uint16_t *x, uint32_t v)
+{
+	x[0] &= 0x7FFF;
+	set_w64(x, v, 0);
+}
+
+/* see cttk.h */
+void
+cttk_i15_set_u64(uint16_t *x, uint64_t v)
+{
+	x[0] &= 0x7FFF;
+	x[0] |= set_w64(x, v, 0) << 15;
+}
+
+/* see cttk.h */
+void
+cttk_i15_set_u64_trunc(uint16_t *x, uint64_t v)
+{
+	x[0] &= 0x7FFF;
+	set_w64(x, v, 0);
+}
+
+/* see cttk.h */
+void
+cttk_i15_set_s32(uint16_t *x, int32_t v)
+{
+	x[0] &= 0x7FFF;
+	x[0] |= set_w64(x, (uint64_t)(int64_t)v, (uint32_t)v >> 31) << 15;
+}
+
+/* see cttk.h */
+void
+cttk_i15_set_s64(uint16_t *x, int64_t v)
+{
+	x[0] &= 0x7FFF;
+	x[0] |= set_w64(x, (uint64_t)v, (uint32_t)((uint64_t)v >> 63)) << 15;
+}
+
+/* see cttk.h */
+void
+cttk_i15_set(uint16_t *d, const uint16_t *a)
+{
+	uint32_t h;
+	size_t dlen, alen;
+
+	/*
+	 * Special case: when source and operands are identical, there
+	 * is nothing more to do.
+	 */
+	if (a == d) {
+		return;
+	}
+
+	/*
+	 * We may now assume that operands do not overlap.
+	 */
+	h = a[0] & 0x7FFF;
+	alen = (h + 15) >> 4;
+
+	h = d[0] & 0x7FFF;
+	dlen = (h + 15) >> 4;
+	d[0] = h | (a[0] & 0x8000);
+
+	if (dlen > alen) {
+		size_t u;
+		uint32_t w;
+
+		memcpy(d + 1, a + 1, alen * sizeof *a);
+		w = -(uint32_t)(a[alen] >> 14) >> 17;
+		for (u = alen; u < dlen; u ++) {
+			d[1 + u] = w;
+		}
+	} else {
+		size_t u;
+		uint32_t w, m;
+
+		memcpy(d + 1, a + 1, dlen * sizeof *a);
+		m = -(uint32_t)(a[alen] >> 14) >> 17;
+		w = ((uint32_t)d[dlen] ^ m) & ((uint32_t)-1 << top_index15(h));
+		for (u = dlen; u < alen; u ++) {
+			w |= (uint32_t)a[u + 1] ^ m;
+		}
+		d[0] |= ((w | -w) >> 16) & 0x8000;
+	}
+}
+
+/* see cttk.h */
+void
+cttk_i15_set_trunc(uint16_t *d, const uint16_t *a)
+{
+	uint32_t h;
+	size_t dlen, alen;
+
+	/*
+	 * Special case: when source and operands are identical, there
+	 * is nothing more to do.
+	 */
+	if (a == d) {
+		return;
+	}
+
+	/*
+	 * We may now assume that operands do not overlap.
+	 */
+	h = a[0] & 0x7FFF;
+	alen = (h + 15) >> 4;
+
+	h = d[0] & 0x7FFF;
+	dlen = (h + 15) >> 4;
+	d[0] = h | (a[0] & 0x8000);
+
+	if (dlen > alen) {
+		size_t u;
+		uint32_t w;
+
+		memcpy(d + 1, a + 1, alen * sizeof *a);
+		w = -(uint32_t)(a[alen] >> 14) >> 17;
+		for (u = alen; u < dlen; u ++) {
+			d[1 + u] = w;
+		}
+	} else {
+		memcpy(d + 1, a + 1, dlen * sizeof *a);
+		d[dlen] = signext(d[dlen], top_index15(h) + 1) & 0x7FFF;
+	}
+}
+
+/* see cttk.h */
+uint32_t
+cttk_i15_to_u32_trunc(const uint16_t *x)
+{
+	return (uint32_t)get_w64(x) & (((uint32_t)x[0] >> 15) - 1);
+}
+
+/* see cttk.h */
+int32_t
+cttk_i15_to_s32_trunc(const uint16_t *x)
+{
+	uint32_t r;
+
+	r = cttk_i15_to_u32_trunc(x);
+	return *(int32_t *)&r;
+}
+
+/* see cttk.h */
+uint64_t
+cttk_i15_to_u64_trunc(const uint16_t *x)
+{
+	return get_w64(x) & ((uint64_t)((uint32_t)x[0] >> 15) - 1);
+}
+
+/* see cttk.h */
+int64_t
+cttk_i15_to_s64_trunc(const uint16_t *x)
+{
+	uint64_t r;
+
+	r = cttk_i15_to_u64_trunc(x);
+	return *(int64_t *)&r;
+}
+
+/*
+ * Generic decoding routine.
+ */
+static void
+gendec(uint16_t *x, const void *src, size_t src_len, int be, int sig, int trunc)
+{
+	uint32_t h, top, top2;
+	const unsigned char *buf;
+	size_t u, v, len;
+	unsigned ssb, ssx, k, hk, extra_bits, extra_bits_len;
+	cttk_bool in_range;
+
+	x[0] &= 0x7FFF;
+	h = x[0];
+	len = (h + 15) >> 4;
+	memset(x + 1, 0, len * sizeof *x);
+	if (src_len == 0) {
+		if (sig) {
+			x[0] |= 0x8000;
+		}
+		return;
+	}
+	buf = src;
+	hk = top_index15(h);
+
+	/*
+	 * 'ssb' is the value used for bytes beyond the source buffer.
+	 */
+	if (sig) {
+		if (be) {
+			ssb = -(unsigned)(buf[0] >> 7) & 0xFF;
+		} else {
+			ssb = -(unsigned)(buf[src_len - 1] >> 7) & 0xFF;
+		}
+	} else {
+		ssb = 0;
+	}
+
+	/*
+	 * u:k points to the next bits to fill in x (u is word index, k
+	 * is bit index).
+	 * v is source byte index (counting from 0 for least significant).
+	 */
+	u = 0;
+	k = 0;
+	v = 0;
+
+	/*
+	 * in_range is set to false if the value turns out to be out of
+	 * range (this is ignored if truncating). ssx is set to 0x00 or
+	 * 0xFF when the sign bit of x is reached.
+	 */
+	in_range = cttk_true;
+	ssx = 0;
+
+	/*
+	 * extra_bits / extra_bits_len will be set if there are extra bits
+	 * that must be checked against the final value sign.
+	 */
+	extra_bits = 0;
+	extra_bits_len = 0;
+
+	while (u < len || v < src_len) {
+		unsigned b;
+
+		/*
+		 * Get next byte of input in b.
+		 */
+		if (v < src_len) {
+			b = be ? buf[src_len - 1 - v] : buf[v];
+		} else {
+			b = ssb;
+		}
+		v ++;
+
+		if (u < len) {
+			if (k <= 7) {
+				x[1 + u] |= (uint32_t)b << k;
+			} else {
+				/*
+				 * A byte may span two words (but never
+				 * three). If we get beyond the last word
+				 * boundary then we may have some extra
+				 * bits which will have to be checked
+				 * against the value sign.
+				 */
+				x[1 + u] |= ((uint32_t)b << k) & 0x7FFF;
+				if ((u + 1) < len) {
+					x[2 + u] |= (uint32_t)b >> (15 - k);
+				} else {
+					extra_bits = (uint32_t)b >> (15 - k);
+					extra_bits_len = k - 7;
+				}
+			}
+
+			k += 8;
+			if (k >= 15) {
+				k -= 15;
+				u ++;
+				if (u == len) {
+					ssx = -(unsigned)((x[len] >> hk) & 1)
+						& 0xFF;
+				}
+			}
+		} else {
+			/*
+			 * If all words are filled, then we merely check
+			 * that extra bytes have a value compatible with
+			 * the range.
+			 */
+			in_range = cttk_and(in_range, cttk_u32_eq(b, ssx));
+		}
+	}
+
+	/*
+	 * We reach this point only when we filled all value words, and
+	 * read all source bytes. ssx has been set. Cleanup is the same
+	 * as in the i31 code.
+	 */
+	top = x[len];
+	top2 = signext(top, hk + 1) & 0x7FFF;
+	if (trunc) {
+		x[len] = top2;
+	} else {
+		in_range = cttk_and(in_range, cttk_u32_eq(top, top2));
+		if (extra_bits_len > 0) {
+			in_range = cttk_and(in_range, cttk_u32_eq(extra_bits,
+				ssx >> (8 - extra_bits_len)));
+		}
+		if (!sig) {
+			in_range = cttk_and(in_range, cttk_u32_eq0(ssx));
+		}
+		x[0] |= cttk_not(in_range).v << 15;
+	}
+}
+
+/*
+ * Generic encoding routine.
+ */
+static void
+genenc(void *dst, size_t dst_len, const uint16_t *x, int be)
+{
+	unsigned char *buf;
+	uint32_t h, acc, ssx;
+	unsigned mask, acc_len;
+	size_t u, len, v;
+
+	h = x[0];
+	mask = (h >> 15) - 1;
+	h &= 0x7FFF;
+	len = (h + 15) >> 4;
+
+	ssx = -(uint32_t)((x[len] >> top_index15(h)) & 1) >> 17;
+	acc = x[1];
+	acc_len = 15;
+	u = 1;
+	buf = dst;
+	for (v = 0; v < dst_len; v ++) {
+		unsigned b;
+
+		if (acc_len >= 8) {
+			b = acc & 0xFF;
+			acc >>= 8;
+			acc_len -= 8;
+		} else {
+			b = acc;
+			if (u < len) {
+				acc = x[1 + u];
+				u ++;
+			} else {
+				acc = ssx;
+			}
+			b |= acc << acc_len;
+			acc >>= (8 - acc_len);
+			acc_len += 7;
+		}
+		b &= mask;
+		if (be) {
+			buf[dst_len - 1 - v] = b;
+		} else {
+			buf[v] = b;
+		}
+	}
+}
+
+/* see cttk.h */
+void
+cttk_i15_decbe_signed(uint16_t *x, const void *src, size_t len)
+{
+	gendec(x, src, len, 1, 1, 0);
+}
+
+/* see cttk.h */
+void
+cttk_i15_decbe_unsigned(uint16_t *x, const void *src, size_t len)
+{
+	gendec(x, src, len, 1, 0, 0);
+}
+
+/* see cttk.h */
+void
+cttk_i15_decbe_signed_trunc(uint16_t *x, const void *src, size_t len)
+{
+	gendec(x, src, len, 1, 1, 1);
+}
+
+/* see cttk.h */
+void
+cttk_i15_decbe_unsigned_trunc(uint16_t *x, const void *src, size_t len)
+{
+	gendec(x, src, len, 1, 0, 1);
+}
+
+/* see cttk.h */
+void
+cttk_i15_decle_signed(uint16_t *x, const void *src, size_t len)
+{
+	gendec(x, src, len, 0, 1, 0);
+}
+
+/* see cttk.h */
+void
+cttk_i15_decle_unsigned(uint16_t *x, const void *src, size_t len)
+{
+	gendec(x, src, len, 0, 0, 0);
+}
+
+/* see cttk.h */
+void
+cttk_i15_decle_signed_trunc(uint16_t *x, const void *src, size_t len)
+{
+	gendec(x, src, len, 0, 1, 1);
+}
+
+/* see cttk.h */
+void
+cttk_i15_decle_unsigned_trunc(uint16_t *x, const void *src, size_t len)
+{
+	gendec(x, src, len, 0, 0, 1);
+}
+
+/* see cttk.h */
+void
+cttk_i15_encbe(void *dst, size_t len, const uint16_t *x)
+{
+	genenc(dst, len, x, 1);
+}
+
+/* see cttk.h */
+void
+cttk_i15_encle(void *dst, size_t len, const uint16_t *x)
+{
+	genenc(dst, len, x, 0);
+}
+
+/*
+ * Compare x with zero. This function ignores the NaN flag.
+ */
+static cttk_bool
+val_eq0(const uint16_t *x)
+{
+	uint32_t h, r;
+	size_t len, u;
+
+	h = x[0] & 0x7FFF;
+	len = (h + 15) >> 4;
+	r = 0;
+	for (u = 0; u < len; u ++) {
+		r |= x[u + 1];
+	}
+	return cttk_u32_eq0(r);
+}
+
+/*
+ * Test whether x is lower than zero. This function ignores the NaN
+ * flag.
+ */
+static cttk_bool
+val_lt0(const uint16_t *x)
+{
+	uint32_t h;
+	size_t len;
+
+	h = x[0] & 0x7FFF;
+	len = (h + 15) >> 4;
+	return cttk_bool_of_u32(((uint32_t)x[len] >> 14) & 1);
+}
+
+/*
+ * Get actual bitlength, i.e. minimal number of bits to hold the value,
+ * excluding the sign bit (hence, -1 has bitlength 0). This function
+ * ignores the NaN flag.
+ */
+static uint32_t
+real_bitlength(const uint16_t *x)
+{
+	uint32_t h, mx, t, g;
+	size_t len, u;
+	unsigned k;
+
+	h = x[0] & 0x7FFF;
+	len = (h + 15) >> 4;
+	k = top_index15(h);
+	mx = -(uint32_t)((x[len] >> k) & 1) >> 17;
+
+	/*
+	 * As in the i31 code: we normalize on the positive case, and
+	 * look for the index (g) and value (t) of the topmost non-zero
+	 * word.
+	 */
+	t = x[1];
+	g = 0;
+	for (u = 1; u < len; u ++) {
+		uint32_t w;
+		cttk_bool nz;
+
+		w = (uint32_t)x[u + 1] ^ mx;
+		nz = cttk_u32_neq0(w);
+		t = cttk_u32_mux(nz, w, t);
+		g = cttk_u32_mux(nz, (uint32_t)u, g);
+	}
+
+	return cttk_u32_bitlength(t) + (g << 4) - g;
+}
+
+/* see cttk.h */
+uint32_t
+cttk_i15_to_u32(const uint16_t *x)
+{
+	uint32_t r;
+
+	r = cttk_i15_to_u32_trunc(x);
+	r &= -cttk_u32_lt(real_bitlength(x), 33).v;
+	r &= val_lt0(x).v - 1;
+	return r;
+}
+
+/* see cttk.h */
+int32_t
+cttk_i15_to_s32(const uint16_t *x)
+{
+	uint32_t r;
+
+	r = cttk_i15_to_u32_trunc(x);
+	r &= -cttk_u32_lt(real_bitlength(x), 32).v;
+	return *(int32_t *)&r;
+}
+
+/* see cttk.h */
+uint64_t
+cttk_i15_to_u64(const uint16_t *x)
+{
+	uint64_t r;
+
+	r = cttk_i15_to_u64_trunc(x);
+	r &= -(uint64_t)cttk_u32_lt(real_bitlength(x), 65).v;
+	r &= (uint64_t)val_lt0(x).v - 1;
+	return r;
+}
+
+/* see cttk.h */
+int64_t
+cttk_i15_to_s64(const uint16_t *x)
+{
+	uint64_t r;
+
+	r = cttk_i15_to_u64_trunc(x);
+	r &= -(uint64_t)cttk_u64_lt(real_bitlength(x), 64).v;
+	return *(int64_t *)&r;
+}
+
+/* see cttk.h */
+cttk_bool
+cttk_i15_eq0(const uint16_t *x)
+{
+	return cttk_and(val_eq0(x), cttk_not(cttk_i15_isnan(x)));
+}
+
+/* see cttk.h */
+cttk_bool
+cttk_i15_neq0(const uint16_t *x)
+{
+	return cttk_not(cttk_or(val_eq0(x), cttk_i15_isnan(x)));
+}
+
+/* see cttk.h */
+cttk_bool
+cttk_i15_gt0(const uint16_t *x)
+{
+	return cttk_not(cttk_or(cttk_or(val_eq0(x), val_lt0(x)),
+		cttk_i15_isnan(x)));
+}
+
+/* see cttk.h */
+cttk_bool
+cttk_i15_lt0(const uint16_t *x)
+{
+	return cttk_and(val_lt0(x), cttk_not(cttk_i15_isnan(x)));
+}
+
+/* see cttk.h */
+cttk_bool
+cttk_i15_geq0(const uint16_t *x)
+{
+	return cttk_not(cttk_or(val_lt0(x), cttk_i15_isnan(x)));
+}
+
+/* see cttk.h */
+cttk_bool
+cttk_i15_leq0(const uint16_t *x)
+{
+	return cttk_and(cttk_or(val_eq0(x), val_lt0(x)),
+		cttk_not(cttk_i15_isnan(x)));
+}
+
+/*
+ * Test two integers for NaN. This function returns true is either or
+ * both are NaN.
+ */
+static inline cttk_bool
+tst_nan2(const uint16_t *x, const uint16_t *y)
+{
+	return cttk_bool_of_u32(((uint32_t)x[0] | (uint32_t)y[0]) >> 15);
+}
+
+/*
+ * Test whether two integers have distinct sizes (the NaN flags are
+ * ignored).
+ */
+static inline int
+size_neq(const uint16_t *x, const uint16_t *y)
+{
+	return ((x[0] ^ y[0]) & 0x7FFF) != 0;
+}
+
+/*
+ * Compare integers; this function assumes that both operands have the
+ * same size. The NaN flag of each value is ignored.
+ */
+static cttk_bool
+val_eq(const uint16_t *x, const uint16_t *y)
+{
+	size_t u, len;
+	uint32_t r;
+
+	len = ((x[0] & 0x7FFF) + 15) >> 4;
+	r = 0;
+	for (u = 0; u < len; u ++) {
+		r |= (uint32_t)x[1 + u] ^ (uint32_t)y[1 + u];
+	}
+	return cttk_u32_eq0(r);
+}
+
+/*
+ * Compare integers; this function assumes that both operands have the
+ * same size. The header word of each value is ignored.
+ */
+static cttk_bool
+val_lt(const uint16_t *x, const uint16_t *y)
+{
+	size_t u, len;
+	uint32_t cc;
+
+	len = ((x[0] & 0x7FFF) + 15) >> 4;
+	cc = 0;
+	for (u = 0; u < len; u ++) {
+		uint32_t wx, wy, wz;
+
+		wx = x[u + 1];
+		wy = y[u + 1];
+		wz = wx - wy - cc;
+		cc = (wz >> 31);
+	}
+
+	/*
+	 * See the i31 code for details: the XOR of the sign bits of x
+	 * and y, and of the carry, yields the sign of the result.
+	 */
+	cc ^= ((uint32_t)x[len] ^ (uint32_t)y[len]) >> 14;
+	return cttk_bool_of_u32(cc);
+}
+
+/*
+ * Generic integer comparison. This function assumes that both operands
+ * have the same size, and ignores the NaN flags. Returned value is
+ * -1, 0 or 1, converted to uint32_t.
+ */
+static uint32_t
+val_cmp(const uint16_t *x, const uint16_t *y)
+{
+	size_t u, len;
+	uint32_t cc, t;
+
+	len = ((x[0] & 0x7FFF) + 15) >> 4;
+	cc = 0;
+	t = 0;
+	for (u = 0; u < len; u ++) {
+		uint32_t wx, wy, wz;
+
+		wx = x[u + 1];
+		wy = y[u + 1];
+		wz = wx - wy - cc;
+		cc = (wz >> 31);
+		t |= wz;
+	}
+
+	/*
+	 * See val_lt() for details.
+	 */
+	cc ^= ((uint32_t)x[len] ^ (uint32_t)y[len]) >> 14;
+	return cttk_u32_neq0(t).v | -cc;
+}
+
+/* see cttk.h */
+cttk_bool
+cttk_i15_eq(const uint16_t *x, const uint16_t *y)
+{
+	if (size_neq(x, y)) {
+		return cttk_false;
+	}
+	return cttk_and(val_eq(x, y), cttk_not(tst_nan2(x, y)));
+}
+
+/* see cttk.h */
+cttk_bool
+cttk_i15_neq(const uint16_t *x, const uint16_t *y)
+{
+	if (size_neq(x, y)) {
+		return cttk_false;
+	}
+	return cttk_not(cttk_or(val_eq(x, y), tst_nan2(x, y)));
+}
+
+/* see cttk.h */
+cttk_bool
+cttk_i15_lt(const uint16_t *x, const uint16_t *y)
+{
+	if (size_neq(x, y)) {
+		return cttk_false;
+	}
+	return cttk_and(val_lt(x, y), cttk_not(tst_nan2(x, y)));
+}
+
+/* see cttk.h */
+cttk_bool
+cttk_i15_leq(const uint16_t *x, const uint16_t *y)
+{
+	if (size_neq(x, y)) {
+		return cttk_false;
+	}
+	return cttk_not(cttk_or(val_lt(y, x), tst_nan2(x, y)));
+}
+
+/* see cttk.h */
+cttk_bool
+cttk_i15_gt(const uint16_t *x, const uint16_t *y)
+{
+	if (size_neq(x, y)) {
+		return cttk_false;
+	}
+	return cttk_and(val_lt(y, x), cttk_not(tst_nan2(x, y)));
+}
+
+/* see cttk.h */
+cttk_bool
+cttk_i15_geq(const uint16_t *x, const uint16_t *y)
+{
+	if (size_neq(x, y)) {
+		return cttk_false;
+	}
+	return cttk_not(cttk_or(val_lt(x, y), tst_nan2(x, y)));
+}
+
+/* see cttk.h */
+int
+cttk_i15_sign(const uint16_t *x)
+{
+	uint32_t w;
+
+	w = (val_eq0(x).v ^ (uint32_t)1) | -val_lt0(x).v;
+	w &= ((uint32_t)x[0] >> 15) - 1;
+	return *(int32_t *)&w;
+}
+
+/* see cttk.h */
+int32_t
+cttk_i15_cmp(const uint16_t *x, const uint16_t *y)
+{
+	uint32_t w;
+
+	if (size_neq(x, y)) {
+		return 0;
+	}
+	w = val_cmp(x, y) & (uint32_t)(tst_nan2(x, y).v - 1);
+	return *(int32_t *)&w;
+}
+
+/* see cttk.h */
+void
+cttk_i15_copy(uint16_t *d, const uint16_t *s)
+{
+	if (d != s) {
+		if (size_neq(d, s)) {
+			d[0] |= 0x8000;
+			return;
+		}
+		memcpy(d, s, (((s[0] & 0x7FFF) + 31) >> 4) * sizeof *s);
+	}
+}
+
+/* see cttk.h */
+void
+cttk_i15_cond_copy(cttk_bool ctl, uint16_t *d, const uint16_t *s)
+{
+	cttk_i15_mux(ctl, d, s, d);
+}
+
+/* see cttk.h */
+void
+cttk_i15_swap(uint16_t *a, uint16_t *b)
+{
+	size_t u, len;
+
+	if (a == b) {
+		return;
+	}
+	if (size_neq(a, b)) {
+		a[0] |= 0x8000;
+		b[0] |= 0x8000;
+		return;
+	}
+	len = ((a[0] & 0x7FFF) + 31) >> 4;
+	for (u = 0; u < len; u ++) {
+		uint16_t w;
+
+		w = a[u];
+		a[u] = b[u];
+		b[u] = w;
+	}
+}
+
+/* see cttk.h */
+void
+cttk_i15_cond_swap(cttk_bool ctl, uint16_t *a, uint16_t *b)
+{
+	size_t u, len;
+
+	if (a == b) {
+		return;
+	}
+	if (size_neq(a, b)) {
+		a[0] |= 0x8000;
+		b[0] |= 0x8000;
+		return;
+	}
+	len = ((a[0] & 0x7FFF) + 31) >> 4;
+	for (u = 0; u < len; u ++) {
+		uint32_t wa, wb, wt;
+
+		wa = a[u];
+		wb = b[u];
+		wt = (wa ^ wb) & -ctl.v;
+		a[u] = wa ^ wt;
+		b[u] = wb ^ wt;
+	}
+}
+
+/* see cttk.h */
+void
+cttk_i15_mux(cttk_bool ctl, uint16_t *d, const uint16_t *a, const uint16_t *b)
+{
+	size_t u, len;
+
+	if (size_neq(d, a) || size_neq(d, b)) {
+		d[0] |= 0x8000;
+		return;
+	}
+	len = ((d[0] & 0x7FFF) + 31) >> 4;
+	for (u = 0; u < len; u ++) {
+		d[u] = cttk_u32_mux(ctl, a[u], b[u]);
+	}
+}
+
+/*
+ * Verify that d, a and b have the same size. On mismatch, d is set to
+ * NaN and 0 is returned.
+ */
+static inline int
+check_size3(uint16_t *d, const uint16_t *a, const uint16_t *b)
+{
+	if (size_neq(d, a) || size_neq(d, b)) {
+		d[0] |= 0x8000;
+		return 0;
+	}
+	return 1;
+}
+
+/* see cttk.h */
+void
+cttk_i15_add(uint16_t *d, const uint16_t *a, const uint16_t *b)
+{
+	uint32_t h, cc, tt;
+	size_t len, u;
+
+	if (!check_size3(d, a, b)) {
+		return;
+	}
+	h = d[0] & 0x7FFF;
+	len = (h + 15) >> 4;
+
+	/*
+	 * Since sizes are equal, we can simply OR together the header
+	 * words, which will propagate any NaN.
+	 */
+	d[0] = a[0] | b[0];
+
+	/*
+	 * Get the XOR of the top words of a[] and b[]. This must be
+	 * done now because either could be used as recipient.
+	 */
+	tt = (uint32_t)a[len] ^ (uint32_t)b[len];
+
+	cc = 0;
+	for (u = 0; u < len; u ++) {
+		uint32_t wa, wb, wd;
+
+		wa = a[u + 1];
+		wb = b[u + 1];
+		wd = wa + wb + cc;
+		d[u + 1] = wd & 0x7FFF;
+		cc = wd >> 15;
+	}
+
+	/*
+	 * Overflow/underflow: the mathematical sign of the result is the
+	 * XOR of the sign bits of a and b, and of the carry (see the
+	 * i31 code for details).
+	 */
+	d[0] |= ((((tt ^ d[len]) >> top_index15(h)) ^ cc) & 1) << 15;
+}
+
+/* see cttk.h */
+void
+cttk_i15_add_trunc(uint16_t *d, const uint16_t *a, const uint16_t *b)
+{
+	uint32_t h, cc;
+	size_t len, u;
+
+	if (!check_size3(d, a, b)) {
+		return;
+	}
+	h = d[0] & 0x7FFF;
+	len = (h + 15) >> 4;
+	d[0] = a[0] | b[0];
+	cc = 0;
+	for (u = 0; u < len; u ++) {
+		uint32_t wa, wb, wd;
+
+		wa = a[u + 1];
+		wb = b[u + 1];
+		wd = wa + wb + cc;
+		d[u + 1] = wd & 0x7FFF;
+		cc = wd >> 15;
+	}
+	d[len] = signext(d[len], top_index15(h) + 1) & 0x7FFF;
+}
+
+/* see cttk.h */
+void
+cttk_i15_sub(uint16_t *d, const uint16_t *a, const uint16_t *b)
+{
+	uint32_t h, cc, tt;
+	size_t len, u;
+
+	if (!check_size3(d, a, b)) {
+		return;
+	}
+	h = d[0] & 0x7FFF;
+	len = (h + 15) >> 4;
+	d[0] = a[0] | b[0];
+	tt = (uint32_t)a[len] ^ (uint32_t)b[len];
+	cc = 0;
+	for (u = 0; u < len; u ++) {
+		uint32_t wa, wb, wd;
+
+		wa = a[u + 1];
+		wb = b[u + 1];
+		wd = wa - wb - cc;
+		d[u + 1] = wd & 0x7FFF;
+		cc = wd >> 31;
+	}
+
+	/*
+	 * Same expression as for addition.
+	 */
+	d[0] |= ((((tt ^ d[len]) >> top_index15(h)) ^ cc) & 1) << 15;
+}
+
+/* see cttk.h */
+void
+cttk_i15_sub_trunc(uint16_t *d, const uint16_t *a, const uint16_t *b)
+{
+	uint32_t h, cc;
+	size_t len, u;
+
+	if (!check_size3(d, a, b)) {
+		return;
+	}
+	h = d[0] & 0x7FFF;
+	len = (h + 15) >> 4;
+	d[0] = a[0] | b[0];
+	cc = 0;
+	for (u = 0; u < len; u ++) {
+		uint32_t wa, wb, wd;
+
+		wa = a[u + 1];
+		wb = b[u + 1];
+		wd = wa - wb - cc;
+		d[u + 1] = wd & 0x7FFF;
+		cc = wd >> 31;
+	}
+	d[len] = signext(d[len], top_index15(h) + 1) & 0x7FFF;
+}
+
+/* see cttk.h */
+void
+cttk_i15_neg(uint16_t *d, const uint16_t *x)
+{
+	uint32_t h, cc, tt;
+	size_t u, len;
+
+	if (size_neq(d, x)) {
+		d[0] |= 0x8000;
+		return;
+	}
+	h = x[0] & 0x7FFF;
+	d[0] = x[0];
+	len = (h + 15) >> 4;
+	cc = 1;
+	tt = x[len];
+	for (u = 0; u < len; u ++) {
+		uint32_t w;
+
+		w = ((uint32_t)x[u + 1] ^ 0x7FFF) + cc;
+		d[u + 1] = w & 0x7FFF;
+		cc = w >> 15;
+	}
+
+	/*
+	 * We get an overflow if the source operand is equal to the
+	 * minimum value in the representable range. This is the
+	 * only situation where the sign bit of the source and of
+	 * the result are both 1.
+	 */
+	d[0] |= ((((uint32_t)d[len] & tt) >> top_index15(h)) & 1) << 15;
+}
+
+/* see cttk.h */
+void
+cttk_i15_neg_trunc(uint16_t *d, const uint16_t *x)
+{
+	uint32_t h, cc;
+	size_t u, len;
+
+	if (size_neq(d, x)) {
+		d[0] |= 0x8000;
+		return;
+	}
+	h = x[0] & 0x7FFF;
+	d[0] = x[0];
+	len = (h + 15) >> 4;
+	cc = 1;
+	for (u = 0; u < len; u ++) {
+		uint32_t w;
+
+		w = ((uint32_t)x[u + 1] ^ 0x7FFF) + cc;
+		d[u + 1] = w & 0x7FFF;
+		cc = w >> 15;
+	}
+	d[len] = signext(d[len], top_index15(h) + 1) & 0x7FFF;
+}
+
+/*
+ * Check the upper words of an exact result against the truncated
+ * value: only0 (only1) is true if all upper words are 0x0000 (0x7FFF),
+ * and wt is the top word of the exact result. The truncated value in d
+ * must also have the same sign as the exact result.
+ */
+static inline cttk_bool
+check_upper(const uint16_t *d, uint32_t h, size_t len,
+	cttk_bool only0, cttk_bool only1, uint32_t wt)
+{
+	uint32_t ssd;
+
+	ssd = -(wt >> 14) >> 17;
+	return cttk_and(
+		cttk_bool_of_u32(cttk_u32_mux(
+			cttk_bool_of_u32(ssd & 1), only1.v, only0.v)),
+		cttk_u32_eq0(((uint32_t)d[len] ^ ssd) >> top_index15(h)));
+}
+
+/*
+ * Generic multiplication routine; see genmul_separate() in the i31
+ * code for the semantics. This function:
+ *  - ignores the NaN flag;
+ *  - assumes that source and destination operands have the same size;
+ *  - assumes that the destination array is distinct from a and b (but
+ *    it may be equal to c).
+ */
+static cttk_bool
+genmul_separate(uint16_t *d, const uint16_t *a, const uint16_t *b,
+	const uint16_t *c)
+{
+	uint32_t h, ssa, ssb, ssc, wd, cc;
+	size_t u, v, len;
+	cttk_bool only0, only1;
+
+	h = d[0] & 0x7FFF;
+	len = (h + 15) >> 4;
+	ssa = -(uint32_t)(a[len] >> 14) >> 17;
+	ssb = -(uint32_t)(b[len] >> 14) >> 17;
+	ssc = c == NULL ? 0 : -(uint32_t)(c[len] >> 14) >> 17;
+	only0 = cttk_true;
+	only1 = cttk_true;
+
+	/*
+	 * The result is computed over 2*len words. Each column sum has
+	 * at most 2*len products, split into their low and high halves,
+	 * so that 32-bit accumulators are sufficient.
+	 */
+	cc = 0;
+	wd = 0;
+	for (u = 0; u < (len << 1); u ++) {
+		uint32_t zd;
+
+		zd = cc;
+		if (c != NULL) {
+			zd += u < len ? c[1 + u] : ssc;
+		}
+		cc = 0;
+		for (v = 0; v <= u; v ++) {
+			uint32_t wa, wb, zr;
+
+			wa = v < len ? a[1 + v] : ssa;
+			wb = (v + len) > u ? b[1 + u - v] : ssb;
+			zr = mul15(wa, wb);
+			zd += zr & 0x7FFF;
+			cc += zr >> 15;
+		}
+		cc += zd >> 15;
+		wd = zd & 0x7FFF;
+		if (u < len) {
+			d[1 + u] = wd;
+		} else {
+			only0 = cttk_and(only0, cttk_u32_eq0(wd));
+			only1 = cttk_and(only1, cttk_u32_eq0(wd ^ 0x7FFF));
+		}
+	}
+	return check_upper(d, h, len, only0, only1, wd);
+}
+
+/*
+ * Unsigned product of two sequences of n 15-bit words (little-endian
+ * order, no header). The result (2*n words) is written in d, which must
+ * not overlap with a or b.
+ */
+static void
+umul_school(uint16_t *d, const uint16_t *a, const uint16_t *b, size_t n)
+{
+	size_t u, v;
+
+	memset(d, 0, (n << 1) * sizeof *d);
+	for (u = 0; u < n; u ++) {
+		uint32_t au, cc;
+
+		au = a[u];
+		cc = 0;
+		for (v = 0; v < n; v ++) {
+			uint32_t z;
+
+			z = mul15(au, b[v]) + (uint32_t)d[u + v] + cc;
+			d[u + v] = z & 0x7FFF;
+			cc = z >> 15;
+		}
+		d[u + n] = cc;
+	}
+}
+
+/*
+ * Karatsuba threshold, in 15-bit words. Since the i15 words are half
+ * as large as the i31 words, the configured threshold is doubled.
+ */
+#define KARATSUBA_THRESHOLD15   (CTTK_KARATSUBA_THRESHOLD << 1)
+
+/*
+ * Get the size (in words) of the temporary area needed by umul_karatsuba()
+ * for operands of n words.
+ */
+static size_t
+karatsuba_tmp_len(size_t n)
+{
+	size_t tlen;
+
+	tlen = 0;
+	while (n >= KARATSUBA_THRESHOLD15) {
+		n = n - (n >> 1) + 1;
+		tlen += n << 2;
+	}
+	return tlen;
+}
+
+/*
+ * Unsigned product, as umul_school(), with Karatsuba's method for
+ * operands of at least KARATSUBA_THRESHOLD15 words. The temporary area t
+ * must have length at least karatsuba_tmp_len(n) words. See the i31
+ * code for details.
+ */
+static void
+umul_karatsuba(uint16_t *d, const uint16_t *a, const uint16_t *b,
+	size_t n, uint16_t *t)
+{
+	size_t n0, n1, u;
+	uint16_t *sa, *sb, *zm;
+	uint32_t ca, cb, cc;
+
+	if (n < KARATSUBA_THRESHOLD15) {
+		umul_school(d, a, b, n);
+		return;
+	}
+	n0 = n >> 1;
+	n1 = n - n0;
+	sa = t;
+	sb = sa + n1 + 1;
+	zm = sb + n1 + 1;
+	t = zm + ((n1 + 1) << 1);
+
+	ca = 0;
+	cb = 0;
+	for (u = 0; u < n1; u ++) {
+		uint32_t wa, wb;
+
+		wa = (uint32_t)a[n0 + u] + ca;
+		wb = (uint32_t)b[n0 + u] + cb;
+		if (u < n0) {
+			wa += a[u];
+			wb += b[u];
+		}
+		sa[u] = wa & 0x7FFF;
+		sb[u] = wb & 0x7FFF;
+		ca = wa >> 15;
+		cb = wb >> 15;
+	}
+	sa[n1] = ca;
+	sb[n1] = cb;
+
+	umul_karatsuba(d, a, b, n0, t);
+	umul_karatsuba(d + (n0 << 1), a + n0, b + n0, n1, t);
+	umul_karatsuba(zm, sa, sb, n1 + 1, t);
+
+	/*
+	 * zm <- zm - a0*b0 - a1*b1 = a0*b1 + a1*b0
+	 */
+	cc = 0;
+	for (u = 0; u < ((n1 + 1) << 1); u ++) {
+		uint32_t w;
+
+		w = (uint32_t)zm[u] - cc;
+		if (u < (n0 << 1)) {
+			w -= d[u];
+		}
+		zm[u] = w & 0x7FFF;
+		cc = w >> 31;
+	}
+	cc = 0;
+	for (u = 0; u < ((n1 + 1) << 1); u ++) {
+		uint32_t w;
+
+		w = (uint32_t)zm[u] - cc;
+		if (u < (n1 << 1)) {
+			w -= d[(n0 << 1) + u];
+		}
+		zm[u] = w & 0x7FFF;
+		cc = w >> 31;
+	}
+
+	/*
+	 * d <- d + zm*2^(15*n0)
+	 */
+	cc = 0;
+	for (u = 0; u < (n << 1) - n0; u ++) {
+		uint32_t w;
+
+		w = (uint32_t)d[n0 + u] + cc;
+		if (u < ((n1 + 1) << 1)) {
+			w += zm[u];
+		}
+		d[n0 + u] = w & 0x7FFF;
+		cc = w >> 15;
+	}
+}
+
+/*
+ * Multiplication with Karatsuba's method. This has the same semantics
+ * as genmul_separate(), except that d may be equal to a and/or b. The
+ * temporary area t must have length at least 2*len+karatsuba_tmp_len(len)
+ * words, where len is the number of value words in the operands.
+ */
+static cttk_bool
+genmul_karatsuba(uint16_t *d, const uint16_t *a, const uint16_t *b,
+	const uint16_t *c, uint16_t *t)
+{
+	uint32_t h, ssa, ssb, ssc, cc;
+	size_t u, len;
+	uint16_t *p;
+	cttk_bool only0, only1;
+
+	h = d[0] & 0x7FFF;
+	len = (h + 15) >> 4;
+	ssa = -(uint32_t)(a[len] >> 14) >> 17;
+	ssb = -(uint32_t)(b[len] >> 14) >> 17;
+
+	p = t;
+	umul_karatsuba(p, a + 1, b + 1, len, p + (len << 1));
+	cc = 0;
+	for (u = 0; u < len; u ++) {
+		uint32_t w;
+
+		w = (uint32_t)p[len + u] - ((uint32_t)b[1 + u] & ssa) - cc;
+		p[len + u] = w & 0x7FFF;
+		cc = w >> 31;
+	}
+	cc = 0;
+	for (u = 0; u < len; u ++) {
+		uint32_t w;
+
+		w = (uint32_t)p[len + u] - ((uint32_t)a[1 + u] & ssb) - cc;
+		p[len + u] = w & 0x7FFF;
+		cc = w >> 31;
+	}
+	if (c != NULL) {
+		ssc = -(uint32_t)(c[len] >> 14) >> 17;
+		cc = 0;
+		for (u = 0; u < (len << 1); u ++) {
+			uint32_t w;
+
+			w = (uint32_t)p[u] + (u < len ? c[1 + u] : ssc) + cc;
+			p[u] = w & 0x7FFF;
+			cc = w >> 15;
+		}
+	}
+
+	only0 = cttk_true;
+	only1 = cttk_true;
+	for (u = len; u < (len << 1); u ++) {
+		only0 = cttk_and(only0, cttk_u32_eq0(p[u]));
+		only1 = cttk_and(only1, cttk_u32_eq0(p[u] ^ 0x7FFF));
+	}
+	memcpy(d + 1, p, len * sizeof *d);
+	return check_upper(d, h, len, only0, only1, p[(len << 1) - 1]);
+}
+
+/*
+ * Get the length (in words) of the temporary buffer that allows
+ * genmul_buf() to use its fastest method, for operands with header h.
+ */
+static size_t
+genmul_tmp_len(uint32_t h)
+{
+	size_t len;
+
+	len = (h + 15) >> 4;
+	if (len >= KARATSUBA_THRESHOLD15) {
+		return (len << 1) + karatsuba_tmp_len(len);
+	}
+	return len + 1;
+}
+
+/*
+ * Verify operand sizes for a multiplication (with an optional addend c),
+ * and set the destination header. Returned value is 0 (and d is set to
+ * NaN) on size mismatch.
+ */
+static int
+genmul_check(uint16_t *d, const uint16_t *a, const uint16_t *b,
+	const uint16_t *c)
+{
+	if (size_neq(d, a) || size_neq(d, b) || (c != NULL && size_neq(d, c))) {
+		d[0] |= 0x8000;
+		return 0;
+	}
+	d[0] = a[0] | b[0] | (c == NULL ? 0 : c[0]);
+	return 1;
+}
+
+/*
+ * Multiplication (with optional addend c) with a caller-provided
+ * temporary t of tlen words (sizes have been verified). If the
+ * temporary is too small to handle an aliased destination, then d is
+ * set to NaN.
+ */
+static cttk_bool
+genmul_buf(uint16_t *d, const uint16_t *a, const uint16_t *b,
+	const uint16_t *c, uint16_t *t, size_t tlen)
+{
+	uint32_t h;
+	size_t len;
+	cttk_bool r;
+
+	h = d[0] & 0x7FFF;
+	len = (h + 15) >> 4;
+	if (len >= KARATSUBA_THRESHOLD15
+		&& tlen >= (len << 1) + karatsuba_tmp_len(len))
+	{
+		return genmul_karatsuba(d, a, b, c, t);
+	}
+	if (d != a && d != b) {
+		return genmul_separate(d, a, b, c);
+	}
+	if (tlen < len + 1) {
+		d[0] |= 0x8000;
+		return cttk_false;
+	}
+	t[0] = h;
+	memset(t + 1, 0, len * sizeof t[0]);
+	r = genmul_separate(t, a, b, c);
+	memcpy(d + 1, t + 1, len * sizeof *d);
+	return r;
+}
+
+/*
+ * Multiplication with a stack-based temporary.
+ */
+static cttk_bool
+genmul_stack(uint16_t *d, const uint16_t *a, const uint16_t *b,
+	const uint16_t *c)
+{
+	uint16_t t[CTTK_MAX_INT_BUF / sizeof(uint16_t)];
+
+	return genmul_buf(d, a, b, c, t, sizeof t / sizeof t[0]);
+}
+
+static cttk_bool
+genmul(uint16_t *d, const uint16_t *a, const uint16_t *b, const uint16_t *c)
+{
+	size_t tlen;
+
+	if (!genmul_check(d, a, b, c)) {
+		return cttk_false;
+	}
+
+	/*
+	 * If the temporary does not fit on the stack, then we try to
+	 * allocate it. If that fails, we use the stack anyway, which
+	 * implies falling back to the schoolbook method, if possible.
+	 */
+	tlen = genmul_tmp_len(d[0] & 0x7FFF);
+#if !CTTK_NO_MALLOC
+	if (tlen > (CTTK_MAX_INT_BUF / sizeof(uint16_t))) {
+		uint16_t *t;
+
+		t = cttk_scratch_alloc(tlen * sizeof *t);
+		if (t != NULL) {
+			cttk_bool r;
+
+			r = genmul_buf(d, a, b, c, t, tlen);
+			free(t);
+			return r;
+		}
+	}
+#else
+	(void)tlen;
+#endif
+	return genmul_stack(d, a, b, c);
+}
+
+/*
+ * Truncate the value of d (header included) to its size, by sign
+ * extension of the top word.
+ */
+static inline void
+trunc_top(uint16_t *d)
+{
+	uint32_t h;
+	size_t len;
+
+	h = d[0] & 0x7FFF;
+	len = (h + 15) >> 4;
+	d[len] = signext(d[len], top_index15(h) + 1) & 0x7FFF;
+}
+
+/* see cttk.h */
+void
+cttk_i15_mul(uint16_t *d, const uint16_t *a, const uint16_t *b)
+{
+	cttk_bool r;
+
+	r = genmul(d, a, b, NULL);
+	d[0] |= (r.v ^ 1) << 15;
+}
+
+/* see cttk.h */
+void
+cttk_i15_mul_trunc(uint16_t *d, const uint16_t *a, const uint16_t *b)
+{
+	genmul(d, a, b, NULL);
+	trunc_top(d);
+}
+
+/* see cttk.h */
+void
+cttk_i15_mul_ws(uint16_t *d, const uint16_t *a, const uint16_t *b,
+	uint16_t *tmp, size_t tmp_len)
+{
+	cttk_bool r;
+
+	if (!genmul_check(d, a, b, NULL)) {
+		return;
+	}
+	r = genmul_buf(d, a, b, NULL, tmp, tmp_len);
+	d[0] |= (r.v ^ 1) << 15;
+}
+
+/* see cttk.h */
+void
+cttk_i15_muladd(uint16_t *d, const uint16_t *a, const uint16_t *b,
+	const uint16_t *c)
+{
+	cttk_bool r;
+
+	r = genmul(d, a, b, c);
+	d[0] |= (r.v ^ 1) << 15;
+}
+
+/* see cttk.h */
+void
+cttk_i15_muladd_trunc(uint16_t *d, const uint16_t *a, const uint16_t *b,
+	const uint16_t *c)
+{
+	genmul(d, a, b, c);
+	trunc_top(d);
+}
+
+/*
+ * Multiplication by a small scalar: d <- a*x + c, where c is either
+ * NULL (no addend) or equal to d. Sizes must have been verified. As in
+ * the i31 code, d may also be equal to a. Returned value is true if and
+ * only if the result was not truncated.
+ *
+ * The 32-bit scalar is split into three words (15, 15 and 2 bits), so
+ * that only 15x15 products are used; the exact result then fits on
+ * len+3 words.
+ */
+static cttk_bool
+genmul_u32(uint16_t *d, const uint16_t *a, uint32_t x, const uint16_t *c)
+{
+	uint32_t h, ssa, ssc, wd, cc, a0, a1, a2;
+	uint32_t xw[3];
+	size_t u, len;
+	cttk_bool only0, only1;
+
+	h = d[0] & 0x7FFF;
+	len = (h + 15) >> 4;
+	ssa = -(uint32_t)(a[len] >> 14) >> 17;
+	ssc = c == NULL ? 0 : -(uint32_t)(c[len] >> 14) >> 17;
+	xw[0] = x & 0x7FFF;
+	xw[1] = (x >> 15) & 0x7FFF;
+	xw[2] = x >> 30;
+	only0 = cttk_true;
+	only1 = cttk_true;
+
+	/*
+	 * a0, a1 and a2 are the words of a of index u, u-1 and u-2,
+	 * respectively (a2 and a1 are shifted in from a0 since d[1+u]
+	 * may overwrite a[1+u]).
+	 */
+	cc = 0;
+	wd = 0;
+	a1 = 0;
+	a2 = 0;
+	for (u = 0; u < len + 3; u ++) {
+		uint32_t zd, zr;
+
+		a0 = u < len ? a[1 + u] : ssa;
+		zd = cc;
+		if (c != NULL) {
+			zd += u < len ? c[1 + u] : ssc;
+		}
+		zr = mul15(a0, xw[0]);
+		zd += zr & 0x7FFF;
+		cc = zr >> 15;
+		zr = mul15(a1, xw[1]);
+		zd += zr & 0x7FFF;
+		cc += zr >> 15;
+		zr = mul15(a2, xw[2]);
+		zd += zr & 0x7FFF;
+		cc += zr >> 15;
+		cc += zd >> 15;
+		wd = zd & 0x7FFF;
+		if (u < len) {
+			d[1 + u] = wd;
+		} else {
+			only0 = cttk_and(only0, cttk_u32_eq0(wd));
+			only1 = cttk_and(only1, cttk_u32_eq0(wd ^ 0x7FFF));
+		}
+		a2 = a1;
+		a1 = a0;
+	}
+	return check_upper(d, h, len, only0, only1, wd);
+}
+
+/*
+ * Verify operand sizes for a multiplication by a small scalar, and set
+ * the destination header (if add is non-zero, then the current value
+ * of d is the addend). Returned value is 0 (and d is set to NaN) on
+ * size mismatch.
+ */
+static int
+genmul_u32_check(uint16_t *d, const uint16_t *a, int add)
+{
+	if (size_neq(d, a)) {
+		d[0] |= 0x8000;
+		return 0;
+	}
+	d[0] = add ? (d[0] | a[0]) : a[0];
+	return 1;
+}
+
+/* see cttk.h */
+void
+cttk_i15_mul_u32(uint16_t *d, const uint16_t *a, uint32_t x)
+{
+	cttk_bool r;
+
+	if (!genmul_u32_check(d, a, 0)) {
+		return;
+	}
+	r = genmul_u32(d, a, x, NULL);
+	d[0] |= (r.v ^ 1) << 15;
+}
+
+/* see cttk.h */
+void
+cttk_i15_mul_u32_trunc(uint16_t *d, const uint16_t *a, uint32_t x)
+{
+	if (!genmul_u32_check(d, a, 0)) {
+		return;
+	}
+	genmul_u32(d, a, x, NULL);
+	trunc_top(d);
+}
+
+/* see cttk.h */
+void
+cttk_i15_addmul_u32(uint16_t *d, const uint16_t *a, uint32_t x)
+{
+	cttk_bool r;
+
+	if (!genmul_u32_check(d, a, 1)) {
+		return;
+	}
+	r = genmul_u32(d, a, x, d);
+	d[0] |= (r.v ^ 1) << 15;
+}
+
+/* see cttk.h */
+void
+cttk_i15_addmul_u32_trunc(uint16_t *d, const uint16_t *a, uint32_t x)
+{
+	if (!genmul_u32_check(d, a, 1)) {
+		return;
+	}
+	genmul_u32(d, a, x, d);
+	trunc_top(d);
+}
+
+/*
+ * Set m (len words, no header) to the absolute value of a. Since a fits
+ * on h bits, its absolute value fits on h-1 bits, and the len value
+ * words are enough even for the minimal value.
+ */
+static void
+abs_words(uint16_t *m, const uint16_t *a, size_t len)
+{
+	uint32_t ss, cc;
+	size_t u;
+
+	ss = -(uint32_t)(a[len] >> 14) >> 17;
+	cc = ss & 1;
+	for (u = 0; u < len; u ++) {
+		uint32_t w;
+
+		w = ((uint32_t)a[1 + u] ^ ss) + cc;
+		m[u] = w & 0x7FFF;
+		cc = w >> 15;
+	}
+}
+
+/*
+ * Generic squaring routine. The absolute value of the source must have
+ * been written in m (len words, see abs_words()). Each cross product
+ * m[i]*m[j] (with i != j) is computed only once, then doubled.
+ */
+static cttk_bool
+gensqr_separate(uint16_t *d, const uint16_t *m)
+{
+	uint32_t h, cc;
+	size_t u, v, len;
+	cttk_bool only0;
+
+	h = d[0] & 0x7FFF;
+	len = (h + 15) >> 4;
+	only0 = cttk_true;
+
+	cc = 0;
+	for (u = 0; u < (len << 1); u ++) {
+		uint32_t wd, zd, zh, zr;
+
+		zd = 0;
+		zh = 0;
+		for (v = u < len ? 0 : u + 1 - len; (v << 1) < u; v ++) {
+			zr = mul15(m[v], m[u - v]);
+			zd += zr & 0x7FFF;
+			zh += zr >> 15;
+		}
+		zd <<= 1;
+		zh <<= 1;
+		if ((u & 1) == 0) {
+			zr = mul15(m[u >> 1], m[u >> 1]);
+			zd += zr & 0x7FFF;
+			zh += zr >> 15;
+		}
+		zd += cc;
+		cc = zh + (zd >> 15);
+		wd = zd & 0x7FFF;
+		if (u < len) {
+			d[1 + u] = wd;
+		} else {
+			only0 = cttk_and(only0, cttk_u32_eq0(wd));
+		}
+	}
+
+	/*
+	 * The square is nonnegative, so all upper bits must be zero.
+	 */
+	return cttk_and(only0,
+		cttk_u32_eq0((uint32_t)d[len] >> top_index15(h)));
+}
+
+/*
+ * Unsigned square of a sequence of n 15-bit words (little-endian order,
+ * no header). The result (2*n words) is written in d, which must not
+ * overlap with a.
+ */
+static void
+usqr_school(uint16_t *d, const uint16_t *a, size_t n)
+{
+	size_t u, v;
+	uint32_t cc;
+
+	memset(d, 0, (n << 1) * sizeof *d);
+	for (u = 0; u < n; u ++) {
+		uint32_t au;
+
+		au = a[u];
+		cc = 0;
+		for (v = u + 1; v < n; v ++) {
+			uint32_t z;
+
+			z = mul15(au, a[v]) + (uint32_t)d[u + v] + cc;
+			d[u + v] = z & 0x7FFF;
+			cc = z >> 15;
+		}
+		d[u + n] = cc;
+	}
+	cc = 0;
+	for (u = 0; u < n; u ++) {
+		uint32_t z, w;
+
+		z = mul15(a[u], a[u]);
+		w = ((uint32_t)d[u << 1] << 1) + (z & 0x7FFF) + cc;
+		d[u << 1] = w & 0x7FFF;
+		cc = w >> 15;
+		w = ((uint32_t)d[(u << 1) + 1] << 1) + (z >> 15) + cc;
+		d[(u << 1) + 1] = w & 0x7FFF;
+		cc = w >> 15;
+	}
+}
+
+/*
+ * Unsigned square, as usqr_school(), with Karatsuba's method for
+ * operands of at least KARATSUBA_THRESHOLD15 words; karatsuba_tmp_len(n)
+ * words of temporary are sufficient.
+ */
+static void
+usqr_karatsuba(uint16_t *d, const uint16_t *a, size_t n, uint16_t *t)
+{
+	size_t n0, n1, u;
+	uint16_t *sa, *zm;
+	uint32_t ca, cc;
+
+	if (n < KARATSUBA_THRESHOLD15) {
+		usqr_school(d, a, n);
+		return;
+	}
+	n0 = n >> 1;
+	n1 = n - n0;
+	sa = t;
+	zm = sa + n1 + 1;
+	t = zm + ((n1 + 1) << 1);
+
+	ca = 0;
+	for (u = 0; u < n1; u ++) {
+		uint32_t wa;
+
+		wa = (uint32_t)a[n0 + u] + ca;
+		if (u < n0) {
+			wa += a[u];
+		}
+		sa[u] = wa & 0x7FFF;
+		ca = wa >> 15;
+	}
+	sa[n1] = ca;
+
+	usqr_karatsuba(d, a, n0, t);
+	usqr_karatsuba(d + (n0 << 1), a + n0, n1, t);
+	usqr_karatsuba(zm, sa, n1 + 1, t);
+
+	/*
+	 * zm <- zm - a0^2 - a1^2 = 2*a0*a1
+	 */
+	cc = 0;
+	for (u = 0; u < ((n1 + 1) << 1); u ++) {
+		uint32_t w;
+
+		w = (uint32_t)zm[u] - cc;
+		if (u < (n0 << 1)) {
+			w -= d[u];
+		}
+		zm[u] = w & 0x7FFF;
+		cc = w >> 31;
+	}
+	cc = 0;
+	for (u = 0; u < ((n1 + 1) << 1); u ++) {
+		uint32_t w;
+
+		w = (uint32_t)zm[u] - cc;
+		if (u < (n1 << 1)) {
+			w -= d[(n0 << 1) + u];
+		}
+		zm[u] = w & 0x7FFF;
+		cc = w >> 31;
+	}
+
+	/*
+	 * d <- d + zm*2^(15*n0)
+	 */
+	cc = 0;
+	for (u = 0; u < (n << 1) - n0; u ++) {
+		uint32_t w;
+
+		w = (uint32_t)d[n0 + u] + cc;
+		if (u < ((n1 + 1) << 1)) {
+			w += zm[u];
+		}
+		d[n0 + u] = w & 0x7FFF;
+		cc = w >> 15;
+	}
+}
+
+/*
+ * Squaring with Karatsuba's method. The absolute value of a must have
+ * been written in m (len words), and the temporary area t must have
+ * length at least 2*len+karatsuba_tmp_len(len) words.
+ */
+static cttk_bool
+gensqr_karatsuba(uint16_t *d, const uint16_t *m, uint16_t *t)
+{
+	uint32_t h;
+	size_t u, len;
+	cttk_bool only0;
+
+	h = d[0] & 0x7FFF;
+	len = (h + 15) >> 4;
+	usqr_karatsuba(t, m, len, t + (len << 1));
+	only0 = cttk_true;
+	for (u = len; u < (len << 1); u ++) {
+		only0 = cttk_and(only0, cttk_u32_eq0(t[u]));
+	}
+	memcpy(d + 1, t, len * sizeof *d);
+	return cttk_and(only0,
+		cttk_u32_eq0((uint32_t)d[len] >> top_index15(h)));
+}
+
+/*
+ * Get the length (in words) of the temporary buffer that allows
+ * gensqr_buf() to use its fastest method, for an operand with header h.
+ */
+static size_t
+gensqr_tmp_len(uint32_t h)
+{
+	size_t len;
+
+	len = (h + 15) >> 4;
+	if (len >= KARATSUBA_THRESHOLD15) {
+		return 3 * len + karatsuba_tmp_len(len);
+	}
+	return len;
+}
+
+/*
+ * Verify operand sizes for a squaring, and set the destination header.
+ * Returned value is 0 (and d is set to NaN) on size mismatch.
+ */
+static int
+gensqr_check(uint16_t *d, const uint16_t *a)
+{
+	if (size_neq(d, a)) {
+		d[0] |= 0x8000;
+		return 0;
+	}
+	d[0] = a[0];
+	return 1;
+}
+
+/*
+ * Squaring with a caller-provided temporary t of tlen words (sizes
+ * have been verified). If the temporary cannot even hold the absolute
+ * value of a, then the generic multiplication is used if d and a are
+ * distinct; otherwise, d is set to NaN.
+ */
+static cttk_bool
+gensqr_buf(uint16_t *d, const uint16_t *a, uint16_t *t, size_t tlen)
+{
+	uint32_t h;
+	size_t len;
+
+	h = d[0] & 0x7FFF;
+	len = (h + 15) >> 4;
+	if (tlen < len) {
+		if (d != a) {
+			return genmul_separate(d, a, a, NULL);
+		}
+		d[0] |= 0x8000;
+		return cttk_false;
+	}
+	abs_words(t, a, len);
+	if (len >= KARATSUBA_THRESHOLD15
+		&& tlen >= 3 * len + karatsuba_tmp_len(len))
+	{
+		return gensqr_karatsuba(d, t, t + len);
+	}
+	return gensqr_separate(d, t);
+}
+
+/*
+ * Squaring with a stack-based temporary.
+ */
+static cttk_bool
+gensqr_stack(uint16_t *d, const uint16_t *a)
+{
+	uint16_t t[CTTK_MAX_INT_BUF / sizeof(uint16_t)];
+
+	return gensqr_buf(d, a, t, sizeof t / sizeof t[0]);
+}
+
+static cttk_bool
+gensqr(uint16_t *d, const uint16_t *a)
+{
+	size_t tlen;
+
+	if (!gensqr_check(d, a)) {
+		return cttk_false;
+	}
+	tlen = gensqr_tmp_len(d[0] & 0x7FFF);
+#if !CTTK_NO_MALLOC
+	if (tlen > (CTTK_MAX_INT_BUF / sizeof(uint16_t))) {
+		uint16_t *t;
+
+		t = cttk_scratch_alloc(tlen * sizeof *t);
+		if (t != NULL) {
+			cttk_bool r;
+
+			r = gensqr_buf(d, a, t, tlen);
+			free(t);
+			return r;
+		}
+	}
+#else
+	(void)tlen;
+#endif
+	return gensqr_stack(d, a);
+}
+
+/* see cttk.h */
+void
+cttk_i15_sqr(uint16_t *d, const uint16_t *a)
+{
+	cttk_bool r;
+
+	r = gensqr(d, a);
+	d[0] |= (r.v ^ 1) << 15;
+}
+
+/* see cttk.h */
+void
+cttk_i15_sqr_trunc(uint16_t *d, const uint16_t *a)
+{
+	gensqr(d, a);
+	trunc_top(d);
+}
+
+/*
+ * Generic left-shift function:
+ *
+ *  - d and a must have been already verified to have the same size.
+ *  - Shift count is n = nd*15+nm, with 0 <= nm < 15, and n fits on 32 bits.
+ *  - If ctl is false, then the shift is not actually done.
+ *
+ * Returned value is false if the value overflows/underflows.
+ *
+ * nd and nm may leak.
+ */
+static cttk_bool
+genlsh(uint16_t *d, const uint16_t *a, uint32_t nd, unsigned nm, cttk_bool ctl)
+{
+	uint32_t n, h, hk, bl, ssa, tt;
+	size_t len, u;
+	cttk_bool r;
+
+	d[0] = a[0];
+	h = d[0] & 0x7FFF;
+	len = (h + 15) >> 4;
+	bl = h - (h >> 4);
+	n = 15 * nd + nm;
+	ssa = -(uint32_t)(a[len] >> 14) & 0x7FFF;
+
+	/*
+	 * If the shift count is greater than or equal to the type size,
+	 * then we can only get zero. This is an overflow/underflow if
+	 * the source value is not 0.
+	 */
+	if (n >= bl) {
+		r = cttk_true;
+		for (u = 0; u < len; u ++) {
+			uint32_t wa;
+
+			wa = a[1 + u];
+			r = cttk_and(r, cttk_u32_eq0(wa));
+			d[1 + u] = wa & (uint32_t)(ctl.v - 1);
+		}
+		return cttk_or(r, cttk_not(ctl));
+	}
+
+	/*
+	 * We reach that point only if n < bl, which implies nd < len.
+	 * Since source and destination may be the same array, we need
+	 * to do the shift in high to low order.
+	 */
+	r = cttk_true;
+	for (u = len; u > len - nd; u --) {
+		r = cttk_and(r, cttk_u32_eq(ssa, a[u]));
+	}
+	if (nm == 0) {
+		for (u = len; u > nd; u --) {
+			d[u] = cttk_u32_mux(ctl, a[u - nd], a[u]);
+		}
+	} else {
+		r = cttk_and(r, cttk_u32_eq0(
+			((uint32_t)a[len - nd] ^ ssa) >> (15 - nm)));
+		for (u = len; u > nd; u --) {
+			uint32_t wa, wd;
+
+			wa = a[u - nd];
+			wd = (wa << nm) & 0x7FFF;
+			if ((u - nd) > 1) {
+				wd |= (uint32_t)a[u - nd - 1] >> (15 - nm);
+			}
+			d[u] = cttk_u32_mux(ctl, wd, a[u]);
+		}
+	}
+	for (u = nd; u > 0; u --) {
+		d[u] = a[u] & (ctl.v - 1);
+	}
+
+	/*
+	 * 'r' contains the overflow/underflow check for all the dropped
+	 * bits, but we must still check the top bits in the high word
+	 * are all equal to the expected sign (and adjust them, for
+	 * truncation support).
+	 */
+	hk = top_index15(h);
+	tt = signext(d[len], hk + 1) & 0x7FFF;
+	r = cttk_and(r, cttk_u32_eq(d[len], tt));
+	d[len] = tt;
+	r = cttk_and(r, cttk_u32_eq0((tt ^ ssa) >> hk));
+	return cttk_or(r, cttk_not(ctl));
+}
+
+/*
+ * Generic right-shift function:
+ *
+ *  - d and a must have been already verified to have the same size.
+ *  - Shift count is n = nd*15+nm, with 0 <= nm < 15, and n fits on 32 bits.
+ *  - If ctl is false, then the shift is not actually done.
+ *
+ * nd and nm may leak.
+ */
+static void
+genrsh(uint16_t *d, const uint16_t *a, uint32_t nd, unsigned nm, cttk_bool ctl)
+{
+	uint32_t h, ssa, n, bl;
+	size_t u, len;
+
+	d[0] = a[0];
+	h = d[0] & 0x7FFF;
+	len = (h + 15) >> 4;
+	bl = h - (h >> 4);
+	n = 15 * nd + nm;
+	ssa = -(uint32_t)(a[len] >> 14) & 0x7FFF;
+
+	/*
+	 * If right-shifting by at least bl-1 bits, then the result is
+	 * either 0 or -1, depending on source sign.
+	 */
+	if ((n + 1) >= bl) {
+		for (u = 0; u < len; u ++) {
+			d[1 + u] = cttk_u32_mux(ctl, ssa, a[1 + u]);
+		}
+		return;
+	}
+
+	/*
+	 * We reach that point only if n < bl, which implies nd < len.
+	 */
+	if (nm == 0) {
+		for (u = 0; u < (len - nd); u ++) {
+			d[1 + u] = cttk_u32_mux(ctl, a[1 + u + nd], a[1 + u]);
+		}
+	} else {
+		for (u = 0; u < (len - nd - 1); u ++) {
+			uint32_t wa;
+
+			wa = (((uint32_t)a[1 + u + nd] >> nm)
+				| ((uint32_t)a[2 + u + nd] << (15 - nm))) & 0x7FFF;
+			d[1 + u] = cttk_u32_mux(ctl, wa, a[1 + u]);
+		}
+		d[len - nd] = cttk_u32_mux(ctl,
+			(((uint32_t)a[len] >> nm) | (ssa << (15 - nm))) & 0x7FFF,
+			a[len - nd]);
+	}
+	for (u = len - nd; u < len; u ++) {
+		d[1 + u] = cttk_u32_mux(ctl, ssa, a[1 + u]);
+	}
+}
+
+/*
+ * Precomputed powers of two divided by 15 (quotient and remainder).
+ */
+static const uint32_t p2m15[] = {
+	((uint32_t)1 <<  0) / 15, ((uint32_t)1 <<  0) % 15,
+	((uint32_t)1 <<  1) / 15, ((uint32_t)1 <<  1) % 15,
+	((uint32_t)1 <<  2) / 15, ((uint32_t)1 <<  2) % 15,
+	((uint32_t)1 <<  3) / 15, ((uint32_t)1 <<  3) % 15,
+	((uint32_t)1 <<  4) / 15, ((uint32_t)1 <<  4) % 15,
+	((uint32_t)1 <<  5) / 15, ((uint32_t)1 <<  5) % 15,
+	((uint32_t)1 <<  6) / 15, ((uint32_t)1 <<  6) % 15,
+	((uint32_t)1 <<  7) / 15, ((uint32_t)1 <<  7) % 15,
+	((uint32_t)1 <<  8) / 15, ((uint32_t)1 <<  8) % 15,
+	((uint32_t)1 <<  9) / 15, ((uint32_t)1 <<  9) % 15,
+	((uint32_t)1 << 10) / 15, ((uint32_t)1 << 10) % 15,
+	((uint32_t)1 << 11) / 15, ((uint32_t)1 << 11) % 15,
+	((uint32_t)1 << 12) / 15, ((uint32_t)1 << 12) % 15,
+	((uint32_t)1 << 13) / 15, ((uint32_t)1 << 13) % 15,
+	((uint32_t)1 << 14) / 15, ((uint32_t)1 << 14) % 15,
+	((uint32_t)1 << 15) / 15, ((uint32_t)1 << 15) % 15,
+	((uint32_t)1 << 16) / 15, ((uint32_t)1 << 16) % 15,
+	((uint32_t)1 << 17) / 15, ((uint32_t)1 << 17) % 15,
+	((uint32_t)1 << 18) / 15, ((uint32_t)1 << 18) % 15,
+	((uint32_t)1 << 19) / 15, ((uint32_t)1 << 19) % 15,
+	((uint32_t)1 << 20) / 15, ((uint32_t)1 << 20) % 15,
+	((uint32_t)1 << 21) / 15, ((uint32_t)1 << 21) % 15,
+	((uint32_t)1 << 22) / 15, ((uint32_t)1 << 22) % 15,
+	((uint32_t)1 << 23) / 15, ((uint32_t)1 << 23) % 15,
+	((uint32_t)1 << 24) / 15, ((uint32_t)1 << 24) % 15,
+	((uint32_t)1 << 25) / 15, ((uint32_t)1 << 25) % 15,
+	((uint32_t)1 << 26) / 15, ((uint32_t)1 << 26) % 15,
+	((uint32_t)1 << 27) / 15, ((uint32_t)1 << 27) % 15,
+	((uint32_t)1 << 28) / 15, ((uint32_t)1 << 28) % 15,
+	((uint32_t)1 << 29) / 15, ((uint32_t)1 << 29) % 15,
+	((uint32_t)1 << 30) / 15, ((uint32_t)1 << 30) % 15,
+	((uint32_t)1 << 31) / 15, ((uint32_t)1 << 31) % 15,
+};
+
+/* see cttk.h */
+void
+cttk_i15_lsh(uint16_t *d, const uint16_t *a, uint32_t n)
+{
+	cttk_bool r;
+
+	if (size_neq(d, a)) {
+		d[0] |= 0x8000;
+		return;
+	}
+	r = genlsh(d, a, n / 15, n % 15, cttk_true);
+	d[0] |= (r.v ^ 1) << 15;
+}
+
+/* see cttk.h */
+void
+cttk_i15_lsh_prot(uint16_t *d, const uint16_t *a, uint32_t n)
+{
+	int i;
+
+	if (size_neq(d, a)) {
+		d[0] |= 0x8000;
+		return;
+	}
+	for (i = 0; i < 32; i ++) {
+		cttk_bool r;
+
+		r = genlsh(d, a, p2m15[i << 1], p2m15[(i << 1) + 1],
+			cttk_u32_neq0(n & ((uint32_t)1 << i)));
+		d[0] |= (r.v ^ 1) << 15;
+		a = d;
+	}
+}
+
+/* see cttk.h */
+void
+cttk_i15_lsh_trunc(uint16_t *d, const uint16_t *a, uint32_t n)
+{
+	if (size_neq(d, a)) {
+		d[0] |= 0x8000;
+		return;
+	}
+	genlsh(d, a, n / 15, n % 15, cttk_true);
+}
+
+/* see cttk.h */
+void
+cttk_i15_lsh_trunc_prot(uint16_t *d, const uint16_t *a, uint32_t n)
+{
+	int i;
+
+	if (size_neq(d, a)) {
+		d[0] |= 0x8000;
+		return;
+	}
+	for (i = 0; i < 32; i ++) {
+		genlsh(d, a, p2m15[i << 1], p2m15[(i << 1) + 1],
+			cttk_u32_neq0(n & ((uint32_t)1 << i)));
+		a = d;
+	}
+}
+
+/* see cttk.h */
+void
+cttk_i15_rsh(uint16_t *d, const uint16_t *a, uint32_t n)
+{
+	if (size_neq(d, a)) {
+		d[0] |= 0x8000;
+		return;
+	}
+	genrsh(d, a, n / 15, n % 15, cttk_true);
+}
+
+/* see cttk.h */
+void
+cttk_i15_rsh_prot(uint16_t *d, const uint16_t *a, uint32_t n)
+{
+	int i;
+
+	if (size_neq(d, a)) {
+		d[0] |= 0x8000;
+		return;
+	}
+	for (i = 0; i < 32; i ++) {
+		genrsh(d, a, p2m15[i << 1], p2m15[(i << 1) + 1],
+			cttk_u32_neq0(n & ((uint32_t)1 << i)));
+		a = d;
+	}
+}
+
+/*
+ * Get the bit length of a nonnegative integer represented over len
+ * 15-bit words (little-endian order, no header).
+ */
+static uint32_t
+words_bitlength(const uint16_t *x, size_t len)
+{
+	uint32_t bl;
+	size_t u;
+
+	bl = 0;
+	for (u = 0; u < len; u ++) {
+		uint32_t w;
+
+		w = x[u];
+		bl = cttk_u32_mux(cttk_u32_neq0(w),
+			15 * (uint32_t)u + cttk_u32_bitlength(w), bl);
+	}
+	return bl;
+}
+
+/*
+ * Left-shift a sequence of len 15-bit words by n bits, in place. Bits
+ * pushed beyond the last word are dropped. The shift count is protected;
+ * it must be lower than 2^nb, and the memory access pattern depends only
+ * on len and nb.
+ */
+static void
+words_lsh_prot(uint16_t *x, size_t len, uint32_t n, unsigned nb)
+{
+	unsigned i;
+
+	for (i = 0; i < nb; i ++) {
+		cttk_bool ctl;
+		size_t nd, u;
+		unsigned nm;
+
+		ctl = cttk_u32_neq0(n & ((uint32_t)1 << i));
+		nd = p2m15[i << 1];
+		nm = p2m15[(i << 1) + 1];
+		for (u = len; u -- > 0;) {
+			uint32_t w;
+
+			w = 0;
+			if (u >= nd) {
+				w = ((uint32_t)x[u - nd] << nm) & 0x7FFF;
+				if (u > nd) {
+					w |= (uint32_t)x[u - nd - 1] >> (15 - nm);
+				}
+			}
+			x[u] = cttk_u32_mux(ctl, w, x[u]);
+		}
+	}
+}
+
+/*
+ * Right-shift a sequence of len 15-bit words by n bits, in place. Zeros
+ * are shifted in from the top. As with words_lsh_prot(), the shift count
+ * is protected and must be lower than 2^nb.
+ */
+static void
+words_rsh_prot(uint16_t *x, size_t len, uint32_t n, unsigned nb)
+{
+	unsigned i;
+
+	for (i = 0; i < nb; i ++) {
+		cttk_bool ctl;
+		size_t nd, u;
+		unsigned nm;
+
+		ctl = cttk_u32_neq0(n & ((uint32_t)1 << i));
+		nd = p2m15[i << 1];
+		nm = p2m15[(i << 1) + 1];
+		for (u = 0; u < len; u ++) {
+			uint32_t w;
+
+			w = 0;
+			if (nd < len - u) {
+				w = (uint32_t)x[u + nd] >> nm;
+				if (nd + 1 < len - u) {
+					w |= ((uint32_t)x[u + nd + 1]
+						<< (15 - nm)) & 0x7FFF;
+				}
+			}
+			x[u] = cttk_u32_mux(ctl, w, x[u]);
+		}
+	}
+}
+
+/*
+ * Divide the 30-bit value hi*2^15+lo by d; hi and lo must fit on 15 bits
+ * each, and d must be such that 2^14 <= d < 2^15. If hi >= d, then the
+ * quotient does not fit on 15 bits, and 0x7FFF is returned instead.
+ * This is a plain restoring division, in constant time.
+ */
+static uint32_t
+divw(uint32_t hi, uint32_t lo, uint32_t d)
+{
+	uint32_t x, q;
+	int k;
+
+	x = (hi << 15) | lo;
+	q = 0;
+	for (k = 14; k >= 0; k --) {
+		uint32_t t, c;
+
+		t = x - (d << k);
+		c = (t >> 31) ^ 1;
+		x = cttk_u32_mux(cttk_bool_of_u32(c), t, x);
+		q |= c << k;
+	}
+	return q | (-cttk_u32_geq(hi, d).v >> 17);
+}
+
+/*
+ * Word-wise division of nonnegative integers, on raw 15-bit words
+ * (little-endian order, no header). The dividend x has nx words, the
+ * divisor y has ny words, with 1 <= ny <= nx; y must not be zero.
+ * On output, the quotient is written in q (nx words; q may be NULL),
+ * and the remainder in the first ny words of x (the other words of x
+ * are set to 0). The contents of y are destroyed. t must have room
+ * for nx+ny words.
+ *
+ * This is the same schoolbook long division as in the i31 code, in
+ * base 2^15.
+ */
+static void
+divmod_words(uint16_t *q, uint16_t *x, size_t nx,
+	uint16_t *y, size_t ny, uint16_t *t)
+{
+	uint32_t s, yt;
+	unsigned nb;
+	size_t j, u;
+
+	s = 15 * (uint32_t)ny - words_bitlength(y, ny);
+	nb = cttk_u32_bitlength(15 * (uint32_t)ny - 1);
+	words_lsh_prot(y, ny, s, nb);
+	memcpy(t, x, nx * sizeof *x);
+	memset(t + nx, 0, ny * sizeof *t);
+	words_lsh_prot(t, nx + ny, s, nb);
+	yt = y[ny - 1];
+
+	for (j = nx; j -- > 0;) {
+		uint16_t *w;
+		uint32_t qw, cc, wu, neg;
+		int k;
+
+		/*
+		 * The current partial remainder is in w[0..ny] and is
+		 * lower than y*2^15.
+		 */
+		w = t + j;
+		qw = divw(w[ny], w[ny - 1], yt);
+
+		/*
+		 * Subtract qw*y; neg is set if the result is negative.
+		 */
+		cc = 0;
+		for (u = 0; u < ny; u ++) {
+			uint32_t z;
+
+			z = mul15(qw, y[u]) + cc;
+			cc = z >> 15;
+			wu = (uint32_t)w[u] - (z & 0x7FFF);
+			cc += wu >> 31;
+			w[u] = wu & 0x7FFF;
+		}
+		wu = (uint32_t)w[ny] - cc;
+		w[ny] = wu & 0x7FFF;
+		neg = wu >> 31;
+
+		/*
+		 * Add back y while the value is negative. The addition
+		 * yields a carry out of the top word exactly when the
+		 * value becomes nonnegative.
+		 */
+		for (k = 0; k < 2; k ++) {
+			uint32_t m;
+
+			m = -neg >> 17;
+			cc = 0;
+			for (u = 0; u < ny; u ++) {
+				wu = (uint32_t)w[u] + ((uint32_t)y[u] & m) + cc;
+				w[u] = wu & 0x7FFF;
+				cc = wu >> 15;
+			}
+			wu = (uint32_t)w[ny] + cc;
+			w[ny] = wu & 0x7FFF;
+			qw -= neg;
+			neg &= (wu >> 15) ^ 1;
+		}
+
+		if (q != NULL) {
+			q[j] = qw;
+		}
+	}
+
+	/*
+	 * The remainder, shifted by s bits, is in the low ny words of t.
+	 */
+	words_rsh_prot(t, ny, s, nb);
+	memcpy(x, t, ny * sizeof *x);
+	memset(x + ny, 0, (nx - ny) * sizeof *x);
+}
+
+/*
+ * Internal division routine:
+ *
+ *   - r is non-NULL.
+ *   - q, r, t1 and t2 are distinct from each other. Only q may be NULL.
+ *   - t1 and t2 are distinct from a and b.
+ *   - All non-NULL arrays have the same size.
+ *   - tw has room for twice the number of value words in a.
+ *
+ * Note that q and r may be aliases on a or b. See the i31 code for the
+ * handling of the special cases.
+ */
+static void
+gendiv_inner(uint16_t *q, uint16_t *r, const uint16_t *a,
+	const uint16_t *b, uint16_t *t1, uint16_t *t2, uint16_t *tw, int mod)
+{
+	uint32_t h, hk, sa, sb;
+	size_t len, u;
+	cttk_bool a_isnan, a_isminv, b_isnan, b_isminv, b_iszero, b_ismone;
+	cttk_bool both_nan, half_nan, b_bad;
+
+	h = b[0] & 0x7FFF;
+	hk = top_index15(h);
+	len = (h + 15) >> 4;
+
+	a_isnan = cttk_i15_isnan(a);
+	b_isnan = cttk_i15_isnan(b);
+	a_isminv = cttk_true;
+	b_isminv = cttk_true;
+	b_iszero = cttk_true;
+	b_ismone = cttk_true;
+	for (u = 0; (u + 1) < len; u ++) {
+		a_isminv = cttk_and(a_isminv, cttk_u32_eq0(a[1 + u]));
+		b_isminv = cttk_and(b_isminv, cttk_u32_eq0(b[1 + u]));
+		b_iszero = cttk_and(b_iszero, cttk_u32_eq0(b[1 + u]));
+		b_ismone = cttk_and(b_ismone, cttk_u32_eq(b[1 + u], 0x7FFF));
+	}
+	a_isminv = cttk_and(a_isminv,
+		cttk_u32_eq(a[len], ((uint32_t)-1 << hk) & 0x7FFF));
+	b_isminv = cttk_and(b_isminv,
+		cttk_u32_eq(b[len], ((uint32_t)-1 << hk) & 0x7FFF));
+	b_iszero = cttk_and(b_iszero, cttk_u32_eq0(b[len]));
+	b_ismone = cttk_and(b_ismone, cttk_u32_eq(b[len], 0x7FFF));
+
+	/*
+	 * Get signs.
+	 */
+	sa = (uint32_t)a[len] >> 14;
+	sb = (uint32_t)b[len] >> 14;
+
+	/*
+	 * Compute |b| into t2.
+	 */
+	cttk_i15_neg(t2, b);
+	cttk_i15_cond_copy(cttk_u32_eq0(sb), t2, b);
+
+	/*
+	 * Set r to |a| or |a+|b||. t1 is free at that point. r may be
+	 * aliased on a or b, but not on t1.
+	 */
+	cttk_i15_add(t1, a, t2);
+	cttk_i15_cond_copy(cttk_not(a_isminv), t1, a);
+	cttk_i15_neg(r, t1);
+	cttk_i15_cond_copy(cttk_not(
+		cttk_bool_of_u32((uint32_t)t1[len] >> 14)), r, t1);
+
+	/*
+	 * Now r is set, and |b|. We "forget" about the true b, and instead
+	 * use |b|.
+	 */
+	b = t2;
+
+	/*
+	 * Compute the division on the positive values. The word-wise
+	 * division destroys its divisor, so we give it a copy in t1.
+	 * If b is zero or MinValue, we use 2^(15*len)-1 instead.
+	 */
+	b_bad = cttk_or(b_iszero, b_isminv);
+	for (u = 0; u < len; u ++) {
+		t1[1 + u] = cttk_u32_mux(b_bad, 0x7FFF, b[1 + u]);
+	}
+	if (q != NULL) {
+		q[0] &= 0x7FFF;
+		divmod_words(q + 1, r + 1, len, t1 + 1, len, tw);
+	} else {
+		divmod_words(NULL, r + 1, len, t1 + 1, len, tw);
+	}
+
+	/*
+	 * Adjust values and signs. t1 is free.
+	 */
+	if (q != NULL) {
+		int32_t p;
+
+		cttk_i15_set_u32_trunc(t1, 0);
+		cttk_i15_cond_copy(b_isminv, q, t1);
+		cttk_i15_neg(t1, q);
+		cttk_i15_cond_copy(cttk_bool_of_u32(sa ^ sb), q, t1);
+		p = cttk_bool_to_int(a_isminv);
+		cttk_i15_set_s32(t1,
+			cttk_s32_mux(cttk_bool_of_u32(sa ^ sb), -p, p));
+		cttk_i15_add(q, q, t1);
+	}
+	cttk_i15_neg(t1, r);
+	cttk_i15_cond_copy(cttk_bool_of_u32(sa), r, t1);
+
+	/*
+	 * Handle the special cases for b == MinValue.
+	 */
+	cttk_i15_set_u32_trunc(t1, 0);
+	if (q != NULL) {
+		cttk_i15_cond_copy(
+			cttk_and(b_isminv, cttk_not(a_isminv)), q, t1);
+	}
+	cttk_i15_cond_copy(cttk_and(b_isminv, a_isminv), r, t1);
+	if (q != NULL) {
+		cttk_i15_set_u32(t1, 1);
+		cttk_i15_cond_copy(cttk_and(b_isminv, a_isminv), q, t1);
+	}
+
+	/*
+	 * Apply NaN conditions.
+	 */
+	both_nan = cttk_or(cttk_or(a_isnan, b_isnan), b_iszero);
+	half_nan = cttk_and(a_isminv, b_ismone);
+	if (q != NULL) {
+		q[0] |= cttk_or(both_nan, half_nan).v << 15;
+	}
+	r[0] |= both_nan.v << 15;
+	cttk_i15_set_u32_trunc(t1, 0);
+	cttk_i15_cond_copy(half_nan, r, t1);
+
+	/*
+	 * Extra step if doing modular reduction (a negative remainder
+	 * is fixed by adding |b|, except when b == MinValue, in which
+	 * case the sign bit is flipped).
+	 */
+	if (mod) {
+		uint32_t sr;
+
+		sr = (uint32_t)r[len] >> 14;
+		cttk_i15_add(t1, r, b);
+		cttk_i15_cond_copy(cttk_and(cttk_bool_of_u32(sr),
+			cttk_not(b_isminv)), r, t1);
+		r[len] ^= ((-(sr & b_isminv.v) << hk) & 0x7FFF);
+	}
+}
+
+/*
+ * Run the division with the provided temporary space; t must have room
+ * for 5*wlen words if r is NULL, 4*wlen words otherwise, where wlen is
+ * the total length (in words, header included) of each operand.
+ */
+static void
+gendiv_buf(uint16_t *q, uint16_t *r,
+	const uint16_t *a, const uint16_t *b, uint16_t *t, int mod)
+{
+	uint32_t h;
+	uint16_t *t1, *t2;
+	size_t wlen;
+
+	h = a[0] & 0x7FFF;
+	wlen = (h + 31) >> 4;
+	if (r == NULL) {
+		r = t;
+		r[0] = h;
+		t += wlen;
+	}
+	t1 = t;
+	t2 = t + wlen;
+	t1[0] = t2[0] = h;
+	gendiv_inner(q, r, a, b, t1, t2, t2 + wlen, mod);
+}
+
+static void
+gendiv_stack(uint16_t *q, uint16_t *r,
+	const uint16_t *a, const uint16_t *b, int mod)
+{
+	uint16_t t[CTTK_MAX_INT_BUF / sizeof(uint16_t)];
+
+	gendiv_buf(q, r, a, b, t, mod);
+}
+
+/*
+ * Set the non-NULL recipients of a division to NaN.
+ */
+static void
+divrem_nan(uint16_t *q, uint16_t *r)
+{
+	if (q != NULL) {
+		q[0] |= 0x8000;
+	}
+	if (r != NULL) {
+		r[0] |= 0x8000;
+	}
+}
+
+/*
+ * Generic division routine. This function assumes that sizes have been
+ * verified to be equal to each other. Either q and r may be NULL, but
+ * not both. Also, q != r.
+ *
+ * If mod is non-zero, then an extra step is applied to ensure a nonnegative
+ * remainder.
+ */
+static void
+gendiv(uint16_t *q, uint16_t *r, const uint16_t *a, const uint16_t *b, int mod)
+{
+	uint32_t h;
+	size_t tlen;
+
+	/*
+	 * Temporaries are carved out of a single buffer, on the stack
+	 * if possible, or allocated on the heap otherwise (see the i31
+	 * code).
+	 */
+	h = a[0] & 0x7FFF;
+	tlen = ((h + 31) >> 4) * (r == NULL ? 5 : 4);
+	if (tlen <= (CTTK_MAX_INT_BUF / sizeof(uint16_t))) {
+		gendiv_stack(q, r, a, b, mod);
+		return;
+	}
+#if !CTTK_NO_MALLOC
+	{
+		uint16_t *t;
+
+		t = cttk_scratch_alloc(tlen * sizeof(uint16_t));
+		if (t != NULL) {
+			gendiv_buf(q, r, a, b, t, mod);
+			free(t);
+			return;
+		}
+	}
+#endif
+
+	/*
+	 * Could not find enough memory for temporaries...
+	 */
+	divrem_nan(q, r);
+}
+
+/*
+ * Division with a caller-provided temporary of tlen words (sizes have
+ * been verified). If the temporary is too small, then the results are
+ * set to NaN.
+ */
+static void
+gendiv_ws(uint16_t *q, uint16_t *r, const uint16_t *a, const uint16_t *b,
+	int mod, uint16_t *t, size_t tlen)
+{
+	uint32_t h;
+
+	h = a[0] & 0x7FFF;
+	if (tlen < ((h + 31) >> 4) * (r == NULL ? 5 : 4)) {
+		divrem_nan(q, r);
+		return;
+	}
+	gendiv_buf(q, r, a, b, t, mod);
+}
+
+/*
+ * Verify operands for cttk_i15_divrem(). Mismatched recipients are set
+ * to NaN and replaced with NULL. Returned value is 1 if the division
+ * must be performed, 0 otherwise.
+ */
+static int
+divrem_check(uint16_t **qq, uint16_t **rr,
+	const uint16_t *a, const uint16_t *b)
+{
+	uint16_t *q, *r;
+
+	q = *qq;
+	r = *rr;
+	if (size_neq(a, b)) {
+		divrem_nan(q, r);
+		return 0;
+	}
+	if (q != NULL && size_neq(q, a)) {
+		q[0] |= 0x8000;
+		q = NULL;
+	}
+	if (r != NULL && size_neq(r, a)) {
+		r[0] |= 0x8000;
+		r = NULL;
+	}
+	if (q == NULL && r == NULL) {
+		return 0;
+	}
+	if (q == r) {
+		divrem_nan(q, r);
+		return 0;
+	}
+	*qq = q;
+	*rr = r;
+	return 1;
+}
+
+/* see cttk.h */
+void
+cttk_i15_divrem(uint16_t *q, uint16_t *r, const uint16_t *a, const uint16_t *b)
+{
+	if (divrem_check(&q, &r, a, b)) {
+		gendiv(q, r, a, b, 0);
+	}
+}
+
+/* see cttk.h */
+void
+cttk_i15_divrem_ws(uint16_t *q, uint16_t *r,
+	const uint16_t *a, const uint16_t *b, uint16_t *tmp, size_t tmp_len)
+{
+	if (divrem_check(&q, &r, a, b)) {
+		gendiv_ws(q, r, a, b, 0, tmp, tmp_len);
+	}
+}
+
+/* see cttk.h */
+void
+cttk_i15_mod(uint16_t *d, const uint16_t *a, const uint16_t *b)
+{
+	if (!check_size3(d, a, b)) {
+		return;
+	}
+	gendiv(NULL, d, a, b, 1);
+}
+
+/* see cttk.h */
+void
+cttk_i15_mod_ws(uint16_t *d, const uint16_t *a, const uint16_t *b,
+	uint16_t *tmp, size_t tmp_len)
+{
+	if (!check_size3(d, a, b)) {
+		return;
+	}
+	gendiv_ws(NULL, d, a, b, 1, tmp, tmp_len);
+}
+
+/* see cttk.h */
+size_t
+cttk_i15_ws_len(unsigned size)
+{
+	uint32_t h;
+	size_t mlen, dlen;
+
+	h = (uint32_t)size + ((uint32_t)size / 15);
+	mlen = genmul_tmp_len(h);
+	dlen = ((h + 31) >> 4) * 5;
+	return mlen > dlen ? mlen : dlen;
+}
+
+/* see cttk.h */
+void
+cttk_i15_and(uint16_t *d, const uint16_t *a, const uint16_t *b)
+{
+	size_t len, u;
+
+	if (!check_size3(d, a, b)) {
+		return;
+	}
+	len = ((d[0] & 0x7FFF) + 15) >> 4;
+	d[0] = a[0] | b[0];
+	for (u = 1; u <= len; u ++) {
+		d[u] = a[u] & b[u];
+	}
+}
+
+/* see cttk.h */
+void
+cttk_i15_or(uint16_t *d, const uint16_t *a, const uint16_t *b)
+{
+	size_t len, u;
+
+	if (!check_size3(d, a, b)) {
+		return;
+	}
+	len = ((d[0] & 0x7FFF) + 15) >> 4;
+	d[0] = a[0] | b[0];
+	for (u = 1; u <= len; u ++) {
+		d[u] = a[u] | b[u];
+	}
+}
+
+/* see cttk.h */
+void
+cttk_i15_xor(uint16_t *d, const uint16_t *a, const uint16_t *b)
+{
+	size_t len, u;
+
+	if (!check_size3(d, a, b)) {
+		return;
+	}
+	len = ((d[0] & 0x7FFF) + 15) >> 4;
+	d[0] = a[0] | b[0];
+	for (u = 1; u <= len; u ++) {
+		d[u] = a[u] ^ b[u];
+	}
+}
+
+/* see cttk.h */
+void
+cttk_i15_eqv(uint16_t *d, const uint16_t *a, const uint16_t *b)
+{
+	size_t len, u;
+
+	if (!check_size3(d, a, b)) {
+		return;
+	}
+	len = ((d[0] & 0x7FFF) + 15) >> 4;
+	d[0] = a[0] | b[0];
+	for (u = 1; u <= len; u ++) {
+		d[u] = a[u] ^ b[u] ^ 0x7FFF;
+	}
+}
+
+/* see cttk.h */
+void
+cttk_i15_not(uint16_t *d, const uint16_t *a)
+{
+	size_t len, u;
+
+	if (size_neq(d, a)) {
+		d[0] |= 0x8000;
+		return;
+	}
+	len = ((d[0] & 0x7FFF) + 15) >> 4;
+	d[0] = a[0];
+	for (u = 1; u <= len; u ++) {
+		d[u] = a[u] ^ 0x7FFF;
+	}
+}
@@ -52,37 +52,13 @@
  *   - The bit length is: h - (h >> 5)
  */
 
-/*
- * Get index of the top bit (sign bit) given the encoded size (header
- * word, without the "NaN" flag). The returned index is relative to
- * the top word.
- */
-static inline unsigned
-top_index(uint32_t h)
-{
-	h = (h & 31) - 1;
-	return h + (31 & (h >> 5));
-}
-
-/*
- * Sign-extend an n-bit value to 32 bits (1 <= n <= 32).
- */
-static inline uint32_t
-signext(uint32_t v, unsigned n)
-{
-	uint32_t hi, lo;
-
-	hi = -(uint32_t)((v >> (n - 1)) & 1) << (n - 1);
-	lo = v & ((uint32_t)-1 >> (32 - n));
-	return hi | lo;
-}
-
 /* see cttk.h */
 void
 cttk_i31_init(uint32_t *x, unsigned size)
 {
 	uint32_t h;
 
+	STATS_I31(SET);
 	h = (uint32_t)size + ((uint32_t)size / 31);
 	*x = h | 0x80000000;
 	memset(x + 1, 0, ((h + 31) >> 5) * sizeof *x);
@@ -95,6 +71,7 @@ cttk_i31_set_u32(uint32_t *x, uint32_t v)
 	uint32_t h, size;
 	size_t len;
 
+	STATS_I31(SET);
 	x[0] &= 0x7FFFFFFF;
 	h = x[0];
 	len = (h + 31) >> 5;
@@ -121,6 +98,7 @@ cttk_i31_set_u32_trunc(uint32_t *x, uint32_t v)
 	uint32_t h, size;
 	size_t len;
 
+	STATS_I31(SET);
 	x[0] &= 0x7FFFFFFF;
 	h = x[0];
 	len = (h + 31) >> 5;
@@ -144,6 +122,7 @@ cttk_i31_set_u64(uint32_t *x, uint64_t v)
 	uint32_t h, size;
 	size_t len;
 
+	STATS_I31(SET);
 	x[0] &= 0x7FFFFFFF;
 	h = x[0];
 	len = (h + 31) >> 5;
@@ -168,6 +147,7 @@ cttk_i31_set_u64_trunc(uint32_t *x, uint64_t v)
 	uint32_t h, size;
 	size_t len;
 
+	STATS_I31(SET);
 	x[0] &= 0x7FFFFFFF;
 	h = x[0];
 	len = (h + 31) >> 5;
@@ -209,6 +189,7 @@ cttk_i31_set_s32(uint32_t *x, int32_t v)
 	size_t u, len;
 	uint32_t w;
 
+	STATS_I31(SET);
 	x[0] &= 0x7FFFFFFF;
 	h = x[0];
 	len = (h + 31) >> 5;
@@ -244,6 +225,7 @@ cttk_i31_set_s64(uint32_t *x, int64_t v)
 	size_t u, len;
 	uint64_t w;
 
+	STATS_I31(SET);
 	x[0] &= 0x7FFFFFFF;
 	h = x[0];
 	len = (h + 31) >> 5;
@@ -282,6 +264,7 @@ cttk_i31_set(uint32_t *d, const uint32_t *a)
 	uint32_t h;
 	size_t dlen, alen;
 
+	STATS_I31(SET);
 	/*
 	 * Special case: when source and operands are identical, there
 	 * is nothing more to do.
@@ -330,6 +313,7 @@ cttk_i31_set_trunc(uint32_t *d, const uint32_t *a)
 	uint32_t h;
 	size_t dlen, alen;
 
+	STATS_I31(SET);
 	/*
 	 * Special case: when source and operands are identical, there
 	 * is nothing more to do.
@@ -374,6 +358,7 @@ cttk_i31_to_u32_trunc(const uint32_t *x)
 {
 	uint32_t r;
 
+	STATS_I31(SET);
 	r = x[1];
 	if ((x[0] & 0x7FFFFFFF) > 32) {
 		r |= x[2] << 31;
@@ -389,6 +374,7 @@ cttk_i31_to_s32_trunc(const uint32_t *x)
 {
 	uint32_t r;
 
+	STATS_I31(SET);
 	r = cttk_i31_to_u32_trunc(x);
 	return *(int32_t *)&r;
 }
@@ -400,6 +386,7 @@ cttk_i31_to_u64_trunc(const uint32_t *x)
 	uint32_t h;
 	uint64_t r;
 
+	STATS_I31(SET);
 	h = x[0] & 0x7FFFFFFF;
 	r = x[1];
 	if (h > 64) {
@@ -419,6 +406,7 @@ cttk_i31_to_s64_trunc(const uint32_t *x)
 {
 	uint64_t r;
 
+	STATS_I31(SET);
 	r = cttk_i31_to_u64_trunc(x);
 	return *(int64_t *)&r;
 }
@@ -615,10 +603,178 @@ genenc(void *dst, size_t dst_len, const uint32_t *x, int be)
 	}
 }
 
+/* see inner.h */
+void
+cttk_i31_sink_init(cttk_i31_sink *sk, uint32_t *x, size_t num)
+{
+	x[0] &= 0x7FFFFFFF;
+	sk->x = x;
+	sk->len = (x[0] + 31) >> 5;
+	memset(x + 1, 0, sk->len * sizeof *x);
+	sk->num = num;
+	sk->pos = num;
+	sk->sign = 0;
+	sk->ext0 = cttk_true;
+	sk->ext1 = cttk_true;
+}
+
+/*
+ * Bits beyond the value words must all match the sign of the result,
+ * which is not known yet: we record whether they are all zeros, and
+ * whether they are all ones.
+ */
+static void
+sink_extra(cttk_i31_sink *sk, uint32_t v, unsigned n)
+{
+	uint32_t m;
+
+	m = ((uint32_t)1 << n) - 1;
+	sk->ext0 = cttk_and(sk->ext0, cttk_u32_eq0(v & m));
+	sk->ext1 = cttk_and(sk->ext1, cttk_u32_eq(v & m, m));
+}
+
+/*
+ * Insert n bits (1 to 24) at the current position.
+ */
+static void
+sink_put(cttk_i31_sink *sk, uint32_t v, unsigned n)
+{
+	size_t w;
+	unsigned s, lo;
+
+	if (sk->pos == sk->num) {
+		sk->sign = (v >> (n - 1)) & 1;
+	}
+	sk->pos -= n;
+	w = sk->pos / 31;
+	s = (unsigned)(sk->pos - 31 * w);
+	lo = 31 - s;
+	if (w < sk->len) {
+		sk->x[1 + w] |= (v << s) & 0x7FFFFFFF;
+	} else {
+		sink_extra(sk, v, n < lo ? n : lo);
+	}
+	if (n > lo) {
+		if (w + 1 < sk->len) {
+			sk->x[2 + w] |= v >> lo;
+		} else {
+			sink_extra(sk, v >> lo, n - lo);
+		}
+	}
+}
+
+/* see inner.h */
+void
+cttk_i31_sink_bytes(cttk_i31_sink *sk, const unsigned char *buf, size_t len)
+{
+	size_t u;
+
+	for (u = 0; (u + 3) <= len; u += 3) {
+		sink_put(sk, ((uint32_t)buf[u] << 16)
+			| ((uint32_t)buf[u + 1] << 8) | (uint32_t)buf[u + 2], 24);
+	}
+	for (; u < len; u ++) {
+		sink_put(sk, buf[u], 8);
+	}
+}
+
+/* see inner.h */
+void
+cttk_i31_sink_finish(cttk_i31_sink *sk, int sig, int trunc)
+{
+	uint32_t *x;
+	uint32_t top, top2, ssx;
+	unsigned hk;
+	size_t len;
+	cttk_bool in_range, neg;
+
+	x = sk->x;
+	len = sk->len;
+	if (sk->num == 0) {
+		if (sig) {
+			x[0] |= 0x80000000;
+		}
+		return;
+	}
+
+	/*
+	 * A signed source is sign-extended over the remaining bits.
+	 */
+	if (sig) {
+		uint32_t m;
+		size_t w;
+
+		m = -sk->sign >> 1;
+		w = sk->num / 31;
+		if (w < len) {
+			x[1 + w] |= (m << (sk->num - 31 * w)) & 0x7FFFFFFF;
+			while (++ w < len) {
+				x[1 + w] = m;
+			}
+		}
+	}
+
+	/*
+	 * As in gendec(), the top word is sign-extended if truncating;
+	 * otherwise, its extra bits, and the bits beyond the value
+	 * words, must match the sign bit.
+	 */
+	hk = top_index(x[0]);
+	top = x[len];
+	top2 = signext(top, hk + 1) & 0x7FFFFFFF;
+	if (trunc) {
+		x[len] = top2;
+		return;
+	}
+	ssx = (top >> hk) & 1;
+	neg = cttk_bool_of_u32(ssx);
+	in_range = cttk_and(cttk_u32_eq(top, top2),
+		cttk_or(cttk_and(neg, sk->ext1),
+		cttk_and(cttk_not(neg), sk->ext0)));
+	if (!sig) {
+		in_range = cttk_and(in_range, cttk_not(neg));
+	}
+	x[0] |= cttk_not(in_range).v << 31;
+}
+
+/* see inner.h */
+void
+cttk_i31_encbe_part(void *dst, const uint32_t *x,
+	size_t len, size_t off, size_t num)
+{
+	unsigned char *buf;
+	uint32_t h, mask, ssx;
+	size_t wl, u;
+
+	h = x[0];
+	mask = (h >> 31) - 1;
+	h &= 0x7FFFFFFF;
+	wl = (h + 31) >> 5;
+	ssx = -(uint32_t)((x[wl] >> top_index(h)) & 1) >> 1;
+	buf = dst;
+	for (u = 0; u < num; u ++) {
+		size_t j, w;
+		unsigned s;
+		uint32_t lo, hi;
+
+		/*
+		 * j is the bit offset of the byte, counting from the
+		 * least significant bit.
+		 */
+		j = (len - 1 - off - u) << 3;
+		w = j / 31;
+		s = (unsigned)(j - 31 * w);
+		lo = w < wl ? x[1 + w] : ssx;
+		hi = (w + 1) < wl ? x[2 + w] : ssx;
+		buf[u] = ((lo >> s) | (hi << (31 - s))) & mask & 0xFF;
+	}
+}
+
 /* see cttk.h */
 void
 cttk_i31_decbe_signed(uint32_t *x, const void *src, size_t len)
 {
+	STATS_I31(CODEC);
 	gendec(x, src, len, 1, 1, 0);
 }
 
@@ -626,6 +782,7 @@ cttk_i31_decbe_signed(uint32_t *x, const void *src, size_t len)
 void
 cttk_i31_decbe_unsigned(uint32_t *x, const void *src, size_t len)
 {
+	STATS_I31(CODEC);
 	gendec(x, src, len, 1, 0, 0);
 }
 
@@ -633,6 +790,7 @@ cttk_i31_decbe_unsigned(uint32_t *x, const void *src, size_t len)
 void
 cttk_i31_decbe_signed_trunc(uint32_t *x, const void *src, size_t len)
 {
+	STATS_I31(CODEC);
 	gendec(x, src, len, 1, 1, 1);
 }
 
@@ -640,6 +798,7 @@ cttk_i31_decbe_signed_trunc(uint32_t *x, const void *src, size_t len)
 void
 cttk_i31_decbe_unsigned_trunc(uint32_t *x, const void *src, size_t len)
 {
+	STATS_I31(CODEC);
 	gendec(x, src, len, 1, 0, 1);
 }
 
@@ -647,6 +806,7 @@ cttk_i31_decbe_unsigned_trunc(uint32_t *x, const void *src, size_t len)
 void
 cttk_i31_decle_signed(uint32_t *x, const void *src, size_t len)
 {
+	STATS_I31(CODEC);
 	gendec(x, src, len, 0, 1, 0);
 }
 
@@ -654,6 +814,7 @@ cttk_i31_decle_signed(uint32_t *x, const void *src, size_t len)
 void
 cttk_i31_decle_unsigned(uint32_t *x, const void *src, size_t len)
 {
+	STATS_I31(CODEC);
 	gendec(x, src, len, 0, 0, 0);
 }
 
@@ -661,6 +822,7 @@ cttk_i31_decle_unsigned(uint32_t *x, const void *src, size_t len)
 void
 cttk_i31_decle_signed_trunc(uint32_t *x, const void *src, size_t len)
 {
+	STATS_I31(CODEC);
 	gendec(x, src, len, 0, 1, 1);
 }
 
@@ -668,6 +830,7 @@ cttk_i31_decle_signed_trunc(uint32_t *x, const void *src, size_t len)
 void
 cttk_i31_decle_unsigned_trunc(uint32_t *x, const void *src, size_t len)
 {
+	STATS_I31(CODEC);
 	gendec(x, src, len, 0, 0, 1);
 }
 
@@ -675,6 +838,7 @@ cttk_i31_decle_unsigned_trunc(uint32_t *x, const void *src, size_t len)
 void
 cttk_i31_encbe(void *dst, size_t len, const uint32_t *x)
 {
+	STATS_I31(CODEC);
 	genenc(dst, len, x, 1);
 }
 
@@ -682,6 +846,7 @@ cttk_i31_encbe(void *dst, size_t len, const uint32_t *x)
 void
 cttk_i31_encle(void *dst, size_t len, const uint32_t *x)
 {
+	STATS_I31(CODEC);
 	genenc(dst, len, x, 0);
 }
 
@@ -763,6 +928,7 @@ cttk_i31_to_u32(const uint32_t *x)
 {
 	uint32_t r;
 
+	STATS_I31(SET);
 	r = cttk_i31_to_u32_trunc(x);
 	r &= -cttk_u32_lt(real_bitlength(x), 33).v;
 	r &= val_lt0(x).v - 1;
@@ -775,6 +941,7 @@ cttk_i31_to_s32(const uint32_t *x)
 {
 	uint32_t r;
 
+	STATS_I31(SET);
 	r = cttk_i31_to_u32_trunc(x);
 	r &= -cttk_u32_lt(real_bitlength(x), 32).v;
 	return *(int32_t *)&r;
@@ -786,6 +953,7 @@ cttk_i31_to_u64(const uint32_t *x)
 {
 	uint64_t r;
 
+	STATS_I31(SET);
 	r = cttk_i31_to_u64_trunc(x);
 	r &= -(uint64_t)cttk_u32_lt(real_bitlength(x), 65).v;
 	r &= (uint64_t)val_lt0(x).v - 1;
@@ -798,6 +966,7 @@ cttk_i31_to_s64(const uint32_t *x)
 {
 	uint64_t r;
 
+	STATS_I31(SET);
 	r = cttk_i31_to_u64_trunc(x);
 	r &= -(uint64_t)cttk_u64_lt(real_bitlength(x), 64).v;
 	return *(int64_t *)&r;
@@ -807,6 +976,7 @@ cttk_i31_to_s64(const uint32_t *x)
 cttk_bool
 cttk_i31_eq0(const uint32_t *x)
 {
+	STATS_I31(CMP);
 	return cttk_and(val_eq0(x), cttk_not(cttk_i31_isnan(x)));
 }
 
@@ -814,6 +984,7 @@ cttk_i31_eq0(const uint32_t *x)
 cttk_bool
 cttk_i31_neq0(const uint32_t *x)
 {
+	STATS_I31(CMP);
 	return cttk_not(cttk_or(val_eq0(x), cttk_i31_isnan(x)));
 }
 
@@ -821,6 +992,7 @@ cttk_i31_neq0(const uint32_t *x)
 cttk_bool
 cttk_i31_gt0(const uint32_t *x)
 {
+	STATS_I31(CMP);
 	return cttk_not(cttk_or(cttk_or(val_eq0(x), val_lt0(x)),
 		cttk_i31_isnan(x)));
 }
@@ -829,6 +1001,7 @@ cttk_i31_gt0(const uint32_t *x)
 cttk_bool
 cttk_i31_lt0(const uint32_t *x)
 {
+	STATS_I31(CMP);
 	return cttk_and(val_lt0(x), cttk_not(cttk_i31_isnan(x)));
 }
 
@@ -836,6 +1009,7 @@ cttk_i31_lt0(const uint32_t *x)
 cttk_bool
 cttk_i31_geq0(const uint32_t *x)
 {
+	STATS_I31(CMP);
 	return cttk_not(cttk_or(val_lt0(x), cttk_i31_isnan(x)));
 }
 
@@ -843,6 +1017,7 @@ cttk_i31_geq0(const uint32_t *x)
 cttk_bool
 cttk_i31_leq0(const uint32_t *x)
 {
+	STATS_I31(CMP);
 	return cttk_and(cttk_or(val_eq0(x), val_lt0(x)),
 		cttk_not(cttk_i31_isnan(x)));
 }
@@ -955,6 +1130,7 @@ val_cmp(const uint32_t *x, const uint32_t *y)
 cttk_bool
 cttk_i31_eq(const uint32_t *x, const uint32_t *y)
 {
+	STATS_I31(CMP);
 	if ((uint32_t)((x[0] ^ y[0]) << 1) != 0) {
 		return cttk_false;
 	}
@@ -965,6 +1141,7 @@ cttk_i31_eq(const uint32_t *x, const uint32_t *y)
 cttk_bool
 cttk_i31_neq(const uint32_t *x, const uint32_t *y)
 {
+	STATS_I31(CMP);
 	if ((uint32_t)((x[0] ^ y[0]) << 1) != 0) {
 		return cttk_false;
 	}
@@ -975,6 +1152,7 @@ cttk_i31_neq(const uint32_t *x, const uint32_t *y)
 cttk_bool
 cttk_i31_lt(const uint32_t *x, const uint32_t *y)
 {
+	STATS_I31(CMP);
 	if ((uint32_t)((x[0] ^ y[0]) << 1) != 0) {
 		return cttk_false;
 	}
@@ -985,6 +1163,7 @@ cttk_i31_lt(const uint32_t *x, const uint32_t *y)
 cttk_bool
 cttk_i31_leq(const uint32_t *x, const uint32_t *y)
 {
+	STATS_I31(CMP);
 	if ((uint32_t)((x[0] ^ y[0]) << 1) != 0) {
 		return cttk_false;
 	}
@@ -995,6 +1174,7 @@ cttk_i31_leq(const uint32_t *x, const uint32_t *y)
 cttk_bool
 cttk_i31_gt(const uint32_t *x, const uint32_t *y)
 {
+	STATS_I31(CMP);
 	if ((uint32_t)((x[0] ^ y[0]) << 1) != 0) {
 		return cttk_false;
 	}
@@ -1005,6 +1185,7 @@ cttk_i31_gt(const uint32_t *x, const uint32_t *y)
 cttk_bool
 cttk_i31_geq(const uint32_t *x, const uint32_t *y)
 {
+	STATS_I31(CMP);
 	if ((uint32_t)((x[0] ^ y[0]) << 1) != 0) {
 		return cttk_false;
 	}
@@ -1017,6 +1198,7 @@ cttk_i31_sign(const uint32_t *x)
 {
 	uint32_t w;
 
+	STATS_I31(CMP);
 	w = (val_eq0(x).v ^ (uint32_t)1) | -val_lt0(x).v;
 	w &= (x[0] >> 31) - 1;
 	return *(int32_t *)&w;
@@ -1028,6 +1210,7 @@ cttk_i31_cmp(const uint32_t *x, const uint32_t *y)
 {
 	uint32_t w;
 
+	STATS_I31(CMP);
 	if ((uint32_t)((x[0] ^ y[0]) << 1) != 0) {
 		return 0;
 	}
@@ -1039,8 +1222,10 @@ cttk_i31_cmp(const uint32_t *x, const uint32_t *y)
 void
 cttk_i31_copy(uint32_t *d, const uint32_t *s)
 {
+	STATS_I31(COPY);
 	if (d != s) {
 		if ((uint32_t)((d[0] ^ s[0]) << 1) != 0) {
+			STATS_NAN_SIZE();
 			d[0] |= 0x80000000;
 			return;
 		}
@@ -1052,6 +1237,7 @@ cttk_i31_copy(uint32_t *d, const uint32_t *s)
 void
 cttk_i31_cond_copy(cttk_bool ctl, uint32_t *d, const uint32_t *s)
 {
+	STATS_I31(COPY);
 	cttk_i31_mux(ctl, d, s, d);
 }
 
@@ -1061,10 +1247,12 @@ cttk_i31_swap(uint32_t *a, uint32_t *b)
 {
 	size_t u, len;
 
+	STATS_I31(COPY);
 	if (a == b) {
 		return;
 	}
 	if ((uint32_t)((a[0] ^ b[0]) << 1) != 0) {
+		STATS_NAN_SIZE();
 		a[0] |= 0x80000000;
 		b[0] |= 0x80000000;
 		return;
@@ -1085,10 +1273,12 @@ cttk_i31_cond_swap(cttk_bool ctl, uint32_t *a, uint32_t *b)
 {
 	size_t u, len;
 
+	STATS_I31(COPY);
 	if (a == b) {
 		return;
 	}
 	if ((uint32_t)((a[0] ^ b[0]) << 1) != 0) {
+		STATS_NAN_SIZE();
 		a[0] |= 0x80000000;
 		b[0] |= 0x80000000;
 		return;
@@ -1112,8 +1302,10 @@ cttk_i31_mux(cttk_bool ctl, uint32_t *d, const uint32_t *a, const uint32_t *b)
 	uint32_t h;
 	size_t u, len;
 
+	STATS_I31(COPY);
 	h = d[0] & 0x7FFFFFFF;
 	if (h != (a[0] & 0x7FFFFFFF) || h != (b[0] & 0x7FFFFFFF)) {
+		STATS_NAN_SIZE();
 		d[0] |= 0x80000000;
 		return;
 	}
@@ -1130,12 +1322,14 @@ cttk_i31_add(uint32_t *d, const uint32_t *a, const uint32_t *b)
 	uint32_t h, cc, tt;
 	size_t len, u;
 
+	STATS_I31(ADD);
 	/*
 	 * Compare sizes. This needs not be constant-time, but take
 	 * care to mask out the NaN bit (since that one may be secret).
 	 */
 	h = d[0] & 0x7FFFFFFF;
 	if (h != (a[0] & 0x7FFFFFFF) || h != (b[0] & 0x7FFFFFFF)) {
+		STATS_NAN_SIZE();
 		d[0] |= 0x80000000;
 		return;
 	}
@@ -1207,12 +1401,14 @@ cttk_i31_add_trunc(uint32_t *d, const uint32_t *a, const uint32_t *b)
 	uint32_t h, cc;
 	size_t len, u;
 
+	STATS_I31(ADD);
 	/*
 	 * Compare sizes. This needs not be constant-time, but take
 	 * care to mask out the NaN bit (since that one may be secret).
 	 */
 	h = d[0] & 0x7FFFFFFF;
 	if (h != (a[0] & 0x7FFFFFFF) || h != (b[0] & 0x7FFFFFFF)) {
+		STATS_NAN_SIZE();
 		d[0] |= 0x80000000;
 		return;
 	}
@@ -1251,12 +1447,14 @@ cttk_i31_sub(uint32_t *d, const uint32_t *a, const uint32_t *b)
 	uint32_t h, cc, tt;
 	size_t len, u;
 
+	STATS_I31(ADD);
 	/*
 	 * Compare sizes. This needs not be constant-time, but take
 	 * care to mask out the NaN bit (since that one may be secret).
 	 */
 	h = d[0] & 0x7FFFFFFF;
 	if (h != (a[0] & 0x7FFFFFFF) || h != (b[0] & 0x7FFFFFFF)) {
+		STATS_NAN_SIZE();
 		d[0] |= 0x80000000;
 		return;
 	}
@@ -1316,12 +1514,14 @@ cttk_i31_sub_trunc(uint32_t *d, const uint32_t *a, const uint32_t *b)
 	uint32_t h, cc;
 	size_t len, u;
 
+	STATS_I31(ADD);
 	/*
 	 * Compare sizes. This needs not be constant-time, but take
 	 * care to mask out the NaN bit (since that one may be secret).
 	 */
 	h = d[0] & 0x7FFFFFFF;
 	if (h != (a[0] & 0x7FFFFFFF) || h != (b[0] & 0x7FFFFFFF)) {
+		STATS_NAN_SIZE();
 		d[0] |= 0x80000000;
 		return;
 	}
@@ -1360,8 +1560,10 @@ cttk_i31_neg(uint32_t *d, const uint32_t *x)
 	uint32_t h, cc, tt;
 	size_t u, len;
 
+	STATS_I31(ADD);
 	h = x[0] & 0x7FFFFFFF;
 	if ((uint32_t)((h ^ d[0]) << 1) != 0) {
+		STATS_NAN_SIZE();
 		d[0] |= 0x80000000;
 		return;
 	}
@@ -1395,8 +1597,10 @@ cttk_i31_neg_trunc(uint32_t *d, const uint32_t *x)
 	uint32_t h, cc;
 	size_t u, len;
 
+	STATS_I31(ADD);
 	h = x[0] & 0x7FFFFFFF;
 	if ((uint32_t)((h ^ d[0]) << 1) != 0) {
+		STATS_NAN_SIZE();
 		d[0] |= 0x80000000;
 		return;
 	}
@@ -1417,36 +1621,45 @@ cttk_i31_neg_trunc(uint32_t *d, const uint32_t *x)
 
 /*
  * Generic multiplication routine. It computes a truncated multiplication,
- * but returns true if and only if the truncation changed the value. This
- * function:
+ * but returns true if and only if the truncation changed the value. If
+ * c is not NULL, then c is added to the product (c + a*b is computed).
+ * This function:
  *  - ignores the NaN flag;
  *  - assumes that source and destination operands have the same size;
- *  - assumes that the destination array is distinct from the source arrays.
- *
- * TODO: use Karatsuba for large inputs.
+ *  - assumes that the destination array is distinct from a and b (but
+ *    it may be equal to c).
  */
 static cttk_bool
-genmul_separate(uint32_t *d, const uint32_t *a, const uint32_t *b)
+genmul_separate(uint32_t *d, const uint32_t *a, const uint32_t *b,
+	const uint32_t *c)
 {
-	uint32_t h, ssa, ssb, ssd;
+	uint32_t h, ssa, ssb, ssc, ssd, wd;
 	size_t u, v, len;
 	uint64_t cc;
-	cttk_bool only0, only1, opz;
+	cttk_bool only0, only1;
 
 	h = d[0] & 0x7FFFFFFF;
 	len = (h + 31) >> 5;
 	ssa = -(uint32_t)(a[len] >> 30) >> 1;
 	ssb = -(uint32_t)(b[len] >> 30) >> 1;
+	ssc = c == NULL ? 0 : -(uint32_t)(c[len] >> 30) >> 1;
 	only0 = cttk_true;
 	only1 = cttk_true;
-	opz = cttk_or(cttk_i31_eq0(a), cttk_i31_eq0(b));
 
+	/*
+	 * The result is computed over 2*len words, which is enough to
+	 * represent it exactly; word c[1+u] is read before d[1+u] is
+	 * written, hence d may be equal to c.
+	 */
 	cc = 0;
+	wd = 0;
 	for (u = 0; u < (len << 1); u ++) {
-		uint32_t wd;
 		uint64_t zd;
 
 		zd = cc;
+		if (c != NULL) {
+			zd += u < len ? c[1 + u] : ssc;
+		}
 		cc = 0;
 		for (v = 0; v <= u; v ++) {
 			uint32_t wa, wb;
@@ -1469,11 +1682,10 @@ genmul_separate(uint32_t *d, const uint32_t *a, const uint32_t *b)
 	}
 
 	/*
-	 * We check that all upper bits have a value compatible with the
-	 * expected result sign.
+	 * The top bit of the last word is the sign of the exact result.
+	 * We check that all upper bits have a value compatible with it.
 	 */
-	ssd = ssa ^ ssb;
-	ssd &= (uint32_t)(opz.v - 1);
+	ssd = -(wd >> 30) >> 1;
 	return cttk_and(
 		cttk_bool_of_u32(cttk_u32_mux(
 			cttk_bool_of_u32(ssd & 1), only1.v, only0.v)),
@@ -1481,70 +1693,362 @@ genmul_separate(uint32_t *d, const uint32_t *a, const uint32_t *b)
 }
 
 /*
- * Multiplication function with a stack-based temporary. Assumptions:
+ * Unsigned product of two sequences of n 31-bit words (little-endian
+ * order, no header). The result (2*n words) is written in d, which must
+ * not overlap with a or b.
+ */
+static void
+umul_school(uint32_t *d, const uint32_t *a, const uint32_t *b, size_t n)
+{
+	size_t u, v;
+
+	memset(d, 0, (n << 1) * sizeof *d);
+	for (u = 0; u < n; u ++) {
+		uint32_t au, cc;
+
+		au = a[u];
+		cc = 0;
+		for (v = 0; v < n; v ++) {
+			uint64_t z;
+
+			z = mulu32w(au, b[v]) + (uint64_t)d[u + v] + (uint64_t)cc;
+			d[u + v] = (uint32_t)z & 0x7FFFFFFF;
+			cc = (uint32_t)(z >> 31);
+		}
+		d[u + n] = cc;
+	}
+}
+
+#if CTTK_KARATSUBA_THRESHOLD < 4
+#error CTTK_KARATSUBA_THRESHOLD must be at least 4
+#endif
+
+/*
+ * Get the size (in words) of the temporary area needed by umul_karatsuba()
+ * for operands of n words.
+ */
+static size_t
+karatsuba_tmp_len(size_t n)
+{
+	size_t tlen;
+
+	tlen = 0;
+	while (n >= CTTK_KARATSUBA_THRESHOLD) {
+		n = n - (n >> 1) + 1;
+		tlen += n << 2;
+	}
+	return tlen;
+}
+
+/*
+ * Unsigned product, as umul_school(), with Karatsuba's method for
+ * operands of at least CTTK_KARATSUBA_THRESHOLD words. The temporary
+ * area t must have length at least karatsuba_tmp_len(n) words.
+ *
+ * Operands are split into a low half (n0 words) and a high half (n1
+ * words, n1 = n0 or n0+1). The low and high products are computed into
+ * d; the middle product (a0+a1)*(b0+b1) is computed over n1+1 words
+ * (the sums may have a carry), then the two other products are
+ * subtracted from it and the result added into d. All lengths depend
+ * only on n, hence the sequence of operations is fixed for a given
+ * operand size.
+ */
+static void
+umul_karatsuba(uint32_t *d, const uint32_t *a, const uint32_t *b,
+	size_t n, uint32_t *t)
+{
+	size_t n0, n1, u;
+	uint32_t *sa, *sb, *zm;
+	uint32_t ca, cb, cc;
+
+	if (n < CTTK_KARATSUBA_THRESHOLD) {
+		umul_school(d, a, b, n);
+		return;
+	}
+	n0 = n >> 1;
+	n1 = n - n0;
+	sa = t;
+	sb = sa + n1 + 1;
+	zm = sb + n1 + 1;
+	t = zm + ((n1 + 1) << 1);
+
+	ca = 0;
+	cb = 0;
+	for (u = 0; u < n1; u ++) {
+		uint32_t wa, wb;
+
+		wa = a[n0 + u] + ca;
+		wb = b[n0 + u] + cb;
+		if (u < n0) {
+			wa += a[u];
+			wb += b[u];
+		}
+		sa[u] = wa & 0x7FFFFFFF;
+		sb[u] = wb & 0x7FFFFFFF;
+		ca = wa >> 31;
+		cb = wb >> 31;
+	}
+	sa[n1] = ca;
+	sb[n1] = cb;
+
+	umul_karatsuba(d, a, b, n0, t);
+	umul_karatsuba(d + (n0 << 1), a + n0, b + n0, n1, t);
+	umul_karatsuba(zm, sa, sb, n1 + 1, t);
+
+	/*
+	 * zm <- zm - a0*b0 - a1*b1 = a0*b1 + a1*b0
+	 */
+	cc = 0;
+	for (u = 0; u < ((n1 + 1) << 1); u ++) {
+		uint32_t w;
+
+		w = zm[u] - cc;
+		if (u < (n0 << 1)) {
+			w -= d[u];
+		}
+		zm[u] = w & 0x7FFFFFFF;
+		cc = w >> 31;
+	}
+	cc = 0;
+	for (u = 0; u < ((n1 + 1) << 1); u ++) {
+		uint32_t w;
+
+		w = zm[u] - cc;
+		if (u < (n1 << 1)) {
+			w -= d[(n0 << 1) + u];
+		}
+		zm[u] = w & 0x7FFFFFFF;
+		cc = w >> 31;
+	}
+
+	/*
+	 * d <- d + zm*2^(31*n0)
+	 */
+	cc = 0;
+	for (u = 0; u < (n << 1) - n0; u ++) {
+		uint32_t w;
+
+		w = d[n0 + u] + cc;
+		if (u < ((n1 + 1) << 1)) {
+			w += zm[u];
+		}
+		d[n0 + u] = w & 0x7FFFFFFF;
+		cc = w >> 31;
+	}
+}
+
+/* see inner.h */
+void
+cttk_i31_umul_words(uint32_t *d, const uint32_t *a, const uint32_t *b,
+	size_t n, uint32_t *t)
+{
+	umul_karatsuba(d, a, b, n, t);
+}
+
+/* see inner.h */
+size_t
+cttk_i31_umul_tmp_len(size_t n)
+{
+	return karatsuba_tmp_len(n);
+}
+
+/*
+ * Multiplication with Karatsuba's method. This has the same semantics
+ * as genmul_separate(), except that d may be equal to a and/or b. The
+ * temporary area t must have length at least 2*len+karatsuba_tmp_len(len)
+ * words, where len is the number of value words in the operands.
  *
- *  - d is equal (same pointer value) to a or b or both;
- *  - a, b and d have the same size;
- *  - the common size does not exceed CTTK_MAX_INT_BUF bytes.
+ * The unsigned product of the two's complement representations is
+ * computed first; the signed product modulo 2^(62*len) is then obtained
+ * by subtracting b (if a < 0) and a (if b < 0) from the upper half.
  */
 static cttk_bool
-genmul_stack(uint32_t *d, const uint32_t *a, const uint32_t *b)
+genmul_karatsuba(uint32_t *d, const uint32_t *a, const uint32_t *b,
+	const uint32_t *c, uint32_t *t)
+{
+	uint32_t h, ssa, ssb, ssc, ssd, cc;
+	size_t u, len;
+	uint32_t *p;
+	cttk_bool only0, only1;
+
+	h = d[0] & 0x7FFFFFFF;
+	len = (h + 31) >> 5;
+	ssa = -(uint32_t)(a[len] >> 30) >> 1;
+	ssb = -(uint32_t)(b[len] >> 30) >> 1;
+
+	p = t;
+	umul_karatsuba(p, a + 1, b + 1, len, p + (len << 1));
+	cc = 0;
+	for (u = 0; u < len; u ++) {
+		uint32_t w;
+
+		w = p[len + u] - (b[1 + u] & ssa) - cc;
+		p[len + u] = w & 0x7FFFFFFF;
+		cc = w >> 31;
+	}
+	cc = 0;
+	for (u = 0; u < len; u ++) {
+		uint32_t w;
+
+		w = p[len + u] - (a[1 + u] & ssb) - cc;
+		p[len + u] = w & 0x7FFFFFFF;
+		cc = w >> 31;
+	}
+	if (c != NULL) {
+		ssc = -(uint32_t)(c[len] >> 30) >> 1;
+		cc = 0;
+		for (u = 0; u < (len << 1); u ++) {
+			uint32_t w;
+
+			w = p[u] + (u < len ? c[1 + u] : ssc) + cc;
+			p[u] = w & 0x7FFFFFFF;
+			cc = w >> 31;
+		}
+	}
+
+	only0 = cttk_true;
+	only1 = cttk_true;
+	for (u = len; u < (len << 1); u ++) {
+		only0 = cttk_and(only0, cttk_u32_eq0(p[u]));
+		only1 = cttk_and(only1, cttk_u32_eq0(p[u] ^ 0x7FFFFFFF));
+	}
+	memcpy(d + 1, p, len * sizeof *d);
+
+	/*
+	 * We check that all upper bits have a value compatible with the
+	 * result sign (as in genmul_separate()).
+	 */
+	ssd = -(p[(len << 1) - 1] >> 30) >> 1;
+	return cttk_and(
+		cttk_bool_of_u32(cttk_u32_mux(
+			cttk_bool_of_u32(ssd & 1), only1.v, only0.v)),
+		cttk_u32_eq0((d[len] ^ ssd) >> top_index(h)));
+}
+
+/*
+ * Get the length (in words) of the temporary buffer that allows
+ * genmul_buf() to use its fastest method, for operands with header h.
+ * Karatsuba multiplication handles aliasing by itself; otherwise, a
+ * temporary for the product is needed only if d is equal to a or b,
+ * but we always count it.
+ */
+static size_t
+genmul_tmp_len(uint32_t h)
+{
+	size_t len;
+
+	len = (h + 31) >> 5;
+	if (len >= CTTK_KARATSUBA_THRESHOLD) {
+		return (len << 1) + karatsuba_tmp_len(len);
+	}
+	return len + 1;
+}
+
+/*
+ * Verify operand sizes for a multiplication (with an optional addend c),
+ * and set the destination header. Returned value is 0 (and d is set to
+ * NaN) on size mismatch.
+ */
+static int
+genmul_check(uint32_t *d, const uint32_t *a, const uint32_t *b,
+	const uint32_t *c)
+{
+	uint32_t h;
+
+	h = d[0] & 0x7FFFFFFF;
+	if (h != (a[0] & 0x7FFFFFFF) || h != (b[0] & 0x7FFFFFFF)
+		|| (c != NULL && h != (c[0] & 0x7FFFFFFF)))
+	{
+		STATS_NAN_SIZE();
+		d[0] |= 0x80000000;
+		return 0;
+	}
+	d[0] = a[0] | b[0] | (c == NULL ? 0 : c[0]);
+	return 1;
+}
+
+/*
+ * Multiplication (with optional addend c) with a caller-provided
+ * temporary t of tlen words (sizes have been verified). Karatsuba
+ * multiplication is used if the operands are large enough and the
+ * temporary is big enough; otherwise, the schoolbook method is used,
+ * with the temporary receiving the product if d is equal to a or b.
+ * If the temporary is too small for that, then d is set to NaN.
+ */
+static cttk_bool
+genmul_buf(uint32_t *d, const uint32_t *a, const uint32_t *b,
+	const uint32_t *c, uint32_t *t, size_t tlen)
 {
-	uint32_t t[CTTK_MAX_INT_BUF / sizeof(uint32_t)];
 	uint32_t h;
 	size_t len;
 	cttk_bool r;
 
 	h = d[0] & 0x7FFFFFFF;
-	t[0] = h;
 	len = (h + 31) >> 5;
+	if (len >= CTTK_KARATSUBA_THRESHOLD
+		&& tlen >= (len << 1) + karatsuba_tmp_len(len))
+	{
+		return genmul_karatsuba(d, a, b, c, t);
+	}
+	if (d != a && d != b) {
+		return genmul_separate(d, a, b, c);
+	}
+	if (tlen < len + 1) {
+		STATS_NAN_SCRATCH();
+		d[0] |= 0x80000000;
+		return cttk_false;
+	}
+	t[0] = h;
 	memset(t + 1, 0, len * sizeof t[0]);
-	r = genmul_separate(t, a, b);
+	r = genmul_separate(t, a, b, c);
 	memcpy(d + 1, t + 1, len * sizeof *d);
 	return r;
 }
 
+/*
+ * Multiplication with a stack-based temporary.
+ */
 static cttk_bool
-genmul(uint32_t *d, const uint32_t *a, const uint32_t *b)
+genmul_stack(uint32_t *d, const uint32_t *a, const uint32_t *b,
+	const uint32_t *c)
 {
-	uint32_t h;
-	size_t blen;
+	uint32_t t[CTTK_MAX_INT_BUF / sizeof(uint32_t)];
 
-	h = d[0] & 0x7FFFFFFF;
-	if (h != (a[0] & 0x7FFFFFFF) || h != (b[0] & 0x7FFFFFFF)) {
-		d[0] |= 0x80000000;
+	return genmul_buf(d, a, b, c, t, sizeof t / sizeof t[0]);
+}
+
+static cttk_bool
+genmul(uint32_t *d, const uint32_t *a, const uint32_t *b, const uint32_t *c)
+{
+	size_t tlen;
+
+	if (!genmul_check(d, a, b, c)) {
 		return cttk_false;
 	}
-	d[0] = a[0] | b[0];
 
-	if (d != a && d != b) {
-		return genmul_separate(d, a, b);
-	}
-	blen = ((h + 63) >> 5) * sizeof *d;
-	if (blen <= CTTK_MAX_INT_BUF) {
-		return genmul_stack(d, a, b);
-	}
+	/*
+	 * If the temporary does not fit on the stack, then we try to
+	 * allocate it. If that fails, we use the stack anyway, which
+	 * implies falling back to the schoolbook method, if possible.
+	 */
+	tlen = genmul_tmp_len(d[0] & 0x7FFFFFFF);
 #if !CTTK_NO_MALLOC
-	{
+	if (tlen > (CTTK_MAX_INT_BUF / sizeof(uint32_t))) {
 		uint32_t *t;
 
-		t = malloc(blen);
+		t = cttk_scratch_alloc(tlen * sizeof *t);
 		if (t != NULL) {
 			cttk_bool r;
-			size_t len;
 
-			t[0] = h;
-			len = (h + 31) >> 5;
-			memset(t + 1, 0, len * sizeof *t);
-			r = genmul_separate(t, a, b);
-			memcpy(d + 1, t + 1, len * sizeof *t);
+			r = genmul_buf(d, a, b, c, t, tlen);
 			free(t);
 			return r;
 		}
 	}
+#else
+	(void)tlen;
 #endif
-	d[0] |= 0x80000000;
-	return cttk_false;
+	return genmul_stack(d, a, b, c);
 }
 
 /* see cttk.h */
@@ -1553,7 +2057,8 @@ cttk_i31_mul(uint32_t *d, const uint32_t *a, const uint32_t *b)
 {
 	cttk_bool r;
 
-	r = genmul(d, a, b);
+	STATS_I31(MUL);
+	r = genmul(d, a, b, NULL);
 	d[0] |= (r.v ^ 1) << 31;
 }
 
@@ -1564,25 +2069,554 @@ cttk_i31_mul_trunc(uint32_t *d, const uint32_t *a, const uint32_t *b)
 	uint32_t h;
 	size_t len;
 
-	genmul(d, a, b);
+	STATS_I31(MUL);
+	genmul(d, a, b, NULL);
 	h = d[0] & 0x7FFFFFFF;
 	len = (h + 31) >> 5;
 	d[len] = signext(d[len], top_index(h) + 1) & 0x7FFFFFFF;
 }
 
-/*
- * Generic left-shift function:
- *
- *  - d and a must have been already verified to have the same size.
- *  - Shift count is n = nd*31+nm, with 0 <= nm < 31, and n fits on 32 bits.
- *  - If ctl is false, then the shift is not actually done.
- *
- * Returned value is false if the value overflows/underflows.
- *
- * nd and nm may leak.
- */
-static cttk_bool
-genlsh(uint32_t *d, const uint32_t *a, uint32_t nd, unsigned nm, cttk_bool ctl)
+/* see cttk.h */
+void
+cttk_i31_mul_ws(uint32_t *d, const uint32_t *a, const uint32_t *b,
+	uint32_t *tmp, size_t tmp_len)
+{
+	cttk_bool r;
+
+	STATS_I31(MUL);
+	if (!genmul_check(d, a, b, NULL)) {
+		return;
+	}
+	r = genmul_buf(d, a, b, NULL, tmp, tmp_len);
+	d[0] |= (r.v ^ 1) << 31;
+}
+
+/* see cttk.h */
+void
+cttk_i31_muladd(uint32_t *d, const uint32_t *a, const uint32_t *b,
+	const uint32_t *c)
+{
+	cttk_bool r;
+
+	STATS_I31(MUL);
+	r = genmul(d, a, b, c);
+	d[0] |= (r.v ^ 1) << 31;
+}
+
+/* see cttk.h */
+void
+cttk_i31_muladd_trunc(uint32_t *d, const uint32_t *a, const uint32_t *b,
+	const uint32_t *c)
+{
+	uint32_t h;
+	size_t len;
+
+	STATS_I31(MUL);
+	genmul(d, a, b, c);
+	h = d[0] & 0x7FFFFFFF;
+	len = (h + 31) >> 5;
+	d[len] = signext(d[len], top_index(h) + 1) & 0x7FFFFFFF;
+}
+
+/*
+ * Multiplication by a small scalar: d <- a*x + c, where c is either
+ * NULL (no addend) or equal to d. Sizes must have been verified. Since
+ * each input word is read only once, and before the corresponding
+ * output word is written, d may also be equal to a. Returned value is
+ * true if and only if the result was not truncated.
+ */
+static cttk_bool
+genmul_u32(uint32_t *d, const uint32_t *a, uint32_t x, const uint32_t *c)
+{
+	uint32_t h, ssa, ssc, ssd, wd;
+	size_t u, len;
+	uint64_t cc;
+	cttk_bool only0, only1;
+
+	h = d[0] & 0x7FFFFFFF;
+	len = (h + 31) >> 5;
+	ssa = -(uint32_t)(a[len] >> 30) >> 1;
+	ssc = c == NULL ? 0 : -(uint32_t)(c[len] >> 30) >> 1;
+	only0 = cttk_true;
+	only1 = cttk_true;
+
+	/*
+	 * The exact result fits on len+2 words.
+	 */
+	cc = 0;
+	wd = 0;
+	for (u = 0; u < len + 2; u ++) {
+		uint64_t z;
+
+		z = mulu32w(u < len ? a[1 + u] : ssa, x) + cc;
+		if (c != NULL) {
+			z += u < len ? c[1 + u] : ssc;
+		}
+		wd = (uint32_t)z & 0x7FFFFFFF;
+		cc = z >> 31;
+		if (u < len) {
+			d[1 + u] = wd;
+		} else {
+			only0 = cttk_and(only0, cttk_u32_eq0(wd));
+			only1 = cttk_and(only1, cttk_u32_eq0(wd ^ 0x7FFFFFFF));
+		}
+	}
+	ssd = -(wd >> 30) >> 1;
+	return cttk_and(
+		cttk_bool_of_u32(cttk_u32_mux(
+			cttk_bool_of_u32(ssd & 1), only1.v, only0.v)),
+		cttk_u32_eq0((d[len] ^ ssd) >> top_index(h)));
+}
+
+/*
+ * Verify operand sizes for a multiplication by a small scalar, and set
+ * the destination header (if add is non-zero, then the current value
+ * of d is the addend). Returned value is 0 (and d is set to NaN) on
+ * size mismatch.
+ */
+static int
+genmul_u32_check(uint32_t *d, const uint32_t *a, int add)
+{
+	if (((d[0] ^ a[0]) & 0x7FFFFFFF) != 0) {
+		STATS_NAN_SIZE();
+		d[0] |= 0x80000000;
+		return 0;
+	}
+	d[0] = add ? (d[0] | a[0]) : a[0];
+	return 1;
+}
+
+/* see cttk.h */
+void
+cttk_i31_mul_u32(uint32_t *d, const uint32_t *a, uint32_t x)
+{
+	cttk_bool r;
+
+	STATS_I31(MUL);
+	if (!genmul_u32_check(d, a, 0)) {
+		return;
+	}
+	r = genmul_u32(d, a, x, NULL);
+	d[0] |= (r.v ^ 1) << 31;
+}
+
+/* see cttk.h */
+void
+cttk_i31_mul_u32_trunc(uint32_t *d, const uint32_t *a, uint32_t x)
+{
+	uint32_t h;
+	size_t len;
+
+	STATS_I31(MUL);
+	if (!genmul_u32_check(d, a, 0)) {
+		return;
+	}
+	genmul_u32(d, a, x, NULL);
+	h = d[0] & 0x7FFFFFFF;
+	len = (h + 31) >> 5;
+	d[len] = signext(d[len], top_index(h) + 1) & 0x7FFFFFFF;
+}
+
+/* see cttk.h */
+void
+cttk_i31_addmul_u32(uint32_t *d, const uint32_t *a, uint32_t x)
+{
+	cttk_bool r;
+
+	STATS_I31(MUL);
+	if (!genmul_u32_check(d, a, 1)) {
+		return;
+	}
+	r = genmul_u32(d, a, x, d);
+	d[0] |= (r.v ^ 1) << 31;
+}
+
+/* see cttk.h */
+void
+cttk_i31_addmul_u32_trunc(uint32_t *d, const uint32_t *a, uint32_t x)
+{
+	uint32_t h;
+	size_t len;
+
+	STATS_I31(MUL);
+	if (!genmul_u32_check(d, a, 1)) {
+		return;
+	}
+	genmul_u32(d, a, x, d);
+	h = d[0] & 0x7FFFFFFF;
+	len = (h + 31) >> 5;
+	d[len] = signext(d[len], top_index(h) + 1) & 0x7FFFFFFF;
+}
+
+/*
+ * Set m (len words, no header) to the absolute value of a. Since a fits
+ * on h bits, its absolute value fits on h-1 bits, and the len value
+ * words are enough even for the minimal value.
+ */
+static void
+abs_words(uint32_t *m, const uint32_t *a, size_t len)
+{
+	uint32_t ss, cc;
+	size_t u;
+
+	ss = -(uint32_t)(a[len] >> 30) >> 1;
+	cc = ss & 1;
+	for (u = 0; u < len; u ++) {
+		uint32_t w;
+
+		w = (a[1 + u] ^ ss) + cc;
+		m[u] = w & 0x7FFFFFFF;
+		cc = w >> 31;
+	}
+}
+
+/*
+ * Generic squaring routine. The source value is a; its absolute value
+ * must have been written in m (len words, see abs_words()). Semantics
+ * are the same as with genmul_separate(d, a, a), but each cross product
+ * m[i]*m[j] (with i != j) is computed only once, then doubled. Since m
+ * is a copy, d may be equal to a.
+ */
+static cttk_bool
+gensqr_separate(uint32_t *d, const uint32_t *m)
+{
+	uint32_t h;
+	size_t u, v, len;
+	uint64_t cc;
+	cttk_bool only0;
+
+	h = d[0] & 0x7FFFFFFF;
+	len = (h + 31) >> 5;
+	only0 = cttk_true;
+
+	cc = 0;
+	for (u = 0; u < (len << 1); u ++) {
+		uint32_t wd;
+		uint64_t zd, zh, zr;
+
+		zd = 0;
+		zh = 0;
+		for (v = u < len ? 0 : u + 1 - len; (v << 1) < u; v ++) {
+			zr = mulu32w(m[v], m[u - v]);
+			zd += zr & 0x7FFFFFFF;
+			zh += zr >> 31;
+		}
+		zd <<= 1;
+		zh <<= 1;
+		if ((u & 1) == 0) {
+			zr = mulu32w(m[u >> 1], m[u >> 1]);
+			zd += zr & 0x7FFFFFFF;
+			zh += zr >> 31;
+		}
+		zd += cc;
+		cc = zh + (zd >> 31);
+		wd = (uint32_t)zd & 0x7FFFFFFF;
+		if (u < len) {
+			d[1 + u] = wd;
+		} else {
+			only0 = cttk_and(only0, cttk_u32_eq0(wd));
+		}
+	}
+
+	/*
+	 * The square is nonnegative, so all upper bits must be zero.
+	 */
+	return cttk_and(only0, cttk_u32_eq0(d[len] >> top_index(h)));
+}
+
+/*
+ * Unsigned square of a sequence of n 31-bit words (little-endian order,
+ * no header). The result (2*n words) is written in d, which must not
+ * overlap with a. Cross products are accumulated first, then the
+ * total is doubled and the diagonal products are added.
+ */
+static void
+usqr_school(uint32_t *d, const uint32_t *a, size_t n)
+{
+	size_t u, v;
+	uint32_t cc;
+
+	memset(d, 0, (n << 1) * sizeof *d);
+	for (u = 0; u < n; u ++) {
+		uint32_t au;
+
+		au = a[u];
+		cc = 0;
+		for (v = u + 1; v < n; v ++) {
+			uint64_t z;
+
+			z = mulu32w(au, a[v]) + (uint64_t)d[u + v] + (uint64_t)cc;
+			d[u + v] = (uint32_t)z & 0x7FFFFFFF;
+			cc = (uint32_t)(z >> 31);
+		}
+		d[u + n] = cc;
+	}
+	cc = 0;
+	for (u = 0; u < n; u ++) {
+		uint64_t z, w;
+
+		z = mulu32w(a[u], a[u]);
+		w = ((uint64_t)d[u << 1] << 1) + (z & 0x7FFFFFFF) + cc;
+		d[u << 1] = (uint32_t)w & 0x7FFFFFFF;
+		cc = (uint32_t)(w >> 31);
+		w = ((uint64_t)d[(u << 1) + 1] << 1) + (z >> 31) + cc;
+		d[(u << 1) + 1] = (uint32_t)w & 0x7FFFFFFF;
+		cc = (uint32_t)(w >> 31);
+	}
+}
+
+/*
+ * Unsigned square, as usqr_school(), with Karatsuba's method for
+ * operands of at least CTTK_KARATSUBA_THRESHOLD words. This follows
+ * umul_karatsuba(), except that the three sub-products are squares,
+ * and only one middle sum is needed; karatsuba_tmp_len(n) words of
+ * temporary are thus sufficient.
+ */
+static void
+usqr_karatsuba(uint32_t *d, const uint32_t *a, size_t n, uint32_t *t)
+{
+	size_t n0, n1, u;
+	uint32_t *sa, *zm;
+	uint32_t ca, cc;
+
+	if (n < CTTK_KARATSUBA_THRESHOLD) {
+		usqr_school(d, a, n);
+		return;
+	}
+	n0 = n >> 1;
+	n1 = n - n0;
+	sa = t;
+	zm = sa + n1 + 1;
+	t = zm + ((n1 + 1) << 1);
+
+	ca = 0;
+	for (u = 0; u < n1; u ++) {
+		uint32_t wa;
+
+		wa = a[n0 + u] + ca;
+		if (u < n0) {
+			wa += a[u];
+		}
+		sa[u] = wa & 0x7FFFFFFF;
+		ca = wa >> 31;
+	}
+	sa[n1] = ca;
+
+	usqr_karatsuba(d, a, n0, t);
+	usqr_karatsuba(d + (n0 << 1), a + n0, n1, t);
+	usqr_karatsuba(zm, sa, n1 + 1, t);
+
+	/*
+	 * zm <- zm - a0^2 - a1^2 = 2*a0*a1
+	 */
+	cc = 0;
+	for (u = 0; u < ((n1 + 1) << 1); u ++) {
+		uint32_t w;
+
+		w = zm[u] - cc;
+		if (u < (n0 << 1)) {
+			w -= d[u];
+		}
+		zm[u] = w & 0x7FFFFFFF;
+		cc = w >> 31;
+	}
+	cc = 0;
+	for (u = 0; u < ((n1 + 1) << 1); u ++) {
+		uint32_t w;
+
+		w = zm[u] - cc;
+		if (u < (n1 << 1)) {
+			w -= d[(n0 << 1) + u];
+		}
+		zm[u] = w & 0x7FFFFFFF;
+		cc = w >> 31;
+	}
+
+	/*
+	 * d <- d + zm*2^(31*n0)
+	 */
+	cc = 0;
+	for (u = 0; u < (n << 1) - n0; u ++) {
+		uint32_t w;
+
+		w = d[n0 + u] + cc;
+		if (u < ((n1 + 1) << 1)) {
+			w += zm[u];
+		}
+		d[n0 + u] = w & 0x7FFFFFFF;
+		cc = w >> 31;
+	}
+}
+
+/*
+ * Squaring with Karatsuba's method. The absolute value of a must have
+ * been written in m (len words), and the temporary area t must have
+ * length at least 2*len+karatsuba_tmp_len(len) words.
+ */
+static cttk_bool
+gensqr_karatsuba(uint32_t *d, const uint32_t *m, uint32_t *t)
+{
+	uint32_t h;
+	size_t u, len;
+	cttk_bool only0;
+
+	h = d[0] & 0x7FFFFFFF;
+	len = (h + 31) >> 5;
+	usqr_karatsuba(t, m, len, t + (len << 1));
+	only0 = cttk_true;
+	for (u = len; u < (len << 1); u ++) {
+		only0 = cttk_and(only0, cttk_u32_eq0(t[u]));
+	}
+	memcpy(d + 1, t, len * sizeof *d);
+	return cttk_and(only0, cttk_u32_eq0(d[len] >> top_index(h)));
+}
+
+/*
+ * Get the length (in words) of the temporary buffer that allows
+ * gensqr_buf() to use its fastest method, for an operand with header h.
+ * The absolute value of the operand always uses the first len words.
+ */
+static size_t
+gensqr_tmp_len(uint32_t h)
+{
+	size_t len;
+
+	len = (h + 31) >> 5;
+	if (len >= CTTK_KARATSUBA_THRESHOLD) {
+		return 3 * len + karatsuba_tmp_len(len);
+	}
+	return len;
+}
+
+/*
+ * Verify operand sizes for a squaring, and set the destination header.
+ * Returned value is 0 (and d is set to NaN) on size mismatch.
+ */
+static int
+gensqr_check(uint32_t *d, const uint32_t *a)
+{
+	if ((d[0] & 0x7FFFFFFF) != (a[0] & 0x7FFFFFFF)) {
+		STATS_NAN_SIZE();
+		d[0] |= 0x80000000;
+		return 0;
+	}
+	d[0] = a[0];
+	return 1;
+}
+
+/*
+ * Squaring with a caller-provided temporary t of tlen words (sizes
+ * have been verified). If the temporary cannot even hold the absolute
+ * value of a, then the generic multiplication is used if d and a are
+ * distinct; otherwise, d is set to NaN.
+ */
+static cttk_bool
+gensqr_buf(uint32_t *d, const uint32_t *a, uint32_t *t, size_t tlen)
+{
+	uint32_t h;
+	size_t len;
+
+	h = d[0] & 0x7FFFFFFF;
+	len = (h + 31) >> 5;
+	if (tlen < len) {
+		if (d != a) {
+			return genmul_separate(d, a, a, NULL);
+		}
+		STATS_NAN_SCRATCH();
+		d[0] |= 0x80000000;
+		return cttk_false;
+	}
+	abs_words(t, a, len);
+	if (len >= CTTK_KARATSUBA_THRESHOLD
+		&& tlen >= 3 * len + karatsuba_tmp_len(len))
+	{
+		return gensqr_karatsuba(d, t, t + len);
+	}
+	return gensqr_separate(d, t);
+}
+
+/*
+ * Squaring with a stack-based temporary.
+ */
+static cttk_bool
+gensqr_stack(uint32_t *d, const uint32_t *a)
+{
+	uint32_t t[CTTK_MAX_INT_BUF / sizeof(uint32_t)];
+
+	return gensqr_buf(d, a, t, sizeof t / sizeof t[0]);
+}
+
+static cttk_bool
+gensqr(uint32_t *d, const uint32_t *a)
+{
+	size_t tlen;
+
+	if (!gensqr_check(d, a)) {
+		return cttk_false;
+	}
+
+	/*
+	 * As in genmul(), a temporary that does not fit on the stack
+	 * is allocated if possible.
+	 */
+	tlen = gensqr_tmp_len(d[0] & 0x7FFFFFFF);
+#if !CTTK_NO_MALLOC
+	if (tlen > (CTTK_MAX_INT_BUF / sizeof(uint32_t))) {
+		uint32_t *t;
+
+		t = cttk_scratch_alloc(tlen * sizeof *t);
+		if (t != NULL) {
+			cttk_bool r;
+
+			r = gensqr_buf(d, a, t, tlen);
+			free(t);
+			return r;
+		}
+	}
+#else
+	(void)tlen;
+#endif
+	return gensqr_stack(d, a);
+}
+
+/* see cttk.h */
+void
+cttk_i31_sqr(uint32_t *d, const uint32_t *a)
+{
+	cttk_bool r;
+
+	STATS_I31(MUL);
+	r = gensqr(d, a);
+	d[0] |= (r.v ^ 1) << 31;
+}
+
+/* see cttk.h */
+void
+cttk_i31_sqr_trunc(uint32_t *d, const uint32_t *a)
+{
+	uint32_t h;
+	size_t len;
+
+	STATS_I31(MUL);
+	gensqr(d, a);
+	h = d[0] & 0x7FFFFFFF;
+	len = (h + 31) >> 5;
+	d[len] = signext(d[len], top_index(h) + 1) & 0x7FFFFFFF;
+}
+
+/*
+ * Generic left-shift function:
+ *
+ *  - d and a must have been already verified to have the same size.
+ *  - Shift count is n = nd*31+nm, with 0 <= nm < 31, and n fits on 32 bits.
+ *  - If ctl is false, then the shift is not actually done.
+ *
+ * Returned value is false if the value overflows/underflows.
+ *
+ * nd and nm may leak.
+ */
+static cttk_bool
+genlsh(uint32_t *d, const uint32_t *a, uint32_t nd, unsigned nm, cttk_bool ctl)
 {
 	uint32_t n, h, hk, bl, ssa, tt;
 	size_t len, u;
@@ -1773,7 +2807,9 @@ cttk_i31_lsh(uint32_t *d, const uint32_t *a, uint32_t n)
 {
 	cttk_bool r;
 
+	STATS_I31(SHIFT);
 	if (((d[0] ^ a[0]) << 1) != 0) {
+		STATS_NAN_SIZE();
 		d[0] |= 0x80000000;
 		return;
 	}
@@ -1787,7 +2823,9 @@ cttk_i31_lsh_prot(uint32_t *d, const uint32_t *a, uint32_t n)
 {
 	int i;
 
+	STATS_I31(SHIFT);
 	if (((d[0] ^ a[0]) << 1) != 0) {
+		STATS_NAN_SIZE();
 		d[0] |= 0x80000000;
 		return;
 	}
@@ -1805,7 +2843,9 @@ cttk_i31_lsh_prot(uint32_t *d, const uint32_t *a, uint32_t n)
 void
 cttk_i31_lsh_trunc(uint32_t *d, const uint32_t *a, uint32_t n)
 {
+	STATS_I31(SHIFT);
 	if (((d[0] ^ a[0]) << 1) != 0) {
+		STATS_NAN_SIZE();
 		d[0] |= 0x80000000;
 		return;
 	}
@@ -1818,7 +2858,9 @@ cttk_i31_lsh_trunc_prot(uint32_t *d, const uint32_t *a, uint32_t n)
 {
 	int i;
 
+	STATS_I31(SHIFT);
 	if (((d[0] ^ a[0]) << 1) != 0) {
+		STATS_NAN_SIZE();
 		d[0] |= 0x80000000;
 		return;
 	}
@@ -1833,7 +2875,9 @@ cttk_i31_lsh_trunc_prot(uint32_t *d, const uint32_t *a, uint32_t n)
 void
 cttk_i31_rsh(uint32_t *d, const uint32_t *a, uint32_t n)
 {
+	STATS_I31(SHIFT);
 	if (((d[0] ^ a[0]) << 1) != 0) {
+		STATS_NAN_SIZE();
 		d[0] |= 0x80000000;
 		return;
 	}
@@ -1846,7 +2890,9 @@ cttk_i31_rsh_prot(uint32_t *d, const uint32_t *a, uint32_t n)
 {
 	int i;
 
+	STATS_I31(SHIFT);
 	if (((d[0] ^ a[0]) << 1) != 0) {
+		STATS_NAN_SIZE();
 		d[0] |= 0x80000000;
 		return;
 	}
@@ -1857,6 +2903,219 @@ cttk_i31_rsh_prot(uint32_t *d, const uint32_t *a, uint32_t n)
 	}
 }
 
+/*
+ * Get the bit length of a nonnegative integer represented over len
+ * 31-bit words (little-endian order, no header).
+ */
+static uint32_t
+words_bitlength(const uint32_t *x, size_t len)
+{
+	uint32_t bl;
+	size_t u;
+
+	bl = 0;
+	for (u = 0; u < len; u ++) {
+		uint32_t w;
+
+		w = x[u];
+		bl = cttk_u32_mux(cttk_u32_neq0(w),
+			31 * (uint32_t)u + cttk_u32_bitlength(w), bl);
+	}
+	return bl;
+}
+
+/*
+ * Left-shift a sequence of len 31-bit words by n bits, in place. Bits
+ * pushed beyond the last word are dropped. The shift count is protected;
+ * it must be lower than 2^nb, and the memory access pattern depends only
+ * on len and nb.
+ */
+static void
+words_lsh_prot(uint32_t *x, size_t len, uint32_t n, unsigned nb)
+{
+	unsigned i;
+
+	for (i = 0; i < nb; i ++) {
+		cttk_bool ctl;
+		size_t nd, u;
+		unsigned nm;
+
+		ctl = cttk_u32_neq0(n & ((uint32_t)1 << i));
+		nd = p2m31[i << 1];
+		nm = p2m31[(i << 1) + 1];
+		for (u = len; u -- > 0;) {
+			uint32_t w;
+
+			w = 0;
+			if (u >= nd) {
+				w = (x[u - nd] << nm) & 0x7FFFFFFF;
+				if (u > nd) {
+					w |= x[u - nd - 1] >> (31 - nm);
+				}
+			}
+			x[u] = cttk_u32_mux(ctl, w, x[u]);
+		}
+	}
+}
+
+/*
+ * Right-shift a sequence of len 31-bit words by n bits, in place. Zeros
+ * are shifted in from the top. As with words_lsh_prot(), the shift count
+ * is protected and must be lower than 2^nb.
+ */
+static void
+words_rsh_prot(uint32_t *x, size_t len, uint32_t n, unsigned nb)
+{
+	unsigned i;
+
+	for (i = 0; i < nb; i ++) {
+		cttk_bool ctl;
+		size_t nd, u;
+		unsigned nm;
+
+		ctl = cttk_u32_neq0(n & ((uint32_t)1 << i));
+		nd = p2m31[i << 1];
+		nm = p2m31[(i << 1) + 1];
+		for (u = 0; u < len; u ++) {
+			uint32_t w;
+
+			w = 0;
+			if (nd < len - u) {
+				w = x[u + nd] >> nm;
+				if (nd + 1 < len - u) {
+					w |= (x[u + nd + 1] << (31 - nm))
+						& 0x7FFFFFFF;
+				}
+			}
+			x[u] = cttk_u32_mux(ctl, w, x[u]);
+		}
+	}
+}
+
+/*
+ * Divide the 62-bit value hi*2^31+lo by d; hi and lo must fit on 31 bits
+ * each, and d must be such that 2^30 <= d < 2^31. If hi >= d, then the
+ * quotient does not fit on 31 bits, and 0x7FFFFFFF is returned instead.
+ * This is a plain restoring division, in constant time.
+ */
+static uint32_t
+divw(uint32_t hi, uint32_t lo, uint32_t d)
+{
+	uint64_t x;
+	uint32_t q;
+	int k;
+
+	x = ((uint64_t)hi << 31) | (uint64_t)lo;
+	q = 0;
+	for (k = 30; k >= 0; k --) {
+		uint64_t t;
+		uint32_t c;
+
+		t = x - ((uint64_t)d << k);
+		c = (uint32_t)(t >> 63) ^ 1;
+		x = cttk_u64_mux(cttk_bool_of_u32(c), t, x);
+		q |= c << k;
+	}
+	return q | (-cttk_u32_geq(hi, d).v >> 1);
+}
+
+/*
+ * Word-wise division of nonnegative integers, on raw 31-bit words
+ * (little-endian order, no header). The dividend x has nx words, the
+ * divisor y has ny words, with 1 <= ny <= nx; y must not be zero.
+ * On output, the quotient is written in q (nx words; q may be NULL),
+ * and the remainder in the first ny words of x (the other words of x
+ * are set to 0). The contents of y are destroyed. t must have room
+ * for nx+ny words.
+ *
+ * This is schoolbook long division in base 2^31. Both operands are
+ * first shifted (with a protected shift count) so that the top bit
+ * of the divisor is set; each quotient word is then estimated from
+ * the top two words of the current partial remainder and the top word
+ * of the divisor. That estimate is never too small, and exceeds the
+ * correct value by at most 2; two conditional add-back steps, which
+ * are always performed, fix it. Memory access pattern and instruction
+ * sequence depend only on nx and ny.
+ */
+static void
+divmod_words(uint32_t *q, uint32_t *x, size_t nx,
+	uint32_t *y, size_t ny, uint32_t *t)
+{
+	uint32_t s, yt;
+	unsigned nb;
+	size_t j, u;
+
+	s = 31 * (uint32_t)ny - words_bitlength(y, ny);
+	nb = cttk_u32_bitlength(31 * (uint32_t)ny - 1);
+	words_lsh_prot(y, ny, s, nb);
+	memcpy(t, x, nx * sizeof *x);
+	memset(t + nx, 0, ny * sizeof *t);
+	words_lsh_prot(t, nx + ny, s, nb);
+	yt = y[ny - 1];
+
+	for (j = nx; j -- > 0;) {
+		uint32_t *w;
+		uint32_t qw, cc, wu, neg;
+		int k;
+
+		/*
+		 * The current partial remainder is in w[0..ny] and is
+		 * lower than y*2^31.
+		 */
+		w = t + j;
+		qw = divw(w[ny], w[ny - 1], yt);
+
+		/*
+		 * Subtract qw*y; neg is set if the result is negative.
+		 */
+		cc = 0;
+		for (u = 0; u < ny; u ++) {
+			uint64_t z;
+
+			z = mulu32w(qw, y[u]) + (uint64_t)cc;
+			cc = (uint32_t)(z >> 31);
+			wu = w[u] - ((uint32_t)z & 0x7FFFFFFF);
+			cc += wu >> 31;
+			w[u] = wu & 0x7FFFFFFF;
+		}
+		wu = w[ny] - cc;
+		w[ny] = wu & 0x7FFFFFFF;
+		neg = wu >> 31;
+
+		/*
+		 * Add back y while the value is negative. The addition
+		 * yields a carry out of the top word exactly when the
+		 * value becomes nonnegative.
+		 */
+		for (k = 0; k < 2; k ++) {
+			uint32_t m;
+
+			m = -neg >> 1;
+			cc = 0;
+			for (u = 0; u < ny; u ++) {
+				wu = w[u] + (y[u] & m) + cc;
+				w[u] = wu & 0x7FFFFFFF;
+				cc = wu >> 31;
+			}
+			wu = w[ny] + cc;
+			w[ny] = wu & 0x7FFFFFFF;
+			qw -= neg;
+			neg &= (wu >> 31) ^ 1;
+		}
+
+		if (q != NULL) {
+			q[j] = qw;
+		}
+	}
+
+	/*
+	 * The remainder, shifted by s bits, is in the low ny words of t.
+	 */
+	words_rsh_prot(t, ny, s, nb);
+	memcpy(x, t, ny * sizeof *x);
+	memset(x + ny, 0, (nx - ny) * sizeof *x);
+}
+
 /*
  * Internal division routine:
  *
@@ -1864,24 +3123,21 @@ cttk_i31_rsh_prot(uint32_t *d, const uint32_t *a, uint32_t n)
  *   - q, r, t1 and t2 are distinct from each other. Only q may be NULL.
  *   - t1 and t2 are distinct from a and b.
  *   - All non-NULL arrays have the same size.
+ *   - tw has room for twice the number of value words in a.
  *
  * Note that q and r may be aliases on a or b.
  */
 static void
 gendiv_inner(uint32_t *q, uint32_t *r, const uint32_t *a,
-	const uint32_t *b, uint32_t *t1, uint32_t *t2, int mod)
+	const uint32_t *b, uint32_t *t1, uint32_t *t2, uint32_t *tw, int mod)
 {
-	uint32_t h, n, hk, sa, sb;
-	size_t ud, len, u;
-	unsigned um;
+	uint32_t h, hk, sa, sb;
+	size_t len, u;
 	cttk_bool a_isnan, a_isminv, b_isnan, b_isminv, b_iszero, b_ismone;
-	cttk_bool both_nan, half_nan;
+	cttk_bool both_nan, half_nan, b_bad;
 
 	h = b[0] & 0x7FFFFFFF;
 	hk = top_index(h);
-	n = h - (h >> 5);
-	ud = h >> 5;
-	um = h & 31;
 	len = (h + 31) >> 5;
 
 	/*
@@ -1971,37 +3227,21 @@ gendiv_inner(uint32_t *q, uint32_t *r, const uint32_t *a,
 	b = t2;
 
 	/*
-	 * Set q to 0 (if defined).
+	 * Compute the division on the positive values. The word-wise
+	 * division destroys its divisor, so we give it a copy in t1.
+	 * That copy must not be zero; if b is zero or MinValue, we use
+	 * 2^(31*len)-1 instead, which is greater than |a| (the results
+	 * are fixed afterwards in both cases).
 	 */
+	b_bad = cttk_or(b_iszero, b_isminv);
+	for (u = 0; u < len; u ++) {
+		t1[1 + u] = cttk_u32_mux(b_bad, 0x7FFFFFFF, b[1 + u]);
+	}
 	if (q != NULL) {
 		q[0] &= 0x7FFFFFFF;
-		memset(q + 1, 0, ((h + 31) >> 5) * sizeof *q);
-	}
-
-	/*
-	 * Compute the division on the positive values.
-	 */
-	while (n -- > 0) {
-		cttk_bool e;
-
-		/*
-		 * The shift on b may yield a NaN, but in that case, the
-		 * comparison will be false, and the cond_copy will put
-		 * back the non-NaN value of r.
-		 */
-		cttk_i31_lsh(t1, b, n);
-		e = cttk_i31_leq(t1, r);
-		cttk_i31_sub(t1, r, t1);
-		cttk_i31_cond_copy(e, r, t1);
-		if (q != NULL) {
-			if (um == 0) {
-				um = 30;
-				ud --;
-			} else {
-				um --;
-			}
-			q[1 + ud] |= e.v << um;
-		}
+		divmod_words(q + 1, r + 1, len, t1 + 1, len, tw);
+	} else {
+		divmod_words(NULL, r + 1, len, t1 + 1, len, tw);
 	}
 
 	/*
@@ -2042,10 +3282,9 @@ gendiv_inner(uint32_t *q, uint32_t *r, const uint32_t *a,
 
 	/*
 	 * Handle the special cases for b == MinValue. In that case,
-	 * when we computed |b|, we got a NaN, and all checks in the
-	 * loop were false. Thus, if a != MinValue, r contains a copy
-	 * of a at this point (which is correct) and we just have to
-	 * set the quotient to 0.
+	 * the division used a divisor greater than |a|. Thus, if
+	 * a != MinValue, r contains a copy of a at this point (which
+	 * is correct) and we just have to set the quotient to 0.
 	 */
 	cttk_i31_set_u32_trunc(t1, 0);
 	if (q != NULL) {
@@ -2104,31 +3343,38 @@ gendiv_inner(uint32_t *q, uint32_t *r, const uint32_t *a,
 	}
 }
 
+/*
+ * Run the division with the provided temporary space; t must have room
+ * for 5*wlen words if r is NULL, 4*wlen words otherwise, where wlen is
+ * the total length (in words, header included) of each operand.
+ */
 static void
-gendiv_stack3(uint32_t *q, const uint32_t *a, const uint32_t *b, int mod)
+gendiv_buf(uint32_t *q, uint32_t *r,
+	const uint32_t *a, const uint32_t *b, uint32_t *t, int mod)
 {
-	uint32_t tr[CTTK_MAX_INT_BUF / (3 * sizeof(uint32_t))];
-	uint32_t t1[CTTK_MAX_INT_BUF / (3 * sizeof(uint32_t))];
-	uint32_t t2[CTTK_MAX_INT_BUF / (3 * sizeof(uint32_t))];
+	uint32_t h, *t1, *t2;
+	size_t wlen;
 
-	memset(tr, 0, sizeof tr);
-	memset(t1, 0, sizeof t1);
-	memset(t2, 0, sizeof t2);
-	tr[0] = t1[0] = t2[0] = a[0];
-	gendiv_inner(q, tr, a, b, t1, t2, mod);
+	h = a[0] & 0x7FFFFFFF;
+	wlen = (h + 63) >> 5;
+	if (r == NULL) {
+		r = t;
+		r[0] = h;
+		t += wlen;
+	}
+	t1 = t;
+	t2 = t + wlen;
+	t1[0] = t2[0] = h;
+	gendiv_inner(q, r, a, b, t1, t2, t2 + wlen, mod);
 }
 
 static void
-gendiv_stack2(uint32_t *q, uint32_t *r,
+gendiv_stack(uint32_t *q, uint32_t *r,
 	const uint32_t *a, const uint32_t *b, int mod)
 {
-	uint32_t t1[CTTK_MAX_INT_BUF / (3 * sizeof(uint32_t))];
-	uint32_t t2[CTTK_MAX_INT_BUF / (3 * sizeof(uint32_t))];
+	uint32_t t[CTTK_MAX_INT_BUF / sizeof(uint32_t)];
 
-	memset(t1, 0, sizeof t1);
-	memset(t2, 0, sizeof t2);
-	t1[0] = t2[0] = a[0];
-	gendiv_inner(q, r, a, b, t1, t2, mod);
+	gendiv_buf(q, r, a, b, t, mod);
 }
 
 /*
@@ -2143,7 +3389,7 @@ static void
 gendiv(uint32_t *q, uint32_t *r, const uint32_t *a, const uint32_t *b, int mod)
 {
 	uint32_t h;
-	size_t wlen;
+	size_t tlen;
 
 	/*
 	 * The inner function requires the following:
@@ -2151,72 +3397,35 @@ gendiv(uint32_t *q, uint32_t *r, const uint32_t *a, const uint32_t *b, int mod)
 	 *  - A nonnegative divisor, which must be a temporary since b
 	 *    might be NULL.
 	 *  - An extra temporary.
+	 *  - Scratch space for the word-wise division, which uses twice
+	 *    the operand length.
 	 *
-	 * We thus need either two (if r != NULL) or three (if r == NULL)
-	 * temporaries.
+	 * All of these are carved out of a single buffer, on the stack
+	 * if possible, or allocated on the heap otherwise.
 	 */
 	h = a[0] & 0x7FFFFFFF;
-	wlen = (h + 63) >> 5;
-	if (r == NULL) {
-		if (wlen <= (CTTK_MAX_INT_BUF / (3 * sizeof(uint32_t)))) {
-			gendiv_stack3(q, a, b, mod);
-			return;
-		}
+	tlen = ((h + 63) >> 5) * (r == NULL ? 5 : 4);
+	if (tlen <= (CTTK_MAX_INT_BUF / sizeof(uint32_t))) {
+		gendiv_stack(q, r, a, b, mod);
+		return;
+	}
 #if !CTTK_NO_MALLOC
-		{
-			uint32_t *tr, *t1, *t2;
-
-			tr = malloc(wlen * sizeof(uint32_t));
-			t1 = malloc(wlen * sizeof(uint32_t));
-			t2 = malloc(wlen * sizeof(uint32_t));
-			if (tr != NULL && t1 != NULL && t2 != NULL) {
-				gendiv_inner(q, tr, a, b, t1, t2, mod);
-				free(tr);
-				free(t1);
-				free(t2);
-				return;
-			}
-			if (tr != NULL) {
-				free(tr);
-			}
-			if (t1 != NULL) {
-				free(t1);
-			}
-			if (t2 != NULL) {
-				free(t2);
-			}
-		}
-#endif
-	} else {
-		if (wlen <= (CTTK_MAX_INT_BUF / (2 * sizeof(uint32_t)))) {
-			gendiv_stack2(q, r, a, b, mod);
+	{
+		uint32_t *t;
+
+		t = cttk_scratch_alloc(tlen * sizeof(uint32_t));
+		if (t != NULL) {
+			gendiv_buf(q, r, a, b, t, mod);
+			free(t);
 			return;
 		}
-#if !CTTK_NO_MALLOC
-		{
-			uint32_t *t1, *t2;
-
-			t1 = malloc(wlen * sizeof(uint32_t));
-			t2 = malloc(wlen * sizeof(uint32_t));
-			if (t1 != NULL && t2 != NULL) {
-				gendiv_inner(q, r, a, b, t1, t2, mod);
-				free(t1);
-				free(t2);
-				return;
-			}
-			if (t1 != NULL) {
-				free(t1);
-			}
-			if (t2 != NULL) {
-				free(t2);
-			}
-		}
-#endif
 	}
+#endif
 
 	/*
 	 * Could not find enough memory for temporaries...
 	 */
+	STATS_NAN_SCRATCH();
 	if (q != NULL) {
 		q[0] |= 0x80000000;
 	}
@@ -2225,14 +3434,20 @@ gendiv(uint32_t *q, uint32_t *r, const uint32_t *a, const uint32_t *b, int mod)
 	}
 }
 
-/* see cttk.h */
-void
-cttk_i31_divrem(uint32_t *q, uint32_t *r, const uint32_t *a, const uint32_t *b)
+/*
+ * Division with a caller-provided temporary of tlen words (sizes have
+ * been verified). If the temporary is too small, then the results are
+ * set to NaN.
+ */
+static void
+gendiv_ws(uint32_t *q, uint32_t *r, const uint32_t *a, const uint32_t *b,
+	int mod, uint32_t *t, size_t tlen)
 {
 	uint32_t h;
 
 	h = a[0] & 0x7FFFFFFF;
-	if (h != (b[0] & 0x7FFFFFFF)) {
+	if (tlen < ((h + 63) >> 5) * (r == NULL ? 5 : 4)) {
+		STATS_NAN_SCRATCH();
 		if (q != NULL) {
 			q[0] |= 0x80000000;
 		}
@@ -2241,24 +3456,75 @@ cttk_i31_divrem(uint32_t *q, uint32_t *r, const uint32_t *a, const uint32_t *b)
 		}
 		return;
 	}
+	gendiv_buf(q, r, a, b, t, mod);
+}
+
+/*
+ * Verify operands for cttk_i31_divrem(). Mismatched recipients are set
+ * to NaN and replaced with NULL. Returned value is 1 if the division
+ * must be performed, 0 otherwise.
+ */
+static int
+divrem_check(uint32_t **qq, uint32_t **rr,
+	const uint32_t *a, const uint32_t *b)
+{
+	uint32_t h, *q, *r;
+
+	q = *qq;
+	r = *rr;
+	h = a[0] & 0x7FFFFFFF;
+	if (h != (b[0] & 0x7FFFFFFF)) {
+		STATS_NAN_SIZE();
+		if (q != NULL) {
+			q[0] |= 0x80000000;
+		}
+		if (r != NULL) {
+			r[0] |= 0x80000000;
+		}
+		return 0;
+	}
 	if (q != NULL && h != (q[0] & 0x7FFFFFFF)) {
+		STATS_NAN_SIZE();
 		q[0] |= 0x80000000;
 		q = NULL;
 	}
 	if (r != NULL && h != (r[0] & 0x7FFFFFFF)) {
+		STATS_NAN_SIZE();
 		r[0] |= 0x80000000;
 		r = NULL;
 	}
 	if (q == NULL && r == NULL) {
-		return;
+		return 0;
 	}
 	if (q == r) {
 		q[0] |= 0x80000000;
 		r[0] |= 0x80000000;
-		return;
+		return 0;
 	}
+	*qq = q;
+	*rr = r;
+	return 1;
+}
 
-	gendiv(q, r, a, b, 0);
+/* see cttk.h */
+void
+cttk_i31_divrem(uint32_t *q, uint32_t *r, const uint32_t *a, const uint32_t *b)
+{
+	STATS_I31(DIV);
+	if (divrem_check(&q, &r, a, b)) {
+		gendiv(q, r, a, b, 0);
+	}
+}
+
+/* see cttk.h */
+void
+cttk_i31_divrem_ws(uint32_t *q, uint32_t *r,
+	const uint32_t *a, const uint32_t *b, uint32_t *tmp, size_t tmp_len)
+{
+	STATS_I31(DIV);
+	if (divrem_check(&q, &r, a, b)) {
+		gendiv_ws(q, r, a, b, 0, tmp, tmp_len);
+	}
 }
 
 /* see cttk.h */
@@ -2267,14 +3533,46 @@ cttk_i31_mod(uint32_t *d, const uint32_t *a, const uint32_t *b)
 {
 	uint32_t h;
 
+	STATS_I31(DIV);
 	h = d[0] & 0x7FFFFFFF;
 	if (h != (a[0] & 0x7FFFFFFF) || h != (b[0] & 0x7FFFFFFF)) {
+		STATS_NAN_SIZE();
 		d[0] |= 0x80000000;
 		return;
 	}
 	gendiv(NULL, d, a, b, 1);
 }
 
+/* see cttk.h */
+void
+cttk_i31_mod_ws(uint32_t *d, const uint32_t *a, const uint32_t *b,
+	uint32_t *tmp, size_t tmp_len)
+{
+	uint32_t h;
+
+	STATS_I31(DIV);
+	h = d[0] & 0x7FFFFFFF;
+	if (h != (a[0] & 0x7FFFFFFF) || h != (b[0] & 0x7FFFFFFF)) {
+		STATS_NAN_SIZE();
+		d[0] |= 0x80000000;
+		return;
+	}
+	gendiv_ws(NULL, d, a, b, 1, tmp, tmp_len);
+}
+
+/* see cttk.h */
+size_t
+cttk_i31_ws_len(unsigned size)
+{
+	uint32_t h;
+	size_t mlen, dlen;
+
+	h = (uint32_t)size + ((uint32_t)size / 31);
+	mlen = genmul_tmp_len(h);
+	dlen = ((h + 63) >> 5) * 5;
+	return mlen > dlen ? mlen : dlen;
+}
+
 /* see cttk.h */
 void
 cttk_i31_and(uint32_t *d, const uint32_t *a, const uint32_t *b)
@@ -2282,8 +3580,10 @@ cttk_i31_and(uint32_t *d, const uint32_t *a, const uint32_t *b)
 	uint32_t h;
 	size_t len, u;
 
+	STATS_I31(BOOL);
 	h = d[0] & 0x7FFFFFFF;
 	if (h != (a[0] & 0x7FFFFFFF) || h != (b[0] & 0x7FFFFFFF)) {
+		STATS_NAN_SIZE();
 		d[0] |= 0x80000000;
 		return;
 	}
@@ -2301,8 +3601,10 @@ cttk_i31_or(uint32_t *d, const uint32_t *a, const uint32_t *b)
 	uint32_t h;
 	size_t len, u;
 
+	STATS_I31(BOOL);
 	h = d[0] & 0x7FFFFFFF;
 	if (h != (a[0] & 0x7FFFFFFF) || h != (b[0] & 0x7FFFFFFF)) {
+		STATS_NAN_SIZE();
 		d[0] |= 0x80000000;
 		return;
 	}
@@ -2320,8 +3622,10 @@ cttk_i31_xor(uint32_t *d, const uint32_t *a, const uint32_t *b)
 	uint32_t h;
 	size_t len, u;
 
+	STATS_I31(BOOL);
 	h = d[0] & 0x7FFFFFFF;
 	if (h != (a[0] & 0x7FFFFFFF) || h != (b[0] & 0x7FFFFFFF)) {
+		STATS_NAN_SIZE();
 		d[0] |= 0x80000000;
 		return;
 	}
@@ -2339,8 +3643,10 @@ cttk_i31_eqv(uint32_t *d, const uint32_t *a, const uint32_t *b)
 	uint32_t h;
 	size_t len, u;
 
+	STATS_I31(BOOL);
 	h = d[0] & 0x7FFFFFFF;
 	if (h != (a[0] & 0x7FFFFFFF) || h != (b[0] & 0x7FFFFFFF)) {
+		STATS_NAN_SIZE();
 		d[0] |= 0x80000000;
 		return;
 	}
@@ -2358,8 +3664,10 @@ cttk_i31_not(uint32_t *d, const uint32_t *a)
 	uint32_t h;
 	size_t len, u;
 
+	STATS_I31(BOOL);
 	h = d[0] & 0x7FFFFFFF;
 	if (h != (a[0] & 0x7FFFFFFF)) {
+		STATS_NAN_SIZE();
 		d[0] |= 0x80000000;
 		return;
 	}
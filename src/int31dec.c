@@ -0,0 +1,566 @@
+/*
+ * Copyright (c) 2018 Thomas Pornin <pornin@bolet.org>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "inner.h"
+
+/*
+ * Decimal conversions for i31 integers.
+ *
+ * Decimal digits are grouped into chunks of 9 digits; the value of a
+ * chunk is lower than 10^9 and fits in a 32-bit word. A value with n
+ * chunks is split with the power B_j = 10^(9*2^j), using the largest j
+ * such that 2^j < n: the high part has n-2^j chunks, and the low part
+ * has 2^j chunks. Encoding divides by B_j; decoding computes
+ * high*B_j + low. Both parts are then processed recursively.
+ *
+ * Operations that use B_j are said to be at "level j": their operands
+ * are i31 integers of level_size(j) bits, which is enough for all
+ * nonnegative values lower than B_j^2. Encoding uses a divisor context
+ * for each B_j (see div31.c), and decoding uses cttk_i31_mul().
+ *
+ * Decoding has the cost of the underlying multiplications (Karatsuba
+ * for large operands). Encoding is quadratic: the divisor contexts are
+ * rebuilt on each call, and both cttk_d31_init() (a generic division)
+ * and the Barrett products in cttk_d31_divrem() use schoolbook
+ * algorithms; the recursion only replaces one division per chunk with
+ * a few large operations per level.
+ *
+ * The split points depend only on the number of chunks, hence on
+ * sizes, and each level uses its own temporaries: all operations on a
+ * given level in the recursion are at lower levels.
+ */
+
+#define MAX_LEVELS   32
+
+/*
+ * Maximum number of decimal digits for the absolute value of an integer
+ * of the provided size (in bits). This is floor((size-1)*log10(2))+1,
+ * with a slightly overestimated value of log10(2) (1292913987/2^32), so
+ * that the result may occasionally be one more than necessary.
+ */
+static size_t
+dec_digits(uint32_t size)
+{
+	return (size_t)(((uint64_t)(size - 1) * 1292913987) >> 32) + 1;
+}
+
+/*
+ * Get the split level for n chunks (n >= 2): this is the largest j such
+ * that 2^j < n.
+ */
+static int
+split_level(size_t n)
+{
+	int j;
+
+	for (j = 0; ((size_t)2 << j) < n; j ++);
+	return j;
+}
+
+/*
+ * Get the number of levels for n chunks (n >= 1). Level 0 is always
+ * present, since its integers are used for single-chunk values.
+ */
+static int
+num_levels(size_t n)
+{
+	return n < 2 ? 1 : split_level(n) + 1;
+}
+
+/*
+ * Size (in bits) of integers at level j. Since 3402/1024 is slightly
+ * greater than log2(10), this accommodates all nonnegative values up
+ * to 10^(18*2^j), plus the sign bit.
+ */
+static unsigned
+level_size(int j)
+{
+	return (unsigned)((((uint64_t)18 << j) * 3402) >> 10) + 2;
+}
+
+/*
+ * Number of 32-bit words for an integer at level j (as with
+ * cttk_i31_def()).
+ */
+static size_t
+level_words(int j)
+{
+	return ((size_t)level_size(j) + 61) / 31;
+}
+
+/*
+ * Compute the powers B_j for levels 0 to num-1, in the array p[].
+ * Each p[j] must contain a level j integer (with its header set).
+ */
+static void
+make_powers(uint32_t **p, int num)
+{
+	int j;
+
+	for (j = 0; j < num; j ++) {
+		if (j == 0) {
+			cttk_i31_set_u32(p[0], 1000000000);
+		} else {
+			cttk_i31_set(p[j], p[j - 1]);
+			cttk_i31_mul(p[j], p[j], p[j]);
+		}
+	}
+}
+
+/* ==================================================================== */
+
+/*
+ * Encoding state: for each level j, a divisor context dc[j] for B_j,
+ * and integers v[j] (dividend), q[j] and r[j] (quotient and
+ * remainder). Chunk i is written at dig[9*i].
+ */
+typedef struct {
+	uint32_t *dc[MAX_LEVELS];
+	uint32_t *v[MAX_LEVELS];
+	uint32_t *q[MAX_LEVELS];
+	uint32_t *r[MAX_LEVELS];
+	unsigned char *dig;
+	uint32_t err;
+} enc_state;
+
+/*
+ * Write the 9 digits of chunk value w (lower than 10^9). The division
+ * by 10 uses a multiplication by 0xCCCCCCCD and a shift, which is
+ * exact for all 32-bit values.
+ */
+static void
+enc_chunk(unsigned char *dig, uint32_t w)
+{
+	int k;
+
+	for (k = 8; k >= 0; k --) {
+		uint32_t q;
+
+		q = (uint32_t)(mulu32w(w, 0xCCCCCCCD) >> 35);
+		dig[k] = (unsigned char)('0' + (w - 10 * q));
+		w = q;
+	}
+}
+
+/*
+ * Encode value x (nonnegative, lower than 10^(9*n)) as chunks i to
+ * i+n-1. For n >= 2, x must fit in a level split_level(n) integer;
+ * it may be v[split_level(n)] itself.
+ */
+static void
+enc_rec(enc_state *es, const uint32_t *x, size_t n, size_t i)
+{
+	int j;
+	size_t nl;
+	uint32_t *v, *q, *r;
+
+	if (n == 1) {
+		enc_chunk(es->dig + 9 * i, cttk_i31_to_u32_trunc(x));
+		return;
+	}
+	j = split_level(n);
+	nl = (size_t)1 << j;
+	v = es->v[j];
+	q = es->q[j];
+	r = es->r[j];
+	cttk_i31_set(v, x);
+	cttk_d31_divrem(q, r, v, es->dc[j]);
+	es->err |= (v[0] | q[0] | r[0]) >> 31;
+	enc_rec(es, q, n - nl, i);
+	enc_rec(es, r, nl, i + n - nl);
+}
+
+/*
+ * Temporary buffer length (in 32-bit words) for encoding nc chunks.
+ */
+static size_t
+enc_tmp_len(size_t nc)
+{
+	size_t tlen;
+	int j, num;
+
+	tlen = (9 * nc + 4) >> 2;
+	num = num_levels(nc);
+	for (j = 0; j < num; j ++) {
+		tlen += 7 * level_words(j);
+	}
+	return tlen;
+}
+
+/*
+ * Encode x with the temporary buffer t (of length enc_tmp_len(nc)
+ * words). Returned value is the number of characters that would be
+ * produced, or 0 on error.
+ */
+static size_t
+encdec_buf(char *dst, size_t dst_len, const uint32_t *x, unsigned flags,
+	uint32_t *t)
+{
+	enc_state es;
+	uint32_t h, neg, nan;
+	size_t nd, nc, pad, start, len, u;
+	int j, num;
+	uint32_t *vt, *zt;
+	unsigned char *buf;
+
+	h = x[0] & 0x7FFFFFFF;
+	nd = dec_digits(h - (h >> 5));
+	nc = (nd + 8) / 9;
+	num = num_levels(nc);
+
+	/*
+	 * Output characters are assembled in buf[]: one character for
+	 * the sign, then the chunk digits.
+	 */
+	buf = (unsigned char *)t;
+	t += (9 * nc + 4) >> 2;
+	es.dig = buf + 1;
+	es.err = 0;
+	for (j = 0; j < num; j ++) {
+		size_t w;
+		unsigned size;
+
+		w = level_words(j);
+		size = level_size(j);
+		es.dc[j] = t;
+		t += w << 2;
+		es.v[j] = t;
+		t += w;
+		es.q[j] = t;
+		t += w;
+		es.r[j] = t;
+		t += w;
+		cttk_i31_init(es.v[j], size);
+		cttk_i31_init(es.q[j], size);
+		cttk_i31_init(es.r[j], size);
+	}
+
+	/*
+	 * Divisor contexts (not needed for a single chunk). The powers
+	 * are computed in the r[] integers. This is redone on every call,
+	 * and is a large part of the (quadratic) encoding cost.
+	 */
+	if (nc >= 2) {
+		make_powers(es.r, num);
+		for (j = 0; j < num; j ++) {
+			cttk_d31_init(es.dc[j], es.r[j]);
+			es.err |= es.dc[j][0] >> 31;
+		}
+	}
+
+	/*
+	 * Get the absolute value of x, in the top level integers. A NaN
+	 * is encoded as zero.
+	 */
+	vt = es.v[num - 1];
+	zt = es.q[num - 1];
+	nan = x[0] >> 31;
+	cttk_i31_set(vt, x);
+	neg = cttk_i31_lt0(vt).v;
+	cttk_i31_neg(zt, vt);
+	cttk_i31_cond_copy(cttk_bool_of_u32(neg), vt, zt);
+	cttk_i31_set_u32(zt, 0);
+	cttk_i31_cond_copy(cttk_bool_of_u32(nan), vt, zt);
+	es.err |= vt[0] >> 31;
+
+	enc_rec(&es, vt, nc, 0);
+	if (es.err) {
+		return 0;
+	}
+
+	/*
+	 * The first 9*nc-nd digits are leading zeros, which are dropped;
+	 * the sign character is put just before the remaining digits.
+	 */
+	pad = 9 * nc - nd;
+	if (flags & CTTK_DEC_TRIM) {
+		start = pad + 1;
+		while (start < 9 * nc && buf[start] == '0') {
+			start ++;
+		}
+		if (neg) {
+			buf[-- start] = '-';
+		}
+	} else {
+		start = pad;
+		buf[start] = (unsigned char)('+' + (neg << 1));
+	}
+	len = 9 * nc + 1 - start;
+
+	if (dst == NULL) {
+		return len;
+	}
+	if (dst_len == 0) {
+		return 0;
+	}
+	if (len >= dst_len) {
+		len = dst_len - 1;
+	}
+	for (u = 0; u < len; u ++) {
+		dst[u] = (char)buf[start + u];
+	}
+	dst[len] = 0;
+	return len;
+}
+
+static size_t
+encdec_stack(char *dst, size_t dst_len, const uint32_t *x, unsigned flags)
+{
+	uint32_t t[CTTK_MAX_INT_BUF / sizeof(uint32_t)];
+
+	return encdec_buf(dst, dst_len, x, flags, t);
+}
+
+/* see cttk.h */
+size_t
+cttk_i31_encdec(char *dst, size_t dst_len, const uint32_t *x, unsigned flags)
+{
+	uint32_t h;
+	size_t nd, nc, tlen;
+
+	STATS_I31(TEXT);
+	h = x[0] & 0x7FFFFFFF;
+	nd = dec_digits(h - (h >> 5));
+	if (dst == NULL && !(flags & CTTK_DEC_TRIM)) {
+		return nd + 1;
+	}
+	nc = (nd + 8) / 9;
+	tlen = enc_tmp_len(nc);
+	if (tlen <= (CTTK_MAX_INT_BUF / sizeof(uint32_t))) {
+		return encdec_stack(dst, dst_len, x, flags);
+	}
+#if !CTTK_NO_MALLOC
+	{
+		uint32_t *t;
+
+		t = cttk_scratch_alloc(tlen * sizeof(uint32_t));
+		if (t != NULL) {
+			size_t r;
+
+			r = encdec_buf(dst, dst_len, x, flags, t);
+			free(t);
+			return r;
+		}
+	}
+#endif
+	if (dst != NULL && dst_len > 0) {
+		dst[0] = 0;
+	}
+	return 0;
+}
+
+/* ==================================================================== */
+
+/*
+ * Decoding state: for each level j, the power p[j] = B_j, and integers
+ * a[j] (high part, then result) and b[j] (low part). Chunk i consists
+ * of the source characters 9*i-pad to 9*i-pad+8; characters at negative
+ * indices are implicit leading zeros.
+ */
+typedef struct {
+	uint32_t *p[MAX_LEVELS];
+	uint32_t *a[MAX_LEVELS];
+	uint32_t *b[MAX_LEVELS];
+	const unsigned char *src;
+	size_t pad;
+	uint32_t ok;
+} dec_state;
+
+/*
+ * Get the value of chunk i. Invalid characters clear ds->ok.
+ */
+static uint32_t
+dec_chunk(dec_state *ds, size_t i)
+{
+	uint32_t w;
+	int k;
+
+	w = 0;
+	for (k = 0; k < 9; k ++) {
+		size_t pos;
+		uint32_t d, m;
+
+		pos = 9 * i + (size_t)k;
+		if (pos < ds->pad) {
+			continue;
+		}
+		d = (uint32_t)ds->src[pos - ds->pad] - '0';
+		m = -(((d - 10) & ~d) >> 31);
+		ds->ok &= m;
+		w = 10 * w + (d & m);
+	}
+	return w;
+}
+
+/*
+ * Set d to the value of chunks i to i+n-1. For n >= 2, d must be large
+ * enough for a level split_level(n) integer; it may be
+ * a[split_level(n)] itself.
+ */
+static void
+dec_rec(dec_state *ds, uint32_t *d, size_t n, size_t i)
+{
+	int j;
+	size_t nl;
+	uint32_t *a, *b;
+
+	if (n == 1) {
+		cttk_i31_set_u32(d, dec_chunk(ds, i));
+		return;
+	}
+	j = split_level(n);
+	nl = (size_t)1 << j;
+	a = ds->a[j];
+	b = ds->b[j];
+	dec_rec(ds, a, n - nl, i);
+	dec_rec(ds, b, nl, i + n - nl);
+	cttk_i31_mul(a, a, ds->p[j]);
+	cttk_i31_add(a, a, b);
+	cttk_i31_set(d, a);
+}
+
+/*
+ * Temporary buffer length (in 32-bit words) for decoding nc chunks.
+ */
+static size_t
+dec_tmp_len(size_t nc)
+{
+	size_t tlen;
+	int j, num;
+
+	tlen = 0;
+	num = num_levels(nc);
+	for (j = 0; j < num; j ++) {
+		tlen += 3 * level_words(j);
+	}
+	return tlen;
+}
+
+/*
+ * Decode nd digits, with the temporary buffer t (of length
+ * dec_tmp_len(nc) words).
+ */
+static void
+decdec_buf(uint32_t *x, const unsigned char *src, size_t nd, uint32_t neg,
+	uint32_t *t)
+{
+	dec_state ds;
+	size_t nc;
+	int j, num;
+	uint32_t *vt, *zt;
+
+	nc = (nd + 8) / 9;
+	num = num_levels(nc);
+	ds.src = src;
+	ds.pad = 9 * nc - nd;
+	ds.ok = 0xFFFFFFFF;
+	for (j = 0; j < num; j ++) {
+		size_t w;
+		unsigned size;
+
+		w = level_words(j);
+		size = level_size(j);
+		ds.p[j] = t;
+		t += w;
+		ds.a[j] = t;
+		t += w;
+		ds.b[j] = t;
+		t += w;
+		cttk_i31_init(ds.p[j], size);
+		cttk_i31_init(ds.a[j], size);
+		cttk_i31_init(ds.b[j], size);
+	}
+	if (nc >= 2) {
+		make_powers(ds.p, num);
+	}
+
+	vt = ds.a[num - 1];
+	zt = ds.b[num - 1];
+	dec_rec(&ds, vt, nc, 0);
+	cttk_i31_neg(zt, vt);
+	cttk_i31_cond_copy(cttk_bool_of_u32(neg), vt, zt);
+	cttk_i31_set(x, vt);
+	x[0] |= (ds.ok ^ 0xFFFFFFFF) & 0x80000000;
+}
+
+static void
+decdec_stack(uint32_t *x, const unsigned char *src, size_t nd, uint32_t neg)
+{
+	uint32_t t[CTTK_MAX_INT_BUF / sizeof(uint32_t)];
+
+	decdec_buf(x, src, nd, neg, t);
+}
+
+/* see cttk.h */
+void
+cttk_i31_decdec(uint32_t *x, const char *src, size_t len)
+{
+	const unsigned char *buf;
+	uint32_t neg, sgn;
+	size_t tlen;
+
+	STATS_I31(TEXT);
+	buf = (const unsigned char *)src;
+
+	/*
+	 * The first character is classified with masks, so that the
+	 * sign value does not leak (only its presence does, through
+	 * the number of digits).
+	 */
+	neg = 0;
+	sgn = 0;
+	if (len > 0) {
+		cttk_bool bp, bn;
+
+		bp = cttk_u32_eq(buf[0], '+');
+		bn = cttk_u32_eq(buf[0], '-');
+		neg = bn.v;
+		sgn = cttk_or(bp, bn).v;
+	}
+	buf += sgn;
+	len -= sgn;
+	if (len == 0) {
+		goto fail;
+	}
+	tlen = dec_tmp_len((len + 8) / 9);
+	if (tlen <= (CTTK_MAX_INT_BUF / sizeof(uint32_t))) {
+		decdec_stack(x, buf, len, neg);
+		return;
+	}
+#if !CTTK_NO_MALLOC
+	{
+		uint32_t *t;
+
+		t = cttk_scratch_alloc(tlen * sizeof(uint32_t));
+		if (t != NULL) {
+			decdec_buf(x, buf, len, neg, t);
+			free(t);
+			return;
+		}
+	}
+#endif
+
+fail:
+	x[0] |= 0x80000000;
+}
@@ -0,0 +1,266 @@
+/*
+ * Copyright (c) 2018 Thomas Pornin <pornin@bolet.org>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "inner.h"
+
+/*
+ * Fixed-size i31 functions. Each function of this file is specialised
+ * for one size (from the CTTK_I31_FIXED_SIZES list, see cttk.h): the
+ * header word, the number of words and the position of the sign bit
+ * are compile-time constants, so that all loops have a known number
+ * of iterations and can be unrolled by the compiler. Representation
+ * and semantics are those of int31.c.
+ */
+
+/*
+ * Header word and number of value words for a given size.
+ */
+#define FX_H(size)     ((uint32_t)(size) + (uint32_t)(size) / 31)
+#define FX_LEN(size)   (((size) + ((size) / 31) + 31) >> 5)
+
+/*
+ * Return 1 if all three headers match h (ignoring the NaN flags),
+ * 0 otherwise.
+ */
+static inline int
+fx_check(uint32_t h, const uint32_t *d, const uint32_t *a, const uint32_t *b)
+{
+	return (((d[0] ^ h) | (a[0] ^ h) | (b[0] ^ h)) & 0x7FFFFFFF) == 0;
+}
+
+/*
+ * Addition or subtraction (op combines OP_SUB and OP_TRUNC); overflow
+ * rules are those of cttk_i31_add() and cttk_i31_sub().
+ */
+#define OP_TRUNC   1
+#define OP_SUB     2
+
+static inline void
+fx_addsub(uint32_t *d, const uint32_t *a, const uint32_t *b,
+	uint32_t h, int op)
+{
+	size_t u, len;
+	unsigned ti;
+	uint32_t hd, cc, tt;
+
+	STATS_I31(ADD);
+	if (!fx_check(h, d, a, b)) {
+		STATS_NAN_SIZE();
+		d[0] |= 0x80000000;
+		return;
+	}
+	len = (h + 31) >> 5;
+	ti = top_index(h);
+	hd = a[0] | b[0];
+	tt = a[len] ^ b[len];
+	cc = 0;
+	for (u = 1; u <= len; u ++) {
+		uint32_t w;
+
+		if (op & OP_SUB) {
+			w = a[u] - b[u] - cc;
+		} else {
+			w = a[u] + b[u] + cc;
+		}
+		d[u] = w & 0x7FFFFFFF;
+		cc = w >> 31;
+	}
+	if (op & OP_TRUNC) {
+		d[len] = signext(d[len], ti + 1) & 0x7FFFFFFF;
+	} else {
+		hd |= (((tt ^ d[len]) >> ti) ^ cc) << 31;
+	}
+	d[0] = hd;
+}
+
+/*
+ * Multiplication (schoolbook, column by column). The product of the
+ * two's complement representations is computed over 2*len words, with
+ * the corrections for negative operands applied on the upper half (as
+ * in batch31.c), so that only len^2 word products are needed. The low
+ * half is assembled in t[] (len words), so that d may alias a or b.
+ */
+static inline void
+fx_mul(uint32_t *d, const uint32_t *a, const uint32_t *b,
+	uint32_t h, uint32_t *t, int trunc)
+{
+	size_t u, v, len;
+	unsigned ti;
+	uint32_t hd, ssa, ssb, ssd, or0, and1, wd;
+	uint64_t cc;
+
+	STATS_I31(MUL);
+	if (!fx_check(h, d, a, b)) {
+		STATS_NAN_SIZE();
+		d[0] |= 0x80000000;
+		return;
+	}
+	len = (h + 31) >> 5;
+	ti = top_index(h);
+	hd = a[0] | b[0];
+	ssa = -(a[len] >> 30) >> 1;
+	ssb = -(b[len] >> 30) >> 1;
+	or0 = 0;
+	and1 = 0x7FFFFFFF;
+	cc = 0;
+	wd = 0;
+	for (u = 0; u < (len << 1); u ++) {
+		size_t vlo, vhi;
+		uint64_t zd;
+
+		zd = cc;
+		cc = 0;
+		vlo = u < len ? 0 : u + 1 - len;
+		vhi = u < len ? u : len - 1;
+		for (v = vlo; v <= vhi; v ++) {
+			uint64_t zr;
+
+			zr = mulu32w(a[v + 1], b[u - v + 1]);
+			zd += zr & 0x7FFFFFFF;
+			cc += zr >> 31;
+		}
+		if (u >= len) {
+			zd += ~(b[u - len + 1] & ssa) & 0x7FFFFFFF;
+			zd += ~(a[u - len + 1] & ssb) & 0x7FFFFFFF;
+			zd += (u == len) << 1;
+		}
+		cc += zd >> 31;
+		wd = (uint32_t)zd & 0x7FFFFFFF;
+		if (u < len) {
+			t[u] = wd;
+		} else {
+			or0 |= wd;
+			and1 &= wd;
+		}
+	}
+	memcpy(d + 1, t, len * sizeof *t);
+	if (trunc) {
+		d[len] = signext(d[len], ti + 1) & 0x7FFFFFFF;
+	} else {
+		cttk_bool ok;
+
+		/*
+		 * The value fits if all upper bits (from the sign bit of
+		 * the low half) are copies of the product sign.
+		 */
+		ssd = -(wd >> 30) >> 1;
+		ok = cttk_and(
+			cttk_bool_of_u32(cttk_u32_mux(
+				cttk_bool_of_u32(ssd & 1),
+				cttk_u32_eq0(and1 ^ 0x7FFFFFFF).v,
+				cttk_u32_eq0(or0).v)),
+			cttk_u32_eq0((d[len] ^ ssd) >> ti));
+		hd |= (ok.v ^ 1) << 31;
+	}
+	d[0] = hd;
+}
+
+/*
+ * Comparison (see cttk_i31_cmp()).
+ */
+static inline int32_t
+fx_cmp(const uint32_t *x, const uint32_t *y, uint32_t h)
+{
+	size_t u, len;
+	uint32_t cc, t, w;
+
+	STATS_I31(CMP);
+	if ((((x[0] ^ h) | (y[0] ^ h)) & 0x7FFFFFFF) != 0) {
+		return 0;
+	}
+	len = (h + 31) >> 5;
+	cc = 0;
+	t = 0;
+	for (u = 1; u <= len; u ++) {
+		uint32_t wz;
+
+		wz = x[u] - y[u] - cc;
+		cc = wz >> 31;
+		t |= wz;
+	}
+	cc ^= (x[len] ^ y[len]) >> 30;
+	w = (cttk_u32_neq0(t).v | -cc) & (((x[0] | y[0]) >> 31) - 1);
+	return *(int32_t *)&w;
+}
+
+/*
+ * For sizes that reach the Karatsuba threshold, the generic functions
+ * are faster than the quadratic fixed-size code; the test is resolved
+ * at compile time.
+ */
+#define FX_MUL(size, trunc, gen)   do { \
+		if (FX_LEN(size) < CTTK_KARATSUBA_THRESHOLD) { \
+			uint32_t t[FX_LEN(size)]; \
+			fx_mul(d, a, b, FX_H(size), t, trunc); \
+		} else if (fx_check(FX_H(size), d, a, b)) { \
+			gen(d, a, b); \
+		} else { \
+			STATS_I31(MUL); \
+			STATS_NAN_SIZE(); \
+			d[0] |= 0x80000000; \
+		} \
+	} while (0)
+
+#define FX_IMPL(size) \
+void \
+cttk_i31_add_ ## size(uint32_t *d, const uint32_t *a, const uint32_t *b) \
+{ \
+	fx_addsub(d, a, b, FX_H(size), 0); \
+} \
+void \
+cttk_i31_add_trunc_ ## size(uint32_t *d, \
+	const uint32_t *a, const uint32_t *b) \
+{ \
+	fx_addsub(d, a, b, FX_H(size), OP_TRUNC); \
+} \
+void \
+cttk_i31_sub_ ## size(uint32_t *d, const uint32_t *a, const uint32_t *b) \
+{ \
+	fx_addsub(d, a, b, FX_H(size), OP_SUB); \
+} \
+void \
+cttk_i31_sub_trunc_ ## size(uint32_t *d, \
+	const uint32_t *a, const uint32_t *b) \
+{ \
+	fx_addsub(d, a, b, FX_H(size), OP_SUB | OP_TRUNC); \
+} \
+void \
+cttk_i31_mul_ ## size(uint32_t *d, const uint32_t *a, const uint32_t *b) \
+{ \
+	FX_MUL(size, 0, cttk_i31_mul); \
+} \
+void \
+cttk_i31_mul_trunc_ ## size(uint32_t *d, \
+	const uint32_t *a, const uint32_t *b) \
+{ \
+	FX_MUL(size, 1, cttk_i31_mul_trunc); \
+} \
+int32_t \
+cttk_i31_cmp_ ## size(const uint32_t *x, const uint32_t *y) \
+{ \
+	return fx_cmp(x, y, FX_H(size)); \
+}
+
+/* see cttk.h */
+CTTK_I31_FIXED_SIZES(FX_IMPL)
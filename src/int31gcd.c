@@ -0,0 +1,703 @@
+/*
+ * Copyright (c) 2018 Thomas Pornin <pornin@bolet.org>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "inner.h"
+
+/*
+ * GCD and modular inversion for i31 integers, with the "safegcd"
+ * algorithm of Bernstein and Yang ("Fast constant-time gcd computation
+ * and modular inversion", 2019).
+ *
+ * The algorithm applies "divsteps" to a state (delta, f, g), with f
+ * odd:
+ *
+ *   if delta > 0 and g is odd:   (1 - delta, g, (g - f) / 2)
+ *   otherwise:                   (1 + delta, f, (g + (g mod 2) f) / 2)
+ *
+ * Starting with delta = 1, f^2 + 4*g^2 <= 5*2^(2*d), g reaches 0 after
+ * at most (49*d+80)/17 (for d < 46) or (49*d+57)/17 (for d >= 46)
+ * divsteps; at that point, f = +/-gcd(f, g). Further divsteps leave f
+ * and g unchanged, so a number of iterations which depends only on
+ * the integer size can be used.
+ *
+ * Divsteps are grouped in batches of 30: each batch works on the low
+ * 32 bits of f and g only, and produces a transition matrix (u, v, q, r)
+ * such that the new values of f and g are (u*f + v*g)/2^30 and
+ * (q*f + r*g)/2^30; the matrix coefficients are lower than or equal to
+ * 2^30 in absolute value, and also |u|+|v| <= 2^30 and |q|+|r| <= 2^30.
+ * The matrix is then applied to the full values. For inversion modulo
+ * m, the same matrix is applied to two extra values d and e, modulo m,
+ * which maintain the invariants f = d*a mod m and g = e*a mod m.
+ *
+ * For the matrix application, values are converted to signed integers
+ * in base 2^30 ("s30" format): n words, the n-1 first ones in the
+ * 0..2^30-1 range, and the last one a signed 32-bit value (in two's
+ * complement). With n = size/30 + 2, all intermediate values fit.
+ */
+
+#define M30   ((uint32_t)0x3FFFFFFF)
+
+static inline int32_t
+s32(uint32_t x)
+{
+	return *(int32_t *)&x;
+}
+
+/*
+ * Arithmetic right shift of a signed 64-bit value by 30 bits.
+ */
+static inline uint64_t
+sar30(uint64_t x)
+{
+	return (x >> 30) | (-(x >> 63) << 34);
+}
+
+/*
+ * Number of s30 words for an i31 header.
+ */
+static inline size_t
+s30_len(uint32_t h)
+{
+	return (size_t)(h - (h >> 5)) / 30 + 2;
+}
+
+/*
+ * Convert the value of i31 integer a into s30 format (n words).
+ */
+static void
+to_s30(uint32_t *d, size_t n, const uint32_t *a)
+{
+	uint32_t h, sw;
+	uint64_t acc;
+	size_t u, j, len;
+	unsigned acc_len;
+
+	h = a[0] & 0x7FFFFFFF;
+	len = (h + 31) >> 5;
+	sw = -(a[len] >> 30) >> 1;
+	acc = 0;
+	acc_len = 0;
+	j = 1;
+	for (u = 0; u < n; u ++) {
+		if (acc_len < 30) {
+			acc |= (uint64_t)(j <= len ? a[j] : sw) << acc_len;
+			acc_len += 31;
+			j ++;
+		}
+		d[u] = (uint32_t)acc & M30;
+		acc >>= 30;
+		acc_len -= 30;
+	}
+	d[n - 1] |= -(d[n - 1] >> 29) << 30;
+}
+
+/*
+ * Write a nonnegative s30 value (n words) into i31 integer d (the
+ * header of d is not modified). Returned value is 1 if the value does
+ * not fit in d (as a nonnegative integer), 0 otherwise.
+ */
+static uint32_t
+from_s30(uint32_t *d, const uint32_t *s, size_t n)
+{
+	uint32_t h, over;
+	uint64_t acc;
+	size_t u, k, len;
+	unsigned acc_len;
+
+	h = d[0] & 0x7FFFFFFF;
+	len = (h + 31) >> 5;
+	acc = 0;
+	acc_len = 0;
+	k = 0;
+	for (u = 1; u <= len; u ++) {
+		while (acc_len < 31 && k < n) {
+			acc |= (uint64_t)(s[k] & M30) << acc_len;
+			acc_len += 30;
+			k ++;
+		}
+		d[u] = (uint32_t)acc & 0x7FFFFFFF;
+		acc >>= 31;
+		acc_len = acc_len < 31 ? 0 : acc_len - 31;
+	}
+	over = (d[len] >> top_index(h)) | (uint32_t)acc | (s[n - 1] & ~M30);
+	for (; k < n; k ++) {
+		over |= s[k];
+	}
+	return (over | -over) >> 31;
+}
+
+/*
+ * Conditionally negate s30 value d (n words): negation happens if
+ * ctl = 0xFFFFFFFF; value is unchanged if ctl = 0.
+ */
+static void
+s30_cond_neg(uint32_t *d, size_t n, uint32_t ctl)
+{
+	uint32_t cc;
+	size_t u;
+
+	cc = ctl & 1;
+	for (u = 0; u < n - 1; u ++) {
+		uint32_t w;
+
+		w = (d[u] ^ (ctl & M30)) + cc;
+		d[u] = w & M30;
+		cc = w >> 30;
+	}
+	d[n - 1] = (d[n - 1] ^ ctl) + cc;
+}
+
+/*
+ * Conditionally add m to d (if ctl = 0xFFFFFFFF) or do nothing (if
+ * ctl = 0).
+ */
+static void
+s30_cond_add(uint32_t *d, const uint32_t *m, size_t n, uint32_t ctl)
+{
+	uint32_t cc;
+	size_t u;
+
+	cc = 0;
+	for (u = 0; u < n - 1; u ++) {
+		uint32_t w;
+
+		w = d[u] + (m[u] & ctl) + cc;
+		d[u] = w & M30;
+		cc = w >> 30;
+	}
+	d[n - 1] += (m[n - 1] & ctl) + cc;
+}
+
+/*
+ * Conditionally subtract m from d (if ctl = 0xFFFFFFFF) or do nothing
+ * (if ctl = 0).
+ */
+static void
+s30_cond_sub(uint32_t *d, const uint32_t *m, size_t n, uint32_t ctl)
+{
+	uint32_t cc;
+	size_t u;
+
+	cc = 0;
+	for (u = 0; u < n - 1; u ++) {
+		uint32_t w;
+
+		w = d[u] - (m[u] & ctl) - cc;
+		d[u] = w & M30;
+		cc = w >> 31;
+	}
+	d[n - 1] -= (m[n - 1] & ctl) + cc;
+}
+
+/*
+ * Get the sign of d - m (0xFFFFFFFF if d < m, 0 otherwise).
+ */
+static uint32_t
+s30_lt(const uint32_t *d, const uint32_t *m, size_t n)
+{
+	uint32_t cc;
+	size_t u;
+
+	cc = 0;
+	for (u = 0; u < n - 1; u ++) {
+		cc = (d[u] - m[u] - cc) >> 31;
+	}
+	return -((d[n - 1] - m[n - 1] - cc) >> 31);
+}
+
+/*
+ * Number of trailing zeros of the bitwise OR of nonnegative s30 values
+ * a and b. If both values are zero, then 0 is returned.
+ */
+static uint32_t
+s30_tzcnt2(const uint32_t *a, const uint32_t *b, size_t n)
+{
+	uint32_t r;
+	size_t u;
+
+	r = 0;
+	for (u = n; u -- > 0;) {
+		uint32_t w, m, c, nz;
+		int i;
+
+		w = a[u] | b[u];
+		m = (uint32_t)-1;
+		c = 0;
+		for (i = 0; i < 30; i ++) {
+			m &= ((w >> i) & 1) - 1;
+			c += m & 1;
+		}
+		nz = -((w | -w) >> 31);
+		r ^= nz & (r ^ ((uint32_t)(30 * u) + c));
+	}
+	return r;
+}
+
+/*
+ * Right-shift nonnegative s30 value d by k bits (k < 30*n). The shift
+ * count is protected: the memory access pattern does not depend on it.
+ */
+static void
+s30_rsh_prot(uint32_t *d, size_t n, uint32_t k)
+{
+	size_t s;
+	int i;
+
+	for (i = 0, s = 1; s < 30 * n; i ++, s <<= 1) {
+		uint32_t ctl;
+		size_t u, nd;
+		unsigned nm;
+
+		ctl = -((k >> i) & 1);
+		nd = s / 30;
+		nm = (unsigned)(s % 30);
+		for (u = 0; u < n; u ++) {
+			uint32_t lo, hi, w;
+
+			lo = (u + nd) < n ? d[u + nd] : 0;
+			hi = (u + nd + 1) < n ? d[u + nd + 1] : 0;
+			w = ((lo >> nm) | (hi << (30 - nm))) & M30;
+			d[u] ^= ctl & (d[u] ^ w);
+		}
+	}
+}
+
+/*
+ * Left-shift nonnegative s30 value d by k bits (k < 30*n). The shift
+ * count is protected. The result is assumed to fit.
+ */
+static void
+s30_lsh_prot(uint32_t *d, size_t n, uint32_t k)
+{
+	size_t s;
+	int i;
+
+	for (i = 0, s = 1; s < 30 * n; i ++, s <<= 1) {
+		uint32_t ctl;
+		size_t u, nd;
+		unsigned nm;
+
+		ctl = -((k >> i) & 1);
+		nd = s / 30;
+		nm = (unsigned)(s % 30);
+		for (u = n; u -- > 0;) {
+			uint32_t lo, hi, w;
+
+			hi = u >= nd ? d[u - nd] : 0;
+			lo = u >= (nd + 1) ? d[u - nd - 1] : 0;
+			w = ((hi << nm) | (lo >> (30 - nm))) & M30;
+			d[u] ^= ctl & (d[u] ^ w);
+		}
+	}
+}
+
+/*
+ * Number of divsteps for values lower than 2^size (in absolute value),
+ * rounded up to a multiple of 30.
+ */
+static uint32_t
+num_divsteps(uint32_t size)
+{
+	uint64_t t;
+
+	if (size < 46) {
+		t = (49 * (uint64_t)size + 80) / 17;
+	} else {
+		t = (49 * (uint64_t)size + 57) / 17;
+	}
+	return (uint32_t)((t + 29) / 30) * 30;
+}
+
+/*
+ * Apply 30 divsteps on the low 32 bits of f and g (f is odd). The
+ * transition matrix is written in tm[] (u, v, q, r, as signed 32-bit
+ * values), and the new value of delta is returned.
+ */
+static uint32_t
+divsteps30(uint32_t delta, uint32_t f, uint32_t g, uint32_t *tm)
+{
+	uint32_t u, v, q, r;
+	int i;
+
+	u = 1;
+	v = 0;
+	q = 0;
+	r = 1;
+	for (i = 0; i < 30; i ++) {
+		uint32_t c1, c2, x;
+
+		/*
+		 * If delta > 0 and g is odd, then replace (delta, f, g)
+		 * with (-delta, g, -f) (and the matrix rows accordingly);
+		 * the common step below then yields the expected result.
+		 */
+		c1 = -((-delta) >> 31) & -(g & 1);
+		x = (f ^ g) & c1;
+		f ^= x;
+		g ^= x;
+		g = (g ^ c1) - c1;
+		x = (u ^ q) & c1;
+		u ^= x;
+		q ^= x;
+		q = (q ^ c1) - c1;
+		x = (v ^ r) & c1;
+		v ^= x;
+		r ^= x;
+		r = (r ^ c1) - c1;
+		delta = (delta ^ c1) - c1 + 1;
+
+		/*
+		 * g <- (g + (g mod 2) f) / 2. Since the matrix is scaled
+		 * by 2^i, the f row is doubled instead of halving g.
+		 */
+		c2 = -(g & 1);
+		g += f & c2;
+		q += u & c2;
+		r += v & c2;
+		g >>= 1;
+		u <<= 1;
+		v <<= 1;
+	}
+	tm[0] = u;
+	tm[1] = v;
+	tm[2] = q;
+	tm[3] = r;
+	return delta;
+}
+
+/*
+ * Replace f and g with (u*f + v*g)/2^30 and (q*f + r*g)/2^30 (the
+ * divisions are exact).
+ */
+static void
+update_fg(uint32_t *f, uint32_t *g, size_t n, const uint32_t *tm)
+{
+	int32_t u, v, q, r;
+	uint64_t cf, cg;
+	size_t i;
+
+	u = s32(tm[0]);
+	v = s32(tm[1]);
+	q = s32(tm[2]);
+	r = s32(tm[3]);
+	cf = (uint64_t)muls32w(u, s32(f[0])) + (uint64_t)muls32w(v, s32(g[0]));
+	cg = (uint64_t)muls32w(q, s32(f[0])) + (uint64_t)muls32w(r, s32(g[0]));
+	cf = sar30(cf);
+	cg = sar30(cg);
+	for (i = 1; i < n; i ++) {
+		int32_t fi, gi;
+
+		fi = s32(f[i]);
+		gi = s32(g[i]);
+		cf += (uint64_t)muls32w(u, fi) + (uint64_t)muls32w(v, gi);
+		cg += (uint64_t)muls32w(q, fi) + (uint64_t)muls32w(r, gi);
+		f[i - 1] = (uint32_t)cf & M30;
+		g[i - 1] = (uint32_t)cg & M30;
+		cf = sar30(cf);
+		cg = sar30(cg);
+	}
+	f[n - 1] = (uint32_t)cf;
+	g[n - 1] = (uint32_t)cg;
+}
+
+/*
+ * Replace d and e with (u*d + v*e)/2^30 and (q*d + r*e)/2^30 modulo m
+ * (m is odd and positive, m0i = -1/m mod 2^30). On input, d and e are
+ * in the 0..m range; on output, they are in the 0..m-1 range.
+ *
+ * Since |u|+|v| <= 2^30, |u*d + v*e| <= 2^30*m; adding the multiple of
+ * m which makes the value a multiple of 2^30 and dividing yields a
+ * value in the -m..2*m-1 range, which is then normalised with a
+ * conditional addition and a conditional subtraction.
+ */
+static void
+update_de(uint32_t *d, uint32_t *e, const uint32_t *m, size_t n,
+	const uint32_t *tm, uint32_t m0i)
+{
+	int32_t u, v, q, r;
+	uint32_t md, me;
+	uint64_t cd, ce;
+	size_t i;
+
+	u = s32(tm[0]);
+	v = s32(tm[1]);
+	q = s32(tm[2]);
+	r = s32(tm[3]);
+	cd = (uint64_t)muls32w(u, s32(d[0])) + (uint64_t)muls32w(v, s32(e[0]));
+	ce = (uint64_t)muls32w(q, s32(d[0])) + (uint64_t)muls32w(r, s32(e[0]));
+	md = mulu32((uint32_t)cd, m0i) & M30;
+	me = mulu32((uint32_t)ce, m0i) & M30;
+	cd = sar30(cd + mulu32w(md, m[0]));
+	ce = sar30(ce + mulu32w(me, m[0]));
+	for (i = 1; i < n; i ++) {
+		int32_t di, ei;
+
+		di = s32(d[i]);
+		ei = s32(e[i]);
+		cd += (uint64_t)muls32w(u, di) + (uint64_t)muls32w(v, ei)
+			+ mulu32w(md, m[i]);
+		ce += (uint64_t)muls32w(q, di) + (uint64_t)muls32w(r, ei)
+			+ mulu32w(me, m[i]);
+		d[i - 1] = (uint32_t)cd & M30;
+		e[i - 1] = (uint32_t)ce & M30;
+		cd = sar30(cd);
+		ce = sar30(ce);
+	}
+	d[n - 1] = (uint32_t)cd;
+	e[n - 1] = (uint32_t)ce;
+
+	s30_cond_add(d, m, n, -(d[n - 1] >> 31));
+	s30_cond_sub(d, m, n, ~s30_lt(d, m, n));
+	s30_cond_add(e, m, n, -(e[n - 1] >> 31));
+	s30_cond_sub(e, m, n, ~s30_lt(e, m, n));
+}
+
+/*
+ * Apply num divsteps (a multiple of 30) to (f, g); f must be odd. If
+ * m is not NULL, then the matrices are also applied to (d, e) modulo m.
+ */
+static void
+run_divsteps(uint32_t *f, uint32_t *g, uint32_t *d, uint32_t *e,
+	const uint32_t *m, size_t n, uint32_t num)
+{
+	uint32_t delta, m0i, tm[4];
+
+	m0i = 0;
+	if (m != NULL) {
+		/*
+		 * Each step doubles the number of correct low bits of
+		 * the inverse (3 bits are correct initially).
+		 */
+		m0i = m[0];
+		m0i = mulu32(m0i, 2 - mulu32(m[0], m0i));
+		m0i = mulu32(m0i, 2 - mulu32(m[0], m0i));
+		m0i = mulu32(m0i, 2 - mulu32(m[0], m0i));
+		m0i = mulu32(m0i, 2 - mulu32(m[0], m0i));
+		m0i = -m0i;
+	}
+	delta = 1;
+	for (; num > 0; num -= 30) {
+		delta = divsteps30(delta,
+			f[0] | (f[1] << 30), g[0] | (g[1] << 30), tm);
+		update_fg(f, g, n, tm);
+		if (m != NULL) {
+			update_de(d, e, m, n, tm, m0i);
+		}
+	}
+}
+
+/*
+ * Modular inversion with a temporary buffer of 5*n words. Sizes have
+ * been verified.
+ */
+static void
+modinv_buf(uint32_t *d, const uint32_t *a, const uint32_t *m,
+	uint32_t *t, size_t n)
+{
+	uint32_t h, nan, ok, valid;
+	uint32_t *f, *g, *xd, *xe, *xm;
+	size_t u;
+
+	h = d[0] & 0x7FFFFFFF;
+	nan = (a[0] | m[0]) >> 31;
+	f = t;
+	g = f + n;
+	xd = g + n;
+	xe = xd + n;
+	xm = xe + n;
+
+	/*
+	 * The modulus must be odd and positive. Otherwise, the
+	 * computation is performed with modulus 1, and the result is
+	 * set to NaN.
+	 */
+	to_s30(xm, n, m);
+	to_s30(g, n, a);
+	valid = xm[0] & ~(xm[n - 1] >> 31) & 1;
+	xm[0] = (xm[0] & -valid) | (valid ^ 1);
+	for (u = 1; u < n; u ++) {
+		xm[u] &= -valid;
+	}
+
+	/*
+	 * Invariants: f = xd*a mod m, g = xe*a mod m. The value of a
+	 * need not be reduced first.
+	 */
+	memcpy(f, xm, n * sizeof *f);
+	memset(xd, 0, n * sizeof *xd);
+	memset(xe, 0, n * sizeof *xe);
+	xe[0] = 1;
+	run_divsteps(f, g, xd, xe, xm, n, num_divsteps(h - (h >> 5)));
+
+	/*
+	 * Now f = +/-gcd(a, m) = +/-xd*a mod m. The inverse exists
+	 * only if f is 1 or -1.
+	 */
+	ok = -(f[n - 1] >> 31);
+	s30_cond_neg(f, n, ok);
+	s30_cond_neg(xd, n, ok);
+	s30_cond_add(xd, xm, n, -(xd[n - 1] >> 31));
+	ok = f[0] ^ 1;
+	for (u = 1; u < n; u ++) {
+		ok |= f[u];
+	}
+	ok = ((ok | -ok) >> 31) ^ 1;
+	nan |= from_s30(d, xd, n) | ((valid & ok) ^ 1);
+	d[0] = h | (nan << 31);
+}
+
+static void
+modinv_stack(uint32_t *d, const uint32_t *a, const uint32_t *m, size_t n)
+{
+	uint32_t t[CTTK_MAX_INT_BUF / sizeof(uint32_t)];
+
+	modinv_buf(d, a, m, t, n);
+}
+
+/* see cttk.h */
+void
+cttk_i31_modinv(uint32_t *d, const uint32_t *a, const uint32_t *m)
+{
+	uint32_t h;
+	size_t n;
+
+	STATS_I31(GCD);
+	h = d[0] & 0x7FFFFFFF;
+	if (h != (a[0] & 0x7FFFFFFF) || h != (m[0] & 0x7FFFFFFF)) {
+		STATS_NAN_SIZE();
+		d[0] |= 0x80000000;
+		return;
+	}
+	n = s30_len(h);
+	if (5 * n <= (CTTK_MAX_INT_BUF / sizeof(uint32_t))) {
+		modinv_stack(d, a, m, n);
+		return;
+	}
+#if !CTTK_NO_MALLOC
+	{
+		uint32_t *t;
+
+		t = cttk_scratch_alloc(5 * n * sizeof(uint32_t));
+		if (t != NULL) {
+			modinv_buf(d, a, m, t, n);
+			free(t);
+			return;
+		}
+	}
+#endif
+	STATS_NAN_SCRATCH();
+	d[0] |= 0x80000000;
+}
+
+/*
+ * GCD with a temporary buffer of 2*n words. Sizes have been verified.
+ */
+static void
+gcd_buf(uint32_t *d, const uint32_t *a, const uint32_t *b,
+	uint32_t *t, size_t n)
+{
+	uint32_t h, nan, k, ctl;
+	uint32_t *f, *g;
+	size_t u;
+
+	h = d[0] & 0x7FFFFFFF;
+	nan = (a[0] | b[0]) >> 31;
+	f = t;
+	g = f + n;
+	to_s30(f, n, a);
+	to_s30(g, n, b);
+	s30_cond_neg(f, n, -(f[n - 1] >> 31));
+	s30_cond_neg(g, n, -(g[n - 1] >> 31));
+
+	/*
+	 * Remove the common factors of 2, then put the odd value in f
+	 * (if both values are zero, then f and g remain zero, and so
+	 * does the result).
+	 */
+	k = s30_tzcnt2(f, g, n);
+	s30_rsh_prot(f, n, k);
+	s30_rsh_prot(g, n, k);
+	ctl = (f[0] & 1) - 1;
+	for (u = 0; u < n; u ++) {
+		uint32_t x;
+
+		x = ctl & (f[u] ^ g[u]);
+		f[u] ^= x;
+		g[u] ^= x;
+	}
+
+	run_divsteps(f, g, NULL, NULL, NULL, n, num_divsteps(h - (h >> 5)));
+	s30_cond_neg(f, n, -(f[n - 1] >> 31));
+	s30_lsh_prot(f, n, k);
+
+	/*
+	 * The GCD is not representable if it is equal to 2^(size-1),
+	 * i.e. for gcd(MinValue, 0) and gcd(MinValue, MinValue).
+	 */
+	nan |= from_s30(d, f, n);
+	d[0] = h | (nan << 31);
+}
+
+static void
+gcd_stack(uint32_t *d, const uint32_t *a, const uint32_t *b, size_t n)
+{
+	uint32_t t[CTTK_MAX_INT_BUF / sizeof(uint32_t)];
+
+	gcd_buf(d, a, b, t, n);
+}
+
+/* see cttk.h */
+void
+cttk_i31_gcd(uint32_t *d, const uint32_t *a, const uint32_t *b)
+{
+	uint32_t h;
+	size_t n;
+
+	STATS_I31(GCD);
+	h = d[0] & 0x7FFFFFFF;
+	if (h != (a[0] & 0x7FFFFFFF) || h != (b[0] & 0x7FFFFFFF)) {
+		STATS_NAN_SIZE();
+		d[0] |= 0x80000000;
+		return;
+	}
+	n = s30_len(h);
+	if (2 * n <= (CTTK_MAX_INT_BUF / sizeof(uint32_t))) {
+		gcd_stack(d, a, b, n);
+		return;
+	}
+#if !CTTK_NO_MALLOC
+	{
+		uint32_t *t;
+
+		t = cttk_scratch_alloc(2 * n * sizeof(uint32_t));
+		if (t != NULL) {
+			gcd_buf(d, a, b, t, n);
+			free(t);
+			return;
+		}
+	}
+#endif
+	STATS_NAN_SCRATCH();
+	d[0] |= 0x80000000;
+}
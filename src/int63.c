@@ -0,0 +1,3277 @@
+/*
+ * Copyright (c) 2018 Thomas Pornin <pornin@bolet.org>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining 
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be 
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, 
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND 
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "inner.h"
+
+/*
+ * Memory layout: a big integer is a sequence of 64 bit words.
+ * First word (header) contains (least to most significant order):
+ *
+ *    size % 63      6 bits, value is 0 to 62
+ *    size / 63      57 bits
+ *    NaN flag       1 bit (1 = NaN, 0 = not NaN)
+ *
+ * Further words contain the value, 63 bits per word, little-endian.
+ * The upper bit of each uint64_t is always 0. The sign bit is extended
+ * over the complete last word (excluding bit 63).
+ *
+ * If the NaN flag is set, then words may contain any value, with
+ * the following constraints:
+ *   - The top bit of each word (except the header word) is still 0.
+ *   - The header word is still fully defined.
+ *
+ * Size is not secret, so we can make conditional jumps based on that
+ * size.
+ *
+ *
+ * Let h be the value of the header word, with the NaN flag masked out.
+ * Then:
+ *
+ *   - The number of value words is equal to: (h + 63) >> 6
+ *   - The bit length is: h - (h >> 6)
+ *
+ * This implementation mirrors the i31 code (int31.c); it is meant for
+ * architectures with 64-bit registers, where it halves the number of
+ * words (and divides by about four the number of word products).
+ */
+
+#define M63   ((uint64_t)0x7FFFFFFFFFFFFFFF)
+#define NAN63   ((uint64_t)1 << 63)
+
+/*
+ * Get index of the top bit (sign bit) given the encoded size (header
+ * word, without the "NaN" flag). The returned index is relative to
+ * the top word.
+ */
+static inline unsigned
+top_index63(uint64_t h)
+{
+	h = (h & 63) - 1;
+	return (unsigned)(h + (63 & (h >> 6)));
+}
+
+/*
+ * Sign-extend an n-bit value to 64 bits (1 <= n <= 64).
+ */
+static inline uint64_t
+signext64(uint64_t v, unsigned n)
+{
+	uint64_t hi, lo;
+
+	hi = -(uint64_t)((v >> (n - 1)) & 1) << (n - 1);
+	lo = v & ((uint64_t)-1 >> (64 - n));
+	return hi | lo;
+}
+
+/*
+ * Bit length of a 64-bit unsigned integer.
+ */
+static inline uint32_t
+bitlength64(uint64_t x)
+{
+	uint32_t xh;
+	cttk_bool nz;
+
+	xh = (uint32_t)(x >> 32);
+	nz = cttk_u32_neq0(xh);
+	return cttk_u32_mux(nz, 32 + cttk_u32_bitlength(xh),
+		cttk_u32_bitlength((uint32_t)x));
+}
+
+/*
+ * Product of two 63-bit values: the low 63 bits are returned, and the
+ * high bits (63 bits) are written in *hi.
+ */
+static inline uint64_t
+mul63(uint64_t x, uint64_t y, uint64_t *hi)
+{
+	uint64_t lo, h;
+
+	lo = mulu64w(x, y, &h);
+	*hi = (h << 1) | (lo >> 63);
+	return lo & M63;
+}
+
+/* see cttk.h */
+void
+cttk_i63_init(uint64_t *x, unsigned size)
+{
+	uint64_t h;
+
+	h = (uint64_t)size + ((uint64_t)size / 63);
+	*x = h | NAN63;
+	memset(x + 1, 0, (size_t)((h + 63) >> 6) * sizeof *x);
+}
+
+/* see cttk.h */
+void
+cttk_i63_set_u32(uint64_t *x, uint32_t v)
+{
+	uint64_t h;
+	uint32_t size;
+	size_t len;
+
+	x[0] &= M63;
+	h = x[0];
+	len = (size_t)((h + 63) >> 6);
+	size = (uint32_t)(h - (h >> 6));
+
+	/*
+	 * If there is an overflow, then we will get a NaN. Otherwise,
+	 * the value is positive, so the sign extends as a 0.
+	 */
+	memset(x + 2, 0, (len - 1) * sizeof(uint64_t));
+	x[1] = v;
+	if (size <= 32) {
+		x[0] |= (uint64_t)cttk_u32_neq0(v >> (size - 1)).v << 63;
+	}
+}
+
+/* see cttk.h */
+void
+cttk_i63_set_u32_trunc(uint64_t *x, uint32_t v)
+{
+	uint64_t h;
+	uint32_t size;
+	size_t len;
+
+	x[0] &= M63;
+	h = x[0];
+	len = (size_t)((h + 63) >> 6);
+	size = (uint32_t)(h - (h >> 6));
+	memset(x + 1, 0, len * sizeof(uint64_t));
+	if (size > 32) {
+		x[1] = v;
+	} else {
+		x[1] = signext64(v, size) & M63;
+	}
+}
+
+/* see cttk.h */
+void
+cttk_i63_set_u64(uint64_t *x, uint64_t v)
+{
+	uint64_t h;
+	uint32_t size;
+	size_t len;
+
+	x[0] &= M63;
+	h = x[0];
+	len = (size_t)((h + 63) >> 6);
+	size = (uint32_t)(h - (h >> 6));
+	memset(x + 1, 0, len * sizeof(uint64_t));
+	x[1] = v & M63;
+	if (size > 63) {
+		x[2] = v >> 63;
+	}
+	if (size <= 64) {
+		x[0] |= (uint64_t)cttk_u64_neq0(v >> (size - 1)).v << 63;
+	}
+}
+
+/* see cttk.h */
+void
+cttk_i63_set_u64_trunc(uint64_t *x, uint64_t v)
+{
+	uint64_t h;
+	uint32_t size;
+	size_t len;
+
+	x[0] &= M63;
+	h = x[0];
+	len = (size_t)((h + 63) >> 6);
+	size = (uint32_t)(h - (h >> 6));
+	memset(x + 1, 0, len * sizeof(uint64_t));
+	if (size >= 65) {
+		/*
+		 * If size is 65 bits or more, then the 64-bit value fits
+		 * unmodified (positive).
+		 */
+		x[1] = v & M63;
+		x[2] = v >> 63;
+	} else if (size == 64) {
+		/*
+		 * If size is 64 bits, then the value uses two words; the
+		 * top bit of the source is the sign bit.
+		 */
+		x[1] = v & M63;
+		x[2] = -(v >> 63) >> 1;
+	} else {
+		x[1] = signext64(v, size) & M63;
+	}
+}
+
+/* see cttk.h */
+void
+cttk_i63_set_s32(uint64_t *x, int32_t v)
+{
+	uint64_t h;
+	uint32_t size;
+	size_t u, len;
+	uint64_t w;
+
+	x[0] &= M63;
+	h = x[0];
+	len = (size_t)((h + 63) >> 6);
+	size = (uint32_t)(h - (h >> 6));
+	w = (uint64_t)(int64_t)v;
+	x[1] = w & M63;
+
+	/*
+	 * If size is at least 32 bits, then there can be no overflow,
+	 * but we must extend the sign bit over all remaining words.
+	 * If size is 31 bits or less, then we check that all top bits
+	 * of the source value are equal to each other.
+	 */
+	if (size >= 32) {
+		w = -(w >> 63) >> 1;
+		for (u = 1; u < len; u ++) {
+			x[u + 1] = w;
+		}
+	} else {
+		uint64_t m;
+
+		m = (uint64_t)-1 << (size - 1);
+		w &= m;
+		x[0] |= (uint64_t)(cttk_u64_neq0(w).v
+			& cttk_u64_neq0(w ^ m).v) << 63;
+	}
+}
+
+/* see cttk.h */
+void
+cttk_i63_set_s64(uint64_t *x, int64_t v)
+{
+	uint64_t h;
+	uint32_t size;
+	size_t u, len;
+	uint64_t w;
+
+	x[0] &= M63;
+	h = x[0];
+	len = (size_t)((h + 63) >> 6);
+	size = (uint32_t)(h - (h >> 6));
+	w = (uint64_t)v;
+	x[1] = w & M63;
+	if (size >= 64) {
+		uint64_t ss;
+
+		ss = -(w >> 63) >> 1;
+		for (u = 1; u < len; u ++) {
+			x[u + 1] = ss;
+		}
+	}
+
+	/*
+	 * Check on overflow: the top bits must be equal to each other.
+	 */
+	if (size < 64) {
+		uint64_t m;
+
+		m = (uint64_t)-1 << (size - 1);
+		w &= m;
+		x[0] |= (uint64_t)(cttk_u64_neq0(w).v
+			& cttk_u64_neq0(w ^ m).v) << 63;
+	}
+}
+
+/* see cttk.h */
+void
+cttk_i63_set(uint64_t *d, const uint64_t *a)
+{
+	uint64_t h;
+	size_t dlen, alen;
+
+	/*
+	 * Special case: when source and operands are identical, there
+	 * is nothing more to do.
+	 */
+	if (a == d) {
+		return;
+	}
+
+	/*
+	 * We may now assume that operands do not overlap.
+	 */
+	h = a[0] & M63;
+	alen = (size_t)((h + 63) >> 6);
+
+	h = d[0] & M63;
+	dlen = (size_t)((h + 63) >> 6);
+	d[0] = h | (a[0] & NAN63);
+
+	if (dlen > alen) {
+		size_t u;
+		uint64_t w;
+
+		memcpy(d + 1, a + 1, alen * sizeof *a);
+		w = -(a[alen] >> 62) >> 1;
+		for (u = alen; u < dlen; u ++) {
+			d[1 + u] = w;
+		}
+	} else {
+		size_t u;
+		uint64_t w, m;
+
+		memcpy(d + 1, a + 1, dlen * sizeof *a);
+		m = -(a[alen] >> 62) >> 1;
+		w = (d[dlen] ^ m) & ((uint64_t)-1 << top_index63(h));
+		for (u = dlen; u < alen; u ++) {
+			w |= a[u + 1] ^ m;
+		}
+		d[0] |= (w | -w) & NAN63;
+	}
+}
+
+/* see cttk.h */
+void
+cttk_i63_set_trunc(uint64_t *d, const uint64_t *a)
+{
+	uint64_t h;
+	size_t dlen, alen;
+
+	/*
+	 * Special case: when source and operands are identical, there
+	 * is nothing more to do.
+	 */
+	if (a == d) {
+		return;
+	}
+
+	/*
+	 * We may now assume that operands do not overlap.
+	 */
+	h = a[0] & M63;
+	alen = (size_t)((h + 63) >> 6);
+
+	h = d[0] & M63;
+	dlen = (size_t)((h + 63) >> 6);
+	d[0] = h | (a[0] & NAN63);
+
+	if (dlen > alen) {
+		size_t u;
+		uint64_t w;
+
+		memcpy(d + 1, a + 1, alen * sizeof *a);
+		w = -(a[alen] >> 62) >> 1;
+		for (u = alen; u < dlen; u ++) {
+			d[1 + u] = w;
+		}
+	} else {
+		uint64_t m, sb;
+
+		memcpy(d + 1, a + 1, dlen * sizeof *a);
+		m = (uint64_t)1 << top_index63(h);
+		sb = d[dlen] & m;
+		d[dlen] &= m - 1;
+		d[dlen] |= -sb & M63;
+	}
+}
+
+/* see cttk.h */
+uint32_t
+cttk_i63_to_u32_trunc(const uint64_t *x)
+{
+	/*
+	 * The low word is sign-extended, so its low 32 bits are always
+	 * the low 32 bits of the value.
+	 */
+	return (uint32_t)x[1] & (uint32_t)((x[0] >> 63) - 1);
+}
+
+/* see cttk.h */
+int32_t
+cttk_i63_to_s32_trunc(const uint64_t *x)
+{
+	uint32_t r;
+
+	r = cttk_i63_to_u32_trunc(x);
+	return *(int32_t *)&r;
+}
+
+/* see cttk.h */
+uint64_t
+cttk_i63_to_u64_trunc(const uint64_t *x)
+{
+	uint64_t h, r;
+
+	h = x[0] & M63;
+	r = x[1];
+	if (h > 64) {
+		r |= x[2] << 63;
+	} else {
+		r |= (r & ((uint64_t)1 << 62)) << 1;
+	}
+	return r & ((x[0] >> 63) - 1);
+}
+
+/* see cttk.h */
+int64_t
+cttk_i63_to_s64_trunc(const uint64_t *x)
+{
+	uint64_t r;
+
+	r = cttk_i63_to_u64_trunc(x);
+	return *(int64_t *)&r;
+}
+
+/*
+ * Generic decoding routine.
+ */
+static void
+gendec(uint64_t *x, const void *src, size_t src_len, int be, int sig, int trunc)
+{
+	uint64_t h, top, top2;
+	const unsigned char *buf;
+	size_t u, v, len;
+	unsigned ssb, ssx, k, hk, extra_bits, extra_bits_len;
+	cttk_bool in_range;
+
+	x[0] &= M63;
+	h = x[0];
+	len = (size_t)((h + 63) >> 6);
+	memset(x + 1, 0, len * sizeof *x);
+	if (src_len == 0) {
+		if (sig) {
+			x[0] |= NAN63;
+		}
+		return;
+	}
+	buf = src;
+	hk = top_index63(h);
+
+	/*
+	 * 'ssb' is the value used for bytes beyond the source buffer.
+	 */
+	if (sig) {
+		if (be) {
+			ssb = -(unsigned)(buf[0] >> 7) & 0xFF;
+		} else {
+			ssb = -(unsigned)(buf[src_len - 1] >> 7) & 0xFF;
+		}
+	} else {
+		ssb = 0;
+	}
+
+	/*
+	 * u:k points to the next bits to fill in x (u is word index, k
+	 * is bit index).
+	 * v is source byte index (counting from 0 for least significant).
+	 */
+	u = 0;
+	k = 0;
+	v = 0;
+
+	/*
+	 * in_range is set to false if the value turns out to be out of
+	 * range (this is ignored if truncating). ssx is set to 0x00 or
+	 * 0xFF when the sign bit of x is reached.
+	 */
+	in_range = cttk_true;
+	ssx = 0;
+
+	/*
+	 * extra_bits / extra_bits_len will be set if there are extra bits
+	 * that must be checked against the final value sign.
+	 */
+	extra_bits = 0;
+	extra_bits_len = 0;
+
+	while (u < len || v < src_len) {
+		unsigned b;
+
+		/*
+		 * Get next byte of input in b.
+		 */
+		if (v < src_len) {
+			b = be ? buf[src_len - 1 - v] : buf[v];
+		} else {
+			b = ssb;
+		}
+		v ++;
+
+		if (u < len) {
+			if (k <= 55) {
+				x[1 + u] |= (uint64_t)b << k;
+			} else {
+				/*
+				 * If we get beyond the last word boundary
+				 * then we may have some extra bits which
+				 * will have to be checked against the
+				 * value sign.
+				 */
+				x[1 + u] |= ((uint64_t)b << k) & M63;
+				if ((u + 1) < len) {
+					x[2 + u] |= (uint64_t)b >> (63 - k);
+				} else {
+					extra_bits = b >> (63 - k);
+					extra_bits_len = k - 55;
+				}
+			}
+
+			k += 8;
+			if (k >= 63) {
+				k -= 63;
+				u ++;
+				if (u == len) {
+					ssx = -(unsigned)((x[len] >> hk) & 1)
+						& 0xFF;
+				}
+			}
+		} else {
+			/*
+			 * If all words are filled, then we merely check
+			 * that extra bytes have a value compatible with
+			 * the range.
+			 */
+			in_range = cttk_and(in_range, cttk_u32_eq(b, ssx));
+		}
+	}
+
+	/*
+	 * We reach this point only when we filled all value words, and
+	 * read all source bytes. ssx has been set. We still need to do
+	 * some cleanup actions:
+	 *
+	 *  - If truncating, then there may be some extra bits in the top
+	 *    word that must be replaced with a sign extension.
+	 *
+	 *  - If not truncating, then we must check that the extra bits
+	 *    in the top word, and also the "extra bits" (if applicable),
+	 *    have the proper value. Moreover, if source is unsigned, then
+	 *    we must also check that we got a positive value.
+	 */
+	top = x[len];
+	top2 = signext64(top, hk + 1) & M63;
+	if (trunc) {
+		x[len] = top2;
+	} else {
+		in_range = cttk_and(in_range, cttk_u64_eq(top, top2));
+		if (extra_bits_len > 0) {
+			in_range = cttk_and(in_range, cttk_u32_eq(extra_bits,
+				ssx >> (8 - extra_bits_len)));
+		}
+		if (!sig) {
+			in_range = cttk_and(in_range, cttk_u32_eq0(ssx));
+		}
+		x[0] |= (uint64_t)cttk_not(in_range).v << 63;
+	}
+}
+
+/*
+ * Generic encoding routine.
+ */
+static void
+genenc(void *dst, size_t dst_len, const uint64_t *x, int be)
+{
+	unsigned char *buf;
+	uint64_t h, acc, ssx;
+	unsigned mask, acc_len;
+	size_t u, len, v;
+
+	h = x[0];
+	mask = (unsigned)(h >> 63) - 1;
+	h &= M63;
+	len = (size_t)((h + 63) >> 6);
+
+	ssx = -(uint64_t)((x[len] >> top_index63(h)) & 1) >> 1;
+	acc = x[1];
+	acc_len = 63;
+	u = 1;
+	buf = dst;
+	for (v = 0; v < dst_len; v ++) {
+		unsigned b;
+
+		if (acc_len >= 8) {
+			b = (unsigned)acc & 0xFF;
+			acc >>= 8;
+			acc_len -= 8;
+		} else {
+			b = (unsigned)acc;
+			if (u < len) {
+				acc = x[1 + u];
+				u ++;
+			} else {
+				acc = ssx;
+			}
+			b |= (unsigned)(acc << acc_len);
+			acc >>= (8 - acc_len);
+			acc_len += 55;
+		}
+		b &= mask;
+		if (be) {
+			buf[dst_len - 1 - v] = b;
+		} else {
+			buf[v] = b;
+		}
+	}
+}
+
+/* see cttk.h */
+void
+cttk_i63_decbe_signed(uint64_t *x, const void *src, size_t len)
+{
+	gendec(x, src, len, 1, 1, 0);
+}
+
+/* see cttk.h */
+void
+cttk_i63_decbe_unsigned(uint64_t *x, const void *src, size_t len)
+{
+	gendec(x, src, len, 1, 0, 0);
+}
+
+/* see cttk.h */
+void
+cttk_i63_decbe_signed_trunc(uint64_t *x, const void *src, size_t len)
+{
+	gendec(x, src, len, 1, 1, 1);
+}
+
+/* see cttk.h */
+void
+cttk_i63_decbe_unsigned_trunc(uint64_t *x, const void *src, size_t len)
+{
+	gendec(x, src, len, 1, 0, 1);
+}
+
+/* see cttk.h */
+void
+cttk_i63_decle_signed(uint64_t *x, const void *src, size_t len)
+{
+	gendec(x, src, len, 0, 1, 0);
+}
+
+/* see cttk.h */
+void
+cttk_i63_decle_unsigned(uint64_t *x, const void *src, size_t len)
+{
+	gendec(x, src, len, 0, 0, 0);
+}
+
+/* see cttk.h */
+void
+cttk_i63_decle_signed_trunc(uint64_t *x, const void *src, size_t len)
+{
+	gendec(x, src, len, 0, 1, 1);
+}
+
+/* see cttk.h */
+void
+cttk_i63_decle_unsigned_trunc(uint64_t *x, const void *src, size_t len)
+{
+	gendec(x, src, len, 0, 0, 1);
+}
+
+/* see cttk.h */
+void
+cttk_i63_encbe(void *dst, size_t len, const uint64_t *x)
+{
+	genenc(dst, len, x, 1);
+}
+
+/* see cttk.h */
+void
+cttk_i63_encle(void *dst, size_t len, const uint64_t *x)
+{
+	genenc(dst, len, x, 0);
+}
+
+/*
+ * Compare x with zero. This function ignores the NaN flag.
+ */
+static cttk_bool
+val_eq0(const uint64_t *x)
+{
+	uint64_t h, r;
+	size_t len, u;
+
+	h = x[0] & M63;
+	len = (size_t)((h + 63) >> 6);
+	r = 0;
+	for (u = 0; u < len; u ++) {
+		r |= x[u + 1];
+	}
+	return cttk_u64_eq0(r);
+}
+
+/*
+ * Test whether x is lower than zero. This function ignores the NaN
+ * flag. Since it only grabs the sign bit, it is efficient even for
+ * large integers.
+ */
+static cttk_bool
+val_lt0(const uint64_t *x)
+{
+	uint64_t h;
+	size_t len;
+
+	h = x[0] & M63;
+	len = (size_t)((h + 63) >> 6);
+	return cttk_bool_of_u32((uint32_t)(x[len] >> 62) & 1);
+}
+
+/*
+ * Get actual bitlength, i.e. minimal number of bits to hold the value,
+ * excluding the sign bit (hence, -1 has bitlength 0). This function
+ * ignores the NaN flag.
+ */
+static uint32_t
+real_bitlength(const uint64_t *x)
+{
+	uint64_t h, mx, t;
+	uint32_t g;
+	size_t len, u;
+	unsigned k;
+
+	h = x[0] & M63;
+	len = (size_t)((h + 63) >> 6);
+	k = top_index63(h);
+	mx = -(uint64_t)((x[len] >> k) & 1) >> 1;
+
+	/*
+	 * mx is an all-zero or all-one pattern (63 bits), depending on
+	 * sign bit value. We XOR it with the words, to normalize on the
+	 * positive case. We look for the index (g) and value (t) of the
+	 * topmost non-zero word.
+	 */
+	t = x[1] ^ mx;
+	g = 0;
+	for (u = 1; u < len; u ++) {
+		uint64_t w;
+		cttk_bool nz;
+
+		w = x[u + 1] ^ mx;
+		nz = cttk_u64_neq0(w);
+		t = cttk_u64_mux(nz, w, t);
+		g = cttk_u32_mux(nz, (uint32_t)u, g);
+	}
+
+	return bitlength64(t) + (g << 6) - g;
+}
+
+/* see cttk.h */
+uint32_t
+cttk_i63_to_u32(const uint64_t *x)
+{
+	uint32_t r;
+
+	r = cttk_i63_to_u32_trunc(x);
+	r &= -cttk_u32_lt(real_bitlength(x), 33).v;
+	r &= val_lt0(x).v - 1;
+	return r;
+}
+
+/* see cttk.h */
+int32_t
+cttk_i63_to_s32(const uint64_t *x)
+{
+	uint32_t r;
+
+	r = cttk_i63_to_u32_trunc(x);
+	r &= -cttk_u32_lt(real_bitlength(x), 32).v;
+	return *(int32_t *)&r;
+}
+
+/* see cttk.h */
+uint64_t
+cttk_i63_to_u64(const uint64_t *x)
+{
+	uint64_t r;
+
+	r = cttk_i63_to_u64_trunc(x);
+	r &= -(uint64_t)cttk_u32_lt(real_bitlength(x), 65).v;
+	r &= (uint64_t)val_lt0(x).v - 1;
+	return r;
+}
+
+/* see cttk.h */
+int64_t
+cttk_i63_to_s64(const uint64_t *x)
+{
+	uint64_t r;
+
+	r = cttk_i63_to_u64_trunc(x);
+	r &= -(uint64_t)cttk_u32_lt(real_bitlength(x), 64).v;
+	return *(int64_t *)&r;
+}
+
+/* see cttk.h */
+cttk_bool
+cttk_i63_eq0(const uint64_t *x)
+{
+	return cttk_and(val_eq0(x), cttk_not(cttk_i63_isnan(x)));
+}
+
+/* see cttk.h */
+cttk_bool
+cttk_i63_neq0(const uint64_t *x)
+{
+	return cttk_not(cttk_or(val_eq0(x), cttk_i63_isnan(x)));
+}
+
+/* see cttk.h */
+cttk_bool
+cttk_i63_gt0(const uint64_t *x)
+{
+	return cttk_not(cttk_or(cttk_or(val_eq0(x), val_lt0(x)),
+		cttk_i63_isnan(x)));
+}
+
+/* see cttk.h */
+cttk_bool
+cttk_i63_lt0(const uint64_t *x)
+{
+	return cttk_and(val_lt0(x), cttk_not(cttk_i63_isnan(x)));
+}
+
+/* see cttk.h */
+cttk_bool
+cttk_i63_geq0(const uint64_t *x)
+{
+	return cttk_not(cttk_or(val_lt0(x), cttk_i63_isnan(x)));
+}
+
+/* see cttk.h */
+cttk_bool
+cttk_i63_leq0(const uint64_t *x)
+{
+	return cttk_and(cttk_or(val_eq0(x), val_lt0(x)),
+		cttk_not(cttk_i63_isnan(x)));
+}
+
+/*
+ * Test two integers for NaN. This function returns true is either or
+ * both are NaN.
+ */
+static inline cttk_bool
+tst_nan2(const uint64_t *x, const uint64_t *y)
+{
+	return cttk_bool_of_u32((uint32_t)((x[0] | y[0]) >> 63));
+}
+
+/*
+ * Compare integers; this function assumes that both operands have the
+ * same size. The NaN flag of each value is ignored.
+ */
+static cttk_bool
+val_eq(const uint64_t *x, const uint64_t *y)
+{
+	size_t u, len;
+	uint64_t r;
+
+	len = (size_t)(((x[0] & M63) + 63) >> 6);
+	r = 0;
+	for (u = 0; u < len; u ++) {
+		r |= x[1 + u] ^ y[1 + u];
+	}
+	return cttk_u64_eq0(r);
+}
+
+/*
+ * Compare integers; this function assumes that both operands have the
+ * same size. The header word of each value is ignored.
+ */
+static cttk_bool
+val_lt(const uint64_t *x, const uint64_t *y)
+{
+	size_t u, len;
+	uint64_t cc;
+
+	len = (size_t)(((x[0] & M63) + 63) >> 6);
+	cc = 0;
+	for (u = 0; u < len; u ++) {
+		uint64_t wx, wy, wz;
+
+		wx = x[u + 1];
+		wy = y[u + 1];
+		wz = wx - wy - cc;
+		cc = (wz >> 63);
+	}
+
+	/*
+	 * The XOR of the sign bits of x and y, and of the carry, yields
+	 * the sign of the result (see int31.c for details).
+	 */
+	cc ^= (x[len] ^ y[len]) >> 62;
+	return cttk_bool_of_u32((uint32_t)cc);
+}
+
+/*
+ * Generic integer comparison. This function assumes that both operands
+ * have the same size, and ignores the NaN flags. Returned value is
+ * -1, 0 or 1, converted to uint32_t.
+ */
+static uint32_t
+val_cmp(const uint64_t *x, const uint64_t *y)
+{
+	size_t u, len;
+	uint64_t cc, t;
+
+	len = (size_t)(((x[0] & M63) + 63) >> 6);
+	cc = 0;
+	t = 0;
+	for (u = 0; u < len; u ++) {
+		uint64_t wx, wy, wz;
+
+		wx = x[u + 1];
+		wy = y[u + 1];
+		wz = wx - wy - cc;
+		cc = (wz >> 63);
+		t |= wz;
+	}
+
+	/*
+	 * See val_lt() for details.
+	 */
+	cc ^= (x[len] ^ y[len]) >> 62;
+	return cttk_u64_neq0(t).v | -(uint32_t)cc;
+}
+
+/* see cttk.h */
+cttk_bool
+cttk_i63_eq(const uint64_t *x, const uint64_t *y)
+{
+	if ((uint64_t)((x[0] ^ y[0]) << 1) != 0) {
+		return cttk_false;
+	}
+	return cttk_and(val_eq(x, y), cttk_not(tst_nan2(x, y)));
+}
+
+/* see cttk.h */
+cttk_bool
+cttk_i63_neq(const uint64_t *x, const uint64_t *y)
+{
+	if ((uint64_t)((x[0] ^ y[0]) << 1) != 0) {
+		return cttk_false;
+	}
+	return cttk_not(cttk_or(val_eq(x, y), tst_nan2(x, y)));
+}
+
+/* see cttk.h */
+cttk_bool
+cttk_i63_lt(const uint64_t *x, const uint64_t *y)
+{
+	if ((uint64_t)((x[0] ^ y[0]) << 1) != 0) {
+		return cttk_false;
+	}
+	return cttk_and(val_lt(x, y), cttk_not(tst_nan2(x, y)));
+}
+
+/* see cttk.h */
+cttk_bool
+cttk_i63_leq(const uint64_t *x, const uint64_t *y)
+{
+	if ((uint64_t)((x[0] ^ y[0]) << 1) != 0) {
+		return cttk_false;
+	}
+	return cttk_not(cttk_or(val_lt(y, x), tst_nan2(x, y)));
+}
+
+/* see cttk.h */
+cttk_bool
+cttk_i63_gt(const uint64_t *x, const uint64_t *y)
+{
+	if ((uint64_t)((x[0] ^ y[0]) << 1) != 0) {
+		return cttk_false;
+	}
+	return cttk_and(val_lt(y, x), cttk_not(tst_nan2(x, y)));
+}
+
+/* see cttk.h */
+cttk_bool
+cttk_i63_geq(const uint64_t *x, const uint64_t *y)
+{
+	if ((uint64_t)((x[0] ^ y[0]) << 1) != 0) {
+		return cttk_false;
+	}
+	return cttk_not(cttk_or(val_lt(x, y), tst_nan2(x, y)));
+}
+
+/* see cttk.h */
+int
+cttk_i63_sign(const uint64_t *x)
+{
+	uint32_t w;
+
+	w = (val_eq0(x).v ^ (uint32_t)1) | -val_lt0(x).v;
+	w &= (uint32_t)(x[0] >> 63) - 1;
+	return *(int32_t *)&w;
+}
+
+/* see cttk.h */
+int32_t
+cttk_i63_cmp(const uint64_t *x, const uint64_t *y)
+{
+	uint32_t w;
+
+	if ((uint64_t)((x[0] ^ y[0]) << 1) != 0) {
+		return 0;
+	}
+	w = val_cmp(x, y) & ((uint32_t)((x[0] | y[0]) >> 63) - 1);
+	return *(int32_t *)&w;
+}
+
+/* see cttk.h */
+void
+cttk_i63_copy(uint64_t *d, const uint64_t *s)
+{
+	if (d != s) {
+		if ((uint64_t)((d[0] ^ s[0]) << 1) != 0) {
+			d[0] |= NAN63;
+			return;
+		}
+		memcpy(d, s, (size_t)(((s[0] & M63) + 127) >> 6) * sizeof *s);
+	}
+}
+
+/* see cttk.h */
+void
+cttk_i63_cond_copy(cttk_bool ctl, uint64_t *d, const uint64_t *s)
+{
+	cttk_i63_mux(ctl, d, s, d);
+}
+
+/* see cttk.h */
+void
+cttk_i63_swap(uint64_t *a, uint64_t *b)
+{
+	size_t u, len;
+
+	if (a == b) {
+		return;
+	}
+	if ((uint64_t)((a[0] ^ b[0]) << 1) != 0) {
+		a[0] |= NAN63;
+		b[0] |= NAN63;
+		return;
+	}
+	len = (size_t)(((a[0] & M63) + 127) >> 6);
+	for (u = 0; u < len; u ++) {
+		uint64_t w;
+
+		w = a[u];
+		a[u] = b[u];
+		b[u] = w;
+	}
+}
+
+/* see cttk.h */
+void
+cttk_i63_cond_swap(cttk_bool ctl, uint64_t *a, uint64_t *b)
+{
+	size_t u, len;
+
+	if (a == b) {
+		return;
+	}
+	if ((uint64_t)((a[0] ^ b[0]) << 1) != 0) {
+		a[0] |= NAN63;
+		b[0] |= NAN63;
+		return;
+	}
+	len = (size_t)(((a[0] & M63) + 127) >> 6);
+	for (u = 0; u < len; u ++) {
+		uint64_t wa, wb, wt;
+
+		wa = a[u];
+		wb = b[u];
+		wt = (wa ^ wb) & -(uint64_t)ctl.v;
+		a[u] = wa ^ wt;
+		b[u] = wb ^ wt;
+	}
+}
+
+/* see cttk.h */
+void
+cttk_i63_mux(cttk_bool ctl, uint64_t *d, const uint64_t *a, const uint64_t *b)
+{
+	uint64_t h;
+	size_t u, len;
+
+	h = d[0] & M63;
+	if (h != (a[0] & M63) || h != (b[0] & M63)) {
+		d[0] |= NAN63;
+		return;
+	}
+	len = (size_t)((h + 127) >> 6);
+	for (u = 0; u < len; u ++) {
+		d[u] = cttk_u64_mux(ctl, a[u], b[u]);
+	}
+}
+
+/* see cttk.h */
+void
+cttk_i63_add(uint64_t *d, const uint64_t *a, const uint64_t *b)
+{
+	uint64_t h, cc, tt;
+	size_t len, u;
+
+	/*
+	 * Compare sizes. This needs not be constant-time, but take
+	 * care to mask out the NaN bit (since that one may be secret).
+	 */
+	h = d[0] & M63;
+	if (h != (a[0] & M63) || h != (b[0] & M63)) {
+		d[0] |= NAN63;
+		return;
+	}
+	len = (size_t)((h + 63) >> 6);
+
+	/*
+	 * Since sizes are equal, we can simply OR together the header
+	 * words, which will propagate any NaN.
+	 */
+	d[0] = a[0] | b[0];
+
+	/*
+	 * Get the XOR of the top words of a[] and b[]. This must be
+	 * done now because either could be used as recipient.
+	 */
+	tt = a[len] ^ b[len];
+
+	/*
+	 * Compute addition.
+	 */
+	cc = 0;
+	for (u = 0; u < len; u ++) {
+		uint64_t wa, wb, wd;
+
+		wa = a[u + 1];
+		wb = b[u + 1];
+		wd = wa + wb + cc;
+		d[u + 1] = wd & M63;
+		cc = wd >> 63;
+	}
+
+	/*
+	 * Overflow/underflow: the mathematical sign of the result is
+	 * the XOR of the sign bits of a and b, and of the carry (see
+	 * int31.c for details). Result is an overflow or underflow if
+	 * and only if the obtained sign bit of d does not match that
+	 * value.
+	 */
+	d[0] |= (((tt ^ d[len]) >> top_index63(h)) ^ cc) << 63;
+}
+
+/* see cttk.h */
+void
+cttk_i63_add_trunc(uint64_t *d, const uint64_t *a, const uint64_t *b)
+{
+	uint64_t h, cc;
+	size_t len, u;
+
+	/*
+	 * Compare sizes. This needs not be constant-time, but take
+	 * care to mask out the NaN bit (since that one may be secret).
+	 */
+	h = d[0] & M63;
+	if (h != (a[0] & M63) || h != (b[0] & M63)) {
+		d[0] |= NAN63;
+		return;
+	}
+	len = (size_t)((h + 63) >> 6);
+
+	/*
+	 * Since sizes are equal, we can simply OR together the header
+	 * words, which will propagate any NaN.
+	 */
+	d[0] = a[0] | b[0];
+
+	/*
+	 * Compute addition.
+	 */
+	cc = 0;
+	for (u = 0; u < len; u ++) {
+		uint64_t wa, wb, wd;
+
+		wa = a[u + 1];
+		wb = b[u + 1];
+		wd = wa + wb + cc;
+		d[u + 1] = wd & M63;
+		cc = wd >> 63;
+	}
+
+	/*
+	 * Apply truncation to the proper size.
+	 */
+	d[len] = signext64(d[len], top_index63(h) + 1) & M63;
+}
+
+/* see cttk.h */
+void
+cttk_i63_sub(uint64_t *d, const uint64_t *a, const uint64_t *b)
+{
+	uint64_t h, cc, tt;
+	size_t len, u;
+
+	/*
+	 * Compare sizes. This needs not be constant-time, but take
+	 * care to mask out the NaN bit (since that one may be secret).
+	 */
+	h = d[0] & M63;
+	if (h != (a[0] & M63) || h != (b[0] & M63)) {
+		d[0] |= NAN63;
+		return;
+	}
+	len = (size_t)((h + 63) >> 6);
+
+	/*
+	 * Since sizes are equal, we can simply OR together the header
+	 * words, which will propagate any NaN.
+	 */
+	d[0] = a[0] | b[0];
+
+	/*
+	 * Get the XOR of the top words of a[] and b[]. This must be
+	 * done now because either could be used as recipient.
+	 */
+	tt = a[len] ^ b[len];
+
+	/*
+	 * Compute subtraction.
+	 */
+	cc = 0;
+	for (u = 0; u < len; u ++) {
+		uint64_t wa, wb, wd;
+
+		wa = a[u + 1];
+		wb = b[u + 1];
+		wd = wa - wb - cc;
+		d[u + 1] = wd & M63;
+		cc = wd >> 63;
+	}
+
+	/*
+	 * Overflow/underflow: same expression as for addition.
+	 */
+	d[0] |= (((tt ^ d[len]) >> top_index63(h)) ^ cc) << 63;
+}
+
+/* see cttk.h */
+void
+cttk_i63_sub_trunc(uint64_t *d, const uint64_t *a, const uint64_t *b)
+{
+	uint64_t h, cc;
+	size_t len, u;
+
+	/*
+	 * Compare sizes. This needs not be constant-time, but take
+	 * care to mask out the NaN bit (since that one may be secret).
+	 */
+	h = d[0] & M63;
+	if (h != (a[0] & M63) || h != (b[0] & M63)) {
+		d[0] |= NAN63;
+		return;
+	}
+	len = (size_t)((h + 63) >> 6);
+
+	/*
+	 * Since sizes are equal, we can simply OR together the header
+	 * words, which will propagate any NaN.
+	 */
+	d[0] = a[0] | b[0];
+
+	/*
+	 * Compute subtraction.
+	 */
+	cc = 0;
+	for (u = 0; u < len; u ++) {
+		uint64_t wa, wb, wd;
+
+		wa = a[u + 1];
+		wb = b[u + 1];
+		wd = wa - wb - cc;
+		d[u + 1] = wd & M63;
+		cc = wd >> 63;
+	}
+
+	/*
+	 * Apply truncation to the proper size.
+	 */
+	d[len] = signext64(d[len], top_index63(h) + 1) & M63;
+}
+
+/* see cttk.h */
+void
+cttk_i63_neg(uint64_t *d, const uint64_t *x)
+{
+	uint64_t h, cc, tt;
+	size_t u, len;
+
+	h = x[0] & M63;
+	if ((uint64_t)((h ^ d[0]) << 1) != 0) {
+		d[0] |= NAN63;
+		return;
+	}
+
+	d[0] = x[0];
+	len = (size_t)((h + 63) >> 6);
+	cc = 1;
+	tt = x[len];
+	for (u = 0; u < len; u ++) {
+		uint64_t w;
+
+		w = x[u + 1];
+		w = (~w & M63) + cc;
+		d[u + 1] = w & M63;
+		cc = w >> 63;
+	}
+
+	/*
+	 * We get an overflow if the source operand is equal to the
+	 * minimum value in the representable range. This is the
+	 * only situation where the sign bit of the source and of
+	 * the result are both 1.
+	 */
+	d[0] |= (((d[len] & tt) >> top_index63(h)) & 1) << 63;
+}
+
+/* see cttk.h */
+void
+cttk_i63_neg_trunc(uint64_t *d, const uint64_t *x)
+{
+	uint64_t h, cc;
+	size_t u, len;
+
+	h = x[0] & M63;
+	if ((uint64_t)((h ^ d[0]) << 1) != 0) {
+		d[0] |= NAN63;
+		return;
+	}
+
+	d[0] = x[0];
+	len = (size_t)((h + 63) >> 6);
+	cc = 1;
+	for (u = 0; u < len; u ++) {
+		uint64_t w;
+
+		w = x[u + 1];
+		w = (~w & M63) + cc;
+		d[u + 1] = w & M63;
+		cc = w >> 63;
+	}
+	d[len] = signext64(d[len], top_index63(h) + 1) & M63;
+}
+
+/*
+ * Generic multiplication routine. It computes a truncated multiplication,
+ * but returns true if and only if the truncation changed the value. If
+ * c is not NULL, then c is added to the product (c + a*b is computed).
+ * This function:
+ *  - ignores the NaN flag;
+ *  - assumes that source and destination operands have the same size;
+ *  - assumes that the destination array is distinct from a and b (but
+ *    it may be equal to c).
+ */
+static cttk_bool
+genmul_separate(uint64_t *d, const uint64_t *a, const uint64_t *b,
+	const uint64_t *c)
+{
+	uint64_t h, ssa, ssb, ssc, ssd, z1, z2, zd;
+	size_t u, v, len;
+	cttk_bool only0, only1;
+
+	h = d[0] & M63;
+	len = (size_t)((h + 63) >> 6);
+	ssa = -(a[len] >> 62) >> 1;
+	ssb = -(b[len] >> 62) >> 1;
+	ssc = c == NULL ? 0 : -(c[len] >> 62) >> 1;
+	only0 = cttk_true;
+	only1 = cttk_true;
+
+	/*
+	 * Column sums are accumulated over three 63-bit words (zd, z1
+	 * and z2).
+	 */
+	z1 = 0;
+	z2 = 0;
+	zd = 0;
+	for (u = 0; u < (len << 1); u ++) {
+		zd = z1;
+		z1 = z2;
+		z2 = 0;
+		if (c != NULL) {
+			zd += u < len ? c[1 + u] : ssc;
+			z1 += zd >> 63;
+			zd &= M63;
+		}
+		for (v = 0; v <= u; v ++) {
+			uint64_t wa, wb, lo, hi;
+
+			wa = v < len ? a[1 + v] : ssa;
+			wb = (v + len) > u ? b[1 + u - v] : ssb;
+			lo = mul63(wa, wb, &hi);
+			zd += lo;
+			z1 += hi + (zd >> 63);
+			zd &= M63;
+			z2 += z1 >> 63;
+			z1 &= M63;
+		}
+		if (u < len) {
+			d[1 + u] = zd;
+		} else {
+			only0 = cttk_and(only0, cttk_u64_eq0(zd));
+			only1 = cttk_and(only1, cttk_u64_eq0(zd ^ M63));
+		}
+	}
+
+	/*
+	 * The top bit of the last word is the sign of the exact result.
+	 * We check that all upper bits have a value compatible with it.
+	 */
+	ssd = -(zd >> 62) >> 1;
+	return cttk_and(
+		cttk_bool_of_u32(cttk_u32_mux(
+			cttk_bool_of_u32((uint32_t)ssd & 1), only1.v, only0.v)),
+		cttk_u64_eq0((d[len] ^ ssd) >> top_index63(h)));
+}
+
+/*
+ * Unsigned product of two sequences of n 63-bit words (little-endian
+ * order, no header). The result (2*n words) is written in d, which must
+ * not overlap with a or b.
+ */
+static void
+umul_school(uint64_t *d, const uint64_t *a, const uint64_t *b, size_t n)
+{
+	size_t u, v;
+
+	memset(d, 0, (n << 1) * sizeof *d);
+	for (u = 0; u < n; u ++) {
+		uint64_t au, cc;
+
+		au = a[u];
+		cc = 0;
+		for (v = 0; v < n; v ++) {
+			uint64_t lo, hi;
+
+			lo = mul63(au, b[v], &hi);
+			lo += d[u + v];
+			hi += lo >> 63;
+			lo = (lo & M63) + cc;
+			hi += lo >> 63;
+			d[u + v] = lo & M63;
+			cc = hi;
+		}
+		d[u + n] = cc;
+	}
+}
+
+/*
+ * Karatsuba threshold, in 63-bit words. Since the i63 words are
+ * twice as large as the i31 words, the configured threshold is halved;
+ * the recursion needs operands of at least 4 words.
+ */
+#if CTTK_KARATSUBA_THRESHOLD < 8
+#define KARATSUBA_THRESHOLD63   4
+#else
+#define KARATSUBA_THRESHOLD63   ((CTTK_KARATSUBA_THRESHOLD + 1) >> 1)
+#endif
+
+/*
+ * Get the size (in words) of the temporary area needed by umul_karatsuba()
+ * for operands of n words.
+ */
+static size_t
+karatsuba_tmp_len(size_t n)
+{
+	size_t tlen;
+
+	tlen = 0;
+	while (n >= KARATSUBA_THRESHOLD63) {
+		n = n - (n >> 1) + 1;
+		tlen += n << 2;
+	}
+	return tlen;
+}
+
+/*
+ * Unsigned product, as umul_school(), with Karatsuba's method for
+ * operands of at least KARATSUBA_THRESHOLD63 words. The temporary area t
+ * must have length at least karatsuba_tmp_len(n) words. See int31.c for
+ * details.
+ */
+static void
+umul_karatsuba(uint64_t *d, const uint64_t *a, const uint64_t *b,
+	size_t n, uint64_t *t)
+{
+	size_t n0, n1, u;
+	uint64_t *sa, *sb, *zm;
+	uint64_t ca, cb, cc;
+
+	if (n < KARATSUBA_THRESHOLD63) {
+		umul_school(d, a, b, n);
+		return;
+	}
+	n0 = n >> 1;
+	n1 = n - n0;
+	sa = t;
+	sb = sa + n1 + 1;
+	zm = sb + n1 + 1;
+	t = zm + ((n1 + 1) << 1);
+
+	ca = 0;
+	cb = 0;
+	for (u = 0; u < n1; u ++) {
+		uint64_t wa, wb;
+
+		wa = a[n0 + u] + ca;
+		wb = b[n0 + u] + cb;
+		if (u < n0) {
+			wa += a[u];
+			wb += b[u];
+		}
+		sa[u] = wa & M63;
+		sb[u] = wb & M63;
+		ca = wa >> 63;
+		cb = wb >> 63;
+	}
+	sa[n1] = ca;
+	sb[n1] = cb;
+
+	umul_karatsuba(d, a, b, n0, t);
+	umul_karatsuba(d + (n0 << 1), a + n0, b + n0, n1, t);
+	umul_karatsuba(zm, sa, sb, n1 + 1, t);
+
+	/*
+	 * zm <- zm - a0*b0 - a1*b1 = a0*b1 + a1*b0
+	 */
+	cc = 0;
+	for (u = 0; u < ((n1 + 1) << 1); u ++) {
+		uint64_t w;
+
+		w = zm[u] - cc;
+		if (u < (n0 << 1)) {
+			w -= d[u];
+		}
+		zm[u] = w & M63;
+		cc = w >> 63;
+	}
+	cc = 0;
+	for (u = 0; u < ((n1 + 1) << 1); u ++) {
+		uint64_t w;
+
+		w = zm[u] - cc;
+		if (u < (n1 << 1)) {
+			w -= d[(n0 << 1) + u];
+		}
+		zm[u] = w & M63;
+		cc = w >> 63;
+	}
+
+	/*
+	 * d <- d + zm*2^(63*n0)
+	 */
+	cc = 0;
+	for (u = 0; u < (n << 1) - n0; u ++) {
+		uint64_t w;
+
+		w = d[n0 + u] + cc;
+		if (u < ((n1 + 1) << 1)) {
+			w += zm[u];
+		}
+		d[n0 + u] = w & M63;
+		cc = w >> 63;
+	}
+}
+
+/*
+ * Multiplication with Karatsuba's method. This has the same semantics
+ * as genmul_separate(), except that d may be equal to a and/or b. The
+ * temporary area t must have length at least 2*len+karatsuba_tmp_len(len)
+ * words, where len is the number of value words in the operands.
+ */
+static cttk_bool
+genmul_karatsuba(uint64_t *d, const uint64_t *a, const uint64_t *b,
+	const uint64_t *c, uint64_t *t)
+{
+	uint64_t h, ssa, ssb, ssc, ssd, cc;
+	size_t u, len;
+	uint64_t *p;
+	cttk_bool only0, only1;
+
+	h = d[0] & M63;
+	len = (size_t)((h + 63) >> 6);
+	ssa = -(a[len] >> 62) >> 1;
+	ssb = -(b[len] >> 62) >> 1;
+
+	p = t;
+	umul_karatsuba(p, a + 1, b + 1, len, p + (len << 1));
+	cc = 0;
+	for (u = 0; u < len; u ++) {
+		uint64_t w;
+
+		w = p[len + u] - (b[1 + u] & ssa) - cc;
+		p[len + u] = w & M63;
+		cc = w >> 63;
+	}
+	cc = 0;
+	for (u = 0; u < len; u ++) {
+		uint64_t w;
+
+		w = p[len + u] - (a[1 + u] & ssb) - cc;
+		p[len + u] = w & M63;
+		cc = w >> 63;
+	}
+	if (c != NULL) {
+		ssc = -(c[len] >> 62) >> 1;
+		cc = 0;
+		for (u = 0; u < (len << 1); u ++) {
+			uint64_t w;
+
+			w = p[u] + (u < len ? c[1 + u] : ssc) + cc;
+			p[u] = w & M63;
+			cc = w >> 63;
+		}
+	}
+
+	only0 = cttk_true;
+	only1 = cttk_true;
+	for (u = len; u < (len << 1); u ++) {
+		only0 = cttk_and(only0, cttk_u64_eq0(p[u]));
+		only1 = cttk_and(only1, cttk_u64_eq0(p[u] ^ M63));
+	}
+	memcpy(d + 1, p, len * sizeof *d);
+
+	/*
+	 * We check that all upper bits have a value compatible with the
+	 * result sign (as in genmul_separate()).
+	 */
+	ssd = -(p[(len << 1) - 1] >> 62) >> 1;
+	return cttk_and(
+		cttk_bool_of_u32(cttk_u32_mux(
+			cttk_bool_of_u32((uint32_t)ssd & 1), only1.v, only0.v)),
+		cttk_u64_eq0((d[len] ^ ssd) >> top_index63(h)));
+}
+
+/*
+ * Get the length (in words) of the temporary buffer that allows
+ * genmul_buf() to use its fastest method, for operands with header h
+ * (see int31.c).
+ */
+static size_t
+genmul_tmp_len(uint64_t h)
+{
+	size_t len;
+
+	len = (size_t)((h + 63) >> 6);
+	if (len >= KARATSUBA_THRESHOLD63) {
+		return (len << 1) + karatsuba_tmp_len(len);
+	}
+	return len + 1;
+}
+
+/*
+ * Verify operand sizes for a multiplication (with an optional addend c),
+ * and set the destination header. Returned value is 0 (and d is set to
+ * NaN) on size mismatch.
+ */
+static int
+genmul_check(uint64_t *d, const uint64_t *a, const uint64_t *b,
+	const uint64_t *c)
+{
+	uint64_t h;
+
+	h = d[0] & M63;
+	if (h != (a[0] & M63) || h != (b[0] & M63)
+		|| (c != NULL && h != (c[0] & M63)))
+	{
+		d[0] |= NAN63;
+		return 0;
+	}
+	d[0] = a[0] | b[0] | (c == NULL ? 0 : c[0]);
+	return 1;
+}
+
+/*
+ * Multiplication (with optional addend c) with a caller-provided
+ * temporary t of tlen words (sizes have been verified). See int31.c
+ * for details.
+ */
+static cttk_bool
+genmul_buf(uint64_t *d, const uint64_t *a, const uint64_t *b,
+	const uint64_t *c, uint64_t *t, size_t tlen)
+{
+	uint64_t h;
+	size_t len;
+	cttk_bool r;
+
+	h = d[0] & M63;
+	len = (size_t)((h + 63) >> 6);
+	if (len >= KARATSUBA_THRESHOLD63
+		&& tlen >= (len << 1) + karatsuba_tmp_len(len))
+	{
+		return genmul_karatsuba(d, a, b, c, t);
+	}
+	if (d != a && d != b) {
+		return genmul_separate(d, a, b, c);
+	}
+	if (tlen < len + 1) {
+		d[0] |= NAN63;
+		return cttk_false;
+	}
+	t[0] = h;
+	memset(t + 1, 0, len * sizeof t[0]);
+	r = genmul_separate(t, a, b, c);
+	memcpy(d + 1, t + 1, len * sizeof *d);
+	return r;
+}
+
+/*
+ * Multiplication with a stack-based temporary.
+ */
+static cttk_bool
+genmul_stack(uint64_t *d, const uint64_t *a, const uint64_t *b,
+	const uint64_t *c)
+{
+	uint64_t t[CTTK_MAX_INT_BUF / sizeof(uint64_t)];
+
+	return genmul_buf(d, a, b, c, t, sizeof t / sizeof t[0]);
+}
+
+static cttk_bool
+genmul(uint64_t *d, const uint64_t *a, const uint64_t *b, const uint64_t *c)
+{
+	size_t tlen;
+
+	if (!genmul_check(d, a, b, c)) {
+		return cttk_false;
+	}
+	tlen = genmul_tmp_len(d[0] & M63);
+#if !CTTK_NO_MALLOC
+	if (tlen > (CTTK_MAX_INT_BUF / sizeof(uint64_t))) {
+		uint64_t *t;
+
+		t = cttk_scratch_alloc(tlen * sizeof *t);
+		if (t != NULL) {
+			cttk_bool r;
+
+			r = genmul_buf(d, a, b, c, t, tlen);
+			free(t);
+			return r;
+		}
+	}
+#else
+	(void)tlen;
+#endif
+	return genmul_stack(d, a, b, c);
+}
+
+/* see cttk.h */
+void
+cttk_i63_mul(uint64_t *d, const uint64_t *a, const uint64_t *b)
+{
+	cttk_bool r;
+
+	r = genmul(d, a, b, NULL);
+	d[0] |= (uint64_t)(r.v ^ 1) << 63;
+}
+
+/* see cttk.h */
+void
+cttk_i63_mul_trunc(uint64_t *d, const uint64_t *a, const uint64_t *b)
+{
+	uint64_t h;
+	size_t len;
+
+	genmul(d, a, b, NULL);
+	h = d[0] & M63;
+	len = (size_t)((h + 63) >> 6);
+	d[len] = signext64(d[len], top_index63(h) + 1) & M63;
+}
+
+/* see cttk.h */
+void
+cttk_i63_mul_ws(uint64_t *d, const uint64_t *a, const uint64_t *b,
+	uint64_t *tmp, size_t tmp_len)
+{
+	cttk_bool r;
+
+	if (!genmul_check(d, a, b, NULL)) {
+		return;
+	}
+	r = genmul_buf(d, a, b, NULL, tmp, tmp_len);
+	d[0] |= (uint64_t)(r.v ^ 1) << 63;
+}
+
+/* see cttk.h */
+void
+cttk_i63_muladd(uint64_t *d, const uint64_t *a, const uint64_t *b,
+	const uint64_t *c)
+{
+	cttk_bool r;
+
+	r = genmul(d, a, b, c);
+	d[0] |= (uint64_t)(r.v ^ 1) << 63;
+}
+
+/* see cttk.h */
+void
+cttk_i63_muladd_trunc(uint64_t *d, const uint64_t *a, const uint64_t *b,
+	const uint64_t *c)
+{
+	uint64_t h;
+	size_t len;
+
+	genmul(d, a, b, c);
+	h = d[0] & M63;
+	len = (size_t)((h + 63) >> 6);
+	d[len] = signext64(d[len], top_index63(h) + 1) & M63;
+}
+
+/*
+ * Multiplication by a small scalar: d <- a*x + c, where c is either
+ * NULL (no addend) or equal to d (see int31.c). The exact result fits
+ * on len+1 words.
+ */
+static cttk_bool
+genmul_u32(uint64_t *d, const uint64_t *a, uint32_t x, const uint64_t *c)
+{
+	uint64_t h, ssa, ssc, ssd, cc, wd;
+	size_t u, len;
+	cttk_bool only0, only1;
+
+	h = d[0] & M63;
+	len = (size_t)((h + 63) >> 6);
+	ssa = -(a[len] >> 62) >> 1;
+	ssc = c == NULL ? 0 : -(c[len] >> 62) >> 1;
+	only0 = cttk_true;
+	only1 = cttk_true;
+
+	cc = 0;
+	wd = 0;
+	for (u = 0; u <= len; u ++) {
+		uint64_t lo, hi;
+
+		lo = mul63(u < len ? a[1 + u] : ssa, x, &hi);
+		if (c != NULL) {
+			lo += u < len ? c[1 + u] : ssc;
+			hi += lo >> 63;
+			lo &= M63;
+		}
+		lo += cc;
+		hi += lo >> 63;
+		wd = lo & M63;
+		cc = hi;
+		if (u < len) {
+			d[1 + u] = wd;
+		} else {
+			only0 = cttk_u64_eq0(wd);
+			only1 = cttk_u64_eq0(wd ^ M63);
+		}
+	}
+	ssd = -(wd >> 62) >> 1;
+	return cttk_and(
+		cttk_bool_of_u32(cttk_u32_mux(
+			cttk_bool_of_u32((uint32_t)ssd & 1), only1.v, only0.v)),
+		cttk_u64_eq0((d[len] ^ ssd) >> top_index63(h)));
+}
+
+/*
+ * Verify operand sizes for a multiplication by a small scalar, and set
+ * the destination header (see int31.c).
+ */
+static int
+genmul_u32_check(uint64_t *d, const uint64_t *a, int add)
+{
+	if (((d[0] ^ a[0]) & M63) != 0) {
+		d[0] |= NAN63;
+		return 0;
+	}
+	d[0] = add ? (d[0] | a[0]) : a[0];
+	return 1;
+}
+
+/* see cttk.h */
+void
+cttk_i63_mul_u32(uint64_t *d, const uint64_t *a, uint32_t x)
+{
+	cttk_bool r;
+
+	if (!genmul_u32_check(d, a, 0)) {
+		return;
+	}
+	r = genmul_u32(d, a, x, NULL);
+	d[0] |= (uint64_t)(r.v ^ 1) << 63;
+}
+
+/* see cttk.h */
+void
+cttk_i63_mul_u32_trunc(uint64_t *d, const uint64_t *a, uint32_t x)
+{
+	uint64_t h;
+	size_t len;
+
+	if (!genmul_u32_check(d, a, 0)) {
+		return;
+	}
+	genmul_u32(d, a, x, NULL);
+	h = d[0] & M63;
+	len = (size_t)((h + 63) >> 6);
+	d[len] = signext64(d[len], top_index63(h) + 1) & M63;
+}
+
+/* see cttk.h */
+void
+cttk_i63_addmul_u32(uint64_t *d, const uint64_t *a, uint32_t x)
+{
+	cttk_bool r;
+
+	if (!genmul_u32_check(d, a, 1)) {
+		return;
+	}
+	r = genmul_u32(d, a, x, d);
+	d[0] |= (uint64_t)(r.v ^ 1) << 63;
+}
+
+/* see cttk.h */
+void
+cttk_i63_addmul_u32_trunc(uint64_t *d, const uint64_t *a, uint32_t x)
+{
+	uint64_t h;
+	size_t len;
+
+	if (!genmul_u32_check(d, a, 1)) {
+		return;
+	}
+	genmul_u32(d, a, x, d);
+	h = d[0] & M63;
+	len = (size_t)((h + 63) >> 6);
+	d[len] = signext64(d[len], top_index63(h) + 1) & M63;
+}
+
+/*
+ * Set m (len words, no header) to the absolute value of a (see int31.c).
+ */
+static void
+abs_words(uint64_t *m, const uint64_t *a, size_t len)
+{
+	uint64_t ss, cc;
+	size_t u;
+
+	ss = -(a[len] >> 62) >> 1;
+	cc = ss & 1;
+	for (u = 0; u < len; u ++) {
+		uint64_t w;
+
+		w = (a[1 + u] ^ ss) + cc;
+		m[u] = w & M63;
+		cc = w >> 63;
+	}
+}
+
+/*
+ * Generic squaring routine; m contains the absolute value of the
+ * source operand (see int31.c for details).
+ */
+static cttk_bool
+gensqr_separate(uint64_t *d, const uint64_t *m)
+{
+	uint64_t h, z1, z2;
+	size_t u, v, len;
+	cttk_bool only0;
+
+	h = d[0] & M63;
+	len = (size_t)((h + 63) >> 6);
+	only0 = cttk_true;
+
+	/*
+	 * Cross products of a column are accumulated over three 63-bit
+	 * words (y0, y1 and y2), then doubled; the diagonal product and
+	 * the carry (z1 and z2) from the previous column are then added.
+	 */
+	z1 = 0;
+	z2 = 0;
+	for (u = 0; u < (len << 1); u ++) {
+		uint64_t y0, y1, y2, lo, hi;
+
+		y0 = 0;
+		y1 = 0;
+		y2 = 0;
+		for (v = u < len ? 0 : u + 1 - len; (v << 1) < u; v ++) {
+			lo = mul63(m[v], m[u - v], &hi);
+			y0 += lo;
+			y1 += hi + (y0 >> 63);
+			y0 &= M63;
+			y2 += y1 >> 63;
+			y1 &= M63;
+		}
+		y2 = (y2 << 1) | (y1 >> 62);
+		y1 = ((y1 << 1) & M63) | (y0 >> 62);
+		y0 = (y0 << 1) & M63;
+		if ((u & 1) == 0) {
+			lo = mul63(m[u >> 1], m[u >> 1], &hi);
+			y0 += lo;
+			y1 += hi + (y0 >> 63);
+			y0 &= M63;
+			y2 += y1 >> 63;
+			y1 &= M63;
+		}
+		y0 += z1;
+		y1 += z2 + (y0 >> 63);
+		y0 &= M63;
+		y2 += y1 >> 63;
+		y1 &= M63;
+		z1 = y1;
+		z2 = y2;
+		if (u < len) {
+			d[1 + u] = y0;
+		} else {
+			only0 = cttk_and(only0, cttk_u64_eq0(y0));
+		}
+	}
+	return cttk_and(only0, cttk_u64_eq0(d[len] >> top_index63(h)));
+}
+
+/*
+ * Unsigned square of a sequence of n 63-bit words (little-endian order,
+ * no header). The result (2*n words) is written in d, which must not
+ * overlap with a.
+ */
+static void
+usqr_school(uint64_t *d, const uint64_t *a, size_t n)
+{
+	size_t u, v;
+	uint64_t cc;
+
+	memset(d, 0, (n << 1) * sizeof *d);
+	for (u = 0; u < n; u ++) {
+		uint64_t au;
+
+		au = a[u];
+		cc = 0;
+		for (v = u + 1; v < n; v ++) {
+			uint64_t lo, hi;
+
+			lo = mul63(au, a[v], &hi);
+			lo += d[u + v];
+			hi += lo >> 63;
+			lo = (lo & M63) + cc;
+			hi += lo >> 63;
+			d[u + v] = lo & M63;
+			cc = hi;
+		}
+		d[u + n] = cc;
+	}
+	cc = 0;
+	for (u = 0; u < n; u ++) {
+		uint64_t lo, hi, w, c;
+
+		lo = mul63(a[u], a[u], &hi);
+		w = ((d[u << 1] << 1) & M63) + lo;
+		c = (d[u << 1] >> 62) + (w >> 63);
+		w = (w & M63) + cc;
+		d[u << 1] = w & M63;
+		cc = c + (w >> 63);
+		w = ((d[(u << 1) + 1] << 1) & M63) + hi;
+		c = (d[(u << 1) + 1] >> 62) + (w >> 63);
+		w = (w & M63) + cc;
+		d[(u << 1) + 1] = w & M63;
+		cc = c + (w >> 63);
+	}
+}
+
+/*
+ * Unsigned square with Karatsuba's method (see int31.c).
+ */
+static void
+usqr_karatsuba(uint64_t *d, const uint64_t *a, size_t n, uint64_t *t)
+{
+	size_t n0, n1, u;
+	uint64_t *sa, *zm;
+	uint64_t ca, cc;
+
+	if (n < KARATSUBA_THRESHOLD63) {
+		usqr_school(d, a, n);
+		return;
+	}
+	n0 = n >> 1;
+	n1 = n - n0;
+	sa = t;
+	zm = sa + n1 + 1;
+	t = zm + ((n1 + 1) << 1);
+
+	ca = 0;
+	for (u = 0; u < n1; u ++) {
+		uint64_t wa;
+
+		wa = a[n0 + u] + ca;
+		if (u < n0) {
+			wa += a[u];
+		}
+		sa[u] = wa & M63;
+		ca = wa >> 63;
+	}
+	sa[n1] = ca;
+
+	usqr_karatsuba(d, a, n0, t);
+	usqr_karatsuba(d + (n0 << 1), a + n0, n1, t);
+	usqr_karatsuba(zm, sa, n1 + 1, t);
+
+	/*
+	 * zm <- zm - a0^2 - a1^2 = 2*a0*a1
+	 */
+	cc = 0;
+	for (u = 0; u < ((n1 + 1) << 1); u ++) {
+		uint64_t w;
+
+		w = zm[u] - cc;
+		if (u < (n0 << 1)) {
+			w -= d[u];
+		}
+		zm[u] = w & M63;
+		cc = w >> 63;
+	}
+	cc = 0;
+	for (u = 0; u < ((n1 + 1) << 1); u ++) {
+		uint64_t w;
+
+		w = zm[u] - cc;
+		if (u < (n1 << 1)) {
+			w -= d[(n0 << 1) + u];
+		}
+		zm[u] = w & M63;
+		cc = w >> 63;
+	}
+
+	/*
+	 * d <- d + zm*2^(63*n0)
+	 */
+	cc = 0;
+	for (u = 0; u < (n << 1) - n0; u ++) {
+		uint64_t w;
+
+		w = d[n0 + u] + cc;
+		if (u < ((n1 + 1) << 1)) {
+			w += zm[u];
+		}
+		d[n0 + u] = w & M63;
+		cc = w >> 63;
+	}
+}
+
+/*
+ * Squaring with Karatsuba's method (see int31.c).
+ */
+static cttk_bool
+gensqr_karatsuba(uint64_t *d, const uint64_t *m, uint64_t *t)
+{
+	uint64_t h;
+	size_t u, len;
+	cttk_bool only0;
+
+	h = d[0] & M63;
+	len = (size_t)((h + 63) >> 6);
+	usqr_karatsuba(t, m, len, t + (len << 1));
+	only0 = cttk_true;
+	for (u = len; u < (len << 1); u ++) {
+		only0 = cttk_and(only0, cttk_u64_eq0(t[u]));
+	}
+	memcpy(d + 1, t, len * sizeof *d);
+	return cttk_and(only0, cttk_u64_eq0(d[len] >> top_index63(h)));
+}
+
+/*
+ * Get the length (in words) of the temporary buffer that allows
+ * gensqr_buf() to use its fastest method, for an operand with header h.
+ */
+static size_t
+gensqr_tmp_len(uint64_t h)
+{
+	size_t len;
+
+	len = (size_t)((h + 63) >> 6);
+	if (len >= KARATSUBA_THRESHOLD63) {
+		return 3 * len + karatsuba_tmp_len(len);
+	}
+	return len;
+}
+
+/*
+ * Verify operand sizes for a squaring, and set the destination header.
+ * Returned value is 0 (and d is set to NaN) on size mismatch.
+ */
+static int
+gensqr_check(uint64_t *d, const uint64_t *a)
+{
+	if ((d[0] & M63) != (a[0] & M63)) {
+		d[0] |= NAN63;
+		return 0;
+	}
+	d[0] = a[0];
+	return 1;
+}
+
+/*
+ * Squaring with a caller-provided temporary t of tlen words (sizes
+ * have been verified). See int31.c for details.
+ */
+static cttk_bool
+gensqr_buf(uint64_t *d, const uint64_t *a, uint64_t *t, size_t tlen)
+{
+	uint64_t h;
+	size_t len;
+
+	h = d[0] & M63;
+	len = (size_t)((h + 63) >> 6);
+	if (tlen < len) {
+		if (d != a) {
+			return genmul_separate(d, a, a, NULL);
+		}
+		d[0] |= NAN63;
+		return cttk_false;
+	}
+	abs_words(t, a, len);
+	if (len >= KARATSUBA_THRESHOLD63
+		&& tlen >= 3 * len + karatsuba_tmp_len(len))
+	{
+		return gensqr_karatsuba(d, t, t + len);
+	}
+	return gensqr_separate(d, t);
+}
+
+/*
+ * Squaring with a stack-based temporary.
+ */
+static cttk_bool
+gensqr_stack(uint64_t *d, const uint64_t *a)
+{
+	uint64_t t[CTTK_MAX_INT_BUF / sizeof(uint64_t)];
+
+	return gensqr_buf(d, a, t, sizeof t / sizeof t[0]);
+}
+
+static cttk_bool
+gensqr(uint64_t *d, const uint64_t *a)
+{
+	size_t tlen;
+
+	if (!gensqr_check(d, a)) {
+		return cttk_false;
+	}
+
+	tlen = gensqr_tmp_len(d[0] & M63);
+#if !CTTK_NO_MALLOC
+	if (tlen > (CTTK_MAX_INT_BUF / sizeof(uint64_t))) {
+		uint64_t *t;
+
+		t = cttk_scratch_alloc(tlen * sizeof *t);
+		if (t != NULL) {
+			cttk_bool r;
+
+			r = gensqr_buf(d, a, t, tlen);
+			free(t);
+			return r;
+		}
+	}
+#else
+	(void)tlen;
+#endif
+	return gensqr_stack(d, a);
+}
+
+/* see cttk.h */
+void
+cttk_i63_sqr(uint64_t *d, const uint64_t *a)
+{
+	cttk_bool r;
+
+	r = gensqr(d, a);
+	d[0] |= (uint64_t)(r.v ^ 1) << 63;
+}
+
+/* see cttk.h */
+void
+cttk_i63_sqr_trunc(uint64_t *d, const uint64_t *a)
+{
+	uint64_t h;
+	size_t len;
+
+	gensqr(d, a);
+	h = d[0] & M63;
+	len = (size_t)((h + 63) >> 6);
+	d[len] = signext64(d[len], top_index63(h) + 1) & M63;
+}
+
+/*
+ * Generic left-shift function:
+ *
+ *  - d and a must have been already verified to have the same size.
+ *  - Shift count is n = nd*63+nm, with 0 <= nm < 63, and n fits on 32 bits.
+ *  - If ctl is false, then the shift is not actually done.
+ *
+ * Returned value is false if the value overflows/underflows.
+ *
+ * nd and nm may leak.
+ */
+static cttk_bool
+genlsh(uint64_t *d, const uint64_t *a, uint32_t nd, unsigned nm, cttk_bool ctl)
+{
+	uint64_t h, ssa, tt, cm;
+	uint32_t n, bl;
+	unsigned hk;
+	size_t len, u;
+	cttk_bool r;
+
+	d[0] = a[0];
+	h = d[0] & M63;
+	len = (size_t)((h + 63) >> 6);
+	bl = (uint32_t)(h - (h >> 6));
+	n = 63 * nd + nm;
+	ssa = -(a[len] >> 62) & M63;
+	cm = (uint64_t)ctl.v - 1;
+
+	/*
+	 * If the shift count is greater than or equal to the type size,
+	 * then we can only get zero. This is an overflow/underflow if
+	 * the source value is not 0.
+	 */
+	if (n >= bl) {
+		r = cttk_true;
+		for (u = 0; u < len; u ++) {
+			uint64_t wa;
+
+			wa = a[1 + u];
+			r = cttk_and(r, cttk_u64_eq0(wa));
+			d[1 + u] = wa & cm;
+		}
+		return cttk_or(r, cttk_not(ctl));
+	}
+
+	/*
+	 * We reach that point only if n < bl, which implies nd < len.
+	 * Since source and destination may be the same array, we need
+	 * to do the shift in high to low order.
+	 */
+	r = cttk_true;
+	for (u = len; u > len - nd; u --) {
+		r = cttk_and(r, cttk_u64_eq(ssa, a[u]));
+	}
+	if (nm == 0) {
+		for (u = len; u > nd; u --) {
+			d[u] = cttk_u64_mux(ctl, a[u - nd], a[u]);
+		}
+	} else {
+		r = cttk_and(r,
+			cttk_u64_eq0((a[len - nd] ^ ssa) >> (63 - nm)));
+		for (u = len; u > nd; u --) {
+			uint64_t wa, wd;
+
+			wa = a[u - nd];
+			wd = (wa << nm) & M63;
+			if ((u - nd) > 1) {
+				wd |= a[u - nd - 1] >> (63 - nm);
+			}
+			d[u] = cttk_u64_mux(ctl, wd, a[u]);
+		}
+	}
+	for (u = nd; u > 0; u --) {
+		d[u] = a[u] & cm;
+	}
+
+	/*
+	 * 'r' contains the overflow/underflow check for all the dropped
+	 * bits, but we must still check the top bits in the high word
+	 * are all equal to the expected sign (and we should also adjust
+	 * them, for truncation support).
+	 */
+	hk = top_index63(h);
+	tt = signext64(d[len], hk + 1) & M63;
+	r = cttk_and(r, cttk_u64_eq(d[len], tt));
+	d[len] = tt;
+	r = cttk_and(r, cttk_u64_eq0((tt ^ ssa) >> hk));
+	return cttk_or(r, cttk_not(ctl));
+}
+
+/*
+ * Generic right-shift function:
+ *
+ *  - d and a must have been already verified to have the same size.
+ *  - Shift count is n = nd*63+nm, with 0 <= nm < 63, and n fits on 32 bits.
+ *  - If ctl is false, then the shift is not actually done.
+ *
+ * nd and nm may leak.
+ */
+static void
+genrsh(uint64_t *d, const uint64_t *a, uint32_t nd, unsigned nm, cttk_bool ctl)
+{
+	uint64_t h, ssa;
+	uint32_t n, bl;
+	size_t u, len;
+
+	d[0] = a[0];
+	h = d[0] & M63;
+	len = (size_t)((h + 63) >> 6);
+	bl = (uint32_t)(h - (h >> 6));
+	n = 63 * nd + nm;
+	ssa = -(a[len] >> 62) & M63;
+
+	/*
+	 * If right-shifting by at least bl-1 bits, then the result is
+	 * either 0 or -1, depending on source sign.
+	 */
+	if ((n + 1) >= bl) {
+		for (u = 0; u < len; u ++) {
+			d[1 + u] = cttk_u64_mux(ctl, ssa, a[1 + u]);
+		}
+		return;
+	}
+
+	/*
+	 * We reach that point only if n < bl, which implies nd < len.
+	 */
+	if (nm == 0) {
+		for (u = 0; u < (len - nd); u ++) {
+			d[1 + u] = cttk_u64_mux(ctl, a[1 + u + nd], a[1 + u]);
+		}
+	} else {
+		for (u = 0; u < (len - nd - 1); u ++) {
+			uint64_t wa;
+
+			wa = ((a[1 + u + nd] >> nm)
+				| (a[2 + u + nd] << (63 - nm))) & M63;
+			d[1 + u] = cttk_u64_mux(ctl, wa, a[1 + u]);
+		}
+		d[len - nd] = cttk_u64_mux(ctl,
+			((a[len] >> nm) | (ssa << (63 - nm))) & M63,
+			a[len - nd]);
+	}
+	for (u = len - nd; u < len; u ++) {
+		d[1 + u] = cttk_u64_mux(ctl, ssa, a[1 + u]);
+	}
+}
+
+/*
+ * Precomputed powers of two divided by 63 (quotient and remainder).
+ */
+static const uint32_t p2m63[] = {
+	((uint32_t)1 <<  0) / 63, ((uint32_t)1 <<  0) % 63,
+	((uint32_t)1 <<  1) / 63, ((uint32_t)1 <<  1) % 63,
+	((uint32_t)1 <<  2) / 63, ((uint32_t)1 <<  2) % 63,
+	((uint32_t)1 <<  3) / 63, ((uint32_t)1 <<  3) % 63,
+	((uint32_t)1 <<  4) / 63, ((uint32_t)1 <<  4) % 63,
+	((uint32_t)1 <<  5) / 63, ((uint32_t)1 <<  5) % 63,
+	((uint32_t)1 <<  6) / 63, ((uint32_t)1 <<  6) % 63,
+	((uint32_t)1 <<  7) / 63, ((uint32_t)1 <<  7) % 63,
+	((uint32_t)1 <<  8) / 63, ((uint32_t)1 <<  8) % 63,
+	((uint32_t)1 <<  9) / 63, ((uint32_t)1 <<  9) % 63,
+	((uint32_t)1 << 10) / 63, ((uint32_t)1 << 10) % 63,
+	((uint32_t)1 << 11) / 63, ((uint32_t)1 << 11) % 63,
+	((uint32_t)1 << 12) / 63, ((uint32_t)1 << 12) % 63,
+	((uint32_t)1 << 13) / 63, ((uint32_t)1 << 13) % 63,
+	((uint32_t)1 << 14) / 63, ((uint32_t)1 << 14) % 63,
+	((uint32_t)1 << 15) / 63, ((uint32_t)1 << 15) % 63,
+	((uint32_t)1 << 16) / 63, ((uint32_t)1 << 16) % 63,
+	((uint32_t)1 << 17) / 63, ((uint32_t)1 << 17) % 63,
+	((uint32_t)1 << 18) / 63, ((uint32_t)1 << 18) % 63,
+	((uint32_t)1 << 19) / 63, ((uint32_t)1 << 19) % 63,
+	((uint32_t)1 << 20) / 63, ((uint32_t)1 << 20) % 63,
+	((uint32_t)1 << 21) / 63, ((uint32_t)1 << 21) % 63,
+	((uint32_t)1 << 22) / 63, ((uint32_t)1 << 22) % 63,
+	((uint32_t)1 << 23) / 63, ((uint32_t)1 << 23) % 63,
+	((uint32_t)1 << 24) / 63, ((uint32_t)1 << 24) % 63,
+	((uint32_t)1 << 25) / 63, ((uint32_t)1 << 25) % 63,
+	((uint32_t)1 << 26) / 63, ((uint32_t)1 << 26) % 63,
+	((uint32_t)1 << 27) / 63, ((uint32_t)1 << 27) % 63,
+	((uint32_t)1 << 28) / 63, ((uint32_t)1 << 28) % 63,
+	((uint32_t)1 << 29) / 63, ((uint32_t)1 << 29) % 63,
+	((uint32_t)1 << 30) / 63, ((uint32_t)1 << 30) % 63,
+	((uint32_t)1 << 31) / 63, ((uint32_t)1 << 31) % 63,
+};
+
+/* see cttk.h */
+void
+cttk_i63_lsh(uint64_t *d, const uint64_t *a, uint32_t n)
+{
+	cttk_bool r;
+
+	if (((d[0] ^ a[0]) << 1) != 0) {
+		d[0] |= NAN63;
+		return;
+	}
+	r = genlsh(d, a, n / 63, n % 63, cttk_true);
+	d[0] |= (uint64_t)(r.v ^ 1) << 63;
+}
+
+/* see cttk.h */
+void
+cttk_i63_lsh_prot(uint64_t *d, const uint64_t *a, uint32_t n)
+{
+	int i;
+
+	if (((d[0] ^ a[0]) << 1) != 0) {
+		d[0] |= NAN63;
+		return;
+	}
+	for (i = 0; i < 32; i ++) {
+		cttk_bool r;
+
+		r = genlsh(d, a, p2m63[i << 1], p2m63[(i << 1) + 1],
+			cttk_u32_neq0(n & ((uint32_t)1 << i)));
+		d[0] |= (uint64_t)(r.v ^ 1) << 63;
+		a = d;
+	}
+}
+
+/* see cttk.h */
+void
+cttk_i63_lsh_trunc(uint64_t *d, const uint64_t *a, uint32_t n)
+{
+	if (((d[0] ^ a[0]) << 1) != 0) {
+		d[0] |= NAN63;
+		return;
+	}
+	genlsh(d, a, n / 63, n % 63, cttk_true);
+}
+
+/* see cttk.h */
+void
+cttk_i63_lsh_trunc_prot(uint64_t *d, const uint64_t *a, uint32_t n)
+{
+	int i;
+
+	if (((d[0] ^ a[0]) << 1) != 0) {
+		d[0] |= NAN63;
+		return;
+	}
+	for (i = 0; i < 32; i ++) {
+		genlsh(d, a, p2m63[i << 1], p2m63[(i << 1) + 1],
+			cttk_u32_neq0(n & ((uint32_t)1 << i)));
+		a = d;
+	}
+}
+
+/* see cttk.h */
+void
+cttk_i63_rsh(uint64_t *d, const uint64_t *a, uint32_t n)
+{
+	if (((d[0] ^ a[0]) << 1) != 0) {
+		d[0] |= NAN63;
+		return;
+	}
+	genrsh(d, a, n / 63, n % 63, cttk_true);
+}
+
+/* see cttk.h */
+void
+cttk_i63_rsh_prot(uint64_t *d, const uint64_t *a, uint32_t n)
+{
+	int i;
+
+	if (((d[0] ^ a[0]) << 1) != 0) {
+		d[0] |= NAN63;
+		return;
+	}
+	for (i = 0; i < 32; i ++) {
+		genrsh(d, a, p2m63[i << 1], p2m63[(i << 1) + 1],
+			cttk_u32_neq0(n & ((uint32_t)1 << i)));
+		a = d;
+	}
+}
+
+/*
+ * Get the bit length of a nonnegative integer represented over len
+ * 63-bit words (little-endian order, no header).
+ */
+static uint32_t
+words_bitlength(const uint64_t *x, size_t len)
+{
+	uint32_t bl;
+	size_t u;
+
+	bl = 0;
+	for (u = 0; u < len; u ++) {
+		uint64_t w;
+
+		w = x[u];
+		bl = cttk_u32_mux(cttk_u64_neq0(w),
+			63 * (uint32_t)u + bitlength64(w), bl);
+	}
+	return bl;
+}
+
+/*
+ * Left-shift a sequence of len 63-bit words by n bits, in place. Bits
+ * pushed beyond the last word are dropped. The shift count is protected;
+ * it must be lower than 2^nb, and the memory access pattern depends only
+ * on len and nb.
+ */
+static void
+words_lsh_prot(uint64_t *x, size_t len, uint32_t n, unsigned nb)
+{
+	unsigned i;
+
+	for (i = 0; i < nb; i ++) {
+		cttk_bool ctl;
+		size_t nd, u;
+		unsigned nm;
+
+		ctl = cttk_u32_neq0(n & ((uint32_t)1 << i));
+		nd = p2m63[i << 1];
+		nm = p2m63[(i << 1) + 1];
+		for (u = len; u -- > 0;) {
+			uint64_t w;
+
+			w = 0;
+			if (u >= nd) {
+				w = (x[u - nd] << nm) & M63;
+				if (u > nd) {
+					w |= x[u - nd - 1] >> (63 - nm);
+				}
+			}
+			x[u] = cttk_u64_mux(ctl, w, x[u]);
+		}
+	}
+}
+
+/*
+ * Right-shift a sequence of len 63-bit words by n bits, in place. Zeros
+ * are shifted in from the top. As with words_lsh_prot(), the shift count
+ * is protected and must be lower than 2^nb.
+ */
+static void
+words_rsh_prot(uint64_t *x, size_t len, uint32_t n, unsigned nb)
+{
+	unsigned i;
+
+	for (i = 0; i < nb; i ++) {
+		cttk_bool ctl;
+		size_t nd, u;
+		unsigned nm;
+
+		ctl = cttk_u32_neq0(n & ((uint32_t)1 << i));
+		nd = p2m63[i << 1];
+		nm = p2m63[(i << 1) + 1];
+		for (u = 0; u < len; u ++) {
+			uint64_t w;
+
+			w = 0;
+			if (nd < len - u) {
+				w = x[u + nd] >> nm;
+				if (nd + 1 < len - u) {
+					w |= (x[u + nd + 1] << (63 - nm))
+						& M63;
+				}
+			}
+			x[u] = cttk_u64_mux(ctl, w, x[u]);
+		}
+	}
+}
+
+/*
+ * Divide the 126-bit value hi*2^63+lo by d; hi and lo must fit on 63 bits
+ * each, and d must be such that 2^62 <= d < 2^63. If hi >= d, then the
+ * quotient does not fit on 63 bits, and 2^63-1 is returned instead.
+ * This is a plain restoring division, in constant time: the partial
+ * remainder is kept lower than 2*d, hence it fits in 64 bits.
+ */
+static uint64_t
+divw(uint64_t hi, uint64_t lo, uint64_t d)
+{
+	uint64_t r, q;
+	int k;
+
+	r = hi;
+	q = 0;
+	for (k = 62; k >= 0; k --) {
+		uint64_t c;
+
+		r = (r << 1) | ((lo >> k) & 1);
+		c = cttk_u64_geq(r, d).v;
+		r -= d & -c;
+		q |= c << k;
+	}
+	return q | (-(uint64_t)cttk_u64_geq(hi, d).v >> 1);
+}
+
+/*
+ * Word-wise division of nonnegative integers, on raw 63-bit words
+ * (little-endian order, no header). The dividend x has nx words, the
+ * divisor y has ny words, with 1 <= ny <= nx; y must not be zero.
+ * On output, the quotient is written in q (nx words; q may be NULL),
+ * and the remainder in the first ny words of x (the other words of x
+ * are set to 0). The contents of y are destroyed. t must have room
+ * for nx+ny words. This is the same algorithm as in int31.c, in base
+ * 2^63.
+ */
+static void
+divmod_words(uint64_t *q, uint64_t *x, size_t nx,
+	uint64_t *y, size_t ny, uint64_t *t)
+{
+	uint64_t yt;
+	uint32_t s;
+	unsigned nb;
+	size_t j, u;
+
+	s = 63 * (uint32_t)ny - words_bitlength(y, ny);
+	nb = cttk_u32_bitlength(63 * (uint32_t)ny - 1);
+	words_lsh_prot(y, ny, s, nb);
+	memcpy(t, x, nx * sizeof *x);
+	memset(t + nx, 0, ny * sizeof *t);
+	words_lsh_prot(t, nx + ny, s, nb);
+	yt = y[ny - 1];
+
+	for (j = nx; j -- > 0;) {
+		uint64_t *w;
+		uint64_t qw, cc, wu, neg;
+		int k;
+
+		/*
+		 * The current partial remainder is in w[0..ny] and is
+		 * lower than y*2^63.
+		 */
+		w = t + j;
+		qw = divw(w[ny], w[ny - 1], yt);
+
+		/*
+		 * Subtract qw*y; neg is set if the result is negative.
+		 */
+		cc = 0;
+		for (u = 0; u < ny; u ++) {
+			uint64_t lo, hi;
+
+			lo = mul63(qw, y[u], &hi) + cc;
+			cc = hi + (lo >> 63);
+			wu = w[u] - (lo & M63);
+			cc += wu >> 63;
+			w[u] = wu & M63;
+		}
+		wu = w[ny] - cc;
+		w[ny] = wu & M63;
+		neg = wu >> 63;
+
+		/*
+		 * Add back y while the value is negative. The addition
+		 * yields a carry out of the top word exactly when the
+		 * value becomes nonnegative.
+		 */
+		for (k = 0; k < 2; k ++) {
+			uint64_t m;
+
+			m = -neg >> 1;
+			cc = 0;
+			for (u = 0; u < ny; u ++) {
+				wu = w[u] + (y[u] & m) + cc;
+				w[u] = wu & M63;
+				cc = wu >> 63;
+			}
+			wu = w[ny] + cc;
+			w[ny] = wu & M63;
+			qw -= neg;
+			neg &= (wu >> 63) ^ 1;
+		}
+
+		if (q != NULL) {
+			q[j] = qw;
+		}
+	}
+
+	/*
+	 * The remainder, shifted by s bits, is in the low ny words of t.
+	 */
+	words_rsh_prot(t, ny, s, nb);
+	memcpy(x, t, ny * sizeof *x);
+	memset(x + ny, 0, (nx - ny) * sizeof *x);
+}
+
+/*
+ * Internal division routine:
+ *
+ *   - r is non-NULL.
+ *   - q, r, t1 and t2 are distinct from each other. Only q may be NULL.
+ *   - t1 and t2 are distinct from a and b.
+ *   - All non-NULL arrays have the same size.
+ *   - tw has room for twice the number of value words in a.
+ *
+ * Note that q and r may be aliases on a or b. Special cases are handled
+ * as in int31.c.
+ */
+static void
+gendiv_inner(uint64_t *q, uint64_t *r, const uint64_t *a,
+	const uint64_t *b, uint64_t *t1, uint64_t *t2, uint64_t *tw, int mod)
+{
+	uint64_t h, sa, sb;
+	unsigned hk;
+	size_t len, u;
+	cttk_bool a_isnan, a_isminv, b_isnan, b_isminv, b_iszero, b_ismone;
+	cttk_bool both_nan, half_nan, b_bad;
+
+	h = b[0] & M63;
+	hk = top_index63(h);
+	len = (size_t)((h + 63) >> 6);
+
+	/*
+	 * If a or b is NaN, or b is zero, then both q and r will be NaN.
+	 * If a is MinValue and b is -1, then q = NaN and r = 0.
+	 * We obtain the relevant values here:
+	 *    a_isnan      a is NaN
+	 *    b_isnan      b is NaN
+	 *    a_isminv     a == MinValue
+	 *    b_isminv     b == MinValue
+	 *    b_iszero     b == 0
+	 *    b_ismone     b == -1
+	 */
+	a_isnan = cttk_i63_isnan(a);
+	b_isnan = cttk_i63_isnan(b);
+	a_isminv = cttk_true;
+	b_isminv = cttk_true;
+	b_iszero = cttk_true;
+	b_ismone = cttk_true;
+	for (u = 0; (u + 1) < len; u ++) {
+		a_isminv = cttk_and(a_isminv, cttk_u64_eq0(a[1 + u]));
+		b_isminv = cttk_and(b_isminv, cttk_u64_eq0(b[1 + u]));
+		b_iszero = cttk_and(b_iszero, cttk_u64_eq0(b[1 + u]));
+		b_ismone = cttk_and(b_ismone, cttk_u64_eq(b[1 + u], M63));
+	}
+	a_isminv = cttk_and(a_isminv,
+		cttk_u64_eq(a[len], ((uint64_t)-1 << hk) & M63));
+	b_isminv = cttk_and(b_isminv,
+		cttk_u64_eq(b[len], ((uint64_t)-1 << hk) & M63));
+	b_iszero = cttk_and(b_iszero, cttk_u64_eq0(b[len]));
+	b_ismone = cttk_and(b_ismone, cttk_u64_eq(b[len], M63));
+
+	/*
+	 * Get signs.
+	 */
+	sa = a[len] >> 62;
+	sb = b[len] >> 62;
+
+	/*
+	 * Compute |b| into t2.
+	 */
+	cttk_i63_neg(t2, b);
+	cttk_i63_cond_copy(cttk_u64_eq0(sb), t2, b);
+
+	/*
+	 * Set r to |a| or |a+|b||. t1 is free at that point. r may be
+	 * aliased on a or b, but not on t1.
+	 */
+	cttk_i63_add(t1, a, t2);
+	cttk_i63_cond_copy(cttk_not(a_isminv), t1, a);
+	cttk_i63_neg(r, t1);
+	cttk_i63_cond_copy(cttk_not(cttk_bool_of_u32(
+		(uint32_t)(t1[len] >> 62))), r, t1);
+
+	/*
+	 * Now r is set, and |b|. We "forget" about the true b, and instead
+	 * use |b|.
+	 */
+	b = t2;
+
+	/*
+	 * Compute the division on the positive values. The word-wise
+	 * division destroys its divisor, so we give it a copy in t1.
+	 * That copy must not be zero; if b is zero or MinValue, we use
+	 * 2^(63*len)-1 instead, which is greater than |a|.
+	 */
+	b_bad = cttk_or(b_iszero, b_isminv);
+	for (u = 0; u < len; u ++) {
+		t1[1 + u] = cttk_u64_mux(b_bad, M63, b[1 + u]);
+	}
+	if (q != NULL) {
+		q[0] &= M63;
+		divmod_words(q + 1, r + 1, len, t1 + 1, len, tw);
+	} else {
+		divmod_words(NULL, r + 1, len, t1 + 1, len, tw);
+	}
+
+	/*
+	 * Adjust values and signs. t1 is free.
+	 */
+	if (q != NULL) {
+		int32_t p;
+
+		/*
+		 * If b == MinValue, then we must set q to 0; if
+		 * a == MinValue too, we will add 1 afterwards.
+		 */
+		cttk_i63_set_u32_trunc(t1, 0);
+		cttk_i63_cond_copy(b_isminv, q, t1);
+
+		/*
+		 * We adjust the sign of q: it is negative if the
+		 * signs of a and b differ.
+		 */
+		cttk_i63_neg(t1, q);
+		cttk_i63_cond_copy(cttk_bool_of_u32((uint32_t)(sa ^ sb)), q, t1);
+
+		/*
+		 * If a == MinValue, then there is a +1 or -1 to add
+		 * (after the sign adjustment, see int31.c).
+		 */
+		p = cttk_bool_to_int(a_isminv);
+		cttk_i63_set_s32(t1,
+			cttk_s32_mux(cttk_bool_of_u32((uint32_t)(sa ^ sb)), -p, p));
+		cttk_i63_add(q, q, t1);
+	}
+	cttk_i63_neg(t1, r);
+	cttk_i63_cond_copy(cttk_bool_of_u32((uint32_t)sa), r, t1);
+
+	/*
+	 * Handle the special cases for b == MinValue. In that case,
+	 * the division used a divisor greater than |a|. Thus, if
+	 * a != MinValue, r contains a copy of a at this point (which
+	 * is correct) and we just have to set the quotient to 0.
+	 */
+	cttk_i63_set_u32_trunc(t1, 0);
+	if (q != NULL) {
+		cttk_i63_cond_copy(
+			cttk_and(b_isminv, cttk_not(a_isminv)), q, t1);
+	}
+	cttk_i63_cond_copy(cttk_and(b_isminv, a_isminv), r, t1);
+	if (q != NULL) {
+		cttk_i63_set_u32(t1, 1);
+		cttk_i63_cond_copy(cttk_and(b_isminv, a_isminv), q, t1);
+	}
+
+	/*
+	 * Apply NaN conditions.
+	 */
+	both_nan = cttk_or(cttk_or(a_isnan, b_isnan), b_iszero);
+	half_nan = cttk_and(a_isminv, b_ismone);
+	if (q != NULL) {
+		q[0] |= (uint64_t)cttk_or(both_nan, half_nan).v << 63;
+	}
+	r[0] |= (uint64_t)both_nan.v << 63;
+	cttk_i63_set_u32_trunc(t1, 0);
+	cttk_i63_cond_copy(half_nan, r, t1);
+
+	/*
+	 * Extra step if doing modular reduction: if r < 0, add |b| (which
+	 * is in t2), except when b == MinValue, in which case we flip the
+	 * sign bit of r (see int31.c for details).
+	 */
+	if (mod) {
+		uint64_t sr;
+
+		sr = r[len] >> 62;
+		cttk_i63_add(t1, r, b);
+		cttk_i63_cond_copy(cttk_and(cttk_bool_of_u32((uint32_t)sr),
+			cttk_not(b_isminv)), r, t1);
+		r[len] ^= ((-(sr & b_isminv.v) << hk) & M63);
+	}
+}
+
+/*
+ * Run the division with the provided temporary space; t must have room
+ * for 5*wlen words if r is NULL, 4*wlen words otherwise, where wlen is
+ * the total length (in words, header included) of each operand.
+ */
+static void
+gendiv_buf(uint64_t *q, uint64_t *r,
+	const uint64_t *a, const uint64_t *b, uint64_t *t, int mod)
+{
+	uint64_t h, *t1, *t2;
+	size_t wlen;
+
+	h = a[0] & M63;
+	wlen = (size_t)((h + 127) >> 6);
+	if (r == NULL) {
+		r = t;
+		r[0] = h;
+		t += wlen;
+	}
+	t1 = t;
+	t2 = t + wlen;
+	t1[0] = t2[0] = h;
+	gendiv_inner(q, r, a, b, t1, t2, t2 + wlen, mod);
+}
+
+static void
+gendiv_stack(uint64_t *q, uint64_t *r,
+	const uint64_t *a, const uint64_t *b, int mod)
+{
+	uint64_t t[CTTK_MAX_INT_BUF / sizeof(uint64_t)];
+
+	gendiv_buf(q, r, a, b, t, mod);
+}
+
+/*
+ * Generic division routine. This function assumes that sizes have been
+ * verified to be equal to each other. Either q and r may be NULL, but
+ * not both. Also, q != r.
+ *
+ * If mod is non-zero, then an extra step is applied to ensure a nonnegative
+ * remainder.
+ */
+static void
+gendiv(uint64_t *q, uint64_t *r, const uint64_t *a, const uint64_t *b, int mod)
+{
+	uint64_t h;
+	size_t tlen;
+
+	h = a[0] & M63;
+	tlen = (size_t)((h + 127) >> 6) * (r == NULL ? 5 : 4);
+	if (tlen <= (CTTK_MAX_INT_BUF / sizeof(uint64_t))) {
+		gendiv_stack(q, r, a, b, mod);
+		return;
+	}
+#if !CTTK_NO_MALLOC
+	{
+		uint64_t *t;
+
+		t = cttk_scratch_alloc(tlen * sizeof(uint64_t));
+		if (t != NULL) {
+			gendiv_buf(q, r, a, b, t, mod);
+			free(t);
+			return;
+		}
+	}
+#endif
+
+	/*
+	 * Could not find enough memory for temporaries...
+	 */
+	if (q != NULL) {
+		q[0] |= NAN63;
+	}
+	if (r != NULL) {
+		r[0] |= NAN63;
+	}
+}
+
+/*
+ * Division with a caller-provided temporary of tlen words (sizes have
+ * been verified). If the temporary is too small, then the results are
+ * set to NaN.
+ */
+static void
+gendiv_ws(uint64_t *q, uint64_t *r, const uint64_t *a, const uint64_t *b,
+	int mod, uint64_t *t, size_t tlen)
+{
+	uint64_t h;
+
+	h = a[0] & M63;
+	if (tlen < (size_t)((h + 127) >> 6) * (r == NULL ? 5 : 4)) {
+		if (q != NULL) {
+			q[0] |= NAN63;
+		}
+		if (r != NULL) {
+			r[0] |= NAN63;
+		}
+		return;
+	}
+	gendiv_buf(q, r, a, b, t, mod);
+}
+
+/*
+ * Verify operands for cttk_i63_divrem(). Mismatched recipients are set
+ * to NaN and replaced with NULL. Returned value is 1 if the division
+ * must be performed, 0 otherwise.
+ */
+static int
+divrem_check(uint64_t **qq, uint64_t **rr,
+	const uint64_t *a, const uint64_t *b)
+{
+	uint64_t h, *q, *r;
+
+	q = *qq;
+	r = *rr;
+	h = a[0] & M63;
+	if (h != (b[0] & M63)) {
+		if (q != NULL) {
+			q[0] |= NAN63;
+		}
+		if (r != NULL) {
+			r[0] |= NAN63;
+		}
+		return 0;
+	}
+	if (q != NULL && h != (q[0] & M63)) {
+		q[0] |= NAN63;
+		q = NULL;
+	}
+	if (r != NULL && h != (r[0] & M63)) {
+		r[0] |= NAN63;
+		r = NULL;
+	}
+	if (q == NULL && r == NULL) {
+		return 0;
+	}
+	if (q == r) {
+		q[0] |= NAN63;
+		r[0] |= NAN63;
+		return 0;
+	}
+	*qq = q;
+	*rr = r;
+	return 1;
+}
+
+/* see cttk.h */
+void
+cttk_i63_divrem(uint64_t *q, uint64_t *r, const uint64_t *a, const uint64_t *b)
+{
+	if (divrem_check(&q, &r, a, b)) {
+		gendiv(q, r, a, b, 0);
+	}
+}
+
+/* see cttk.h */
+void
+cttk_i63_divrem_ws(uint64_t *q, uint64_t *r,
+	const uint64_t *a, const uint64_t *b, uint64_t *tmp, size_t tmp_len)
+{
+	if (divrem_check(&q, &r, a, b)) {
+		gendiv_ws(q, r, a, b, 0, tmp, tmp_len);
+	}
+}
+
+/* see cttk.h */
+void
+cttk_i63_mod(uint64_t *d, const uint64_t *a, const uint64_t *b)
+{
+	uint64_t h;
+
+	h = d[0] & M63;
+	if (h != (a[0] & M63) || h != (b[0] & M63)) {
+		d[0] |= NAN63;
+		return;
+	}
+	gendiv(NULL, d, a, b, 1);
+}
+
+/* see cttk.h */
+void
+cttk_i63_mod_ws(uint64_t *d, const uint64_t *a, const uint64_t *b,
+	uint64_t *tmp, size_t tmp_len)
+{
+	uint64_t h;
+
+	h = d[0] & M63;
+	if (h != (a[0] & M63) || h != (b[0] & M63)) {
+		d[0] |= NAN63;
+		return;
+	}
+	gendiv_ws(NULL, d, a, b, 1, tmp, tmp_len);
+}
+
+/* see cttk.h */
+size_t
+cttk_i63_ws_len(unsigned size)
+{
+	uint64_t h;
+	size_t mlen, dlen;
+
+	h = (uint64_t)size + ((uint64_t)size / 63);
+	mlen = genmul_tmp_len(h);
+	dlen = (size_t)((h + 127) >> 6) * 5;
+	return mlen > dlen ? mlen : dlen;
+}
+
+/* see cttk.h */
+void
+cttk_i63_and(uint64_t *d, const uint64_t *a, const uint64_t *b)
+{
+	uint64_t h;
+	size_t len, u;
+
+	h = d[0] & M63;
+	if (h != (a[0] & M63) || h != (b[0] & M63)) {
+		d[0] |= NAN63;
+		return;
+	}
+	len = (size_t)((h + 63) >> 6);
+	d[0] = a[0] | b[0];
+	for (u = 1; u <= len; u ++) {
+		d[u] = a[u] & b[u];
+	}
+}
+
+/* see cttk.h */
+void
+cttk_i63_or(uint64_t *d, const uint64_t *a, const uint64_t *b)
+{
+	uint64_t h;
+	size_t len, u;
+
+	h = d[0] & M63;
+	if (h != (a[0] & M63) || h != (b[0] & M63)) {
+		d[0] |= NAN63;
+		return;
+	}
+	len = (size_t)((h + 63) >> 6);
+	d[0] = a[0] | b[0];
+	for (u = 1; u <= len; u ++) {
+		d[u] = a[u] | b[u];
+	}
+}
+
+/* see cttk.h */
+void
+cttk_i63_xor(uint64_t *d, const uint64_t *a, const uint64_t *b)
+{
+	uint64_t h;
+	size_t len, u;
+
+	h = d[0] & M63;
+	if (h != (a[0] & M63) || h != (b[0] & M63)) {
+		d[0] |= NAN63;
+		return;
+	}
+	len = (size_t)((h + 63) >> 6);
+	d[0] = a[0] | b[0];
+	for (u = 1; u <= len; u ++) {
+		d[u] = a[u] ^ b[u];
+	}
+}
+
+/* see cttk.h */
+void
+cttk_i63_eqv(uint64_t *d, const uint64_t *a, const uint64_t *b)
+{
+	uint64_t h;
+	size_t len, u;
+
+	h = d[0] & M63;
+	if (h != (a[0] & M63) || h != (b[0] & M63)) {
+		d[0] |= NAN63;
+		return;
+	}
+	len = (size_t)((h + 63) >> 6);
+	d[0] = a[0] | b[0];
+	for (u = 1; u <= len; u ++) {
+		d[u] = a[u] ^ b[u] ^ M63;
+	}
+}
+
+/* see cttk.h */
+void
+cttk_i63_not(uint64_t *d, const uint64_t *a)
+{
+	uint64_t h;
+	size_t len, u;
+
+	h = d[0] & M63;
+	if (h != (a[0] & M63)) {
+		d[0] |= NAN63;
+		return;
+	}
+	len = (size_t)((h + 63) >> 6);
+	d[0] = a[0];
+	for (u = 1; u <= len; u ++) {
+		d[u] = a[u] ^ M63;
+	}
+}
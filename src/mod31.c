@@ -0,0 +1,644 @@
+/*
+ * Copyright (c) 2018 Thomas Pornin <pornin@bolet.org>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining 
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be 
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, 
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND 
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "inner.h"
+
+/*
+ * Modular integers use the i31 representation (see int31.c); values
+ * modulo m are nonnegative integers lower than m, with the same size
+ * as m, and are kept in Montgomery representation: value x is stored
+ * as x*R mod m, with R = 2^(31*len), len being the number of value
+ * words of the modulus.
+ *
+ * The modulus context layout is the following (len is the number of
+ * value words of m):
+ *
+ *    mc[0]                 header word of m (NaN flag set if invalid)
+ *    mc[1..len]            value words of m
+ *    mc[len+1]             -1/m mod 2^31
+ *    mc[len+2..2*len+1]    R^2 mod m
+ *
+ * Thus, the context starts with a copy of m, as a normal i31 integer.
+ */
+
+/*
+ * Compute -1/x mod 2^31. x must be odd.
+ */
+static uint32_t
+ninv31(uint32_t x)
+{
+	uint32_t y;
+
+	y = 2 - x;
+	y = mulu32(y, 2 - mulu32(x, y));
+	y = mulu32(y, 2 - mulu32(x, y));
+	y = mulu32(y, 2 - mulu32(x, y));
+	y = mulu32(y, 2 - mulu32(x, y));
+	return -y & 0x7FFFFFFF;
+}
+
+/*
+ * Subtract m from x (len words) if ctl is true, or if x >= m. The
+ * extra carry bit (c, 0 or 1) is the top bit of x: the value to reduce
+ * is x + c*2^(31*len). The result is assumed to fit in len words.
+ */
+static void
+cond_sub(uint32_t *x, uint32_t c, const uint32_t *m, size_t len)
+{
+	size_t u;
+	uint32_t cc, mask;
+
+	cc = 0;
+	for (u = 0; u < len; u ++) {
+		cc = (x[u] - m[u] - cc) >> 31;
+	}
+	mask = -(c | (cc ^ 1)) >> 1;
+	cc = 0;
+	for (u = 0; u < len; u ++) {
+		uint32_t w;
+
+		w = x[u] - (m[u] & mask) - cc;
+		x[u] = w & 0x7FFFFFFF;
+		cc = w >> 31;
+	}
+}
+
+/*
+ * Montgomery multiplication: d <- x*y/R mod m. Arrays have len words
+ * (no header). d must be distinct from x and y. Operands x and y must
+ * be lower than m; the result is lower than m.
+ */
+static void
+montymul(uint32_t *d, const uint32_t *x, const uint32_t *y,
+	const uint32_t *m, uint32_t m0i, size_t len)
+{
+	size_t u, v;
+	uint32_t dh;
+
+	memset(d, 0, len * sizeof *d);
+	dh = 0;
+	for (u = 0; u < len; u ++) {
+		uint32_t xu, f;
+		uint64_t r, zh;
+
+		xu = x[u];
+		f = mulu32(d[0] + mulu32(xu, y[0]), m0i) & 0x7FFFFFFF;
+		r = 0;
+		for (v = 0; v < len; v ++) {
+			uint64_t z;
+
+			z = (uint64_t)d[v] + mulu32w(xu, y[v])
+				+ mulu32w(f, m[v]) + r;
+			r = z >> 31;
+			if (v != 0) {
+				d[v - 1] = (uint32_t)z & 0x7FFFFFFF;
+			}
+		}
+		zh = (uint64_t)dh + r;
+		d[len - 1] = (uint32_t)zh & 0x7FFFFFFF;
+		dh = (uint32_t)(zh >> 31);
+	}
+
+	/*
+	 * The value is lower than 2*m at this point.
+	 */
+	cond_sub(d, dh, m, len);
+}
+
+/*
+ * Montgomery reduction: x <- x/R mod m. Arrays have len words (no
+ * header); x may have any value (lower than R); the result is lower
+ * than m.
+ */
+static void
+montyred(uint32_t *x, const uint32_t *m, uint32_t m0i, size_t len)
+{
+	size_t u, v;
+	uint32_t dh;
+
+	dh = 0;
+	for (u = 0; u < len; u ++) {
+		uint32_t f;
+		uint64_t r, zh;
+
+		f = mulu32(x[0], m0i) & 0x7FFFFFFF;
+		r = 0;
+		for (v = 0; v < len; v ++) {
+			uint64_t z;
+
+			z = (uint64_t)x[v] + mulu32w(f, m[v]) + r;
+			r = z >> 31;
+			if (v != 0) {
+				x[v - 1] = (uint32_t)z & 0x7FFFFFFF;
+			}
+		}
+		zh = (uint64_t)dh + r;
+		x[len - 1] = (uint32_t)zh & 0x7FFFFFFF;
+		dh = (uint32_t)(zh >> 31);
+	}
+	cond_sub(x, dh, m, len);
+}
+
+/* see cttk.h */
+void
+cttk_m31_init(uint32_t *mc, const uint32_t *m)
+{
+	uint32_t h, w;
+	size_t len, u, v;
+	uint32_t *m2, *r2;
+	cttk_bool ok, one;
+
+	h = m[0] & 0x7FFFFFFF;
+	len = (h + 31) >> 5;
+	memmove(mc, m, (len + 1) * sizeof *m);
+	m2 = mc + 1;
+	r2 = mc + len + 2;
+
+	/*
+	 * The modulus must be odd and greater than 1 (this excludes
+	 * negative values).
+	 */
+	ok = cttk_not(cttk_i31_isnan(m));
+	ok = cttk_and(ok, cttk_bool_of_u32(m2[0] & 1));
+	ok = cttk_and(ok, cttk_u32_eq0(m2[len - 1] >> top_index(h)));
+	one = cttk_u32_eq(m2[0], 1);
+	for (u = 1; u < len; u ++) {
+		one = cttk_and(one, cttk_u32_eq0(m2[u]));
+	}
+	ok = cttk_and(ok, cttk_not(one));
+	mc[0] = h | ((ok.v ^ 1) << 31);
+	mc[len + 1] = ninv31(m2[0] | ((ok.v ^ 1)));
+
+	/*
+	 * Compute R^2 mod m by successive doublings, starting from 1.
+	 * If the modulus is invalid, the computed value is meaningless
+	 * (but computed nonetheless).
+	 */
+	memset(r2, 0, len * sizeof *r2);
+	r2[0] = 1;
+	for (v = 62 * len; v > 0; v --) {
+		uint32_t cc;
+
+		cc = 0;
+		for (u = 0; u < len; u ++) {
+			w = (r2[u] << 1) | cc;
+			r2[u] = w & 0x7FFFFFFF;
+			cc = w >> 31;
+		}
+		cond_sub(r2, cc, m2, len);
+	}
+}
+
+/*
+ * Check that d, a and b (b may be NULL) match the modulus size; on
+ * mismatch, d is set to NaN and 0 is returned. On success, the header
+ * of d is set (with the NaN flag set if any operand or the modulus is
+ * NaN), and the number of value words is returned.
+ */
+static size_t
+check_sizes(uint32_t *d, const uint32_t *a, const uint32_t *b,
+	const uint32_t *mc)
+{
+	uint32_t h, nf;
+
+	h = mc[0] & 0x7FFFFFFF;
+	nf = mc[0] | a[0];
+	if (((mc[0] ^ d[0]) << 1) != 0 || ((mc[0] ^ a[0]) << 1) != 0) {
+		d[0] |= 0x80000000;
+		return 0;
+	}
+	if (b != NULL) {
+		if (((mc[0] ^ b[0]) << 1) != 0) {
+			d[0] |= 0x80000000;
+			return 0;
+		}
+		nf |= b[0];
+	}
+	d[0] = h | (nf & 0x80000000);
+	return (h + 31) >> 5;
+}
+
+/*
+ * Montgomery multiplication with a temporary buffer for the output, so
+ * that the value words of d may alias a and/or b. Here, d is a complete
+ * integer (with header), while a and b point to value words only. The
+ * header of d is not modified, unless no temporary buffer could be
+ * obtained, in which case d is set to NaN.
+ */
+static void
+montymul_tmp(uint32_t *d, const uint32_t *a, const uint32_t *b,
+	const uint32_t *mc, size_t len)
+{
+	if (len <= (CTTK_MAX_INT_BUF / sizeof(uint32_t))) {
+		uint32_t t[CTTK_MAX_INT_BUF / sizeof(uint32_t)];
+
+		montymul(t, a, b, mc + 1, mc[len + 1], len);
+		memcpy(d + 1, t, len * sizeof *d);
+		return;
+	}
+#if !CTTK_NO_MALLOC
+	{
+		uint32_t *t;
+
+		t = cttk_scratch_alloc(len * sizeof *t);
+		if (t != NULL) {
+			montymul(t, a, b, mc + 1, mc[len + 1], len);
+			memcpy(d + 1, t, len * sizeof *d);
+			free(t);
+			return;
+		}
+	}
+#endif
+	d[0] |= 0x80000000;
+}
+
+/* see cttk.h */
+void
+cttk_m31_encode(uint32_t *d, const uint32_t *a, const uint32_t *mc)
+{
+	size_t len, u;
+	uint32_t s, cc;
+	cttk_bool z;
+
+	len = check_sizes(d, a, NULL, mc);
+	if (len == 0) {
+		return;
+	}
+
+	/*
+	 * We get |a| (as an unsigned integer over len words, which always
+	 * fits, even for MinValue), then compute |a|*R^2/R = |a|*R mod m,
+	 * and finally negate modulo m if a < 0.
+	 */
+	s = -(a[len] >> 30) >> 1;
+	cc = s & 1;
+	for (u = 0; u < len; u ++) {
+		uint32_t w;
+
+		w = (a[1 + u] ^ s) + cc;
+		d[1 + u] = w & 0x7FFFFFFF;
+		cc = w >> 31;
+	}
+	montymul_tmp(d, d + 1, mc + len + 2, mc, len);
+	z = cttk_true;
+	for (u = 0; u < len; u ++) {
+		z = cttk_and(z, cttk_u32_eq0(d[1 + u]));
+	}
+	s &= (uint32_t)(z.v - 1);
+	cc = 0;
+	for (u = 0; u < len; u ++) {
+		uint32_t w, x;
+
+		x = d[1 + u];
+		w = mc[1 + u] - x - cc;
+		cc = w >> 31;
+		d[1 + u] = x ^ ((x ^ w) & s);
+	}
+}
+
+/* see cttk.h */
+void
+cttk_m31_decode(uint32_t *d, const uint32_t *a, const uint32_t *mc)
+{
+	size_t len;
+
+	len = check_sizes(d, a, NULL, mc);
+	if (len == 0) {
+		return;
+	}
+	memmove(d + 1, a + 1, len * sizeof *a);
+	montyred(d + 1, mc + 1, mc[len + 1], len);
+}
+
+/* see cttk.h */
+void
+cttk_m31_add(uint32_t *d, const uint32_t *a, const uint32_t *b,
+	const uint32_t *mc)
+{
+	size_t len, u;
+	uint32_t cc;
+
+	len = check_sizes(d, a, b, mc);
+	if (len == 0) {
+		return;
+	}
+	cc = 0;
+	for (u = 0; u < len; u ++) {
+		uint32_t w;
+
+		w = a[1 + u] + b[1 + u] + cc;
+		d[1 + u] = w & 0x7FFFFFFF;
+		cc = w >> 31;
+	}
+	cond_sub(d + 1, cc, mc + 1, len);
+}
+
+/* see cttk.h */
+void
+cttk_m31_sub(uint32_t *d, const uint32_t *a, const uint32_t *b,
+	const uint32_t *mc)
+{
+	size_t len, u;
+	uint32_t cc, mask;
+
+	len = check_sizes(d, a, b, mc);
+	if (len == 0) {
+		return;
+	}
+	cc = 0;
+	for (u = 0; u < len; u ++) {
+		uint32_t w;
+
+		w = a[1 + u] - b[1 + u] - cc;
+		d[1 + u] = w & 0x7FFFFFFF;
+		cc = w >> 31;
+	}
+	mask = -cc >> 1;
+	cc = 0;
+	for (u = 0; u < len; u ++) {
+		uint32_t w;
+
+		w = d[1 + u] + (mc[1 + u] & mask) + cc;
+		d[1 + u] = w & 0x7FFFFFFF;
+		cc = w >> 31;
+	}
+}
+
+/* see cttk.h */
+void
+cttk_m31_neg(uint32_t *d, const uint32_t *a, const uint32_t *mc)
+{
+	size_t len, u;
+	uint32_t cc, mask;
+
+	len = check_sizes(d, a, NULL, mc);
+	if (len == 0) {
+		return;
+	}
+
+	/*
+	 * Result is m-a, except when a = 0, in which case it is 0.
+	 */
+	mask = 0;
+	for (u = 0; u < len; u ++) {
+		mask |= a[1 + u];
+	}
+	mask = -cttk_u32_neq0(mask).v >> 1;
+	cc = 0;
+	for (u = 0; u < len; u ++) {
+		uint32_t w;
+
+		w = mc[1 + u] - a[1 + u] - cc;
+		cc = w >> 31;
+		d[1 + u] = w & mask;
+	}
+}
+
+/* see cttk.h */
+void
+cttk_m31_mul(uint32_t *d, const uint32_t *a, const uint32_t *b,
+	const uint32_t *mc)
+{
+	size_t len;
+
+	len = check_sizes(d, a, b, mc);
+	if (len == 0) {
+		return;
+	}
+	montymul_tmp(d, a + 1, b + 1, mc, len);
+}
+
+/* see cttk.h */
+void
+cttk_m31_sqr(uint32_t *d, const uint32_t *a, const uint32_t *mc)
+{
+	size_t len;
+
+	len = check_sizes(d, a, NULL, mc);
+	if (len == 0) {
+		return;
+	}
+	montymul_tmp(d, a + 1, a + 1, mc, len);
+}
+
+/*
+ * Modular exponentiation uses a fixed window: the exponent is split
+ * into chunks of POW_WINDOW bits, and each chunk implies POW_WINDOW
+ * squarings and one multiplication by a value looked up in a table of
+ * 2^POW_WINDOW precomputed powers. The lookup reads all table entries
+ * (with cttk_array_read(), which uses the vector code when available).
+ * If there is not enough room for the full table, a smaller window
+ * is used.
+ */
+#define POW_WINDOW   4
+
+/*
+ * Get n bits (n <= 31) from the exponent, starting at bit position
+ * off (counted from the least significant bit). The exponent is
+ * either given as i31 value words (ew, ewlen words), or as an unsigned
+ * big-endian sequence of bytes (eb, eblen bytes); exactly one of ew
+ * and eb is non-NULL. Bits beyond the exponent end are zero. Only the
+ * bit position may leak, not the value.
+ */
+static uint32_t
+get_ebits(const uint32_t *ew, size_t ewlen,
+	const unsigned char *eb, size_t eblen, size_t off, int n)
+{
+	uint32_t x;
+	size_t k;
+	int i;
+
+	x = 0;
+	if (ew != NULL) {
+		k = off / 31;
+		i = (int)(off % 31);
+		if (k < ewlen) {
+			x = ew[k] >> i;
+		}
+		if (i + n > 31 && k + 1 < ewlen) {
+			x |= ew[k + 1] << (31 - i);
+		}
+	} else {
+		uint64_t acc;
+
+		acc = 0;
+		k = off >> 3;
+		for (i = 0; i < n + (int)(off & 7); i += 8, k ++) {
+			if (k < eblen) {
+				acc |= (uint64_t)eb[eblen - 1 - k] << i;
+			}
+		}
+		x = (uint32_t)(acc >> (off & 7));
+	}
+	return x & (((uint32_t)1 << n) - 1);
+}
+
+/*
+ * Exponentiation core: x <- a^e mod m, with x and a being value words
+ * (len words, Montgomery representation). The exponent has ebits bits
+ * (see get_ebits() for the exponent parameters). The temporary t must
+ * have room for ((1 << win) + 3) * len words. x may overlap with a and
+ * with the exponent.
+ */
+static void
+modpow_inner(uint32_t *x, const uint32_t *a,
+	const uint32_t *ew, size_t ewlen, const unsigned char *eb, size_t eblen,
+	size_t ebits, const uint32_t *mc, size_t len, int win, uint32_t *t)
+{
+	const uint32_t *m;
+	uint32_t m0i, num, u;
+	uint32_t *tab, *t1, *t2, *t3;
+	size_t k, nw;
+	int i;
+
+	m = mc + 1;
+	m0i = mc[len + 1];
+	num = (uint32_t)1 << win;
+	tab = t;
+	t1 = tab + ((size_t)num * len);
+	t2 = t1 + len;
+	t3 = t2 + len;
+
+	/*
+	 * Table entry i contains a^i (in Montgomery representation).
+	 * Entry 0 is 1, i.e. R mod m, obtained by reducing R^2.
+	 */
+	memcpy(tab, mc + len + 2, len * sizeof *tab);
+	montyred(tab, m, m0i, len);
+	memcpy(tab + len, a, len * sizeof *a);
+	for (u = 2; u < num; u ++) {
+		montymul(tab + (size_t)u * len,
+			tab + (size_t)(u - 1) * len, a, m, m0i, len);
+	}
+
+	/*
+	 * Process windows from the top. The first window is simply
+	 * looked up.
+	 */
+	nw = (ebits + (size_t)win - 1) / (size_t)win;
+	if (nw == 0) {
+		memcpy(x, tab, len * sizeof *x);
+		return;
+	}
+	k = nw - 1;
+	cttk_array_read(t1, tab, len * sizeof *tab, num,
+		get_ebits(ew, ewlen, eb, eblen, k * (size_t)win, win));
+	while (k -- > 0) {
+		for (i = 0; i < win; i ++) {
+			montymul(t2, t1, t1, m, m0i, len);
+			memcpy(t1, t2, len * sizeof *t1);
+		}
+		cttk_array_read(t2, tab, len * sizeof *tab, num,
+			get_ebits(ew, ewlen, eb, eblen, k * (size_t)win, win));
+		montymul(t3, t1, t2, m, m0i, len);
+		memcpy(t1, t3, len * sizeof *t1);
+	}
+	memcpy(x, t1, len * sizeof *x);
+}
+
+/*
+ * Exponentiation wrapper with temporary buffer management. The header
+ * of d must already be set. If possible, the full window is used, with
+ * a stack buffer or a dynamically allocated buffer; otherwise, the
+ * largest window that fits in a stack buffer is used. If none fits,
+ * then d is set to NaN.
+ */
+static void
+modpow_tmp(uint32_t *d, const uint32_t *a,
+	const uint32_t *ew, size_t ewlen, const unsigned char *eb, size_t eblen,
+	size_t ebits, const uint32_t *mc, size_t len)
+{
+	uint32_t t[CTTK_MAX_INT_BUF / sizeof(uint32_t)];
+	int win;
+
+	if ((((size_t)1 << POW_WINDOW) + 3) * len
+		<= (sizeof t) / sizeof t[0])
+	{
+		modpow_inner(d + 1, a + 1, ew, ewlen, eb, eblen, ebits,
+			mc, len, POW_WINDOW, t);
+		return;
+	}
+#if !CTTK_NO_MALLOC
+	{
+		uint32_t *tt;
+
+		tt = cttk_scratch_alloc((((size_t)1 << POW_WINDOW) + 3)
+			* len * sizeof *tt);
+		if (tt != NULL) {
+			modpow_inner(d + 1, a + 1, ew, ewlen, eb, eblen, ebits,
+				mc, len, POW_WINDOW, tt);
+			free(tt);
+			return;
+		}
+	}
+#endif
+	for (win = POW_WINDOW - 1; win > 0; win --) {
+		if ((((size_t)1 << win) + 3) * len
+			<= (sizeof t) / sizeof t[0])
+		{
+			modpow_inner(d + 1, a + 1, ew, ewlen, eb, eblen, ebits,
+				mc, len, win, t);
+			return;
+		}
+	}
+	d[0] |= 0x80000000;
+}
+
+/* see cttk.h */
+void
+cttk_m31_pow(uint32_t *d, const uint32_t *a, const uint32_t *e,
+	const uint32_t *mc)
+{
+	size_t len, elen;
+	uint32_t eh;
+
+	len = check_sizes(d, a, NULL, mc);
+	if (len == 0) {
+		return;
+	}
+
+	/*
+	 * A negative or NaN exponent yields a NaN. The exponent sign
+	 * bit is the top bit of the top word, which is then ignored.
+	 */
+	eh = e[0] & 0x7FFFFFFF;
+	elen = (eh + 31) >> 5;
+	d[0] |= (e[0] | (e[elen] << (31 - top_index(eh)))) & 0x80000000;
+	modpow_tmp(d, a, e + 1, elen, NULL, 0,
+		(size_t)(eh - (eh >> 5)) - 1, mc, len);
+}
+
+/* see cttk.h */
+void
+cttk_m31_pow_be(uint32_t *d, const uint32_t *a,
+	const void *e, size_t elen, const uint32_t *mc)
+{
+	size_t len;
+
+	len = check_sizes(d, a, NULL, mc);
+	if (len == 0) {
+		return;
+	}
+	modpow_tmp(d, a, NULL, 0, e, elen, elen << 3, mc, len);
+}
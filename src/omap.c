@@ -0,0 +1,361 @@
+/*
+ * Copyright (c) 2018 Thomas Pornin <pornin@bolet.org>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining 
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be 
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, 
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND 
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "inner.h"
+
+/*
+ * Oblivious map. Entries are stored in buckets of OMAP_SLOTS slots; each
+ * key is mapped to two buckets with a keyed hash function (SipHash-2-4,
+ * with a random secret key), and is stored in one of them (two-choice
+ * hashing: new keys go into the least loaded bucket). The buckets are
+ * the elements of a Path ORAM, so that the accessed bucket indices are
+ * protected. Within a bucket, all slots are processed with masking and
+ * conditional copies.
+ *
+ * Slot layout: one "used" byte (0x00 or 0x01), then the key, then the
+ * value.
+ *
+ * The number of buckets is chosen so that the full map (num entries)
+ * uses at most half of the slots; with two-choice hashing, the
+ * probability that an insertion fails because both buckets are full
+ * is then negligible.
+ */
+
+#define OMAP_SLOTS   8
+
+/*
+ * SipHash-2-4 (Aumasson and Bernstein), returning the 64-bit output.
+ */
+#define ROTL64(x, n)   (((x) << (n)) | ((x) >> (64 - (n))))
+
+#define SIPROUND   do { \
+		v0 += v1; v1 = ROTL64(v1, 13); v1 ^= v0; v0 = ROTL64(v0, 32); \
+		v2 += v3; v3 = ROTL64(v3, 16); v3 ^= v2; \
+		v0 += v3; v3 = ROTL64(v3, 21); v3 ^= v0; \
+		v2 += v1; v1 = ROTL64(v1, 17); v1 ^= v2; v2 = ROTL64(v2, 32); \
+	} while (0)
+
+static uint64_t
+siphash(uint64_t k0, uint64_t k1, const unsigned char *buf, size_t len)
+{
+	uint64_t v0, v1, v2, v3, m;
+	size_t u;
+	int i;
+
+	v0 = k0 ^ (uint64_t)0x736F6D6570736575;
+	v1 = k1 ^ (uint64_t)0x646F72616E646F6D;
+	v2 = k0 ^ (uint64_t)0x6C7967656E657261;
+	v3 = k1 ^ (uint64_t)0x7465646279746573;
+	for (u = 0; (u + 8) <= len; u += 8) {
+		m = (uint64_t)buf[u]
+			| ((uint64_t)buf[u + 1] << 8)
+			| ((uint64_t)buf[u + 2] << 16)
+			| ((uint64_t)buf[u + 3] << 24)
+			| ((uint64_t)buf[u + 4] << 32)
+			| ((uint64_t)buf[u + 5] << 40)
+			| ((uint64_t)buf[u + 6] << 48)
+			| ((uint64_t)buf[u + 7] << 56);
+		v3 ^= m;
+		SIPROUND;
+		SIPROUND;
+		v0 ^= m;
+	}
+	m = (uint64_t)len << 56;
+	for (i = 0; u < len; u ++, i ++) {
+		m |= (uint64_t)buf[u] << (i << 3);
+	}
+	v3 ^= m;
+	SIPROUND;
+	SIPROUND;
+	v0 ^= m;
+	v2 ^= 0xFF;
+	SIPROUND;
+	SIPROUND;
+	SIPROUND;
+	SIPROUND;
+	return v0 ^ v1 ^ v2 ^ v3;
+}
+
+/*
+ * Get the bucket count for the provided map capacity, or 0 if not
+ * supported.
+ */
+static size_t
+bucket_count(size_t num)
+{
+	size_t nb;
+
+	if (num == 0 || num > ((size_t)0x7FFFFFFF / 2) * OMAP_SLOTS) {
+		return 0;
+	}
+	nb = (num + (OMAP_SLOTS >> 1) - 1) / (OMAP_SLOTS >> 1);
+	return nb < 2 ? 2 : nb;
+}
+
+/*
+ * Get the bucket length, or 0 if it would not fit in a size_t.
+ */
+static size_t
+bucket_len(size_t key_len, size_t val_len)
+{
+	if (key_len == 0 || key_len > ((size_t)-1 >> 8)
+		|| val_len > ((size_t)-1 >> 8)
+		|| (1 + key_len + val_len) > (size_t)-1 / OMAP_SLOTS)
+	{
+		return 0;
+	}
+	return OMAP_SLOTS * (1 + key_len + val_len);
+}
+
+/* see cttk.h */
+size_t
+cttk_omap_mem_len(size_t key_len, size_t val_len, size_t num)
+{
+	size_t blen, nb, olen, extra;
+
+	blen = bucket_len(key_len, val_len);
+	nb = bucket_count(num);
+	if (blen == 0 || nb == 0) {
+		return 0;
+	}
+	olen = cttk_oram_mem_len(blen, nb);
+	if (olen == 0) {
+		return 0;
+	}
+
+	/*
+	 * Extra space: two bucket buffers, and an all-zero slot.
+	 */
+	extra = 2 * blen + (blen / OMAP_SLOTS);
+	if (extra > (size_t)-1 - olen) {
+		return 0;
+	}
+	return olen + extra;
+}
+
+/* see cttk.h */
+int
+cttk_omap_init(cttk_omap *m, void *mem, size_t mem_len,
+	size_t key_len, size_t val_len, size_t num,
+	void (*rng)(void *rng_ctx, void *dst, size_t len), void *rng_ctx)
+{
+	unsigned char *buf, tmp[16];
+	size_t total, blen, nb, olen;
+
+	total = cttk_omap_mem_len(key_len, val_len, num);
+	if (total == 0 || mem_len < total || rng == NULL) {
+		return 0;
+	}
+	blen = bucket_len(key_len, val_len);
+	nb = bucket_count(num);
+	olen = cttk_oram_mem_len(blen, nb);
+	if (!cttk_oram_init(&m->oram, mem, olen, blen, nb, rng, rng_ctx)) {
+		return 0;
+	}
+	buf = (unsigned char *)mem + olen;
+	m->buf1 = buf;
+	m->buf2 = buf + blen;
+	m->zero = buf + 2 * blen;
+	memset(buf, 0, total - olen);
+	m->key_len = key_len;
+	m->val_len = val_len;
+	m->num_buckets = nb;
+	rng(rng_ctx, tmp, sizeof tmp);
+	memcpy(&m->k0, tmp, 8);
+	memcpy(&m->k1, tmp + 8, 8);
+	return 1;
+}
+
+/*
+ * Compute the two bucket indices for a key; they are always distinct.
+ * Reduction to the bucket range uses a multiplication (not a division,
+ * which is not constant-time on many CPUs).
+ */
+static void
+get_buckets(const cttk_omap *m, const void *key, size_t *b1, size_t *b2)
+{
+	uint64_t h;
+	uint32_t nb, x1, x2;
+
+	h = siphash(m->k0, m->k1, key, m->key_len);
+	nb = (uint32_t)m->num_buckets;
+	x1 = (uint32_t)(mulu32w((uint32_t)h, nb) >> 32);
+	x2 = (uint32_t)(mulu32w((uint32_t)(h >> 32), nb - 1) >> 32);
+
+	/*
+	 * x2 is in 0..nb-2; skipping x1 yields a distinct index.
+	 */
+	x2 += cttk_u32_geq(x2, x1).v;
+	*b1 = x1;
+	*b2 = x2;
+}
+
+/*
+ * Read the two buckets for a key into buf1 and buf2.
+ */
+static cttk_bool
+read_buckets(cttk_omap *m, const void *key, size_t *b1, size_t *b2)
+{
+	cttk_bool r1, r2;
+
+	get_buckets(m, key, b1, b2);
+	r1 = cttk_oram_read(&m->oram, m->buf1, *b1);
+	r2 = cttk_oram_read(&m->oram, m->buf2, *b2);
+	return cttk_and(r1, r2);
+}
+
+static cttk_bool
+write_buckets(cttk_omap *m, size_t b1, size_t b2)
+{
+	cttk_bool r1, r2;
+
+	r1 = cttk_oram_write(&m->oram, b1, m->buf1);
+	r2 = cttk_oram_write(&m->oram, b2, m->buf2);
+	return cttk_and(r1, r2);
+}
+
+/*
+ * Get the slot length.
+ */
+static inline size_t
+slot_len(const cttk_omap *m)
+{
+	return 1 + m->key_len + m->val_len;
+}
+
+/*
+ * Test whether a slot is used and contains the provided key.
+ */
+static inline cttk_bool
+slot_match(const cttk_omap *m, const unsigned char *s, const void *key)
+{
+	return cttk_and(cttk_u32_neq0(s[0]),
+		cttk_array_eq(s + 1, key, m->key_len));
+}
+
+/* see cttk.h */
+cttk_bool
+cttk_omap_lookup(cttk_omap *m, const void *key, void *val)
+{
+	size_t b1, b2, slen, u;
+	cttk_bool ok, found;
+
+	ok = read_buckets(m, key, &b1, &b2);
+	slen = slot_len(m);
+	memset(val, 0, m->val_len);
+	found = cttk_false;
+	for (u = 0; u < (OMAP_SLOTS << 1); u ++) {
+		unsigned char *s;
+		cttk_bool hit;
+
+		s = (u < OMAP_SLOTS ? m->buf1 : m->buf2)
+			+ (u % OMAP_SLOTS) * slen;
+		hit = slot_match(m, s, key);
+		cttk_cond_copy(hit, val, s + 1 + m->key_len, m->val_len);
+		found = cttk_or(found, hit);
+	}
+	return cttk_and(ok, found);
+}
+
+/* see cttk.h */
+cttk_bool
+cttk_omap_insert(cttk_omap *m, const void *key, const void *val)
+{
+	size_t b1, b2, slen, u;
+	uint32_t n1, n2;
+	cttk_bool ok, found, second, done;
+
+	ok = read_buckets(m, key, &b1, &b2);
+	slen = slot_len(m);
+
+	/*
+	 * If the key is already present, replace the value. We also
+	 * count the used slots in each bucket.
+	 */
+	found = cttk_false;
+	n1 = 0;
+	n2 = 0;
+	for (u = 0; u < (OMAP_SLOTS << 1); u ++) {
+		unsigned char *s;
+		cttk_bool hit;
+
+		s = (u < OMAP_SLOTS ? m->buf1 : m->buf2)
+			+ (u % OMAP_SLOTS) * slen;
+		hit = slot_match(m, s, key);
+		cttk_cond_copy(hit, s + 1 + m->key_len, val, m->val_len);
+		found = cttk_or(found, hit);
+		if (u < OMAP_SLOTS) {
+			n1 += s[0];
+		} else {
+			n2 += s[0];
+		}
+	}
+
+	/*
+	 * Otherwise, add the entry into the first free slot of the
+	 * least loaded bucket.
+	 */
+	second = cttk_u32_lt(n2, n1);
+	done = found;
+	for (u = 0; u < (OMAP_SLOTS << 1); u ++) {
+		unsigned char *s;
+		cttk_bool put;
+
+		s = (u < OMAP_SLOTS ? m->buf1 : m->buf2)
+			+ (u % OMAP_SLOTS) * slen;
+		put = cttk_and(cttk_not(done), cttk_u32_eq0(s[0]));
+		put = cttk_and(put, u < OMAP_SLOTS ? cttk_not(second) : second);
+		s[0] |= (unsigned char)put.v;
+		cttk_cond_copy(put, s + 1, key, m->key_len);
+		cttk_cond_copy(put, s + 1 + m->key_len, val, m->val_len);
+		done = cttk_or(done, put);
+	}
+
+	ok = cttk_and(ok, write_buckets(m, b1, b2));
+	return cttk_and(ok, done);
+}
+
+/* see cttk.h */
+cttk_bool
+cttk_omap_delete(cttk_omap *m, const void *key)
+{
+	size_t b1, b2, slen, u;
+	cttk_bool ok, found;
+
+	ok = read_buckets(m, key, &b1, &b2);
+	slen = slot_len(m);
+	found = cttk_false;
+	for (u = 0; u < (OMAP_SLOTS << 1); u ++) {
+		unsigned char *s;
+		cttk_bool hit;
+
+		s = (u < OMAP_SLOTS ? m->buf1 : m->buf2)
+			+ (u % OMAP_SLOTS) * slen;
+		hit = slot_match(m, s, key);
+		cttk_cond_copy(hit, s, m->zero, slen);
+		found = cttk_or(found, hit);
+	}
+	ok = cttk_and(ok, write_buckets(m, b1, b2));
+	return cttk_and(ok, found);
+}
@@ -24,29 +24,758 @@
 
 #include "inner.h"
 
+/*
+ * Conditional copy and swap, and buffer comparisons, are implemented
+ * with several code paths:
+ *
+ *  - A portable path that processes data by 64-bit words (with byte
+ *    accesses only for the unaligned head and tail).
+ *
+ *  - Vector paths (SSE2, AVX2) that process 16 or 32 bytes at a
+ *    time, with unaligned loads and stores.
+ *
+ * Copy and swap use the same masking technique in all paths
+ * (d ^= (s ^ d) & m, where m is all-zeros or all-ones); comparisons
+ * process the whole buffers and merge per-chunk results with masks.
+ * Which path is used, and the sequence of memory accesses, depend only
+ * on the buffer addresses and lengths, not on the data or the control
+ * value. The vector path is chosen once, on first use, depending on
+ * what the CPU supports.
+ *
+ * Copy supports overlapping buffers: if dst <= src, then data is
+ * processed in ascending address order, otherwise in descending order.
+ * Each chunk (byte, word or vector) is fully read before being written,
+ * which makes the copy correct in all cases of overlap.
+ */
+
+/*
+ * Load and store 64-bit words with no alignment requirement. With
+ * usual compilers, these calls are inlined into plain accesses.
+ */
+static inline uint64_t
+ld64(const void *src)
+{
+	uint64_t x;
+
+	memcpy(&x, src, sizeof x);
+	return x;
+}
+
+static inline void
+st64(void *dst, uint64_t x)
+{
+	memcpy(dst, &x, sizeof x);
+}
+
+/*
+ * Load a 64-bit word with big-endian convention (no alignment
+ * requirement).
+ */
+static inline uint64_t
+ld64be(const unsigned char *src)
+{
+#if defined __GNUC__ && defined __BYTE_ORDER__ \
+	&& __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+	return __builtin_bswap64(ld64(src));
+#elif defined __GNUC__ && defined __BYTE_ORDER__ \
+	&& __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+	return ld64(src);
+#else
+	return ((uint64_t)src[0] << 56) | ((uint64_t)src[1] << 48)
+		| ((uint64_t)src[2] << 40) | ((uint64_t)src[3] << 32)
+		| ((uint64_t)src[4] << 24) | ((uint64_t)src[5] << 16)
+		| ((uint64_t)src[6] << 8) | (uint64_t)src[7];
+#endif
+}
+
+/*
+ * Byte-wise conditional copy. m is 0x00 or 0xFF.
+ */
+static void
+cond_copy_bytes(unsigned m, unsigned char *d,
+	const unsigned char *s, size_t len)
+{
+	size_t u;
+
+	if ((uintptr_t)d <= (uintptr_t)s) {
+		for (u = 0; u < len; u ++) {
+			d[u] ^= (s[u] ^ d[u]) & m;
+		}
+	} else {
+		for (u = len; u -- > 0;) {
+			d[u] ^= (s[u] ^ d[u]) & m;
+		}
+	}
+}
+
+/*
+ * Word-wise conditional copy. m is 0 or 0xFFFFFFFF. Words are aligned
+ * on the destination.
+ */
+static void
+cond_copy_words(uint32_t m, unsigned char *d,
+	const unsigned char *s, size_t len)
+{
+	uint64_t wm;
+	size_t head, nw, u;
+
+	wm = (uint64_t)m | ((uint64_t)m << 32);
+	head = (size_t)(-(uintptr_t)d & 7);
+	if (head > len) {
+		head = len;
+	}
+	nw = (len - head) >> 3;
+	if ((uintptr_t)d <= (uintptr_t)s) {
+		cond_copy_bytes(m & 0xFF, d, s, head);
+		for (u = head; u < head + (nw << 3); u += 8) {
+			uint64_t x, y;
+
+			x = ld64(d + u);
+			y = ld64(s + u);
+			st64(d + u, x ^ ((x ^ y) & wm));
+		}
+		cond_copy_bytes(m & 0xFF, d + u, s + u, len - u);
+	} else {
+		u = head + (nw << 3);
+		cond_copy_bytes(m & 0xFF, d + u, s + u, len - u);
+		while (u > head) {
+			uint64_t x, y;
+
+			u -= 8;
+			x = ld64(d + u);
+			y = ld64(s + u);
+			st64(d + u, x ^ ((x ^ y) & wm));
+		}
+		cond_copy_bytes(m & 0xFF, d, s, head);
+	}
+}
+
+/*
+ * Word-wise conditional swap. m is 0 or 0xFFFFFFFF.
+ */
+static void
+cond_swap_words(uint32_t m, unsigned char *a, unsigned char *b, size_t len)
+{
+	uint64_t wm;
+	size_t u;
+
+	wm = (uint64_t)m | ((uint64_t)m << 32);
+	for (u = 0; (u + 8) <= len; u += 8) {
+		uint64_t x, y, t;
+
+		x = ld64(a + u);
+		y = ld64(b + u);
+		t = (x ^ y) & wm;
+		st64(a + u, x ^ t);
+		st64(b + u, y ^ t);
+	}
+	for (; u < len; u ++) {
+		unsigned t;
+
+		t = (a[u] ^ b[u]) & m & 0xFF;
+		a[u] ^= t;
+		b[u] ^= t;
+	}
+}
+
+/*
+ * Batch kernels for cttk_array_read_many() and cttk_array_write_many().
+ * They process num source buffers of len bytes each, located at s,
+ * s + stride, s + 2*stride... and a destination buffer d; m[] contains
+ * one mask (0 or 0xFFFFFFFF) per source buffer. The "or" kernel ORs
+ * into d the sources whose mask is set; the "blend" kernel copies them
+ * into d, in order (the last selected source wins). Each destination
+ * chunk is kept in a register over all sources.
+ */
+static void
+many_or_words(unsigned char *d, const unsigned char *s, size_t stride,
+	const uint32_t *m, size_t num, size_t len)
+{
+	size_t u, j;
+
+	for (u = 0; (u + 8) <= len; u += 8) {
+		uint64_t x;
+
+		x = ld64(d + u);
+		for (j = 0; j < num; j ++) {
+			x |= ld64(s + j * stride + u)
+				& ((uint64_t)m[j] | ((uint64_t)m[j] << 32));
+		}
+		st64(d + u, x);
+	}
+	for (; u < len; u ++) {
+		unsigned x;
+
+		x = d[u];
+		for (j = 0; j < num; j ++) {
+			x |= s[j * stride + u] & m[j];
+		}
+		d[u] = x & 0xFF;
+	}
+}
+
+static void
+many_blend_words(unsigned char *d, const unsigned char *s, size_t stride,
+	const uint32_t *m, size_t num, size_t len)
+{
+	size_t u, j;
+
+	for (u = 0; (u + 8) <= len; u += 8) {
+		uint64_t x;
+
+		x = ld64(d + u);
+		for (j = 0; j < num; j ++) {
+			x ^= (x ^ ld64(s + j * stride + u))
+				& ((uint64_t)m[j] | ((uint64_t)m[j] << 32));
+		}
+		st64(d + u, x);
+	}
+	for (; u < len; u ++) {
+		unsigned x;
+
+		x = d[u];
+		for (j = 0; j < num; j ++) {
+			x ^= (x ^ s[j * stride + u]) & m[j];
+		}
+		d[u] = x & 0xFF;
+	}
+}
+
+#if CTTK_SSE2
+
+static void
+cond_copy_sse2(uint32_t m, unsigned char *d,
+	const unsigned char *s, size_t len)
+{
+	__m128i vm;
+	size_t u;
+
+	vm = _mm_set1_epi32((int)m);
+	if ((uintptr_t)d <= (uintptr_t)s) {
+		for (u = 0; (u + 16) <= len; u += 16) {
+			__m128i x, y;
+
+			x = _mm_loadu_si128((const __m128i *)(d + u));
+			y = _mm_loadu_si128((const __m128i *)(s + u));
+			x = _mm_xor_si128(x, _mm_and_si128(
+				_mm_xor_si128(x, y), vm));
+			_mm_storeu_si128((__m128i *)(d + u), x);
+		}
+		cond_copy_words(m, d + u, s + u, len - u);
+	} else {
+		for (u = len; u >= 16; u -= 16) {
+			__m128i x, y;
+
+			x = _mm_loadu_si128((const __m128i *)(d + u - 16));
+			y = _mm_loadu_si128((const __m128i *)(s + u - 16));
+			x = _mm_xor_si128(x, _mm_and_si128(
+				_mm_xor_si128(x, y), vm));
+			_mm_storeu_si128((__m128i *)(d + u - 16), x);
+		}
+		cond_copy_words(m, d, s, u);
+	}
+}
+
+static void
+cond_swap_sse2(uint32_t m, unsigned char *a, unsigned char *b, size_t len)
+{
+	__m128i vm;
+	size_t u;
+
+	vm = _mm_set1_epi32((int)m);
+	for (u = 0; (u + 16) <= len; u += 16) {
+		__m128i x, y, t;
+
+		x = _mm_loadu_si128((const __m128i *)(a + u));
+		y = _mm_loadu_si128((const __m128i *)(b + u));
+		t = _mm_and_si128(_mm_xor_si128(x, y), vm);
+		_mm_storeu_si128((__m128i *)(a + u), _mm_xor_si128(x, t));
+		_mm_storeu_si128((__m128i *)(b + u), _mm_xor_si128(y, t));
+	}
+	cond_swap_words(m, a + u, b + u, len - u);
+}
+
+static void
+many_or_sse2(unsigned char *d, const unsigned char *s, size_t stride,
+	const uint32_t *m, size_t num, size_t len)
+{
+	size_t u, j;
+
+	for (u = 0; (u + 16) <= len; u += 16) {
+		__m128i x;
+
+		x = _mm_loadu_si128((const __m128i *)(d + u));
+		for (j = 0; j < num; j ++) {
+			x = _mm_or_si128(x, _mm_and_si128(_mm_loadu_si128(
+				(const __m128i *)(s + j * stride + u)),
+				_mm_set1_epi32((int)m[j])));
+		}
+		_mm_storeu_si128((__m128i *)(d + u), x);
+	}
+	many_or_words(d + u, s + u, stride, m, num, len - u);
+}
+
+static void
+many_blend_sse2(unsigned char *d, const unsigned char *s, size_t stride,
+	const uint32_t *m, size_t num, size_t len)
+{
+	size_t u, j;
+
+	for (u = 0; (u + 16) <= len; u += 16) {
+		__m128i x;
+
+		x = _mm_loadu_si128((const __m128i *)(d + u));
+		for (j = 0; j < num; j ++) {
+			x = _mm_xor_si128(x, _mm_and_si128(_mm_xor_si128(x,
+				_mm_loadu_si128((const __m128i *)
+				(s + j * stride + u))),
+				_mm_set1_epi32((int)m[j])));
+		}
+		_mm_storeu_si128((__m128i *)(d + u), x);
+	}
+	many_blend_words(d + u, s + u, stride, m, num, len - u);
+}
+
+#endif
+
+#if CTTK_AVX2
+
+TARGET_AVX2
+static void
+cond_copy_avx2(uint32_t m, unsigned char *d,
+	const unsigned char *s, size_t len)
+{
+	__m256i vm;
+	size_t u;
+
+	vm = _mm256_set1_epi32((int)m);
+	if ((uintptr_t)d <= (uintptr_t)s) {
+		for (u = 0; (u + 32) <= len; u += 32) {
+			__m256i x, y;
+
+			x = _mm256_loadu_si256((const __m256i *)(d + u));
+			y = _mm256_loadu_si256((const __m256i *)(s + u));
+			x = _mm256_xor_si256(x, _mm256_and_si256(
+				_mm256_xor_si256(x, y), vm));
+			_mm256_storeu_si256((__m256i *)(d + u), x);
+		}
+		cond_copy_words(m, d + u, s + u, len - u);
+	} else {
+		for (u = len; u >= 32; u -= 32) {
+			__m256i x, y;
+
+			x = _mm256_loadu_si256((const __m256i *)(d + u - 32));
+			y = _mm256_loadu_si256((const __m256i *)(s + u - 32));
+			x = _mm256_xor_si256(x, _mm256_and_si256(
+				_mm256_xor_si256(x, y), vm));
+			_mm256_storeu_si256((__m256i *)(d + u - 32), x);
+		}
+		cond_copy_words(m, d, s, u);
+	}
+}
+
+TARGET_AVX2
+static void
+cond_swap_avx2(uint32_t m, unsigned char *a, unsigned char *b, size_t len)
+{
+	__m256i vm;
+	size_t u;
+
+	vm = _mm256_set1_epi32((int)m);
+	for (u = 0; (u + 32) <= len; u += 32) {
+		__m256i x, y, t;
+
+		x = _mm256_loadu_si256((const __m256i *)(a + u));
+		y = _mm256_loadu_si256((const __m256i *)(b + u));
+		t = _mm256_and_si256(_mm256_xor_si256(x, y), vm);
+		_mm256_storeu_si256((__m256i *)(a + u), _mm256_xor_si256(x, t));
+		_mm256_storeu_si256((__m256i *)(b + u), _mm256_xor_si256(y, t));
+	}
+	cond_swap_words(m, a + u, b + u, len - u);
+}
+
+TARGET_AVX2
+static void
+many_or_avx2(unsigned char *d, const unsigned char *s, size_t stride,
+	const uint32_t *m, size_t num, size_t len)
+{
+	size_t u, j;
+
+	for (u = 0; (u + 32) <= len; u += 32) {
+		__m256i x;
+
+		x = _mm256_loadu_si256((const __m256i *)(d + u));
+		for (j = 0; j < num; j ++) {
+			x = _mm256_or_si256(x, _mm256_and_si256(
+				_mm256_loadu_si256((const __m256i *)
+				(s + j * stride + u)),
+				_mm256_set1_epi32((int)m[j])));
+		}
+		_mm256_storeu_si256((__m256i *)(d + u), x);
+	}
+	many_or_words(d + u, s + u, stride, m, num, len - u);
+}
+
+TARGET_AVX2
+static void
+many_blend_avx2(unsigned char *d, const unsigned char *s, size_t stride,
+	const uint32_t *m, size_t num, size_t len)
+{
+	size_t u, j;
+
+	for (u = 0; (u + 32) <= len; u += 32) {
+		__m256i x;
+
+		x = _mm256_loadu_si256((const __m256i *)(d + u));
+		for (j = 0; j < num; j ++) {
+			x = _mm256_xor_si256(x, _mm256_and_si256(
+				_mm256_xor_si256(x, _mm256_loadu_si256(
+				(const __m256i *)(s + j * stride + u))),
+				_mm256_set1_epi32((int)m[j])));
+		}
+		_mm256_storeu_si256((__m256i *)(d + u), x);
+	}
+	many_blend_words(d + u, s + u, stride, m, num, len - u);
+}
+
+#endif
+
+/*
+ * Comparison kernels. An "eq" kernel returns 0 if the two buffers are
+ * equal, a non-zero value otherwise. A "cmp" kernel returns -1, 0 or 1
+ * (as an uint32_t), as cttk_array_cmp().
+ */
+
+/*
+ * Merge the comparison result z (-1, 0 or 1) for a chunk into the
+ * current result r for the preceding bytes: r is updated only if it is
+ * still 0 (r is 0, 1 or -1, so its low bit is set if and only if it is
+ * not 0).
+ */
+static inline uint32_t
+cmp_merge(uint32_t r, uint32_t z)
+{
+	return r | ((uint32_t)((r & 1) - 1) & z);
+}
+
+/*
+ * Given two masks over the bytes of a chunk (bit i corresponds to byte
+ * i in memory order), of the bytes which differ (neq) and the bytes
+ * of the first buffer that are greater (gt), get the chunk comparison
+ * result (-1, 0 or 1).
+ */
+static inline uint32_t
+cmp_mask(uint64_t neq, uint64_t gt)
+{
+	uint64_t low;
+	uint32_t g, d;
+
+	low = neq & -neq;
+	g = cttk_u64_neq0(gt & low).v;
+	d = cttk_u64_neq0(low).v;
+	return g | -(d & (g ^ 1));
+}
+
+static uint64_t
+array_eq_words(const unsigned char *a, const unsigned char *b, size_t len)
+{
+	uint64_t r;
+	size_t u;
+
+	r = 0;
+	for (u = 0; (u + 8) <= len; u += 8) {
+		r |= ld64(a + u) ^ ld64(b + u);
+	}
+	for (; u < len; u ++) {
+		r |= a[u] ^ b[u];
+	}
+	return r;
+}
+
+static uint32_t
+array_cmp_bytes(uint32_t r, const unsigned char *a,
+	const unsigned char *b, size_t len)
+{
+	size_t u;
+
+	for (u = 0; u < len; u ++) {
+		uint32_t z;
+
+		/*
+		 * If the bytes are equal, then z is zero.
+		 * If a[u] > b[u], then z is in the 1..255 range.
+		 * If a[u] < b[u], then bits 8..31 of z are set to 1.
+		 */
+		z = a[u] - b[u];
+
+		/*
+		 * Set bit 8 to 1 if bits 0..7 are not all zero.
+		 */
+		z |= z + 0xFF;
+
+		/*
+		 * At that point:
+		 *  - If a[u] == b[u], then z == 0xFF.
+		 *  - If a[u] < b[u], then bits 8..31 of z are all one.
+		 *  - If a[u] > b[u], then bit 8 is one, and bits 9..31
+		 *    are zero.
+		 * We just need to shift the result to remove the low 8 bits,
+		 * duplicating the sign bit as needed.
+		 */
+		z = (z >> 8) | (z & 0xFF000000);
+		r = cmp_merge(r, z);
+	}
+	return r;
+}
+
+/*
+ * Word-wise comparison: words are decoded with big-endian convention,
+ * so that numerical order on words matches lexicographic order on
+ * bytes.
+ */
+static uint32_t
+array_cmp_words(uint32_t r, const unsigned char *a,
+	const unsigned char *b, size_t len)
+{
+	size_t u;
+
+	for (u = 0; (u + 8) <= len; u += 8) {
+		r = cmp_merge(r,
+			(uint32_t)cttk_u64_cmp(ld64be(a + u), ld64be(b + u)));
+	}
+	return array_cmp_bytes(r, a + u, b + u, len - u);
+}
+
+#if CTTK_SSE2
+
+static uint64_t
+array_eq_sse2(const unsigned char *a, const unsigned char *b, size_t len)
+{
+	__m128i acc;
+	size_t u;
+
+	acc = _mm_setzero_si128();
+	for (u = 0; (u + 16) <= len; u += 16) {
+		acc = _mm_or_si128(acc, _mm_xor_si128(
+			_mm_loadu_si128((const __m128i *)(a + u)),
+			_mm_loadu_si128((const __m128i *)(b + u))));
+	}
+	return (uint64_t)(_mm_movemask_epi8(
+		_mm_cmpeq_epi8(acc, _mm_setzero_si128())) ^ 0xFFFF)
+		| array_eq_words(a + u, b + u, len - u);
+}
+
+static uint32_t
+array_cmp_sse2(const unsigned char *a, const unsigned char *b, size_t len)
+{
+	uint32_t r;
+	size_t u;
+
+	r = 0;
+	for (u = 0; (u + 16) <= len; u += 16) {
+		__m128i x, y;
+		uint32_t eq, ge;
+
+		x = _mm_loadu_si128((const __m128i *)(a + u));
+		y = _mm_loadu_si128((const __m128i *)(b + u));
+		eq = (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(x, y));
+		ge = (uint32_t)_mm_movemask_epi8(
+			_mm_cmpeq_epi8(_mm_max_epu8(x, y), x));
+		r = cmp_merge(r, cmp_mask(eq ^ 0xFFFF, ge & ~eq));
+	}
+	return array_cmp_words(r, a + u, b + u, len - u);
+}
+
+#endif
+
+#if CTTK_AVX2
+
+TARGET_AVX2
+static uint64_t
+array_eq_avx2(const unsigned char *a, const unsigned char *b, size_t len)
+{
+	__m256i acc;
+	size_t u;
+
+	acc = _mm256_setzero_si256();
+	for (u = 0; (u + 32) <= len; u += 32) {
+		acc = _mm256_or_si256(acc, _mm256_xor_si256(
+			_mm256_loadu_si256((const __m256i *)(a + u)),
+			_mm256_loadu_si256((const __m256i *)(b + u))));
+	}
+	return (uint64_t)~(uint32_t)_mm256_movemask_epi8(
+		_mm256_cmpeq_epi8(acc, _mm256_setzero_si256()))
+		| array_eq_words(a + u, b + u, len - u);
+}
+
+TARGET_AVX2
+static uint32_t
+array_cmp_avx2(const unsigned char *a, const unsigned char *b, size_t len)
+{
+	uint32_t r;
+	size_t u;
+
+	r = 0;
+	for (u = 0; (u + 32) <= len; u += 32) {
+		__m256i x, y;
+		uint32_t eq, ge;
+
+		x = _mm256_loadu_si256((const __m256i *)(a + u));
+		y = _mm256_loadu_si256((const __m256i *)(b + u));
+		eq = (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(x, y));
+		ge = (uint32_t)_mm256_movemask_epi8(
+			_mm256_cmpeq_epi8(_mm256_max_epu8(x, y), x));
+		r = cmp_merge(r, cmp_mask(~eq, ge & ~eq));
+	}
+	return array_cmp_words(r, a + u, b + u, len - u);
+}
+
+#endif
+
+/*
+ * Below this length (in bytes), the word-wise code is used directly.
+ */
+#define VEC_MIN   32
+
+typedef void (*cond_copy_fn)(uint32_t m, unsigned char *d,
+	const unsigned char *s, size_t len);
+typedef void (*cond_swap_fn)(uint32_t m, unsigned char *a,
+	unsigned char *b, size_t len);
+typedef uint64_t (*array_eq_fn)(const unsigned char *a,
+	const unsigned char *b, size_t len);
+typedef uint32_t (*array_cmp_fn)(const unsigned char *a,
+	const unsigned char *b, size_t len);
+typedef void (*many_fn)(unsigned char *d, const unsigned char *s,
+	size_t stride, const uint32_t *m, size_t num, size_t len);
+
+static void cond_copy_first(uint32_t m, unsigned char *d,
+	const unsigned char *s, size_t len);
+static void cond_swap_first(uint32_t m, unsigned char *a,
+	unsigned char *b, size_t len);
+static uint64_t array_eq_first(const unsigned char *a,
+	const unsigned char *b, size_t len);
+static uint32_t array_cmp_first(const unsigned char *a,
+	const unsigned char *b, size_t len);
+static void many_or_first(unsigned char *d, const unsigned char *s,
+	size_t stride, const uint32_t *m, size_t num, size_t len);
+static void many_blend_first(unsigned char *d, const unsigned char *s,
+	size_t stride, const uint32_t *m, size_t num, size_t len);
+
+/*
+ * Selected implementations. The pointers initially reference functions
+ * that make the selection (see cpu.c) and then forward the call. They
+ * are accessed with DISPATCH_LOAD() and DISPATCH_STORE() (see inner.h),
+ * since concurrent first calls may write them from several threads.
+ */
+static cond_copy_fn DISPATCH_VAR cond_copy_impl = &cond_copy_first;
+static cond_swap_fn DISPATCH_VAR cond_swap_impl = &cond_swap_first;
+static array_eq_fn DISPATCH_VAR array_eq_impl = &array_eq_first;
+static array_cmp_fn DISPATCH_VAR array_cmp_impl = &array_cmp_first;
+static many_fn DISPATCH_VAR many_or_impl = &many_or_first;
+static many_fn DISPATCH_VAR many_blend_impl = &many_blend_first;
+
+static uint32_t
+array_cmp_words0(const unsigned char *a, const unsigned char *b, size_t len)
+{
+	return array_cmp_words(0, a, b, len);
+}
+
+/* see inner.h */
+void
+cttk_oram1_select(void)
+{
+	uint32_t f;
+	cond_copy_fn fc;
+	cond_swap_fn fs;
+	array_eq_fn fe;
+	array_cmp_fn fk;
+	many_fn fo, fb;
+
+	f = cttk_cpu_features();
+	fc = &cond_copy_words;
+	fs = &cond_swap_words;
+	fe = &array_eq_words;
+	fk = &array_cmp_words0;
+	fo = &many_or_words;
+	fb = &many_blend_words;
+#if CTTK_SSE2
+	if (f & CTTK_CPU_SSE2) {
+		fc = &cond_copy_sse2;
+		fs = &cond_swap_sse2;
+		fe = &array_eq_sse2;
+		fk = &array_cmp_sse2;
+		fo = &many_or_sse2;
+		fb = &many_blend_sse2;
+	}
+#endif
+#if CTTK_AVX2
+	if (f & CTTK_CPU_AVX2) {
+		fc = &cond_copy_avx2;
+		fs = &cond_swap_avx2;
+		fe = &array_eq_avx2;
+		fk = &array_cmp_avx2;
+		fo = &many_or_avx2;
+		fb = &many_blend_avx2;
+	}
+#endif
+	(void)f;
+	DISPATCH_STORE(cond_copy_impl, fc);
+	DISPATCH_STORE(cond_swap_impl, fs);
+	DISPATCH_STORE(array_eq_impl, fe);
+	DISPATCH_STORE(array_cmp_impl, fk);
+	DISPATCH_STORE(many_or_impl, fo);
+	DISPATCH_STORE(many_blend_impl, fb);
+}
+
+static void
+cond_copy_first(uint32_t m, unsigned char *d,
+	const unsigned char *s, size_t len)
+{
+	cttk_oram1_select();
+	DISPATCH_LOAD(cond_copy_impl)(m, d, s, len);
+}
+
+static void
+cond_swap_first(uint32_t m, unsigned char *a, unsigned char *b, size_t len)
+{
+	cttk_oram1_select();
+	DISPATCH_LOAD(cond_swap_impl)(m, a, b, len);
+}
+
+static uint64_t
+array_eq_first(const unsigned char *a, const unsigned char *b, size_t len)
+{
+	cttk_oram1_select();
+	return DISPATCH_LOAD(array_eq_impl)(a, b, len);
+}
+
+static uint32_t
+array_cmp_first(const unsigned char *a, const unsigned char *b, size_t len)
+{
+	cttk_oram1_select();
+	return DISPATCH_LOAD(array_cmp_impl)(a, b, len);
+}
+
+static void
+many_or_first(unsigned char *d, const unsigned char *s,
+	size_t stride, const uint32_t *m, size_t num, size_t len)
+{
+	cttk_oram1_select();
+	DISPATCH_LOAD(many_or_impl)(d, s, stride, m, num, len);
+}
+
+static void
+many_blend_first(unsigned char *d, const unsigned char *s,
+	size_t stride, const uint32_t *m, size_t num, size_t len)
+{
+	cttk_oram1_select();
+	DISPATCH_LOAD(many_blend_impl)(d, s, stride, m, num, len);
+}
+
 /* see cttk.h */
 void
 cttk_cond_copy(cttk_bool ctl, void *dst, const void *src, size_t len)
 {
-	/*
-	 * TODO: make optimised versions for special cases:
-	 *
-	 *  - We can copy by full words, depending on alignment (and
-	 *    architecture tolerance for unaligned accesses), even in
-	 *    case of overlap (it suffices to do the copy in the
-	 *    appropriate direction).
-	 *
-	 *  - We may use SSE2, AVX2, or similar vector operands on
-	 *    platforms that support them.
-	 *
-	 * Code below is the basic, portable variant. It relies on the
-	 * idea that if source and destination overlap, then converting
-	 * the pointers to integers should preserve ordering.
-	 */
-	unsigned char *bdst;
-	const unsigned char *bsrc;
-	size_t u;
-
 	/*
 	 * In order to perform a constant-time copy, we need to read the
 	 * current contents of the destination buffer, which may be, from
@@ -56,20 +785,10 @@ cttk_cond_copy(cttk_bool ctl, void *dst, const void *src, size_t len)
 	 * shall incur no trap representation, and therefore no undefined
 	 * behaviour).
 	 */
-	bdst = dst;
-	bsrc = src;
-	if ((uintptr_t)dst <= (uintptr_t)src) {
-		u = 0;
-		while (u < len) {
-			bdst[u] ^= (bsrc[u] ^ bdst[u]) & -ctl.v;
-			u ++;
-		}
+	if (len < VEC_MIN) {
+		cond_copy_words(-ctl.v, dst, src, len);
 	} else {
-		u = len;
-		while (u > 0) {
-			u --;
-			bdst[u] ^= (bsrc[u] ^ bdst[u]) & -ctl.v;
-		}
+		DISPATCH_LOAD(cond_copy_impl)(-ctl.v, dst, src, len);
 	}
 }
 
@@ -77,31 +796,45 @@ cttk_cond_copy(cttk_bool ctl, void *dst, const void *src, size_t len)
 void
 cttk_cond_swap(cttk_bool ctl, void *a, void *b, size_t len)
 {
-	/*
-	 * TODO: make optimised versions for special cases:
-	 *
-	 *  - We can copy by full words, depending on alignment (and
-	 *    architecture tolerance for unaligned accesses), even in
-	 *    case of overlap (it suffices to do the copy in the
-	 *    appropriate direction).
-	 *
-	 *  - We may use SSE2, AVX2, or similar vector operands on
-	 *    platforms that support them.
-	 *
-	 * Code below is the basic, portable variant.
-	 */
-	unsigned char *za, *zb;
-	size_t u;
+	if (len < VEC_MIN) {
+		cond_swap_words(-ctl.v, a, b, len);
+	} else {
+		DISPATCH_LOAD(cond_swap_impl)(-ctl.v, a, b, len);
+	}
+}
+
+/*
+ * Masks are computed for up to MANY_CHUNK elements (or indices) at a
+ * time; the "many" kernels then keep the current destination chunk in
+ * a register across all of them.
+ */
+#define MANY_CHUNK    64
 
-	za = a;
-	zb = b;
+static many_fn
+many_or_select(size_t elt_len)
+{
+	return elt_len < VEC_MIN ? &many_or_words : DISPATCH_LOAD(many_or_impl);
+}
 
-	for (u = 0; u < len; u ++) {
-		uint32_t x;
+/*
+ * OR into d the element among the n elements at b (with indices u to
+ * u+n-1) whose index is equal to index, if any.
+ */
+static void
+array_or_range(many_fn fo, unsigned char *d, const unsigned char *b,
+	size_t elt_len, size_t u, size_t n, size_t index)
+{
+	size_t v;
+
+	for (v = 0; v < n; v += MANY_CHUNK) {
+		uint32_t m[MANY_CHUNK];
+		size_t j, nv;
 
-		x = (za[u] ^ zb[u]) & -ctl.v;
-		za[u] ^= x;
-		zb[u] ^= x;
+		nv = n - v < MANY_CHUNK ? n - v : MANY_CHUNK;
+		for (j = 0; j < nv; j ++) {
+			m[j] = -cttk_u64_eq(u + v + j, index).v;
+		}
+		fo(d, b + v * elt_len, elt_len, m, nv, elt_len);
 	}
 }
 
@@ -110,13 +843,11 @@ void
 cttk_array_read(void *d,
 	const void *a, size_t elt_len, size_t num_len, size_t index)
 {
-	size_t u;
-	const unsigned char *b;
-
+	STATS_SCAN_BEGIN(1, elt_len * num_len);
 	memset(d, 0, elt_len);
-	for (u = 0, b = a; u < num_len; u ++, b += elt_len) {
-		cttk_cond_copy(cttk_u64_eq(u, index), d, b, elt_len);
-	}
+	array_or_range(many_or_select(elt_len),
+		d, a, elt_len, 0, num_len, index);
+	STATS_SCAN_END();
 }
 
 /* see cttk.h */
@@ -127,74 +858,239 @@ cttk_array_write(void *a, size_t elt_len, size_t num_len,
 	size_t u;
 	unsigned char *b;
 
+	STATS_SCAN_BEGIN(1, elt_len * num_len);
 	for (u = 0, b = a; u < num_len; u ++, b += elt_len) {
 		cttk_cond_copy(cttk_u64_eq(u, index), b, s, elt_len);
 	}
+	STATS_SCAN_END();
+}
+
+/*
+ * Batch reads process the array by blocks of about ARRAY_BLOCK bytes;
+ * each block is scanned once per index while it is in L1 cache, so that
+ * the array goes through the memory hierarchy only once for the whole
+ * batch. Batch writes load each array element once and blend into it
+ * all the source values.
+ */
+#define ARRAY_BLOCK   16384
+
+static size_t
+array_block_num(size_t elt_len)
+{
+	return elt_len >= ARRAY_BLOCK ? 1 : ARRAY_BLOCK / elt_len;
 }
 
 /* see cttk.h */
-cttk_bool
-cttk_array_eq(const void *src1, const void *src2, size_t len)
+void
+cttk_array_read_many(void *d, const void *a, size_t elt_len, size_t num_len,
+	const size_t *index, size_t num_index)
 {
-	const unsigned char *buf1, *buf2;
-	size_t u;
-	uint32_t r;
+	size_t bn, u, k;
+	unsigned char *dd;
+	const unsigned char *b;
+	many_fn fo;
 
-	r = 0;
-	buf1 = src1;
-	buf2 = src2;
-	for (u = 0; u < len; u ++) {
-		r |= buf1[u] ^ buf2[u];
+	if (elt_len == 0) {
+		return;
+	}
+	STATS_SCAN_BEGIN(num_index, elt_len * num_len * num_index);
+	dd = d;
+	memset(dd, 0, elt_len * num_index);
+	fo = many_or_select(elt_len);
+	bn = array_block_num(elt_len);
+	for (u = 0, b = a; u < num_len; u += bn, b += bn * elt_len) {
+		size_t n;
+
+		n = num_len - u < bn ? num_len - u : bn;
+		for (k = 0; k < num_index; k ++) {
+			array_or_range(fo, dd + k * elt_len, b,
+				elt_len, u, n, index[k]);
+		}
 	}
-	return cttk_u32_eq0(r);
+	STATS_SCAN_END();
 }
 
 /* see cttk.h */
-int32_t
-cttk_array_cmp(const void *src1, const void *src2, size_t len)
+void
+cttk_array_write_many(void *a, size_t elt_len, size_t num_len,
+	const size_t *index, size_t num_index, const void *s)
 {
-	const unsigned char *buf1, *buf2;
-	uint32_t r;
 	size_t u;
+	unsigned char *b;
+	const unsigned char *ss;
+	many_fn fb;
 
-	buf1 = src1;
-	buf2 = src2;
-	r = 0;
-	for (u = 0; u < len; u ++) {
-		uint32_t z;
+	if (elt_len == 0) {
+		return;
+	}
+	STATS_SCAN_BEGIN(num_index, elt_len * num_len * num_index);
+	ss = s;
+	fb = elt_len < VEC_MIN
+		? &many_blend_words : DISPATCH_LOAD(many_blend_impl);
+	for (u = 0, b = a; u < num_len; u ++, b += elt_len) {
+		size_t k;
 
-		/*
-		 * If the bytes are equal, then z is zero.
-		 * If buf1[u] > buf2[u], then z is in the 1..255 range.
-		 * If buf1[u] < buf2[u], then bits 8..31 of z are set to 1.
-		 */
-		z = buf1[u] - buf2[u];
+		for (k = 0; k < num_index; k += MANY_CHUNK) {
+			uint32_t m[MANY_CHUNK];
+			size_t j, nk;
 
-		/*
-		 * Set bit 8 to 1 if bits 0..7 are not all zero.
-		 */
-		z |= z + 0xFF;
+			nk = num_index - k < MANY_CHUNK
+				? num_index - k : MANY_CHUNK;
+			for (j = 0; j < nk; j ++) {
+				m[j] = -cttk_u64_eq(u, index[k + j]).v;
+			}
+			fb(b, ss + k * elt_len, elt_len, m, nk, elt_len);
+		}
+	}
+	STATS_SCAN_END();
+}
 
-		/*
-		 * At that point:
-		 *  - If buf1[u] == buf2[u], then z == 0xFF.
-		 *  - If buf1[u] < buf2[u], then bits 8..31 of z are all one.
-		 *  - If buf1[u] > buf2[u], then bit 8 is one, and bits 9..31
-		 *    are zero.
-		 * We just need to shift the result to remove the low 8 bits,
-		 * duplicating the sign bit as needed.
-		 */
-		z = (z >> 8) | (z & 0xFF000000);
+/*
+ * Context for cttk_array_read_mt(): job 0 writes its partial result
+ * directly in d, job i > 0 uses t + (i-1)*elt_len.
+ */
+typedef struct {
+	unsigned char *d;
+	unsigned char *t;
+	const unsigned char *a;
+	size_t elt_len, num_len, index, num_jobs;
+	many_fn fo;
+} read_mt_context;
 
-		/*
-		 * If r is 1 or -1 at this point, then its low bit is set,
-		 * and "(r & 1) - 1" will be 0; in that case, r remains
-		 * unmodified.
-		 *
-		 * If r is 0, then "(r & 1) - 1" will be -1, and r is set
-		 * to the value of z (which is 0, 1 or -1).
-		 */
-		r |= (uint32_t)((r & 1) - 1) & z;
+static void
+read_mt_job(void *arg, size_t idx)
+{
+	const read_mt_context *rc;
+	size_t q, r, lo, n;
+	unsigned char *p;
+
+	rc = arg;
+	q = rc->num_len / rc->num_jobs;
+	r = rc->num_len % rc->num_jobs;
+	lo = idx * q + (idx < r ? idx : r);
+	n = q + (idx < r);
+	p = idx == 0 ? rc->d : rc->t + (idx - 1) * rc->elt_len;
+	memset(p, 0, rc->elt_len);
+	array_or_range(rc->fo, p, rc->a + lo * rc->elt_len,
+		rc->elt_len, lo, n, rc->index);
+}
+
+static void
+read_mt_buf(void *d, const void *a, size_t elt_len, size_t num_len,
+	size_t index, size_t num_jobs, cttk_executor exec, void *exec_ctx,
+	unsigned char *t)
+{
+	read_mt_context rc;
+	uint32_t m[MANY_CHUNK];
+	size_t j;
+
+	rc.d = d;
+	rc.t = t;
+	rc.a = a;
+	rc.elt_len = elt_len;
+	rc.num_len = num_len;
+	rc.index = index;
+	rc.num_jobs = num_jobs;
+	rc.fo = many_or_select(elt_len);
+	if (num_jobs <= 1) {
+		read_mt_job(&rc, 0);
+		return;
+	}
+	exec(exec_ctx, &read_mt_job, &rc, num_jobs);
+
+	/*
+	 * Combine the partial results.
+	 */
+	memset(m, 0xFF, sizeof m);
+	for (j = 0; j < num_jobs - 1; j += MANY_CHUNK) {
+		size_t nm;
+
+		nm = num_jobs - 1 - j < MANY_CHUNK
+			? num_jobs - 1 - j : MANY_CHUNK;
+		rc.fo(d, t + j * elt_len, elt_len, m, nm, elt_len);
+	}
+}
+
+static void
+read_mt_stack(void *d, const void *a, size_t elt_len, size_t num_len,
+	size_t index, size_t num_jobs, cttk_executor exec, void *exec_ctx)
+{
+	unsigned char t[CTTK_MAX_INT_BUF];
+
+	read_mt_buf(d, a, elt_len, num_len,
+		index, num_jobs, exec, exec_ctx, t);
+}
+
+/* see cttk.h */
+void
+cttk_array_read_mt(void *d, const void *a, size_t elt_len,
+	size_t num_len, size_t index,
+	unsigned num_threads, cttk_executor exec, void *exec_ctx)
+{
+	size_t num_jobs;
+
+	if (exec == NULL || num_threads <= 1
+		|| num_len <= 1 || elt_len == 0)
+	{
+		cttk_array_read(d, a, elt_len, num_len, index);
+		return;
+	}
+	STATS_SCAN_BEGIN(1, elt_len * num_len);
+	num_jobs = num_threads < num_len ? num_threads : num_len;
+	if ((num_jobs - 1) <= CTTK_MAX_INT_BUF / elt_len) {
+		read_mt_stack(d, a, elt_len, num_len,
+			index, num_jobs, exec, exec_ctx);
+		STATS_SCAN_END();
+		return;
+	}
+#if !CTTK_NO_MALLOC
+	{
+		unsigned char *t;
+
+		t = cttk_scratch_alloc((num_jobs - 1) * elt_len);
+		if (t != NULL) {
+			read_mt_buf(d, a, elt_len, num_len,
+				index, num_jobs, exec, exec_ctx, t);
+			free(t);
+			STATS_SCAN_END();
+			return;
+		}
+	}
+#endif
+
+	/*
+	 * Not enough room for all partial results: use as many jobs as
+	 * the stack buffer allows.
+	 */
+	read_mt_stack(d, a, elt_len, num_len,
+		index, 1 + CTTK_MAX_INT_BUF / elt_len, exec, exec_ctx);
+	STATS_SCAN_END();
+}
+
+/* see cttk.h */
+cttk_bool
+cttk_array_eq(const void *src1, const void *src2, size_t len)
+{
+	uint64_t r;
+
+	if (len < VEC_MIN) {
+		r = array_eq_words(src1, src2, len);
+	} else {
+		r = DISPATCH_LOAD(array_eq_impl)(src1, src2, len);
+	}
+	return cttk_u64_eq0(r);
+}
+
+/* see cttk.h */
+int32_t
+cttk_array_cmp(const void *src1, const void *src2, size_t len)
+{
+	uint32_t r;
+
+	if (len < VEC_MIN) {
+		r = array_cmp_words(0, src1, src2, len);
+	} else {
+		r = DISPATCH_LOAD(array_cmp_impl)(src1, src2, len);
 	}
 	return *(int32_t *)&r;
 }
@@ -0,0 +1,431 @@
+/*
+ * Copyright (c) 2018 Thomas Pornin <pornin@bolet.org>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining 
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be 
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, 
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND 
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "inner.h"
+
+/*
+ * Path ORAM (Stefanov et al., 2013), with a recursive position map.
+ *
+ * Each ORAM level stores its blocks in a binary tree of buckets; each
+ * bucket has ORAM_Z slots. Every block is mapped to a random leaf, and
+ * is always located either in a bucket on the path from the root to
+ * its leaf, or in the stash. An access reads the full path for the
+ * block's current leaf into a work area (stash + path), remaps the
+ * block to a new random leaf, then writes the path back, moving as
+ * many blocks as possible from the work area into the path buckets
+ * (deepest first).
+ *
+ * The leaf of each block is recorded in a position map. For level k,
+ * the position map is either a plain array (accessed with linear scans,
+ * with cttk_array_read() and cttk_array_write()), if it is small enough,
+ * or held in another ORAM (level k+1) whose blocks contain ORAM_PACK
+ * positions each.
+ *
+ * A slot consists of an 8-byte header followed by the block data. The
+ * header contains the block index (ORAM_EMPTY for an unused slot) and
+ * the block leaf, as two 32-bit words in native encoding. Positions
+ * are stored as leaf+1, so that 0 means "never accessed": such blocks
+ * are not in the tree yet, and are created (with all-zero data) on
+ * first access.
+ *
+ * Leaves are public once drawn (the path that is read reveals them),
+ * but they are random and independent of the accessed indices. All
+ * processing inside the work area is done with constant-time masking
+ * and conditional copies, over all slots.
+ */
+
+#define ORAM_Z        4
+#define ORAM_STASH    80
+#define ORAM_PACK     16
+#define ORAM_LINEAR   4096
+#define ORAM_EMPTY    ((uint32_t)0xFFFFFFFF)
+#define ORAM_HDR      8
+
+#define OP_READ    0
+#define OP_WRITE   1
+#define OP_POS     2
+
+static inline uint32_t
+get32(const unsigned char *src)
+{
+	uint32_t x;
+
+	memcpy(&x, src, sizeof x);
+	return x;
+}
+
+static inline void
+put32(unsigned char *dst, uint32_t x)
+{
+	memcpy(dst, &x, sizeof x);
+}
+
+/*
+ * Compute the level parameters for the provided element size and count.
+ * The parameters are written in lv[] (CTTK_ORAM_MAX_LEVELS entries) and
+ * the number of levels is written in *num_levels. Returned value is the
+ * total memory size (in bytes) of all trees and work areas, or 0 if
+ * the parameters are invalid or the size would not fit in a size_t.
+ */
+static size_t
+compute_levels(cttk_oram_level *lv, unsigned *num_levels,
+	size_t elt_len, size_t num_len)
+{
+	size_t total, num;
+	unsigned k;
+
+	if (elt_len == 0 || num_len == 0 || num_len > 0x7FFFFFFF
+		|| elt_len > ((size_t)-1 >> 8))
+	{
+		return 0;
+	}
+	total = 0;
+	num = num_len;
+	for (k = 0;; k ++) {
+		size_t slot_len, nb, ns, len;
+		unsigned depth;
+
+		if (k >= CTTK_ORAM_MAX_LEVELS) {
+			return 0;
+		}
+		depth = cttk_u32_bitlength((uint32_t)(num - 1));
+		depth = depth == 0 ? 0 : depth - 1;
+		slot_len = ORAM_HDR + (k == 0 ? elt_len : 4 * ORAM_PACK);
+
+		/*
+		 * Tree: 2^(depth+1)-1 buckets; work area: stash + one path.
+		 */
+		nb = ((size_t)2 << depth) - 1;
+		ns = nb * ORAM_Z + ORAM_STASH + ORAM_Z * (depth + 1);
+		if (ns > ((size_t)-1 - total) / slot_len) {
+			return 0;
+		}
+		len = ns * slot_len;
+		total += len;
+
+		lv[k].data_len = slot_len - ORAM_HDR;
+		lv[k].slot_len = slot_len;
+		lv[k].num = (uint32_t)num;
+		lv[k].depth = depth;
+		if (num <= ORAM_LINEAR) {
+			break;
+		}
+		num = (num + ORAM_PACK - 1) / ORAM_PACK;
+	}
+	*num_levels = k + 1;
+	return total;
+}
+
+/* see cttk.h */
+size_t
+cttk_oram_mem_len(size_t elt_len, size_t num_len)
+{
+	cttk_oram_level lv[CTTK_ORAM_MAX_LEVELS];
+	unsigned num_levels;
+	size_t total, extra;
+
+	total = compute_levels(lv, &num_levels, elt_len, num_len);
+	if (total == 0) {
+		return 0;
+	}
+
+	/*
+	 * Extra space: final position map (4 bytes per entry) and an
+	 * all-zero block (for newly created blocks).
+	 */
+	extra = 4 * (size_t)lv[num_levels - 1].num
+		+ (elt_len > 4 * ORAM_PACK ? elt_len : 4 * ORAM_PACK);
+	if (extra > (size_t)-1 - total) {
+		return 0;
+	}
+	return total + extra;
+}
+
+/* see cttk.h */
+int
+cttk_oram_init(cttk_oram *o, void *mem, size_t mem_len,
+	size_t elt_len, size_t num_len,
+	void (*rng)(void *rng_ctx, void *dst, size_t len), void *rng_ctx)
+{
+	unsigned char *buf;
+	size_t total;
+	unsigned k;
+
+	total = cttk_oram_mem_len(elt_len, num_len);
+	if (total == 0 || mem_len < total || rng == NULL) {
+		return 0;
+	}
+	compute_levels(o->levels, &o->num_levels, elt_len, num_len);
+	buf = mem;
+	for (k = 0; k < o->num_levels; k ++) {
+		cttk_oram_level *lv;
+		size_t tlen;
+
+		lv = &o->levels[k];
+		tlen = (((size_t)2 << lv->depth) - 1) * ORAM_Z * lv->slot_len;
+		lv->tree = buf;
+		lv->work = buf + tlen;
+		buf += tlen + (ORAM_STASH + ORAM_Z * (lv->depth + 1))
+			* lv->slot_len;
+	}
+
+	/*
+	 * All slots are initially empty (all-ones headers); the data
+	 * bytes are also set, so that the memory contents are always
+	 * initialised.
+	 */
+	memset(mem, 0xFF, (size_t)(buf - (unsigned char *)mem));
+	o->posmap = buf;
+	buf += 4 * (size_t)o->levels[o->num_levels - 1].num;
+	o->zero = buf;
+	memset(o->posmap, 0, total - (size_t)(o->posmap - (unsigned char *)mem));
+	o->elt_len = elt_len;
+	o->num_len = num_len;
+	o->rng = rng;
+	o->rng_ctx = rng_ctx;
+	o->fail = 0;
+	return 1;
+}
+
+/*
+ * Access block idx in ORAM level k:
+ *
+ *  - The position of the block is obtained and updated (recursively).
+ *  - The path is read into the work area; the block is created if it
+ *    is not present yet.
+ *  - The operation (op) is applied on the block contents:
+ *      OP_READ    block data is written into dst, if ctl is true
+ *      OP_WRITE   block data is set to src, if ctl is true
+ *      OP_POS     entry sub (a 32-bit word) of the block is set to
+ *                 val, and its previous value is returned
+ *  - The path is written back, and remaining blocks are moved into the
+ *    stash.
+ *
+ * rv[] contains two random 32-bit words per level.
+ */
+static uint32_t
+level_access(cttk_oram *o, unsigned k, uint32_t idx, const uint32_t *rv,
+	int op, cttk_bool ctl, unsigned char *dst, const unsigned char *src,
+	uint32_t sub, uint32_t val)
+{
+	cttk_oram_level *lv;
+	unsigned char *work, *tree;
+	unsigned depth, d;
+	uint32_t mask, new_leaf, p, leaf, r, fail;
+	size_t slot_len, data_len, nw, j;
+	cttk_bool found, ins;
+
+	lv = &o->levels[k];
+	depth = lv->depth;
+	mask = ((uint32_t)1 << depth) - 1;
+	new_leaf = rv[k << 1] & mask;
+
+	/*
+	 * Get the current position of the block, and set the new one.
+	 */
+	if (k + 1 < o->num_levels) {
+		p = level_access(o, k + 1, idx / ORAM_PACK, rv, OP_POS,
+			cttk_true, NULL, NULL, idx % ORAM_PACK, new_leaf + 1);
+	} else {
+		unsigned char tmp[4];
+
+		cttk_array_read(tmp, o->posmap, 4, lv->num, idx);
+		p = get32(tmp);
+		put32(tmp, new_leaf + 1);
+		cttk_array_write(o->posmap, 4, lv->num, idx, tmp);
+	}
+
+	/*
+	 * If the block was never accessed, then it is not in the tree;
+	 * we still read a random path.
+	 */
+	leaf = cttk_u32_mux(cttk_u32_eq0(p), rv[(k << 1) + 1] & mask, p - 1);
+
+	/*
+	 * Read the path into the work area (after the stash). The leaf
+	 * value is random and can be revealed.
+	 */
+	slot_len = lv->slot_len;
+	data_len = lv->data_len;
+	work = lv->work;
+	tree = lv->tree;
+	nw = ORAM_STASH + ORAM_Z * (depth + 1);
+	for (d = 0; d <= depth; d ++) {
+		size_t b;
+
+		b = ((size_t)1 << d) - 1 + (leaf >> (depth - d));
+		memcpy(work + (ORAM_STASH + ORAM_Z * d) * slot_len,
+			tree + b * ORAM_Z * slot_len, ORAM_Z * slot_len);
+	}
+
+	/*
+	 * Look for the block. If not found, create it in the first
+	 * free slot, with all-zero data.
+	 */
+	found = cttk_false;
+	for (j = 0; j < nw; j ++) {
+		found = cttk_or(found,
+			cttk_u32_eq(get32(work + j * slot_len), idx));
+	}
+	ins = cttk_not(found);
+	for (j = 0; j < nw; j ++) {
+		unsigned char *s;
+		cttk_bool e;
+
+		s = work + j * slot_len;
+		e = cttk_and(ins, cttk_u32_eq(get32(s), ORAM_EMPTY));
+		put32(s, cttk_u32_mux(e, idx, get32(s)));
+		cttk_cond_copy(e, s + ORAM_HDR, o->zero, data_len);
+		ins = cttk_and(ins, cttk_not(e));
+	}
+	fail = ins.v;
+
+	/*
+	 * Apply the operation on the block, and remap it.
+	 */
+	r = 0;
+	for (j = 0; j < nw; j ++) {
+		unsigned char *s;
+		cttk_bool hit;
+
+		s = work + j * slot_len;
+		hit = cttk_u32_eq(get32(s), idx);
+		put32(s + 4, cttk_u32_mux(hit, new_leaf, get32(s + 4)));
+		switch (op) {
+		case OP_READ:
+			cttk_cond_copy(cttk_and(hit, ctl),
+				dst, s + ORAM_HDR, data_len);
+			break;
+		case OP_WRITE:
+			cttk_cond_copy(cttk_and(hit, ctl),
+				s + ORAM_HDR, src, data_len);
+			break;
+		default: {
+			unsigned char tmp[4 * ORAM_PACK], e4[4];
+
+			cttk_array_read(e4, s + ORAM_HDR, 4, ORAM_PACK, sub);
+			r = cttk_u32_mux(hit, get32(e4), r);
+			memcpy(tmp, s + ORAM_HDR, sizeof tmp);
+			put32(e4, val);
+			cttk_array_write(tmp, 4, ORAM_PACK, sub, e4);
+			cttk_cond_copy(hit, s + ORAM_HDR, tmp, sizeof tmp);
+			break;
+		}
+		}
+	}
+
+	/*
+	 * Write back the path, from leaf to root. Each bucket slot
+	 * receives the first block (if any) of the work area that may
+	 * be stored at that depth, i.e. whose leaf has the same
+	 * top bits as the path leaf.
+	 */
+	for (d = depth + 1; d -- > 0;) {
+		size_t b;
+		unsigned z;
+
+		b = ((size_t)1 << d) - 1 + (leaf >> (depth - d));
+		for (z = 0; z < ORAM_Z; z ++) {
+			unsigned char *t;
+			cttk_bool done;
+
+			t = tree + (b * ORAM_Z + z) * slot_len;
+			put32(t, ORAM_EMPTY);
+			done = cttk_false;
+			for (j = 0; j < nw; j ++) {
+				unsigned char *s;
+				uint32_t id;
+				cttk_bool elig;
+
+				s = work + j * slot_len;
+				id = get32(s);
+				elig = cttk_and(cttk_not(done), cttk_and(
+					cttk_u32_neq(id, ORAM_EMPTY),
+					cttk_u32_eq0((get32(s + 4) ^ leaf)
+						>> (depth - d))));
+				cttk_cond_copy(elig, t, s, slot_len);
+				put32(s, cttk_u32_mux(elig, ORAM_EMPTY, id));
+				done = cttk_or(done, elig);
+			}
+		}
+	}
+
+	/*
+	 * Move the remaining blocks from the path part of the work area
+	 * into free stash slots. If some block cannot be moved, then the
+	 * stash has overflowed, and that block is lost.
+	 */
+	for (j = ORAM_STASH; j < nw; j ++) {
+		unsigned char *s;
+		cttk_bool pending;
+		size_t i;
+
+		s = work + j * slot_len;
+		pending = cttk_u32_neq(get32(s), ORAM_EMPTY);
+		for (i = 0; i < ORAM_STASH; i ++) {
+			unsigned char *t;
+			cttk_bool mv;
+
+			t = work + i * slot_len;
+			mv = cttk_and(pending, cttk_u32_eq(get32(t), ORAM_EMPTY));
+			cttk_cond_copy(mv, t, s, slot_len);
+			pending = cttk_and(pending, cttk_not(mv));
+		}
+		fail |= pending.v;
+	}
+	o->fail |= fail;
+	return r;
+}
+
+/*
+ * Common code for reads and writes.
+ */
+static cttk_bool
+oram_access(cttk_oram *o, size_t index, int op,
+	unsigned char *dst, const unsigned char *src)
+{
+	uint32_t rv[CTTK_ORAM_MAX_LEVELS << 1];
+	cttk_bool in;
+
+	o->rng(o->rng_ctx, rv, (size_t)o->num_levels * 2 * sizeof rv[0]);
+	in = cttk_u64_lt((uint64_t)index, (uint64_t)o->num_len);
+	level_access(o, 0, cttk_u32_mux(in, (uint32_t)index, 0), rv,
+		op, in, dst, src, 0, 0);
+	return cttk_u32_eq0(o->fail);
+}
+
+/* see cttk.h */
+cttk_bool
+cttk_oram_read(cttk_oram *o, void *d, size_t index)
+{
+	memset(d, 0, o->elt_len);
+	return oram_access(o, index, OP_READ, d, NULL);
+}
+
+/* see cttk.h */
+cttk_bool
+cttk_oram_write(cttk_oram *o, size_t index, const void *s)
+{
+	return oram_access(o, index, OP_WRITE, NULL, s);
+}
@@ -0,0 +1,255 @@
+/*
+ * Copyright (c) 2018 Thomas Pornin <pornin@bolet.org>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining 
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be 
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, 
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND 
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "inner.h"
+
+/*
+ * Oblivious sort with a bitonic sorting network.
+ *
+ * The network is defined for N elements, with N the smallest power of
+ * two not lower than the element count. It uses the "flip" variant, in
+ * which all comparators put the lowest key at the lowest index: for
+ * k = 2, 4, 8... N, a "flip" pass compares elements i and i^(k-1)
+ * (for all i with bit k/2 cleared), then "half-cleaner" passes compare
+ * i and i+j (for i with bit j cleared), for distances j = k/4 to 1.
+ * The missing elements (from the count up to N) behave as if they had
+ * keys greater than all real keys, so that the comparators that
+ * involve them never swap; they are simply skipped.
+ *
+ * Each pass is a set of N/2 independent comparators, which are
+ * identified by their pair index p (0 to N/2-1): with d the distance
+ * (k/2 for a flip pass, j for a half-cleaner), the lower element has
+ * index i = 2*(p - p mod d) + (p mod d).
+ *
+ * For cache efficiency, passes with distance d <= B/2 (with B a block
+ * of at most SORT_BLOCK bytes, and a power of two elements) only
+ * involve elements within the same aligned block. They are
+ * grouped: each block is sorted completely first (all passes for
+ * k <= B), then, for each k > B, all passes with short distances are
+ * performed block by block. Only passes with larger distances go over
+ * the whole array.
+ *
+ * The sequence of memory accesses depends only on the element count
+ * and sizes; compare-exchanges use cttk_array_cmp() and cttk_cond_swap()
+ * (and thus their vector implementations).
+ *
+ * In multi-threaded mode, each pass over the whole array, and each
+ * group of block-local passes, is split into independent jobs (ranges
+ * of pairs, or of blocks), which are handed over to the executor.
+ */
+
+#define SORT_BLOCK   32768
+
+typedef struct {
+	unsigned char *base;
+	size_t count;
+	size_t elt_len;
+	size_t key_off;
+	size_t key_len;
+
+	/* Block size (in elements), and number of blocks. */
+	size_t blen;
+	size_t num_blocks;
+
+	/* Number of pairs in each pass. */
+	size_t num_pairs;
+
+	/*
+	 * Current step: global pass (k, d) if local is 0; otherwise,
+	 * block-local passes for all k from kmin to kmax, with distances
+	 * up to blen/2 only.
+	 */
+	int local;
+	size_t k, d;
+	size_t kmin, kmax;
+
+	/* Number of jobs for the current step. */
+	size_t num_jobs;
+} sort_context;
+
+/*
+ * Compare-exchange of elements i and l (with i < l; skipped if l is
+ * beyond the element count).
+ */
+static void
+cmp_swap(const sort_context *sc, size_t i, size_t l)
+{
+	unsigned char *a, *b;
+	int32_t r;
+
+	if (l >= sc->count) {
+		return;
+	}
+	a = sc->base + i * sc->elt_len;
+	b = sc->base + l * sc->elt_len;
+	r = cttk_array_cmp(a + sc->key_off, b + sc->key_off, sc->key_len);
+	cttk_cond_swap(cttk_bool_of_u32((uint32_t)-r >> 31), a, b, sc->elt_len);
+}
+
+/*
+ * Process pairs p0 to p1-1 of the pass (k, d): this is a flip pass if
+ * d = k/2, a half-cleaner otherwise.
+ */
+static void
+run_pairs(const sort_context *sc, size_t k, size_t d, size_t p0, size_t p1)
+{
+	size_t p;
+
+	for (p = p0; p < p1; p ++) {
+		size_t i;
+
+		i = ((p & ~(d - 1)) << 1) | (p & (d - 1));
+		if (d == (k >> 1)) {
+			cmp_swap(sc, i, i ^ (k - 1));
+		} else {
+			cmp_swap(sc, i, i + d);
+		}
+	}
+}
+
+/*
+ * Process the block-local passes of the current step, for blocks b0
+ * to b1-1.
+ */
+static void
+run_blocks(const sort_context *sc, size_t b0, size_t b1)
+{
+	size_t b, hb;
+
+	hb = sc->blen >> 1;
+	for (b = b0; b < b1; b ++) {
+		size_t k;
+
+		if (b * sc->blen >= sc->count) {
+			break;
+		}
+		for (k = sc->kmin; k <= sc->kmax; k <<= 1) {
+			size_t d;
+
+			for (d = k > sc->blen ? hb : (k >> 1); d > 0; d >>= 1) {
+				run_pairs(sc, k, d, b * hb, (b + 1) * hb);
+			}
+		}
+	}
+}
+
+/*
+ * Job number idx (out of num_jobs) for the current step.
+ */
+static void
+sort_job(void *arg, size_t idx)
+{
+	const sort_context *sc;
+	size_t total, q, r, lo, hi;
+
+	sc = arg;
+	total = sc->local ? sc->num_blocks : sc->num_pairs;
+	q = total / sc->num_jobs;
+	r = total % sc->num_jobs;
+	lo = idx * q + (idx < r ? idx : r);
+	hi = lo + q + (idx < r);
+	if (sc->local) {
+		run_blocks(sc, lo, hi);
+	} else {
+		run_pairs(sc, sc->k, sc->d, lo, hi);
+	}
+}
+
+/*
+ * Run the current step, with the executor if there is one.
+ */
+static void
+run_step(sort_context *sc, size_t num_threads,
+	cttk_executor exec, void *exec_ctx)
+{
+	size_t total;
+
+	total = sc->local ? sc->num_blocks : sc->num_pairs;
+	if (exec == NULL || num_threads <= 1 || total <= 1) {
+		sc->num_jobs = 1;
+		sort_job(sc, 0);
+	} else {
+		sc->num_jobs = num_threads < total ? num_threads : total;
+		exec(exec_ctx, &sort_job, sc, sc->num_jobs);
+	}
+}
+
+/* see cttk.h */
+void
+cttk_oblivious_sort_mt(void *base, size_t count, size_t elt_len,
+	size_t key_off, size_t key_len,
+	unsigned num_threads, cttk_executor exec, void *exec_ctx)
+{
+	sort_context sc;
+	size_t n, k;
+
+	if (count <= 1 || elt_len == 0) {
+		return;
+	}
+	for (n = 2; n < count; n <<= 1);
+	sc.base = base;
+	sc.count = count;
+	sc.elt_len = elt_len;
+	sc.key_off = key_off;
+	sc.key_len = key_len;
+	sc.num_pairs = n >> 1;
+	for (sc.blen = 2; sc.blen < n
+		&& (sc.blen << 1) * elt_len <= SORT_BLOCK; sc.blen <<= 1);
+	sc.num_blocks = n / sc.blen;
+
+	/*
+	 * Sort each block.
+	 */
+	sc.local = 1;
+	sc.kmin = 2;
+	sc.kmax = sc.blen;
+	run_step(&sc, num_threads, exec, exec_ctx);
+
+	/*
+	 * Merge blocks.
+	 */
+	for (k = sc.blen << 1; k <= n; k <<= 1) {
+		size_t d;
+
+		sc.local = 0;
+		sc.k = k;
+		for (d = k >> 1; d >= sc.blen; d >>= 1) {
+			sc.d = d;
+			run_step(&sc, num_threads, exec, exec_ctx);
+		}
+		sc.local = 1;
+		sc.kmin = k;
+		sc.kmax = k;
+		run_step(&sc, num_threads, exec, exec_ctx);
+	}
+}
+
+/* see cttk.h */
+void
+cttk_oblivious_sort(void *base, size_t count, size_t elt_len,
+	size_t key_off, size_t key_len)
+{
+	cttk_oblivious_sort_mt(base, count, elt_len, key_off, key_len,
+		1, NULL, NULL);
+}
@@ -0,0 +1,125 @@
+/*
+ * Copyright (c) 2018 Thomas Pornin <pornin@bolet.org>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining 
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be 
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, 
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND 
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "inner.h"
+
+#if CTTK_STATS
+
+CTTK_TLS cttk_stats cttk_stats_tls;
+
+/*
+ * Nesting depth and start time of the current linear array access.
+ */
+static CTTK_TLS unsigned scan_depth;
+static CTTK_TLS uint64_t scan_start;
+
+static uint64_t (*stats_clock)(void) = NULL;
+
+/* see inner.h */
+void
+cttk_stats_scan_begin(size_t num, size_t bytes)
+{
+	if (scan_depth ++ != 0) {
+		return;
+	}
+	cttk_stats_tls.array_accesses += num;
+	cttk_stats_tls.array_bytes += bytes;
+	if (stats_clock != NULL) {
+		scan_start = stats_clock();
+	}
+}
+
+/* see inner.h */
+void
+cttk_stats_scan_end(void)
+{
+	if (-- scan_depth != 0) {
+		return;
+	}
+	if (stats_clock != NULL) {
+		cttk_stats_tls.array_time += stats_clock() - scan_start;
+	}
+}
+
+#if !CTTK_NO_MALLOC
+/* see inner.h */
+void *
+cttk_scratch_alloc(size_t len)
+{
+	void *p;
+
+	p = malloc(len);
+	cttk_stats_tls.scratch_allocs ++;
+	cttk_stats_tls.scratch_bytes += len;
+	cttk_stats_tls.scratch_failures += (p == NULL);
+	return p;
+}
+#endif
+
+/* see cttk.h */
+int
+cttk_stats_snapshot(cttk_stats *st)
+{
+	*st = cttk_stats_tls;
+	return 1;
+}
+
+/* see cttk.h */
+void
+cttk_stats_reset(void)
+{
+	memset(&cttk_stats_tls, 0, sizeof cttk_stats_tls);
+}
+
+/* see cttk.h */
+void
+cttk_stats_set_clock(uint64_t (*clock_fn)(void))
+{
+	stats_clock = clock_fn;
+}
+
+#else
+
+/* see cttk.h */
+int
+cttk_stats_snapshot(cttk_stats *st)
+{
+	memset(st, 0, sizeof *st);
+	return 0;
+}
+
+/* see cttk.h */
+void
+cttk_stats_reset(void)
+{
+}
+
+/* see cttk.h */
+void
+cttk_stats_set_clock(uint64_t (*clock_fn)(void))
+{
+	(void)clock_fn;
+}
+
+#endif
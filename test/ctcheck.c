@@ -0,0 +1,1051 @@
+/*
+ * Copyright (c) 2018 Thomas Pornin <pornin@bolet.org>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining 
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be 
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, 
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND 
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "cttk.h"
+
+/*
+ * Constant-time verification harness. Each check prepares inputs for
+ * one library function, then runs that function. Two modes are
+ * supported:
+ *
+ *  - dudect: the function is run many times, on inputs taken either
+ *    from a fixed value or at random (the class is chosen randomly for
+ *    each measure). Execution times of the two classes are compared
+ *    with Welch's t-test, on the raw measures and on measures cropped
+ *    at several percentiles; a high |t| shows that execution time
+ *    depends on the secret values. This is a statistical test: it can
+ *    only find leaks, not prove their absence.
+ *
+ *  - memcheck: when run under Valgrind, secret inputs are marked as
+ *    uninitialised; Valgrind then reports any conditional jump or
+ *    memory address that depends on them. Each check is run once, and
+ *    fails if the number of Valgrind errors increased. This requires
+ *    the Valgrind headers at compile time; otherwise, this mode is not
+ *    available.
+ *
+ * Public parameters (lengths, shift counts for the non-"prot"
+ * functions, character classes for decoders) are the same for both
+ * input classes. Decoders are not checked in memcheck mode, since the
+ * character classes (digit, whitespace, invalid) are computed from the
+ * same bits as the secret values, but are allowed to leak.
+ */
+
+#if defined __has_include
+#if __has_include(<valgrind/memcheck.h>)
+#include <valgrind/memcheck.h>
+#define HAVE_VALGRIND   1
+#endif
+#endif
+#ifndef HAVE_VALGRIND
+#define HAVE_VALGRIND   0
+#endif
+
+#if defined _MSC_VER && (defined _M_X64 || defined _M_IX86)
+#include <intrin.h>
+#define HAVE_TSC   1
+#elif (defined __GNUC__ || defined __clang__) \
+	&& (defined __x86_64__ || defined __i386__)
+#include <x86intrin.h>
+#define HAVE_TSC   1
+#else
+#define HAVE_TSC   0
+#endif
+#if HAVE_TSC && (defined __SSE2__ || defined _M_X64 \
+	|| (defined _M_IX86_FP && _M_IX86_FP >= 2))
+#define SERIALIZE   1
+#else
+#define SERIALIZE   0
+#endif
+
+/*
+ * Timestamp for one measure. Pending stores from the input preparation
+ * are drained first: otherwise, store-forwarding stalls when the
+ * measured function reads its inputs make the fixed class (for which
+ * the CPU learns the store/load pattern) faster than the random class.
+ *
+ * Without a TSC, clock() is used; its resolution is usually too coarse
+ * for short functions, and the dudect mode is then not meaningful for
+ * these.
+ */
+static uint64_t
+timestamp(void)
+{
+#if HAVE_TSC
+#if SERIALIZE
+	_mm_mfence();
+	_mm_lfence();
+#endif
+	return (uint64_t)__rdtsc();
+#else
+	return (uint64_t)clock();
+#endif
+}
+
+/*
+ * In memcheck mode, secret() marks a memory area as uninitialised, and
+ * public() marks it as initialised again.
+ */
+static int memcheck = 0;
+
+static void
+secret(void *p, size_t len)
+{
+#if HAVE_VALGRIND
+	if (memcheck) {
+		VALGRIND_MAKE_MEM_UNDEFINED(p, len);
+	}
+#else
+	(void)p;
+	(void)len;
+#endif
+}
+
+static void
+public(void *p, size_t len)
+{
+#if HAVE_VALGRIND
+	if (memcheck) {
+		VALGRIND_MAKE_MEM_DEFINED(p, len);
+	}
+#else
+	(void)p;
+	(void)len;
+#endif
+}
+
+/*
+ * PRNG for test inputs (xorshift64*).
+ */
+static uint64_t rnd_state = 0x2545F4914F6CDD1D;
+
+static uint64_t
+rnd64(void)
+{
+	rnd_state ^= rnd_state >> 12;
+	rnd_state ^= rnd_state << 25;
+	rnd_state ^= rnd_state >> 27;
+	return rnd_state * 0x2545F4914F6CDD1D;
+}
+
+static void
+rnd(void *dst, size_t len)
+{
+	unsigned char *buf;
+	size_t u;
+
+	buf = dst;
+	for (u = 0; u < len; u ++) {
+		buf[u] = (unsigned char)(rnd64() >> 56);
+	}
+}
+
+static void *
+xmalloc(size_t len)
+{
+	void *p;
+
+	p = malloc(len == 0 ? 1 : len);
+	if (p == NULL) {
+		fprintf(stderr, "memory allocation failed\n");
+		exit(EXIT_FAILURE);
+	}
+	return p;
+}
+
+/*
+ * Input source: class 0 uses a fixed value, class 1 a random value.
+ * Both are produced by the same PRNG (class 0 restarts it from a fixed
+ * seed that depends on 'off'), so that input preparation has the same
+ * cost and leaves the caches in the same state for both classes. The
+ * PRNG state is selected without any conditional jump; otherwise, the
+ * branch history at the start of the measured function would differ
+ * between classes, and so would the branch predictions. The fixed seed
+ * is itself chosen randomly at startup: a fixed all-zero value would
+ * not exercise the same code paths (e.g. a zero divisor).
+ */
+static uint64_t fixed_seed;
+
+static void
+input(void *dst, size_t len, size_t off, int cls)
+{
+	uint64_t save, m;
+
+	m = -(uint64_t)(cls & 1);
+	save = rnd_state;
+	rnd_state = (save & m) | ((fixed_seed + (uint64_t)off) & ~m);
+	rnd(dst, len);
+	rnd_state = (rnd_state & m) | (save & ~m);
+}
+
+/* ==================================================================== */
+/*
+ * Test state. All checks share the same buffers.
+ */
+
+#define INT_SIZE   1024
+#define INT_LEN    ((INT_SIZE + 61) / 31)
+#define BUF_LEN    1024
+#define ARR_ELT    16
+#define ARR_NUM    64
+#define ARR_MANY   4
+
+static uint32_t ia[INT_LEN], ib[INT_LEN], id[INT_LEN], ir[INT_LEN];
+static cttk_d31_def(idc, INT_SIZE);
+static uint32_t shift_count;
+static unsigned char bin1[BUF_LEN], bin2[BUF_LEN];
+static unsigned char arr[ARR_ELT * ARR_NUM];
+static char str[2 * BUF_LEN + 64];
+static size_t str_len, arr_index, arr_many[ARR_MANY];
+static cttk_bool ctl;
+static volatile uint32_t sink;
+
+#if HAVE_VALGRIND
+static void
+reset_state(void)
+{
+	public(ia, sizeof ia);
+	public(ib, sizeof ib);
+	public(id, sizeof id);
+	public(ir, sizeof ir);
+	public(idc, sizeof idc);
+	public(&shift_count, sizeof shift_count);
+	public(bin1, sizeof bin1);
+	public(bin2, sizeof bin2);
+	public(arr, sizeof arr);
+	public(str, sizeof str);
+	public(&arr_index, sizeof arr_index);
+	public(&ctl, sizeof ctl);
+}
+#endif
+
+/*
+ * Set x to a random value of 'len' bytes (at most INT_SIZE / 8, and
+ * non-negative), with bit 'bit' forced to 1 (unless 'bit' is negative).
+ * All value words (but not the header word) are marked secret.
+ */
+static void
+input_int(uint32_t *x, size_t len, size_t off, int bit, int cls)
+{
+	unsigned char tmp[INT_SIZE >> 3];
+
+	input(tmp, len, off, cls);
+	tmp[0] &= 0x7F;
+	if (bit >= 0) {
+		tmp[len - 1 - (bit >> 3)] |= 1 << (bit & 7);
+	}
+	cttk_i31_init(x, INT_SIZE);
+	cttk_i31_decbe_signed(x, tmp, len);
+	secret(x + 1, (INT_LEN - 1) * sizeof(uint32_t));
+}
+
+/* ==================================================================== */
+/*
+ * Checks: i31.
+ */
+
+static void
+prep_int2(int cls)
+{
+	input_int(ia, INT_SIZE >> 3, 0, -1, cls);
+	input_int(ib, INT_SIZE >> 3, 256, -1, cls);
+	cttk_i31_init(id, INT_SIZE);
+	cttk_i31_init(ir, INT_SIZE);
+}
+
+static void
+prep_int2_half(int cls)
+{
+	input_int(ia, INT_SIZE >> 4, 0, -1, cls);
+	input_int(ib, INT_SIZE >> 4, 256, -1, cls);
+	cttk_i31_init(id, INT_SIZE);
+}
+
+static void
+prep_int_div(int cls)
+{
+	input_int(ia, INT_SIZE >> 3, 0, -1, cls);
+	input_int(ib, INT_SIZE >> 4, 256, 0, cls);
+	cttk_i31_init(id, INT_SIZE);
+	cttk_i31_init(ir, INT_SIZE);
+}
+
+static void
+prep_int_shift(int cls)
+{
+	input_int(ia, INT_SIZE >> 3, 0, -1, cls);
+	cttk_i31_init(id, INT_SIZE);
+	shift_count = 37;
+}
+
+static void
+prep_int_shift_prot(int cls)
+{
+	input(&shift_count, sizeof shift_count, 512, cls);
+	shift_count &= INT_SIZE - 1;
+	secret(&shift_count, sizeof shift_count);
+	input_int(ia, INT_SIZE >> 3, 0, -1, cls);
+	cttk_i31_init(id, INT_SIZE);
+}
+
+static void
+prep_int_codec(int cls)
+{
+	input(bin1, INT_SIZE >> 3, 0, cls);
+	secret(bin1, INT_SIZE >> 3);
+	cttk_i31_init(ia, INT_SIZE);
+}
+
+static void
+run_i31_add(void)
+{
+	cttk_i31_add(id, ia, ib);
+}
+
+static void
+run_i31_sub(void)
+{
+	cttk_i31_sub(id, ia, ib);
+}
+
+static void
+run_i31_mul(void)
+{
+	cttk_i31_mul(id, ia, ib);
+}
+
+static void
+run_i31_divrem(void)
+{
+	cttk_i31_divrem(id, ir, ia, ib);
+}
+
+static void
+run_i31_mod(void)
+{
+	cttk_i31_mod(ir, ia, ib);
+}
+
+static void
+run_i31_lsh(void)
+{
+	cttk_i31_lsh_trunc(id, ia, shift_count);
+}
+
+static void
+run_i31_rsh(void)
+{
+	cttk_i31_rsh(id, ia, shift_count);
+}
+
+static void
+run_i31_lsh_prot(void)
+{
+	cttk_i31_lsh_trunc_prot(id, ia, shift_count);
+}
+
+static void
+run_i31_rsh_prot(void)
+{
+	cttk_i31_rsh_prot(id, ia, shift_count);
+}
+
+static void
+run_i31_cmp(void)
+{
+	sink = cttk_i31_lt(ia, ib).v ^ cttk_i31_eq(ia, ib).v;
+}
+
+static void
+run_i31_decbe(void)
+{
+	cttk_i31_decbe_signed(ia, bin1, INT_SIZE >> 3);
+}
+
+static void
+run_i31_encbe(void)
+{
+	cttk_i31_encbe(bin2, INT_SIZE >> 3, ia);
+}
+
+static void
+prep_i31_encbe(int cls)
+{
+	input_int(ia, INT_SIZE >> 3, 0, -1, cls);
+}
+
+static void
+run_i31_enchex(void)
+{
+	cttk_i31_enchex(str, sizeof str, ia, INT_SIZE >> 3, 0);
+}
+
+static void
+run_i31_encb64(void)
+{
+	cttk_i31_encb64(str, sizeof str, ia, INT_SIZE >> 3, 0);
+}
+
+static void
+prep_i31_hex_str(int cls)
+{
+	input(bin1, INT_SIZE >> 3, 0, cls);
+	bin1[0] &= 0x7F;
+	str_len = cttk_bintohex_gen(str, sizeof str, bin1, INT_SIZE >> 3, 0);
+	cttk_i31_init(ia, INT_SIZE);
+}
+
+static void
+run_i31_dechex(void)
+{
+	cttk_i31_dechex(ia, str, str_len, NULL, CTTK_I31_SIGNED);
+}
+
+static void
+prep_int_gcd(int cls)
+{
+	input_int(ia, INT_SIZE >> 3, 0, -1, cls);
+	input_int(ib, INT_SIZE >> 3, 256, -1, cls);
+	cttk_i31_init(id, INT_SIZE);
+}
+
+/*
+ * The modulus (odd, positive) is the same for both classes, and public;
+ * only the value to invert is secret.
+ */
+static void
+prep_int_modinv(int cls)
+{
+	input_int(ia, INT_SIZE >> 3, 0, -1, cls);
+	input_int(ib, INT_SIZE >> 3, 256, 0, 0);
+	public(ib + 1, (INT_LEN - 1) * sizeof(uint32_t));
+	cttk_i31_init(id, INT_SIZE);
+}
+
+static void
+run_i31_gcd(void)
+{
+	cttk_i31_gcd(id, ia, ib);
+}
+
+static void
+run_i31_modinv(void)
+{
+	cttk_i31_modinv(id, ia, ib);
+}
+
+/*
+ * The divisor context is built from a fixed, public divisor; only the
+ * dividend is secret.
+ */
+static void
+prep_d31(int cls)
+{
+	input_int(ia, INT_SIZE >> 3, 0, -1, cls);
+	input_int(ib, INT_SIZE >> 4, 256, 0, 0);
+	public(ib + 1, (INT_LEN - 1) * sizeof(uint32_t));
+	cttk_d31_init(idc, ib);
+	cttk_i31_init(id, INT_SIZE);
+	cttk_i31_init(ir, INT_SIZE);
+}
+
+static void
+run_d31_divrem(void)
+{
+	cttk_d31_divrem(id, ir, ia, idc);
+}
+
+static void
+run_d31_mod(void)
+{
+	cttk_d31_mod(ir, ia, idc);
+}
+
+static void
+run_i31_encdec(void)
+{
+	cttk_i31_encdec(str, sizeof str, ia, 0);
+}
+
+/*
+ * Decimal input: a sign and 300 digits (which fits in INT_SIZE bits).
+ * The string length is public; the sign and the digits differ between
+ * classes. Only the digits are marked secret for memcheck, since the
+ * presence of the sign character is allowed to leak.
+ */
+static void
+prep_i31_dec_str(int cls)
+{
+	size_t u;
+
+	input(bin1, 301, 0, cls);
+	str[0] = (bin1[300] & 1) != 0 ? '-' : '+';
+	for (u = 0; u < 300; u ++) {
+		str[u + 1] = (char)('0' + bin1[u] % 10);
+	}
+	str_len = 301;
+	secret(str + 1, 300);
+	cttk_i31_init(ia, INT_SIZE);
+}
+
+static void
+run_i31_decdec(void)
+{
+	cttk_i31_decdec(ia, str, str_len);
+}
+
+/* ==================================================================== */
+/*
+ * Checks: conditional copies, array accesses and comparisons.
+ */
+
+static void
+prep_cond(int cls)
+{
+	unsigned char b;
+
+	input(&b, 1, 1024, cls);
+	ctl = cttk_bool_of_u32(b & 1);
+	secret(&ctl, sizeof ctl);
+	input(bin1, BUF_LEN, 0, cls);
+	input(bin2, BUF_LEN, 1024, cls);
+	secret(bin1, BUF_LEN);
+	secret(bin2, BUF_LEN);
+}
+
+static void
+prep_array(int cls)
+{
+	input(&arr_index, sizeof arr_index, 2048, cls);
+	arr_index %= ARR_NUM;
+	secret(&arr_index, sizeof arr_index);
+	input(arr, sizeof arr, 0, cls);
+	input(bin1, ARR_ELT, 3072, cls);
+	secret(arr, sizeof arr);
+	secret(bin1, ARR_ELT);
+}
+
+static void
+prep_array_many(int cls)
+{
+	size_t u;
+
+	input(arr_many, sizeof arr_many, 2048, cls);
+	for (u = 0; u < ARR_MANY; u ++) {
+		arr_many[u] %= ARR_NUM;
+	}
+	secret(arr_many, sizeof arr_many);
+	input(arr, sizeof arr, 0, cls);
+	input(bin1, ARR_ELT * ARR_MANY, 3072, cls);
+	secret(arr, sizeof arr);
+	secret(bin1, ARR_ELT * ARR_MANY);
+}
+
+static void
+prep_cmp(int cls)
+{
+	size_t u;
+
+	input(bin1, BUF_LEN, 0, cls);
+	memcpy(bin2, bin1, BUF_LEN);
+	input(&u, sizeof u, 2048, cls);
+	bin2[u % BUF_LEN] ^= 0x01;
+	secret(bin1, BUF_LEN);
+	secret(bin2, BUF_LEN);
+}
+
+static void
+run_cond_copy(void)
+{
+	cttk_cond_copy(ctl, bin1, bin2, BUF_LEN);
+}
+
+static void
+run_cond_swap(void)
+{
+	cttk_cond_swap(ctl, bin1, bin2, BUF_LEN);
+}
+
+static void
+run_array_read(void)
+{
+	cttk_array_read(bin2, arr, ARR_ELT, ARR_NUM, arr_index);
+}
+
+static void
+run_array_write(void)
+{
+	cttk_array_write(arr, ARR_ELT, ARR_NUM, arr_index, bin1);
+}
+
+/*
+ * Sequential executor, for the multi-threaded variants.
+ */
+static void
+seq_exec(void *exec_ctx, void (*job)(void *arg, size_t idx),
+	void *arg, size_t num)
+{
+	size_t u;
+
+	(void)exec_ctx;
+	for (u = 0; u < num; u ++) {
+		job(arg, u);
+	}
+}
+
+static void
+run_array_read_mt(void)
+{
+	cttk_array_read_mt(bin2, arr, ARR_ELT, ARR_NUM, arr_index,
+		4, seq_exec, NULL);
+}
+
+static void
+run_array_read_many(void)
+{
+	cttk_array_read_many(bin2, arr, ARR_ELT, ARR_NUM, arr_many, ARR_MANY);
+}
+
+static void
+run_array_write_many(void)
+{
+	cttk_array_write_many(arr, ARR_ELT, ARR_NUM, arr_many, ARR_MANY, bin1);
+}
+
+static void
+prep_sort(int cls)
+{
+	input(arr, sizeof arr, 0, cls);
+	secret(arr, sizeof arr);
+}
+
+static void
+run_oblivious_sort(void)
+{
+	cttk_oblivious_sort(arr, ARR_NUM, ARR_ELT, 0, 8);
+}
+
+static void
+run_bitslice8(void)
+{
+	uint32_t q[64];
+
+	cttk_bitslice_in8(q, bin1, 256);
+	cttk_bitslice_out8(bin2, q, 256);
+}
+
+static void
+run_array_eq(void)
+{
+	sink = cttk_array_eq(bin1, bin2, BUF_LEN).v;
+}
+
+static void
+run_array_cmp(void)
+{
+	sink = (uint32_t)cttk_array_cmp(bin1, bin2, BUF_LEN);
+}
+
+/* ==================================================================== */
+/*
+ * Checks: hexadecimal and Base64. Decoders get a valid string made
+ * from secret bytes; only the decoded values differ between classes.
+ */
+
+static void
+prep_bin(int cls)
+{
+	input(bin1, BUF_LEN, 0, cls);
+	secret(bin1, BUF_LEN);
+}
+
+static void
+prep_hex_str(int cls)
+{
+	input(bin1, BUF_LEN, 0, cls);
+	str_len = cttk_bintohex_gen(str, sizeof str, bin1, BUF_LEN, 0);
+}
+
+static void
+prep_b64_str(int cls)
+{
+	input(bin1, BUF_LEN, 0, cls);
+	str_len = cttk_bintob64_gen(str, sizeof str, bin1, BUF_LEN,
+		CTTK_B64ENC_NEWLINE);
+}
+
+static void
+run_bintohex(void)
+{
+	cttk_bintohex_gen(str, sizeof str, bin1, BUF_LEN, 0);
+}
+
+static void
+run_hextobin(void)
+{
+	cttk_hextobin_gen(bin2, BUF_LEN, str, str_len, NULL, 0);
+}
+
+static void
+run_bintob64(void)
+{
+	cttk_bintob64_gen(str, sizeof str, bin1, BUF_LEN, 0);
+}
+
+static void
+run_bintob64_lines(void)
+{
+	cttk_bintob64_gen(str, sizeof str, bin1, BUF_LEN,
+		CTTK_B64ENC_NEWLINE);
+}
+
+static void
+run_b64tobin(void)
+{
+	cttk_b64tobin_gen(bin2, BUF_LEN, str, str_len, NULL, 0);
+}
+
+/* ==================================================================== */
+
+typedef struct {
+	const char *name;
+	void (*prep)(int cls);
+	void (*run)(void);
+	int memcheck;
+} ct_check;
+
+static const ct_check checks[] = {
+	{ "i31_add",           prep_int2,           run_i31_add,        1 },
+	{ "i31_sub",           prep_int2,           run_i31_sub,        1 },
+	{ "i31_mul",           prep_int2_half,      run_i31_mul,        1 },
+	{ "i31_divrem",        prep_int_div,        run_i31_divrem,     1 },
+	{ "i31_mod",           prep_int_div,        run_i31_mod,        1 },
+	{ "i31_lsh_trunc",     prep_int_shift,      run_i31_lsh,        1 },
+	{ "i31_rsh",           prep_int_shift,      run_i31_rsh,        1 },
+	{ "i31_lsh_trunc_prot", prep_int_shift_prot, run_i31_lsh_prot,  1 },
+	{ "i31_rsh_prot",      prep_int_shift_prot, run_i31_rsh_prot,   1 },
+	{ "i31_lt_eq",         prep_int2,           run_i31_cmp,        1 },
+	{ "i31_decbe_signed",  prep_int_codec,      run_i31_decbe,      1 },
+	{ "i31_encbe",         prep_i31_encbe,      run_i31_encbe,      1 },
+	{ "i31_enchex",        prep_i31_encbe,      run_i31_enchex,     1 },
+	{ "i31_encb64",        prep_i31_encbe,      run_i31_encb64,     1 },
+	{ "i31_dechex",        prep_i31_hex_str,    run_i31_dechex,     0 },
+	{ "i31_gcd",           prep_int_gcd,        run_i31_gcd,        1 },
+	{ "i31_modinv",        prep_int_modinv,     run_i31_modinv,     1 },
+	{ "d31_divrem",        prep_d31,            run_d31_divrem,     1 },
+	{ "d31_mod",           prep_d31,            run_d31_mod,        1 },
+	{ "i31_encdec",        prep_i31_encbe,      run_i31_encdec,     1 },
+	{ "i31_decdec",        prep_i31_dec_str,    run_i31_decdec,     1 },
+	{ "cond_copy",         prep_cond,           run_cond_copy,      1 },
+	{ "cond_swap",         prep_cond,           run_cond_swap,      1 },
+	{ "array_read",        prep_array,          run_array_read,     1 },
+	{ "array_write",       prep_array,          run_array_write,    1 },
+	{ "array_read_mt",     prep_array,          run_array_read_mt,  1 },
+	{ "array_read_many",   prep_array_many,     run_array_read_many, 1 },
+	{ "array_write_many",  prep_array_many,     run_array_write_many, 1 },
+	{ "oblivious_sort",    prep_sort,           run_oblivious_sort, 1 },
+	{ "bitslice8",         prep_bin,            run_bitslice8,      1 },
+	{ "array_eq",          prep_cmp,            run_array_eq,       1 },
+	{ "array_cmp",         prep_cmp,            run_array_cmp,      1 },
+	{ "bintohex",          prep_bin,            run_bintohex,       1 },
+	{ "hextobin",          prep_hex_str,        run_hextobin,       0 },
+	{ "bintob64",          prep_bin,            run_bintob64,       1 },
+	{ "bintob64_lines",    prep_bin,            run_bintob64_lines, 1 },
+	{ "b64tobin",          prep_b64_str,        run_b64tobin,       0 },
+	{ NULL, 0, 0, 0 }
+};
+
+/* ==================================================================== */
+/*
+ * Welch's t-test, with the cropping strategy from dudect: besides the
+ * raw measures, the test is also applied to the measures below some
+ * percentiles (computed over all measures), since the upper tail is
+ * mostly noise (interrupts, context switches...). The reported value
+ * is the maximum |t| over all these tests.
+ */
+
+static double
+dsqrt(double x)
+{
+	double y;
+	int i;
+
+	if (x <= 0.0) {
+		return 0.0;
+	}
+	y = x >= 1.0 ? x : 1.0;
+	for (i = 0; i < 200; i ++) {
+		double z;
+
+		z = 0.5 * (y + x / y);
+		if (z >= y) {
+			break;
+		}
+		y = z;
+	}
+	return y;
+}
+
+static int
+cmp_u64(const void *a, const void *b)
+{
+	uint64_t x, y;
+
+	x = *(const uint64_t *)a;
+	y = *(const uint64_t *)b;
+	return x < y ? -1 : x > y ? 1 : 0;
+}
+
+static double
+welch_t(const uint64_t *tt, const unsigned char *cls, long num, uint64_t max)
+{
+	double n[2], mean[2], m2[2];
+	double v;
+	long l;
+	int c;
+
+	for (c = 0; c < 2; c ++) {
+		n[c] = 0.0;
+		mean[c] = 0.0;
+		m2[c] = 0.0;
+	}
+	for (l = 0; l < num; l ++) {
+		double x, d;
+
+		if (tt[l] > max) {
+			continue;
+		}
+		c = cls[l];
+		x = (double)tt[l];
+		n[c] += 1.0;
+		d = x - mean[c];
+		mean[c] += d / n[c];
+		m2[c] += d * (x - mean[c]);
+	}
+	if (n[0] < 2.0 || n[1] < 2.0) {
+		return 0.0;
+	}
+	v = m2[0] / ((n[0] - 1.0) * n[0]) + m2[1] / ((n[1] - 1.0) * n[1]);
+	if (v <= 0.0) {
+		return 0.0;
+	}
+	v = (mean[0] - mean[1]) / dsqrt(v);
+	return v < 0.0 ? -v : v;
+}
+
+static double
+dudect(const ct_check *ck, long num)
+{
+	static const double crops[] = {
+		0.50, 0.70, 0.80, 0.90, 0.95, 0.98, 0.99, 0.995, 0.999, 0.0
+	};
+	uint64_t *tt, *sorted;
+	unsigned char *cls;
+	double t, tmax;
+	long l, warmup;
+	int i;
+
+	tt = xmalloc((size_t)num * sizeof *tt);
+	sorted = xmalloc((size_t)num * sizeof *sorted);
+	cls = xmalloc((size_t)num);
+	warmup = num / 16;
+	for (l = -warmup; l < num; l ++) {
+		uint64_t t0, t1;
+		int c;
+
+		c = (int)(rnd64() >> 63);
+		ck->prep(c);
+		t0 = timestamp();
+		ck->run();
+		t1 = timestamp();
+		if (l >= 0) {
+			tt[l] = t1 - t0;
+			cls[l] = (unsigned char)c;
+		}
+	}
+
+	memcpy(sorted, tt, (size_t)num * sizeof *tt);
+	qsort(sorted, (size_t)num, sizeof *sorted, cmp_u64);
+	tmax = welch_t(tt, cls, num, sorted[num - 1]);
+	for (i = 0; crops[i] != 0.0; i ++) {
+		t = welch_t(tt, cls, num, sorted[(long)(crops[i] * (num - 1))]);
+		if (t > tmax) {
+			tmax = t;
+		}
+	}
+	free(tt);
+	free(sorted);
+	free(cls);
+	return tmax;
+}
+
+/*
+ * Memcheck mode: run the check once on secret inputs, and return the
+ * number of errors reported by Valgrind.
+ */
+static unsigned long
+memcheck_run(const ct_check *ck)
+{
+#if HAVE_VALGRIND
+	unsigned long e0, e1;
+
+	reset_state();
+	ck->prep(1);
+	e0 = VALGRIND_COUNT_ERRORS;
+	ck->run();
+	e1 = VALGRIND_COUNT_ERRORS;
+	reset_state();
+	return e1 - e0;
+#else
+	(void)ck;
+	return 0;
+#endif
+}
+
+/* ==================================================================== */
+
+static void
+usage(void)
+{
+	fprintf(stderr,
+"usage: ctcheck [ options ] [ name... ]\n"
+"options:\n"
+"   -n num      number of measures per function (default: 100000)\n"
+"   -t thr      failure threshold for |t| (default: 10)\n"
+"   -list       list the checked functions and exit\n"
+"If names are provided, then only the functions whose name starts\n"
+"with one of them are checked. Run under Valgrind (memcheck) to\n"
+"trace secret-dependent branches and memory accesses instead of\n"
+"measuring timings.\n");
+	exit(EXIT_FAILURE);
+}
+
+int
+main(int argc, char *argv[])
+{
+	long num;
+	double thr;
+	char **filters;
+	int i, num_filters, num_fail;
+
+	num = 100000;
+	thr = 10.0;
+	filters = xmalloc((size_t)argc * sizeof(char *));
+	num_filters = 0;
+	for (i = 1; i < argc; i ++) {
+		const char *arg;
+
+		arg = argv[i];
+		if (strcmp(arg, "-n") == 0) {
+			if (++ i >= argc) {
+				usage();
+			}
+			num = atol(argv[i]);
+			if (num < 100) {
+				usage();
+			}
+		} else if (strcmp(arg, "-t") == 0) {
+			if (++ i >= argc) {
+				usage();
+			}
+			thr = atof(argv[i]);
+			if (!(thr > 0.0)) {
+				usage();
+			}
+		} else if (strcmp(arg, "-list") == 0) {
+			int j;
+
+			for (j = 0; checks[j].name != NULL; j ++) {
+				printf("%s\n", checks[j].name);
+			}
+			return 0;
+		} else if (arg[0] == '-') {
+			usage();
+		} else {
+			filters[num_filters ++] = argv[i];
+		}
+	}
+
+#if HAVE_VALGRIND
+	memcheck = RUNNING_ON_VALGRIND != 0;
+#endif
+	fixed_seed = rnd64() | 1;
+	printf("ctcheck: %s mode", memcheck ? "memcheck" : "dudect");
+	if (!memcheck) {
+		printf(", %ld measures, threshold |t| < %.2f", num, thr);
+	}
+	printf("\n");
+
+	num_fail = 0;
+	for (i = 0; checks[i].name != NULL; i ++) {
+		const ct_check *ck;
+		int j, ok;
+
+		ck = &checks[i];
+		if (num_filters > 0) {
+			for (j = 0; j < num_filters; j ++) {
+				if (strncmp(ck->name, filters[j],
+					strlen(filters[j])) == 0)
+				{
+					break;
+				}
+			}
+			if (j == num_filters) {
+				continue;
+			}
+		}
+		printf("%-20s ", ck->name);
+		fflush(stdout);
+		if (memcheck) {
+			unsigned long err;
+
+			if (!ck->memcheck) {
+				printf("skipped\n");
+				continue;
+			}
+			err = memcheck_run(ck);
+			ok = (err == 0);
+			printf("errors = %-6lu %s\n", err, ok ? "PASS" : "FAIL");
+		} else {
+			double t;
+
+			t = dudect(ck, num);
+			ok = (t < thr);
+			printf("|t| = %8.2f  %s\n", t, ok ? "PASS" : "FAIL");
+		}
+		fflush(stdout);
+		if (!ok) {
+			num_fail ++;
+		}
+	}
+
+	printf("ctcheck: %d failure(s)\n", num_fail);
+	free(filters);
+	return num_fail == 0 ? 0 : 1;
+}
@@ -0,0 +1,932 @@
+/*
+ * Copyright (c) 2018 Thomas Pornin <pornin@bolet.org>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining 
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be 
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, 
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND 
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "cttk.h"
+
+/*
+ * Speed benchmarks. Each benchmark is a function that performs a given
+ * number of iterations of the measured operation. The number of
+ * iterations is doubled until the run lasts long enough; the last run
+ * provides the reported figures.
+ *
+ * Time is measured with clock() (processor time). On x86, the TSC is
+ * also read; note that the TSC ticks at a fixed rate, which is not
+ * necessarily the actual core frequency (e.g. with "turbo" modes), so
+ * cycle counts are only comparable between runs on the same machine.
+ */
+
+#if defined _MSC_VER && (defined _M_X64 || defined _M_IX86)
+#include <intrin.h>
+#define HAVE_TSC   1
+#elif (defined __GNUC__ || defined __clang__) \
+	&& (defined __x86_64__ || defined __i386__)
+#include <x86intrin.h>
+#define HAVE_TSC   1
+#else
+#define HAVE_TSC   0
+#endif
+
+static uint64_t
+read_tsc(void)
+{
+#if HAVE_TSC
+	return (uint64_t)__rdtsc();
+#else
+	return 0;
+#endif
+}
+
+/*
+ * PRNG for benchmark inputs (xorshift64*). Values do not matter for
+ * constant-time code, but we want realistic operands nonetheless.
+ */
+static uint64_t rnd_state = 0x9E3779B97F4A7C15;
+
+static void
+rnd(void *dst, size_t len)
+{
+	unsigned char *buf;
+	size_t u;
+
+	buf = dst;
+	for (u = 0; u < len; u ++) {
+		rnd_state ^= rnd_state >> 12;
+		rnd_state ^= rnd_state << 25;
+		rnd_state ^= rnd_state >> 27;
+		buf[u] = (unsigned char)((rnd_state * 0x2545F4914F6CDD1D) >> 56);
+	}
+}
+
+static void *
+xmalloc(size_t len)
+{
+	void *p;
+
+	p = malloc(len == 0 ? 1 : len);
+	if (p == NULL) {
+		fprintf(stderr, "memory allocation failed\n");
+		exit(EXIT_FAILURE);
+	}
+	return p;
+}
+
+/* ==================================================================== */
+/*
+ * Output: plain text, CSV or JSON.
+ */
+
+#define OUT_TEXT   0
+#define OUT_CSV    1
+#define OUT_JSON   2
+
+static int out_format = OUT_TEXT;
+static int out_count = 0;
+static double min_time = 0.25;
+static char **filters = NULL;
+static int num_filters = 0;
+
+static int
+selected(const char *name)
+{
+	int i;
+
+	if (num_filters == 0) {
+		return 1;
+	}
+	for (i = 0; i < num_filters; i ++) {
+		if (strncmp(name, filters[i], strlen(filters[i])) == 0) {
+			return 1;
+		}
+	}
+	return 0;
+}
+
+static void
+out_begin(void)
+{
+	switch (out_format) {
+	case OUT_CSV:
+		printf("name,param,iterations,"
+			"ns_per_op,cycles_per_op,mb_per_s\n");
+		break;
+	case OUT_JSON:
+		printf("{\n  \"tsc\": %s,\n  \"results\": [",
+			HAVE_TSC ? "true" : "false");
+		break;
+	}
+	fflush(stdout);
+}
+
+static void
+out_end(void)
+{
+	if (out_format == OUT_JSON) {
+		printf("%s]\n}\n", out_count > 0 ? "\n  " : "");
+	}
+	fflush(stdout);
+}
+
+/*
+ * Report one result. 'bytes' is the amount of data processed per
+ * operation; if zero, no throughput is reported.
+ */
+static void
+out_result(const char *name, const char *param, long num,
+	double tt, uint64_t cc, size_t bytes)
+{
+	double ns, cy, mbps;
+
+	ns = tt * 1e9 / (double)num;
+	cy = (double)cc / (double)num;
+	mbps = bytes == 0 ? 0.0 : ((double)bytes * (double)num) / (tt * 1e6);
+	switch (out_format) {
+	case OUT_TEXT:
+		printf("%-16s %-10s %12.2f ns/op", name, param, ns);
+		if (HAVE_TSC) {
+			printf(" %12.1f cycles/op", cy);
+		}
+		if (bytes != 0) {
+			printf(" %10.2f MB/s", mbps);
+		}
+		printf("\n");
+		break;
+	case OUT_CSV:
+		printf("%s,%s,%ld,%.3f,", name, param, num, ns);
+		if (HAVE_TSC) {
+			printf("%.1f", cy);
+		}
+		printf(",");
+		if (bytes != 0) {
+			printf("%.2f", mbps);
+		}
+		printf("\n");
+		break;
+	case OUT_JSON:
+		printf("%s\n    { \"name\": \"%s\", \"param\": \"%s\","
+			" \"iterations\": %ld, \"ns_per_op\": %.3f,",
+			out_count > 0 ? "," : "", name, param, num, ns);
+		if (HAVE_TSC) {
+			printf(" \"cycles_per_op\": %.1f,", cy);
+		} else {
+			printf(" \"cycles_per_op\": null,");
+		}
+		if (bytes != 0) {
+			printf(" \"mb_per_s\": %.2f }", mbps);
+		} else {
+			printf(" \"mb_per_s\": null }");
+		}
+		break;
+	}
+	out_count ++;
+	fflush(stdout);
+}
+
+/*
+ * Run a benchmark: 'fn' is called with 'ctx' and an iteration count.
+ */
+static void
+run_bench(const char *name, const char *param, size_t bytes,
+	void (*fn)(void *ctx, long num), void *ctx)
+{
+	long num;
+
+	if (!selected(name)) {
+		return;
+	}
+	num = 1;
+	for (;;) {
+		clock_t begin, end;
+		uint64_t c0, c1;
+		double tt;
+
+		begin = clock();
+		c0 = read_tsc();
+		fn(ctx, num);
+		c1 = read_tsc();
+		end = clock();
+		tt = (double)(end - begin) / CLOCKS_PER_SEC;
+		if (tt >= min_time || num >= (1L << 30)) {
+			out_result(name, param, num, tt, c1 - c0, bytes);
+			return;
+		}
+		num <<= 1;
+	}
+}
+
+/* ==================================================================== */
+/*
+ * Big integers (i31).
+ */
+
+typedef struct {
+	uint32_t *a, *b, *d, *q, *r;
+} i31_ctx;
+
+static void
+bench_i31_add(void *ctx, long num)
+{
+	i31_ctx *ic;
+	long l;
+
+	ic = ctx;
+	for (l = 0; l < num; l ++) {
+		cttk_i31_add(ic->d, ic->a, ic->b);
+	}
+}
+
+static void
+bench_i31_mul(void *ctx, long num)
+{
+	i31_ctx *ic;
+	long l;
+
+	ic = ctx;
+	for (l = 0; l < num; l ++) {
+		cttk_i31_mul(ic->d, ic->q, ic->b);
+	}
+}
+
+static void
+bench_i31_sqr(void *ctx, long num)
+{
+	i31_ctx *ic;
+	long l;
+
+	ic = ctx;
+	for (l = 0; l < num; l ++) {
+		cttk_i31_sqr(ic->d, ic->q);
+	}
+}
+
+static void
+bench_i31_muladd(void *ctx, long num)
+{
+	i31_ctx *ic;
+	long l;
+
+	ic = ctx;
+	for (l = 0; l < num; l ++) {
+		cttk_i31_muladd(ic->d, ic->q, ic->b, ic->a);
+	}
+}
+
+static void
+bench_i31_div(void *ctx, long num)
+{
+	i31_ctx *ic;
+	long l;
+
+	ic = ctx;
+	for (l = 0; l < num; l ++) {
+		cttk_i31_divrem(ic->d, ic->r, ic->a, ic->b);
+	}
+}
+
+static void
+bench_i31_lsh(void *ctx, long num)
+{
+	i31_ctx *ic;
+	long l;
+
+	ic = ctx;
+	for (l = 0; l < num; l ++) {
+		cttk_i31_lsh_trunc(ic->d, ic->a, (uint32_t)l & 63);
+	}
+}
+
+static void
+bench_i31_rsh(void *ctx, long num)
+{
+	i31_ctx *ic;
+	long l;
+
+	ic = ctx;
+	for (l = 0; l < num; l ++) {
+		cttk_i31_rsh(ic->d, ic->a, (uint32_t)l & 63);
+	}
+}
+
+/*
+ * All integers have the same size. For multiplication, squaring and
+ * multiply-add, the first operand is 'q' (set to a half-size value) so
+ * that the product does not overflow; for division, 'b' is a half-size
+ * value.
+ */
+static void
+speed_i31(void)
+{
+	static const unsigned sizes[] = {
+		256, 512, 1024, 2048, 4096, 8192, 0
+	};
+	int i;
+
+	for (i = 0; sizes[i] != 0; i ++) {
+		unsigned size;
+		size_t wlen, blen;
+		unsigned char *tmp;
+		char param[20];
+		i31_ctx ic;
+
+		size = sizes[i];
+		wlen = ((size_t)size + 61) / 31;
+		blen = size >> 3;
+		ic.a = xmalloc(wlen * sizeof(uint32_t));
+		ic.b = xmalloc(wlen * sizeof(uint32_t));
+		ic.d = xmalloc(wlen * sizeof(uint32_t));
+		ic.q = xmalloc(wlen * sizeof(uint32_t));
+		ic.r = xmalloc(wlen * sizeof(uint32_t));
+		cttk_i31_init(ic.a, size);
+		cttk_i31_init(ic.b, size);
+		cttk_i31_init(ic.d, size);
+		cttk_i31_init(ic.q, size);
+		cttk_i31_init(ic.r, size);
+		tmp = xmalloc(blen);
+		rnd(tmp, blen);
+		tmp[0] &= 0x3F;
+		cttk_i31_decbe_signed(ic.a, tmp, blen);
+		rnd(tmp, blen >> 1);
+		tmp[0] = (tmp[0] & 0x3F) | 0x20;
+		cttk_i31_decbe_signed(ic.b, tmp, blen >> 1);
+		rnd(tmp, blen >> 1);
+		tmp[0] &= 0x3F;
+		cttk_i31_decbe_signed(ic.q, tmp, blen >> 1);
+		free(tmp);
+
+		sprintf(param, "%u", size);
+		run_bench("i31_add", param, 0, bench_i31_add, &ic);
+		run_bench("i31_mul", param, 0, bench_i31_mul, &ic);
+		run_bench("i31_sqr", param, 0, bench_i31_sqr, &ic);
+		run_bench("i31_muladd", param, 0, bench_i31_muladd, &ic);
+		run_bench("i31_div", param, 0, bench_i31_div, &ic);
+		run_bench("i31_lsh", param, 0, bench_i31_lsh, &ic);
+		run_bench("i31_rsh", param, 0, bench_i31_rsh, &ic);
+
+		free(ic.a);
+		free(ic.b);
+		free(ic.d);
+		free(ic.q);
+		free(ic.r);
+	}
+}
+
+/*
+ * Batches hold BATCH_NUM lanes, with the same values as the individual
+ * integers in speed_i31(); each call processes all lanes.
+ */
+#define BATCH_NUM   8
+
+typedef struct {
+	uint32_t *a, *b, *d, *q;
+} i31_batch_ctx;
+
+static void
+bench_i31_batch_add(void *ctx, long num)
+{
+	i31_batch_ctx *bc;
+	long l;
+
+	bc = ctx;
+	for (l = 0; l < num; l ++) {
+		cttk_i31_batch_add(bc->d, bc->a, bc->b);
+	}
+}
+
+static void
+bench_i31_batch_mul(void *ctx, long num)
+{
+	i31_batch_ctx *bc;
+	long l;
+
+	bc = ctx;
+	for (l = 0; l < num; l ++) {
+		cttk_i31_batch_mul(bc->d, bc->q, bc->b);
+	}
+}
+
+static void
+speed_i31_batch(void)
+{
+	static const unsigned sizes[] = {
+		256, 512, 1024, 2048, 4096, 0
+	};
+	int i;
+
+	for (i = 0; sizes[i] != 0; i ++) {
+		unsigned size;
+		size_t wlen, blen, k;
+		unsigned char *tmp;
+		uint32_t *x;
+		char param[20];
+		i31_batch_ctx bc;
+
+		size = sizes[i];
+		wlen = ((size_t)size + 61) / 31;
+		blen = size >> 3;
+		bc.a = xmalloc((2 + BATCH_NUM * wlen) * sizeof(uint32_t));
+		bc.b = xmalloc((2 + BATCH_NUM * wlen) * sizeof(uint32_t));
+		bc.d = xmalloc((2 + BATCH_NUM * wlen) * sizeof(uint32_t));
+		bc.q = xmalloc((2 + BATCH_NUM * wlen) * sizeof(uint32_t));
+		x = xmalloc(wlen * sizeof(uint32_t));
+		cttk_i31_batch_init(bc.a, size, BATCH_NUM);
+		cttk_i31_batch_init(bc.b, size, BATCH_NUM);
+		cttk_i31_batch_init(bc.d, size, BATCH_NUM);
+		cttk_i31_batch_init(bc.q, size, BATCH_NUM);
+		cttk_i31_init(x, size);
+		tmp = xmalloc(blen);
+		for (k = 0; k < BATCH_NUM; k ++) {
+			rnd(tmp, blen);
+			tmp[0] &= 0x3F;
+			cttk_i31_decbe_signed(x, tmp, blen);
+			cttk_i31_batch_set(bc.a, k, x);
+			rnd(tmp, blen >> 1);
+			tmp[0] = (tmp[0] & 0x3F) | 0x20;
+			cttk_i31_decbe_signed(x, tmp, blen >> 1);
+			cttk_i31_batch_set(bc.b, k, x);
+			rnd(tmp, blen >> 1);
+			tmp[0] &= 0x3F;
+			cttk_i31_decbe_signed(x, tmp, blen >> 1);
+			cttk_i31_batch_set(bc.q, k, x);
+		}
+		free(tmp);
+		free(x);
+
+		sprintf(param, "%ux%u", size, BATCH_NUM);
+		run_bench("i31_batch_add", param, 0, bench_i31_batch_add, &bc);
+		run_bench("i31_batch_mul", param, 0, bench_i31_batch_mul, &bc);
+
+		free(bc.a);
+		free(bc.b);
+		free(bc.d);
+		free(bc.q);
+	}
+}
+
+/* ==================================================================== */
+/*
+ * Conditional copy and array look-up.
+ */
+
+#define MANY_NUM   16
+
+typedef struct {
+	unsigned char *a, *d;
+	size_t elt_len, num_len;
+	size_t index[MANY_NUM];
+} mem_ctx;
+
+static void
+bench_cond_copy(void *ctx, long num)
+{
+	mem_ctx *mc;
+	long l;
+
+	mc = ctx;
+	for (l = 0; l < num; l ++) {
+		cttk_cond_copy(cttk_u32_neq0((uint32_t)l & 1),
+			mc->d, mc->a, mc->elt_len);
+	}
+}
+
+static void
+bench_array_read(void *ctx, long num)
+{
+	mem_ctx *mc;
+	long l;
+
+	mc = ctx;
+	for (l = 0; l < num; l ++) {
+		cttk_array_read(mc->d, mc->a, mc->elt_len, mc->num_len,
+			(size_t)l % mc->num_len);
+	}
+}
+
+static void
+bench_array_read_many(void *ctx, long num)
+{
+	mem_ctx *mc;
+	long l;
+
+	mc = ctx;
+	for (l = 0; l < num; l ++) {
+		mc->index[0] = (size_t)l % mc->num_len;
+		cttk_array_read_many(mc->d, mc->a, mc->elt_len, mc->num_len,
+			mc->index, MANY_NUM);
+	}
+}
+
+static void
+bench_oblivious_sort(void *ctx, long num)
+{
+	mem_ctx *mc;
+	long l;
+
+	mc = ctx;
+	for (l = 0; l < num; l ++) {
+		cttk_oblivious_sort(mc->a, mc->num_len, mc->elt_len, 0, 8);
+	}
+}
+
+static void
+speed_mem(void)
+{
+	static const size_t copy_sizes[] = {
+		16, 64, 256, 1024, 4096, 16384, 0
+	};
+	static const size_t array_sizes[] = {
+		16, 16,   16, 256,   64, 64,   64, 1024,   256, 256,
+		1024, 64,   16, 65536,   0, 0
+	};
+	static const size_t many_sizes[] = {
+		16, 256,   64, 1024,   16, 65536,   0, 0
+	};
+	static const size_t sort_sizes[] = {
+		16, 1024,   16, 65536,   64, 16384,   0, 0
+	};
+	mem_ctx mc;
+	char param[40];
+	int i;
+
+	for (i = 0; copy_sizes[i] != 0; i ++) {
+		mc.elt_len = copy_sizes[i];
+		mc.num_len = 1;
+		mc.a = xmalloc(mc.elt_len);
+		mc.d = xmalloc(mc.elt_len);
+		rnd(mc.a, mc.elt_len);
+		sprintf(param, "%lu", (unsigned long)mc.elt_len);
+		run_bench("cond_copy", param, mc.elt_len,
+			bench_cond_copy, &mc);
+		free(mc.a);
+		free(mc.d);
+	}
+
+	for (i = 0; array_sizes[i] != 0; i += 2) {
+		mc.elt_len = array_sizes[i];
+		mc.num_len = array_sizes[i + 1];
+		mc.a = xmalloc(mc.elt_len * mc.num_len);
+		mc.d = xmalloc(mc.elt_len);
+		rnd(mc.a, mc.elt_len * mc.num_len);
+		sprintf(param, "%lux%lu", (unsigned long)mc.elt_len,
+			(unsigned long)mc.num_len);
+		run_bench("array_read", param, mc.elt_len * mc.num_len,
+			bench_array_read, &mc);
+		free(mc.a);
+		free(mc.d);
+	}
+
+	/*
+	 * Batch reads of MANY_NUM indices; the MB/s figure is relative
+	 * to the array size (one pass).
+	 */
+	for (i = 0; many_sizes[i] != 0; i += 2) {
+		size_t u;
+
+		mc.elt_len = many_sizes[i];
+		mc.num_len = many_sizes[i + 1];
+		mc.a = xmalloc(mc.elt_len * mc.num_len);
+		mc.d = xmalloc(mc.elt_len * MANY_NUM);
+		rnd(mc.a, mc.elt_len * mc.num_len);
+		for (u = 0; u < MANY_NUM; u ++) {
+			mc.index[u] = (u * 7919) % mc.num_len;
+		}
+		sprintf(param, "%lux%lux%d", (unsigned long)mc.elt_len,
+			(unsigned long)mc.num_len, MANY_NUM);
+		run_bench("array_read_many", param, mc.elt_len * mc.num_len,
+			bench_array_read_many, &mc);
+		free(mc.a);
+		free(mc.d);
+	}
+
+	for (i = 0; sort_sizes[i] != 0; i += 2) {
+		mc.elt_len = sort_sizes[i];
+		mc.num_len = sort_sizes[i + 1];
+		mc.a = xmalloc(mc.elt_len * mc.num_len);
+		mc.d = NULL;
+		rnd(mc.a, mc.elt_len * mc.num_len);
+		sprintf(param, "%lux%lu", (unsigned long)mc.elt_len,
+			(unsigned long)mc.num_len);
+		run_bench("oblivious_sort", param, mc.elt_len * mc.num_len,
+			bench_oblivious_sort, &mc);
+		free(mc.a);
+	}
+}
+
+/* ==================================================================== */
+/*
+ * Constant-time S-box lookups: the AES S-box is applied to a buffer of
+ * SBOX_LEN bytes, either with one cttk_array_read() per byte (or with
+ * cttk_array_read_many()), or with the bitsliced versions produced by
+ * bsgen, including the conversions to and from bitsliced form.
+ */
+
+#define SBOX_LEN   256
+
+void bs_aes_sbox_32(uint32_t *d, const uint32_t *s);
+void bs_aes_sbox_64(uint32_t *d, const uint32_t *s);
+void bs_aes_sbox_128(uint32_t *d, const uint32_t *s);
+void bs_aes_sbox_256(uint32_t *d, const uint32_t *s);
+
+typedef struct {
+	unsigned char sbox[256];
+	unsigned char buf[SBOX_LEN];
+	size_t index[SBOX_LEN];
+	void (*fn)(uint32_t *d, const uint32_t *s);
+	size_t width;
+} sbox_ctx;
+
+static void
+bench_sbox_array_read(void *ctx, long num)
+{
+	sbox_ctx *sc;
+	long l;
+
+	sc = ctx;
+	for (l = 0; l < num; l ++) {
+		size_t u;
+
+		for (u = 0; u < SBOX_LEN; u ++) {
+			cttk_array_read(sc->buf + u, sc->sbox, 1, 256,
+				sc->buf[u]);
+		}
+	}
+}
+
+static void
+bench_sbox_read_many(void *ctx, long num)
+{
+	sbox_ctx *sc;
+	long l;
+
+	sc = ctx;
+	for (l = 0; l < num; l ++) {
+		size_t u;
+
+		for (u = 0; u < SBOX_LEN; u ++) {
+			sc->index[u] = sc->buf[u];
+		}
+		cttk_array_read_many(sc->buf, sc->sbox, 1, 256,
+			sc->index, SBOX_LEN);
+	}
+}
+
+static void
+bench_sbox_bitslice(void *ctx, long num)
+{
+	sbox_ctx *sc;
+	long l;
+
+	sc = ctx;
+	for (l = 0; l < num; l ++) {
+		size_t u;
+
+		for (u = 0; u < SBOX_LEN; u += sc->width) {
+			uint32_t q[64];
+
+			cttk_bitslice_in8(q, sc->buf + u, sc->width);
+			sc->fn(q, q);
+			cttk_bitslice_out8(sc->buf + u, q, sc->width);
+		}
+	}
+}
+
+static void
+speed_sbox(void)
+{
+	static const struct {
+		void (*fn)(uint32_t *d, const uint32_t *s);
+		size_t width;
+		const char *param;
+	} fns[] = {
+		{ bs_aes_sbox_32, 32, "bitslice32" },
+		{ bs_aes_sbox_64, 64, "bitslice64" },
+		{ bs_aes_sbox_128, 128, "bitslice128" },
+		{ bs_aes_sbox_256, 256, "bitslice256" },
+		{ NULL, 0, NULL }
+	};
+	sbox_ctx sc;
+	size_t u;
+	int i;
+
+	/*
+	 * Only the access pattern matters here, not the table contents;
+	 * the buffer is first filled with random bytes.
+	 */
+	rnd(sc.sbox, sizeof sc.sbox);
+	rnd(sc.buf, sizeof sc.buf);
+	for (u = 0; u < SBOX_LEN; u ++) {
+		sc.index[u] = 0;
+	}
+	run_bench("sbox", "array_read", SBOX_LEN,
+		bench_sbox_array_read, &sc);
+	run_bench("sbox", "read_many", SBOX_LEN,
+		bench_sbox_read_many, &sc);
+	for (i = 0; fns[i].fn != NULL; i ++) {
+		sc.fn = fns[i].fn;
+		sc.width = fns[i].width;
+		run_bench("sbox", fns[i].param, SBOX_LEN,
+			bench_sbox_bitslice, &sc);
+	}
+}
+
+/* ==================================================================== */
+/*
+ * Hexadecimal and Base64 codecs. Throughput is expressed relatively to
+ * the binary data length, for both encoding and decoding.
+ */
+
+#define CODEC_LEN   65536
+
+typedef struct {
+	unsigned char *bin;
+	char *str;
+	size_t bin_len, str_len;
+	unsigned flags;
+} codec_ctx;
+
+static void
+bench_hex_enc(void *ctx, long num)
+{
+	codec_ctx *cc;
+	long l;
+
+	cc = ctx;
+	for (l = 0; l < num; l ++) {
+		cttk_bintohex_gen(cc->str, cc->str_len,
+			cc->bin, cc->bin_len, cc->flags);
+	}
+}
+
+static void
+bench_hex_dec(void *ctx, long num)
+{
+	codec_ctx *cc;
+	long l;
+
+	cc = ctx;
+	for (l = 0; l < num; l ++) {
+		cttk_hextobin_gen(cc->bin, cc->bin_len,
+			cc->str, cc->str_len, NULL, cc->flags);
+	}
+}
+
+static void
+bench_b64_enc(void *ctx, long num)
+{
+	codec_ctx *cc;
+	long l;
+
+	cc = ctx;
+	for (l = 0; l < num; l ++) {
+		cttk_bintob64_gen(cc->str, cc->str_len,
+			cc->bin, cc->bin_len, cc->flags);
+	}
+}
+
+static void
+bench_b64_dec(void *ctx, long num)
+{
+	codec_ctx *cc;
+	long l;
+
+	cc = ctx;
+	for (l = 0; l < num; l ++) {
+		cttk_b64tobin_gen(cc->bin, cc->bin_len,
+			cc->str, cc->str_len, NULL, cc->flags);
+	}
+}
+
+static void
+speed_codec(void)
+{
+	codec_ctx cc;
+
+	cc.bin_len = CODEC_LEN;
+	cc.str_len = 2 * CODEC_LEN + 1;
+	cc.bin = xmalloc(cc.bin_len);
+	cc.str = xmalloc(cc.str_len);
+	rnd(cc.bin, cc.bin_len);
+
+	cc.flags = 0;
+	run_bench("hex_enc", "flat", CODEC_LEN, bench_hex_enc, &cc);
+	cc.str_len = cttk_bintohex_gen(cc.str, 2 * CODEC_LEN + 1,
+		cc.bin, cc.bin_len, 0);
+	run_bench("hex_dec", "flat", CODEC_LEN, bench_hex_dec, &cc);
+	cc.flags = CTTK_HEX_SKIP_WS;
+	run_bench("hex_dec", "skipws", CODEC_LEN, bench_hex_dec, &cc);
+
+	cc.str_len = 2 * CODEC_LEN + 1;
+	cc.flags = 0;
+	run_bench("b64_enc", "flat", CODEC_LEN, bench_b64_enc, &cc);
+	cc.flags = CTTK_B64ENC_NEWLINE;
+	run_bench("b64_enc", "lines", CODEC_LEN, bench_b64_enc, &cc);
+
+	cc.str_len = cttk_bintob64_gen(cc.str, 2 * CODEC_LEN + 1,
+		cc.bin, cc.bin_len, 0);
+	cc.flags = 0;
+	run_bench("b64_dec", "flat", CODEC_LEN, bench_b64_dec, &cc);
+	cc.str_len = cttk_bintob64_gen(cc.str, 2 * CODEC_LEN + 1,
+		cc.bin, cc.bin_len, CTTK_B64ENC_NEWLINE);
+	run_bench("b64_dec", "lines", CODEC_LEN, bench_b64_dec, &cc);
+
+	free(cc.bin);
+	free(cc.str);
+}
+
+/* ==================================================================== */
+
+static void
+usage(void)
+{
+	fprintf(stderr,
+"usage: speedcttk [ options ] [ name... ]\n"
+"options:\n"
+"   -csv        output results as CSV\n"
+"   -json       output results as JSON\n"
+"   -t secs     minimum duration of each measure (default: 0.25)\n"
+"   -cpu mask   restrict used CPU features (1=SSE2 2=AVX2)\n"
+"If names are provided, then only the benchmarks whose name starts\n"
+"with one of them are run. Benchmark names:\n"
+"   i31_add i31_mul i31_sqr i31_muladd i31_div i31_lsh i31_rsh\n"
+"   i31_batch_add i31_batch_mul\n"
+"   cond_copy array_read array_read_many oblivious_sort sbox\n"
+"   hex_enc hex_dec b64_enc b64_dec\n");
+	exit(EXIT_FAILURE);
+}
+
+int
+main(int argc, char *argv[])
+{
+	int i;
+
+	filters = xmalloc((size_t)argc * sizeof(char *));
+	for (i = 1; i < argc; i ++) {
+		const char *arg;
+
+		arg = argv[i];
+		if (strcmp(arg, "-csv") == 0) {
+			out_format = OUT_CSV;
+		} else if (strcmp(arg, "-json") == 0) {
+			out_format = OUT_JSON;
+		} else if (strcmp(arg, "-t") == 0) {
+			if (++ i >= argc) {
+				usage();
+			}
+			min_time = atof(argv[i]);
+			if (!(min_time > 0.0)) {
+				usage();
+			}
+		} else if (strcmp(arg, "-cpu") == 0) {
+			char *end;
+			unsigned long m;
+
+			if (++ i >= argc) {
+				usage();
+			}
+			m = strtoul(argv[i], &end, 0);
+			if (*argv[i] == 0 || *end != 0) {
+				usage();
+			}
+			cttk_cpu_set_features((uint32_t)m);
+		} else if (arg[0] == '-') {
+			usage();
+		} else {
+			filters[num_filters ++] = argv[i];
+		}
+	}
+
+	out_begin();
+	speed_i31();
+	speed_i31_batch();
+	speed_mem();
+	speed_sbox();
+	speed_codec();
+	out_end();
+	free(filters);
+	return 0;
+}
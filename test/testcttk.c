@@ -454,6 +454,35 @@ test_comparisons_buffers(void)
 			buf2[v] = buf1[v];
 		}
 
+		/*
+		 * Buffers with a common prefix and several differences
+		 * afterwards, at various (unaligned) offsets.
+		 */
+		for (i = 0; i < 40; i ++) {
+			size_t off1, off2, k;
+			int cc, ref;
+
+			off1 = rnd32() % (sizeof buf1 - u + 1);
+			off2 = rnd32() % (sizeof buf2 - u + 1);
+			rnd(buf1 + off1, u);
+			memcpy(buf2 + off2, buf1 + off1, u);
+			if (u > 0) {
+				k = rnd32() % u;
+				for (v = k; v < u; v ++) {
+					if ((rnd32() & 3) == 0) {
+						buf2[off2 + v] = rnd32();
+					}
+				}
+			}
+			ref = memcmp(buf1 + off1, buf2 + off2, u);
+			ref = (ref > 0) - (ref < 0);
+			cc = cttk_array_cmp(buf1 + off1, buf2 + off2, u);
+			check(cc == ref, "array_cmp 3 (%zu,%d)", u, i);
+			check(cttk_array_eq(buf1 + off1, buf2 + off2, u).v
+				== (uint32_t)(ref == 0),
+				"array_eq 3 (%zu,%d)", u, i);
+		}
+
 		if (u % 8 == 0) {
 			printf(".");
 			fflush(stdout);
@@ -465,165 +494,187 @@ test_comparisons_buffers(void)
 }
 
 static void
-test_hex(void)
+test_cond_copy(void)
 {
-	static const unsigned char databin[] = {
-		0x38, 0xF2, 0x45, 0x86, 0x85, 0x82, 0xE3, 0x59,
-		0x83, 0x3D, 0xE0, 0x0D, 0x90, 0x50, 0x5F, 0xA8,
-		0x41, 0xBF, 0x0A, 0xE3, 0x01, 0x5B, 0x70, 0xCA,
-		0x16, 0x0B, 0xDB, 0x63, 0x57, 0xF1, 0xB9, 0xE3,
-		0x9A, 0x3F, 0xF6, 0x49, 0x28, 0xCA, 0xC9, 0x4F,
-		0xCB, 0x6E, 0x44, 0x11, 0x92, 0x82, 0xC4, 0x72,
-		0xF4, 0x31, 0xB1, 0xDF, 0x0C, 0xDE, 0xA5, 0x85,
-		0x03, 0x26, 0x4C, 0x87, 0xC4, 0x76, 0x5E, 0x5C,
-		0x6C, 0x61, 0x63, 0x7F, 0x93, 0xC1, 0xE1, 0x60,
-		0xC3, 0x3C, 0x2C, 0x11, 0x4C, 0x83, 0x6C, 0x1A,
-		0x57, 0x2C, 0x72, 0x1B, 0x63, 0x44, 0x0B, 0xB8,
-		0x4A, 0x46, 0x7C, 0x42, 0xAA, 0xBA, 0x56, 0xF2,
-		0x67, 0x5E, 0xA4, 0xA0, 0x0D, 0x7A, 0xF9, 0x59,
-		0xE1, 0xF5, 0xCA, 0xE7, 0x0B, 0xA0, 0xA6, 0xD7,
-		0x3E, 0xFE, 0xCF, 0x08, 0xDF, 0xE4, 0xA4, 0xBF,
-		0x7D, 0x4B, 0x84, 0x91, 0x17, 0xF2, 0x0C, 0x3B,
-		0x66, 0x58, 0xF3, 0x27, 0x4C, 0x88, 0x5C, 0x09,
-		0x47, 0xD0, 0xE3, 0x00, 0x40, 0x16, 0xBC, 0xFC,
-		0x56, 0x2C, 0x58, 0x3E, 0x95, 0xA2, 0x1C, 0x45,
-		0x7D, 0x18, 0xA9, 0xBC, 0xD1, 0x45, 0x54, 0x43,
-		0x5B, 0x46, 0x55, 0xBB, 0xA2, 0x23, 0xB1, 0x43,
-		0x1D, 0x02, 0x8A, 0xD2, 0x14, 0x7A, 0x3C, 0x36,
-		0x61, 0x21, 0x39, 0xA6, 0x7B, 0xC1, 0xB0, 0x13,
-		0x00, 0xCC, 0xAB, 0x50, 0x9F, 0x1D, 0x40, 0x01,
-		0xD2, 0x84, 0x55, 0x6C, 0xF5, 0x0E, 0x14, 0x74,
-		0xBC, 0xF1, 0x1D, 0x17, 0xE4, 0x98, 0x70, 0x2C,
-		0x1A, 0xD7, 0x66, 0x67, 0x33, 0xEE, 0x20, 0xE9,
-		0x5D, 0x93, 0xD0, 0xF4, 0x0A, 0xD8, 0x6D, 0x23,
-		0xF1, 0x08, 0x9D, 0x70, 0x1B, 0x97, 0xAC, 0x99,
-		0xB0, 0xE5, 0x3A, 0x4E, 0x7E, 0x46, 0xB2, 0x81,
-		0x24, 0xB9, 0x08, 0x23, 0xD2, 0x21, 0xF9, 0x3D,
-		0xB6, 0x96, 0xF4, 0xF6, 0x06, 0x65, 0x66, 0x04
-	};
-
-	char datastr[1 + ((sizeof databin) << 1)];
-	char tmp[sizeof datastr];
-	unsigned char buf[(sizeof databin) + 1];
-	size_t u, v, w;
-	int i, j;
-	const char *err;
+	unsigned char buf[300], ref[sizeof buf], sav[sizeof buf];
+	unsigned char buf2[sizeof buf], ref2[sizeof buf];
+	size_t len;
 
-	printf("Test hex: ");
+	printf("Test cond_copy/cond_swap: ");
 	fflush(stdout);
 
-	for (i = 0; i < 2; i ++) {
-		unsigned flags;
+	rnd_init(12);
 
-		flags = (i == 0) ? 0 : CTTK_HEX_UPPERCASE;
-		for (u = 0; u < sizeof databin; u ++) {
-			sprintf(datastr + (u << 1),
-				(i == 0) ? "%02x" : "%02X", databin[u]);
+	for (len = 0; len <= 200; len ++) {
+		size_t off1, off2;
+		int ctl;
+
+		/*
+		 * Conditional copy, with all kinds of overlap (and also
+		 * unaligned non-overlapping buffers).
+		 */
+		for (off1 = 0; off1 < 9; off1 ++) {
+			for (off2 = 0; off2 < 100; off2 += 1 + (off2 >= 9) * 7) {
+				for (ctl = 0; ctl < 2; ctl ++) {
+					rnd(buf, sizeof buf);
+					memcpy(sav, buf, sizeof buf);
+					memcpy(ref, buf, sizeof buf);
+					if (ctl) {
+						memmove(ref + off1,
+							ref + off2, len);
+					}
+					cttk_cond_copy(cttk_bool_of_u32(ctl),
+						buf + off1, buf + off2, len);
+					check(memcmp(buf, ref, sizeof buf) == 0,
+						"cond_copy 1 (%zu,%zu,%zu,%d)",
+						len, off1, off2, ctl);
+
+					memcpy(buf, sav, sizeof buf);
+					memcpy(ref, sav, sizeof buf);
+					if (ctl) {
+						memmove(ref + off2,
+							ref + off1, len);
+					}
+					cttk_cond_copy(cttk_bool_of_u32(ctl),
+						buf + off2, buf + off1, len);
+					check(memcmp(buf, ref, sizeof buf) == 0,
+						"cond_copy 2 (%zu,%zu,%zu,%d)",
+						len, off1, off2, ctl);
+				}
+			}
 		}
-		for (u = 0; u <= sizeof datastr; u ++) {
-			memset(tmp, 'T', sizeof tmp);
-			v = cttk_bintohex_gen(tmp, u,
-				databin, sizeof databin, flags);
-			if (u == 0) {
-				check(v == 0, "bintohex 1");
-				check(tmp[0] == 'T', "bintohex 2");
-			} else {
-				check(v == u - 1, "bintohex 3");
-				check(tmp[v] == 0, "bintohex 4");
-				check(memcmp(datastr, tmp, v) == 0,
-					"bintohex 5");
+
+		/*
+		 * Conditional swap (distinct buffers, various alignments).
+		 */
+		for (off1 = 0; off1 < 9; off1 ++) {
+			for (off2 = 0; off2 < 9; off2 ++) {
+				for (ctl = 0; ctl < 2; ctl ++) {
+					rnd(buf, sizeof buf);
+					rnd(buf2, sizeof buf2);
+					memcpy(ref, buf, sizeof buf);
+					memcpy(ref2, buf2, sizeof buf2);
+					if (ctl) {
+						memcpy(ref + off1,
+							buf2 + off2, len);
+						memcpy(ref2 + off2,
+							buf + off1, len);
+					}
+					cttk_cond_swap(cttk_bool_of_u32(ctl),
+						buf + off1, buf2 + off2, len);
+					check(memcmp(buf, ref, sizeof buf) == 0
+						&& memcmp(buf2, ref2,
+						sizeof buf2) == 0,
+						"cond_swap (%zu,%zu,%zu,%d)",
+						len, off1, off2, ctl);
+				}
 			}
 		}
-		for (u = 0; u <= sizeof databin; u ++) {
-			memset(tmp, 'U', sizeof tmp);
-			v = cttk_bintohex_gen(tmp, sizeof tmp,
-				databin, u, flags);
-			check(v == (u << 1), "bintohex 6");
-			check(tmp[v] == 0, "bintohex 7");
-			check(memcmp(datastr, tmp, v) == 0, "bintohex 8");
-			v = cttk_bintohex_gen(NULL, 0, databin, u, flags);
-			check(v == (u << 1), "bintohex 9");
+
+		if (len % 8 == 0) {
+			printf(".");
+			fflush(stdout);
 		}
-		printf(".");
-		fflush(stdout);
 	}
 
-	for (i = 0; i < 2; i ++) {
-		for (u = 0; u < sizeof databin; u ++) {
-			sprintf(datastr + (u << 1),
-				(i == 0) ? "%02x" : "%02X", databin[u]);
-		}
-		for (u = 0; u <= sizeof datastr; u ++) {
-			memset(buf, 0xFF, sizeof buf);
-			v = cttk_hextobin_gen(buf, sizeof buf,
-				datastr, u, &err, 0);
-			check(v == (u >> 1), "hextobin 1");
-			if (u == sizeof datastr) {
-				check(err == datastr + u - 1, "hextobin 2");
-			} else if ((u & 1) == 1) {
-				check(err == datastr + u, "hextobin 3");
-			} else {
-				check(err == NULL, "hextobin 4");
-			}
-			check(memcmp(buf, databin, v) == 0, "hextobin 5");
-			check(buf[v] == 0xFF, "hextobin 6");
+	printf(" done.\n");
+	fflush(stdout);
+}
 
-			v = cttk_hextobin_gen(NULL, 0, datastr, u, &err, 0);
-			check(v == (u >> 1), "hextobin 7");
-			v = cttk_hextobin_gen(NULL, 0, datastr, u, NULL, 0);
-			check(v == (u >> 1), "hextobin 8");
+static void
+test_array_many(void)
+{
+	static const struct {
+		size_t elt_len, num_len, num_index;
+	} params[] = {
+		{ 1, 1, 1 },
+		{ 1, 300, 20 },
+		{ 7, 50, 0 },
+		{ 7, 50, 9 },
+		{ 16, 3000, 33 },
+		{ 40, 1000, 10 },
+		{ 3, 200, 100 },
+		{ 57, 150, 70 },
+		{ 5000, 10, 5 },
+		{ 20000, 3, 4 },
+	};
+	size_t k;
 
-			memset(buf, 0xFF, sizeof buf);
-			v = cttk_hextobin_gen(buf, sizeof buf,
-				datastr, u, &err, CTTK_HEX_PAD_ODD);
-			if (u == sizeof datastr) {
-				check(v == (u >> 1), "hextobin 9");
-				check(err == datastr + u - 1, "hextobin 10");
-			} else if ((u & 1) == 1) {
-				check(v == ((u + 1) >> 1), "hextobin 11");
-				check(err == NULL, "hextobin 12");
-				v --;
-				check(buf[v] == (databin[v] & 0xF0),
-					"hextobin 13");
-			} else {
-				check(v == (u >> 1), "hextobin 14");
-				check(err == NULL, "hextobin 15");
-			}
-			check(memcmp(buf, databin, v) == 0, "hextobin 16");
-		}
+	printf("Test array_read_many/array_write_many: ");
+	fflush(stdout);
 
-		for (u = 0; u <= sizeof databin; u ++) {
-			memset(buf, 0xFF, sizeof buf);
-			v = cttk_hextobin_gen(buf, u,
-				datastr, (sizeof databin) << 1, &err, 0);
-			check(u == v, "hextobin 17");
-			check(buf[v] == 0xFF, "hextobin 18");
-			if (u == sizeof databin) {
-				check(err == NULL, "hextobin 19");
-			} else {
-				check(err == datastr + (u << 1), "hextobin 20");
+	rnd_init(22);
+
+	for (k = 0; k < (sizeof params) / sizeof params[0]; k ++) {
+		size_t elt_len, num_len, num_index, u;
+		size_t index[100];
+		unsigned char *a, *ref, *d, *s;
+		int i;
+
+		elt_len = params[k].elt_len;
+		num_len = params[k].num_len;
+		num_index = params[k].num_index;
+		a = malloc(elt_len * num_len);
+		ref = malloc(elt_len * num_len);
+		d = malloc(elt_len * num_index + 1);
+		s = malloc(elt_len * num_index + 1);
+		check(a != NULL && ref != NULL && d != NULL && s != NULL,
+			"malloc");
+
+		for (i = 0; i < 10; i ++) {
+			/*
+			 * Random indices, with duplicates and a few
+			 * out-of-range values.
+			 */
+			rnd(a, elt_len * num_len);
+			memcpy(ref, a, elt_len * num_len);
+			for (u = 0; u < num_index; u ++) {
+				index[u] = rnd32() % (num_len + 2);
+				if ((u & 3) == 3) {
+					index[u] = index[u - 1];
+				}
 			}
-			check(memcmp(buf, databin, u) == 0, "hextobin 21");
-		}
 
-		for (u = 0, v = 0; datastr[u] && v < (sizeof tmp) - 10; u ++) {
-			for (j = 0; j < (int)(u % 7); j ++) {
-				tmp[v] = 1 + (v & 31);
-				v ++;
+			cttk_array_read_many(d, a, elt_len, num_len,
+				index, num_index);
+			for (u = 0; u < num_index; u ++) {
+				unsigned char *dk;
+
+				dk = d + u * elt_len;
+				if (index[u] < num_len) {
+					check(memcmp(dk, ref + index[u] * elt_len,
+						elt_len) == 0,
+						"read_many (%zu,%d,%zu)", k, i, u);
+				} else {
+					size_t v;
+
+					for (v = 0; v < elt_len; v ++) {
+						check(dk[v] == 0,
+							"read_many zero (%zu,%d,%zu)",
+							k, i, u);
+					}
+				}
 			}
-			tmp[v ++] = datastr[u];
-		}
-		if ((u & 1) != 0) {
-			v --;
+			check(memcmp(a, ref, elt_len * num_len) == 0,
+				"read_many source (%zu,%d)", k, i);
+
+			rnd(s, elt_len * num_index);
+			cttk_array_write_many(a, elt_len, num_len,
+				index, num_index, s);
+			for (u = 0; u < num_index; u ++) {
+				if (index[u] < num_len) {
+					memcpy(ref + index[u] * elt_len,
+						s + u * elt_len, elt_len);
+				}
+			}
+			check(memcmp(a, ref, elt_len * num_len) == 0,
+				"write_many (%zu,%d)", k, i);
 		}
-		memset(buf, 0xFF, sizeof buf);
-		w = cttk_hextobin_gen(buf, sizeof buf,
-			tmp, v, &err, CTTK_HEX_SKIP_WS);
-		check(w == (u >> 1), "hextobin 22");
-		check(buf[w] == 0xFF, "hextobin 23");
-		check(err == NULL, "hextobin 24");
-		check(memcmp(buf, databin, w) == 0, "hextobin 25");
 
+		free(a);
+		free(ref);
+		free(d);
+		free(s);
 		printf(".");
 		fflush(stdout);
 	}
@@ -632,440 +683,650 @@ test_hex(void)
 	fflush(stdout);
 }
 
-static char
-b64char(int x)
+/*
+ * Test executor: jobs are run sequentially, in reverse order; each job
+ * must be run exactly once. The context counts the jobs.
+ */
+static void
+seq_exec(void *exec_ctx, void (*job)(void *arg, size_t idx),
+	void *arg, size_t num)
 {
-	return "ABCDEFGHIJKLMNOPQRSTUVWXYZ"
-		"abcdefghijklmnopqrstuvwxyz0123456789+/" [x];
+	size_t u;
+
+	*(size_t *)exec_ctx += num;
+	for (u = num; u -- > 0;) {
+		job(arg, u);
+	}
 }
 
 static void
-b64enc(char *dst, const unsigned char *buf, size_t len,
-	int pad, int line_len, int crlf)
+test_array_read_mt(void)
 {
-	size_t u, v;
-	int lc;
+	static const struct {
+		size_t elt_len, num_len;
+		unsigned num_threads;
+	} params[] = {
+		{ 1, 1, 4 },
+		{ 1, 1000, 100 },
+		{ 7, 5, 8 },
+		{ 16, 3000, 1 },
+		{ 16, 3000, 4 },
+		{ 40, 999, 7 },
+		{ 5000, 10, 3 },
+	};
+	size_t k;
 
-	lc = 0;
-	v = 0;
-	for (u = 0; (u + 2) < len; u += 3) {
-		uint32_t x;
+	printf("Test array_read_mt: ");
+	fflush(stdout);
 
-		x = ((uint32_t)buf[u] << 16)
-			| ((uint32_t)buf[u + 1] << 8)
-			| (uint32_t)buf[u + 2];
-		dst[v ++] = b64char(x >> 18);
-		dst[v ++] = b64char((x >> 12) & 63);
-		dst[v ++] = b64char((x >> 6) & 63);
-		dst[v ++] = b64char(x & 63);
-		lc ++;
-		if (lc == line_len) {
-			lc = 0;
-			if (crlf) {
-				dst[v ++] = '\r';
+	rnd_init(23);
+
+	for (k = 0; k < (sizeof params) / sizeof params[0]; k ++) {
+		size_t elt_len, num_len, u;
+		unsigned nt;
+		unsigned char *a, *d, *d2;
+
+		elt_len = params[k].elt_len;
+		num_len = params[k].num_len;
+		nt = params[k].num_threads;
+		a = malloc(elt_len * num_len);
+		d = malloc(elt_len);
+		d2 = malloc(elt_len);
+		check(a != NULL && d != NULL && d2 != NULL, "malloc");
+		rnd(a, elt_len * num_len);
+
+		for (u = 0; u < num_len + 2; u += 1 + (num_len >> 4)) {
+			size_t nj, v;
+
+			nj = 0;
+			rnd(d, elt_len);
+			cttk_array_read_mt(d, a, elt_len, num_len, u,
+				nt, seq_exec, &nj);
+			if (u < num_len) {
+				check(memcmp(d, a + u * elt_len, elt_len) == 0,
+					"read_mt (%zu,%zu)", k, u);
+			} else {
+				for (v = 0; v < elt_len; v ++) {
+					check(d[v] == 0,
+						"read_mt zero (%zu,%zu)", k, u);
+				}
+			}
+			check(nj <= nt && nj <= num_len,
+				"read_mt jobs (%zu,%zu): %zu", k, u, nj);
+			if (nt > 1 && num_len > 1 && elt_len < 4096) {
+				check(nj == (nt < num_len ? nt : num_len),
+					"read_mt jobs (%zu,%zu): %zu", k, u, nj);
 			}
-			dst[v ++] = '\n';
-		}
-	}
-	if (u == len - 1) {
-		uint32_t x;
 
-		x = buf[u];
-		dst[v ++] = b64char(x >> 2);
-		dst[v ++] = b64char((x << 4) & 63);
-		if (pad) {
-			dst[v ++] = '=';
-			dst[v ++] = '=';
+			rnd(d2, elt_len);
+			cttk_array_read_mt(d2, a, elt_len, num_len, u,
+				nt, NULL, NULL);
+			check(memcmp(d, d2, elt_len) == 0,
+				"read_mt no exec (%zu,%zu)", k, u);
 		}
-		lc ++;
-	} else if (u == len - 2) {
-		uint32_t x;
 
-		x = ((uint32_t)buf[u] << 8) | (uint32_t)buf[u + 1];
-		dst[v ++] = b64char(x >> 10);
-		dst[v ++] = b64char((x >> 4) & 63);
-		dst[v ++] = b64char((x << 2) & 63);
-		if (pad) {
-			dst[v ++] = '=';
-		}
-		lc ++;
-	}
-	if (lc != 0 && line_len != 0) {
-		if (crlf) {
-			dst[v ++] = '\r';
-		}
-		dst[v ++] = '\n';
+		free(a);
+		free(d);
+		free(d2);
+		printf(".");
+		fflush(stdout);
 	}
-	dst[v ++] = 0;
+
+	printf(" done.\n");
+	fflush(stdout);
 }
 
 static void
-test_base64(void)
+oram_rng(void *ctx, void *dst, size_t len)
 {
-	/*
-	 * Test data is a random 256-byte blob.
-	 */
-	static const unsigned char databin[] = {
-		0x6D, 0xDD, 0x85, 0x66, 0xB3, 0x64, 0xB6, 0x41,
-		0xF6, 0x70, 0x69, 0xD7, 0x20, 0xCB, 0x2A, 0x10,
-		0xE1, 0x33, 0x34, 0xE1, 0x8B, 0x26, 0xB9, 0x71,
-		0xFD, 0xE1, 0x58, 0x87, 0xFD, 0xB2, 0xD1, 0xDA,
-		0x9D, 0x93, 0x04, 0x67, 0x8A, 0xDC, 0x17, 0xDA,
-		0xCB, 0x38, 0xE5, 0xB1, 0x81, 0xCF, 0x8A, 0xF9,
-		0xDB, 0x51, 0xC5, 0x70, 0x2F, 0x26, 0x88, 0x7F,
-		0x36, 0x65, 0xD4, 0xCD, 0x22, 0x67, 0xF9, 0x1D,
-		0x72, 0x9F, 0xE1, 0xFE, 0x2B, 0xF8, 0xF6, 0x7D,
-		0x3B, 0x2B, 0xEE, 0x84, 0x3F, 0xAF, 0xEF, 0x01,
-		0x26, 0x0B, 0x21, 0x21, 0x52, 0x49, 0xE2, 0xFC,
-		0x76, 0x46, 0x3B, 0x70, 0xA2, 0x94, 0x92, 0x1C,
-		0xAF, 0x7D, 0x50, 0xE0, 0x2C, 0x6D, 0x83, 0xA9,
-		0x09, 0x56, 0x21, 0x5D, 0x8D, 0x56, 0x26, 0x06,
-		0x15, 0x63, 0x7E, 0xB3, 0x8C, 0x45, 0x6C, 0x7D,
-		0x82, 0xBD, 0xA0, 0xC7, 0x8E, 0x58, 0xDD, 0xDA,
-		0x70, 0xB8, 0x11, 0x83, 0x2E, 0x81, 0xBC, 0xCF,
-		0xAD, 0x5D, 0x09, 0xDA, 0x60, 0x03, 0xE8, 0x9E,
-		0x72, 0xF9, 0xAE, 0xDC, 0xAC, 0x56, 0x6F, 0xF8,
-		0xEB, 0x44, 0x58, 0xBA, 0x95, 0xB9, 0x2B, 0x71,
-		0x85, 0xD4, 0x58, 0x74, 0xA2, 0x54, 0xC4, 0x66,
-		0x80, 0xE4, 0x67, 0xFE, 0x09, 0x70, 0xD5, 0x2A,
-		0x05, 0x12, 0x63, 0x77, 0xFB, 0xD8, 0x19, 0x4B,
-		0xA6, 0xBE, 0xFE, 0x01, 0x09, 0x7D, 0x52, 0x6A,
-		0x76, 0x8B, 0x12, 0x76, 0x70, 0x67, 0xBA, 0xEC,
-		0x26, 0x97, 0x6C, 0x60, 0xBD, 0x67, 0x8E, 0xD1,
-		0xCA, 0x58, 0xD4, 0x87, 0x54, 0x8E, 0x7D, 0xAA,
-		0x4A, 0x0F, 0xE2, 0x92, 0x13, 0xDF, 0x5E, 0x9F,
-		0x11, 0xB7, 0x44, 0x70, 0x84, 0x04, 0x8F, 0x03,
-		0xB4, 0xBB, 0x83, 0x87, 0x76, 0x1C, 0xC5, 0xB7,
-		0xF2, 0xF8, 0x2C, 0xD4, 0xFF, 0xAC, 0xDA, 0xAD,
-		0xAA, 0x59, 0xBA, 0xD9, 0xA9, 0x8D, 0x54, 0x37
+	(void)ctx;
+	rnd(dst, len);
+}
+
+static void
+test_oram(void)
+{
+	static const struct {
+		size_t elt_len, num_len;
+		int n;
+	} params[] = {
+		{ 1, 1, 50 },
+		{ 7, 2, 50 },
+		{ 16, 3, 100 },
+		{ 33, 17, 300 },
+		{ 4, 100, 1000 },
+		{ 16, 4096, 3000 },
+		{ 9, 4097, 3000 },
+		{ 16, 70000, 2000 },
 	};
+	size_t k;
 
-	static const char datab64[] =
-"bd2FZrNktkH2cGnXIMsqEOEzNOGLJrlx/eFYh/2y0dqdkwRnitwX2ss45bGBz4r521HFcC8miH82"
-"ZdTNImf5HXKf4f4r+PZ9OyvuhD+v7wEmCyEhUkni/HZGO3CilJIcr31Q4Cxtg6kJViFdjVYmBhVj"
-"frOMRWx9gr2gx45Y3dpwuBGDLoG8z61dCdpgA+iecvmu3KxWb/jrRFi6lbkrcYXUWHSiVMRmgORn"
-"/glw1SoFEmN3+9gZS6a+/gEJfVJqdosSdnBnuuwml2xgvWeO0cpY1IdUjn2qSg/ikhPfXp8Rt0Rw"
-"hASPA7S7g4d2HMW38vgs1P+s2q2qWbrZqY1UNw==";
+	printf("Test ORAM: ");
+	fflush(stdout);
 
-	size_t u;
+	rnd_init(13);
 
-	printf("Test base64: ");
-	fflush(stdout);
+	/*
+	 * Invalid parameters.
+	 */
+	check(cttk_oram_mem_len(0, 10) == 0, "mem_len (elt_len = 0)");
+	check(cttk_oram_mem_len(10, 0) == 0, "mem_len (num_len = 0)");
+	check(cttk_oram_mem_len(10, (size_t)1 << 31) == 0,
+		"mem_len (too many elements)");
+
+	for (k = 0; k < (sizeof params) / sizeof params[0]; k ++) {
+		cttk_oram o;
+		size_t elt_len, num_len, mem_len;
+		unsigned char *mem, *ref, buf[64], buf2[64];
+		int i;
 
-	for (u = 0; u <= sizeof databin; u ++) {
-		char text[(sizeof databin) << 1], tref[sizeof text];
-		unsigned char data[sizeof databin];
-		int ff;
-		size_t len;
+		elt_len = params[k].elt_len;
+		num_len = params[k].num_len;
+		mem_len = cttk_oram_mem_len(elt_len, num_len);
+		check(mem_len != 0, "mem_len (%zu,%zu)", elt_len, num_len);
+		mem = malloc(mem_len);
+		ref = calloc(num_len, elt_len);
+		check(mem != NULL && ref != NULL, "malloc");
+		check(!cttk_oram_init(&o, mem, mem_len - 1, elt_len, num_len,
+			oram_rng, NULL), "init (short)");
+		check(cttk_oram_init(&o, mem, mem_len, elt_len, num_len,
+			oram_rng, NULL), "init (%zu,%zu)", elt_len, num_len);
+
+		for (i = 0; i < params[k].n; i ++) {
+			size_t index;
+
+			/*
+			 * Accesses are concentrated on a subset of indices
+			 * half of the time, so that elements are written
+			 * and read back several times. A few accesses are
+			 * out of range.
+			 */
+			index = rnd32() % (num_len + 2);
+			if ((i & 1) != 0) {
+				index %= 20;
+			}
+			if ((rnd32() & 1) == 0) {
+				rnd(buf, elt_len);
+				check(cttk_oram_write(&o, index, buf).v,
+					"write (%zu,%d)", k, i);
+				if (index < num_len) {
+					memcpy(ref + index * elt_len,
+						buf, elt_len);
+				}
+			} else {
+				memset(buf2, 0, elt_len);
+				if (index < num_len) {
+					memcpy(buf2, ref + index * elt_len,
+						elt_len);
+				}
+				check(cttk_oram_read(&o, buf, index).v,
+					"read (%zu,%d)", k, i);
+				check(memcmp(buf, buf2, elt_len) == 0,
+					"read value (%zu,%d)", k, i);
+			}
+		}
 
 		/*
-		 * Check test Base64 encoder against reference.
+		 * Read back a sample of the elements.
 		 */
-		b64enc(tref, databin, u, 1, 0, 0);
-		if (u == sizeof databin) {
-			check(strcmp(tref, datab64) == 0, "b64enc ref");
-		} else {
-			len = 4 * (u / 3);
-			check(memcmp(tref, datab64, len) == 0, "b64enc ref");
+		for (i = 0; i < 100; i ++) {
+			size_t index;
+
+			index = (size_t)i < num_len ? (size_t)i
+				: rnd32() % num_len;
+			check(cttk_oram_read(&o, buf, index).v, "read");
+			check(memcmp(buf, ref + index * elt_len, elt_len) == 0,
+				"read back (%zu,%d)", k, i);
 		}
 
+		free(mem);
+		free(ref);
+		printf(".");
+		fflush(stdout);
+	}
+
+	printf(" done.\n");
+	fflush(stdout);
+}
+
+static void
+test_omap(void)
+{
+	static const struct {
+		size_t key_len, val_len, num, keys;
+		int n;
+	} params[] = {
+		{ 1, 1, 1, 3, 100 },
+		{ 1, 0, 16, 40, 500 },
+		{ 4, 8, 100, 150, 2000 },
+		{ 16, 16, 1000, 1000, 3000 },
+		{ 33, 3, 300, 600, 2000 },
+	};
+	size_t k;
+
+	printf("Test omap: ");
+	fflush(stdout);
+
+	rnd_init(14);
+
+	check(cttk_omap_mem_len(0, 4, 10) == 0, "mem_len (key_len = 0)");
+	check(cttk_omap_mem_len(4, 4, 0) == 0, "mem_len (num = 0)");
+
+	for (k = 0; k < (sizeof params) / sizeof params[0]; k ++) {
+		cttk_omap m;
+		size_t key_len, val_len, num, nkeys, mem_len, count, u;
+		unsigned char *mem, *keys, *vals, *present;
+		unsigned char val[64], ref[64];
+		int i;
+
+		key_len = params[k].key_len;
+		val_len = params[k].val_len;
+		num = params[k].num;
+		nkeys = params[k].keys;
+		mem_len = cttk_omap_mem_len(key_len, val_len, num);
+		check(mem_len != 0, "mem_len (%zu)", k);
+		mem = malloc(mem_len);
+		keys = malloc(nkeys * key_len);
+		vals = calloc(nkeys, val_len + 1);
+		present = calloc(nkeys, 1);
+		check(mem != NULL && keys != NULL && vals != NULL
+			&& present != NULL, "malloc");
+		check(!cttk_omap_init(&m, mem, mem_len - 1,
+			key_len, val_len, num, oram_rng, NULL), "init (short)");
+		check(cttk_omap_init(&m, mem, mem_len,
+			key_len, val_len, num, oram_rng, NULL), "init (%zu)", k);
+
 		/*
-		 * Test encoder with all flag combinations and truncation.
+		 * Distinct random keys (for 1-byte keys, we use all
+		 * values in order).
 		 */
-		for (ff = 0; ff < 10; ff ++) {
-			int pad, line_len, crlf;
-			unsigned flags;
+		for (u = 0; u < nkeys; u ++) {
 			size_t v;
 
-			flags = 0;
-			pad = ff / 5;
-			if (!pad) {
-				flags |= CTTK_B64ENC_NO_PAD;
+			for (;;) {
+				if (key_len == 1) {
+					keys[u] = (unsigned char)u;
+				} else {
+					rnd(keys + u * key_len, key_len);
+				}
+				for (v = 0; v < u; v ++) {
+					if (memcmp(keys + u * key_len,
+						keys + v * key_len,
+						key_len) == 0)
+					{
+						break;
+					}
+				}
+				if (v == u) {
+					break;
+				}
 			}
-			switch (ff % 3) {
+		}
+
+		count = 0;
+		for (i = 0; i < params[k].n; i ++) {
+			const unsigned char *key;
+			cttk_bool r;
+
+			u = rnd32() % nkeys;
+			key = keys + u * key_len;
+			switch (rnd32() % 3) {
 			case 0:
-				line_len = 0;
-				crlf = 0;
+				if (!present[u] && count >= num) {
+					break;
+				}
+				rnd(val, val_len);
+				r = cttk_omap_insert(&m, key, val);
+				check(r.v, "insert (%zu,%d)", k, i);
+				memcpy(vals + u * val_len, val, val_len);
+				count += !present[u];
+				present[u] = 1;
 				break;
 			case 1:
-				line_len = 19;
-				crlf = 0;
-				flags |= CTTK_B64ENC_NEWLINE;
+				r = cttk_omap_delete(&m, key);
+				check(r.v == present[u], "delete (%zu,%d)", k, i);
+				count -= present[u];
+				present[u] = 0;
 				break;
-			case 2:
-				line_len = 16;
-				crlf = 0;
-				flags |= CTTK_B64ENC_NEWLINE;
-				flags |= CTTK_B64ENC_LINE64;
-				break;
-			case 3:
-				line_len = 19;
-				crlf = 1;
-				flags |= CTTK_B64ENC_NEWLINE;
-				flags |= CTTK_B64ENC_CRLF;
-				break;
-			case 4:
-				line_len = 16;
-				crlf = 1;
-				flags |= CTTK_B64ENC_NEWLINE;
-				flags |= CTTK_B64ENC_LINE64;
-				flags |= CTTK_B64ENC_CRLF;
+			default:
+				memset(ref, 0, val_len);
+				if (present[u]) {
+					memcpy(ref, vals + u * val_len, val_len);
+				}
+				r = cttk_omap_lookup(&m, key, val);
+				check(r.v == present[u], "lookup (%zu,%d)", k, i);
+				check(memcmp(val, ref, val_len) == 0,
+					"lookup value (%zu,%d)", k, i);
 				break;
 			}
-
-			b64enc(tref, databin, u, pad, line_len, crlf);
-			len = cttk_bintob64_gen(NULL, 0, databin, u, flags);
-			check(len == strlen(tref), "b64enc (%zu, %d) 1", u, ff);
-			len = cttk_bintob64_gen(text, sizeof text,
-				databin, u, flags);
-			check(len == strlen(tref), "b64enc (%zu, %d) 2", u, ff);
-			check(len == strlen(text), "b64enc (%zu, %d) 3", u, ff);
-			check(!strcmp(text, tref), "b64enc (%zu, %d) 4", u, ff);
-			check(cttk_bintob64_gen(text, 0, databin,
-				u, flags) == 0, "b64enc (%zu, %d) 5", u, ff);
-
-			for (v = 0; v <= len; v ++) {
-				size_t len2;
-
-				len2 = cttk_bintob64_gen(text, v + 1,
-					databin, u, flags);
-				check(len2 == v,
-					"b64enc (%zu, %d, %zu) 6", u, ff, v);
-				check(len2 == strlen(text),
-					"b64enc (%zu, %d, %zu) 7", u, ff, v);
-				check(memcmp(text, tref, len2) == 0,
-					"b64enc (%zu, %d, %zu) 8", u, ff, v);
-			}
 		}
 
 		/*
-		 * Test decoder with added whitespace and non-whitespace.
+		 * Fill the map up to its capacity, then check all keys.
 		 */
-		for (ff = 0; ff < 2; ff ++) {
-			size_t v;
+		for (u = 0; u < nkeys && count < num; u ++) {
+			if (!present[u]) {
+				rnd(val, val_len);
+				check(cttk_omap_insert(&m,
+					keys + u * key_len, val).v,
+					"insert (fill) (%zu,%zu)", k, u);
+				memcpy(vals + u * val_len, val, val_len);
+				present[u] = 1;
+				count ++;
+			}
+		}
+		for (u = 0; u < nkeys; u ++) {
+			cttk_bool r;
+
+			r = cttk_omap_lookup(&m, keys + u * key_len, val);
+			check(r.v == present[u], "lookup (final) (%zu,%zu)", k, u);
+			if (present[u]) {
+				check(memcmp(val, vals + u * val_len,
+					val_len) == 0,
+					"lookup value (final) (%zu,%zu)", k, u);
+			}
+		}
 
-			b64enc(tref + 1, databin, u, ff, 0, 0);
-			len = strlen(tref + 1);
-			for (v = 0; v <= len; v ++) {
-				size_t len2, len3;
-				const char *err;
+		free(mem);
+		free(keys);
+		free(vals);
+		free(present);
+		printf(".");
+		fflush(stdout);
+	}
 
-				if (v == 0) {
-					tref[0] = ' ';
-				} else {
-					tref[v - 1] = tref[v];
-					tref[v] = ' ';
-				}
-				err = datab64;
-				len2 = cttk_b64tobin_gen(data, sizeof data,
-					tref, len + 1, &err,
-					ff ? 0 : CTTK_B64DEC_NO_PAD);
-				check(len2 == u,
-					"b64dec (%zu, %d, %zu) 1", u, ff, v);
-				check(err == NULL,
-					"b64dec (%zu, %d, %zu) 2", u, ff, v);
-				check(memcmp(data, databin, u) == 0,
-					"b64dec (%zu, %d, %zu) 3", u, ff, v);
+	printf(" done.\n");
+	fflush(stdout);
+}
 
-				err = datab64;
-				len2 = cttk_b64tobin_gen(data, sizeof data,
-					tref, len + 1, &err,
-					(ff ? 0 : CTTK_B64DEC_NO_PAD)
-					| CTTK_B64DEC_NO_WS);
-				check(err == tref + v,
-					"b64dec (%zu, %d, %zu) 4", u, ff, v);
-				len3 = (v * 3) / 4;
-				if (len3 > u) {
-					len3 = u;
-				}
-				check(len2 == len3,
-					"b64dec (%zu, %d, %zu) 5", u, ff, v);
-				check(memcmp(data, databin, len2) == 0,
-					"b64dec (%zu, %d, %zu) 6", u, ff, v);
+/*
+ * Record length for cmp_records() (used with qsort()).
+ */
+static size_t sort_rec_len;
 
-				tref[v] = '%';
-				err = datab64;
-				len2 = cttk_b64tobin_gen(data, sizeof data,
-					tref, len + 1, &err,
-					ff ? 0 : CTTK_B64DEC_NO_PAD);
-				check(err == tref + v,
-					"b64dec (%zu, %d, %zu) 7", u, ff, v);
-				len3 = (v * 3) / 4;
-				if (len3 > u) {
-					len3 = u;
-				}
-				check(len2 == len3,
-					"b64dec (%zu, %d, %zu) 8", u, ff, v);
-				check(memcmp(data, databin, len2) == 0,
-					"b64dec (%zu, %d, %zu) 9", u, ff, v);
+static int
+cmp_records(const void *a, const void *b)
+{
+	return memcmp(a, b, sort_rec_len);
+}
+
+static void
+test_oblivious_sort(void)
+{
+	static const struct {
+		size_t elt_len, key_off, key_len, count;
+	} params[] = {
+		{ 1, 0, 1, 0 },
+		{ 1, 0, 1, 1 },
+		{ 4, 0, 4, 2 },
+		{ 4, 1, 2, 3 },
+		{ 8, 0, 8, 17 },
+		{ 8, 3, 1, 64 },
+		{ 16, 0, 16, 100 },
+		{ 16, 4, 8, 2048 },
+		{ 16, 8, 8, 5000 },
+		{ 40, 0, 32, 1025 },
+		{ 300, 7, 35, 1000 },
+		{ 3, 0, 0, 10 },
+	};
+	size_t k, total_jobs;
+
+	printf("Test oblivious sort: ");
+	fflush(stdout);
+
+	rnd_init(21);
+	total_jobs = 0;
+
+	for (k = 0; k < (sizeof params) / sizeof params[0]; k ++) {
+		size_t elt_len, key_off, key_len, count, len, u, nj;
+		unsigned char *a, *b, *ref;
+		unsigned nt;
+
+		elt_len = params[k].elt_len;
+		key_off = params[k].key_off;
+		key_len = params[k].key_len;
+		count = params[k].count;
+		len = elt_len * count;
+		a = malloc(len + 1);
+		b = malloc(len + 1);
+		ref = malloc(len + 1);
+		check(a != NULL && b != NULL && ref != NULL, "malloc");
+		rnd(a, len);
+
+		/*
+		 * Many duplicate keys in half of the records.
+		 */
+		for (u = 0; u < count; u += 2) {
+			if (key_len > 0) {
+				memset(a + u * elt_len + key_off,
+					(int)(rnd32() % 3), key_len);
 			}
 		}
+		memcpy(ref, a, len);
+		memcpy(b, a, len);
+
+		cttk_oblivious_sort(a, count, elt_len, key_off, key_len);
+		for (u = 1; u < count; u ++) {
+			check(memcmp(a + (u - 1) * elt_len + key_off,
+				a + u * elt_len + key_off, key_len) <= 0,
+				"sort order (%zu,%zu)", k, u);
+		}
 
 		/*
-		 * Test decoder with a truncated input.
+		 * Multi-threaded mode must produce the same output.
 		 */
-		for (ff = 0; ff < 2; ff ++) {
-			size_t v;
+		for (nt = 0; nt <= 7; nt += 7) {
+			memcpy(b, ref, len);
+			nj = 0;
+			cttk_oblivious_sort_mt(b, count, elt_len,
+				key_off, key_len, nt, seq_exec, &nj);
+			check(memcmp(a, b, len) == 0,
+				"sort mt (%zu,%u)", k, nt);
+			check(nt > 1 || nj == 0, "sort mt jobs (%zu)", k);
+			total_jobs += nj;
+		}
 
-			b64enc(tref, databin, u, ff, 0, 0);
-			len = strlen(tref);
-			for (v = 0; v <= len; v ++) {
-				size_t len2, len3;
-				const char *err, *err2;
+		/*
+		 * The records must be a permutation of the source.
+		 */
+		if (count > 0) {
+			sort_rec_len = elt_len;
+			qsort(ref, count, elt_len, &cmp_records);
+			memcpy(b, a, len);
+			qsort(b, count, elt_len, &cmp_records);
+			check(memcmp(ref, b, len) == 0,
+				"sort permutation (%zu)", k);
+		}
 
-				err = datab64;
-				len2 = cttk_b64tobin_gen(data, sizeof data,
-					tref, v, &err,
-					ff ? 0 : CTTK_B64DEC_NO_PAD);
-				len3 = (v * 3) / 4;
-				if (len3 > u) {
-					len3 = u;
-				}
-				check(len2 == len3,
-					"b64trunc1 (%zu, %d, %zu) 1", u, ff, v);
-				if (ff) {
-					if (v % 4 == 0) {
-						err2 = NULL;
-					} else {
-						err2 = tref + v;
-					}
-				} else {
-					int ok;
+		free(a);
+		free(b);
+		free(ref);
+		printf(".");
+		fflush(stdout);
+	}
+	check(total_jobs > 0, "sort mt jobs");
 
-					if (len3 == u) {
-						ok = 1;
-					} else if (v % 4 == 0) {
-						ok = 1;
-					} else if (v % 4 == 1) {
-						ok = 0;
-					} else if (v % 4 == 2) {
-						ok = !(databin[len3] & 0xF0);
-					} else {
-						ok = !(databin[len3] & 0xC0);
-					}
-					err2 = ok ? NULL : tref + v;
-				}
-				check(err == err2,
-					"b64trunc1 (%zu, %d, %zu) 2", u, ff, v);
-				check(memcmp(data, databin, u) == 0,
-					"b64trunc1 (%zu, %d, %zu) 3", u, ff, v);
-			}
-		}
+	printf(" done.\n");
+	fflush(stdout);
+}
 
-		/*
-		 * Test decoder with a truncated output.
-		 */
-		for (ff = 0; ff < 2; ff ++) {
-			size_t v;
+/*
+ * Bitsliced functions generated by bsgen from test/aes_sbox.bs and
+ * test/add4.bs (see mk/mkrules.sh).
+ */
+void bs_aes_sbox_32(uint32_t *d, const uint32_t *s);
+void bs_aes_sbox_64(uint32_t *d, const uint32_t *s);
+void bs_aes_sbox_128(uint32_t *d, const uint32_t *s);
+void bs_aes_sbox_256(uint32_t *d, const uint32_t *s);
+void bs_add4_64(uint32_t *d, const uint32_t *s);
 
-			b64enc(tref, databin, u, ff, 0, 0);
-			len = strlen(tref);
-			for (v = 0; v <= u; v ++) {
-				size_t len2;
-				const char *err, *err2;
+/*
+ * Reference AES S-box, computed from its definition (inversion in
+ * GF(2^8), then affine transform).
+ */
+static void
+make_aes_sbox(unsigned char *sbox)
+{
+	unsigned x;
 
-				err = datab64;
-				len2 = cttk_b64tobin_gen(data, v,
-					tref, len, &err,
-					ff ? 0 : CTTK_B64DEC_NO_PAD);
-				check(len2 == v,
-					"b64trunc2 (%zu, %d, %zu) 1", u, ff, v);
-				err2 = (v == u) ? NULL : tref + (4 * v + 2) / 3;
-				check(err == err2,
-					"b64trunc2 (%zu, %d, %zu) 2", u, ff, v);
-				check(memcmp(data, databin, v) == 0,
-					"b64trunc2 (%zu, %d, %zu) 3", u, ff, v);
+	for (x = 0; x < 256; x ++) {
+		unsigned y, z, k, a;
+
+		/*
+		 * Inverse of x is x^254 (and 0 for x = 0).
+		 */
+		y = 1;
+		for (k = 0; k < 254; k ++) {
+			unsigned b, p;
+
+			p = 0;
+			a = y;
+			for (b = x; b != 0; b >>= 1) {
+				if (b & 1) {
+					p ^= a;
+				}
+				a <<= 1;
+				if (a & 0x100) {
+					a ^= 0x11B;
+				}
 			}
+			y = p;
 		}
-
-		if ((u & 7) == 0) {
-			printf(".");
-			fflush(stdout);
+		z = y;
+		for (k = 1; k <= 4; k ++) {
+			z ^= ((y << k) | (y >> (8 - k))) & 0xFF;
 		}
+		sbox[x] = (unsigned char)(z ^ 0x63);
 	}
-
-	printf(" done.\n");
-	fflush(stdout);
 }
 
 static void
-test_mul(void)
+test_bitslice(void)
 {
-	int i, j, k;
-	uint32_t xu32, yu32;
-	int32_t xs32, ys32;
-	uint64_t xu64, yu64;
-	int64_t xs64, ys64;
+	static const struct {
+		void (*fn)(uint32_t *d, const uint32_t *s);
+		size_t width;
+	} sbox_fns[] = {
+		{ bs_aes_sbox_32, 32 },
+		{ bs_aes_sbox_64, 64 },
+		{ bs_aes_sbox_128, 128 },
+		{ bs_aes_sbox_256, 256 },
+	};
+	static const unsigned bit_sizes[] = { 1, 5, 8, 17, 31, 32 };
+	unsigned char sbox[256];
+	size_t width, k;
 
-	printf("Test mul: ");
+	printf("Test bitslice: ");
 	fflush(stdout);
 
-	for (i = 0; i < 32 * 64; i ++) {
-		k = i >> 5;
-		xu64 = (uint64_t)((i & 15) - 8);
-		if (i < 32 * 4) {
-			xu64 >>= k;
-		} else {
-			xu64 <<= k;
-			xu64 ^= (uint64_t)((i >> 4) & 1) << (i >> 6);
+	rnd_init(25);
+	make_aes_sbox(sbox);
+
+	for (width = 32; width <= 256; width <<= 1) {
+		uint32_t v[256], w[256], q[32 * 8], q2[32 * 8];
+		unsigned char b[256], b2[256];
+		size_t nw, i;
+		int n;
+
+		nw = width >> 5;
+		for (k = 0; k < (sizeof bit_sizes) / sizeof bit_sizes[0]; k ++) {
+			unsigned nbits, j;
+
+			nbits = bit_sizes[k];
+			for (n = 0; n < 20; n ++) {
+				rnd(v, width * sizeof v[0]);
+				cttk_bitslice_in(q, v, width, nbits);
+				for (i = 0; i < width; i ++) {
+					for (j = 0; j < nbits; j ++) {
+						check(((q[j * nw + (i >> 5)]
+							>> (i & 31)) & 1)
+							== ((v[i] >> j) & 1),
+							"bitslice_in (%zu,%u,%zu,%u)",
+							width, nbits, i, j);
+					}
+				}
+				cttk_bitslice_out(w, q, width, nbits);
+				for (i = 0; i < width; i ++) {
+					uint32_t m;
+
+					m = nbits == 32 ? (uint32_t)-1
+						: (((uint32_t)1 << nbits) - 1);
+					check(w[i] == (v[i] & m),
+						"bitslice_out (%zu,%u,%zu)",
+						width, nbits, i);
+				}
+			}
 		}
-		xs64 = *(int64_t *)&xu64;
-		xu32 = (uint32_t)xu64;
-		xs32 = *(int32_t *)&xu32;
-		for (j = 0; j < 32 * 64; j ++) {
-			uint32_t ru32;
-			int32_t rs32;
-			uint64_t ru32w, ru64;
-			int64_t rs32w, rs64;
 
-			k = j >> 5;
-			yu64 = (uint64_t)((j & 15) - 8);
-			if (j < 32 * 4) {
-				yu64 >>= k;
-			} else {
-				yu64 <<= k;
-				yu64 ^= (uint64_t)((j >> 4) & 1) << (j >> 6);
+		for (n = 0; n < 20; n ++) {
+			rnd(b, width);
+			for (i = 0; i < width; i ++) {
+				v[i] = b[i];
 			}
-			ys64 = *(int64_t *)&yu64;
-			yu32 = (uint32_t)yu64;
-			ys32 = *(int32_t *)&yu32;
+			cttk_bitslice_in(q, v, width, 8);
+			cttk_bitslice_in8(q2, b, width);
+			check(memcmp(q, q2, width) == 0,
+				"bitslice_in8 (%zu)", width);
+			cttk_bitslice_out8(b2, q, width);
+			check(memcmp(b, b2, width) == 0,
+				"bitslice_out8 (%zu)", width);
+		}
+		printf(".");
+		fflush(stdout);
+	}
 
-			ru32 = xu32 * yu32;
-			rs32 = *(int32_t *)&ru32;
-			ru32w = (uint64_t)xu32 * (uint64_t)yu32;
-			rs32w = (int64_t)xs32 * (int64_t)ys32;
-			ru64 = xu64 * yu64;
-			rs64 = xs64 * ys64;
+	for (k = 0; k < (sizeof sbox_fns) / sizeof sbox_fns[0]; k ++) {
+		uint32_t q[64], q2[64];
+		unsigned char b[256], b2[256];
+		size_t i;
+		int n;
+
+		width = sbox_fns[k].width;
+		for (n = 0; n < 20; n ++) {
+			rnd(b, width);
+			if (n == 0) {
+				for (i = 0; i < width; i ++) {
+					b[i] = (unsigned char)i;
+				}
+			}
+			cttk_bitslice_in8(q, b, width);
+			sbox_fns[k].fn(q2, q);
+			cttk_bitslice_out8(b2, q2, width);
+			for (i = 0; i < width; i ++) {
+				check(b2[i] == sbox[b[i]],
+					"bitslice AES (%zu,%d,%zu)", width, n, i);
+			}
 
-			check(cttk_mulu32(xu32, yu32) == ru32,
-				"mulu32: %lu, %lu\n",
-				(unsigned long)xu32,
-				(unsigned long)yu32);
-			check(cttk_muls32(xs32, ys32) == rs32,
-				"muls32: %llu, %llu\n",
-				(long)xs32,
-				(long)ys32);
-			check(cttk_mulu32w(xu32, yu32) == ru32w,
-				"mulu32w: %lu, %lu\n",
-				(unsigned long)xu32,
-				(unsigned long)yu32);
-			check(cttk_muls32w(xs32, ys32) == rs32w,
-				"muls32w: %lu, %lu\n",
-				(long)xs32,
-				(long)ys32);
-			check(cttk_mulu64(xu64, yu64) == ru64,
-				"mulu64: %llu, %llu\n",
-				(unsigned long long)xu64,
-				(unsigned long long)yu64);
-			check(cttk_muls64(xs64, ys64) == rs64,
-				"muls64: %llu, %llu\n",
-				(long long)xs64,
-				(long long)ys64);
+			/*
+			 * In-place evaluation.
+			 */
+			sbox_fns[k].fn(q, q);
+			check(memcmp(q, q2, width) == 0,
+				"bitslice AES in place (%zu,%d)", width, n);
 		}
+		printf(".");
+		fflush(stdout);
+	}
 
-		if ((i & 31) == 0) {
-			printf(".");
-			fflush(stdout);
+	for (k = 0; k < 20; k ++) {
+		uint32_t v[64], w[64], q[16], q2[12];
+		size_t i;
+
+		rnd(v, sizeof v);
+		for (i = 0; i < 64; i ++) {
+			v[i] &= 0xFF;
+		}
+		v[0] = 0;
+		v[1] = 0xFF;
+		cttk_bitslice_in(q, v, 64, 8);
+		bs_add4_64(q2, q);
+		cttk_bitslice_out(w, q2, 64, 6);
+		for (i = 0; i < 64; i ++) {
+			uint32_t s;
+
+			s = (v[i] & 0x0F) + (v[i] >> 4);
+			s |= (uint32_t)(s == 0) << 5;
+			check(w[i] == s, "bitslice add4 (%zu,%zu)", k, i);
 		}
 	}
 
@@ -1073,1124 +1334,4785 @@ test_mul(void)
 	fflush(stdout);
 }
 
-static void
-test_bitlength(void)
+/*
+ * Reference hexadecimal decoder (no whitespace), for comparison with
+ * cttk_hextobin_gen().
+ */
+static size_t
+hextobin_ref(unsigned char *dst, size_t dst_len,
+	const char *src, size_t src_len, const char **err, int pad)
 {
-	int i, j;
-
-	printf("Test bitlength: ");
-	fflush(stdout);
-
-	check(cttk_u32_bitlength(0) == 0, "bitlength 0");
-
-	for (i = 0; i <= 31; i ++) {
-		for (j = 0; j < 256; j ++) {
-			uint32_t x, y, bl;
+	size_t u, v;
+	int acc;
 
-			x = (uint32_t)1 << i;
-			if (j < 64) {
-				y = (uint32_t)j;
-				if (y < x) {
-					x += y;
-				}
-			} else if (j < 128) {
-				if (i >= 6) {
-					y = (uint32_t)(j - 64);
-					x += y << (i - 6);
-				}
-			} else if (j < 192) {
-				y = (uint32_t)(j - 128);
-				if (y < x) {
-					x = (x << 1) - 1;
-					x -= y;
-				}
-			} else {
-				if (i >= 6) {
-					x = (x << 1) - 1;
-					y = (uint32_t)(j - 192);
-					x -= y << (i - 6);
-				}
+	acc = -1;
+	v = 0;
+	for (u = 0; u < src_len; u ++) {
+		int c, d;
+
+		c = *((const unsigned char *)src + u);
+		if (c >= '0' && c <= '9') {
+			d = c - '0';
+		} else if (c >= 'A' && c <= 'F') {
+			d = c - ('A' - 10);
+		} else if (c >= 'a' && c <= 'f') {
+			d = c - ('a' - 10);
+		} else {
+			*err = src + u;
+			if (acc >= 0 && pad) {
+				dst[v ++] = acc;
 			}
-
-			bl = cttk_u32_bitlength(x);
-			check(bl == (uint32_t)(i + 1),
-				"bitlength: %08lX -> %u (%d,%d)",
-				(unsigned long)x, (unsigned)bl, i, j);
+			return v;
+		}
+		if (acc >= 0) {
+			dst[v ++] = acc + d;
+			acc = -1;
+		} else {
+			if (v == dst_len) {
+				*err = src + u;
+				return v;
+			}
+			acc = d << 4;
 		}
 	}
-
-	printf("done.\n");
-	fflush(stdout);
+	if (acc >= 0) {
+		if (pad) {
+			dst[v ++] = acc;
+		} else {
+			*err = src + src_len;
+			return v;
+		}
+	}
+	*err = NULL;
+	return v;
 }
 
 /*
- * Custom rudimentary bigint implementation for test purposes.
- * Each integer is an array of 16-bit words, in little-endian order.
- * Maximum size is 512 bits.
+ * Decode a string with a streaming decoder (hexadecimal if b64 is zero,
+ * Base64 otherwise), with random chunk lengths and random (small)
+ * output buffer lengths. The result is checked against the one-shot
+ * decoder output (ref_len bytes in ref, error pointer ref_err).
  */
-typedef struct {
-	uint16_t v[32];
-} zint;
-
 static void
-zint_zero(zint *z)
+check_dec_stream(int b64, const char *src, size_t src_len, unsigned flags,
+	const unsigned char *ref, size_t ref_len, const char *ref_err)
 {
-	memset(z->v, 0, sizeof z->v);
-}
+	cttk_hexdec_context hc;
+	cttk_b64dec_context bc;
+	unsigned char out[1000];
+	size_t u, v;
+	const char *serr;
+	cttk_bool ok;
 
-static void
-zint_set_u64(zint *z, uint64_t x)
-{
-	memset(z->v, 0, sizeof z->v);
-	z->v[0] = (uint16_t)x;
-	z->v[1] = (uint16_t)(x >> 16);
-	z->v[2] = (uint16_t)(x >> 32);
-	z->v[3] = (uint16_t)(x >> 48);
+	if (b64) {
+		cttk_b64dec_init(&bc, flags);
+	} else {
+		cttk_hexdec_init(&hc, flags);
+	}
+	serr = NULL;
+	v = 0;
+	for (u = 0; u < src_len && serr == NULL;) {
+		size_t clen;
+		const char *p;
+
+		clen = rnd32() % 40;
+		if (clen > src_len - u) {
+			clen = src_len - u;
+		}
+		p = src + u;
+		for (;;) {
+			size_t olen, r;
+			const char *err;
+
+			olen = 1 + rnd32() % ((rnd32() & 1) ? 6 : 100);
+			if (olen > sizeof out - v) {
+				olen = sizeof out - v;
+			}
+			if (b64) {
+				r = cttk_b64dec_update(&bc, out + v, olen,
+					p, (src + u + clen) - p, &err);
+			} else {
+				r = cttk_hexdec_update(&hc, out + v, olen,
+					p, (src + u + clen) - p, &err);
+			}
+			v += r;
+			if (err == NULL) {
+				break;
+			}
+
+			/*
+			 * No progress means an invalid character;
+			 * otherwise, the output buffer was full.
+			 */
+			if (err == p && r == 0) {
+				serr = err;
+				break;
+			}
+			p = err;
+		}
+		u += clen;
+	}
+	if (b64) {
+		ok = cttk_b64dec_final(&bc);
+	} else {
+		size_t r;
+
+		ok = cttk_hexdec_final(&hc, out + v, sizeof out - v, &r);
+		v += r;
+	}
+	check(v == ref_len, "dec stream 1");
+	check(memcmp(out, ref, v) == 0, "dec stream 2");
+	if (ref_err == NULL) {
+		check(ok.v && serr == NULL, "dec stream 3");
+	} else if (ref_err == src + src_len) {
+		check(!ok.v && serr == NULL, "dec stream 4");
+	} else {
+		check(!ok.v && serr == ref_err, "dec stream 5");
+	}
 }
 
-/* unused
 static void
-zint_set_s64(zint *z, int64_t x)
+test_hex(void)
 {
-	zint_set_u64(z, (uint64_t)x);
-	if (x < 0) {
-		memset(z->v + 4, 0xFF, (sizeof z->v) - 4 * sizeof(uint16_t));
+	static const unsigned char databin[] = {
+		0x38, 0xF2, 0x45, 0x86, 0x85, 0x82, 0xE3, 0x59,
+		0x83, 0x3D, 0xE0, 0x0D, 0x90, 0x50, 0x5F, 0xA8,
+		0x41, 0xBF, 0x0A, 0xE3, 0x01, 0x5B, 0x70, 0xCA,
+		0x16, 0x0B, 0xDB, 0x63, 0x57, 0xF1, 0xB9, 0xE3,
+		0x9A, 0x3F, 0xF6, 0x49, 0x28, 0xCA, 0xC9, 0x4F,
+		0xCB, 0x6E, 0x44, 0x11, 0x92, 0x82, 0xC4, 0x72,
+		0xF4, 0x31, 0xB1, 0xDF, 0x0C, 0xDE, 0xA5, 0x85,
+		0x03, 0x26, 0x4C, 0x87, 0xC4, 0x76, 0x5E, 0x5C,
+		0x6C, 0x61, 0x63, 0x7F, 0x93, 0xC1, 0xE1, 0x60,
+		0xC3, 0x3C, 0x2C, 0x11, 0x4C, 0x83, 0x6C, 0x1A,
+		0x57, 0x2C, 0x72, 0x1B, 0x63, 0x44, 0x0B, 0xB8,
+		0x4A, 0x46, 0x7C, 0x42, 0xAA, 0xBA, 0x56, 0xF2,
+		0x67, 0x5E, 0xA4, 0xA0, 0x0D, 0x7A, 0xF9, 0x59,
+		0xE1, 0xF5, 0xCA, 0xE7, 0x0B, 0xA0, 0xA6, 0xD7,
+		0x3E, 0xFE, 0xCF, 0x08, 0xDF, 0xE4, 0xA4, 0xBF,
+		0x7D, 0x4B, 0x84, 0x91, 0x17, 0xF2, 0x0C, 0x3B,
+		0x66, 0x58, 0xF3, 0x27, 0x4C, 0x88, 0x5C, 0x09,
+		0x47, 0xD0, 0xE3, 0x00, 0x40, 0x16, 0xBC, 0xFC,
+		0x56, 0x2C, 0x58, 0x3E, 0x95, 0xA2, 0x1C, 0x45,
+		0x7D, 0x18, 0xA9, 0xBC, 0xD1, 0x45, 0x54, 0x43,
+		0x5B, 0x46, 0x55, 0xBB, 0xA2, 0x23, 0xB1, 0x43,
+		0x1D, 0x02, 0x8A, 0xD2, 0x14, 0x7A, 0x3C, 0x36,
+		0x61, 0x21, 0x39, 0xA6, 0x7B, 0xC1, 0xB0, 0x13,
+		0x00, 0xCC, 0xAB, 0x50, 0x9F, 0x1D, 0x40, 0x01,
+		0xD2, 0x84, 0x55, 0x6C, 0xF5, 0x0E, 0x14, 0x74,
+		0xBC, 0xF1, 0x1D, 0x17, 0xE4, 0x98, 0x70, 0x2C,
+		0x1A, 0xD7, 0x66, 0x67, 0x33, 0xEE, 0x20, 0xE9,
+		0x5D, 0x93, 0xD0, 0xF4, 0x0A, 0xD8, 0x6D, 0x23,
+		0xF1, 0x08, 0x9D, 0x70, 0x1B, 0x97, 0xAC, 0x99,
+		0xB0, 0xE5, 0x3A, 0x4E, 0x7E, 0x46, 0xB2, 0x81,
+		0x24, 0xB9, 0x08, 0x23, 0xD2, 0x21, 0xF9, 0x3D,
+		0xB6, 0x96, 0xF4, 0xF6, 0x06, 0x65, 0x66, 0x04
+	};
+
+	char datastr[1 + ((sizeof databin) << 1)];
+	char tmp[sizeof datastr];
+	unsigned char buf[(sizeof databin) + 1];
+	size_t u, v, w;
+	int i, j;
+	const char *err;
+
+	printf("Test hex: ");
+	fflush(stdout);
+
+	for (i = 0; i < 2; i ++) {
+		unsigned flags;
+
+		flags = (i == 0) ? 0 : CTTK_HEX_UPPERCASE;
+		for (u = 0; u < sizeof databin; u ++) {
+			sprintf(datastr + (u << 1),
+				(i == 0) ? "%02x" : "%02X", databin[u]);
+		}
+		for (u = 0; u <= sizeof datastr; u ++) {
+			memset(tmp, 'T', sizeof tmp);
+			v = cttk_bintohex_gen(tmp, u,
+				databin, sizeof databin, flags);
+			if (u == 0) {
+				check(v == 0, "bintohex 1");
+				check(tmp[0] == 'T', "bintohex 2");
+			} else {
+				check(v == u - 1, "bintohex 3");
+				check(tmp[v] == 0, "bintohex 4");
+				check(memcmp(datastr, tmp, v) == 0,
+					"bintohex 5");
+			}
+		}
+		for (u = 0; u <= sizeof databin; u ++) {
+			memset(tmp, 'U', sizeof tmp);
+			v = cttk_bintohex_gen(tmp, sizeof tmp,
+				databin, u, flags);
+			check(v == (u << 1), "bintohex 6");
+			check(tmp[v] == 0, "bintohex 7");
+			check(memcmp(datastr, tmp, v) == 0, "bintohex 8");
+			v = cttk_bintohex_gen(NULL, 0, databin, u, flags);
+			check(v == (u << 1), "bintohex 9");
+		}
+		printf(".");
+		fflush(stdout);
+	}
+
+	for (i = 0; i < 2; i ++) {
+		for (u = 0; u < sizeof databin; u ++) {
+			sprintf(datastr + (u << 1),
+				(i == 0) ? "%02x" : "%02X", databin[u]);
+		}
+		for (u = 0; u <= sizeof datastr; u ++) {
+			memset(buf, 0xFF, sizeof buf);
+			v = cttk_hextobin_gen(buf, sizeof buf,
+				datastr, u, &err, 0);
+			check(v == (u >> 1), "hextobin 1");
+			if (u == sizeof datastr) {
+				check(err == datastr + u - 1, "hextobin 2");
+			} else if ((u & 1) == 1) {
+				check(err == datastr + u, "hextobin 3");
+			} else {
+				check(err == NULL, "hextobin 4");
+			}
+			check(memcmp(buf, databin, v) == 0, "hextobin 5");
+			check(buf[v] == 0xFF, "hextobin 6");
+
+			v = cttk_hextobin_gen(NULL, 0, datastr, u, &err, 0);
+			check(v == (u >> 1), "hextobin 7");
+			v = cttk_hextobin_gen(NULL, 0, datastr, u, NULL, 0);
+			check(v == (u >> 1), "hextobin 8");
+
+			memset(buf, 0xFF, sizeof buf);
+			v = cttk_hextobin_gen(buf, sizeof buf,
+				datastr, u, &err, CTTK_HEX_PAD_ODD);
+			if (u == sizeof datastr) {
+				check(v == (u >> 1), "hextobin 9");
+				check(err == datastr + u - 1, "hextobin 10");
+			} else if ((u & 1) == 1) {
+				check(v == ((u + 1) >> 1), "hextobin 11");
+				check(err == NULL, "hextobin 12");
+				v --;
+				check(buf[v] == (databin[v] & 0xF0),
+					"hextobin 13");
+			} else {
+				check(v == (u >> 1), "hextobin 14");
+				check(err == NULL, "hextobin 15");
+			}
+			check(memcmp(buf, databin, v) == 0, "hextobin 16");
+		}
+
+		for (u = 0; u <= sizeof databin; u ++) {
+			memset(buf, 0xFF, sizeof buf);
+			v = cttk_hextobin_gen(buf, u,
+				datastr, (sizeof databin) << 1, &err, 0);
+			check(u == v, "hextobin 17");
+			check(buf[v] == 0xFF, "hextobin 18");
+			if (u == sizeof databin) {
+				check(err == NULL, "hextobin 19");
+			} else {
+				check(err == datastr + (u << 1), "hextobin 20");
+			}
+			check(memcmp(buf, databin, u) == 0, "hextobin 21");
+		}
+
+		for (u = 0, v = 0; datastr[u] && v < (sizeof tmp) - 10; u ++) {
+			for (j = 0; j < (int)(u % 7); j ++) {
+				tmp[v] = 1 + (v & 31);
+				v ++;
+			}
+			tmp[v ++] = datastr[u];
+		}
+		if ((u & 1) != 0) {
+			v --;
+		}
+		memset(buf, 0xFF, sizeof buf);
+		w = cttk_hextobin_gen(buf, sizeof buf,
+			tmp, v, &err, CTTK_HEX_SKIP_WS);
+		check(w == (u >> 1), "hextobin 22");
+		check(buf[w] == 0xFF, "hextobin 23");
+		check(err == NULL, "hextobin 24");
+		check(memcmp(buf, databin, w) == 0, "hextobin 25");
+
+		printf(".");
+		fflush(stdout);
+	}
+
+	/*
+	 * Random strings, with an optional invalid character, decoded
+	 * at various offsets and with various output buffer lengths;
+	 * this exercises the block-wise decoding paths and their
+	 * transitions to the per-character loop.
+	 */
+	for (i = 0; i < 2000; i ++) {
+		static const char bad_chars[] = "/:@G`g \x7F\x80\xB0\xC1\xE6";
+		char str[300];
+		unsigned char buf1[160], buf2[160];
+		const char *err1, *err2;
+		size_t len, off, dlen, v1, v2;
+		int pad;
+
+		off = rnd32() & 31;
+		len = rnd32() % (sizeof str - off + 1);
+		for (u = 0; u < len; u ++) {
+			str[off + u] = "0123456789abcdefABCDEF"[rnd32() % 22];
+		}
+		if ((i & 1) != 0 && len > 0) {
+			str[off + rnd32() % len] =
+				bad_chars[rnd32() % (sizeof bad_chars - 1)];
+		}
+		dlen = rnd32() % (sizeof buf1 + 1);
+		pad = (i & 2) != 0;
+		memset(buf1, 0xFF, sizeof buf1);
+		memset(buf2, 0xFF, sizeof buf2);
+		v1 = cttk_hextobin_gen(buf1, dlen, str + off, len, &err1,
+			pad ? CTTK_HEX_PAD_ODD : 0);
+		v2 = hextobin_ref(buf2, dlen, str + off, len, &err2, pad);
+		check(v1 == v2, "hextobin 26");
+		check(err1 == err2, "hextobin 27");
+		check(memcmp(buf1, buf2, sizeof buf1) == 0, "hextobin 28");
+		v1 = cttk_hextobin_gen(NULL, 0, str + off, len, &err1,
+			pad ? CTTK_HEX_PAD_ODD : 0);
+		v2 = hextobin_ref(buf2, sizeof buf2, str + off, len,
+			&err2, pad);
+		check(v1 == v2, "hextobin 29");
+		check(err1 == err2, "hextobin 30");
+
+		/*
+		 * Streaming decoder, with and without whitespace.
+		 */
+		v1 = cttk_hextobin_gen(buf1, sizeof buf1, str + off, len, &err1,
+			pad ? CTTK_HEX_PAD_ODD : 0);
+		check_dec_stream(0, str + off, len, pad ? CTTK_HEX_PAD_ODD : 0,
+			buf1, v1, err1);
+		v1 = cttk_hextobin_gen(buf1, sizeof buf1, str + off, len, &err1,
+			CTTK_HEX_SKIP_WS | (pad ? CTTK_HEX_PAD_ODD : 0));
+		check_dec_stream(0, str + off, len,
+			CTTK_HEX_SKIP_WS | (pad ? CTTK_HEX_PAD_ODD : 0),
+			buf1, v1, err1);
+		if ((i & 255) == 0) {
+			printf(".");
+			fflush(stdout);
+		}
 	}
+
+	printf(" done.\n");
+	fflush(stdout);
 }
-*/
 
-static unsigned
-zint_bitlength(const zint *z)
+static char
+b64char(int x)
 {
-	unsigned w;
-	int i;
+	return "ABCDEFGHIJKLMNOPQRSTUVWXYZ"
+		"abcdefghijklmnopqrstuvwxyz0123456789+/" [x];
+}
 
-	if (z->v[31] >= 0x8000) {
-		w = 0xFFFF;
-	} else {
-		w = 0x0000;
-	}
-	for (i = 31; i >= 0; i --) {
-		if (z->v[i] != w) {
-			int j;
-			unsigned x;
+static void
+b64enc(char *dst, const unsigned char *buf, size_t len,
+	int pad, int line_len, int crlf)
+{
+	size_t u, v;
+	int lc;
 
-			x = z->v[i] ^ w;
-			for (j = 15; j >= 0; j --) {
-				if ((x >> j) != 0) {
-					return (i << 4) + j + 1;
-				}
+	lc = 0;
+	v = 0;
+	for (u = 0; (u + 2) < len; u += 3) {
+		uint32_t x;
+
+		x = ((uint32_t)buf[u] << 16)
+			| ((uint32_t)buf[u + 1] << 8)
+			| (uint32_t)buf[u + 2];
+		dst[v ++] = b64char(x >> 18);
+		dst[v ++] = b64char((x >> 12) & 63);
+		dst[v ++] = b64char((x >> 6) & 63);
+		dst[v ++] = b64char(x & 63);
+		lc ++;
+		if (lc == line_len) {
+			lc = 0;
+			if (crlf) {
+				dst[v ++] = '\r';
 			}
+			dst[v ++] = '\n';
+		}
+	}
+	if (u == len - 1) {
+		uint32_t x;
+
+		x = buf[u];
+		dst[v ++] = b64char(x >> 2);
+		dst[v ++] = b64char((x << 4) & 63);
+		if (pad) {
+			dst[v ++] = '=';
+			dst[v ++] = '=';
+		}
+		lc ++;
+	} else if (u == len - 2) {
+		uint32_t x;
+
+		x = ((uint32_t)buf[u] << 8) | (uint32_t)buf[u + 1];
+		dst[v ++] = b64char(x >> 10);
+		dst[v ++] = b64char((x >> 4) & 63);
+		dst[v ++] = b64char((x << 2) & 63);
+		if (pad) {
+			dst[v ++] = '=';
+		}
+		lc ++;
+	}
+	if (lc != 0 && line_len != 0) {
+		if (crlf) {
+			dst[v ++] = '\r';
+		}
+		dst[v ++] = '\n';
+	}
+	dst[v ++] = 0;
+}
+
+/*
+ * Reference Base64 decoder, for comparison with cttk_b64tobin_gen()
+ * (same semantics, with straightforward code).
+ */
+static size_t
+b64dec_ref(unsigned char *dst, size_t dst_len,
+	const char *src, size_t src_len, const char **err, unsigned flags)
+{
+	size_t u, v;
+	unsigned acc;
+	int lc;
+
+	acc = 0;
+	lc = 0;
+	v = 0;
+	for (u = 0; u < src_len; u ++) {
+		int c;
+		const char *p;
+
+		c = *((const unsigned char *)src + u);
+		p = (c == 0) ? NULL : strchr("ABCDEFGHIJKLMNOPQRSTUVWXYZ"
+			"abcdefghijklmnopqrstuvwxyz0123456789+/", c);
+		if (p == NULL) {
+			if (!(flags & CTTK_B64DEC_NO_WS) && c <= 32) {
+				continue;
+			}
+			if (c != '=' || (flags & CTTK_B64DEC_NO_PAD)
+				|| lc < 2 || acc != 0)
+			{
+				*err = src + u;
+				return v;
+			}
+			for (u ++; u < src_len; u ++) {
+				c = *((const unsigned char *)src + u);
+				if (lc == 2 && c == '=') {
+					lc ++;
+				} else if (c > 32
+					|| (flags & CTTK_B64DEC_NO_WS))
+				{
+					*err = src + u;
+					return v;
+				}
+			}
+			*err = (lc == 2) ? src + u : NULL;
+			return v;
+		}
+		if (dst != NULL && v >= dst_len) {
+			*err = src + u;
+			return v;
+		}
+		acc = (acc << 6) | (unsigned)(p - "ABCDEFGHIJKLMNOPQRSTUVWXYZ"
+			"abcdefghijklmnopqrstuvwxyz0123456789+/");
+		if (lc != 0) {
+			int k;
+
+			k = 6 - 2 * lc;
+			if (dst != NULL) {
+				dst[v] = (unsigned char)(acc >> k);
+			}
+			v ++;
+			acc &= (1u << k) - 1;
+		}
+		lc = (lc + 1) & 3;
+	}
+	if ((flags & CTTK_B64DEC_NO_PAD) ? (lc == 1 || acc != 0) : lc != 0) {
+		*err = src + u;
+		return v;
+	}
+	*err = NULL;
+	return v;
+}
+
+static void
+test_base64(void)
+{
+	/*
+	 * Test data is a random 256-byte blob.
+	 */
+	static const unsigned char databin[] = {
+		0x6D, 0xDD, 0x85, 0x66, 0xB3, 0x64, 0xB6, 0x41,
+		0xF6, 0x70, 0x69, 0xD7, 0x20, 0xCB, 0x2A, 0x10,
+		0xE1, 0x33, 0x34, 0xE1, 0x8B, 0x26, 0xB9, 0x71,
+		0xFD, 0xE1, 0x58, 0x87, 0xFD, 0xB2, 0xD1, 0xDA,
+		0x9D, 0x93, 0x04, 0x67, 0x8A, 0xDC, 0x17, 0xDA,
+		0xCB, 0x38, 0xE5, 0xB1, 0x81, 0xCF, 0x8A, 0xF9,
+		0xDB, 0x51, 0xC5, 0x70, 0x2F, 0x26, 0x88, 0x7F,
+		0x36, 0x65, 0xD4, 0xCD, 0x22, 0x67, 0xF9, 0x1D,
+		0x72, 0x9F, 0xE1, 0xFE, 0x2B, 0xF8, 0xF6, 0x7D,
+		0x3B, 0x2B, 0xEE, 0x84, 0x3F, 0xAF, 0xEF, 0x01,
+		0x26, 0x0B, 0x21, 0x21, 0x52, 0x49, 0xE2, 0xFC,
+		0x76, 0x46, 0x3B, 0x70, 0xA2, 0x94, 0x92, 0x1C,
+		0xAF, 0x7D, 0x50, 0xE0, 0x2C, 0x6D, 0x83, 0xA9,
+		0x09, 0x56, 0x21, 0x5D, 0x8D, 0x56, 0x26, 0x06,
+		0x15, 0x63, 0x7E, 0xB3, 0x8C, 0x45, 0x6C, 0x7D,
+		0x82, 0xBD, 0xA0, 0xC7, 0x8E, 0x58, 0xDD, 0xDA,
+		0x70, 0xB8, 0x11, 0x83, 0x2E, 0x81, 0xBC, 0xCF,
+		0xAD, 0x5D, 0x09, 0xDA, 0x60, 0x03, 0xE8, 0x9E,
+		0x72, 0xF9, 0xAE, 0xDC, 0xAC, 0x56, 0x6F, 0xF8,
+		0xEB, 0x44, 0x58, 0xBA, 0x95, 0xB9, 0x2B, 0x71,
+		0x85, 0xD4, 0x58, 0x74, 0xA2, 0x54, 0xC4, 0x66,
+		0x80, 0xE4, 0x67, 0xFE, 0x09, 0x70, 0xD5, 0x2A,
+		0x05, 0x12, 0x63, 0x77, 0xFB, 0xD8, 0x19, 0x4B,
+		0xA6, 0xBE, 0xFE, 0x01, 0x09, 0x7D, 0x52, 0x6A,
+		0x76, 0x8B, 0x12, 0x76, 0x70, 0x67, 0xBA, 0xEC,
+		0x26, 0x97, 0x6C, 0x60, 0xBD, 0x67, 0x8E, 0xD1,
+		0xCA, 0x58, 0xD4, 0x87, 0x54, 0x8E, 0x7D, 0xAA,
+		0x4A, 0x0F, 0xE2, 0x92, 0x13, 0xDF, 0x5E, 0x9F,
+		0x11, 0xB7, 0x44, 0x70, 0x84, 0x04, 0x8F, 0x03,
+		0xB4, 0xBB, 0x83, 0x87, 0x76, 0x1C, 0xC5, 0xB7,
+		0xF2, 0xF8, 0x2C, 0xD4, 0xFF, 0xAC, 0xDA, 0xAD,
+		0xAA, 0x59, 0xBA, 0xD9, 0xA9, 0x8D, 0x54, 0x37
+	};
+
+	static const char datab64[] =
+"bd2FZrNktkH2cGnXIMsqEOEzNOGLJrlx/eFYh/2y0dqdkwRnitwX2ss45bGBz4r521HFcC8miH82"
+"ZdTNImf5HXKf4f4r+PZ9OyvuhD+v7wEmCyEhUkni/HZGO3CilJIcr31Q4Cxtg6kJViFdjVYmBhVj"
+"frOMRWx9gr2gx45Y3dpwuBGDLoG8z61dCdpgA+iecvmu3KxWb/jrRFi6lbkrcYXUWHSiVMRmgORn"
+"/glw1SoFEmN3+9gZS6a+/gEJfVJqdosSdnBnuuwml2xgvWeO0cpY1IdUjn2qSg/ikhPfXp8Rt0Rw"
+"hASPA7S7g4d2HMW38vgs1P+s2q2qWbrZqY1UNw==";
+
+	size_t u;
+
+	printf("Test base64: ");
+	fflush(stdout);
+
+	for (u = 0; u <= sizeof databin; u ++) {
+		char text[(sizeof databin) << 1], tref[sizeof text];
+		unsigned char data[sizeof databin];
+		int ff;
+		size_t len;
+
+		/*
+		 * Check test Base64 encoder against reference.
+		 */
+		b64enc(tref, databin, u, 1, 0, 0);
+		if (u == sizeof databin) {
+			check(strcmp(tref, datab64) == 0, "b64enc ref");
+		} else {
+			len = 4 * (u / 3);
+			check(memcmp(tref, datab64, len) == 0, "b64enc ref");
+		}
+
+		/*
+		 * Test encoder with all flag combinations and truncation.
+		 */
+		for (ff = 0; ff < 10; ff ++) {
+			int pad, line_len, crlf;
+			unsigned flags;
+			size_t v;
+
+			flags = 0;
+			pad = ff / 5;
+			if (!pad) {
+				flags |= CTTK_B64ENC_NO_PAD;
+			}
+			switch (ff % 3) {
+			case 0:
+				line_len = 0;
+				crlf = 0;
+				break;
+			case 1:
+				line_len = 19;
+				crlf = 0;
+				flags |= CTTK_B64ENC_NEWLINE;
+				break;
+			case 2:
+				line_len = 16;
+				crlf = 0;
+				flags |= CTTK_B64ENC_NEWLINE;
+				flags |= CTTK_B64ENC_LINE64;
+				break;
+			case 3:
+				line_len = 19;
+				crlf = 1;
+				flags |= CTTK_B64ENC_NEWLINE;
+				flags |= CTTK_B64ENC_CRLF;
+				break;
+			case 4:
+				line_len = 16;
+				crlf = 1;
+				flags |= CTTK_B64ENC_NEWLINE;
+				flags |= CTTK_B64ENC_LINE64;
+				flags |= CTTK_B64ENC_CRLF;
+				break;
+			}
+
+			b64enc(tref, databin, u, pad, line_len, crlf);
+			len = cttk_bintob64_gen(NULL, 0, databin, u, flags);
+			check(len == strlen(tref), "b64enc (%zu, %d) 1", u, ff);
+			len = cttk_bintob64_gen(text, sizeof text,
+				databin, u, flags);
+			check(len == strlen(tref), "b64enc (%zu, %d) 2", u, ff);
+			check(len == strlen(text), "b64enc (%zu, %d) 3", u, ff);
+			check(!strcmp(text, tref), "b64enc (%zu, %d) 4", u, ff);
+			check(cttk_bintob64_gen(text, 0, databin,
+				u, flags) == 0, "b64enc (%zu, %d) 5", u, ff);
+
+			for (v = 0; v <= len; v ++) {
+				size_t len2;
+
+				len2 = cttk_bintob64_gen(text, v + 1,
+					databin, u, flags);
+				check(len2 == v,
+					"b64enc (%zu, %d, %zu) 6", u, ff, v);
+				check(len2 == strlen(text),
+					"b64enc (%zu, %d, %zu) 7", u, ff, v);
+				check(memcmp(text, tref, len2) == 0,
+					"b64enc (%zu, %d, %zu) 8", u, ff, v);
+			}
+		}
+
+		/*
+		 * Test decoder with added whitespace and non-whitespace.
+		 */
+		for (ff = 0; ff < 2; ff ++) {
+			size_t v;
+
+			b64enc(tref + 1, databin, u, ff, 0, 0);
+			len = strlen(tref + 1);
+			for (v = 0; v <= len; v ++) {
+				size_t len2, len3;
+				const char *err;
+
+				if (v == 0) {
+					tref[0] = ' ';
+				} else {
+					tref[v - 1] = tref[v];
+					tref[v] = ' ';
+				}
+				err = datab64;
+				len2 = cttk_b64tobin_gen(data, sizeof data,
+					tref, len + 1, &err,
+					ff ? 0 : CTTK_B64DEC_NO_PAD);
+				check(len2 == u,
+					"b64dec (%zu, %d, %zu) 1", u, ff, v);
+				check(err == NULL,
+					"b64dec (%zu, %d, %zu) 2", u, ff, v);
+				check(memcmp(data, databin, u) == 0,
+					"b64dec (%zu, %d, %zu) 3", u, ff, v);
+
+				err = datab64;
+				len2 = cttk_b64tobin_gen(data, sizeof data,
+					tref, len + 1, &err,
+					(ff ? 0 : CTTK_B64DEC_NO_PAD)
+					| CTTK_B64DEC_NO_WS);
+				check(err == tref + v,
+					"b64dec (%zu, %d, %zu) 4", u, ff, v);
+				len3 = (v * 3) / 4;
+				if (len3 > u) {
+					len3 = u;
+				}
+				check(len2 == len3,
+					"b64dec (%zu, %d, %zu) 5", u, ff, v);
+				check(memcmp(data, databin, len2) == 0,
+					"b64dec (%zu, %d, %zu) 6", u, ff, v);
+
+				tref[v] = '%';
+				err = datab64;
+				len2 = cttk_b64tobin_gen(data, sizeof data,
+					tref, len + 1, &err,
+					ff ? 0 : CTTK_B64DEC_NO_PAD);
+				check(err == tref + v,
+					"b64dec (%zu, %d, %zu) 7", u, ff, v);
+				len3 = (v * 3) / 4;
+				if (len3 > u) {
+					len3 = u;
+				}
+				check(len2 == len3,
+					"b64dec (%zu, %d, %zu) 8", u, ff, v);
+				check(memcmp(data, databin, len2) == 0,
+					"b64dec (%zu, %d, %zu) 9", u, ff, v);
+			}
+		}
+
+		/*
+		 * Test decoder with a truncated input.
+		 */
+		for (ff = 0; ff < 2; ff ++) {
+			size_t v;
+
+			b64enc(tref, databin, u, ff, 0, 0);
+			len = strlen(tref);
+			for (v = 0; v <= len; v ++) {
+				size_t len2, len3;
+				const char *err, *err2;
+
+				err = datab64;
+				len2 = cttk_b64tobin_gen(data, sizeof data,
+					tref, v, &err,
+					ff ? 0 : CTTK_B64DEC_NO_PAD);
+				len3 = (v * 3) / 4;
+				if (len3 > u) {
+					len3 = u;
+				}
+				check(len2 == len3,
+					"b64trunc1 (%zu, %d, %zu) 1", u, ff, v);
+				if (ff) {
+					if (v % 4 == 0) {
+						err2 = NULL;
+					} else {
+						err2 = tref + v;
+					}
+				} else {
+					int ok;
+
+					if (len3 == u) {
+						ok = 1;
+					} else if (v % 4 == 0) {
+						ok = 1;
+					} else if (v % 4 == 1) {
+						ok = 0;
+					} else if (v % 4 == 2) {
+						ok = !(databin[len3] & 0xF0);
+					} else {
+						ok = !(databin[len3] & 0xC0);
+					}
+					err2 = ok ? NULL : tref + v;
+				}
+				check(err == err2,
+					"b64trunc1 (%zu, %d, %zu) 2", u, ff, v);
+				check(memcmp(data, databin, u) == 0,
+					"b64trunc1 (%zu, %d, %zu) 3", u, ff, v);
+			}
+		}
+
+		/*
+		 * Test decoder with a truncated output.
+		 */
+		for (ff = 0; ff < 2; ff ++) {
+			size_t v;
+
+			b64enc(tref, databin, u, ff, 0, 0);
+			len = strlen(tref);
+			for (v = 0; v <= u; v ++) {
+				size_t len2;
+				const char *err, *err2;
+
+				err = datab64;
+				len2 = cttk_b64tobin_gen(data, v,
+					tref, len, &err,
+					ff ? 0 : CTTK_B64DEC_NO_PAD);
+				check(len2 == v,
+					"b64trunc2 (%zu, %d, %zu) 1", u, ff, v);
+				err2 = (v == u) ? NULL : tref + (4 * v + 2) / 3;
+				check(err == err2,
+					"b64trunc2 (%zu, %d, %zu) 2", u, ff, v);
+				check(memcmp(data, databin, v) == 0,
+					"b64trunc2 (%zu, %d, %zu) 3", u, ff, v);
+			}
+		}
+
+		if ((u & 7) == 0) {
+			printf(".");
+			fflush(stdout);
+		}
+	}
+
+	/*
+	 * Random data, encoded with all flag combinations and random
+	 * output lengths, and decoded at random offsets after adding
+	 * a random extra character; this exercises the bulk encoding
+	 * and decoding paths and their transitions to the generic code.
+	 */
+	for (u = 0; u < 3000; u ++) {
+		static const char extra[] = " \n\r\t=%-_.:@[`{\x80\xC3\xFF";
+		unsigned char data[900], data1[700], data2[700];
+		char text[1300], tref[1300];
+		const char *err1, *err2;
+		size_t len, tlen, olen, off, v1, v2;
+		int line_len, crlf;
+		unsigned flags, dflags;
+		cttk_b64enc_context ec;
+
+		len = rnd32() % 601;
+		rnd(data, len);
+		flags = rnd32() & 0x0F;
+		if (flags & CTTK_B64ENC_NEWLINE) {
+			line_len = (flags & CTTK_B64ENC_LINE64) ? 16 : 19;
+			crlf = (flags & CTTK_B64ENC_CRLF) != 0;
+		} else {
+			line_len = 0;
+			crlf = 0;
+		}
+		off = rnd32() & 31;
+		b64enc(tref + off, data, len,
+			!(flags & CTTK_B64ENC_NO_PAD), line_len, crlf);
+		tlen = strlen(tref + off);
+		olen = (u & 1) ? sizeof text - off : rnd32() % (tlen + 2);
+		v1 = cttk_bintob64_gen(text + off, olen, data, len, flags);
+		v2 = olen == 0 ? 0 : (tlen < olen ? tlen : olen - 1);
+		check(v1 == v2, "b64enc random 1");
+		check(memcmp(text + off, tref + off, v1) == 0,
+			"b64enc random 2");
+		check(olen == 0 || text[off + v1] == 0, "b64enc random 3");
+
+		if ((u & 3) != 0 && tlen > 0) {
+			tref[off + rnd32() % tlen] =
+				extra[rnd32() % (sizeof extra - 1)];
+		}
+		dflags = rnd32() & 3;
+		if ((flags & CTTK_B64ENC_NO_PAD) == 0) {
+			dflags &= ~(unsigned)CTTK_B64DEC_NO_PAD;
+		}
+		olen = (u & 2) ? sizeof data1 : rnd32() % (len + 2);
+		memset(data1, 0xA5, sizeof data1);
+		memset(data2, 0xA5, sizeof data2);
+		v1 = cttk_b64tobin_gen(data1, olen,
+			tref + off, tlen, &err1, dflags);
+		v2 = b64dec_ref(data2, olen, tref + off, tlen, &err2, dflags);
+		check(v1 == v2, "b64dec random 1");
+		check(err1 == err2, "b64dec random 2");
+		check(memcmp(data1, data2, sizeof data1) == 0,
+			"b64dec random 3");
+		v1 = cttk_b64tobin_gen(NULL, 0,
+			tref + off, tlen, &err1, dflags);
+		v2 = b64dec_ref(NULL, 0, tref + off, tlen, &err2, dflags);
+		check(v1 == v2, "b64dec random 4");
+		check(err1 == err2, "b64dec random 5");
+
+		/*
+		 * Streaming decoder.
+		 */
+		v1 = cttk_b64tobin_gen(data1, sizeof data1,
+			tref + off, tlen, &err1, dflags);
+		check_dec_stream(1, tref + off, tlen, dflags, data1, v1, err1);
+
+		/*
+		 * Streaming encoder, with random chunk lengths.
+		 */
+		b64enc(tref, data, len,
+			!(flags & CTTK_B64ENC_NO_PAD), line_len, crlf);
+		cttk_b64enc_init(&ec, flags);
+		for (v1 = 0, v2 = 0; v1 < len;) {
+			size_t clen, r;
+
+			clen = rnd32() % 50;
+			if (clen > len - v1) {
+				clen = len - v1;
+			}
+			r = cttk_b64enc_update(&ec, NULL, 0, data + v1, clen);
+			if (r > 0) {
+				check(cttk_b64enc_update(&ec, text + v2, r - 1,
+					data + v1, clen) == 0, "b64enc stream 1");
+			}
+			check(cttk_b64enc_update(&ec, text + v2, r,
+				data + v1, clen) == r, "b64enc stream 2");
+			v1 += clen;
+			v2 += r;
+		}
+		v1 = cttk_b64enc_final(&ec, NULL, 0);
+		check(cttk_b64enc_final(&ec, text + v2, v1) == v1,
+			"b64enc stream 3");
+		v2 += v1;
+		check(v2 == strlen(tref), "b64enc stream 4");
+		check(memcmp(text, tref, v2) == 0, "b64enc stream 5");
+
+		if ((u & 255) == 0) {
+			printf(".");
+			fflush(stdout);
+		}
+	}
+
+	printf(" done.\n");
+	fflush(stdout);
+}
+
+static void
+test_mul(void)
+{
+	int i, j, k;
+	uint32_t xu32, yu32;
+	int32_t xs32, ys32;
+	uint64_t xu64, yu64;
+	int64_t xs64, ys64;
+
+	printf("Test mul: ");
+	fflush(stdout);
+
+	for (i = 0; i < 32 * 64; i ++) {
+		k = i >> 5;
+		xu64 = (uint64_t)((i & 15) - 8);
+		if (i < 32 * 4) {
+			xu64 >>= k;
+		} else {
+			xu64 <<= k;
+			xu64 ^= (uint64_t)((i >> 4) & 1) << (i >> 6);
+		}
+		xs64 = *(int64_t *)&xu64;
+		xu32 = (uint32_t)xu64;
+		xs32 = *(int32_t *)&xu32;
+		for (j = 0; j < 32 * 64; j ++) {
+			uint32_t ru32;
+			int32_t rs32;
+			uint64_t ru32w, ru64;
+			int64_t rs32w, rs64;
+
+			k = j >> 5;
+			yu64 = (uint64_t)((j & 15) - 8);
+			if (j < 32 * 4) {
+				yu64 >>= k;
+			} else {
+				yu64 <<= k;
+				yu64 ^= (uint64_t)((j >> 4) & 1) << (j >> 6);
+			}
+			ys64 = *(int64_t *)&yu64;
+			yu32 = (uint32_t)yu64;
+			ys32 = *(int32_t *)&yu32;
+
+			ru32 = xu32 * yu32;
+			rs32 = *(int32_t *)&ru32;
+			ru32w = (uint64_t)xu32 * (uint64_t)yu32;
+			rs32w = (int64_t)xs32 * (int64_t)ys32;
+			ru64 = xu64 * yu64;
+			rs64 = xs64 * ys64;
+
+			check(cttk_mulu32(xu32, yu32) == ru32,
+				"mulu32: %lu, %lu\n",
+				(unsigned long)xu32,
+				(unsigned long)yu32);
+			check(cttk_muls32(xs32, ys32) == rs32,
+				"muls32: %llu, %llu\n",
+				(long)xs32,
+				(long)ys32);
+			check(cttk_mulu32w(xu32, yu32) == ru32w,
+				"mulu32w: %lu, %lu\n",
+				(unsigned long)xu32,
+				(unsigned long)yu32);
+			check(cttk_muls32w(xs32, ys32) == rs32w,
+				"muls32w: %lu, %lu\n",
+				(long)xs32,
+				(long)ys32);
+			check(cttk_mulu64(xu64, yu64) == ru64,
+				"mulu64: %llu, %llu\n",
+				(unsigned long long)xu64,
+				(unsigned long long)yu64);
+			check(cttk_muls64(xs64, ys64) == rs64,
+				"muls64: %llu, %llu\n",
+				(long long)xs64,
+				(long long)ys64);
+		}
+
+		if ((i & 31) == 0) {
+			printf(".");
+			fflush(stdout);
+		}
+	}
+
+	printf(" done.\n");
+	fflush(stdout);
+}
+
+static void
+test_bitlength(void)
+{
+	int i, j;
+
+	printf("Test bitlength: ");
+	fflush(stdout);
+
+	check(cttk_u32_bitlength(0) == 0, "bitlength 0");
+
+	for (i = 0; i <= 31; i ++) {
+		for (j = 0; j < 256; j ++) {
+			uint32_t x, y, bl;
+
+			x = (uint32_t)1 << i;
+			if (j < 64) {
+				y = (uint32_t)j;
+				if (y < x) {
+					x += y;
+				}
+			} else if (j < 128) {
+				if (i >= 6) {
+					y = (uint32_t)(j - 64);
+					x += y << (i - 6);
+				}
+			} else if (j < 192) {
+				y = (uint32_t)(j - 128);
+				if (y < x) {
+					x = (x << 1) - 1;
+					x -= y;
+				}
+			} else {
+				if (i >= 6) {
+					x = (x << 1) - 1;
+					y = (uint32_t)(j - 192);
+					x -= y << (i - 6);
+				}
+			}
+
+			bl = cttk_u32_bitlength(x);
+			check(bl == (uint32_t)(i + 1),
+				"bitlength: %08lX -> %u (%d,%d)",
+				(unsigned long)x, (unsigned)bl, i, j);
+		}
+	}
+
+	printf("done.\n");
+	fflush(stdout);
+}
+
+/*
+ * Custom rudimentary bigint implementation for test purposes.
+ * Each integer is an array of 16-bit words, in little-endian order.
+ * Maximum size is 512 bits.
+ */
+typedef struct {
+	uint16_t v[32];
+} zint;
+
+static void
+zint_zero(zint *z)
+{
+	memset(z->v, 0, sizeof z->v);
+}
+
+static void
+zint_set_u64(zint *z, uint64_t x)
+{
+	memset(z->v, 0, sizeof z->v);
+	z->v[0] = (uint16_t)x;
+	z->v[1] = (uint16_t)(x >> 16);
+	z->v[2] = (uint16_t)(x >> 32);
+	z->v[3] = (uint16_t)(x >> 48);
+}
+
+/* unused
+static void
+zint_set_s64(zint *z, int64_t x)
+{
+	zint_set_u64(z, (uint64_t)x);
+	if (x < 0) {
+		memset(z->v + 4, 0xFF, (sizeof z->v) - 4 * sizeof(uint16_t));
+	}
+}
+*/
+
+static unsigned
+zint_bitlength(const zint *z)
+{
+	unsigned w;
+	int i;
+
+	if (z->v[31] >= 0x8000) {
+		w = 0xFFFF;
+	} else {
+		w = 0x0000;
+	}
+	for (i = 31; i >= 0; i --) {
+		if (z->v[i] != w) {
+			int j;
+			unsigned x;
+
+			x = z->v[i] ^ w;
+			for (j = 15; j >= 0; j --) {
+				if ((x >> j) != 0) {
+					return (i << 4) + j + 1;
+				}
+			}
+		}
+	}
+	return 0;
+}
+
+static uint64_t
+zint_get_u64(const zint *z)
+{
+	return (uint64_t)z->v[0]
+		| ((uint64_t)z->v[1] << 16)
+		| ((uint64_t)z->v[2] << 32)
+		| ((uint64_t)z->v[3] << 48);
+}
+
+static int64_t
+zint_get_s64(const zint *z)
+{
+	uint64_t x;
+
+	x = zint_get_u64(z);
+	return *(int64_t *)&x;
+}
+
+static void
+zint_trunc(zint *z, unsigned bl)
+{
+	unsigned k;
+	uint16_t w;
+
+	if (bl >= 512) {
+		return;
+	}
+	if (bl == 0) {
+		memset(z->v, 0, sizeof z->v);
+		return;
+	}
+	bl --;
+	k = bl >> 4;
+	bl &= 15;
+	w = z->v[k];
+	if (((w >> bl) & 1) != 0) {
+		z->v[k] |= (0xFFFF << bl) & 0xFFFF;
+		for (k ++; k < 32; k ++) {
+			z->v[k] = 0xFFFF;
+		}
+	} else {
+		z->v[k] &= ~(0xFFFF << bl);
+		for (k ++; k < 32; k ++) {
+			z->v[k] = 0x0000;
+		}
+	}
+}
+
+static void
+zint_copy(zint *d, const zint *s)
+{
+	memmove(d->v, s->v, sizeof s->v);
+}
+
+static void
+zint_add(zint *d, const zint *a, const zint *b)
+{
+	int i;
+	uint32_t cc;
+
+	cc = 0;
+	for (i = 0; i < 32; i ++) {
+		uint32_t wa, wb, wd;
+
+		wa = a->v[i];
+		wb = b->v[i];
+		wd = wa + wb + cc;
+		cc = wd >> 16;
+		d->v[i] = wd & 0xFFFF;
+	}
+}
+
+static void
+zint_sub(zint *d, const zint *a, const zint *b)
+{
+	int i;
+	uint32_t cc;
+
+	cc = 0;
+	for (i = 0; i < 32; i ++) {
+		uint32_t wa, wb, wd;
+
+		wa = a->v[i];
+		wb = b->v[i];
+		wd = wa - wb - cc;
+		cc = (wd >> 16) & 1;
+		d->v[i] = wd & 0xFFFF;
+	}
+}
+
+static int
+zint_cmp(const zint *a, const zint *b)
+{
+	zint d;
+	int i;
+
+	zint_sub(&d, a, b);
+	if (d.v[31] >= 0x8000) {
+		return -1;
+	}
+	for (i = 0; i < 32; i ++) {
+		if (d.v[i] != 0) {
+			return 1;
+		}
+	}
+	return 0;
+}
+
+static int
+zint_sign(const zint *a)
+{
+	int i;
+
+	if (a->v[31] >= 0x8000) {
+		return -1;
+	}
+	for (i = 0; i < 32; i ++) {
+		if (a->v[i] != 0) {
+			return 1;
+		}
+	}
+	return 0;
+}
+
+static void
+zint_decode(zint *z, const void *src, size_t len, int be, int sig)
+{
+	const unsigned char *buf;
+	size_t u;
+	unsigned bx;
+
+	zint_zero(z);
+	if (len == 0) {
+		return;
+	}
+	buf = src;
+	if (sig) {
+		if (be) {
+			bx = buf[0] >= 0x80 ? 0xFF : 0x00;
+		} else {
+			bx = buf[len - 1] >= 0x80 ? 0xFF : 0x00;
+		}
+	} else {
+		bx = 0x00;
+	}
+	for (u = 0; u < 64; u ++) {
+		unsigned b;
+
+		if (u < len) {
+			b = be ? buf[len - 1 - u] : buf[u];
+		} else {
+			b = bx;
+		}
+		if ((u & 1) != 0) {
+			b <<= 8;
+		}
+		z->v[u >> 1] |= b;
+	}
+}
+
+static void
+zint_encode(void *dst, size_t len, const zint *z, int be)
+{
+	unsigned char *buf;
+	size_t u;
+	unsigned ssx;
+
+	buf = dst;
+	ssx = (z->v[31] >= 0x8000) ? 0xFF : 0x00;
+	for (u = 0; u < len; u ++) {
+		unsigned b;
+
+		if (u < 64) {
+			b = z->v[u >> 1];
+			if ((u & 1) != 0) {
+				b >>= 8;
+			}
+		} else {
+			b = ssx;
+		}
+		if (be) {
+			buf[len - 1 - u] = b;
+		} else {
+			buf[u] = b;
+		}
+	}
+}
+
+static void
+zint_mul(zint *d, zint *a, zint *b)
+{
+	zint x, t;
+	int i, j;
+
+	zint_zero(&t);
+	for (i = 0; i < 32; i ++) {
+		uint32_t wb, cc;
+
+		wb = b->v[i];
+		memset(x.v, 0, i * sizeof(uint16_t));
+		cc = 0;
+		for (j = i; j < 32; j ++) {
+			uint32_t wa, wx;
+
+			wa = a->v[j - i];
+			wx = wa * wb + cc;
+			cc = wx >> 16;
+			x.v[j] = (uint16_t)wx;
+		}
+		zint_add(&t, &t, &x);
+	}
+	zint_copy(d, &t);
+}
+
+static void
+zint_lsh(zint *d, zint *a, unsigned n)
+{
+	zint t;
+	int i, nd, nm;
+
+	nd = (int)(n >> 4);
+	nm = (int)(n & 15);
+	for (i = 0; i < 32; i ++) {
+		if (i < nd) {
+			t.v[i] = 0;
+		} else if (i == nd) {
+			t.v[i] = (uint16_t)((uint32_t)a->v[0] << nm);
+		} else {
+			t.v[i] = (uint16_t)(((uint32_t)a->v[i - nd] << nm)
+				| ((uint32_t)a->v[i - nd - 1] >> (16 - nm)));
+		}
+	}
+	zint_copy(d, &t);
+}
+
+static void
+zint_rsh(zint *d, zint *a, unsigned n)
+{
+	int i, nd, nm;
+	uint32_t ssa;
+
+	nd = (int)(n >> 4);
+	nm = (int)(n & 15);
+	ssa = (a->v[31] >= 0x8000) ? 0xFFFF : 0x0000;
+	for (i = 0; i < 32; i ++) {
+		if (i + nd < 31) {
+			d->v[i] = (uint16_t)(((uint32_t)a->v[i + nd] >> nm)
+				| ((uint32_t)a->v[i + nd + 1] << (16 - nm)));
+		} else if (i + nd == 31) {
+			d->v[i] = (uint16_t)(((uint32_t)a->v[31] >> nm)
+				| (ssa << (16 - nm)));
+		} else {
+			d->v[i] = ssa;
+		}
+	}
+}
+
+static void
+zint_and(zint *d, const zint *a, const zint *b)
+{
+	int i;
+
+	for (i = 0; i < 32; i ++) {
+		d->v[i] = a->v[i] & b->v[i];
+	}
+}
+
+static void
+zint_or(zint *d, const zint *a, const zint *b)
+{
+	int i;
+
+	for (i = 0; i < 32; i ++) {
+		d->v[i] = a->v[i] | b->v[i];
+	}
+}
+
+static void
+zint_xor(zint *d, const zint *a, const zint *b)
+{
+	int i;
+
+	for (i = 0; i < 32; i ++) {
+		d->v[i] = a->v[i] ^ b->v[i];
+	}
+}
+
+static void
+zint_eqv(zint *d, const zint *a, const zint *b)
+{
+	int i;
+
+	for (i = 0; i < 32; i ++) {
+		d->v[i] = ~(a->v[i] ^ b->v[i]);
+	}
+}
+
+static void
+zint_not(zint *d, const zint *a)
+{
+	int i;
+
+	for (i = 0; i < 32; i ++) {
+		d->v[i] = ~a->v[i];
+	}
+}
+
+static void
+test_i31_set(void)
+{
+	cttk_i31_def(x, 500);
+	int i, j;
+	zint z;
+
+	printf("Test i31 set: ");
+	fflush(stdout);
+
+	rnd_init(1);
+
+	for (i = 1; i <= 128; i ++) {
+		cttk_i31_init(x, i);
+
+		for (j = 0; j < 64; j ++) {
+			uint64_t tu64;
+			uint32_t tu32;
+
+			tu64 = (uint64_t)1 << j;
+			cttk_i31_set_u64(x, tu64);
+			if (j < (i - 1)) {
+				check(cttk_i31_to_u64(x) == tu64,
+					"set_u64 1 (%d,%d)", i, j);
+			} else {
+				check(cttk_i31_to_u64(x) == 0,
+					"set_u64 2 (%d,%d)", i, j);
+			}
+			tu64 = (tu64 << 1) - 1;
+			cttk_i31_set_u64(x, tu64);
+			if (j < (i - 1)) {
+				check(cttk_i31_to_u64(x) == tu64,
+					"set_u64 3 (%d,%d)", i, j);
+			} else {
+				check(cttk_i31_to_u64(x) == 0,
+					"set_u64 4 (%d,%d)", i, j);
+			}
+			cttk_i31_set_u64_trunc(x, tu64);
+			if (j < (i - 1)) {
+				check(cttk_i31_to_u64_trunc(x) == tu64,
+					"set_u64 5 (%d,%d)", i, j);
+			} else {
+				check(cttk_i31_to_u64_trunc(x) == (uint64_t)-1,
+					"set_u64 6 (%d,%d)", i, j);
+			}
+
+			if (j >= 32) {
+				continue;
+			}
+
+			tu32 = (uint32_t)1 << j;
+			cttk_i31_set_u32(x, tu32);
+			if (j < (i - 1)) {
+				check(cttk_i31_to_u32(x) == tu32,
+					"set_u32 1 (%d,%d)", i, j);
+			} else {
+				check(cttk_i31_to_u32(x) == 0,
+					"set_u32 2 (%d,%d)", i, j);
+			}
+			tu32 = (tu32 << 1) - 1;
+			cttk_i31_set_u32(x, tu32);
+			if (j < (i - 1)) {
+				check(cttk_i31_to_u32(x) == tu32,
+					"set_u32 3 (%d,%d)", i, j);
+			} else {
+				check(cttk_i31_to_u32(x) == 0,
+					"set_u32 4 (%d,%d)", i, j);
+			}
+			cttk_i31_set_u32_trunc(x, tu32);
+			if (j < (i - 1)) {
+				check(cttk_i31_to_u32_trunc(x) == tu32,
+					"set_u32 5 (%d,%d)", i, j);
+			} else {
+				check(cttk_i31_to_u32_trunc(x) == (uint32_t)-1,
+					"set_u32 6 (%d,%d)", i, j);
+			}
+		}
+
+		for (j = 0; j < 100; j ++) {
+			uint64_t tu64;
+			uint32_t tu32;
+			int64_t ts64;
+			int32_t ts32;
+
+			tu64 = rnd64();
+			ts64 = *(int64_t *)&tu64;
+			tu32 = rnd32();
+			ts32 = *(int32_t *)&tu32;
+
+			cttk_i31_set_u64_trunc(x, tu64);
+			zint_set_u64(&z, tu64);
+			zint_trunc(&z, i);
+			if (i <= 64 && zint_get_s64(&z) < 0) {
+				check(cttk_i31_to_u64(x) == 0,
+					"to_u64 1 (%d,%d)", i, j);
+			} else {
+				check(cttk_i31_to_u64(x) == zint_get_u64(&z),
+					"to_u64 2 (%d,%d)", i, j);
+			}
+			if (i >= 65 && tu64 >= ((uint64_t)1 << 63)) {
+				check(cttk_i31_to_s64(x) == 0,
+					"to_s64 1 (%d,%d)", i, j);
+				check(cttk_i31_to_s64_trunc(x) == ts64,
+					"to_s64_trunc 1 (%d,%d)", i, j);
+				check(cttk_i31_to_u64_trunc(x) == tu64,
+					"to_u64_trunc 1 (%d,%d)", i, j);
+			} else {
+				check(cttk_i31_to_s64(x) == zint_get_s64(&z),
+					"to_s64 2 (%d,%d)", i, j);
+				check(cttk_i31_to_s64_trunc(x)
+					== zint_get_s64(&z),
+					"to_s64_trunc 2 (%d,%d)", i, j);
+				check(cttk_i31_to_u64_trunc(x)
+					== zint_get_u64(&z),
+					"to_u64_trunc 2 (%d,%d)", i, j);
+			}
+
+			cttk_i31_set_u32_trunc(x, tu32);
+			zint_set_u64(&z, tu32);
+			zint_trunc(&z, i);
+			if (zint_get_s64(&z) < 0) {
+				check(cttk_i31_to_u32(x) == 0,
+					"to_u32 1 (%d,%d)", i, j);
+			} else {
+				check(cttk_i31_to_u32(x) == zint_get_u64(&z),
+					"to_u32 2 (%d,%d)", i, j);
+			}
+			if (i >= 33 && tu32 >= ((uint32_t)1 << 31)) {
+				check(cttk_i31_to_s32(x) == 0,
+					"to_s32 1 (%d,%d)", i, j);
+				check(cttk_i31_to_s32_trunc(x) == ts32,
+					"to_s32_trunc 1 (%d,%d)", i, j);
+				check(cttk_i31_to_u32_trunc(x) == tu32,
+					"to_u32_trunc 1 (%d,%d)", i, j);
+			} else {
+				check(cttk_i31_to_s32(x) == zint_get_s64(&z),
+					"to_s32 2 (%d,%d)", i, j);
+				check(cttk_i31_to_s32_trunc(x)
+					== zint_get_s64(&z),
+					"to_s32_trunc 2 (%d,%d)", i, j);
+				check(cttk_i31_to_u32_trunc(x)
+					== (uint32_t)zint_get_u64(&z),
+					"to_u32_trunc 2 (%d,%d)", i, j);
+			}
+		}
+
+		if ((i & 7) == 0) {
+			printf(".");
+			fflush(stdout);
+		}
+	}
+
+	printf(" ");
+	fflush(stdout);
+
+	for (i = 1; i <= 80; i ++) {
+		for (j = 1; j <= 80; j ++) {
+			int k;
+
+			for (k = 0; k < 10; k ++) {
+				unsigned char tmp[17], tmp2[17];
+				cttk_i31_def(x, 100);
+				cttk_i31_def(y, 100);
+
+				cttk_i31_init(x, i);
+				cttk_i31_init(y, j);
+				rnd(tmp, 17);
+				zint_decode(&z, tmp, 17, 0, 0);
+				zint_trunc(&z, i);
+				zint_encode(tmp, 17, &z, 0);
+				cttk_i31_decle_signed(x, tmp, 17);
+
+				cttk_i31_set(y, x);
+				if (zint_bitlength(&z) >= (unsigned)j) {
+					check(cttk_i31_isnan(y).v,
+						"set 1 (%d,%d,%d)", i, j, k);
+				} else {
+					check(!cttk_i31_isnan(y).v,
+						"set 2 (%d,%d,%d)", i, j, k);
+					cttk_i31_encle(tmp2, 17, y);
+					check(memcmp(tmp, tmp2, 17) == 0,
+						"set 3 (%d,%d,%d)", i, j, k);
+				}
+
+				cttk_i31_set_trunc(y, x);
+				cttk_i31_encle(tmp2, 17, y);
+				zint_trunc(&z, j);
+				zint_encode(tmp, 17, &z, 0);
+				check(!cttk_i31_isnan(y).v,
+					"set 4 (%d,%d,%d)", i, j, k);
+				check(memcmp(tmp, tmp2, 17) == 0,
+					"set 5 (%d,%d,%d)", i, j, k);
+			}
+		}
+
+		if ((i & 3) == 0) {
+			printf(".");
+			fflush(stdout);
+		}
+	}
+
+	printf(" done.\n");
+	fflush(stdout);
+}
+
+static int
+memiszero(const void *data, size_t len)
+{
+	unsigned x;
+	const unsigned char *buf;
+
+	buf = data;
+	x = 0;
+	while (len -- > 0) {
+		x |= *buf ++;
+	}
+	return x == 0;
+}
+
+static void
+test_i31_codec(void)
+{
+	cttk_i31_def(x, 300);
+	zint z;
+	int i, j, be;
+	unsigned char tmp1[100], tmp2[100];
+
+	printf("Test i31 codec: ");
+	fflush(stdout);
+
+	rnd_init(3);
+
+	for (be = 0; be < 2; be ++) {
+		for (i = 1; i <= 128; i ++) {
+			cttk_i31_init(x, i);
+
+			for (j = 0; j < 100; j ++) {
+				rnd(tmp1, 17);
+				zint_decode(&z, tmp1, 17, be, 0);
+				zint_trunc(&z, i + 2);
+				zint_encode(tmp1, 17, &z, be);
+
+				if (be) {
+					cttk_i31_decbe_signed(x, tmp1, 17);
+					cttk_i31_encbe(tmp2, 17, x);
+				} else {
+					cttk_i31_decle_signed(x, tmp1, 17);
+					cttk_i31_encle(tmp2, 17, x);
+				}
+				if (zint_bitlength(&z) < (unsigned)i) {
+					check(memcmp(tmp2, tmp1, 17) == 0,
+						"codec 1 (%d,%d,%d)", be, i, j);
+				} else {
+					check(cttk_bool_to_int(
+						cttk_i31_isnan(x)),
+						"codec 2 (%d,%d,%d)", be, i, j);
+					check(memiszero(tmp2, 17),
+						"codec 3 (%d,%d,%d)", be, i, j);
+				}
+				if (be) {
+					cttk_i31_decbe_unsigned(x, tmp1, 17);
+					cttk_i31_encbe(tmp2, 17, x);
+				} else {
+					cttk_i31_decle_unsigned(x, tmp1, 17);
+					cttk_i31_encle(tmp2, 17, x);
+				}
+				if (zint_bitlength(&z) < (unsigned)i
+					&& z.v[31] < 0x8000)
+				{
+					check(memcmp(tmp2, tmp1, 17) == 0,
+						"codec 4 (%d,%d,%d)", be, i, j);
+				} else {
+					check(cttk_bool_to_int(
+						cttk_i31_isnan(x)),
+						"codec 5 (%d,%d,%d)", be, i, j);
+					check(memiszero(tmp2, 17),
+						"codec 6 (%d,%d,%d)", be, i, j);
+				}
+
+				rnd(tmp1, 17);
+				if (be) {
+					cttk_i31_decbe_signed_trunc(
+						x, tmp1, 17);
+					cttk_i31_encbe(tmp2, 17, x);
+				} else {
+					cttk_i31_decle_signed_trunc(
+						x, tmp1, 17);
+					cttk_i31_encle(tmp2, 17, x);
+				}
+				zint_decode(&z, tmp1, 17, be, 0);
+				zint_trunc(&z, i);
+				zint_encode(tmp1, 17, &z, be);
+				check(memcmp(tmp1, tmp2, 17) == 0,
+					"codec 7 (%d,%d,%d)", be, i, j);
+
+				rnd(tmp1, 8);
+				if (be) {
+					cttk_i31_decbe_unsigned_trunc(
+						x, tmp1, 8);
+					cttk_i31_encbe(tmp2, 17, x);
+				} else {
+					cttk_i31_decle_unsigned_trunc(
+						x, tmp1, 8);
+					cttk_i31_encle(tmp2, 17, x);
+				}
+				zint_decode(&z, tmp1, 8, be, 0);
+				zint_trunc(&z, i);
+				zint_encode(tmp1, 17, &z, be);
+				check(memcmp(tmp1, tmp2, 17) == 0,
+					"codec 8 (%d,%d,%d)", be, i, j);
+			}
+
+			if ((i & 7) == 0) {
+				printf(".");
+				fflush(stdout);
+			}
+		}
+	}
+
+	printf(" done.\n");
+	fflush(stdout);
+}
+
+static void
+test_i31_cmp(void)
+{
+	cttk_i31_def(x1, 300);
+	cttk_i31_def(x2, 300);
+	zint z1, z2;
+	int i, j;
+	unsigned char tmp1[100], tmp2[100];
+
+	printf("Test i31 codec: ");
+	fflush(stdout);
+
+	rnd_init(4);
+
+	for (i = 1; i <= 128; i ++) {
+		cttk_i31_init(x1, i);
+		cttk_i31_init(x2, i);
+
+		check(!cttk_bool_to_int(cttk_i31_eq0(x1)),
+			"cmp nan1 1 (%d)", i);
+		check(!cttk_bool_to_int(cttk_i31_neq0(x1)),
+			"cmp nan1 2 (%d)", i);
+		check(!cttk_bool_to_int(cttk_i31_lt0(x1)),
+			"cmp nan1 3 (%d)", i);
+		check(!cttk_bool_to_int(cttk_i31_leq0(x1)),
+			"cmp nan1 4 (%d)", i);
+		check(!cttk_bool_to_int(cttk_i31_gt0(x1)),
+			"cmp nan1 5 (%d)", i);
+		check(!cttk_bool_to_int(cttk_i31_geq0(x1)),
+			"cmp nan1 6 (%d)", i);
+		check(!cttk_bool_to_int(cttk_i31_eq(x1, x2)),
+			"cmp nan1 7 (%d)", i);
+		check(!cttk_bool_to_int(cttk_i31_neq(x1, x2)),
+			"cmp nan1 8 (%d)", i);
+		check(!cttk_bool_to_int(cttk_i31_lt(x1, x2)),
+			"cmp nan1 9 (%d)", i);
+		check(!cttk_bool_to_int(cttk_i31_leq(x1, x2)),
+			"cmp nan1 10 (%d)", i);
+		check(!cttk_bool_to_int(cttk_i31_gt(x1, x2)),
+			"cmp nan1 11 (%d)", i);
+		check(!cttk_bool_to_int(cttk_i31_geq(x1, x2)),
+			"cmp nan1 12 (%d)", i);
+
+		cttk_i31_set_s32(x1, 0);
+		check(cttk_bool_to_int(cttk_i31_eq0(x1)),
+			"cmp eq0 1 (%d)", i);
+		check(!cttk_bool_to_int(cttk_i31_neq0(x1)),
+			"cmp neq0 2 (%d)", i);
+		check(!cttk_bool_to_int(cttk_i31_lt0(x1)),
+			"cmp lt0 3 (%d)", i);
+		check(cttk_bool_to_int(cttk_i31_leq0(x1)),
+			"cmp leq0 4 (%d)", i);
+		check(!cttk_bool_to_int(cttk_i31_gt0(x1)),
+			"cmp gt0 5 (%d)", i);
+		check(cttk_bool_to_int(cttk_i31_geq0(x1)),
+			"cmp geq0 6 (%d)", i);
+		check(!cttk_bool_to_int(cttk_i31_eq(x1, x2)),
+			"cmp nan2 1 (%d)", i);
+		check(!cttk_bool_to_int(cttk_i31_neq(x1, x2)),
+			"cmp nan2 2 (%d)", i);
+		check(!cttk_bool_to_int(cttk_i31_lt(x1, x2)),
+			"cmp nan2 3 (%d)", i);
+		check(!cttk_bool_to_int(cttk_i31_leq(x1, x2)),
+			"cmp nan2 4 (%d)", i);
+		check(!cttk_bool_to_int(cttk_i31_gt(x1, x2)),
+			"cmp nan2 5 (%d)", i);
+		check(!cttk_bool_to_int(cttk_i31_geq(x1, x2)),
+			"cmp nan2 6 (%d)", i);
+		check(!cttk_bool_to_int(cttk_i31_eq(x2, x1)),
+			"cmp nan2 7 (%d)", i);
+		check(!cttk_bool_to_int(cttk_i31_neq(x2, x1)),
+			"cmp nan2 8 (%d)", i);
+		check(!cttk_bool_to_int(cttk_i31_lt(x2, x1)),
+			"cmp nan2 9 (%d)", i);
+		check(!cttk_bool_to_int(cttk_i31_leq(x2, x1)),
+			"cmp nan2 10 (%d)", i);
+		check(!cttk_bool_to_int(cttk_i31_gt(x2, x1)),
+			"cmp nan2 11 (%d)", i);
+		check(!cttk_bool_to_int(cttk_i31_geq(x2, x1)),
+			"cmp nan2 12 (%d)", i);
+
+		for (j = 0; j < 100; j ++) {
+			int cc;
+
+			rnd(tmp1, 17);
+			rnd(tmp2, 17);
+			zint_decode(&z1, tmp1, 17, 0, 0);
+			zint_decode(&z2, tmp2, 17, 0, 0);
+			zint_trunc(&z1, i);
+			zint_trunc(&z2, i);
+			zint_encode(tmp1, 17, &z1, 0);
+			zint_encode(tmp2, 17, &z2, 0);
+			cttk_i31_decle_signed(x1, tmp1, 17);
+			cttk_i31_decle_signed(x2, tmp2, 17);
+
+			cc = zint_cmp(&z1, &z2);
+			check(cttk_i31_cmp(x1, x2) == cc,
+				"cmp 1 (%d,%d)", i, j);
+			check(cttk_bool_to_int(cttk_i31_lt(x1, x2))
+				== (cc < 0), "cmp 2 (%d,%d)", i, j);
+			check(cttk_bool_to_int(cttk_i31_leq(x1, x2))
+				== (cc <= 0), "cmp 3 (%d,%d)", i, j);
+			check(cttk_bool_to_int(cttk_i31_gt(x1, x2))
+				== (cc > 0), "cmp 4 (%d,%d)", i, j);
+			check(cttk_bool_to_int(cttk_i31_geq(x1, x2))
+				== (cc >= 0), "cmp 5 (%d,%d)", i, j);
+			check(cttk_bool_to_int(cttk_i31_eq(x1, x1)),
+				"cmp 6 (%d,%d)", i, j);
+			check(cttk_bool_to_int(cttk_i31_geq(x1, x1)),
+				"cmp 7 (%d,%d)", i, j);
+			check(cttk_bool_to_int(cttk_i31_leq(x1, x1)),
+				"cmp 8 (%d,%d)", i, j);
+			check(!cttk_bool_to_int(cttk_i31_neq(x1, x1)),
+				"cmp 9 (%d,%d)", i, j);
+			check(!cttk_bool_to_int(cttk_i31_gt(x1, x1)),
+				"cmp 10 (%d,%d)", i, j);
+			check(!cttk_bool_to_int(cttk_i31_lt(x1, x1)),
+				"cmp 11 (%d,%d)", i, j);
+
+			cc = zint_sign(&z1);
+			check(cttk_bool_to_int(cttk_i31_lt0(x1)) == (cc < 0),
+				"cmp 12 (%d,%d)", i, j);
+			check(cttk_bool_to_int(cttk_i31_leq0(x1)) == (cc <= 0),
+				"cmp 13 (%d,%d)", i, j);
+			check(cttk_bool_to_int(cttk_i31_gt0(x1)) == (cc > 0),
+				"cmp 14 (%d,%d)", i, j);
+			check(cttk_bool_to_int(cttk_i31_geq0(x1)) == (cc >= 0),
+				"cmp 15 (%d,%d)", i, j);
+		}
+
+		if ((i & 3) == 0) {
+			printf(".");
+			fflush(stdout);
+		}
+	}
+
+	printf(" done.\n");
+	fflush(stdout);
+}
+
+static void
+test_i31_addsub(void)
+{
+	cttk_i31_def(x1, 300);
+	cttk_i31_def(x2, 300);
+	cttk_i31_def(x3, 300);
+	zint z1, z2, z3;
+	int i, j;
+	unsigned char tmp1[100], tmp2[100], tmp3[100], tmp4[100];
+
+	printf("Test i31 add/sub: ");
+	fflush(stdout);
+
+	rnd_init(5);
+
+	for (i = 1; i <= 128; i ++) {
+		cttk_i31_init(x1, i);
+		cttk_i31_init(x2, i);
+		cttk_i31_init(x3, i);
+
+		for (j = 0; j < 100; j ++) {
+			rnd(tmp1, 17);
+			rnd(tmp2, 17);
+			zint_decode(&z1, tmp1, 17, 0, 0);
+			zint_decode(&z2, tmp2, 17, 0, 0);
+			zint_trunc(&z1, i);
+			zint_trunc(&z2, i);
+			zint_encode(tmp1, 17, &z1, 0);
+			zint_encode(tmp2, 17, &z2, 0);
+			cttk_i31_decle_signed(x1, tmp1, 17);
+			cttk_i31_decle_signed(x2, tmp2, 17);
+
+			zint_add(&z3, &z1, &z2);
+			zint_encode(tmp3, 17, &z3, 0);
+			cttk_i31_add(x3, x1, x2);
+			if (zint_bitlength(&z3) >= (uint32_t)i) {
+				check(cttk_bool_to_int(cttk_i31_isnan(x3)),
+					"add 1 (%d,%d)", i, j);
+			} else {
+				cttk_i31_encle(tmp4, 17, x3);
+				check(memcmp(tmp3, tmp4, 17) == 0,
+					"add 2 (%d,%d)", i, j);
+			}
+			zint_trunc(&z3, i);
+			zint_encode(tmp3, 17, &z3, 0);
+			cttk_i31_add_trunc(x3, x1, x2);
+			cttk_i31_encle(tmp4, 17, x3);
+			check(memcmp(tmp3, tmp4, 17) == 0,
+				"add 3 (%d,%d)", i, j);
+
+			zint_sub(&z3, &z1, &z2);
+			zint_encode(tmp3, 17, &z3, 0);
+			cttk_i31_sub(x3, x1, x2);
+			if (zint_bitlength(&z3) >= (uint32_t)i) {
+				check(cttk_bool_to_int(cttk_i31_isnan(x3)),
+					"sub 1 (%d,%d)", i, j);
+			} else {
+				cttk_i31_encle(tmp4, 17, x3);
+				check(memcmp(tmp3, tmp4, 17) == 0,
+					"sub 2 (%d,%d)", i, j);
+			}
+			zint_trunc(&z3, i);
+			zint_encode(tmp3, 17, &z3, 0);
+			cttk_i31_sub_trunc(x3, x1, x2);
+			cttk_i31_encle(tmp4, 17, x3);
+			check(memcmp(tmp3, tmp4, 17) == 0,
+				"sub 3 (%d,%d)", i, j);
+
+			zint_zero(&z1);
+			zint_sub(&z3, &z1, &z2);
+			zint_encode(tmp3, 17, &z3, 0);
+			cttk_i31_neg(x3, x2);
+			if (zint_bitlength(&z3) >= (uint32_t)i) {
+				check(cttk_bool_to_int(cttk_i31_isnan(x3)),
+					"neg 1 (%d,%d)", i, j);
+			} else {
+				cttk_i31_encle(tmp4, 17, x3);
+				check(memcmp(tmp3, tmp4, 17) == 0,
+					"neg 2 (%d,%d)", i, j);
+			}
+			zint_trunc(&z3, i);
+			zint_encode(tmp3, 17, &z3, 0);
+			cttk_i31_neg_trunc(x3, x2);
+			cttk_i31_encle(tmp4, 17, x3);
+			check(memcmp(tmp3, tmp4, 17) == 0,
+				"neg 3 (%d,%d)", i, j);
+		}
+
+		memset(tmp1, 0, 17);
+		tmp1[(i - 1) >> 3] |= 1 << ((i - 1) & 7);
+		cttk_i31_decle_unsigned_trunc(x1, tmp1, 17);
+		check(cttk_bool_to_int(cttk_i31_lt0(x1)),
+			"negmin 1 (%d)", i);
+		cttk_i31_neg(x3, x1);
+		check(cttk_bool_to_int(cttk_i31_isnan(x3)),
+			"negmin 2 (%d)", i);
+		cttk_i31_neg_trunc(x3, x1);
+		check(!cttk_bool_to_int(cttk_i31_isnan(x3)),
+			"negmin 3 (%d)", i);
+		check(cttk_bool_to_int(cttk_i31_eq(x1, x3)),
+			"negmin 4 (%d)", i);
+
+		if ((i & 3) == 0) {
+			printf(".");
+			fflush(stdout);
+		}
+	}
+
+	printf(" done.\n");
+	fflush(stdout);
+}
+
+static void
+test_i31_mul(void)
+{
+	cttk_i31_def(x1, 300);
+	cttk_i31_def(x2, 300);
+	cttk_i31_def(x3, 300);
+	zint z1, z2, z3;
+	int i, j;
+	unsigned char tmp1[100], tmp2[100], tmp3[100], tmp4[100];
+
+	printf("Test i31 mul: ");
+	fflush(stdout);
+
+	rnd_init(6);
+
+	cttk_i31_init(x1, 1);
+	cttk_i31_init(x2, 1);
+	cttk_i31_init(x3, 1);
+	cttk_i31_set_s32(x1, 0);
+	cttk_i31_set_s32(x2, -1);
+	cttk_i31_mul(x3, x1, x2);
+	check(!cttk_bool_to_int(cttk_i31_isnan(x3)), "mul0-1");
+	check(cttk_i31_to_s32(x3) == 0, "mul0-2");
+	cttk_i31_mul(x3, x2, x1);
+	check(!cttk_bool_to_int(cttk_i31_isnan(x3)), "mul0-3");
+	check(cttk_i31_to_s32(x3) == 0, "mul0-4");
+
+	for (i = 1; i <= 128; i ++) {
+		cttk_i31_init(x1, i);
+		cttk_i31_init(x2, i);
+		cttk_i31_init(x3, i);
+
+		for (j = 0; j < 1000; j ++) {
+			rnd(tmp1, 17);
+			rnd(tmp2, 17);
+			zint_decode(&z1, tmp1, 17, 0, 0);
+			zint_decode(&z2, tmp2, 17, 0, 0);
+			zint_trunc(&z1, i);
+			zint_trunc(&z2, i);
+			zint_encode(tmp1, 17, &z1, 0);
+			zint_encode(tmp2, 17, &z2, 0);
+			cttk_i31_decle_signed(x1, tmp1, 17);
+			cttk_i31_decle_signed(x2, tmp2, 17);
+
+			zint_mul(&z3, &z1, &z2);
+			zint_encode(tmp3, 17, &z3, 0);
+			cttk_i31_mul(x3, x1, x2);
+			if (zint_bitlength(&z3) >= (uint32_t)i) {
+				check(cttk_bool_to_int(cttk_i31_isnan(x3)),
+					"mul 1 (%d,%d)", i, j);
+			} else {
+				check(!cttk_bool_to_int(cttk_i31_isnan(x3)),
+					"mul 2 (%d,%d)", i, j);
+				cttk_i31_encle(tmp4, 17, x3);
+				check(memcmp(tmp3, tmp4, 17) == 0,
+					"mul 3 (%d,%d)", i, j);
+			}
+			zint_trunc(&z3, i);
+			zint_encode(tmp3, 17, &z3, 0);
+			cttk_i31_mul_trunc(x3, x1, x2);
+			cttk_i31_encle(tmp4, 17, x3);
+			check(!cttk_bool_to_int(cttk_i31_isnan(x3)),
+				"mul 4 (%d,%d)", i, j);
+			check(memcmp(tmp3, tmp4, 17) == 0,
+				"mul 5 (%d,%d)", i, j);
+
+			rnd(tmp1, 17);
+			rnd(tmp2, 17);
+			zint_decode(&z1, tmp1, 17, 0, 0);
+			zint_decode(&z2, tmp2, 17, 0, 0);
+			zint_trunc(&z1, (i + 2) >> 1);
+			zint_trunc(&z2, (i + 2) >> 1);
+			zint_encode(tmp1, 17, &z1, 0);
+			zint_encode(tmp2, 17, &z2, 0);
+			cttk_i31_decle_signed(x1, tmp1, 17);
+			cttk_i31_decle_signed(x2, tmp2, 17);
+
+			zint_mul(&z3, &z1, &z2);
+			zint_encode(tmp3, 17, &z3, 0);
+			cttk_i31_mul(x3, x1, x2);
+			if (zint_bitlength(&z3) >= (uint32_t)i) {
+				check(cttk_bool_to_int(cttk_i31_isnan(x3)),
+					"mul 6 (%d,%d)", i, j);
+			} else {
+				check(!cttk_bool_to_int(cttk_i31_isnan(x3)),
+					"mul 7 (%d,%d)", i, j);
+				cttk_i31_encle(tmp4, 17, x3);
+				check(memcmp(tmp3, tmp4, 17) == 0,
+					"mul 8 (%d,%d)", i, j);
+			}
+			zint_trunc(&z3, i);
+			zint_encode(tmp3, 17, &z3, 0);
+			cttk_i31_mul_trunc(x3, x1, x2);
+			cttk_i31_encle(tmp4, 17, x3);
+			check(!cttk_bool_to_int(cttk_i31_isnan(x3)),
+				"mul 9 (%d,%d)", i, j);
+			check(memcmp(tmp3, tmp4, 17) == 0,
+				"mul 10 (%d,%d)", i, j);
+
+			cttk_i31_mul_trunc(x1, x1, x2);
+			cttk_i31_encle(tmp4, 17, x1);
+			check(!cttk_bool_to_int(cttk_i31_isnan(x1)),
+				"mul 11 (%d,%d)", i, j);
+			check(memcmp(tmp3, tmp4, 17) == 0,
+				"mul 12 (%d,%d)", i, j);
+
+			/*
+			 * Squaring (x2 is still the half-size operand).
+			 */
+			zint_mul(&z3, &z2, &z2);
+			zint_encode(tmp3, 17, &z3, 0);
+			cttk_i31_sqr(x3, x2);
+			if (zint_bitlength(&z3) >= (uint32_t)i) {
+				check(cttk_bool_to_int(cttk_i31_isnan(x3)),
+					"sqr 1 (%d,%d)", i, j);
+			} else {
+				check(!cttk_bool_to_int(cttk_i31_isnan(x3)),
+					"sqr 2 (%d,%d)", i, j);
+				cttk_i31_encle(tmp4, 17, x3);
+				check(memcmp(tmp3, tmp4, 17) == 0,
+					"sqr 3 (%d,%d)", i, j);
+			}
+			zint_trunc(&z3, i);
+			zint_encode(tmp3, 17, &z3, 0);
+			cttk_i31_copy(x3, x2);
+			cttk_i31_sqr_trunc(x3, x3);
+			cttk_i31_encle(tmp4, 17, x3);
+			check(!cttk_bool_to_int(cttk_i31_isnan(x3)),
+				"sqr 4 (%d,%d)", i, j);
+			check(memcmp(tmp3, tmp4, 17) == 0,
+				"sqr 5 (%d,%d)", i, j);
+		}
+
+		memset(tmp1, 0, 17);
+		for (j = i - 1; j < 17 * 8; j ++) {
+			tmp1[j >> 3] |= 1 << (j & 7);
+		}
+		memset(tmp2, 0xFF, 17);
+		cttk_i31_decle_signed(x1, tmp1, 17);
+		cttk_i31_decle_signed(x2, tmp2, 17);
+		check(!cttk_bool_to_int(cttk_i31_isnan(x1)), "mul 13 (%d)", i);
+		check(!cttk_bool_to_int(cttk_i31_isnan(x2)), "mul 14 (%d)", i);
+		cttk_i31_mul(x3, x1, x2);
+		check(cttk_bool_to_int(cttk_i31_isnan(x3)), "mul 15 (%d)", i);
+		cttk_i31_mul_trunc(x3, x1, x2);
+		check(!cttk_bool_to_int(cttk_i31_isnan(x3)), "mul 16 (%d)", i);
+		check(cttk_bool_to_int(cttk_i31_eq(x3, x1)), "mul 17 (%d)", i);
+		cttk_i31_sqr(x3, x1);
+		check(cttk_bool_to_int(cttk_i31_isnan(x3)), "sqr 6 (%d)", i);
+		cttk_i31_mul_trunc(x2, x1, x1);
+		cttk_i31_sqr_trunc(x3, x1);
+		check(!cttk_bool_to_int(cttk_i31_isnan(x3)), "sqr 7 (%d)", i);
+		check(cttk_bool_to_int(cttk_i31_eq(x3, x2)), "sqr 8 (%d)", i);
+
+		if ((i & 3) == 0) {
+			printf(".");
+			fflush(stdout);
 		}
 	}
-	return 0;
-}
 
-static uint64_t
-zint_get_u64(const zint *z)
-{
-	return (uint64_t)z->v[0]
-		| ((uint64_t)z->v[1] << 16)
-		| ((uint64_t)z->v[2] << 32)
-		| ((uint64_t)z->v[3] << 48);
+	printf(" done.\n");
+	fflush(stdout);
 }
 
-static int64_t
-zint_get_s64(const zint *z)
+/*
+ * Set x to the value z (which must fit on 17 bytes).
+ */
+static void
+zint_to_i31(uint32_t *x, const zint *z)
 {
-	uint64_t x;
+	unsigned char tmp[17];
 
-	x = zint_get_u64(z);
-	return *(int64_t *)&x;
+	zint_encode(tmp, sizeof tmp, z, 0);
+	cttk_i31_decle_signed(x, tmp, sizeof tmp);
 }
 
+/*
+ * Check that x matches the value z, computed for the non-truncating
+ * (trunc == 0) or truncating (trunc != 0) variant of an operation on
+ * integers of size bits.
+ */
 static void
-zint_trunc(zint *z, unsigned bl)
+check_i31_zint(const uint32_t *x, zint *z, int size, int trunc,
+	const char *name, int i, int j)
 {
-	unsigned k;
-	uint16_t w;
+	unsigned char tmp1[17], tmp2[17];
 
-	if (bl >= 512) {
-		return;
-	}
-	if (bl == 0) {
-		memset(z->v, 0, sizeof z->v);
+	if (!trunc && zint_bitlength(z) >= (unsigned)size) {
+		check(cttk_bool_to_int(cttk_i31_isnan(x)),
+			"%s 1 (%d,%d)", name, i, j);
 		return;
 	}
-	bl --;
-	k = bl >> 4;
-	bl &= 15;
-	w = z->v[k];
-	if (((w >> bl) & 1) != 0) {
-		z->v[k] |= (0xFFFF << bl) & 0xFFFF;
-		for (k ++; k < 32; k ++) {
-			z->v[k] = 0xFFFF;
+	zint_trunc(z, size);
+	check(!cttk_bool_to_int(cttk_i31_isnan(x)), "%s 2 (%d,%d)", name, i, j);
+	zint_encode(tmp1, 17, z, 0);
+	cttk_i31_encle(tmp2, 17, x);
+	check(memcmp(tmp1, tmp2, 17) == 0, "%s 3 (%d,%d)", name, i, j);
+}
+
+static void
+test_i31_muladd(void)
+{
+	cttk_i31_def(x1, 128);
+	cttk_i31_def(x2, 128);
+	cttk_i31_def(x3, 128);
+	cttk_i31_def(x4, 128);
+	zint z1, z2, z3, z4, zx;
+	int i, j;
+	unsigned char tmp[17];
+
+	printf("Test i31 muladd: ");
+	fflush(stdout);
+
+	rnd_init(14);
+
+	for (i = 1; i <= 128; i ++) {
+		cttk_i31_init(x1, i);
+		cttk_i31_init(x2, i);
+		cttk_i31_init(x3, i);
+		cttk_i31_init(x4, i);
+
+		for (j = 0; j < 300; j ++) {
+			uint32_t x;
+			int t, n1, n2;
+
+			/*
+			 * Product operands are about half-size, so that
+			 * both overflowing and non-overflowing results
+			 * are obtained.
+			 */
+			n1 = (i + 2 + (j & 1)) >> 1;
+			n2 = (i + 2 + ((j >> 1) & 1)) >> 1;
+			rnd(tmp, 17);
+			zint_decode(&z1, tmp, 17, 0, 0);
+			zint_trunc(&z1, n1 < i ? n1 : i);
+			rnd(tmp, 17);
+			zint_decode(&z2, tmp, 17, 0, 0);
+			zint_trunc(&z2, n2 < i ? n2 : i);
+			rnd(tmp, 17);
+			zint_decode(&z3, tmp, 17, 0, 0);
+			zint_trunc(&z3, i - ((j >> 2) & 3) * (i >> 2));
+			zint_to_i31(x1, &z1);
+			zint_to_i31(x2, &z2);
+			zint_to_i31(x3, &z3);
+			zint_mul(&z4, &z1, &z2);
+			zint_add(&z4, &z4, &z3);
+
+			for (t = 0; t < 2; t ++) {
+				zint_copy(&zx, &z4);
+				if (t) {
+					cttk_i31_muladd_trunc(x4, x1, x2, x3);
+				} else {
+					cttk_i31_muladd(x4, x1, x2, x3);
+				}
+				check_i31_zint(x4, &zx, i, t, "muladd", i, j);
+
+				/*
+				 * Accumulator and destination may be the
+				 * same array; so may a multiplication
+				 * operand and the destination.
+				 */
+				zint_copy(&zx, &z4);
+				cttk_i31_copy(x4, x3);
+				if (t) {
+					cttk_i31_muladd_trunc(x4, x1, x2, x4);
+				} else {
+					cttk_i31_muladd(x4, x1, x2, x4);
+				}
+				check_i31_zint(x4, &zx, i, t, "muladd acc", i, j);
+				zint_copy(&zx, &z4);
+				cttk_i31_copy(x4, x1);
+				if (t) {
+					cttk_i31_muladd_trunc(x4, x4, x2, x3);
+				} else {
+					cttk_i31_muladd(x4, x4, x2, x3);
+				}
+				check_i31_zint(x4, &zx, i, t, "muladd alias", i, j);
+			}
+
+			/*
+			 * Small scalar multiplication and accumulation.
+			 */
+			rnd(tmp, 17);
+			zint_decode(&z1, tmp, 17, 0, 0);
+			zint_trunc(&z1, i - ((j >> 2) & 3) * (i >> 2));
+			zint_to_i31(x1, &z1);
+			x = rnd32() >> (j & 31);
+			zint_set_u64(&zx, x);
+			zint_mul(&z4, &z1, &zx);
+			for (t = 0; t < 2; t ++) {
+				zint_copy(&zx, &z4);
+				if (t) {
+					cttk_i31_mul_u32_trunc(x4, x1, x);
+				} else {
+					cttk_i31_mul_u32(x4, x1, x);
+				}
+				check_i31_zint(x4, &zx, i, t, "mul_u32", i, j);
+				zint_copy(&zx, &z4);
+				zint_add(&zx, &zx, &z3);
+				cttk_i31_copy(x4, x3);
+				if (t) {
+					cttk_i31_addmul_u32_trunc(x4, x1, x);
+				} else {
+					cttk_i31_addmul_u32(x4, x1, x);
+				}
+				check_i31_zint(x4, &zx, i, t, "addmul_u32", i, j);
+			}
+			zint_set_u64(&zx, (uint64_t)x + 1);
+			zint_mul(&zx, &z1, &zx);
+			cttk_i31_copy(x4, x1);
+			cttk_i31_addmul_u32(x4, x4, x);
+			check_i31_zint(x4, &zx, i, 0, "addmul_u32 alias", i, j);
 		}
-	} else {
-		z->v[k] &= ~(0xFFFF << bl);
-		for (k ++; k < 32; k ++) {
-			z->v[k] = 0x0000;
+
+		/*
+		 * The product may overflow as long as the sum does not.
+		 */
+		if (i >= 3) {
+			cttk_i31_set_u32(x1, 1);
+			cttk_i31_lsh(x1, x1, i - 2);
+			cttk_i31_set_u32(x2, 2);
+			cttk_i31_set_s32(x3, -1);
+			cttk_i31_muladd(x4, x1, x2, x3);
+			check(!cttk_bool_to_int(cttk_i31_isnan(x4)),
+				"muladd 4 (%d)", i);
+			cttk_i31_mul_u32(x4, x1, 2);
+			check(cttk_bool_to_int(cttk_i31_isnan(x4)),
+				"mul_u32 4 (%d)", i);
+			cttk_i31_addmul_u32(x3, x1, 2);
+			check(!cttk_bool_to_int(cttk_i31_isnan(x3)),
+				"addmul_u32 4 (%d)", i);
+		}
+
+		/*
+		 * An overflowing result that would fit after wrapping
+		 * around (this is for sizes which are multiples of 31).
+		 */
+		cttk_i31_set_s32(x1, -1);
+		cttk_i31_lsh(x1, x1, i - 1);
+		cttk_i31_set_s32(x3, -1);
+		cttk_i31_addmul_u32(x3, x1, 0xFFFFFFFF);
+		check(cttk_bool_to_int(cttk_i31_isnan(x3)), "addmul_u32 6 (%d)", i);
+
+		/*
+		 * NaN propagation.
+		 */
+		cttk_i31_set_s32(x1, 0);
+		cttk_i31_set_s32(x2, 0);
+		cttk_i31_init(x3, i);
+		cttk_i31_muladd(x4, x1, x2, x3);
+		check(cttk_bool_to_int(cttk_i31_isnan(x4)), "muladd 5 (%d)", i);
+		cttk_i31_set_s32(x4, 0);
+		cttk_i31_addmul_u32(x4, x3, 1);
+		check(cttk_bool_to_int(cttk_i31_isnan(x4)), "addmul_u32 5 (%d)", i);
+
+		if ((i & 3) == 0) {
+			printf(".");
+			fflush(stdout);
 		}
 	}
+
+	printf(" done.\n");
+	fflush(stdout);
 }
 
+/*
+ * Reference multiplication for large integers: a and b are signed
+ * integers of len bytes each (little-endian, two's complement); the
+ * 2*len-byte product is written in d.
+ */
 static void
-zint_copy(zint *d, const zint *s)
+bytes_mul(unsigned char *d, const unsigned char *a, const unsigned char *b,
+	size_t len)
 {
-	memmove(d->v, s->v, sizeof s->v);
+	size_t u, v;
+	unsigned sa, sb;
+
+	sa = (a[len - 1] >> 7) * 0xFF;
+	sb = (b[len - 1] >> 7) * 0xFF;
+	memset(d, 0, len << 1);
+	for (u = 0; u < (len << 1); u ++) {
+		unsigned wa, cc;
+
+		wa = u < len ? a[u] : sa;
+		cc = 0;
+		for (v = 0; (u + v) < (len << 1); v ++) {
+			unsigned wb;
+
+			wb = v < len ? b[v] : sb;
+			cc += wa * wb + d[u + v];
+			d[u + v] = (unsigned char)cc;
+			cc >>= 8;
+		}
+	}
 }
 
-static void
-zint_add(zint *d, const zint *a, const zint *b)
+/*
+ * Return 1 if the signed integer in buf (len bytes, little-endian)
+ * fits on n bits (i.e. all bits from n-1 upwards are equal).
+ */
+static int
+bytes_fits(const unsigned char *buf, size_t len, unsigned n)
 {
-	int i;
-	uint32_t cc;
-
-	cc = 0;
-	for (i = 0; i < 32; i ++) {
-		uint32_t wa, wb, wd;
+	size_t u;
+	unsigned s;
 
-		wa = a->v[i];
-		wb = b->v[i];
-		wd = wa + wb + cc;
-		cc = wd >> 16;
-		d->v[i] = wd & 0xFFFF;
+	s = (buf[len - 1] >> 7) & 1;
+	for (u = n - 1; u < (len << 3); u ++) {
+		if (((buf[u >> 3] >> (u & 7)) & 1) != s) {
+			return 0;
+		}
 	}
+	return 1;
 }
 
 static void
-zint_sub(zint *d, const zint *a, const zint *b)
+test_i31_mul_large(void)
 {
-	int i;
-	uint32_t cc;
+	static const unsigned sizes[] = {
+		990, 1000, 1500, 2048, 3072, 4096, 6000, 8192, 9100
+	};
+	cttk_i31_def(x1, 9100);
+	cttk_i31_def(x2, 9100);
+	cttk_i31_def(x3, 9100);
+	cttk_i31_def(x4, 9100);
+	size_t k;
+	int j, ok;
+	static unsigned char tmp1[1200], tmp2[1200], tmp3[2400];
+
+	printf("Test i31 mul (large): ");
+	fflush(stdout);
 
-	cc = 0;
-	for (i = 0; i < 32; i ++) {
-		uint32_t wa, wb, wd;
+	rnd_init(11);
 
-		wa = a->v[i];
-		wb = b->v[i];
-		wd = wa - wb - cc;
-		cc = (wd >> 16) & 1;
-		d->v[i] = wd & 0xFFFF;
+	for (k = 0; k < (sizeof sizes) / sizeof sizes[0]; k ++) {
+		unsigned size;
+		size_t len;
+
+		size = sizes[k];
+		len = (size + 7) >> 3;
+		cttk_i31_init(x1, size);
+		cttk_i31_init(x2, size);
+		cttk_i31_init(x3, size);
+		cttk_i31_init(x4, size);
+
+		for (j = 0; j < 20; j ++) {
+			rnd(tmp1, len);
+			rnd(tmp2, len);
+			cttk_i31_decle_signed_trunc(x1, tmp1, len);
+			cttk_i31_decle_signed_trunc(x2, tmp2, len);
+			if (j >= 4) {
+				/*
+				 * Make the product size close to the limit,
+				 * so that both overflowing and non-overflowing
+				 * products are exercised.
+				 */
+				cttk_i31_rsh(x1, x1, (size >> 1) - 2 + (j & 3));
+				cttk_i31_rsh(x2, x2, (size >> 1) - 2 + (j >> 2));
+			}
+			cttk_i31_encle(tmp1, len, x1);
+			cttk_i31_encle(tmp2, len, x2);
+			bytes_mul(tmp3, tmp1, tmp2, len);
+
+			cttk_i31_mul(x3, x1, x2);
+			cttk_i31_decle_signed_trunc(x4, tmp3, len << 1);
+			if (bytes_fits(tmp3, len << 1, size)) {
+				check(!cttk_bool_to_int(cttk_i31_isnan(x3)),
+					"mul large 1 (%u,%d)", size, j);
+				check(cttk_bool_to_int(cttk_i31_eq(x3, x4)),
+					"mul large 2 (%u,%d)", size, j);
+			} else {
+				check(cttk_bool_to_int(cttk_i31_isnan(x3)),
+					"mul large 3 (%u,%d)", size, j);
+			}
+			cttk_i31_mul_trunc(x3, x1, x2);
+			check(cttk_bool_to_int(cttk_i31_eq(x3, x4)),
+				"mul large 4 (%u,%d)", size, j);
+
+			/*
+			 * Aliased operands.
+			 */
+			cttk_i31_copy(x3, x1);
+			cttk_i31_mul_trunc(x3, x3, x2);
+			check(cttk_bool_to_int(cttk_i31_eq(x3, x4)),
+				"mul large 5 (%u,%d)", size, j);
+
+			/*
+			 * Fused multiply-add (x4 <- x1*x2 + x1).
+			 */
+			cttk_i31_mul(x3, x1, x2);
+			cttk_i31_add(x3, x3, x1);
+			ok = !cttk_bool_to_int(cttk_i31_isnan(x3));
+			cttk_i31_add_trunc(x4, x4, x1);
+			cttk_i31_muladd(x3, x1, x2, x1);
+			if (ok) {
+				check(!cttk_bool_to_int(cttk_i31_isnan(x3)),
+					"muladd large 1 (%u,%d)", size, j);
+			}
+			if (!cttk_bool_to_int(cttk_i31_isnan(x3))) {
+				check(cttk_bool_to_int(cttk_i31_eq(x3, x4)),
+					"muladd large 2 (%u,%d)", size, j);
+			}
+			cttk_i31_copy(x3, x1);
+			cttk_i31_muladd_trunc(x3, x3, x2, x3);
+			check(cttk_bool_to_int(cttk_i31_eq(x3, x4)),
+				"muladd large 3 (%u,%d)", size, j);
+			bytes_mul(tmp3, tmp1, tmp1, len);
+			cttk_i31_decle_signed_trunc(x4, tmp3, len << 1);
+			cttk_i31_copy(x3, x1);
+			cttk_i31_mul_trunc(x3, x3, x3);
+			check(cttk_bool_to_int(cttk_i31_eq(x3, x4)),
+				"mul large 6 (%u,%d)", size, j);
+			cttk_i31_sqr(x3, x1);
+			if (bytes_fits(tmp3, len << 1, size)) {
+				check(!cttk_bool_to_int(cttk_i31_isnan(x3)),
+					"sqr large 1 (%u,%d)", size, j);
+				check(cttk_bool_to_int(cttk_i31_eq(x3, x4)),
+					"sqr large 2 (%u,%d)", size, j);
+			} else {
+				check(cttk_bool_to_int(cttk_i31_isnan(x3)),
+					"sqr large 3 (%u,%d)", size, j);
+			}
+			cttk_i31_copy(x3, x1);
+			cttk_i31_sqr_trunc(x3, x3);
+			check(cttk_bool_to_int(cttk_i31_eq(x3, x4)),
+				"sqr large 4 (%u,%d)", size, j);
+		}
+
+		/*
+		 * A square whose low half is zero must still be reported
+		 * as overflowing.
+		 */
+		cttk_i31_set_u32(x1, 1);
+		cttk_i31_lsh(x1, x1, (size >> 1) + 16);
+		cttk_i31_sqr(x3, x1);
+		check(cttk_bool_to_int(cttk_i31_isnan(x3)),
+			"sqr large 5 (%u)", size);
+		cttk_i31_sqr_trunc(x3, x1);
+		check(cttk_bool_to_int(cttk_i31_eq0(x3)),
+			"sqr large 6 (%u)", size);
+
+		printf(".");
+		fflush(stdout);
 	}
+
+	printf(" done.\n");
+	fflush(stdout);
 }
 
-static int
-zint_cmp(const zint *a, const zint *b)
+static void
+test_i31_shift(void)
 {
-	zint d;
-	int i;
+	cttk_i31_def(x1, 300);
+	cttk_i31_def(x2, 300);
+	zint z1, z2;
+	int i, j, k;
+	unsigned char tmp1[100], tmp2[100], tmp3[100];
 
-	zint_sub(&d, a, b);
-	if (d.v[31] >= 0x8000) {
-		return -1;
-	}
-	for (i = 0; i < 32; i ++) {
-		if (d.v[i] != 0) {
-			return 1;
+	printf("Test i31 shift: ");
+	fflush(stdout);
+
+	rnd_init(7);
+
+	for (i = 1; i <= 128; i ++) {
+		cttk_i31_init(x1, i);
+		cttk_i31_init(x2, i);
+
+		for (j = 0; j <= i + 32; j ++) {
+			for (k = 0; k < 50; k ++) {
+				rnd(tmp1, 17);
+				zint_decode(&z1, tmp1, 17, 0, 0);
+				zint_trunc(&z1, i);
+				zint_encode(tmp1, 17, &z1, 0);
+				cttk_i31_decle_signed(x1, tmp1, 17);
+
+				zint_lsh(&z2, &z1, j);
+				zint_encode(tmp2, 17, &z2, 0);
+				cttk_i31_lsh(x2, x1, j);
+				if (zint_bitlength(&z2) >= (uint32_t)i) {
+					check(cttk_bool_to_int(
+						cttk_i31_isnan(x2)),
+						"lsh 1 (%d,%d,%d)", i, j, k);
+				} else {
+					check(!cttk_bool_to_int(
+						cttk_i31_isnan(x2)),
+						"lsh 2 (%d,%d,%d)", i, j, k);
+					cttk_i31_encle(tmp3, 17, x2);
+					check(memcmp(tmp2, tmp3, 17) == 0,
+						"lsh 3 (%d,%d,%d)", i, j, k);
+				}
+
+				cttk_i31_lsh_prot(x2, x1, j);
+				if (zint_bitlength(&z2) >= (uint32_t)i) {
+					check(cttk_bool_to_int(
+						cttk_i31_isnan(x2)),
+						"lsh 4 (%d,%d,%d)", i, j, k);
+				} else {
+					check(!cttk_bool_to_int(
+						cttk_i31_isnan(x2)),
+						"lsh 5 (%d,%d,%d)", i, j, k);
+					cttk_i31_encle(tmp3, 17, x2);
+					check(memcmp(tmp2, tmp3, 17) == 0,
+						"lsh 6 (%d,%d,%d)", i, j, k);
+				}
+
+				zint_trunc(&z2, i);
+				zint_encode(tmp2, 17, &z2, 0);
+				cttk_i31_lsh_trunc(x2, x1, j);
+				cttk_i31_encle(tmp3, 17, x2);
+				check(memcmp(tmp2, tmp3, 17) == 0,
+					"lsh 7 (%d,%d,%d)", i, j, k);
+				cttk_i31_lsh_trunc_prot(x2, x1, j);
+				cttk_i31_encle(tmp3, 17, x2);
+				check(memcmp(tmp2, tmp3, 17) == 0,
+					"lsh 8 (%d,%d,%d)", i, j, k);
+
+				zint_rsh(&z2, &z1, j);
+				zint_encode(tmp2, 17, &z2, 0);
+				cttk_i31_rsh(x2, x1, j);
+				cttk_i31_encle(tmp3, 17, x2);
+				check(memcmp(tmp2, tmp3, 17) == 0,
+					"rsh 1 (%d,%d,%d)", i, j, k);
+				cttk_i31_rsh_prot(x2, x1, j);
+				cttk_i31_encle(tmp3, 17, x2);
+				check(memcmp(tmp2, tmp3, 17) == 0,
+					"rsh 2 (%d,%d,%d)", i, j, k);
+			}
 		}
-	}
-	return 0;
-}
-
-static int
-zint_sign(const zint *a)
-{
-	int i;
 
-	if (a->v[31] >= 0x8000) {
-		return -1;
-	}
-	for (i = 0; i < 32; i ++) {
-		if (a->v[i] != 0) {
-			return 1;
+		if ((i & 3) == 0) {
+			printf(".");
+			fflush(stdout);
 		}
 	}
-	return 0;
+
+	printf(" done.\n");
+	fflush(stdout);
 }
 
 static void
-zint_decode(zint *z, const void *src, size_t len, int be, int sig)
+test_i31_div(void)
 {
-	const unsigned char *buf;
-	size_t u;
-	unsigned bx;
+	cttk_i31_def(a, 300);
+	cttk_i31_def(b, 300);
+	cttk_i31_def(q, 300);
+	cttk_i31_def(r, 300);
+	cttk_i31_def(m, 300);
+	cttk_i31_def(x, 300);
+	int i, j;
+	unsigned char tmp1[100], tmp2[100];
 
-	zint_zero(z);
-	if (len == 0) {
-		return;
-	}
-	buf = src;
-	if (sig) {
-		if (be) {
-			bx = buf[0] >= 0x80 ? 0xFF : 0x00;
-		} else {
-			bx = buf[len - 1] >= 0x80 ? 0xFF : 0x00;
-		}
-	} else {
-		bx = 0x00;
-	}
-	for (u = 0; u < 64; u ++) {
-		unsigned b;
+	printf("Test i31 div: ");
+	fflush(stdout);
 
-		if (u < len) {
-			b = be ? buf[len - 1 - u] : buf[u];
-		} else {
-			b = bx;
-		}
-		if ((u & 1) != 0) {
-			b <<= 8;
-		}
-		z->v[u >> 1] |= b;
-	}
-}
+	rnd_init(8);
 
-static void
-zint_encode(void *dst, size_t len, const zint *z, int be)
-{
-	unsigned char *buf;
-	size_t u;
-	unsigned ssx;
+	for (i = 1; i <= 128; i ++) {
+		cttk_i31_init(a, i);
+		cttk_i31_init(b, i);
+		cttk_i31_init(q, i);
+		cttk_i31_init(r, i);
+		cttk_i31_init(m, i);
+		cttk_i31_init(x, i);
 
-	buf = dst;
-	ssx = (z->v[31] >= 0x8000) ? 0xFF : 0x00;
-	for (u = 0; u < len; u ++) {
-		unsigned b;
+		for (j = 0; j < 1000; j ++) {
+			cttk_bool bb;
 
-		if (u < 64) {
-			b = z->v[u >> 1];
-			if ((u & 1) != 0) {
-				b >>= 8;
+			rnd(tmp1, 17);
+			rnd(tmp2, 17);
+			cttk_i31_decle_signed_trunc(a, tmp1, 17);
+			cttk_i31_decle_signed_trunc(b, tmp2, 17);
+			if (j >= 500) {
+				cttk_i31_rsh(b, b, i >> 1);
 			}
-		} else {
-			b = ssx;
-		}
-		if (be) {
-			buf[len - 1 - u] = b;
-		} else {
-			buf[u] = b;
-		}
-	}
-}
 
-static void
-zint_mul(zint *d, zint *a, zint *b)
-{
-	zint x, t;
-	int i, j;
+			/*
+			 * Set bb to true if b == -1 and a == MinValue.
+			 */
+			if (i >= 2) {
+				cttk_i31_set_u32_trunc(x, 1);
+				cttk_i31_add(x, x, b);
+				bb = cttk_i31_eq0(x);
+				cttk_i31_lsh_trunc(x, a, 1);
+				bb = cttk_and(bb, cttk_and(cttk_i31_eq0(x),
+					cttk_i31_neq0(a)));
+			} else {
+				bb = cttk_bool_of_u32(i == 1
+					&& (tmp1[0] & tmp2[0] & 1) == 1);
+			}
 
-	zint_zero(&t);
-	for (i = 0; i < 32; i ++) {
-		uint32_t wb, cc;
+			cttk_i31_divrem(q, r, a, b);
 
-		wb = b->v[i];
-		memset(x.v, 0, i * sizeof(uint16_t));
-		cc = 0;
-		for (j = i; j < 32; j ++) {
-			uint32_t wa, wx;
+			if (cttk_bool_to_int(cttk_i31_eq0(b))) {
+				check(cttk_bool_to_int(cttk_i31_isnan(q)),
+					"div 1 (%d,%d)", i, j);
+				check(cttk_bool_to_int(cttk_i31_isnan(r)),
+					"div 2 (%d,%d)", i, j);
+			} else if (cttk_bool_to_int(bb)) {
+				check(cttk_bool_to_int(cttk_i31_isnan(q)),
+					"div 3 (%d,%d)", i, j);
+				check(cttk_bool_to_int(cttk_i31_eq0(r)),
+					"div 4 (%d,%d)", i, j);
+			} else if (cttk_bool_to_int(cttk_i31_lt0(a))) {
+				check(cttk_bool_to_int(cttk_i31_leq0(r)),
+					"div 5 (%d,%d)", i, j);
+				if (cttk_bool_to_int(cttk_i31_lt0(b))) {
+					check(cttk_bool_to_int(
+						cttk_i31_lt(b, r)),
+						"div 6 (%d,%d)", i, j);
+				} else {
+					cttk_i31_neg(x, r);
+					check(cttk_bool_to_int(
+						cttk_i31_lt(x, b)),
+						"div 7 (%d,%d)", i, j);
+				}
+				cttk_i31_mul(x, b, q);
+				cttk_i31_add(x, x, r);
+				check(cttk_bool_to_int(cttk_i31_eq(x, a)),
+					"div 8 (%d,%d)", i, j);
+			} else {
+				check(cttk_bool_to_int(cttk_i31_geq0(r)),
+					"div 9 (%d,%d)", i, j);
+				if (cttk_bool_to_int(cttk_i31_lt0(b))) {
+					cttk_i31_neg(x, r);
+					check(cttk_bool_to_int(
+						cttk_i31_lt(b, x)),
+						"div 10 (%d,%d)", i, j);
+				} else {
+					check(cttk_bool_to_int(
+						cttk_i31_lt(r, b)),
+						"div 11 (%d,%d)", i, j);
+				}
+				cttk_i31_mul(x, b, q);
+				cttk_i31_add(x, x, r);
+				check(cttk_bool_to_int(cttk_i31_eq(x, a)),
+					"div 12 (%d,%d)", i, j);
+			}
 
-			wa = a->v[j - i];
-			wx = wa * wb + cc;
-			cc = wx >> 16;
-			x.v[j] = (uint16_t)wx;
+			cttk_i31_mod(m, a, b);
+
+			if (cttk_bool_to_int(cttk_i31_eq0(b))) {
+				check(cttk_bool_to_int(cttk_i31_isnan(m)),
+					"mod 1 (%d,%d)", i, j);
+			} else {
+				check(!cttk_bool_to_int(cttk_i31_isnan(m)),
+					"mod 2 (%d,%d)", i, j);
+				check(cttk_bool_to_int(cttk_i31_geq0(m)),
+					"mod 3 (%d,%d)", i, j);
+				if (cttk_bool_to_int(cttk_i31_geq0(r))) {
+					check(cttk_bool_to_int
+						(cttk_i31_eq(r, m)),
+						"mod 4 (%d,%d)", i, j);
+				} else if (cttk_bool_to_int(cttk_i31_gt0(b))) {
+					cttk_i31_sub(m, m, r);
+					check(cttk_bool_to_int
+						(cttk_i31_eq(b, m)),
+						"mod 5 (%d,%d)", i, j);
+				} else {
+					cttk_i31_add(m, m, b);
+					check(cttk_bool_to_int
+						(cttk_i31_eq(r, m)),
+						"mod 6 (%d,%d)", i, j);
+				}
+			}
+		}
+
+		if ((i & 3) == 0) {
+			printf(".");
+			fflush(stdout);
 		}
-		zint_add(&t, &t, &x);
 	}
-	zint_copy(d, &t);
+
+	printf(" done.\n");
+	fflush(stdout);
 }
 
 static void
-zint_lsh(zint *d, zint *a, unsigned n)
+test_i31_div_large(void)
 {
-	zint t;
-	int i, nd, nm;
+	static const unsigned sizes[] = {
+		155, 186, 250, 311, 521, 1024, 2047, 3100, 5000, 8300
+	};
+	cttk_i31_def(a, 8300);
+	cttk_i31_def(b, 8300);
+	cttk_i31_def(q, 8300);
+	cttk_i31_def(r, 8300);
+	cttk_i31_def(x, 8300);
+	size_t k;
+	int j;
+	unsigned char tmp1[1040], tmp2[1040];
+	uint32_t *ws;
+
+	printf("Test i31 div (large): ");
+	fflush(stdout);
 
-	nd = (int)(n >> 4);
-	nm = (int)(n & 15);
-	for (i = 0; i < 32; i ++) {
-		if (i < nd) {
-			t.v[i] = 0;
-		} else if (i == nd) {
-			t.v[i] = (uint16_t)((uint32_t)a->v[0] << nm);
-		} else {
-			t.v[i] = (uint16_t)(((uint32_t)a->v[i - nd] << nm)
-				| ((uint32_t)a->v[i - nd - 1] >> (16 - nm)));
+	/*
+	 * Large sizes may exceed CTTK_MAX_INT_BUF; an explicit temporary
+	 * buffer keeps the test meaningful when the library is compiled
+	 * with CTTK_NO_MALLOC.
+	 */
+	rnd_init(10);
+	ws = malloc(cttk_i31_ws_len(8300) * sizeof *ws);
+	check(ws != NULL, "malloc");
+
+	for (k = 0; k < (sizeof sizes) / sizeof sizes[0]; k ++) {
+		unsigned size;
+		size_t len, wlen;
+
+		size = sizes[k];
+		len = (size + 7) >> 3;
+		wlen = cttk_i31_ws_len(size);
+		cttk_i31_init(a, size);
+		cttk_i31_init(b, size);
+		cttk_i31_init(q, size);
+		cttk_i31_init(r, size);
+		cttk_i31_init(x, size);
+
+		for (j = 0; j < 40; j ++) {
+			rnd(tmp1, len);
+			rnd(tmp2, len);
+			cttk_i31_decle_signed_trunc(a, tmp1, len);
+			cttk_i31_decle_signed_trunc(b, tmp2, len);
+			switch (j & 7) {
+			case 1:
+				cttk_i31_rsh(b, b, (size * (unsigned)j) / 41);
+				break;
+			case 2:
+				cttk_i31_rsh(b, b, size - 32);
+				break;
+			case 3:
+				cttk_i31_rsh(a, a, size >> 1);
+				break;
+			case 4:
+				/* a = MinValue */
+				cttk_i31_set_s32(a, -1);
+				cttk_i31_lsh_trunc(a, a, size - 1);
+				break;
+			case 5:
+				/* b = MinValue */
+				cttk_i31_set_s32(b, -1);
+				cttk_i31_lsh_trunc(b, b, size - 1);
+				break;
+			case 6:
+				/* b = a >> 1, to get a quotient of 2 or 3 */
+				cttk_i31_rsh(b, a, 1);
+				break;
+			}
+			if (cttk_bool_to_int(cttk_i31_eq0(b))) {
+				cttk_i31_set_u32(b, 1);
+			}
+
+			cttk_i31_divrem_ws(q, r, a, b, ws, wlen);
+			check(!cttk_bool_to_int(cttk_i31_isnan(q)),
+				"div large 1 (%u,%d)", size, j);
+			check(!cttk_bool_to_int(cttk_i31_isnan(r)),
+				"div large 2 (%u,%d)", size, j);
+			if (cttk_bool_to_int(cttk_i31_lt0(a))) {
+				check(cttk_bool_to_int(cttk_i31_leq0(r)),
+					"div large 3 (%u,%d)", size, j);
+				cttk_i31_neg(x, r);
+			} else {
+				check(cttk_bool_to_int(cttk_i31_geq0(r)),
+					"div large 4 (%u,%d)", size, j);
+				cttk_i31_copy(x, r);
+			}
+			if (cttk_bool_to_int(cttk_i31_lt0(b))) {
+				cttk_i31_neg(x, x);
+				check(cttk_bool_to_int(cttk_i31_lt(b, x)),
+					"div large 5 (%u,%d)", size, j);
+			} else {
+				check(cttk_bool_to_int(cttk_i31_lt(x, b)),
+					"div large 6 (%u,%d)", size, j);
+			}
+			cttk_i31_mul_ws(x, b, q, ws, wlen);
+			cttk_i31_add(x, x, r);
+			check(cttk_bool_to_int(cttk_i31_eq(x, a)),
+				"div large 7 (%u,%d)", size, j);
 		}
+
+		printf(".");
+		fflush(stdout);
 	}
-	zint_copy(d, &t);
+
+	free(ws);
+	printf(" done.\n");
+	fflush(stdout);
 }
 
+/*
+ * Fill the temporary buffer for _ws functions with a known pattern,
+ * with a sentinel word after the first tmp_len words.
+ */
 static void
-zint_rsh(zint *d, zint *a, unsigned n)
+ws_fill(uint32_t *tmp, size_t tmp_len)
 {
-	int i, nd, nm;
-	uint32_t ssa;
+	size_t u;
 
-	nd = (int)(n >> 4);
-	nm = (int)(n & 15);
-	ssa = (a->v[31] >= 0x8000) ? 0xFFFF : 0x0000;
-	for (i = 0; i < 32; i ++) {
-		if (i + nd < 31) {
-			d->v[i] = (uint16_t)(((uint32_t)a->v[i + nd] >> nm)
-				| ((uint32_t)a->v[i + nd + 1] << (16 - nm)));
-		} else if (i + nd == 31) {
-			d->v[i] = (uint16_t)(((uint32_t)a->v[31] >> nm)
-				| (ssa << (16 - nm)));
-		} else {
-			d->v[i] = ssa;
-		}
+	for (u = 0; u <= tmp_len; u ++) {
+		tmp[u] = 0xA5A5A5A5;
 	}
 }
 
 static void
-zint_and(zint *d, const zint *a, const zint *b)
+test_i31_ws(void)
 {
-	int i;
+	static const unsigned sizes[] = {
+		31, 100, 155, 250, 496, 521, 1024, 2047, 4000, 8300
+	};
+	cttk_i31_def(a, 8300);
+	cttk_i31_def(b, 8300);
+	cttk_i31_def(c, 8300);
+	cttk_i31_def(d, 8300);
+	cttk_i31_def(x, 8300);
+	cttk_i31_def(y, 8300);
+	unsigned char tmp1[1040], tmp2[1040];
+	uint32_t *ws;
+	size_t k;
+	int j;
+
+	printf("Test i31 ws: ");
+	fflush(stdout);
 
-	for (i = 0; i < 32; i ++) {
-		d->v[i] = a->v[i] & b->v[i];
-	}
-}
+	rnd_init(12);
+	ws = malloc((cttk_i31_ws_len(8300) + 1) * sizeof *ws);
+	check(ws != NULL, "malloc");
+
+	for (k = 0; k < (sizeof sizes) / sizeof sizes[0]; k ++) {
+		unsigned size;
+		size_t len, wlen;
+
+		size = sizes[k];
+		len = (size + 7) >> 3;
+		wlen = cttk_i31_ws_len(size);
+		check(wlen <= cttk_i31_ws_len(8300), "ws_len (%u)", size);
+		cttk_i31_init(a, size);
+		cttk_i31_init(b, size);
+		cttk_i31_init(c, size);
+		cttk_i31_init(d, size);
+		cttk_i31_init(x, size);
+		cttk_i31_init(y, size);
+
+		for (j = 0; j < 20; j ++) {
+			rnd(tmp1, len);
+			rnd(tmp2, len);
+			cttk_i31_decle_signed_trunc(a, tmp1, len);
+			cttk_i31_decle_signed_trunc(b, tmp2, len);
+			if ((j & 1) == 1) {
+				cttk_i31_rsh(a, a, size >> 1);
+				cttk_i31_rsh(b, b, (size + 1) >> 1);
+			}
+			if (cttk_bool_to_int(cttk_i31_eq0(b))) {
+				cttk_i31_set_u32(b, 1);
+			}
 
-static void
-zint_or(zint *d, const zint *a, const zint *b)
-{
-	int i;
+			ws_fill(ws, wlen);
+			cttk_i31_mul(x, a, b);
+			cttk_i31_mul_ws(c, a, b, ws, wlen);
+			check(cttk_bool_to_int(cttk_i31_eq(c, x))
+				|| (cttk_bool_to_int(cttk_i31_isnan(c))
+				&& cttk_bool_to_int(cttk_i31_isnan(x))),
+				"mul_ws 1 (%u,%d)", size, j);
+			cttk_i31_copy(c, a);
+			cttk_i31_mul_ws(c, c, b, ws, wlen);
+			check(cttk_bool_to_int(cttk_i31_eq(c, x))
+				|| (cttk_bool_to_int(cttk_i31_isnan(c))
+				&& cttk_bool_to_int(cttk_i31_isnan(x))),
+				"mul_ws 2 (%u,%d)", size, j);
+			cttk_i31_mul_ws(c, a, b, NULL, 0);
+			check(cttk_bool_to_int(cttk_i31_eq(c, x))
+				|| (cttk_bool_to_int(cttk_i31_isnan(c))
+				&& cttk_bool_to_int(cttk_i31_isnan(x))),
+				"mul_ws 3 (%u,%d)", size, j);
+			cttk_i31_copy(c, a);
+			cttk_i31_mul_ws(c, c, b, NULL, 0);
+			check(cttk_bool_to_int(cttk_i31_isnan(c)),
+				"mul_ws 4 (%u,%d)", size, j);
 
-	for (i = 0; i < 32; i ++) {
-		d->v[i] = a->v[i] | b->v[i];
+			/*
+			 * With CTTK_NO_MALLOC, the plain functions report NaN
+			 * for the largest sizes (the temporary buffer exceeds
+			 * CTTK_MAX_INT_BUF); the _ws variants must still work.
+			 */
+			cttk_i31_divrem(x, y, a, b);
+			cttk_i31_divrem_ws(c, d, a, b, ws, wlen);
+			check((cttk_bool_to_int(cttk_i31_eq(c, x))
+				&& cttk_bool_to_int(cttk_i31_eq(d, y)))
+				|| (cttk_bool_to_int(cttk_i31_isnan(x))
+				&& !cttk_bool_to_int(cttk_i31_isnan(c))
+				&& !cttk_bool_to_int(cttk_i31_isnan(d))),
+				"divrem_ws 1 (%u,%d)", size, j);
+			cttk_i31_copy(x, c);
+			cttk_i31_init(c, size);
+			cttk_i31_divrem_ws(c, NULL, a, b, ws, wlen);
+			check(cttk_bool_to_int(cttk_i31_eq(c, x)),
+				"divrem_ws 2 (%u,%d)", size, j);
+			cttk_i31_divrem_ws(c, d, a, b, ws, 0);
+			check(cttk_bool_to_int(cttk_i31_isnan(c))
+				&& cttk_bool_to_int(cttk_i31_isnan(d)),
+				"divrem_ws 3 (%u,%d)", size, j);
+			cttk_i31_init(c, size);
+			cttk_i31_init(d, size);
+
+			cttk_i31_mod(x, a, b);
+			cttk_i31_mod_ws(c, a, b, ws, wlen);
+			check(cttk_bool_to_int(cttk_i31_eq(c, x))
+				|| (cttk_bool_to_int(cttk_i31_isnan(x))
+				&& !cttk_bool_to_int(cttk_i31_isnan(c))),
+				"mod_ws 1 (%u,%d)", size, j);
+			cttk_i31_mod_ws(c, a, b, ws, 1);
+			check(cttk_bool_to_int(cttk_i31_isnan(c)),
+				"mod_ws 2 (%u,%d)", size, j);
+			cttk_i31_init(c, size);
+
+			check(ws[wlen] == 0xA5A5A5A5,
+				"ws overflow (%u,%d)", size, j);
+		}
+
+		printf(".");
+		fflush(stdout);
 	}
+
+	free(ws);
+	printf(" done.\n");
+	fflush(stdout);
 }
 
+/*
+ * Reference modular multiplication: d <- (a*b) mod m, using plain
+ * i31 operations over twice the size.
+ */
 static void
-zint_xor(zint *d, const zint *a, const zint *b)
+ref_mulmod(uint32_t *d, const uint32_t *a, const uint32_t *b,
+	const uint32_t *m, unsigned size)
 {
-	int i;
-
-	for (i = 0; i < 32; i ++) {
-		d->v[i] = a->v[i] ^ b->v[i];
-	}
+	cttk_i31_def(wa, 4202);
+	cttk_i31_def(wb, 4202);
+	cttk_i31_def(wm, 4202);
+
+	cttk_i31_init(wa, (size << 1) + 2);
+	cttk_i31_init(wb, (size << 1) + 2);
+	cttk_i31_init(wm, (size << 1) + 2);
+	cttk_i31_set(wa, a);
+	cttk_i31_set(wb, b);
+	cttk_i31_set(wm, m);
+	cttk_i31_mul(wa, wa, wb);
+	cttk_i31_mod(wa, wa, wm);
+	cttk_i31_set(d, wa);
 }
 
 static void
-zint_eqv(zint *d, const zint *a, const zint *b)
+test_m31(void)
 {
-	int i;
+	static const unsigned sizes[] = {
+		3, 5, 31, 32, 33, 62, 63, 64, 100, 255, 521, 1024, 2100
+	};
+	cttk_m31_def(mc, 2100);
+	cttk_i31_def(m, 2100);
+	cttk_i31_def(a, 2100);
+	cttk_i31_def(b, 2100);
+	cttk_i31_def(c, 2100);
+	cttk_i31_def(x, 2100);
+	cttk_i31_def(y, 2100);
+	cttk_i31_def(z, 2100);
+	cttk_i31_def(s, 100);
+	size_t k;
+	int j;
+	unsigned char tmp[300];
+
+	printf("Test m31: ");
+	fflush(stdout);
 
-	for (i = 0; i < 32; i ++) {
-		d->v[i] = ~(a->v[i] ^ b->v[i]);
-	}
-}
+	rnd_init(11);
 
-static void
-zint_not(zint *d, const zint *a)
-{
-	int i;
+	/*
+	 * Invalid moduli.
+	 */
+	cttk_i31_init(m, 100);
+	cttk_i31_set_u32(m, 0);
+	cttk_m31_init(mc, m);
+	check(cttk_bool_to_int(cttk_m31_isnan(mc)), "m31 invalid 1");
+	cttk_i31_set_u32(m, 1);
+	cttk_m31_init(mc, m);
+	check(cttk_bool_to_int(cttk_m31_isnan(mc)), "m31 invalid 2");
+	cttk_i31_set_u32(m, 1000);
+	cttk_m31_init(mc, m);
+	check(cttk_bool_to_int(cttk_m31_isnan(mc)), "m31 invalid 3");
+	cttk_i31_set_s32(m, -1001);
+	cttk_m31_init(mc, m);
+	check(cttk_bool_to_int(cttk_m31_isnan(mc)), "m31 invalid 4");
+	cttk_i31_init(m, 100);
+	cttk_m31_init(mc, m);
+	check(cttk_bool_to_int(cttk_m31_isnan(mc)), "m31 invalid 5");
+	cttk_i31_set_u32(m, 1001);
+	cttk_m31_init(mc, m);
+	check(!cttk_bool_to_int(cttk_m31_isnan(mc)), "m31 valid");
 
-	for (i = 0; i < 32; i ++) {
-		d->v[i] = ~a->v[i];
+	/*
+	 * Size mismatch and NaN propagation.
+	 */
+	cttk_i31_init(a, 100);
+	cttk_i31_init(s, 99);
+	cttk_i31_set_u32(a, 5);
+	cttk_i31_set_u32(s, 5);
+	cttk_i31_init(x, 100);
+	cttk_m31_encode(x, s, mc);
+	check(cttk_bool_to_int(cttk_i31_isnan(x)), "m31 size 1");
+	cttk_m31_encode(x, a, mc);
+	check(!cttk_bool_to_int(cttk_i31_isnan(x)), "m31 size 2");
+	cttk_m31_mul(s, x, x, mc);
+	check(cttk_bool_to_int(cttk_i31_isnan(s)), "m31 size 3");
+	cttk_i31_init(b, 100);
+	cttk_i31_init(y, 100);
+	cttk_m31_add(y, x, b, mc);
+	check(cttk_bool_to_int(cttk_i31_isnan(y)), "m31 nan 1");
+	cttk_m31_mul(y, b, x, mc);
+	check(cttk_bool_to_int(cttk_i31_isnan(y)), "m31 nan 2");
+	cttk_m31_decode(y, x, mc);
+	check(cttk_i31_to_u32(y) == 5, "m31 decode small");
+
+	for (k = 0; k < (sizeof sizes) / sizeof sizes[0]; k ++) {
+		unsigned size;
+		size_t len;
+
+		size = sizes[k];
+		len = (size + 7) >> 3;
+		cttk_i31_init(m, size);
+		cttk_i31_init(a, size);
+		cttk_i31_init(b, size);
+		cttk_i31_init(c, size);
+		cttk_i31_init(x, size);
+		cttk_i31_init(y, size);
+		cttk_i31_init(z, size);
+
+		for (j = 0; j < 30; j ++) {
+			/*
+			 * Random odd positive modulus; the top bits are
+			 * sometimes forced, to get a modulus close to the
+			 * maximum.
+			 */
+			rnd(tmp, len);
+			cttk_i31_decle_unsigned_trunc(m, tmp, len);
+			cttk_i31_set_s32(c, -1);
+			cttk_i31_lsh_trunc(c, c, size - 1);
+			cttk_i31_not(c, c);
+			cttk_i31_and(m, m, c);
+			if ((j & 3) == 0) {
+				cttk_i31_copy(m, c);
+			} else if ((j & 3) == 1) {
+				cttk_i31_rsh(m, m, (unsigned)j % size);
+			}
+			cttk_i31_set_u32_trunc(c, 1);
+			cttk_i31_or(m, m, c);
+			if (cttk_bool_to_int(cttk_i31_eq(m, c))) {
+				cttk_i31_set_u32_trunc(m, 3);
+			}
+			cttk_m31_init(mc, m);
+			check(!cttk_bool_to_int(cttk_m31_isnan(mc)),
+				"m31 init (%u,%d)", size, j);
+			check(cttk_bool_to_int(cttk_i31_eq(mc, m)),
+				"m31 init copy (%u,%d)", size, j);
+
+			/*
+			 * Random operands; a may be negative.
+			 */
+			rnd(tmp, len);
+			cttk_i31_decle_signed_trunc(a, tmp, len);
+			if (j == 5) {
+				cttk_i31_set_s32(a, -1);
+				cttk_i31_lsh_trunc(a, a, size - 1);
+			}
+			rnd(tmp, len);
+			cttk_i31_decle_unsigned_trunc(b, tmp, len);
+			cttk_i31_mod(b, b, m);
+
+			cttk_m31_encode(x, a, mc);
+			cttk_m31_encode(y, b, mc);
+			check(!cttk_bool_to_int(cttk_i31_isnan(x)),
+				"m31 encode (%u,%d)", size, j);
+			cttk_i31_mod(a, a, m);
+			cttk_m31_decode(z, x, mc);
+			check(cttk_bool_to_int(cttk_i31_eq(z, a)),
+				"m31 decode (%u,%d)", size, j);
+
+			cttk_m31_mul(z, x, y, mc);
+			cttk_m31_decode(z, z, mc);
+			ref_mulmod(c, a, b, m, size);
+			check(cttk_bool_to_int(cttk_i31_eq(z, c)),
+				"m31 mul (%u,%d)", size, j);
+
+			cttk_m31_sqr(z, x, mc);
+			cttk_m31_decode(z, z, mc);
+			ref_mulmod(c, a, a, m, size);
+			check(cttk_bool_to_int(cttk_i31_eq(z, c)),
+				"m31 sqr (%u,%d)", size, j);
+
+			cttk_m31_add(z, x, y, mc);
+			cttk_m31_decode(z, z, mc);
+			cttk_i31_sub(c, a, m);
+			cttk_i31_add(c, c, b);
+			cttk_i31_mod(c, c, m);
+			check(cttk_bool_to_int(cttk_i31_eq(z, c)),
+				"m31 add (%u,%d)", size, j);
+
+			cttk_m31_sub(z, x, y, mc);
+			cttk_m31_decode(z, z, mc);
+			cttk_i31_sub(c, a, b);
+			cttk_i31_mod(c, c, m);
+			check(cttk_bool_to_int(cttk_i31_eq(z, c)),
+				"m31 sub (%u,%d)", size, j);
+
+			cttk_m31_neg(z, x, mc);
+			cttk_m31_add(z, z, x, mc);
+			check(cttk_bool_to_int(cttk_i31_eq0(z)),
+				"m31 neg (%u,%d)", size, j);
+
+			/*
+			 * Aliasing: x <- x*x, then x <- x*y.
+			 */
+			cttk_m31_mul(x, x, x, mc);
+			cttk_m31_mul(x, x, y, mc);
+			cttk_m31_decode(x, x, mc);
+			ref_mulmod(c, a, a, m, size);
+			ref_mulmod(c, c, b, m, size);
+			check(cttk_bool_to_int(cttk_i31_eq(x, c)),
+				"m31 alias (%u,%d)", size, j);
+		}
+
+		printf(".");
+		fflush(stdout);
 	}
+
+	printf(" done.\n");
+	fflush(stdout);
 }
 
 static void
-test_i31_set(void)
+test_m31_pow(void)
 {
-	cttk_i31_def(x, 500);
-	int i, j;
-	zint z;
-
-	printf("Test i31 set: ");
+	static const unsigned sizes[] = {
+		3, 31, 32, 62, 100, 255, 521, 1024, 2100
+	};
+	static const unsigned esizes[] = {
+		1, 2, 5, 31, 32, 33, 64, 100, 300
+	};
+	cttk_m31_def(mc, 2100);
+	cttk_i31_def(m, 2100);
+	cttk_i31_def(a, 2100);
+	cttk_i31_def(x, 2100);
+	cttk_i31_def(y, 2100);
+	cttk_i31_def(e, 300);
+	size_t k;
+	int j;
+	unsigned char tmp[300], eb[40];
+
+	printf("Test m31 pow: ");
 	fflush(stdout);
 
-	rnd_init(1);
+	rnd_init(12);
 
-	for (i = 1; i <= 128; i ++) {
-		cttk_i31_init(x, i);
+	for (k = 0; k < (sizeof sizes) / sizeof sizes[0]; k ++) {
+		unsigned size;
+		size_t len;
 
-		for (j = 0; j < 64; j ++) {
-			uint64_t tu64;
-			uint32_t tu32;
+		size = sizes[k];
+		len = (size + 7) >> 3;
+		cttk_i31_init(m, size);
+		cttk_i31_init(a, size);
+		cttk_i31_init(x, size);
+		cttk_i31_init(y, size);
 
-			tu64 = (uint64_t)1 << j;
-			cttk_i31_set_u64(x, tu64);
-			if (j < (i - 1)) {
-				check(cttk_i31_to_u64(x) == tu64,
-					"set_u64 1 (%d,%d)", i, j);
-			} else {
-				check(cttk_i31_to_u64(x) == 0,
-					"set_u64 2 (%d,%d)", i, j);
-			}
-			tu64 = (tu64 << 1) - 1;
-			cttk_i31_set_u64(x, tu64);
-			if (j < (i - 1)) {
-				check(cttk_i31_to_u64(x) == tu64,
-					"set_u64 3 (%d,%d)", i, j);
-			} else {
-				check(cttk_i31_to_u64(x) == 0,
-					"set_u64 4 (%d,%d)", i, j);
-			}
-			cttk_i31_set_u64_trunc(x, tu64);
-			if (j < (i - 1)) {
-				check(cttk_i31_to_u64_trunc(x) == tu64,
-					"set_u64 5 (%d,%d)", i, j);
-			} else {
-				check(cttk_i31_to_u64_trunc(x) == (uint64_t)-1,
-					"set_u64 6 (%d,%d)", i, j);
-			}
+		for (j = 0; j < 18; j ++) {
+			unsigned esize;
+			size_t elen;
+			uint32_t u;
 
-			if (j >= 32) {
-				continue;
+			/*
+			 * Random odd modulus, at least 3.
+			 */
+			rnd(tmp, len);
+			tmp[len - 1] &= 0x7F >> ((len << 3) - size);
+			tmp[0] |= 1;
+			if (size < 8 && tmp[0] == 1) {
+				tmp[0] = 3;
 			}
+			cttk_i31_decle_unsigned(m, tmp, len);
+			cttk_m31_init(mc, m);
+			check(!cttk_bool_to_int(cttk_m31_isnan(mc)),
+				"m31 pow init (%u,%d)", size, j);
+			rnd(tmp, len);
+			cttk_i31_decle_unsigned_trunc(a, tmp, len);
+			cttk_m31_encode(a, a, mc);
 
-			tu32 = (uint32_t)1 << j;
-			cttk_i31_set_u32(x, tu32);
-			if (j < (i - 1)) {
-				check(cttk_i31_to_u32(x) == tu32,
-					"set_u32 1 (%d,%d)", i, j);
-			} else {
-				check(cttk_i31_to_u32(x) == 0,
-					"set_u32 2 (%d,%d)", i, j);
-			}
-			tu32 = (tu32 << 1) - 1;
-			cttk_i31_set_u32(x, tu32);
-			if (j < (i - 1)) {
-				check(cttk_i31_to_u32(x) == tu32,
-					"set_u32 3 (%d,%d)", i, j);
-			} else {
-				check(cttk_i31_to_u32(x) == 0,
-					"set_u32 4 (%d,%d)", i, j);
+			/*
+			 * Random exponent; reference value is computed
+			 * with a square-and-multiply loop.
+			 */
+			esize = esizes[j % ((sizeof esizes) / sizeof esizes[0])];
+			elen = (esize + 7) >> 3;
+			cttk_i31_init(e, esize);
+			rnd(eb, elen);
+			eb[0] &= 0xFF >> ((elen << 3) - (esize - 1));
+			if (j == 3) {
+				memset(eb, 0, elen);
 			}
-			cttk_i31_set_u32_trunc(x, tu32);
-			if (j < (i - 1)) {
-				check(cttk_i31_to_u32_trunc(x) == tu32,
-					"set_u32 5 (%d,%d)", i, j);
-			} else {
-				check(cttk_i31_to_u32_trunc(x) == (uint32_t)-1,
-					"set_u32 6 (%d,%d)", i, j);
+			cttk_i31_decbe_unsigned(e, eb, elen);
+			check(!cttk_bool_to_int(cttk_i31_isnan(e)),
+				"m31 pow e (%u,%d)", size, j);
+
+			cttk_i31_set_u32(y, 1);
+			cttk_m31_encode(y, y, mc);
+			for (u = (uint32_t)(elen << 3); u -- > 0;) {
+				cttk_m31_sqr(y, y, mc);
+				if ((eb[elen - 1 - (u >> 3)] >> (u & 7)) & 1) {
+					cttk_m31_mul(y, y, a, mc);
+				}
 			}
+
+			cttk_m31_pow(x, a, e, mc);
+			check(!cttk_bool_to_int(cttk_i31_isnan(x)),
+				"m31 pow nan (%u,%d)", size, j);
+			check(cttk_bool_to_int(cttk_i31_eq(x, y)),
+				"m31 pow (%u,%d)", size, j);
+			cttk_m31_pow_be(x, a, eb, elen, mc);
+			check(cttk_bool_to_int(cttk_i31_eq(x, y)),
+				"m31 pow_be (%u,%d)", size, j);
+			cttk_m31_pow(a, a, e, mc);
+			check(cttk_bool_to_int(cttk_i31_eq(a, y)),
+				"m31 pow alias (%u,%d)", size, j);
+
+			/*
+			 * Negative exponent yields NaN.
+			 */
+			cttk_i31_set_s32(e, -1);
+			cttk_m31_pow(x, a, e, mc);
+			check(cttk_bool_to_int(cttk_i31_isnan(x)),
+				"m31 pow neg (%u,%d)", size, j);
 		}
 
+		printf(".");
+		fflush(stdout);
+	}
+
+	printf(" done.\n");
+	fflush(stdout);
+}
+
+static void
+test_i31_bool(void)
+{
+	cttk_i31_def(x1, 300);
+	cttk_i31_def(x2, 300);
+	cttk_i31_def(x3, 300);
+	zint z1, z2, z3;
+	int i, j;
+	unsigned char tmp1[100], tmp2[100], tmp3[100], tmp4[100];
+
+	printf("Test i31 bool: ");
+	fflush(stdout);
+
+	rnd_init(9);
+
+	for (i = 1; i <= 128; i ++) {
+		cttk_i31_init(x1, i);
+		cttk_i31_init(x2, i);
+		cttk_i31_init(x3, i);
+
 		for (j = 0; j < 100; j ++) {
-			uint64_t tu64;
-			uint32_t tu32;
-			int64_t ts64;
-			int32_t ts32;
+			rnd(tmp1, 17);
+			rnd(tmp2, 17);
+			zint_decode(&z1, tmp1, 17, 0, 0);
+			zint_decode(&z2, tmp2, 17, 0, 0);
+			zint_trunc(&z1, i);
+			zint_trunc(&z2, i);
+			zint_encode(tmp1, 17, &z1, 0);
+			zint_encode(tmp2, 17, &z2, 0);
+			cttk_i31_decle_signed(x1, tmp1, 17);
+			cttk_i31_decle_signed(x2, tmp2, 17);
 
-			tu64 = rnd64();
-			ts64 = *(int64_t *)&tu64;
-			tu32 = rnd32();
-			ts32 = *(int32_t *)&tu32;
+			zint_and(&z3, &z1, &z2);
+			zint_encode(tmp3, 17, &z3, 0);
+			cttk_i31_and(x3, x1, x2);
+			cttk_i31_encle(tmp4, 17, x3);
+			check(memcmp(tmp3, tmp4, 17) == 0, "and (%d,%d)", i, j);
 
-			cttk_i31_set_u64_trunc(x, tu64);
-			zint_set_u64(&z, tu64);
-			zint_trunc(&z, i);
-			if (i <= 64 && zint_get_s64(&z) < 0) {
-				check(cttk_i31_to_u64(x) == 0,
-					"to_u64 1 (%d,%d)", i, j);
-			} else {
-				check(cttk_i31_to_u64(x) == zint_get_u64(&z),
-					"to_u64 2 (%d,%d)", i, j);
-			}
-			if (i >= 65 && tu64 >= ((uint64_t)1 << 63)) {
-				check(cttk_i31_to_s64(x) == 0,
-					"to_s64 1 (%d,%d)", i, j);
-				check(cttk_i31_to_s64_trunc(x) == ts64,
-					"to_s64_trunc 1 (%d,%d)", i, j);
-				check(cttk_i31_to_u64_trunc(x) == tu64,
-					"to_u64_trunc 1 (%d,%d)", i, j);
-			} else {
-				check(cttk_i31_to_s64(x) == zint_get_s64(&z),
-					"to_s64 2 (%d,%d)", i, j);
-				check(cttk_i31_to_s64_trunc(x)
-					== zint_get_s64(&z),
-					"to_s64_trunc 2 (%d,%d)", i, j);
-				check(cttk_i31_to_u64_trunc(x)
-					== zint_get_u64(&z),
-					"to_u64_trunc 2 (%d,%d)", i, j);
-			}
+			zint_or(&z3, &z1, &z2);
+			zint_encode(tmp3, 17, &z3, 0);
+			cttk_i31_or(x3, x1, x2);
+			cttk_i31_encle(tmp4, 17, x3);
+			check(memcmp(tmp3, tmp4, 17) == 0, "or (%d,%d)", i, j);
+
+			zint_xor(&z3, &z1, &z2);
+			zint_encode(tmp3, 17, &z3, 0);
+			cttk_i31_xor(x3, x1, x2);
+			cttk_i31_encle(tmp4, 17, x3);
+			check(memcmp(tmp3, tmp4, 17) == 0, "xor (%d,%d)", i, j);
 
-			cttk_i31_set_u32_trunc(x, tu32);
-			zint_set_u64(&z, tu32);
-			zint_trunc(&z, i);
-			if (zint_get_s64(&z) < 0) {
-				check(cttk_i31_to_u32(x) == 0,
-					"to_u32 1 (%d,%d)", i, j);
-			} else {
-				check(cttk_i31_to_u32(x) == zint_get_u64(&z),
-					"to_u32 2 (%d,%d)", i, j);
-			}
-			if (i >= 33 && tu32 >= ((uint32_t)1 << 31)) {
-				check(cttk_i31_to_s32(x) == 0,
-					"to_s32 1 (%d,%d)", i, j);
-				check(cttk_i31_to_s32_trunc(x) == ts32,
-					"to_s32_trunc 1 (%d,%d)", i, j);
-				check(cttk_i31_to_u32_trunc(x) == tu32,
-					"to_u32_trunc 1 (%d,%d)", i, j);
-			} else {
-				check(cttk_i31_to_s32(x) == zint_get_s64(&z),
-					"to_s32 2 (%d,%d)", i, j);
-				check(cttk_i31_to_s32_trunc(x)
-					== zint_get_s64(&z),
-					"to_s32_trunc 2 (%d,%d)", i, j);
-				check(cttk_i31_to_u32_trunc(x)
-					== (uint32_t)zint_get_u64(&z),
-					"to_u32_trunc 2 (%d,%d)", i, j);
-			}
+			zint_eqv(&z3, &z1, &z2);
+			zint_encode(tmp3, 17, &z3, 0);
+			cttk_i31_eqv(x3, x1, x2);
+			cttk_i31_encle(tmp4, 17, x3);
+			check(memcmp(tmp3, tmp4, 17) == 0, "eqv (%d,%d)", i, j);
+
+			zint_not(&z3, &z1);
+			zint_encode(tmp3, 17, &z3, 0);
+			cttk_i31_not(x3, x1);
+			cttk_i31_encle(tmp4, 17, x3);
+			check(memcmp(tmp3, tmp4, 17) == 0, "not (%d,%d)", i, j);
 		}
 
-		if ((i & 7) == 0) {
+		if ((i & 3) == 0) {
 			printf(".");
 			fflush(stdout);
 		}
 	}
 
-	printf(" ");
+	printf(" done.\n");
 	fflush(stdout);
+}
 
-	for (i = 1; i <= 80; i ++) {
-		for (j = 1; j <= 80; j ++) {
-			int k;
+/*
+ * Fill buf (len bytes, little-endian) with a test value for an integer
+ * of the provided size (in bits). Special values (0, -1, MinValue,
+ * MaxValue, small values) are produced with some probability; otherwise,
+ * the value is random. The buffer is meant to be decoded with a
+ * truncating signed decoding function.
+ */
+static void
+rnd_special(unsigned char *buf, size_t len, unsigned size)
+{
+	unsigned k;
 
-			for (k = 0; k < 10; k ++) {
-				unsigned char tmp[17], tmp2[17];
-				cttk_i31_def(x, 100);
-				cttk_i31_def(y, 100);
+	k = rnd32() & 15;
+	switch (k) {
+	case 0:
+		memset(buf, 0, len);
+		break;
+	case 1:
+		memset(buf, 0xFF, len);
+		break;
+	case 2:
+		memset(buf, 0, len);
+		buf[(size - 1) >> 3] |= 1 << ((size - 1) & 7);
+		break;
+	case 3:
+		memset(buf, 0xFF, len);
+		memset(buf + (size >> 3), 0, len - (size >> 3));
+		if ((size & 7) != 0) {
+			buf[size >> 3] = (1 << (size & 7)) - 1;
+		}
+		buf[(size - 1) >> 3] &= ~(1 << ((size - 1) & 7));
+		break;
+	case 4:
+		memset(buf, 0, len);
+		buf[0] = rnd32();
+		break;
+	case 5:
+		memset(buf, 0xFF, len);
+		buf[0] = rnd32();
+		break;
+	default:
+		rnd(buf, len);
+		if (k == 6) {
+			buf[rnd32() % len] = 0;
+		}
+		break;
+	}
+}
 
-				cttk_i31_init(x, i);
-				cttk_i31_init(y, j);
-				rnd(tmp, 17);
-				zint_decode(&z, tmp, 17, 0, 0);
-				zint_trunc(&z, i);
-				zint_encode(tmp, 17, &z, 0);
-				cttk_i31_decle_signed(x, tmp, 17);
+/*
+ * Check that an i63 and an i31 integer have the same NaN status and
+ * (if not NaN) the same value.
+ */
+static void
+check_i63(const uint64_t *x, const uint32_t *y, size_t len,
+	const char *name, unsigned size, int j)
+{
+	unsigned char tmp1[1100], tmp2[1100];
 
-				cttk_i31_set(y, x);
-				if (zint_bitlength(&z) >= (unsigned)j) {
-					check(cttk_i31_isnan(y).v,
-						"set 1 (%d,%d,%d)", i, j, k);
-				} else {
-					check(!cttk_i31_isnan(y).v,
-						"set 2 (%d,%d,%d)", i, j, k);
-					cttk_i31_encle(tmp2, 17, y);
-					check(memcmp(tmp, tmp2, 17) == 0,
-						"set 3 (%d,%d,%d)", i, j, k);
-				}
+	check(cttk_bool_to_int(cttk_i63_isnan(x))
+		== cttk_bool_to_int(cttk_i31_isnan(y)),
+		"%s NaN (%u,%d)", name, size, j);
+	if (cttk_bool_to_int(cttk_i31_isnan(y))) {
+		return;
+	}
+	cttk_i63_encle(tmp1, len, x);
+	cttk_i31_encle(tmp2, len, y);
+	check(memcmp(tmp1, tmp2, len) == 0, "%s (%u,%d)", name, size, j);
+}
 
-				cttk_i31_set_trunc(y, x);
-				cttk_i31_encle(tmp2, 17, y);
-				zint_trunc(&z, j);
-				zint_encode(tmp, 17, &z, 0);
-				check(!cttk_i31_isnan(y).v,
-					"set 4 (%d,%d,%d)", i, j, k);
-				check(memcmp(tmp, tmp2, 17) == 0,
-					"set 5 (%d,%d,%d)", i, j, k);
+static void
+test_i63(void)
+{
+	static const unsigned large[] = {
+		189, 252, 441, 503, 504, 521, 1024, 2048, 3000, 4100
+	};
+	cttk_i63_def(a, 4100);
+	cttk_i63_def(b, 4100);
+	cttk_i63_def(c, 4100);
+	cttk_i63_def(d, 4100);
+	cttk_i31_def(x, 4100);
+	cttk_i31_def(y, 4100);
+	cttk_i31_def(z, 4100);
+	cttk_i31_def(t, 4100);
+	unsigned char tmp1[520], tmp2[520], tmp3[520], tmp4[520];
+	uint64_t *ws;
+	size_t ws_len;
+	int i, j;
+
+	printf("Test i63: ");
+	fflush(stdout);
+
+	rnd_init(11);
+	ws = malloc(cttk_i63_ws_len(4100) * sizeof *ws);
+	check(ws != NULL, "malloc");
+
+	/*
+	 * Mismatched sizes yield NaN.
+	 */
+	cttk_i63_init(a, 100);
+	cttk_i63_init(b, 101);
+	cttk_i63_init(c, 100);
+	cttk_i63_set_u32(a, 5);
+	cttk_i63_set_u32(b, 7);
+	cttk_i63_add(c, a, b);
+	check(cttk_bool_to_int(cttk_i63_isnan(c)), "size mismatch");
+	cttk_i63_init(c, 100);
+	cttk_i63_mul(c, a, b);
+	check(cttk_bool_to_int(cttk_i63_isnan(c)), "size mismatch");
+
+	for (i = 1; i <= (int)(140 + (sizeof large) / sizeof large[0]); i ++) {
+		unsigned size;
+		size_t len;
+
+		size = i <= 140 ? (unsigned)i : large[i - 141];
+		len = (size + 15) >> 3;
+		ws_len = cttk_i63_ws_len(size);
+		cttk_i63_init(a, size);
+		cttk_i63_init(b, size);
+		cttk_i63_init(c, size);
+		cttk_i63_init(d, size);
+		cttk_i31_init(x, size);
+		cttk_i31_init(y, size);
+		cttk_i31_init(z, size);
+		cttk_i31_init(t, size);
+
+		for (j = 0; j < (i <= 140 ? 40 : 10); j ++) {
+			uint64_t v;
+			uint32_t n;
+
+			/*
+			 * Setters and getters.
+			 */
+			v = rnd64() >> (rnd32() & 63);
+			cttk_i63_set_u64(a, v);
+			cttk_i31_set_u64(x, v);
+			check_i63(a, x, len, "set_u64", size, j);
+			check(cttk_i63_to_u64(a) == cttk_i31_to_u64(x),
+				"to_u64 (%u,%d)", size, j);
+			check(cttk_i63_to_s64(a) == cttk_i31_to_s64(x),
+				"to_s64 (%u,%d)", size, j);
+			check(cttk_i63_to_u32(a) == cttk_i31_to_u32(x),
+				"to_u32 (%u,%d)", size, j);
+			check(cttk_i63_to_s32(a) == cttk_i31_to_s32(x),
+				"to_s32 (%u,%d)", size, j);
+			cttk_i63_set_s64(a, (int64_t)v);
+			cttk_i31_set_s64(x, (int64_t)v);
+			check_i63(a, x, len, "set_s64", size, j);
+			cttk_i63_set_u64_trunc(a, v);
+			cttk_i31_set_u64_trunc(x, v);
+			check_i63(a, x, len, "set_u64_trunc", size, j);
+			check(cttk_i63_to_u64_trunc(a)
+				== cttk_i31_to_u64_trunc(x),
+				"to_u64_trunc (%u,%d)", size, j);
+			check(cttk_i63_to_s32_trunc(a)
+				== cttk_i31_to_s32_trunc(x),
+				"to_s32_trunc (%u,%d)", size, j);
+			cttk_i63_set_s32(a, (int32_t)v);
+			cttk_i31_set_s32(x, (int32_t)v);
+			check_i63(a, x, len, "set_s32", size, j);
+			cttk_i63_set_u32_trunc(a, (uint32_t)v);
+			cttk_i31_set_u32_trunc(x, (uint32_t)v);
+			check_i63(a, x, len, "set_u32_trunc", size, j);
+
+			/*
+			 * Decoding (with possible overflows) and encoding.
+			 */
+			rnd_special(tmp1, len, size);
+			cttk_i63_decle_signed(a, tmp1, len);
+			cttk_i31_decle_signed(x, tmp1, len);
+			check_i63(a, x, len, "decle_signed", size, j);
+			cttk_i63_decbe_unsigned(a, tmp1, (size + 7) >> 3);
+			cttk_i31_decbe_unsigned(x, tmp1, (size + 7) >> 3);
+			check_i63(a, x, len, "decbe_unsigned", size, j);
+			cttk_i63_decbe_signed_trunc(a, tmp1, len);
+			cttk_i31_decbe_signed_trunc(x, tmp1, len);
+			check_i63(a, x, len, "decbe_signed_trunc", size, j);
+			cttk_i63_encbe(tmp3, len, a);
+			cttk_i31_encbe(tmp4, len, x);
+			check(memcmp(tmp3, tmp4, len) == 0,
+				"encbe (%u,%d)", size, j);
+
+			/*
+			 * Operands for the arithmetic operations.
+			 */
+			rnd_special(tmp1, len, size);
+			rnd_special(tmp2, len, size);
+			cttk_i63_decle_signed_trunc(a, tmp1, len);
+			cttk_i63_decle_signed_trunc(b, tmp2, len);
+			cttk_i31_decle_signed_trunc(x, tmp1, len);
+			cttk_i31_decle_signed_trunc(y, tmp2, len);
+			check_i63(a, x, len, "decle_signed_trunc", size, j);
+			check_i63(b, y, len, "decle_signed_trunc", size, j);
+
+			check(cttk_i63_cmp(a, b) == cttk_i31_cmp(x, y),
+				"cmp (%u,%d)", size, j);
+			check(cttk_i63_sign(a) == cttk_i31_sign(x),
+				"sign (%u,%d)", size, j);
+			check(cttk_bool_to_int(cttk_i63_eq(a, b))
+				== cttk_bool_to_int(cttk_i31_eq(x, y)),
+				"eq (%u,%d)", size, j);
+			check(cttk_bool_to_int(cttk_i63_leq(a, b))
+				== cttk_bool_to_int(cttk_i31_leq(x, y)),
+				"leq (%u,%d)", size, j);
+			check(cttk_bool_to_int(cttk_i63_gt0(a))
+				== cttk_bool_to_int(cttk_i31_gt0(x)),
+				"gt0 (%u,%d)", size, j);
+
+			cttk_i63_add(c, a, b);
+			cttk_i31_add(z, x, y);
+			check_i63(c, z, len, "add", size, j);
+			cttk_i63_add_trunc(c, a, b);
+			cttk_i31_add_trunc(z, x, y);
+			check_i63(c, z, len, "add_trunc", size, j);
+			cttk_i63_sub(c, a, b);
+			cttk_i31_sub(z, x, y);
+			check_i63(c, z, len, "sub", size, j);
+			cttk_i63_sub_trunc(c, a, b);
+			cttk_i31_sub_trunc(z, x, y);
+			check_i63(c, z, len, "sub_trunc", size, j);
+			cttk_i63_neg(c, a);
+			cttk_i31_neg(z, x);
+			check_i63(c, z, len, "neg", size, j);
+			cttk_i63_neg_trunc(c, a);
+			cttk_i31_neg_trunc(z, x);
+			check_i63(c, z, len, "neg_trunc", size, j);
+
+			cttk_i63_mul(c, a, b);
+			cttk_i31_mul(z, x, y);
+			check_i63(c, z, len, "mul", size, j);
+			cttk_i63_mul_ws(c, a, b, ws, ws_len);
+			check_i63(c, z, len, "mul_ws", size, j);
+			cttk_i63_mul_trunc(c, a, b);
+			cttk_i31_mul_trunc(z, x, y);
+			check_i63(c, z, len, "mul_trunc", size, j);
+			cttk_i63_copy(c, a);
+			cttk_i31_copy(z, x);
+			cttk_i63_mul_trunc(c, c, c);
+			cttk_i31_mul_trunc(z, z, z);
+			check_i63(c, z, len, "mul_trunc", size, j);
+			cttk_i63_sqr_trunc(c, a);
+			check_i63(c, z, len, "sqr_trunc", size, j);
+			cttk_i63_rsh(c, a, size >> 1);
+			cttk_i31_rsh(z, x, size >> 1);
+			cttk_i63_sqr(c, c);
+			cttk_i31_mul(z, z, z);
+			check_i63(c, z, len, "sqr", size, j);
+			cttk_i63_muladd(c, c, b, a);
+			cttk_i31_muladd(z, z, y, x);
+			check_i63(c, z, len, "muladd", size, j);
+			cttk_i63_muladd_trunc(c, a, b, a);
+			cttk_i31_muladd_trunc(z, x, y, x);
+			check_i63(c, z, len, "muladd_trunc", size, j);
+
+			n = rnd32() >> (j & 31);
+			cttk_i63_mul_u32(c, a, n);
+			cttk_i31_mul_u32(z, x, n);
+			check_i63(c, z, len, "mul_u32", size, j);
+			cttk_i63_mul_u32_trunc(c, a, n);
+			cttk_i31_mul_u32_trunc(z, x, n);
+			check_i63(c, z, len, "mul_u32_trunc", size, j);
+			cttk_i63_rsh(c, b, 32);
+			cttk_i31_rsh(z, y, 32);
+			cttk_i63_addmul_u32(c, a, n);
+			cttk_i31_addmul_u32(z, x, n);
+			check_i63(c, z, len, "addmul_u32", size, j);
+			cttk_i63_copy(c, b);
+			cttk_i31_copy(z, y);
+			cttk_i63_addmul_u32_trunc(c, a, n);
+			cttk_i31_addmul_u32_trunc(z, x, n);
+			check_i63(c, z, len, "addmul_u32_trunc", size, j);
+
+			n = rnd32() % (size + 70);
+			cttk_i63_lsh(c, a, n);
+			cttk_i31_lsh(z, x, n);
+			check_i63(c, z, len, "lsh", size, j);
+			cttk_i63_lsh_prot(c, a, n);
+			check_i63(c, z, len, "lsh_prot", size, j);
+			cttk_i63_lsh_trunc(c, a, n);
+			cttk_i31_lsh_trunc(z, x, n);
+			check_i63(c, z, len, "lsh_trunc", size, j);
+			cttk_i63_lsh_trunc_prot(c, a, n);
+			check_i63(c, z, len, "lsh_trunc_prot", size, j);
+			cttk_i63_rsh(c, a, n);
+			cttk_i31_rsh(z, x, n);
+			check_i63(c, z, len, "rsh", size, j);
+			cttk_i63_rsh_prot(c, a, n);
+			check_i63(c, z, len, "rsh_prot", size, j);
+
+			if ((j & 1) == 1) {
+				/*
+				 * Use a shorter divisor half of the time.
+				 */
+				n = rnd32() % size;
+				cttk_i63_rsh(b, b, n);
+				cttk_i31_rsh(y, y, n);
 			}
+			cttk_i63_divrem(c, d, a, b);
+			cttk_i31_divrem(z, t, x, y);
+			check_i63(c, z, len, "div", size, j);
+			check_i63(d, t, len, "rem", size, j);
+			cttk_i63_divrem_ws(c, d, a, b, ws, ws_len);
+			check_i63(c, z, len, "div_ws", size, j);
+			check_i63(d, t, len, "rem_ws", size, j);
+			cttk_i63_mod(c, a, b);
+			cttk_i31_mod(z, x, y);
+			check_i63(c, z, len, "mod", size, j);
+			cttk_i63_mod_ws(c, a, b, ws, ws_len);
+			check_i63(c, z, len, "mod_ws", size, j);
+
+			cttk_i63_and(c, a, b);
+			cttk_i31_and(z, x, y);
+			check_i63(c, z, len, "and", size, j);
+			cttk_i63_or(c, a, b);
+			cttk_i31_or(z, x, y);
+			check_i63(c, z, len, "or", size, j);
+			cttk_i63_xor(c, a, b);
+			cttk_i31_xor(z, x, y);
+			check_i63(c, z, len, "xor", size, j);
+			cttk_i63_eqv(c, a, b);
+			cttk_i31_eqv(z, x, y);
+			check_i63(c, z, len, "eqv", size, j);
+			cttk_i63_not(c, a);
+			cttk_i31_not(z, x);
+			check_i63(c, z, len, "not", size, j);
+
+			/*
+			 * NaN propagation.
+			 */
+			cttk_i63_cond_swap(cttk_bool_of_u32(j & 1), a, b);
+			cttk_i31_cond_swap(cttk_bool_of_u32(j & 1), x, y);
+			check_i63(a, x, len, "cond_swap", size, j);
+			cttk_i63_mux(cttk_bool_of_u32((j >> 1) & 1), c, a, b);
+			cttk_i31_mux(cttk_bool_of_u32((j >> 1) & 1), z, x, y);
+			check_i63(c, z, len, "mux", size, j);
+			cttk_i63_set_s32(b, 0);
+			cttk_i63_divrem(c, d, a, b);
+			check(cttk_bool_to_int(cttk_i63_isnan(c))
+				&& cttk_bool_to_int(cttk_i63_isnan(d)),
+				"div by zero (%u,%d)", size, j);
+			cttk_i63_add(c, c, a);
+			check(cttk_bool_to_int(cttk_i63_isnan(c)),
+				"NaN propagation (%u,%d)", size, j);
+			cttk_i63_init(c, size);
+			cttk_i63_init(d, size);
+			cttk_i31_init(z, size);
+			cttk_i31_init(t, size);
 		}
 
-		if ((i & 3) == 0) {
+		if ((i & 7) == 0) {
 			printf(".");
 			fflush(stdout);
 		}
 	}
 
+	free(ws);
 	printf(" done.\n");
 	fflush(stdout);
 }
 
-static int
-memiszero(const void *data, size_t len)
+/*
+ * Check that an i15 and an i31 integer have the same NaN status and
+ * (if not NaN) the same value.
+ */
+static void
+check_i15(const uint16_t *x, const uint32_t *y, size_t len,
+	const char *name, unsigned size, int j)
 {
-	unsigned x;
-	const unsigned char *buf;
+	unsigned char tmp1[1100], tmp2[1100];
 
-	buf = data;
-	x = 0;
-	while (len -- > 0) {
-		x |= *buf ++;
+	check(cttk_bool_to_int(cttk_i15_isnan(x))
+		== cttk_bool_to_int(cttk_i31_isnan(y)),
+		"%s NaN (%u,%d)", name, size, j);
+	if (cttk_bool_to_int(cttk_i31_isnan(y))) {
+		return;
 	}
-	return x == 0;
+	cttk_i15_encle(tmp1, len, x);
+	cttk_i31_encle(tmp2, len, y);
+	check(memcmp(tmp1, tmp2, len) == 0, "%s (%u,%d)", name, size, j);
 }
 
 static void
-test_i31_codec(void)
+test_i15(void)
 {
-	cttk_i31_def(x, 300);
-	zint z;
-	int i, j, be;
-	unsigned char tmp1[100], tmp2[100];
+	static const unsigned large[] = {
+		189, 252, 441, 503, 504, 521, 1024, 2048, 3000, 4100
+	};
+	cttk_i15_def(a, 4100);
+	cttk_i15_def(b, 4100);
+	cttk_i15_def(c, 4100);
+	cttk_i15_def(d, 4100);
+	cttk_i31_def(x, 4100);
+	cttk_i31_def(y, 4100);
+	cttk_i31_def(z, 4100);
+	cttk_i31_def(t, 4100);
+	unsigned char tmp1[520], tmp2[520], tmp3[520], tmp4[520];
+	uint16_t *ws;
+	size_t ws_len;
+	int i, j;
 
-	printf("Test i31 codec: ");
+	printf("Test i15: ");
 	fflush(stdout);
 
-	rnd_init(3);
+	rnd_init(17);
+	ws = malloc(cttk_i15_ws_len(4100) * sizeof *ws);
+	check(ws != NULL, "malloc");
 
-	for (be = 0; be < 2; be ++) {
-		for (i = 1; i <= 128; i ++) {
-			cttk_i31_init(x, i);
+	/*
+	 * Mismatched sizes yield NaN.
+	 */
+	cttk_i15_init(a, 100);
+	cttk_i15_init(b, 101);
+	cttk_i15_init(c, 100);
+	cttk_i15_set_u32(a, 5);
+	cttk_i15_set_u32(b, 7);
+	cttk_i15_add(c, a, b);
+	check(cttk_bool_to_int(cttk_i15_isnan(c)), "size mismatch");
+	cttk_i15_init(c, 100);
+	cttk_i15_mul(c, a, b);
+	check(cttk_bool_to_int(cttk_i15_isnan(c)), "size mismatch");
+
+	for (i = 1; i <= (int)(140 + (sizeof large) / sizeof large[0]); i ++) {
+		unsigned size;
+		size_t len;
 
-			for (j = 0; j < 100; j ++) {
-				rnd(tmp1, 17);
-				zint_decode(&z, tmp1, 17, be, 0);
-				zint_trunc(&z, i + 2);
-				zint_encode(tmp1, 17, &z, be);
+		size = i <= 140 ? (unsigned)i : large[i - 141];
+		len = (size + 15) >> 3;
+		ws_len = cttk_i15_ws_len(size);
+		cttk_i15_init(a, size);
+		cttk_i15_init(b, size);
+		cttk_i15_init(c, size);
+		cttk_i15_init(d, size);
+		cttk_i31_init(x, size);
+		cttk_i31_init(y, size);
+		cttk_i31_init(z, size);
+		cttk_i31_init(t, size);
+
+		for (j = 0; j < (i <= 140 ? 40 : 10); j ++) {
+			uint64_t v;
+			uint32_t n;
 
-				if (be) {
-					cttk_i31_decbe_signed(x, tmp1, 17);
-					cttk_i31_encbe(tmp2, 17, x);
-				} else {
-					cttk_i31_decle_signed(x, tmp1, 17);
-					cttk_i31_encle(tmp2, 17, x);
-				}
-				if (zint_bitlength(&z) < (unsigned)i) {
-					check(memcmp(tmp2, tmp1, 17) == 0,
-						"codec 1 (%d,%d,%d)", be, i, j);
-				} else {
-					check(cttk_bool_to_int(
-						cttk_i31_isnan(x)),
-						"codec 2 (%d,%d,%d)", be, i, j);
-					check(memiszero(tmp2, 17),
-						"codec 3 (%d,%d,%d)", be, i, j);
-				}
-				if (be) {
-					cttk_i31_decbe_unsigned(x, tmp1, 17);
-					cttk_i31_encbe(tmp2, 17, x);
-				} else {
-					cttk_i31_decle_unsigned(x, tmp1, 17);
-					cttk_i31_encle(tmp2, 17, x);
-				}
-				if (zint_bitlength(&z) < (unsigned)i
-					&& z.v[31] < 0x8000)
-				{
-					check(memcmp(tmp2, tmp1, 17) == 0,
-						"codec 4 (%d,%d,%d)", be, i, j);
-				} else {
-					check(cttk_bool_to_int(
-						cttk_i31_isnan(x)),
-						"codec 5 (%d,%d,%d)", be, i, j);
-					check(memiszero(tmp2, 17),
-						"codec 6 (%d,%d,%d)", be, i, j);
-				}
+			/*
+			 * Setters and getters.
+			 */
+			v = rnd64() >> (rnd32() & 63);
+			cttk_i15_set_u64(a, v);
+			cttk_i31_set_u64(x, v);
+			check_i15(a, x, len, "set_u64", size, j);
+			check(cttk_i15_to_u64(a) == cttk_i31_to_u64(x),
+				"to_u64 (%u,%d)", size, j);
+			check(cttk_i15_to_s64(a) == cttk_i31_to_s64(x),
+				"to_s64 (%u,%d)", size, j);
+			check(cttk_i15_to_u32(a) == cttk_i31_to_u32(x),
+				"to_u32 (%u,%d)", size, j);
+			check(cttk_i15_to_s32(a) == cttk_i31_to_s32(x),
+				"to_s32 (%u,%d)", size, j);
+			cttk_i15_set_s64(a, (int64_t)v);
+			cttk_i31_set_s64(x, (int64_t)v);
+			check_i15(a, x, len, "set_s64", size, j);
+			cttk_i15_set_u64_trunc(a, v);
+			cttk_i31_set_u64_trunc(x, v);
+			check_i15(a, x, len, "set_u64_trunc", size, j);
+			check(cttk_i15_to_u64_trunc(a)
+				== cttk_i31_to_u64_trunc(x),
+				"to_u64_trunc (%u,%d)", size, j);
+			check(cttk_i15_to_s32_trunc(a)
+				== cttk_i31_to_s32_trunc(x),
+				"to_s32_trunc (%u,%d)", size, j);
+			cttk_i15_set_s32(a, (int32_t)v);
+			cttk_i31_set_s32(x, (int32_t)v);
+			check_i15(a, x, len, "set_s32", size, j);
+			cttk_i15_set_u32_trunc(a, (uint32_t)v);
+			cttk_i31_set_u32_trunc(x, (uint32_t)v);
+			check_i15(a, x, len, "set_u32_trunc", size, j);
 
-				rnd(tmp1, 17);
-				if (be) {
-					cttk_i31_decbe_signed_trunc(
-						x, tmp1, 17);
-					cttk_i31_encbe(tmp2, 17, x);
-				} else {
-					cttk_i31_decle_signed_trunc(
-						x, tmp1, 17);
-					cttk_i31_encle(tmp2, 17, x);
-				}
-				zint_decode(&z, tmp1, 17, be, 0);
-				zint_trunc(&z, i);
-				zint_encode(tmp1, 17, &z, be);
-				check(memcmp(tmp1, tmp2, 17) == 0,
-					"codec 7 (%d,%d,%d)", be, i, j);
+			/*
+			 * Decoding (with possible overflows) and encoding.
+			 */
+			rnd_special(tmp1, len, size);
+			cttk_i15_decle_signed(a, tmp1, len);
+			cttk_i31_decle_signed(x, tmp1, len);
+			check_i15(a, x, len, "decle_signed", size, j);
+			cttk_i15_decbe_unsigned(a, tmp1, (size + 7) >> 3);
+			cttk_i31_decbe_unsigned(x, tmp1, (size + 7) >> 3);
+			check_i15(a, x, len, "decbe_unsigned", size, j);
+			cttk_i15_decbe_signed_trunc(a, tmp1, len);
+			cttk_i31_decbe_signed_trunc(x, tmp1, len);
+			check_i15(a, x, len, "decbe_signed_trunc", size, j);
+			cttk_i15_encbe(tmp3, len, a);
+			cttk_i31_encbe(tmp4, len, x);
+			check(memcmp(tmp3, tmp4, len) == 0,
+				"encbe (%u,%d)", size, j);
 
-				rnd(tmp1, 8);
-				if (be) {
-					cttk_i31_decbe_unsigned_trunc(
-						x, tmp1, 8);
-					cttk_i31_encbe(tmp2, 17, x);
-				} else {
-					cttk_i31_decle_unsigned_trunc(
-						x, tmp1, 8);
-					cttk_i31_encle(tmp2, 17, x);
-				}
-				zint_decode(&z, tmp1, 8, be, 0);
-				zint_trunc(&z, i);
-				zint_encode(tmp1, 17, &z, be);
-				check(memcmp(tmp1, tmp2, 17) == 0,
-					"codec 8 (%d,%d,%d)", be, i, j);
+			/*
+			 * Operands for the arithmetic operations.
+			 */
+			rnd_special(tmp1, len, size);
+			rnd_special(tmp2, len, size);
+			cttk_i15_decle_signed_trunc(a, tmp1, len);
+			cttk_i15_decle_signed_trunc(b, tmp2, len);
+			cttk_i31_decle_signed_trunc(x, tmp1, len);
+			cttk_i31_decle_signed_trunc(y, tmp2, len);
+			check_i15(a, x, len, "decle_signed_trunc", size, j);
+			check_i15(b, y, len, "decle_signed_trunc", size, j);
+
+			check(cttk_i15_cmp(a, b) == cttk_i31_cmp(x, y),
+				"cmp (%u,%d)", size, j);
+			check(cttk_i15_sign(a) == cttk_i31_sign(x),
+				"sign (%u,%d)", size, j);
+			check(cttk_bool_to_int(cttk_i15_eq(a, b))
+				== cttk_bool_to_int(cttk_i31_eq(x, y)),
+				"eq (%u,%d)", size, j);
+			check(cttk_bool_to_int(cttk_i15_leq(a, b))
+				== cttk_bool_to_int(cttk_i31_leq(x, y)),
+				"leq (%u,%d)", size, j);
+			check(cttk_bool_to_int(cttk_i15_gt0(a))
+				== cttk_bool_to_int(cttk_i31_gt0(x)),
+				"gt0 (%u,%d)", size, j);
+
+			cttk_i15_add(c, a, b);
+			cttk_i31_add(z, x, y);
+			check_i15(c, z, len, "add", size, j);
+			cttk_i15_add_trunc(c, a, b);
+			cttk_i31_add_trunc(z, x, y);
+			check_i15(c, z, len, "add_trunc", size, j);
+			cttk_i15_sub(c, a, b);
+			cttk_i31_sub(z, x, y);
+			check_i15(c, z, len, "sub", size, j);
+			cttk_i15_sub_trunc(c, a, b);
+			cttk_i31_sub_trunc(z, x, y);
+			check_i15(c, z, len, "sub_trunc", size, j);
+			cttk_i15_neg(c, a);
+			cttk_i31_neg(z, x);
+			check_i15(c, z, len, "neg", size, j);
+			cttk_i15_neg_trunc(c, a);
+			cttk_i31_neg_trunc(z, x);
+			check_i15(c, z, len, "neg_trunc", size, j);
+
+			cttk_i15_mul(c, a, b);
+			cttk_i31_mul(z, x, y);
+			check_i15(c, z, len, "mul", size, j);
+			cttk_i15_mul_ws(c, a, b, ws, ws_len);
+			check_i15(c, z, len, "mul_ws", size, j);
+			cttk_i15_mul_trunc(c, a, b);
+			cttk_i31_mul_trunc(z, x, y);
+			check_i15(c, z, len, "mul_trunc", size, j);
+			cttk_i15_copy(c, a);
+			cttk_i31_copy(z, x);
+			cttk_i15_mul_trunc(c, c, c);
+			cttk_i31_mul_trunc(z, z, z);
+			check_i15(c, z, len, "mul_trunc", size, j);
+			cttk_i15_sqr_trunc(c, a);
+			check_i15(c, z, len, "sqr_trunc", size, j);
+			cttk_i15_rsh(c, a, size >> 1);
+			cttk_i31_rsh(z, x, size >> 1);
+			cttk_i15_sqr(c, c);
+			cttk_i31_mul(z, z, z);
+			check_i15(c, z, len, "sqr", size, j);
+			cttk_i15_muladd(c, c, b, a);
+			cttk_i31_muladd(z, z, y, x);
+			check_i15(c, z, len, "muladd", size, j);
+			cttk_i15_muladd_trunc(c, a, b, a);
+			cttk_i31_muladd_trunc(z, x, y, x);
+			check_i15(c, z, len, "muladd_trunc", size, j);
+
+			n = rnd32() >> (j & 31);
+			cttk_i15_mul_u32(c, a, n);
+			cttk_i31_mul_u32(z, x, n);
+			check_i15(c, z, len, "mul_u32", size, j);
+			cttk_i15_mul_u32_trunc(c, a, n);
+			cttk_i31_mul_u32_trunc(z, x, n);
+			check_i15(c, z, len, "mul_u32_trunc", size, j);
+			cttk_i15_rsh(c, b, 32);
+			cttk_i31_rsh(z, y, 32);
+			cttk_i15_addmul_u32(c, a, n);
+			cttk_i31_addmul_u32(z, x, n);
+			check_i15(c, z, len, "addmul_u32", size, j);
+			cttk_i15_copy(c, b);
+			cttk_i31_copy(z, y);
+			cttk_i15_addmul_u32_trunc(c, a, n);
+			cttk_i31_addmul_u32_trunc(z, x, n);
+			check_i15(c, z, len, "addmul_u32_trunc", size, j);
+
+			n = rnd32() % (size + 70);
+			cttk_i15_lsh(c, a, n);
+			cttk_i31_lsh(z, x, n);
+			check_i15(c, z, len, "lsh", size, j);
+			cttk_i15_lsh_prot(c, a, n);
+			check_i15(c, z, len, "lsh_prot", size, j);
+			cttk_i15_lsh_trunc(c, a, n);
+			cttk_i31_lsh_trunc(z, x, n);
+			check_i15(c, z, len, "lsh_trunc", size, j);
+			cttk_i15_lsh_trunc_prot(c, a, n);
+			check_i15(c, z, len, "lsh_trunc_prot", size, j);
+			cttk_i15_rsh(c, a, n);
+			cttk_i31_rsh(z, x, n);
+			check_i15(c, z, len, "rsh", size, j);
+			cttk_i15_rsh_prot(c, a, n);
+			check_i15(c, z, len, "rsh_prot", size, j);
+
+			if ((j & 1) == 1) {
+				/*
+				 * Use a shorter divisor half of the time.
+				 */
+				n = rnd32() % size;
+				cttk_i15_rsh(b, b, n);
+				cttk_i31_rsh(y, y, n);
 			}
+			cttk_i15_divrem(c, d, a, b);
+			cttk_i31_divrem(z, t, x, y);
+			check_i15(c, z, len, "div", size, j);
+			check_i15(d, t, len, "rem", size, j);
+			cttk_i15_divrem_ws(c, d, a, b, ws, ws_len);
+			check_i15(c, z, len, "div_ws", size, j);
+			check_i15(d, t, len, "rem_ws", size, j);
+			cttk_i15_mod(c, a, b);
+			cttk_i31_mod(z, x, y);
+			check_i15(c, z, len, "mod", size, j);
+			cttk_i15_mod_ws(c, a, b, ws, ws_len);
+			check_i15(c, z, len, "mod_ws", size, j);
+
+			cttk_i15_and(c, a, b);
+			cttk_i31_and(z, x, y);
+			check_i15(c, z, len, "and", size, j);
+			cttk_i15_or(c, a, b);
+			cttk_i31_or(z, x, y);
+			check_i15(c, z, len, "or", size, j);
+			cttk_i15_xor(c, a, b);
+			cttk_i31_xor(z, x, y);
+			check_i15(c, z, len, "xor", size, j);
+			cttk_i15_eqv(c, a, b);
+			cttk_i31_eqv(z, x, y);
+			check_i15(c, z, len, "eqv", size, j);
+			cttk_i15_not(c, a);
+			cttk_i31_not(z, x);
+			check_i15(c, z, len, "not", size, j);
+
+			/*
+			 * NaN propagation.
+			 */
+			cttk_i15_cond_swap(cttk_bool_of_u32(j & 1), a, b);
+			cttk_i31_cond_swap(cttk_bool_of_u32(j & 1), x, y);
+			check_i15(a, x, len, "cond_swap", size, j);
+			cttk_i15_mux(cttk_bool_of_u32((j >> 1) & 1), c, a, b);
+			cttk_i31_mux(cttk_bool_of_u32((j >> 1) & 1), z, x, y);
+			check_i15(c, z, len, "mux", size, j);
+			cttk_i15_set_s32(b, 0);
+			cttk_i15_divrem(c, d, a, b);
+			check(cttk_bool_to_int(cttk_i15_isnan(c))
+				&& cttk_bool_to_int(cttk_i15_isnan(d)),
+				"div by zero (%u,%d)", size, j);
+			cttk_i15_add(c, c, a);
+			check(cttk_bool_to_int(cttk_i15_isnan(c)),
+				"NaN propagation (%u,%d)", size, j);
+			cttk_i15_init(c, size);
+			cttk_i15_init(d, size);
+			cttk_i31_init(z, size);
+			cttk_i31_init(t, size);
+		}
+
+		if ((i & 7) == 0) {
+			printf(".");
+			fflush(stdout);
+		}
+	}
+
+	free(ws);
+	printf(" done.\n");
+	fflush(stdout);
+}
+
+static uint64_t stats_ticks;
+
+static uint64_t
+stats_clock(void)
+{
+	return stats_ticks += 5;
+}
+
+static void
+check_stats_zero(const cttk_stats *st, const char *name)
+{
+	size_t u;
+
+	for (u = 0; u < CTTK_STATS_I31_NUM; u ++) {
+		check(st->i31_calls[u] == 0, "%s i31 calls %u",
+			name, (unsigned)u);
+	}
+	check(st->nan_size == 0 && st->nan_scratch == 0
+		&& st->scratch_allocs == 0 && st->scratch_bytes == 0
+		&& st->scratch_failures == 0 && st->array_accesses == 0
+		&& st->array_bytes == 0 && st->array_time == 0,
+		"%s counters", name);
+}
+
+static void
+test_stats(void)
+{
+	cttk_i31_def(x, 20000);
+	cttk_i31_def(y, 20000);
+	cttk_i31_def(z, 20000);
+	cttk_i31_def(t, 100);
+	unsigned char tab[40], buf[12];
+	size_t idx[3];
+	cttk_stats st;
+	int ok;
+
+	printf("Test stats: ");
+	fflush(stdout);
 
-			if ((i & 7) == 0) {
-				printf(".");
-				fflush(stdout);
-			}
-		}
+	cttk_stats_reset();
+	ok = cttk_stats_snapshot(&st);
+	check_stats_zero(&st, "reset");
+	if (!ok) {
+		/*
+		 * Without CTTK_STATS, everything must stay at zero.
+		 */
+		cttk_i31_init(x, 100);
+		cttk_i31_add(x, x, x);
+		cttk_array_read(buf, tab, 4, 10, 3);
+		cttk_stats_snapshot(&st);
+		check_stats_zero(&st, "disabled");
+		printf("disabled.\n");
+		fflush(stdout);
+		return;
 	}
 
+	/*
+	 * Size mismatches are counted as NaN results.
+	 */
+	cttk_i31_init(x, 100);
+	cttk_i31_init(t, 90);
+	cttk_i31_set_u32(x, 7);
+	cttk_i31_set_u32(t, 7);
+	cttk_stats_reset();
+	cttk_i31_add(x, x, t);
+	cttk_i31_mul(x, x, t);
+	cttk_stats_snapshot(&st);
+	check(st.i31_calls[CTTK_STATS_I31_ADD] == 1, "add calls");
+	check(st.i31_calls[CTTK_STATS_I31_MUL] == 1, "mul calls");
+	check(st.nan_size == 2, "NaN size");
+	check(st.nan_scratch == 0, "NaN scratch");
+	check(cttk_bool_to_int(cttk_i31_isnan(x)), "NaN result");
+	printf(".");
+	fflush(stdout);
+
+	/*
+	 * A large division needs temporaries beyond the stack limit.
+	 */
+	cttk_i31_init(x, 20000);
+	cttk_i31_init(y, 20000);
+	cttk_i31_init(z, 20000);
+	memset(tab, 0x5A, sizeof tab);
+	cttk_i31_decle_unsigned_trunc(x, tab, sizeof tab);
+	cttk_i31_set_u32(y, 12345);
+	cttk_stats_reset();
+	cttk_i31_mod(z, x, y);
+	cttk_stats_snapshot(&st);
+	check(st.i31_calls[CTTK_STATS_I31_DIV] == 1, "mod calls");
+	check(st.nan_size == 0, "mod NaN size");
+	/*
+	 * Either the heap allocation succeeded, or the result is NaN
+	 * (allocation failure, or library built without malloc()).
+	 */
+	check(st.scratch_allocs - st.scratch_failures + st.nan_scratch == 1,
+		"mod scratch");
+	check(st.scratch_allocs == 0 || st.scratch_bytes > 4096,
+		"mod scratch bytes");
+	printf(".");
+	fflush(stdout);
+
+	/*
+	 * Linear array accesses, with a fake clock.
+	 */
+	memset(tab, 0, sizeof tab);
+	idx[0] = 1;
+	idx[1] = 5;
+	idx[2] = 9;
+	stats_ticks = 0;
+	cttk_stats_set_clock(&stats_clock);
+	cttk_stats_reset();
+	cttk_array_read(buf, tab, 4, 10, 3);
+	cttk_array_write(tab, 4, 10, 3, buf);
+	cttk_array_read_many(buf, tab, 4, 10, idx, 3);
+	cttk_stats_snapshot(&st);
+	cttk_stats_set_clock(0);
+	check(st.array_accesses == 5, "array accesses");
+	check(st.array_bytes == 200, "array bytes");
+	check(st.array_time == 15, "array time");
+	printf(".");
+	fflush(stdout);
+
+	cttk_stats_reset();
+	cttk_stats_snapshot(&st);
+	check_stats_zero(&st, "reset");
+
 	printf(" done.\n");
 	fflush(stdout);
 }
 
+
+/*
+ * Set x to a random value of the specified size; the value is NaN with
+ * probability 1/16, and uses only about half of the size with
+ * probability 1/4 (so that products do not always overflow).
+ */
 static void
-test_i31_cmp(void)
+rnd_i31_special(uint32_t *x, unsigned size)
 {
-	cttk_i31_def(x1, 300);
-	cttk_i31_def(x2, 300);
-	zint z1, z2;
-	int i, j;
-	unsigned char tmp1[100], tmp2[100];
+	unsigned char tmp[512];
+	size_t len;
+
+	len = (size + 7) >> 3;
+	rnd_special(tmp, len, size);
+	switch (rnd32() & 15) {
+	case 0:
+		tmp[len] = 0x40;
+		cttk_i31_decle_signed(x, tmp, len + 1);
+		break;
+	case 1:
+	case 2:
+	case 3:
+	case 4:
+		memset(tmp + (len >> 1), -(tmp[len >> 1] >> 7),
+			len - (len >> 1));
+		/* fall through */
+	default:
+		cttk_i31_decle_signed_trunc(x, tmp, len);
+		break;
+	}
+}
 
-	printf("Test i31 codec: ");
-	fflush(stdout);
+/*
+ * Fill lane idx of batch b with a random value (see rnd_i31_special());
+ * the value is also written in x.
+ */
+static void
+rnd_batch_lane(uint32_t *b, size_t idx, uint32_t *x, unsigned size)
+{
+	rnd_i31_special(x, size);
+	cttk_i31_batch_set(b, idx, x);
+}
 
-	rnd_init(4);
+static void
+check_batch_lane(const uint32_t *b, size_t idx, uint32_t *x,
+	const uint32_t *z, const char *name, unsigned size, size_t num)
+{
+	size_t len;
 
-	for (i = 1; i <= 128; i ++) {
-		cttk_i31_init(x1, i);
-		cttk_i31_init(x2, i);
+	cttk_i31_batch_get(x, b, idx);
+	len = (z[0] + 31) >> 5;
+	if ((z[0] >> 31) != 0) {
+		check((x[0] >> 31) != 0, "batch %s NaN (%u,%u,%u)",
+			name, size, (unsigned)num, (unsigned)idx);
+	} else {
+		check(memcmp(x, z, (len + 1) * sizeof *x) == 0,
+			"batch %s (%u,%u,%u)",
+			name, size, (unsigned)num, (unsigned)idx);
+	}
+}
 
-		check(!cttk_bool_to_int(cttk_i31_eq0(x1)),
-			"cmp nan1 1 (%d)", i);
-		check(!cttk_bool_to_int(cttk_i31_neq0(x1)),
-			"cmp nan1 2 (%d)", i);
-		check(!cttk_bool_to_int(cttk_i31_lt0(x1)),
-			"cmp nan1 3 (%d)", i);
-		check(!cttk_bool_to_int(cttk_i31_leq0(x1)),
-			"cmp nan1 4 (%d)", i);
-		check(!cttk_bool_to_int(cttk_i31_gt0(x1)),
-			"cmp nan1 5 (%d)", i);
-		check(!cttk_bool_to_int(cttk_i31_geq0(x1)),
-			"cmp nan1 6 (%d)", i);
-		check(!cttk_bool_to_int(cttk_i31_eq(x1, x2)),
-			"cmp nan1 7 (%d)", i);
-		check(!cttk_bool_to_int(cttk_i31_neq(x1, x2)),
-			"cmp nan1 8 (%d)", i);
-		check(!cttk_bool_to_int(cttk_i31_lt(x1, x2)),
-			"cmp nan1 9 (%d)", i);
-		check(!cttk_bool_to_int(cttk_i31_leq(x1, x2)),
-			"cmp nan1 10 (%d)", i);
-		check(!cttk_bool_to_int(cttk_i31_gt(x1, x2)),
-			"cmp nan1 11 (%d)", i);
-		check(!cttk_bool_to_int(cttk_i31_geq(x1, x2)),
-			"cmp nan1 12 (%d)", i);
+static void
+test_i31_batch(void)
+{
+	static const unsigned sizes[] = {
+		1, 2, 30, 31, 32, 61, 62, 63, 64, 100, 257, 1000, 4000, 0
+	};
+	static const size_t nums[] = {
+		1, 3, 4, 5, 8, 9, 13, 0
+	};
+	int si, ni;
+	uint32_t *ba, *bb, *bd, *x, *y, *z, *w;
+	int32_t *r;
+	cttk_bool *ctl;
+	size_t blen;
 
-		cttk_i31_set_s32(x1, 0);
-		check(cttk_bool_to_int(cttk_i31_eq0(x1)),
-			"cmp eq0 1 (%d)", i);
-		check(!cttk_bool_to_int(cttk_i31_neq0(x1)),
-			"cmp neq0 2 (%d)", i);
-		check(!cttk_bool_to_int(cttk_i31_lt0(x1)),
-			"cmp lt0 3 (%d)", i);
-		check(cttk_bool_to_int(cttk_i31_leq0(x1)),
-			"cmp leq0 4 (%d)", i);
-		check(!cttk_bool_to_int(cttk_i31_gt0(x1)),
-			"cmp gt0 5 (%d)", i);
-		check(cttk_bool_to_int(cttk_i31_geq0(x1)),
-			"cmp geq0 6 (%d)", i);
-		check(!cttk_bool_to_int(cttk_i31_eq(x1, x2)),
-			"cmp nan2 1 (%d)", i);
-		check(!cttk_bool_to_int(cttk_i31_neq(x1, x2)),
-			"cmp nan2 2 (%d)", i);
-		check(!cttk_bool_to_int(cttk_i31_lt(x1, x2)),
-			"cmp nan2 3 (%d)", i);
-		check(!cttk_bool_to_int(cttk_i31_leq(x1, x2)),
-			"cmp nan2 4 (%d)", i);
-		check(!cttk_bool_to_int(cttk_i31_gt(x1, x2)),
-			"cmp nan2 5 (%d)", i);
-		check(!cttk_bool_to_int(cttk_i31_geq(x1, x2)),
-			"cmp nan2 6 (%d)", i);
-		check(!cttk_bool_to_int(cttk_i31_eq(x2, x1)),
-			"cmp nan2 7 (%d)", i);
-		check(!cttk_bool_to_int(cttk_i31_neq(x2, x1)),
-			"cmp nan2 8 (%d)", i);
-		check(!cttk_bool_to_int(cttk_i31_lt(x2, x1)),
-			"cmp nan2 9 (%d)", i);
-		check(!cttk_bool_to_int(cttk_i31_leq(x2, x1)),
-			"cmp nan2 10 (%d)", i);
-		check(!cttk_bool_to_int(cttk_i31_gt(x2, x1)),
-			"cmp nan2 11 (%d)", i);
-		check(!cttk_bool_to_int(cttk_i31_geq(x2, x1)),
-			"cmp nan2 12 (%d)", i);
+	printf("Test i31 batch: ");
+	fflush(stdout);
 
-		for (j = 0; j < 100; j ++) {
-			int cc;
+	rnd_init(15);
+
+	blen = 2 + 14 * ((4001 + 61) / 31);
+	ba = malloc(blen * sizeof *ba);
+	bb = malloc(blen * sizeof *bb);
+	bd = malloc(blen * sizeof *bd);
+	x = malloc(((4000 + 32 + 61) / 31) * sizeof *x);
+	y = malloc(((4000 + 32 + 61) / 31) * sizeof *y);
+	z = malloc(((4000 + 61) / 31) * sizeof *z);
+	w = malloc(((4000 + 61) / 31) * sizeof *w);
+	r = malloc(13 * sizeof *r);
+	ctl = malloc(13 * sizeof *ctl);
+	check(ba != NULL && bb != NULL && bd != NULL && x != NULL
+		&& y != NULL && z != NULL && w != NULL && r != NULL
+		&& ctl != NULL, "malloc");
+
+	for (si = 0; sizes[si] != 0; si ++) {
+		unsigned size;
+
+		size = sizes[si];
+		for (ni = 0; nums[ni] != 0; ni ++) {
+			size_t num, i;
+			int j;
 
-			rnd(tmp1, 17);
-			rnd(tmp2, 17);
-			zint_decode(&z1, tmp1, 17, 0, 0);
-			zint_decode(&z2, tmp2, 17, 0, 0);
-			zint_trunc(&z1, i);
-			zint_trunc(&z2, i);
-			zint_encode(tmp1, 17, &z1, 0);
-			zint_encode(tmp2, 17, &z2, 0);
-			cttk_i31_decle_signed(x1, tmp1, 17);
-			cttk_i31_decle_signed(x2, tmp2, 17);
+			num = nums[ni];
+			cttk_i31_batch_init(ba, size, num);
+			cttk_i31_batch_init(bb, size, num);
+			cttk_i31_batch_init(bd, size, num);
+			cttk_i31_init(x, size);
+			cttk_i31_init(y, size);
+			cttk_i31_init(z, size);
+			cttk_i31_init(w, size);
+			for (i = 0; i < num; i ++) {
+				cttk_i31_batch_get(x, ba, i);
+				check(cttk_bool_to_int(cttk_i31_isnan(x)),
+					"batch init (%u,%u)",
+					size, (unsigned)num);
+				cttk_i31_init(x, size);
+			}
 
-			cc = zint_cmp(&z1, &z2);
-			check(cttk_i31_cmp(x1, x2) == cc,
-				"cmp 1 (%d,%d)", i, j);
-			check(cttk_bool_to_int(cttk_i31_lt(x1, x2))
-				== (cc < 0), "cmp 2 (%d,%d)", i, j);
-			check(cttk_bool_to_int(cttk_i31_leq(x1, x2))
-				== (cc <= 0), "cmp 3 (%d,%d)", i, j);
-			check(cttk_bool_to_int(cttk_i31_gt(x1, x2))
-				== (cc > 0), "cmp 4 (%d,%d)", i, j);
-			check(cttk_bool_to_int(cttk_i31_geq(x1, x2))
-				== (cc >= 0), "cmp 5 (%d,%d)", i, j);
-			check(cttk_bool_to_int(cttk_i31_eq(x1, x1)),
-				"cmp 6 (%d,%d)", i, j);
-			check(cttk_bool_to_int(cttk_i31_geq(x1, x1)),
-				"cmp 7 (%d,%d)", i, j);
-			check(cttk_bool_to_int(cttk_i31_leq(x1, x1)),
-				"cmp 8 (%d,%d)", i, j);
-			check(!cttk_bool_to_int(cttk_i31_neq(x1, x1)),
-				"cmp 9 (%d,%d)", i, j);
-			check(!cttk_bool_to_int(cttk_i31_gt(x1, x1)),
-				"cmp 10 (%d,%d)", i, j);
-			check(!cttk_bool_to_int(cttk_i31_lt(x1, x1)),
-				"cmp 11 (%d,%d)", i, j);
+			for (j = 0; j < 20; j ++) {
+				int op;
 
-			cc = zint_sign(&z1);
-			check(cttk_bool_to_int(cttk_i31_lt0(x1)) == (cc < 0),
-				"cmp 12 (%d,%d)", i, j);
-			check(cttk_bool_to_int(cttk_i31_leq0(x1)) == (cc <= 0),
-				"cmp 13 (%d,%d)", i, j);
-			check(cttk_bool_to_int(cttk_i31_gt0(x1)) == (cc > 0),
-				"cmp 14 (%d,%d)", i, j);
-			check(cttk_bool_to_int(cttk_i31_geq0(x1)) == (cc >= 0),
-				"cmp 15 (%d,%d)", i, j);
-		}
+				for (i = 0; i < num; i ++) {
+					rnd_batch_lane(ba, i, x, size);
+					rnd_batch_lane(bb, i, y, size);
+					if ((rnd32() & 7) == 0) {
+						cttk_i31_batch_set(bb, i, x);
+					}
+					ctl[i] = cttk_bool_of_u32(rnd32() & 1);
+				}
 
-		if ((i & 3) == 0) {
-			printf(".");
-			fflush(stdout);
+				for (op = 0; op < 6; op ++) {
+					static const char *const names[] = {
+						"add", "add_trunc",
+						"sub", "sub_trunc",
+						"mul", "mul_trunc"
+					};
+					int alias;
+
+					for (alias = 0; alias < 2; alias ++) {
+						uint32_t *d;
+
+						if (alias) {
+							memcpy(bd, ba, blen
+								* sizeof *bd);
+							d = bd;
+						} else {
+							d = ba;
+						}
+						switch (op) {
+						case 0:
+							cttk_i31_batch_add(bd, d, bb);
+							break;
+						case 1:
+							cttk_i31_batch_add_trunc(
+								bd, d, bb);
+							break;
+						case 2:
+							cttk_i31_batch_sub(bd, d, bb);
+							break;
+						case 3:
+							cttk_i31_batch_sub_trunc(
+								bd, d, bb);
+							break;
+						case 4:
+							cttk_i31_batch_mul(bd, d, bb);
+							break;
+						default:
+							cttk_i31_batch_mul_trunc(
+								bd, d, bb);
+							break;
+						}
+						for (i = 0; i < num; i ++) {
+							cttk_i31_batch_get(x, ba, i);
+							cttk_i31_batch_get(y, bb, i);
+							switch (op) {
+							case 0:
+								cttk_i31_add(z, x, y);
+								break;
+							case 1:
+								cttk_i31_add_trunc(
+									z, x, y);
+								break;
+							case 2:
+								cttk_i31_sub(z, x, y);
+								break;
+							case 3:
+								cttk_i31_sub_trunc(
+									z, x, y);
+								break;
+							case 4:
+								cttk_i31_mul(z, x, y);
+								break;
+							default:
+								cttk_i31_mul_trunc(
+									z, x, y);
+								break;
+							}
+							check_batch_lane(bd, i, w, z,
+								names[op], size, num);
+							cttk_i31_init(z, size);
+						}
+					}
+				}
+
+				cttk_i31_batch_cmp(r, ba, bb);
+				for (i = 0; i < num; i ++) {
+					int32_t rr;
+
+					cttk_i31_batch_get(x, ba, i);
+					cttk_i31_batch_get(y, bb, i);
+					rr = cttk_i31_cmp(x, y);
+					if (cttk_bool_to_int(cttk_or(
+						cttk_i31_isnan(x),
+						cttk_i31_isnan(y))))
+					{
+						rr = 0;
+					}
+					check(r[i] == rr, "batch cmp (%u,%u,%u)",
+						size, (unsigned)num, (unsigned)i);
+				}
+
+				memcpy(bd, bb, blen * sizeof *bd);
+				cttk_i31_batch_cond_copy(ctl, bd, ba);
+				for (i = 0; i < num; i ++) {
+					cttk_i31_batch_get(x, ba, i);
+					cttk_i31_batch_get(y, bb, i);
+					cttk_i31_cond_copy(ctl[i], y, x);
+					check_batch_lane(bd, i, w, y,
+						"cond_copy", size, num);
+				}
+			}
+
+			/*
+			 * Size or lane count mismatch yields NaN in all
+			 * lanes.
+			 */
+			cttk_i31_batch_init(bb, size, num + 1);
+			cttk_i31_batch_add(bd, ba, bb);
+			cttk_i31_batch_init(bb, size + 1, num);
+			cttk_i31_batch_mul(bd, bd, bb);
+			for (i = 0; i < num; i ++) {
+				cttk_i31_batch_get(x, bd, i);
+				check(cttk_bool_to_int(cttk_i31_isnan(x)),
+					"batch mismatch (%u,%u)",
+					size, (unsigned)num);
+				cttk_i31_init(x, size);
+			}
+			cttk_i31_init(y, size + 32);
+			cttk_i31_batch_get(y, ba, 0);
+			check(cttk_bool_to_int(cttk_i31_isnan(y)),
+				"batch get size (%u)", size);
+			cttk_i31_init(x, size);
+			cttk_i31_batch_get(x, ba, num);
+			check(cttk_bool_to_int(cttk_i31_isnan(x)),
+				"batch get index (%u)", size);
 		}
+		printf(".");
+		fflush(stdout);
 	}
 
+	free(ba);
+	free(bb);
+	free(bd);
+	free(x);
+	free(y);
+	free(z);
+	free(w);
+	free(r);
+	free(ctl);
 	printf(" done.\n");
 	fflush(stdout);
 }
 
+typedef struct {
+	unsigned size;
+	void (*fn[6])(uint32_t *d, const uint32_t *a, const uint32_t *b);
+	int32_t (*cmp)(const uint32_t *x, const uint32_t *y);
+} i31_fixed_funs;
+
+#define I31_FIXED_ENTRY(size)   { size, { \
+		&cttk_i31_add_ ## size, &cttk_i31_add_trunc_ ## size, \
+		&cttk_i31_sub_ ## size, &cttk_i31_sub_trunc_ ## size, \
+		&cttk_i31_mul_ ## size, &cttk_i31_mul_trunc_ ## size }, \
+		&cttk_i31_cmp_ ## size },
+
 static void
-test_i31_addsub(void)
+test_i31_fixed(void)
 {
-	cttk_i31_def(x1, 300);
-	cttk_i31_def(x2, 300);
-	cttk_i31_def(x3, 300);
-	zint z1, z2, z3;
-	int i, j;
-	unsigned char tmp1[100], tmp2[100], tmp3[100], tmp4[100];
+	static const i31_fixed_funs funs[] = {
+		CTTK_I31_FIXED_SIZES(I31_FIXED_ENTRY)
+		{ 0, { 0, 0, 0, 0, 0, 0 }, 0 }
+	};
+	static void (*const gen[6])(uint32_t *d,
+		const uint32_t *a, const uint32_t *b) = {
+		&cttk_i31_add, &cttk_i31_add_trunc,
+		&cttk_i31_sub, &cttk_i31_sub_trunc,
+		&cttk_i31_mul, &cttk_i31_mul_trunc
+	};
+	cttk_i31_def(x, 4000);
+	cttk_i31_def(y, 4000);
+	cttk_i31_def(z, 4000);
+	cttk_i31_def(w, 4000);
+	int i;
 
-	printf("Test i31 add/sub: ");
+	printf("Test i31 fixed: ");
 	fflush(stdout);
 
-	rnd_init(5);
-
-	for (i = 1; i <= 128; i ++) {
-		cttk_i31_init(x1, i);
-		cttk_i31_init(x2, i);
-		cttk_i31_init(x3, i);
-
-		for (j = 0; j < 100; j ++) {
-			rnd(tmp1, 17);
-			rnd(tmp2, 17);
-			zint_decode(&z1, tmp1, 17, 0, 0);
-			zint_decode(&z2, tmp2, 17, 0, 0);
-			zint_trunc(&z1, i);
-			zint_trunc(&z2, i);
-			zint_encode(tmp1, 17, &z1, 0);
-			zint_encode(tmp2, 17, &z2, 0);
-			cttk_i31_decle_signed(x1, tmp1, 17);
-			cttk_i31_decle_signed(x2, tmp2, 17);
-
-			zint_add(&z3, &z1, &z2);
-			zint_encode(tmp3, 17, &z3, 0);
-			cttk_i31_add(x3, x1, x2);
-			if (zint_bitlength(&z3) >= (uint32_t)i) {
-				check(cttk_bool_to_int(cttk_i31_isnan(x3)),
-					"add 1 (%d,%d)", i, j);
-			} else {
-				cttk_i31_encle(tmp4, 17, x3);
-				check(memcmp(tmp3, tmp4, 17) == 0,
-					"add 2 (%d,%d)", i, j);
-			}
-			zint_trunc(&z3, i);
-			zint_encode(tmp3, 17, &z3, 0);
-			cttk_i31_add_trunc(x3, x1, x2);
-			cttk_i31_encle(tmp4, 17, x3);
-			check(memcmp(tmp3, tmp4, 17) == 0,
-				"add 3 (%d,%d)", i, j);
+	rnd_init(16);
 
-			zint_sub(&z3, &z1, &z2);
-			zint_encode(tmp3, 17, &z3, 0);
-			cttk_i31_sub(x3, x1, x2);
-			if (zint_bitlength(&z3) >= (uint32_t)i) {
-				check(cttk_bool_to_int(cttk_i31_isnan(x3)),
-					"sub 1 (%d,%d)", i, j);
-			} else {
-				cttk_i31_encle(tmp4, 17, x3);
-				check(memcmp(tmp3, tmp4, 17) == 0,
-					"sub 2 (%d,%d)", i, j);
+	for (i = 0; funs[i].size != 0; i ++) {
+		unsigned size;
+		size_t len;
+		int j, k;
+
+		size = funs[i].size;
+		len = ((size + size / 31) + 31) >> 5;
+		cttk_i31_init(x, size);
+		cttk_i31_init(y, size);
+		cttk_i31_init(z, size);
+		cttk_i31_init(w, size);
+		for (j = 0; j < 1000; j ++) {
+			rnd_i31_special(x, size);
+			rnd_i31_special(y, size);
+			if ((j & 15) == 0) {
+				cttk_i31_copy(y, x);
 			}
-			zint_trunc(&z3, i);
-			zint_encode(tmp3, 17, &z3, 0);
-			cttk_i31_sub_trunc(x3, x1, x2);
-			cttk_i31_encle(tmp4, 17, x3);
-			check(memcmp(tmp3, tmp4, 17) == 0,
-				"sub 3 (%d,%d)", i, j);
+			for (k = 0; k < 6; k ++) {
+				gen[k](z, x, y);
+				funs[i].fn[k](w, x, y);
+				if (cttk_bool_to_int(cttk_i31_isnan(z))) {
+					check(cttk_bool_to_int(
+						cttk_i31_isnan(w)),
+						"fixed %d NaN (%u,%d)", k, size, j);
+				} else {
+					check(memcmp(z, w,
+						(len + 1) * sizeof *z) == 0,
+						"fixed %d (%u,%d)", k, size, j);
+				}
 
-			zint_zero(&z1);
-			zint_sub(&z3, &z1, &z2);
-			zint_encode(tmp3, 17, &z3, 0);
-			cttk_i31_neg(x3, x2);
-			if (zint_bitlength(&z3) >= (uint32_t)i) {
-				check(cttk_bool_to_int(cttk_i31_isnan(x3)),
-					"neg 1 (%d,%d)", i, j);
-			} else {
-				cttk_i31_encle(tmp4, 17, x3);
-				check(memcmp(tmp3, tmp4, 17) == 0,
-					"neg 2 (%d,%d)", i, j);
+				/*
+				 * Destination may be the same array as
+				 * the first operand.
+				 */
+				cttk_i31_copy(w, x);
+				funs[i].fn[k](w, w, y);
+				if (cttk_bool_to_int(cttk_i31_isnan(z))) {
+					check(cttk_bool_to_int(
+						cttk_i31_isnan(w)),
+						"fixed %d alias NaN (%u,%d)",
+						k, size, j);
+				} else {
+					check(memcmp(z, w,
+						(len + 1) * sizeof *z) == 0,
+						"fixed %d alias (%u,%d)", k, size, j);
+				}
+				cttk_i31_init(w, size);
 			}
-			zint_trunc(&z3, i);
-			zint_encode(tmp3, 17, &z3, 0);
-			cttk_i31_neg_trunc(x3, x2);
-			cttk_i31_encle(tmp4, 17, x3);
-			check(memcmp(tmp3, tmp4, 17) == 0,
-				"neg 3 (%d,%d)", i, j);
+			check(funs[i].cmp(x, y) == cttk_i31_cmp(x, y),
+				"fixed cmp (%u,%d)", size, j);
 		}
 
-		memset(tmp1, 0, 17);
-		tmp1[(i - 1) >> 3] |= 1 << ((i - 1) & 7);
-		cttk_i31_decle_unsigned_trunc(x1, tmp1, 17);
-		check(cttk_bool_to_int(cttk_i31_lt0(x1)),
-			"negmin 1 (%d)", i);
-		cttk_i31_neg(x3, x1);
-		check(cttk_bool_to_int(cttk_i31_isnan(x3)),
-			"negmin 2 (%d)", i);
-		cttk_i31_neg_trunc(x3, x1);
-		check(!cttk_bool_to_int(cttk_i31_isnan(x3)),
-			"negmin 3 (%d)", i);
-		check(cttk_bool_to_int(cttk_i31_eq(x1, x3)),
-			"negmin 4 (%d)", i);
-
-		if ((i & 3) == 0) {
-			printf(".");
-			fflush(stdout);
+		/*
+		 * Operands of another size yield NaN.
+		 */
+		cttk_i31_init(y, size + 1);
+		cttk_i31_set_u32(y, 1);
+		cttk_i31_set_u32(x, 1);
+		for (k = 0; k < 6; k ++) {
+			cttk_i31_init(w, size);
+			cttk_i31_set_u32(w, 0);
+			funs[i].fn[k](w, x, y);
+			check(cttk_bool_to_int(cttk_i31_isnan(w)),
+				"fixed %d size (%u)", k, size);
+			cttk_i31_init(w, size + 1);
+			cttk_i31_set_u32(w, 0);
+			funs[i].fn[k](w, y, y);
+			check(cttk_bool_to_int(cttk_i31_isnan(w)),
+				"fixed %d size 2 (%u)", k, size);
 		}
+		check(funs[i].cmp(y, y) == 0, "fixed cmp size (%u)", size);
+
+		printf(".");
+		fflush(stdout);
 	}
 
 	printf(" done.\n");
 	fflush(stdout);
 }
 
+/*
+ * Reference GCD (Euclid's algorithm, not constant-time). Operands have
+ * the provided size; d must have size+1 bits, so that the GCD is
+ * always representable. The result is NaN if an operand is NaN.
+ */
 static void
-test_i31_mul(void)
+ref_i31_gcd(uint32_t *d, const uint32_t *a, const uint32_t *b, unsigned size)
 {
-	cttk_i31_def(x1, 300);
-	cttk_i31_def(x2, 300);
-	cttk_i31_def(x3, 300);
-	zint z1, z2, z3;
-	int i, j;
-	unsigned char tmp1[100], tmp2[100], tmp3[100], tmp4[100];
-
-	printf("Test i31 mul: ");
-	fflush(stdout);
+	cttk_i31_def(x, 2200);
+	cttk_i31_def(y, 2200);
+
+	cttk_i31_init(x, size + 1);
+	cttk_i31_init(y, size + 1);
+	cttk_i31_set(x, a);
+	cttk_i31_set(y, b);
+	cttk_i31_set(d, a);
+	if (cttk_bool_to_int(cttk_i31_lt0(x))) {
+		cttk_i31_neg(x, x);
+	}
+	if (cttk_bool_to_int(cttk_i31_lt0(y))) {
+		cttk_i31_neg(y, y);
+	}
+	while (cttk_bool_to_int(cttk_i31_neq0(y))) {
+		cttk_i31_mod(d, x, y);
+		cttk_i31_copy(x, y);
+		cttk_i31_copy(y, d);
+	}
+	cttk_i31_copy(d, x);
+	d[0] |= (a[0] | b[0]) & 0x80000000;
+}
 
-	rnd_init(6);
+static void
+test_i31_gcd(void)
+{
+	static const unsigned large_sizes[] = {
+		255, 256, 384, 521, 1024, 2048, 0
+	};
+	cttk_i31_def(a, 2100);
+	cttk_i31_def(b, 2100);
+	cttk_i31_def(c, 2100);
+	cttk_i31_def(d, 2100);
+	cttk_i31_def(e, 2100);
+	cttk_i31_def(r, 2200);
+	cttk_i31_def(x, 4300);
+	cttk_i31_def(y, 4300);
+	cttk_i31_def(z, 4300);
+	unsigned k;
 
-	cttk_i31_init(x1, 1);
-	cttk_i31_init(x2, 1);
-	cttk_i31_init(x3, 1);
-	cttk_i31_set_s32(x1, 0);
-	cttk_i31_set_s32(x2, -1);
-	cttk_i31_mul(x3, x1, x2);
-	check(!cttk_bool_to_int(cttk_i31_isnan(x3)), "mul0-1");
-	check(cttk_i31_to_s32(x3) == 0, "mul0-2");
-	cttk_i31_mul(x3, x2, x1);
-	check(!cttk_bool_to_int(cttk_i31_isnan(x3)), "mul0-3");
-	check(cttk_i31_to_s32(x3) == 0, "mul0-4");
+	printf("Test i31 gcd/modinv: ");
+	fflush(stdout);
 
-	for (i = 1; i <= 128; i ++) {
-		cttk_i31_init(x1, i);
-		cttk_i31_init(x2, i);
-		cttk_i31_init(x3, i);
+	rnd_init(18);
 
-		for (j = 0; j < 1000; j ++) {
-			rnd(tmp1, 17);
-			rnd(tmp2, 17);
-			zint_decode(&z1, tmp1, 17, 0, 0);
-			zint_decode(&z2, tmp2, 17, 0, 0);
-			zint_trunc(&z1, i);
-			zint_trunc(&z2, i);
-			zint_encode(tmp1, 17, &z1, 0);
-			zint_encode(tmp2, 17, &z2, 0);
-			cttk_i31_decle_signed(x1, tmp1, 17);
-			cttk_i31_decle_signed(x2, tmp2, 17);
+	for (k = 1;; k ++) {
+		unsigned size;
+		size_t len;
+		int j, num;
+
+		if (k <= 130) {
+			size = k;
+			num = 200;
+		} else if (large_sizes[k - 131] != 0) {
+			size = large_sizes[k - 131];
+			num = 20;
+		} else {
+			break;
+		}
+		len = ((size + size / 31) + 31) >> 5;
+		cttk_i31_init(a, size);
+		cttk_i31_init(b, size);
+		cttk_i31_init(c, size);
+		cttk_i31_init(d, size);
+		cttk_i31_init(e, size);
+		cttk_i31_init(r, size + 1);
+		cttk_i31_init(x, 2 * size + 2);
+		cttk_i31_init(y, 2 * size + 2);
+		cttk_i31_init(z, 2 * size + 2);
+
+		for (j = 0; j < num; j ++) {
+			int valid;
+
+			rnd_i31_special(a, size);
+			rnd_i31_special(b, size);
+			if ((j & 3) == 0 && size >= 6) {
+				/*
+				 * Make sure that large common factors occur.
+				 */
+				rnd_i31_special(c, size);
+				cttk_i31_rsh(a, a, size - size / 3);
+				cttk_i31_rsh(b, b, size - size / 3);
+				cttk_i31_rsh(c, c, size - size / 3);
+				cttk_i31_mul(a, a, c);
+				cttk_i31_mul(b, b, c);
+			}
 
-			zint_mul(&z3, &z1, &z2);
-			zint_encode(tmp3, 17, &z3, 0);
-			cttk_i31_mul(x3, x1, x2);
-			if (zint_bitlength(&z3) >= (uint32_t)i) {
-				check(cttk_bool_to_int(cttk_i31_isnan(x3)),
-					"mul 1 (%d,%d)", i, j);
+			/*
+			 * GCD.
+			 */
+			ref_i31_gcd(r, a, b, size);
+			cttk_i31_set(e, r);
+			cttk_i31_gcd(d, a, b);
+			if (cttk_bool_to_int(cttk_i31_isnan(e))) {
+				check(cttk_bool_to_int(cttk_i31_isnan(d)),
+					"gcd NaN (%u,%d)", size, j);
 			} else {
-				check(!cttk_bool_to_int(cttk_i31_isnan(x3)),
-					"mul 2 (%d,%d)", i, j);
-				cttk_i31_encle(tmp4, 17, x3);
-				check(memcmp(tmp3, tmp4, 17) == 0,
-					"mul 3 (%d,%d)", i, j);
+				check(cttk_bool_to_int(cttk_i31_eq(d, e)),
+					"gcd (%u,%d)", size, j);
 			}
-			zint_trunc(&z3, i);
-			zint_encode(tmp3, 17, &z3, 0);
-			cttk_i31_mul_trunc(x3, x1, x2);
-			cttk_i31_encle(tmp4, 17, x3);
-			check(!cttk_bool_to_int(cttk_i31_isnan(x3)),
-				"mul 4 (%d,%d)", i, j);
-			check(memcmp(tmp3, tmp4, 17) == 0,
-				"mul 5 (%d,%d)", i, j);
-
-			rnd(tmp1, 17);
-			rnd(tmp2, 17);
-			zint_decode(&z1, tmp1, 17, 0, 0);
-			zint_decode(&z2, tmp2, 17, 0, 0);
-			zint_trunc(&z1, (i + 2) >> 1);
-			zint_trunc(&z2, (i + 2) >> 1);
-			zint_encode(tmp1, 17, &z1, 0);
-			zint_encode(tmp2, 17, &z2, 0);
-			cttk_i31_decle_signed(x1, tmp1, 17);
-			cttk_i31_decle_signed(x2, tmp2, 17);
+			cttk_i31_copy(c, b);
+			cttk_i31_gcd(c, a, c);
+			check(memcmp(c, d, (len + 1) * sizeof *c) == 0,
+				"gcd alias (%u,%d)", size, j);
 
-			zint_mul(&z3, &z1, &z2);
-			zint_encode(tmp3, 17, &z3, 0);
-			cttk_i31_mul(x3, x1, x2);
-			if (zint_bitlength(&z3) >= (uint32_t)i) {
-				check(cttk_bool_to_int(cttk_i31_isnan(x3)),
-					"mul 6 (%d,%d)", i, j);
+			/*
+			 * Modular inversion; the modulus is made odd and
+			 * positive most of the time.
+			 */
+			if ((j & 3) != 0) {
+				if (cttk_bool_to_int(cttk_i31_lt0(b))) {
+					cttk_i31_not(b, b);
+				}
+				cttk_i31_set_u32(c, 1);
+				if (!cttk_bool_to_int(cttk_i31_isnan(c))) {
+					cttk_i31_or(b, b, c);
+				}
+			}
+			ref_i31_gcd(r, a, b, size);
+			valid = cttk_bool_to_int(cttk_i31_gt0(b))
+				&& (cttk_i31_to_u32_trunc(b) & 1) != 0
+				&& cttk_i31_to_u32(r) == 1;
+			cttk_i31_modinv(d, a, b);
+			if (!valid) {
+				check(cttk_bool_to_int(cttk_i31_isnan(d)),
+					"modinv NaN (%u,%d)", size, j);
 			} else {
-				check(!cttk_bool_to_int(cttk_i31_isnan(x3)),
-					"mul 7 (%d,%d)", i, j);
-				cttk_i31_encle(tmp4, 17, x3);
-				check(memcmp(tmp3, tmp4, 17) == 0,
-					"mul 8 (%d,%d)", i, j);
+				check(!cttk_bool_to_int(cttk_i31_isnan(d)),
+					"modinv 1 (%u,%d)", size, j);
+				check(cttk_bool_to_int(cttk_i31_geq0(d))
+					&& cttk_bool_to_int(cttk_i31_lt(d, b)),
+					"modinv 2 (%u,%d)", size, j);
+				cttk_i31_set(x, a);
+				cttk_i31_set(y, d);
+				cttk_i31_mul(x, x, y);
+				cttk_i31_set(y, b);
+				cttk_i31_mod(z, x, y);
+				if (cttk_bool_to_int(cttk_i31_eq0(d))) {
+					/* m = 1 */
+					check(cttk_bool_to_int(cttk_i31_eq0(z)),
+						"modinv 3 (%u,%d)", size, j);
+				} else {
+					check(cttk_i31_to_u32(z) == 1,
+						"modinv 4 (%u,%d)", size, j);
+				}
 			}
-			zint_trunc(&z3, i);
-			zint_encode(tmp3, 17, &z3, 0);
-			cttk_i31_mul_trunc(x3, x1, x2);
-			cttk_i31_encle(tmp4, 17, x3);
-			check(!cttk_bool_to_int(cttk_i31_isnan(x3)),
-				"mul 9 (%d,%d)", i, j);
-			check(memcmp(tmp3, tmp4, 17) == 0,
-				"mul 10 (%d,%d)", i, j);
-
-			cttk_i31_mul_trunc(x1, x1, x2);
-			cttk_i31_encle(tmp4, 17, x1);
-			check(!cttk_bool_to_int(cttk_i31_isnan(x1)),
-				"mul 11 (%d,%d)", i, j);
-			check(memcmp(tmp3, tmp4, 17) == 0,
-				"mul 12 (%d,%d)", i, j);
+			cttk_i31_copy(c, a);
+			cttk_i31_modinv(c, c, b);
+			check(memcmp(c, d, (len + 1) * sizeof *c) == 0,
+				"modinv alias 1 (%u,%d)", size, j);
+			cttk_i31_copy(c, b);
+			cttk_i31_modinv(c, a, c);
+			check(memcmp(c, d, (len + 1) * sizeof *c) == 0,
+				"modinv alias 2 (%u,%d)", size, j);
 		}
 
-		memset(tmp1, 0, 17);
-		for (j = i - 1; j < 17 * 8; j ++) {
-			tmp1[j >> 3] |= 1 << (j & 7);
+		/*
+		 * Negative moduli, NaN operands and size mismatches.
+		 */
+		cttk_i31_set_u32_trunc(a, 1);
+		cttk_i31_set_s32(b, -1);
+		cttk_i31_modinv(d, a, b);
+		check(cttk_bool_to_int(cttk_i31_isnan(d)),
+			"modinv neg (%u)", size);
+		if (size >= 3) {
+			cttk_i31_set_s32(b, -3);
+			cttk_i31_modinv(d, a, b);
+			check(cttk_bool_to_int(cttk_i31_isnan(d)),
+				"modinv neg 2 (%u)", size);
 		}
-		memset(tmp2, 0xFF, 17);
-		cttk_i31_decle_signed(x1, tmp1, 17);
-		cttk_i31_decle_signed(x2, tmp2, 17);
-		check(!cttk_bool_to_int(cttk_i31_isnan(x1)), "mul 13 (%d)", i);
-		check(!cttk_bool_to_int(cttk_i31_isnan(x2)), "mul 14 (%d)", i);
-		cttk_i31_mul(x3, x1, x2);
-		check(cttk_bool_to_int(cttk_i31_isnan(x3)), "mul 15 (%d)", i);
-		cttk_i31_mul_trunc(x3, x1, x2);
-		check(!cttk_bool_to_int(cttk_i31_isnan(x3)), "mul 16 (%d)", i);
-		check(cttk_bool_to_int(cttk_i31_eq(x3, x1)), "mul 17 (%d)", i);
-
-		if ((i & 3) == 0) {
+		cttk_i31_set_u32_trunc(b, 1);
+		a[0] |= 0x80000000;
+		cttk_i31_gcd(d, a, b);
+		check(cttk_bool_to_int(cttk_i31_isnan(d)), "gcd NaN 2 (%u)", size);
+		cttk_i31_modinv(d, b, a);
+		check(cttk_bool_to_int(cttk_i31_isnan(d)),
+			"modinv NaN 2 (%u)", size);
+		cttk_i31_set_u32_trunc(a, 1);
+		cttk_i31_gcd(r, a, b);
+		check(cttk_bool_to_int(cttk_i31_isnan(r)), "gcd size (%u)", size);
+		cttk_i31_init(r, size + 1);
+		cttk_i31_modinv(r, a, b);
+		check(cttk_bool_to_int(cttk_i31_isnan(r)),
+			"modinv size (%u)", size);
+
+		if ((k & 3) == 0) {
 			printf(".");
 			fflush(stdout);
 		}
@@ -2201,86 +6123,170 @@ test_i31_mul(void)
 }
 
 static void
-test_i31_shift(void)
+test_d31(void)
 {
-	cttk_i31_def(x1, 300);
-	cttk_i31_def(x2, 300);
-	zint z1, z2;
-	int i, j, k;
-	unsigned char tmp1[100], tmp2[100], tmp3[100];
+	static const unsigned large_sizes[] = {
+		255, 256, 521, 1024, 2048, 3000, 0
+	};
+	cttk_i31_def(a, 3000);
+	cttk_i31_def(b, 3000);
+	cttk_i31_def(q1, 3000);
+	cttk_i31_def(r1, 3000);
+	cttk_i31_def(q2, 3000);
+	cttk_i31_def(r2, 3000);
+	cttk_d31_def(dc, 3000);
+	unsigned k;
 
-	printf("Test i31 shift: ");
+	printf("Test d31: ");
 	fflush(stdout);
 
-	rnd_init(7);
-
-	for (i = 1; i <= 128; i ++) {
-		cttk_i31_init(x1, i);
-		cttk_i31_init(x2, i);
-
-		for (j = 0; j <= i + 32; j ++) {
-			for (k = 0; k < 50; k ++) {
-				rnd(tmp1, 17);
-				zint_decode(&z1, tmp1, 17, 0, 0);
-				zint_trunc(&z1, i);
-				zint_encode(tmp1, 17, &z1, 0);
-				cttk_i31_decle_signed(x1, tmp1, 17);
+	rnd_init(19);
 
-				zint_lsh(&z2, &z1, j);
-				zint_encode(tmp2, 17, &z2, 0);
-				cttk_i31_lsh(x2, x1, j);
-				if (zint_bitlength(&z2) >= (uint32_t)i) {
-					check(cttk_bool_to_int(
-						cttk_i31_isnan(x2)),
-						"lsh 1 (%d,%d,%d)", i, j, k);
-				} else {
-					check(!cttk_bool_to_int(
-						cttk_i31_isnan(x2)),
-						"lsh 2 (%d,%d,%d)", i, j, k);
-					cttk_i31_encle(tmp3, 17, x2);
-					check(memcmp(tmp2, tmp3, 17) == 0,
-						"lsh 3 (%d,%d,%d)", i, j, k);
-				}
+	for (k = 1;; k ++) {
+		unsigned size;
+		size_t len;
+		int i, j, num;
+
+		if (k <= 130) {
+			size = k;
+			num = 20;
+		} else if (large_sizes[k - 131] != 0) {
+			size = large_sizes[k - 131];
+			num = 4;
+		} else {
+			break;
+		}
+		len = ((size + size / 31) + 31) >> 5;
+		cttk_i31_init(a, size);
+		cttk_i31_init(b, size);
+		cttk_i31_init(q1, size);
+		cttk_i31_init(r1, size);
+		cttk_i31_init(q2, size);
+		cttk_i31_init(r2, size);
+
+		for (i = 0; i < num; i ++) {
+			rnd_i31_special(b, size);
+			if ((i & 3) == 0 && size > 2) {
+				cttk_i31_rsh(b, b, rnd32() % (size - 1));
+			}
+			cttk_d31_init(dc, b);
+			check(cttk_bool_to_int(cttk_d31_isnan(dc))
+				== cttk_bool_to_int(cttk_or(cttk_i31_isnan(b),
+				cttk_i31_eq0(b))), "d31 init (%u,%d)", size, i);
+			check(memcmp(dc + 1, b + 1, len * sizeof *b) == 0,
+				"d31 init copy (%u,%d)", size, i);
+
+			if (cttk_bool_to_int(cttk_i31_isnan(b))) {
+				rnd_i31_special(a, size);
+				cttk_d31_divrem(q2, r2, a, dc);
+				cttk_d31_mod(r1, a, dc);
+				check(cttk_bool_to_int(cttk_i31_isnan(q2))
+					&& cttk_bool_to_int(cttk_i31_isnan(r2))
+					&& cttk_bool_to_int(cttk_i31_isnan(r1)),
+					"d31 NaN (%u,%d)", size, i);
+				continue;
+			}
 
-				cttk_i31_lsh_prot(x2, x1, j);
-				if (zint_bitlength(&z2) >= (uint32_t)i) {
-					check(cttk_bool_to_int(
-						cttk_i31_isnan(x2)),
-						"lsh 4 (%d,%d,%d)", i, j, k);
-				} else {
-					check(!cttk_bool_to_int(
-						cttk_i31_isnan(x2)),
-						"lsh 5 (%d,%d,%d)", i, j, k);
-					cttk_i31_encle(tmp3, 17, x2);
-					check(memcmp(tmp2, tmp3, 17) == 0,
-						"lsh 6 (%d,%d,%d)", i, j, k);
+			for (j = 0; j < 50; j ++) {
+				rnd_i31_special(a, size);
+				if ((j & 1) == 0) {
+					/*
+					 * Exact multiples of b, or very
+					 * close, exercise the correction
+					 * step.
+					 */
+					cttk_i31_rsh(a, a, rnd32() % size);
+					cttk_i31_mul(q1, a, b);
+					if (!cttk_bool_to_int(
+						cttk_i31_isnan(q1)))
+					{
+						cttk_i31_copy(a, q1);
+					}
+					cttk_i31_set_s32(q1,
+						(int32_t)(rnd32() % 3) - 1);
+					cttk_i31_add(q1, a, q1);
+					if ((j & 2) == 0 && !cttk_bool_to_int(
+						cttk_i31_isnan(q1)))
+					{
+						cttk_i31_copy(a, q1);
+					}
 				}
-
-				zint_trunc(&z2, i);
-				zint_encode(tmp2, 17, &z2, 0);
-				cttk_i31_lsh_trunc(x2, x1, j);
-				cttk_i31_encle(tmp3, 17, x2);
-				check(memcmp(tmp2, tmp3, 17) == 0,
-					"lsh 7 (%d,%d,%d)", i, j, k);
-				cttk_i31_lsh_trunc_prot(x2, x1, j);
-				cttk_i31_encle(tmp3, 17, x2);
-				check(memcmp(tmp2, tmp3, 17) == 0,
-					"lsh 8 (%d,%d,%d)", i, j, k);
-
-				zint_rsh(&z2, &z1, j);
-				zint_encode(tmp2, 17, &z2, 0);
-				cttk_i31_rsh(x2, x1, j);
-				cttk_i31_encle(tmp3, 17, x2);
-				check(memcmp(tmp2, tmp3, 17) == 0,
-					"rsh 1 (%d,%d,%d)", i, j, k);
-				cttk_i31_rsh_prot(x2, x1, j);
-				cttk_i31_encle(tmp3, 17, x2);
-				check(memcmp(tmp2, tmp3, 17) == 0,
-					"rsh 2 (%d,%d,%d)", i, j, k);
+
+				cttk_i31_divrem(q1, r1, a, b);
+				cttk_d31_divrem(q2, r2, a, dc);
+				check(cttk_bool_to_int(cttk_i31_isnan(q1))
+					== cttk_bool_to_int(
+					cttk_i31_isnan(q2)),
+					"d31 q NaN (%u,%d,%d)", size, i, j);
+				check(cttk_bool_to_int(cttk_i31_isnan(r1))
+					== cttk_bool_to_int(
+					cttk_i31_isnan(r2)),
+					"d31 r NaN (%u,%d,%d)", size, i, j);
+				if (!cttk_bool_to_int(cttk_i31_isnan(q1))) {
+					check(cttk_bool_to_int(
+						cttk_i31_eq(q1, q2)),
+						"d31 q (%u,%d,%d)", size, i, j);
+				}
+				if (!cttk_bool_to_int(cttk_i31_isnan(r1))) {
+					check(cttk_bool_to_int(
+						cttk_i31_eq(r1, r2)),
+						"d31 r (%u,%d,%d)", size, i, j);
+				}
+
+				cttk_i31_mod(r1, a, b);
+				cttk_d31_mod(r2, a, dc);
+				check(cttk_bool_to_int(cttk_i31_isnan(r1))
+					== cttk_bool_to_int(
+					cttk_i31_isnan(r2)),
+					"d31 mod NaN (%u,%d,%d)", size, i, j);
+				if (!cttk_bool_to_int(cttk_i31_isnan(r1))) {
+					check(cttk_bool_to_int(
+						cttk_i31_eq(r1, r2)),
+						"d31 mod (%u,%d,%d)", size, i, j);
+				}
+
+				/*
+				 * Quotient or remainder in the same array
+				 * as the dividend.
+				 */
+				cttk_i31_copy(q2, a);
+				cttk_d31_divrem(q2, NULL, q2, dc);
+				cttk_i31_div(q1, a, b);
+				check(memcmp(q1, q2, (len + 1) * sizeof *q1)
+					== 0 || (cttk_bool_to_int(
+					cttk_i31_isnan(q1)) && cttk_bool_to_int(
+					cttk_i31_isnan(q2))),
+					"d31 q alias (%u,%d,%d)", size, i, j);
+				cttk_i31_copy(r2, a);
+				cttk_d31_mod(r2, r2, dc);
+				cttk_i31_mod(r1, a, b);
+				check(memcmp(r1, r2, (len + 1) * sizeof *r1)
+					== 0 || (cttk_bool_to_int(
+					cttk_i31_isnan(r1)) && cttk_bool_to_int(
+					cttk_i31_isnan(r2))),
+					"d31 mod alias (%u,%d,%d)", size, i, j);
 			}
 		}
 
-		if ((i & 3) == 0) {
+		/*
+		 * Size mismatch.
+		 */
+		cttk_i31_set_u32_trunc(b, 1);
+		cttk_d31_init(dc, b);
+		cttk_i31_init(a, size + 1);
+		cttk_i31_set_u32(a, 0);
+		cttk_d31_divrem(q2, r2, a, dc);
+		check(cttk_bool_to_int(cttk_i31_isnan(q2))
+			&& cttk_bool_to_int(cttk_i31_isnan(r2)),
+			"d31 size (%u)", size);
+		cttk_i31_init(a, size);
+		cttk_i31_set_u32(a, 0);
+		cttk_i31_init(r2, size + 1);
+		cttk_d31_mod(r2, a, dc);
+		check(cttk_bool_to_int(cttk_i31_isnan(r2)),
+			"d31 size 2 (%u)", size);
+
+		if ((k & 3) == 0) {
 			printf(".");
 			fflush(stdout);
 		}
@@ -2290,134 +6296,230 @@ test_i31_shift(void)
 	fflush(stdout);
 }
 
+/*
+ * Reference decimal encoding, in the fixed-length format of
+ * cttk_i31_encdec() with nd digits (a NaN is encoded as zero), using
+ * repeated divisions by 10000. Returned value is 0 if the value does
+ * not fit in nd digits, 1 otherwise.
+ */
+static int
+ref_i31_encdec(char *dst, const uint32_t *x, size_t nd)
+{
+	cttk_i31_def(y, 4001);
+	cttk_i31_def(r, 4001);
+	cttk_i31_def(t, 4001);
+	uint32_t h;
+	unsigned size;
+	int neg;
+	size_t k;
+
+	h = x[0] & 0x7FFFFFFF;
+	size = h - (h >> 5) + 1;
+	if (size < 16) {
+		size = 16;
+	}
+	cttk_i31_init(y, size);
+	cttk_i31_init(r, size);
+	cttk_i31_init(t, size);
+	if (cttk_bool_to_int(cttk_i31_isnan(x))) {
+		cttk_i31_set_u32(y, 0);
+	} else {
+		cttk_i31_set(y, x);
+	}
+	neg = cttk_bool_to_int(cttk_i31_lt0(y));
+	if (neg) {
+		cttk_i31_neg(y, y);
+	}
+	cttk_i31_set_u32(t, 10000);
+	k = nd;
+	while (k > 0) {
+		uint32_t w;
+		int i;
+
+		cttk_i31_divrem(y, r, y, t);
+		w = cttk_i31_to_u32(r);
+		for (i = 0; i < 4 && k > 0; i ++) {
+			dst[k --] = (char)('0' + w % 10);
+			w /= 10;
+		}
+	}
+	dst[0] = neg ? '-' : '+';
+	dst[nd + 1] = 0;
+	return cttk_bool_to_int(cttk_i31_eq0(y));
+}
+
 static void
-test_i31_div(void)
+test_i31_dec(void)
 {
-	cttk_i31_def(a, 300);
-	cttk_i31_def(b, 300);
-	cttk_i31_def(q, 300);
-	cttk_i31_def(r, 300);
-	cttk_i31_def(m, 300);
-	cttk_i31_def(x, 300);
-	int i, j;
-	unsigned char tmp1[100], tmp2[100];
+	static const unsigned large_sizes[] = {
+		255, 256, 521, 1024, 2048, 3000, 4000, 0
+	};
+	static const char *const bad[] = {
+		"", "+", "-", "1x", "x1", " 1", "1 ", "+-1", "--1", "1.0",
+		"/", ":", NULL
+	};
+	cttk_i31_def(x, 4000);
+	cttk_i31_def(y, 4000);
+	cttk_i31_def(p, 4001);
+	char s1[1300], s2[1300], s3[1300], st[1300];
+	unsigned k;
 
-	printf("Test i31 div: ");
+	printf("Test i31 decimal: ");
 	fflush(stdout);
 
-	rnd_init(8);
+	rnd_init(20);
 
-	for (i = 1; i <= 128; i ++) {
-		cttk_i31_init(a, i);
-		cttk_i31_init(b, i);
-		cttk_i31_init(q, i);
-		cttk_i31_init(r, i);
-		cttk_i31_init(m, i);
-		cttk_i31_init(x, i);
+	for (k = 1;; k ++) {
+		unsigned size;
+		size_t nd, n, u;
+		int i, num;
 
-		for (j = 0; j < 1000; j ++) {
-			cttk_bool bb;
+		if (k <= 130) {
+			size = k;
+			num = 20;
+		} else if (large_sizes[k - 131] != 0) {
+			size = large_sizes[k - 131];
+			num = 4;
+		} else {
+			break;
+		}
+		cttk_i31_init(x, size);
+		cttk_i31_init(y, size);
 
-			rnd(tmp1, 17);
-			rnd(tmp2, 17);
-			cttk_i31_decle_signed_trunc(a, tmp1, 17);
-			cttk_i31_decle_signed_trunc(b, tmp2, 17);
-			if (j >= 500) {
-				cttk_i31_rsh(b, b, i >> 1);
+#if CTTK_NO_MALLOC
+		/*
+		 * Without dynamic allocation, sizes whose temporary buffer
+		 * exceeds CTTK_MAX_INT_BUF cannot be encoded (an empty
+		 * string is produced).
+		 */
+		cttk_i31_set_u32(x, 0);
+		if (cttk_i31_encdec(s2, sizeof s2, x, 0) == 0) {
+			break;
+		}
+#endif
+
+		/*
+		 * The number of digits must be enough for 2^(size-1), with
+		 * at most one extra leading zero.
+		 */
+		nd = cttk_i31_encdec(NULL, 0, x, 0) - 1;
+		cttk_i31_init(p, size + 1);
+		cttk_i31_set_u32(p, 1);
+		cttk_i31_lsh(p, p, size - 1);
+		check(ref_i31_encdec(s1, p, nd), "i31 dec digits (%u)", size);
+		check(nd == 1 || s1[1] != '0' || s1[2] != '0',
+			"i31 dec digits 2 (%u)", size);
+
+		/*
+		 * 2^(size-1) does not fit; its opposite does.
+		 */
+		cttk_i31_decdec(y, s1, nd + 1);
+		check(cttk_bool_to_int(cttk_i31_isnan(y)),
+			"i31 dec overflow (%u)", size);
+		cttk_i31_decdec(y, s1 + 1, nd);
+		check(cttk_bool_to_int(cttk_i31_isnan(y)),
+			"i31 dec overflow 2 (%u)", size);
+		s1[0] = '-';
+		cttk_i31_decdec(y, s1, nd + 1);
+		cttk_i31_neg(p, p);
+		cttk_i31_set(x, p);
+		check(cttk_bool_to_int(cttk_i31_eq(x, y)),
+			"i31 dec min (%u)", size);
+
+		for (i = 0; i < num; i ++) {
+			const char *t;
+
+			switch (i) {
+			case 0:
+				cttk_i31_set_u32(x, 0);
+				break;
+			case 1:
+				cttk_i31_set(x, p);
+				break;
+			case 2:
+				cttk_i31_set(x, p);
+				cttk_i31_not(x, x);
+				break;
+			default:
+				rnd_i31_special(x, size);
+				break;
 			}
 
+			check(ref_i31_encdec(s1, x, nd),
+				"i31 dec ref (%u,%d)", size, i);
+			n = cttk_i31_encdec(s2, sizeof s2, x, 0);
+			check(n == nd + 1 && strcmp(s1, s2) == 0,
+				"i31 encdec (%u,%d)", size, i);
+
 			/*
-			 * Set bb to true if b == -1 and a == MinValue.
+			 * Trimmed output.
 			 */
-			if (i >= 2) {
-				cttk_i31_set_u32_trunc(x, 1);
-				cttk_i31_add(x, x, b);
-				bb = cttk_i31_eq0(x);
-				cttk_i31_lsh_trunc(x, a, 1);
-				bb = cttk_and(bb, cttk_and(cttk_i31_eq0(x),
-					cttk_i31_neq0(a)));
+			t = s1 + 1;
+			while (t[0] == '0' && t[1] != 0) {
+				t ++;
+			}
+			if (s1[0] == '-') {
+				st[0] = '-';
+				strcpy(st + 1, t);
 			} else {
-				bb = cttk_bool_of_u32(i == 1
-					&& (tmp1[0] & tmp2[0] & 1) == 1);
+				strcpy(st, t);
 			}
+			t = st;
+			n = cttk_i31_encdec(s2, sizeof s2, x, CTTK_DEC_TRIM);
+			check(n == strlen(t) && strcmp(s2, t) == 0,
+				"i31 encdec trim (%u,%d)", size, i);
+			check(cttk_i31_encdec(NULL, 0, x, CTTK_DEC_TRIM) == n,
+				"i31 encdec trim len (%u,%d)", size, i);
 
-			cttk_i31_divrem(q, r, a, b);
-
-			if (cttk_bool_to_int(cttk_i31_eq0(b))) {
-				check(cttk_bool_to_int(cttk_i31_isnan(q)),
-					"div 1 (%d,%d)", i, j);
-				check(cttk_bool_to_int(cttk_i31_isnan(r)),
-					"div 2 (%d,%d)", i, j);
-			} else if (cttk_bool_to_int(bb)) {
-				check(cttk_bool_to_int(cttk_i31_isnan(q)),
-					"div 3 (%d,%d)", i, j);
-				check(cttk_bool_to_int(cttk_i31_eq0(r)),
-					"div 4 (%d,%d)", i, j);
-			} else if (cttk_bool_to_int(cttk_i31_lt0(a))) {
-				check(cttk_bool_to_int(cttk_i31_leq0(r)),
-					"div 5 (%d,%d)", i, j);
-				if (cttk_bool_to_int(cttk_i31_lt0(b))) {
-					check(cttk_bool_to_int(
-						cttk_i31_lt(b, r)),
-						"div 6 (%d,%d)", i, j);
-				} else {
-					cttk_i31_neg(x, r);
-					check(cttk_bool_to_int(
-						cttk_i31_lt(x, b)),
-						"div 7 (%d,%d)", i, j);
-				}
-				cttk_i31_mul(x, b, q);
-				cttk_i31_add(x, x, r);
-				check(cttk_bool_to_int(cttk_i31_eq(x, a)),
-					"div 8 (%d,%d)", i, j);
-			} else {
-				check(cttk_bool_to_int(cttk_i31_geq0(r)),
-					"div 9 (%d,%d)", i, j);
-				if (cttk_bool_to_int(cttk_i31_lt0(b))) {
-					cttk_i31_neg(x, r);
-					check(cttk_bool_to_int(
-						cttk_i31_lt(b, x)),
-						"div 10 (%d,%d)", i, j);
-				} else {
-					check(cttk_bool_to_int(
-						cttk_i31_lt(r, b)),
-						"div 11 (%d,%d)", i, j);
-				}
-				cttk_i31_mul(x, b, q);
-				cttk_i31_add(x, x, r);
-				check(cttk_bool_to_int(cttk_i31_eq(x, a)),
-					"div 12 (%d,%d)", i, j);
+			/*
+			 * Truncated output.
+			 */
+			memset(s3, 'z', sizeof s3);
+			n = cttk_i31_encdec(s3, 5, x, 0);
+			check(n == (nd + 1 < 4 ? nd + 1 : 4)
+				&& memcmp(s1, s3, n) == 0 && s3[n] == 0
+				&& s3[5] == 'z',
+				"i31 encdec truncated (%u,%d)", size, i);
+			check(cttk_i31_encdec(s3, 0, x, 0) == 0
+				&& s3[0] == s1[0],
+				"i31 encdec empty (%u,%d)", size, i);
+
+			if (cttk_bool_to_int(cttk_i31_isnan(x))) {
+				continue;
 			}
+			cttk_i31_decdec(y, s1, nd + 1);
+			check(cttk_bool_to_int(cttk_i31_eq(x, y)),
+				"i31 decdec (%u,%d)", size, i);
+			cttk_i31_set_u32(y, 0);
+			cttk_i31_decdec(y, t, strlen(t));
+			check(cttk_bool_to_int(cttk_i31_eq(x, y)),
+				"i31 decdec trim (%u,%d)", size, i);
 
-			cttk_i31_mod(m, a, b);
+			/*
+			 * Leading zeros.
+			 */
+			s3[0] = s1[0];
+			memset(s3 + 1, '0', 40);
+			memcpy(s3 + 41, s1 + 1, nd + 1);
+			cttk_i31_decdec(y, s3, nd + 41);
+			check(cttk_bool_to_int(cttk_i31_eq(x, y)),
+				"i31 decdec zeros (%u,%d)", size, i);
+		}
 
-			if (cttk_bool_to_int(cttk_i31_eq0(b))) {
-				check(cttk_bool_to_int(cttk_i31_isnan(m)),
-					"mod 1 (%d,%d)", i, j);
-			} else {
-				check(!cttk_bool_to_int(cttk_i31_isnan(m)),
-					"mod 2 (%d,%d)", i, j);
-				check(cttk_bool_to_int(cttk_i31_geq0(m)),
-					"mod 3 (%d,%d)", i, j);
-				if (cttk_bool_to_int(cttk_i31_geq0(r))) {
-					check(cttk_bool_to_int
-						(cttk_i31_eq(r, m)),
-						"mod 4 (%d,%d)", i, j);
-				} else if (cttk_bool_to_int(cttk_i31_gt0(b))) {
-					cttk_i31_sub(m, m, r);
-					check(cttk_bool_to_int
-						(cttk_i31_eq(b, m)),
-						"mod 5 (%d,%d)", i, j);
-				} else {
-					cttk_i31_add(m, m, b);
-					check(cttk_bool_to_int
-						(cttk_i31_eq(r, m)),
-						"mod 6 (%d,%d)", i, j);
-				}
-			}
+		/*
+		 * Malformed strings.
+		 */
+		for (u = 0; bad[u] != NULL; u ++) {
+			cttk_i31_set_u32(y, 0);
+			cttk_i31_decdec(y, bad[u], strlen(bad[u]));
+			check(cttk_bool_to_int(cttk_i31_isnan(y)),
+				"i31 decdec bad (%u,%s)", size, bad[u]);
 		}
+		cttk_i31_decdec(y, "-0", 2);
+		check(cttk_bool_to_int(cttk_i31_eq0(y)),
+			"i31 decdec -0 (%u)", size);
 
-		if ((i & 3) == 0) {
+		if ((k & 3) == 0) {
 			printf(".");
 			fflush(stdout);
 		}
@@ -2427,70 +6529,168 @@ test_i31_div(void)
 	fflush(stdout);
 }
 
+/*
+ * Run again the tests of functions with several implementations, with
+ * each proper subset of the CPU features.
+ */
+/*
+ * Compare the result of a text decoding (y) with the reference (x),
+ * obtained by decoding the bytes.
+ */
 static void
-test_i31_bool(void)
+check_i31_txt(const uint32_t *x, const uint32_t *y, const char *name,
+	unsigned size, int i)
 {
-	cttk_i31_def(x1, 300);
-	cttk_i31_def(x2, 300);
-	cttk_i31_def(x3, 300);
-	zint z1, z2, z3;
-	int i, j;
-	unsigned char tmp1[100], tmp2[100], tmp3[100], tmp4[100];
-
-	printf("Test i31 bool: ");
-	fflush(stdout);
+	check(cttk_bool_to_int(cttk_i31_isnan(x))
+		== cttk_bool_to_int(cttk_i31_isnan(y)),
+		"%s NaN (%u,%d)", name, size, i);
+	if (!cttk_bool_to_int(cttk_i31_isnan(x))) {
+		check(cttk_bool_to_int(cttk_i31_eq(x, y)),
+			"%s value (%u,%d)", name, size, i);
+	}
+}
 
-	rnd_init(9);
+static void
+ref_i31_decbe(uint32_t *x, const void *src, size_t len, unsigned flags)
+{
+	switch (flags & (CTTK_I31_SIGNED | CTTK_I31_TRUNC)) {
+	case 0:
+		cttk_i31_decbe_unsigned(x, src, len);
+		break;
+	case CTTK_I31_SIGNED:
+		cttk_i31_decbe_signed(x, src, len);
+		break;
+	case CTTK_I31_TRUNC:
+		cttk_i31_decbe_unsigned_trunc(x, src, len);
+		break;
+	default:
+		cttk_i31_decbe_signed_trunc(x, src, len);
+		break;
+	}
+}
 
-	for (i = 1; i <= 128; i ++) {
-		cttk_i31_init(x1, i);
-		cttk_i31_init(x2, i);
-		cttk_i31_init(x3, i);
+static void
+test_i31_txt(void)
+{
+	cttk_i31_def(x, 2100);
+	cttk_i31_def(y, 2100);
+	unsigned char b[300], b2[300];
+	char s1[1000], s2[1000], s3[1000];
+	int i;
 
-		for (j = 0; j < 100; j ++) {
-			rnd(tmp1, 17);
-			rnd(tmp2, 17);
-			zint_decode(&z1, tmp1, 17, 0, 0);
-			zint_decode(&z2, tmp2, 17, 0, 0);
-			zint_trunc(&z1, i);
-			zint_trunc(&z2, i);
-			zint_encode(tmp1, 17, &z1, 0);
-			zint_encode(tmp2, 17, &z2, 0);
-			cttk_i31_decle_signed(x1, tmp1, 17);
-			cttk_i31_decle_signed(x2, tmp2, 17);
+	printf("Test i31 hex/base64: ");
+	fflush(stdout);
 
-			zint_and(&z3, &z1, &z2);
-			zint_encode(tmp3, 17, &z3, 0);
-			cttk_i31_and(x3, x1, x2);
-			cttk_i31_encle(tmp4, 17, x3);
-			check(memcmp(tmp3, tmp4, 17) == 0, "and (%d,%d)", i, j);
+	rnd_init(24);
 
-			zint_or(&z3, &z1, &z2);
-			zint_encode(tmp3, 17, &z3, 0);
-			cttk_i31_or(x3, x1, x2);
-			cttk_i31_encle(tmp4, 17, x3);
-			check(memcmp(tmp3, tmp4, 17) == 0, "or (%d,%d)", i, j);
+	for (i = 0; i < 3000; i ++) {
+		unsigned size, flags;
+		size_t nb, n, u, v, len, dst_len;
+		const char *e1, *e2;
 
-			zint_xor(&z3, &z1, &z2);
-			zint_encode(tmp3, 17, &z3, 0);
-			cttk_i31_xor(x3, x1, x2);
-			cttk_i31_encle(tmp4, 17, x3);
-			check(memcmp(tmp3, tmp4, 17) == 0, "xor (%d,%d)", i, j);
+		size = (i < 2000) ? 1 + (rnd32() % 300) : 1 + (rnd32() % 2100);
+		nb = rnd32() % ((size >> 3) + 4);
+		cttk_i31_init(x, size);
+		cttk_i31_init(y, size);
+		rnd(b, nb);
+		if ((i & 3) == 0 && nb > 0) {
+			/*
+			 * Values that fit (or nearly fit) are more
+			 * interesting for range checks.
+			 */
+			memset(b, -(b[nb - 1] & 1) & 0xFF, nb > 8 ? nb - 8 : 0);
+		}
 
-			zint_eqv(&z3, &z1, &z2);
-			zint_encode(tmp3, 17, &z3, 0);
-			cttk_i31_eqv(x3, x1, x2);
-			cttk_i31_encle(tmp4, 17, x3);
-			check(memcmp(tmp3, tmp4, 17) == 0, "eqv (%d,%d)", i, j);
+		/*
+		 * Hexadecimal decoding.
+		 */
+		flags = rnd32() & (CTTK_HEX_PAD_ODD | CTTK_HEX_SKIP_WS
+			| CTTK_I31_SIGNED | CTTK_I31_TRUNC);
+		n = cttk_bintohex_gen(s1, sizeof s1, b, nb, rnd32() & 1);
+		if (n > 0 && (rnd32() & 3) == 0) {
+			n --;
+		}
+		for (u = 0, v = 0; u < n; u ++) {
+			if ((flags & CTTK_HEX_SKIP_WS) != 0
+				&& (rnd32() & 7) == 0)
+			{
+				s2[v ++] = (rnd32() & 1) ? ' ' : '\n';
+			}
+			s2[v ++] = s1[u];
+		}
+		if (v > 0 && (rnd32() % 10) == 0) {
+			s2[rnd32() % v] = (rnd32() & 1) ? 'g' : ' ';
+		}
+		len = v;
+		n = cttk_hextobin_gen(b2, sizeof b2, s2, len, &e1, flags);
+		if (e1 == NULL) {
+			ref_i31_decbe(x, b2, n, flags);
+		} else {
+			cttk_i31_init(x, size);
+			cttk_i31_set_u32(x, 0);
+			x[0] |= 0x80000000;
+		}
+		cttk_i31_dechex(y, s2, len, &e2, flags);
+		check(e1 == e2, "i31 dechex err (%u,%d)", size, i);
+		check_i31_txt(x, y, "i31 dechex", size, i);
 
-			zint_not(&z3, &z1);
-			zint_encode(tmp3, 17, &z3, 0);
-			cttk_i31_not(x3, x1);
-			cttk_i31_encle(tmp4, 17, x3);
-			check(memcmp(tmp3, tmp4, 17) == 0, "not (%d,%d)", i, j);
+		/*
+		 * Base64 decoding.
+		 */
+		flags = rnd32() & (CTTK_B64DEC_NO_PAD | CTTK_B64DEC_NO_WS
+			| CTTK_I31_SIGNED | CTTK_I31_TRUNC);
+		len = cttk_bintob64_gen(s2, sizeof s2, b, nb,
+			((flags & CTTK_B64DEC_NO_PAD) ? CTTK_B64ENC_NO_PAD : 0)
+			| ((flags & CTTK_B64DEC_NO_WS) ? 0
+			: CTTK_B64ENC_NEWLINE | CTTK_B64ENC_LINE64));
+		if (len > 0 && (rnd32() % 10) == 0) {
+			s2[rnd32() % len] = (rnd32() & 1) ? '*' : 'B';
+		}
+		n = cttk_b64tobin_gen(b2, sizeof b2, s2, len, &e1, flags);
+		if (e1 == NULL) {
+			ref_i31_decbe(x, b2, n, flags);
+		} else {
+			cttk_i31_set_u32(x, 0);
+			x[0] |= 0x80000000;
 		}
+		cttk_i31_decb64(y, s2, len, &e2, flags);
+		check(e1 == e2, "i31 decb64 err (%u,%d)", size, i);
+		check_i31_txt(x, y, "i31 decb64", size, i);
 
-		if ((i & 3) == 0) {
+		/*
+		 * Encodings, with possibly truncated outputs.
+		 */
+		cttk_i31_decbe_signed_trunc(x, b, nb);
+		if ((i % 50) == 0) {
+			x[0] |= 0x80000000;
+		}
+		cttk_i31_encbe(b2, nb, x);
+		flags = rnd32() & CTTK_HEX_UPPERCASE;
+		dst_len = (rnd32() & 1) ? sizeof s1 : rnd32() % (2 * nb + 2);
+		check(cttk_i31_enchex(NULL, 0, x, nb, flags)
+			== cttk_bintohex_gen(NULL, 0, b2, nb, flags),
+			"i31 enchex len (%u,%d)", size, i);
+		memset(s1, 'x', sizeof s1);
+		memset(s3, 'x', sizeof s3);
+		check(cttk_i31_enchex(s1, dst_len, x, nb, flags)
+			== cttk_bintohex_gen(s3, dst_len, b2, nb, flags)
+			&& memcmp(s1, s3, sizeof s1) == 0,
+			"i31 enchex (%u,%d)", size, i);
+
+		flags = rnd32() & (CTTK_B64ENC_NO_PAD | CTTK_B64ENC_NEWLINE
+			| CTTK_B64ENC_CRLF | CTTK_B64ENC_LINE64);
+		n = cttk_bintob64_gen(NULL, 0, b2, nb, flags);
+		check(cttk_i31_encb64(NULL, 0, x, nb, flags) == n,
+			"i31 encb64 len (%u,%d)", size, i);
+		dst_len = (rnd32() & 1) ? sizeof s1 : rnd32() % (n + 2);
+		memset(s1, 'x', sizeof s1);
+		memset(s3, 'x', sizeof s3);
+		check(cttk_i31_encb64(s1, dst_len, x, nb, flags)
+			== cttk_bintob64_gen(s3, dst_len, b2, nb, flags)
+			&& memcmp(s1, s3, sizeof s1) == 0,
+			"i31 encb64 (%u,%d)", size, i);
+
+		if ((i % 100) == 0) {
 			printf(".");
 			fflush(stdout);
 		}
@@ -2500,12 +6700,50 @@ test_i31_bool(void)
 	fflush(stdout);
 }
 
+static void
+test_cpu_features(void)
+{
+	uint32_t f, m;
+
+	f = cttk_cpu_features();
+	check((f & ~(CTTK_CPU_SSE2 | CTTK_CPU_AVX2)) == 0,
+		"CPU features: 0x%08lX", (unsigned long)f);
+	cttk_cpu_set_features((uint32_t)-1);
+	check(cttk_cpu_features() == f, "CPU features (restore)");
+	if (f == 0) {
+		return;
+	}
+	m = f;
+	do {
+		m = (m - 1) & f;
+		cttk_cpu_set_features(m);
+		check(cttk_cpu_features() == m,
+			"CPU features (set 0x%08lX)", (unsigned long)m);
+		printf("CPU features: 0x%08lX\n", (unsigned long)m);
+		fflush(stdout);
+		test_cond_copy();
+		test_bitslice();
+		test_hex();
+		test_base64();
+		test_i31_batch();
+	} while (m != 0);
+	cttk_cpu_set_features((uint32_t)-1);
+	check(cttk_cpu_features() == f, "CPU features (restore)");
+}
+
 int
 main(void)
 {
 	test_comparisons_32();
 	test_comparisons_64();
 	test_comparisons_buffers();
+	test_cond_copy();
+	test_array_many();
+	test_array_read_mt();
+	test_oram();
+	test_omap();
+	test_oblivious_sort();
+	test_bitslice();
 	test_hex();
 	test_base64();
 	test_mul();
@@ -2515,8 +6753,24 @@ main(void)
 	test_i31_cmp();
 	test_i31_addsub();
 	test_i31_mul();
+	test_i31_muladd();
+	test_i31_mul_large();
 	test_i31_shift();
 	test_i31_div();
+	test_i31_div_large();
+	test_i31_ws();
 	test_i31_bool();
+	test_m31();
+	test_m31_pow();
+	test_i31_batch();
+	test_i31_fixed();
+	test_i31_gcd();
+	test_d31();
+	test_i31_dec();
+	test_i31_txt();
+	test_i63();
+	test_i15();
+	test_stats();
+	test_cpu_features();
 	return 0;
 }
@@ -0,0 +1,1430 @@
+/*
+ * Copyright (c) 2018 Thomas Pornin <pornin@bolet.org>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining 
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be 
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, 
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND 
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * bsgen: generator of bitsliced code.
+ *
+ * Usage:
+ *
+ *    bsgen [ -w width ] [ -n name ] [ -o output ] input
+ *
+ * The input file describes a boolean function, either as a lookup
+ * table or as a circuit; the output is a C source file that defines
+ * the following function:
+ *
+ *    void name(uint32_t *d, const uint32_t *s);
+ *
+ * which evaluates the boolean function over a batch of 'width' values
+ * in bitsliced representation (see cttk_bitslice_in() in cttk.h): s
+ * contains one slice per input bit, and the output slices are written
+ * in d. d and s may be the same array. The width is 32, 64, 128 or 256
+ * (default is 64). Portable code uses 32-bit or 64-bit words; for
+ * widths of 128 and 256, SSE2 and AVX2 variants are also produced,
+ * and selected at runtime with cttk_cpu_features().
+ *
+ * Input format: '#' starts a comment, which runs until the end of the
+ * line. A lookup table starts with 'table', followed by the number of
+ * input bits (1 to 16), the number of output bits (1 to 32), and all
+ * the table values, in decimal or hexadecimal (with a "0x" prefix):
+ *
+ *    table 3 2
+ *    0 1 1 2 1 2 2 3
+ *
+ * A circuit starts with 'circuit', followed by 'input' and 'output'
+ * lines that list the input and output bits, least significant first,
+ * and the gates, one per line, in an order such that each name is
+ * defined before being used:
+ *
+ *    circuit
+ *    input a b c
+ *    output s r
+ *    t = a ^ b
+ *    s = t ^ c
+ *    u = a & b
+ *    v = t & c
+ *    r = u | v
+ *
+ * A gate is 'x = y op z' (op is '&', '|' or '^'), 'x = ~y', 'x = y',
+ * or 'x = 0' / 'x = 1'. An operand may also be complemented ('~y').
+ *
+ * A lookup table is converted into a circuit with a decision diagram:
+ * each function is split along its highest input bit x into two
+ * halves f0 and f1, and recombined as f0 ^ (x & (f0 ^ f1)), or with a
+ * cheaper gate when possible (e.g. when f0 or f1 is constant). All
+ * intermediate values are shared through a table keyed by their full
+ * truth table, so that a value computed for one output bit is reused
+ * for the others. The result is far from optimal (the AES S-box yields
+ * 783 gates, while the best known circuits use about 115), but it is
+ * obtained automatically from the table; hand-optimised circuits can
+ * be provided with the 'circuit' syntax.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdarg.h>
+
+/* ==================================================================== */
+
+static const char *in_name;
+static int in_line;
+
+static void
+die(const char *fmt, ...)
+{
+	va_list ap;
+
+	fprintf(stderr, "bsgen: ");
+	if (in_line > 0) {
+		fprintf(stderr, "%s:%d: ", in_name, in_line);
+	}
+	va_start(ap, fmt);
+	vfprintf(stderr, fmt, ap);
+	va_end(ap);
+	fprintf(stderr, "\n");
+	exit(EXIT_FAILURE);
+}
+
+static void *
+xmalloc(size_t len)
+{
+	void *p;
+
+	if (len == 0) {
+		len = 1;
+	}
+	p = malloc(len);
+	if (p == NULL) {
+		die("memory allocation error");
+	}
+	return p;
+}
+
+static void *
+xrealloc(void *p, size_t len)
+{
+	p = realloc(p, len);
+	if (p == NULL) {
+		die("memory allocation error");
+	}
+	return p;
+}
+
+/* ==================================================================== */
+/*
+ * Gates. Each gate is identified by its index; operands always have
+ * lower indices than the gates that use them. Inputs and constants are
+ * gates too.
+ */
+
+#define OP_ZERO   0   /* constant 0 */
+#define OP_ONE    1   /* constant 1 */
+#define OP_IN     2   /* input bit a */
+#define OP_NOT    3   /* ~a */
+#define OP_AND    4   /* a & b */
+#define OP_OR     5   /* a | b */
+#define OP_XOR    6   /* a ^ b */
+#define OP_ANDN   7   /* ~a & b */
+#define OP_ORN    8   /* ~a | b */
+
+typedef struct {
+	int op;
+	long a, b;
+} gate;
+
+static gate *gates;
+static long num_gates, max_gates;
+
+static long num_in, num_out;
+static long *outputs;
+
+/*
+ * In table mode, the truth table of each gate is kept (tt_len words
+ * per gate), and a hash table maps truth tables to gates.
+ */
+static int table_mode;
+static size_t tt_len;
+static uint32_t *tts;
+static long *htab;
+static size_t hsize;
+
+static uint32_t *
+gate_tt(long g)
+{
+	return tts + (size_t)g * tt_len;
+}
+
+static size_t
+tt_hash(const uint32_t *t)
+{
+	size_t u;
+	uint32_t h;
+
+	h = 0;
+	for (u = 0; u < tt_len; u ++) {
+		h = (h * 0x9E3779B1) ^ t[u];
+		h ^= h >> 15;
+	}
+	return (size_t)h;
+}
+
+static long
+tt_lookup(const uint32_t *t)
+{
+	size_t k;
+
+	for (k = tt_hash(t) & (hsize - 1);; k = (k + 1) & (hsize - 1)) {
+		long g;
+
+		g = htab[k];
+		if (g < 0) {
+			return -1;
+		}
+		if (memcmp(gate_tt(g), t, tt_len * sizeof *t) == 0) {
+			return g;
+		}
+	}
+}
+
+static void
+tt_insert(long g)
+{
+	size_t k;
+
+	if ((size_t)num_gates * 2 >= hsize) {
+		long h;
+
+		free(htab);
+		hsize <<= 1;
+		htab = xmalloc(hsize * sizeof *htab);
+		for (k = 0; k < hsize; k ++) {
+			htab[k] = -1;
+		}
+		for (h = 0; h < g; h ++) {
+			tt_insert(h);
+		}
+	}
+	for (k = tt_hash(gate_tt(g)) & (hsize - 1);
+		htab[k] >= 0; k = (k + 1) & (hsize - 1));
+	htab[k] = g;
+}
+
+/*
+ * Compute the truth table of a gate from those of its operands.
+ */
+static void
+tt_eval(uint32_t *t, int op, long a, long b)
+{
+	const uint32_t *ta, *tb;
+	size_t u;
+
+	ta = op >= OP_NOT ? gate_tt(a) : NULL;
+	tb = op >= OP_AND ? gate_tt(b) : NULL;
+	for (u = 0; u < tt_len; u ++) {
+		uint32_t w;
+
+		switch (op) {
+		case OP_ZERO:
+			w = 0;
+			break;
+		case OP_ONE:
+			w = 0xFFFFFFFF;
+			break;
+		case OP_IN:
+			if (a < 5) {
+				static const uint32_t xm[] = {
+					0xAAAAAAAA, 0xCCCCCCCC, 0xF0F0F0F0,
+					0xFF00FF00, 0xFFFF0000
+				};
+
+				w = xm[a];
+			} else {
+				w = -(uint32_t)((u >> (a - 5)) & 1);
+			}
+			break;
+		case OP_NOT:
+			w = ~ta[u];
+			break;
+		case OP_AND:
+			w = ta[u] & tb[u];
+			break;
+		case OP_OR:
+			w = ta[u] | tb[u];
+			break;
+		case OP_XOR:
+			w = ta[u] ^ tb[u];
+			break;
+		case OP_ANDN:
+			w = ~ta[u] & tb[u];
+			break;
+		default:
+			w = ~ta[u] | tb[u];
+			break;
+		}
+		t[u] = w;
+	}
+}
+
+/*
+ * Make room for one more gate (and its truth table, in table mode).
+ */
+static void
+reserve(void)
+{
+	if (num_gates == max_gates) {
+		max_gates = max_gates == 0 ? 256 : max_gates << 1;
+		gates = xrealloc(gates, (size_t)max_gates * sizeof *gates);
+		if (table_mode) {
+			tts = xrealloc(tts,
+				(size_t)max_gates * tt_len * sizeof *tts);
+		}
+	}
+}
+
+/*
+ * Get a gate. In table mode, an existing gate with the same truth
+ * table is returned, if there is one.
+ */
+static long
+mkgate(int op, long a, long b)
+{
+	long g;
+
+	reserve();
+	g = num_gates;
+	if (table_mode) {
+		long h;
+
+		tt_eval(gate_tt(g), op, a, b);
+		h = tt_lookup(gate_tt(g));
+		if (h >= 0) {
+			return h;
+		}
+	}
+	gates[g].op = op;
+	gates[g].a = a;
+	gates[g].b = b;
+	num_gates ++;
+	if (table_mode) {
+		tt_insert(g);
+	}
+	return g;
+}
+
+/*
+ * Number of new gates needed to get the gate (op, a, b) (0 or 1).
+ */
+static int
+gate_cost(int op, long a, long b)
+{
+	reserve();
+	tt_eval(gate_tt(num_gates), op, a, b);
+	return tt_lookup(gate_tt(num_gates)) < 0;
+}
+
+/* ==================================================================== */
+/*
+ * Table mode.
+ */
+
+static long *in_gates;
+static long gate_zero, gate_one;
+
+/*
+ * Split function f (truth table) along input bit v: f0 and f1 receive
+ * the functions obtained by setting that bit to 0 and 1, respectively.
+ */
+static void
+cofactor(uint32_t *f0, uint32_t *f1, const uint32_t *f, int v)
+{
+	size_t u;
+
+	if (v < 5) {
+		static const uint32_t xm[] = {
+			0x55555555, 0x33333333, 0x0F0F0F0F,
+			0x00FF00FF, 0x0000FFFF
+		};
+		uint32_t m;
+		int s;
+
+		m = xm[v];
+		s = 1 << v;
+		for (u = 0; u < tt_len; u ++) {
+			uint32_t w0, w1;
+
+			w0 = f[u] & m;
+			w1 = (f[u] >> s) & m;
+			f0[u] = w0 | (w0 << s);
+			f1[u] = w1 | (w1 << s);
+		}
+	} else {
+		size_t st;
+
+		st = (size_t)1 << (v - 5);
+		for (u = 0; u < tt_len; u ++) {
+			f0[u] = f[u & ~st];
+			f1[u] = f[u | st];
+		}
+	}
+}
+
+/*
+ * Get a gate that computes function f, which depends only on the
+ * input bits 0 to k-1.
+ */
+static long
+build(const uint32_t *f, int k)
+{
+	uint32_t *f0, *f1, *nf;
+	long g, g0, g1, x;
+	size_t u;
+
+	g = tt_lookup(f);
+	if (g >= 0) {
+		return g;
+	}
+	nf = xmalloc(3 * tt_len * sizeof *nf);
+	f0 = nf + tt_len;
+	f1 = f0 + tt_len;
+	for (u = 0; u < tt_len; u ++) {
+		nf[u] = ~f[u];
+	}
+	g = tt_lookup(nf);
+	if (g >= 0) {
+		free(nf);
+		return mkgate(OP_NOT, g, 0);
+	}
+
+	/*
+	 * Constants are always found, hence k > 0 here.
+	 */
+	for (;;) {
+		cofactor(f0, f1, f, k - 1);
+		if (memcmp(f0, f1, tt_len * sizeof *f0) != 0) {
+			break;
+		}
+		k --;
+	}
+	g0 = build(f0, k - 1);
+	g1 = build(f1, k - 1);
+	x = in_gates[k - 1];
+	for (u = 0; u < tt_len; u ++) {
+		if (f1[u] != ~f0[u]) {
+			break;
+		}
+	}
+	if (g0 == gate_zero) {
+		g = mkgate(OP_AND, x, g1);
+	} else if (g1 == gate_zero) {
+		g = mkgate(OP_ANDN, x, g0);
+	} else if (g1 == gate_one) {
+		g = mkgate(OP_OR, x, g0);
+	} else if (g0 == gate_one) {
+		g = mkgate(OP_ORN, x, g1);
+	} else if (u == tt_len) {
+		g = mkgate(OP_XOR, x, g0);
+	} else {
+		int ca, cb;
+		long d;
+
+		/*
+		 * Either f0 ^ (x & (f0 ^ f1)), or (x & f1) | (~x & f0);
+		 * we use the one that needs fewer new gates.
+		 */
+		ca = gate_cost(OP_XOR, g0, g1);
+		if (ca == 0) {
+			d = mkgate(OP_XOR, g0, g1);
+			ca = gate_cost(OP_AND, x, d);
+		} else {
+			ca = 2;
+		}
+		cb = gate_cost(OP_AND, x, g1) + gate_cost(OP_ANDN, x, g0);
+		if (ca <= cb) {
+			d = mkgate(OP_XOR, g0, g1);
+			g = mkgate(OP_XOR, g0, mkgate(OP_AND, x, d));
+		} else {
+			g = mkgate(OP_OR, mkgate(OP_AND, x, g1),
+				mkgate(OP_ANDN, x, g0));
+		}
+	}
+	free(nf);
+	return g;
+}
+
+static void
+make_table(const uint32_t *table)
+{
+	uint32_t *f;
+	size_t n, u;
+	long j;
+
+	table_mode = 1;
+	n = (size_t)1 << num_in;
+	tt_len = n < 32 ? 1 : (n >> 5);
+	hsize = 1024;
+	htab = xmalloc(hsize * sizeof *htab);
+	for (u = 0; u < hsize; u ++) {
+		htab[u] = -1;
+	}
+	gate_zero = mkgate(OP_ZERO, 0, 0);
+	gate_one = mkgate(OP_ONE, 0, 0);
+	in_gates = xmalloc((size_t)num_in * sizeof *in_gates);
+	for (j = 0; j < num_in; j ++) {
+		in_gates[j] = mkgate(OP_IN, j, 0);
+	}
+	f = xmalloc(tt_len * sizeof *f);
+	for (j = 0; j < num_out; j ++) {
+		memset(f, 0, tt_len * sizeof *f);
+		for (u = 0; u < (tt_len << 5); u ++) {
+			uint32_t b;
+
+			b = (table[u & (n - 1)] >> j) & 1;
+			f[u >> 5] |= b << (u & 31);
+		}
+		outputs[j] = build(f, (int)num_in);
+	}
+	free(f);
+}
+
+/* ==================================================================== */
+/*
+ * Input parsing.
+ */
+
+static char *in_buf;
+static size_t in_ptr;
+
+/*
+ * Get the next token on the current line, or NULL at end of line. The
+ * returned token is either a word (letters, digits and underscores) or
+ * a single character.
+ */
+static char tok_buf[256];
+
+static const char *
+next_token(void)
+{
+	size_t n;
+	int c;
+
+	for (;;) {
+		c = in_buf[in_ptr];
+		if (c == '#') {
+			while (in_buf[in_ptr] != 0 && in_buf[in_ptr] != '\n') {
+				in_ptr ++;
+			}
+			continue;
+		}
+		if (c == ' ' || c == '\t' || c == '\r') {
+			in_ptr ++;
+			continue;
+		}
+		break;
+	}
+	if (c == 0 || c == '\n') {
+		return NULL;
+	}
+	n = 0;
+	for (;;) {
+		c = in_buf[in_ptr];
+		if (!((c >= '0' && c <= '9') || (c >= 'A' && c <= 'Z')
+			|| (c >= 'a' && c <= 'z') || c == '_'))
+		{
+			break;
+		}
+		if (n == sizeof tok_buf - 1) {
+			die("token too long");
+		}
+		tok_buf[n ++] = (char)c;
+		in_ptr ++;
+	}
+	if (n == 0) {
+		tok_buf[n ++] = (char)c;
+		in_ptr ++;
+	}
+	tok_buf[n] = 0;
+	return tok_buf;
+}
+
+/*
+ * Go to the next line; returns 0 at end of input.
+ */
+static int
+next_line(void)
+{
+	while (in_buf[in_ptr] != 0 && in_buf[in_ptr] != '\n') {
+		in_ptr ++;
+	}
+	if (in_buf[in_ptr] == 0) {
+		return 0;
+	}
+	in_ptr ++;
+	in_line ++;
+	return 1;
+}
+
+/*
+ * Get the first token of the next non-empty line, or NULL at end of
+ * input.
+ */
+static const char *
+first_token(void)
+{
+	for (;;) {
+		const char *t;
+
+		t = next_token();
+		if (t != NULL) {
+			return t;
+		}
+		if (!next_line()) {
+			return NULL;
+		}
+	}
+}
+
+static unsigned long
+parse_number(const char *t)
+{
+	unsigned long v;
+	char *end;
+
+	if (t == NULL || t[0] < '0' || t[0] > '9') {
+		die("number expected");
+	}
+	v = strtoul(t, &end, 0);
+	if (*end != 0) {
+		die("invalid number: %s", t);
+	}
+	return v;
+}
+
+static void
+parse_table(void)
+{
+	uint32_t *table;
+	size_t n, u;
+	const char *t;
+
+	num_in = (long)parse_number(next_token());
+	num_out = (long)parse_number(next_token());
+	if (num_in < 1 || num_in > 16 || num_out < 1 || num_out > 32) {
+		die("unsupported table size");
+	}
+	if (next_token() != NULL) {
+		die("unexpected token");
+	}
+	next_line();
+	n = (size_t)1 << num_in;
+	table = xmalloc(n * sizeof *table);
+	u = 0;
+	for (t = first_token(); t != NULL; t = first_token()) {
+		do {
+			unsigned long v;
+
+			if (u == n) {
+				die("too many table values");
+			}
+			v = parse_number(t);
+			if (num_out < 32 && (v >> num_out) != 0) {
+				die("table value out of range: %s", t);
+			}
+			table[u ++] = (uint32_t)v;
+			t = next_token();
+		} while (t != NULL);
+	}
+	in_line = 0;
+	if (u != n) {
+		die("%lu table values expected, %lu found",
+			(unsigned long)n, (unsigned long)u);
+	}
+	outputs = xmalloc((size_t)num_out * sizeof *outputs);
+	make_table(table);
+	free(table);
+}
+
+/*
+ * In circuit mode, names are kept in a plain array, with the
+ * corresponding gates (-1 for output names not yet defined).
+ */
+static char **names;
+static long *name_gates;
+static long num_names, max_names;
+
+static long
+find_name(const char *t)
+{
+	long j;
+
+	for (j = 0; j < num_names; j ++) {
+		if (strcmp(names[j], t) == 0) {
+			return j;
+		}
+	}
+	return -1;
+}
+
+static long
+add_name(const char *t, long g)
+{
+	size_t n;
+
+	if (t == NULL || !((t[0] >= 'A' && t[0] <= 'Z')
+		|| (t[0] >= 'a' && t[0] <= 'z') || t[0] == '_'))
+	{
+		die("name expected");
+	}
+	if (find_name(t) >= 0) {
+		die("duplicate name: %s", t);
+	}
+	if (num_names == max_names) {
+		max_names = max_names == 0 ? 64 : max_names << 1;
+		names = xrealloc(names, (size_t)max_names * sizeof *names);
+		name_gates = xrealloc(name_gates,
+			(size_t)max_names * sizeof *name_gates);
+	}
+	n = strlen(t) + 1;
+	names[num_names] = xmalloc(n);
+	memcpy(names[num_names], t, n);
+	name_gates[num_names] = g;
+	return num_names ++;
+}
+
+/*
+ * Parse an operand (name, possibly complemented) and return its gate;
+ * *neg is set to 1 if the operand is complemented, 0 otherwise.
+ */
+static long
+parse_operand(const char *t, int *neg)
+{
+	long j;
+
+	*neg = 0;
+	if (t != NULL && t[0] == '~') {
+		*neg = 1;
+		t = next_token();
+	}
+	if (t == NULL) {
+		die("operand expected");
+	}
+	j = find_name(t);
+	if (j < 0 || name_gates[j] < 0) {
+		die("undefined name: %s", t);
+	}
+	return name_gates[j];
+}
+
+static void
+parse_circuit(void)
+{
+	long *out_names;
+	const char *t;
+	long j;
+
+	out_names = NULL;
+	if (next_token() != NULL) {
+		die("unexpected token");
+	}
+	for (t = first_token(); t != NULL; t = first_token()) {
+		if (strcmp(t, "input") == 0) {
+			if (out_names != NULL || num_gates > num_in) {
+				die("inputs must be declared first");
+			}
+			while ((t = next_token()) != NULL) {
+				add_name(t, mkgate(OP_IN, num_in ++, 0));
+			}
+		} else if (strcmp(t, "output") == 0) {
+			while ((t = next_token()) != NULL) {
+				out_names = xrealloc(out_names,
+					(size_t)(num_out + 1) * sizeof *out_names);
+				out_names[num_out ++] = add_name(t, -1);
+			}
+		} else {
+			long g;
+			int op;
+
+			j = find_name(t);
+			if (j < 0) {
+				j = add_name(t, -1);
+			} else if (name_gates[j] >= 0) {
+				die("name defined twice: %s", t);
+			}
+			t = next_token();
+			if (t == NULL || strcmp(t, "=") != 0) {
+				die("'=' expected");
+			}
+			t = next_token();
+			if (t != NULL && (strcmp(t, "0") == 0
+				|| strcmp(t, "1") == 0))
+			{
+				g = mkgate(t[0] == '0' ? OP_ZERO : OP_ONE, 0, 0);
+			} else {
+				int na, nb;
+
+				g = parse_operand(t, &na);
+				t = next_token();
+				if (t == NULL) {
+					if (na) {
+						g = mkgate(OP_NOT, g, 0);
+					}
+				} else {
+					long b;
+
+					switch (t[0]) {
+					case '&':
+						op = OP_AND;
+						break;
+					case '|':
+						op = OP_OR;
+						break;
+					case '^':
+						op = OP_XOR;
+						break;
+					default:
+						die("unknown operator: %s", t);
+						return;
+					}
+					b = parse_operand(next_token(), &nb);
+					if (nb) {
+						b = mkgate(OP_NOT, b, 0);
+					}
+
+					/*
+					 * '~a & b' and '~a | b' are single
+					 * gates.
+					 */
+					if (na && op != OP_XOR) {
+						op = op == OP_AND ? OP_ANDN : OP_ORN;
+					} else if (na) {
+						g = mkgate(OP_NOT, g, 0);
+					}
+					g = mkgate(op, g, b);
+				}
+			}
+			if (next_token() != NULL) {
+				die("unexpected token");
+			}
+			name_gates[j] = g;
+		}
+	}
+	in_line = 0;
+	if (num_in == 0 || num_out == 0) {
+		die("no input or no output");
+	}
+	outputs = xmalloc((size_t)num_out * sizeof *outputs);
+	for (j = 0; j < num_out; j ++) {
+		long g;
+
+		g = name_gates[out_names[j]];
+		if (g < 0) {
+			die("undefined output: %s", names[out_names[j]]);
+		}
+		outputs[j] = g;
+	}
+	free(out_names);
+}
+
+/* ==================================================================== */
+/*
+ * Code generation. Each variant (portable code with 32-bit or 64-bit
+ * words, SSE2, AVX2) processes the batch by chunks of its word
+ * size; a chunk of slice j starts at word j*nw + u*cw of the slice
+ * array, with nw = width/32, cw the chunk size (in 32-bit words) and
+ * u the chunk index.
+ */
+
+#define V_U32    0
+#define V_U64    1
+#define V_SSE2   2
+#define V_AVX2   3
+
+static const struct {
+	const char *suffix;
+	const char *type;
+	int bits;
+} variants[] = {
+	{ "u32",  "uint32_t",   32 },
+	{ "u64",  "uint64_t",   64 },
+	{ "sse2", "__m128i",   128 },
+	{ "avx2", "__m256i",   256 }
+};
+
+static FILE *out;
+static int width;
+static const char *fname;
+
+/*
+ * Gate liveness (reachable from the outputs), and variable number of
+ * each live gate: inputs are x<n>, other gates are t<n>.
+ */
+static char *live;
+static long *var_num;
+static long num_live;
+
+static void
+mark_live(void)
+{
+	long g, j;
+
+	live = xmalloc((size_t)num_gates);
+	var_num = xmalloc((size_t)num_gates * sizeof *var_num);
+	memset(live, 0, (size_t)num_gates);
+	for (j = 0; j < num_out; j ++) {
+		live[outputs[j]] = 1;
+	}
+	for (g = num_gates - 1; g >= 0; g --) {
+		if (!live[g]) {
+			continue;
+		}
+		if (gates[g].op >= OP_NOT) {
+			live[gates[g].a] = 1;
+		}
+		if (gates[g].op >= OP_AND) {
+			live[gates[g].b] = 1;
+		}
+	}
+	num_live = 0;
+	for (g = 0; g < num_gates; g ++) {
+		if (!live[g]) {
+			continue;
+		}
+		if (gates[g].op == OP_IN) {
+			var_num[g] = gates[g].a;
+		} else {
+			var_num[g] = num_live ++;
+		}
+	}
+}
+
+static const char *
+var_name(long g)
+{
+	static char buf[2][40];
+	static int k;
+
+	k ^= 1;
+	sprintf(buf[k], "%c%ld",
+		gates[g].op == OP_IN ? 'x' : 't', var_num[g]);
+	return buf[k];
+}
+
+/*
+ * Print the expression for gate g in variant v.
+ */
+static void
+print_expr(int v, long g)
+{
+	const char *a, *b;
+	const char *pre;
+	int op;
+
+	op = gates[g].op;
+	a = op >= OP_NOT ? var_name(gates[g].a) : NULL;
+	b = op >= OP_AND ? var_name(gates[g].b) : NULL;
+	switch (v) {
+	case V_U32:
+	case V_U64:
+		switch (op) {
+		case OP_ZERO:
+			fprintf(out, "0");
+			break;
+		case OP_ONE:
+			fprintf(out, "~(%s)0", variants[v].type);
+			break;
+		case OP_NOT:
+			fprintf(out, "~%s", a);
+			break;
+		case OP_AND:
+			fprintf(out, "%s & %s", a, b);
+			break;
+		case OP_OR:
+			fprintf(out, "%s | %s", a, b);
+			break;
+		case OP_XOR:
+			fprintf(out, "%s ^ %s", a, b);
+			break;
+		case OP_ANDN:
+			fprintf(out, "~%s & %s", a, b);
+			break;
+		case OP_ORN:
+			fprintf(out, "~%s | %s", a, b);
+			break;
+		}
+		break;
+	case V_SSE2:
+	case V_AVX2:
+		pre = v == V_SSE2 ? "_mm" : "_mm256";
+		switch (op) {
+		case OP_ZERO:
+			fprintf(out, "%s_setzero_si%d()", pre, variants[v].bits);
+			break;
+		case OP_ONE:
+			fprintf(out, "ones");
+			break;
+		case OP_NOT:
+			fprintf(out, "%s_xor_si%d(%s, ones)",
+				pre, variants[v].bits, a);
+			break;
+		case OP_AND:
+			fprintf(out, "%s_and_si%d(%s, %s)",
+				pre, variants[v].bits, a, b);
+			break;
+		case OP_OR:
+			fprintf(out, "%s_or_si%d(%s, %s)",
+				pre, variants[v].bits, a, b);
+			break;
+		case OP_XOR:
+			fprintf(out, "%s_xor_si%d(%s, %s)",
+				pre, variants[v].bits, a, b);
+			break;
+		case OP_ANDN:
+			fprintf(out, "%s_andnot_si%d(%s, %s)",
+				pre, variants[v].bits, a, b);
+			break;
+		case OP_ORN:
+			fprintf(out, "%s_or_si%d(%s_xor_si%d(%s, ones), %s)",
+				pre, variants[v].bits,
+				pre, variants[v].bits, a, b);
+			break;
+		}
+		break;
+	}
+}
+
+/*
+ * Print the declarations of the variables of type 'type' named
+ * <c>0 to <c>(n-1), if used[] is set (or used is NULL).
+ */
+static void
+print_decls(const char *ind, const char *type, int c,
+	long n, const char *used)
+{
+	long j;
+	int col;
+
+	col = 0;
+	for (j = 0; j < n; j ++) {
+		char tmp[40];
+		int len;
+
+		if (used != NULL && !used[j]) {
+			continue;
+		}
+		len = sprintf(tmp, "%c%ld", c, j);
+		if (col > 0 && col + len + 2 > 64) {
+			fprintf(out, ";\n");
+			col = 0;
+		}
+		if (col == 0) {
+			fprintf(out, "%s%s %s", ind, type, tmp);
+			col = (int)strlen(type) + 1 + len;
+		} else {
+			fprintf(out, ", %s", tmp);
+			col += len + 2;
+		}
+	}
+	if (col > 0) {
+		fprintf(out, ";\n");
+	}
+}
+
+/*
+ * Print the offset expression for the chunk of slice j.
+ */
+static void
+print_off(long j, int cw, int loop, int half)
+{
+	long nw;
+
+	nw = width >> 5;
+	fprintf(out, "%ld", j * nw + half);
+	if (loop) {
+		if (cw == 1) {
+			fprintf(out, " + u");
+		} else {
+			fprintf(out, " + %d * u", cw);
+		}
+	}
+}
+
+/*
+ * Print the function for variant v.
+ */
+static void
+print_variant(int v, const char *name, int is_static)
+{
+	const char *ind;
+	char *in_used;
+	long g, j, num_chunks;
+	int cw, loop, ones;
+
+	cw = variants[v].bits >> 5;
+	num_chunks = width / variants[v].bits;
+	loop = num_chunks > 1;
+	ind = loop ? "\t\t" : "\t";
+	in_used = xmalloc((size_t)num_in);
+	memset(in_used, 0, (size_t)num_in);
+	ones = 0;
+	for (g = 0; g < num_gates; g ++) {
+		if (!live[g]) {
+			continue;
+		}
+		switch (gates[g].op) {
+		case OP_IN:
+			in_used[gates[g].a] = 1;
+			break;
+		case OP_ONE:
+		case OP_NOT:
+		case OP_ORN:
+			ones = 1;
+			break;
+		}
+	}
+	ones = ones && (v == V_SSE2 || v == V_AVX2);
+
+	fprintf(out, "\n");
+	if (v == V_AVX2) {
+		fprintf(out, "BS_TARGET_AVX2\n");
+	}
+	fprintf(out, "%svoid\n%s%s%s(uint32_t *d, const uint32_t *s)\n{\n",
+		is_static ? "static " : "", name,
+		is_static ? "_" : "", is_static ? variants[v].suffix : "");
+	if (loop) {
+		fprintf(out, "\tint u;\n\n");
+		fprintf(out, "\tfor (u = 0; u < %ld; u ++) {\n", num_chunks);
+	}
+	print_decls(ind, variants[v].type, 'x', num_in, in_used);
+	print_decls(ind, variants[v].type, 't', num_live, NULL);
+	if (ones) {
+		fprintf(out, "%s%s ones;\n", ind, variants[v].type);
+	}
+	fprintf(out, "\n");
+	if (ones) {
+		fprintf(out, "%sones = %s_set1_epi32(-1);\n",
+			ind, v == V_SSE2 ? "_mm" : "_mm256");
+	}
+	for (j = 0; j < num_in; j ++) {
+		if (!in_used[j]) {
+			continue;
+		}
+		fprintf(out, "%sx%ld = ", ind, j);
+		switch (v) {
+		case V_U32:
+			fprintf(out, "s[");
+			print_off(j, cw, loop, 0);
+			fprintf(out, "]");
+			break;
+		case V_U64:
+			fprintf(out, "(uint64_t)s[");
+			print_off(j, cw, loop, 0);
+			fprintf(out, "] | ((uint64_t)s[");
+			print_off(j, cw, loop, 1);
+			fprintf(out, "] << 32)");
+			break;
+		case V_SSE2:
+			fprintf(out, "_mm_loadu_si128((const __m128i *)(s + ");
+			print_off(j, cw, loop, 0);
+			fprintf(out, "))");
+			break;
+		case V_AVX2:
+			fprintf(out,
+				"_mm256_loadu_si256((const __m256i *)(s + ");
+			print_off(j, cw, loop, 0);
+			fprintf(out, "))");
+			break;
+		}
+		fprintf(out, ";\n");
+	}
+	for (g = 0; g < num_gates; g ++) {
+		if (!live[g] || gates[g].op == OP_IN) {
+			continue;
+		}
+		fprintf(out, "%s%s = ", ind, var_name(g));
+		print_expr(v, g);
+		fprintf(out, ";\n");
+	}
+	for (j = 0; j < num_out; j ++) {
+		const char *r;
+
+		r = var_name(outputs[j]);
+		switch (v) {
+		case V_U32:
+			fprintf(out, "%sd[", ind);
+			print_off(j, cw, loop, 0);
+			fprintf(out, "] = %s;\n", r);
+			break;
+		case V_U64:
+			fprintf(out, "%sd[", ind);
+			print_off(j, cw, loop, 0);
+			fprintf(out, "] = (uint32_t)%s;\n", r);
+			fprintf(out, "%sd[", ind);
+			print_off(j, cw, loop, 1);
+			fprintf(out, "] = (uint32_t)(%s >> 32);\n", r);
+			break;
+		case V_SSE2:
+			fprintf(out, "%s_mm_storeu_si128((__m128i *)(d + ", ind);
+			print_off(j, cw, loop, 0);
+			fprintf(out, "), %s);\n", r);
+			break;
+		case V_AVX2:
+			fprintf(out, "%s_mm256_storeu_si256((__m256i *)(d + ",
+				ind);
+			print_off(j, cw, loop, 0);
+			fprintf(out, "), %s);\n", r);
+			break;
+		}
+	}
+	if (loop) {
+		fprintf(out, "\t}\n");
+	}
+	fprintf(out, "}\n");
+	free(in_used);
+}
+
+static void
+print_code(const char *name)
+{
+	long j, n;
+	int simd, v;
+
+	mark_live();
+	n = 0;
+	for (j = 0; j < num_gates; j ++) {
+		if (live[j] && gates[j].op != OP_IN) {
+			n ++;
+		}
+	}
+	fprintf(out, "/*\n");
+	fprintf(out, " * Generated by bsgen from '%s'. Do not edit.\n", fname);
+	fprintf(out, " *\n");
+	fprintf(out, " * Bitsliced %s with %ld input(s) and %ld output(s),\n",
+		table_mode ? "lookup table" : "circuit", num_in, num_out);
+	fprintf(out, " * %ld gates, over batches of %d values:\n", n, width);
+	fprintf(out, " *\n");
+	fprintf(out, " *    void %s(uint32_t *d, const uint32_t *s);\n",
+		name);
+	fprintf(out, " *\n");
+	fprintf(out, " * s contains %ld input slice(s) and d receives %ld"
+		" output slice(s),\n", num_in, num_out);
+	fprintf(out, " * of %d word(s) each (see cttk_bitslice_in()); d and"
+		" s may be equal.\n", width >> 5);
+	fprintf(out, " */\n\n");
+	fprintf(out, "#include \"cttk.h\"\n");
+
+	simd = width >= 128;
+	if (simd) {
+		fprintf(out, "\n"
+"#ifndef BS_SSE2\n"
+"#if defined __SSE2__ || defined _M_X64 \\\n"
+"\t|| (defined _M_IX86_FP && _M_IX86_FP >= 2)\n"
+"#define BS_SSE2   1\n"
+"#else\n"
+"#define BS_SSE2   0\n"
+"#endif\n"
+"#endif\n");
+		if (width >= 256) {
+			fprintf(out, "\n"
+"#ifndef BS_AVX2\n"
+"#if (defined __x86_64__ || defined __i386__) && (defined __clang__ \\\n"
+"\t|| (defined __GNUC__ && (__GNUC__ > 4 \\\n"
+"\t|| (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))))\n"
+"#define BS_AVX2   1\n"
+"#elif (defined _M_X64 || defined _M_IX86) && _MSC_VER >= 1900\n"
+"#define BS_AVX2   1\n"
+"#else\n"
+"#define BS_AVX2   0\n"
+"#endif\n"
+"#endif\n");
+		} else {
+			fprintf(out, "\n#define BS_AVX2   0\n");
+		}
+		fprintf(out, "\n"
+"#if BS_AVX2\n"
+"#include <immintrin.h>\n"
+"#if defined __GNUC__ || defined __clang__\n"
+"#define BS_TARGET_AVX2   __attribute__((target(\"avx2\")))\n"
+"#else\n"
+"#define BS_TARGET_AVX2\n"
+"#endif\n"
+"#elif BS_SSE2\n"
+"#include <emmintrin.h>\n"
+"#endif\n");
+		print_variant(V_U64, name, 1);
+		for (v = V_SSE2; v <= V_AVX2; v ++) {
+			if (v == V_AVX2 && width < 256) {
+				continue;
+			}
+			fprintf(out, "\n#if BS_%s\n",
+				v == V_SSE2 ? "SSE2" : "AVX2");
+			print_variant(v, name, 1);
+			fprintf(out, "#endif\n");
+		}
+		fprintf(out, "\n"
+"void\n"
+"%s(uint32_t *d, const uint32_t *s)\n"
+"{\n"
+"#if BS_AVX2 || BS_SSE2\n"
+"\tuint32_t f;\n"
+"\n"
+"\tf = cttk_cpu_features();\n"
+"#endif\n", name);
+		if (width >= 256) {
+			fprintf(out,
+"#if BS_AVX2\n"
+"\tif ((f & CTTK_CPU_AVX2) != 0) {\n"
+"\t\t%s_avx2(d, s);\n"
+"\t\treturn;\n"
+"\t}\n"
+"#endif\n", name);
+		}
+		fprintf(out,
+"#if BS_SSE2\n"
+"\tif ((f & CTTK_CPU_SSE2) != 0) {\n"
+"\t\t%s_sse2(d, s);\n"
+"\t\treturn;\n"
+"\t}\n"
+"#endif\n"
+"\t%s_u64(d, s);\n"
+"}\n", name, name);
+	} else {
+		print_variant(width == 32 ? V_U32 : V_U64, name, 0);
+	}
+}
+
+/* ==================================================================== */
+
+static void
+usage(void)
+{
+	fprintf(stderr,
+"usage: bsgen [ options ] input\n"
+"options:\n"
+"   -w width    batch size: 32, 64 (default), 128 or 256\n"
+"   -n name     name of the generated function (default: bs_eval)\n"
+"   -o file     output file (default: standard output)\n");
+	exit(EXIT_FAILURE);
+}
+
+int
+main(int argc, char *argv[])
+{
+	const char *name, *out_name, *t;
+	FILE *f;
+	size_t len, max_len;
+	int i;
+
+	width = 64;
+	name = "bs_eval";
+	out_name = NULL;
+	fname = NULL;
+	for (i = 1; i < argc; i ++) {
+		const char *arg;
+
+		arg = argv[i];
+		if (strcmp(arg, "-w") == 0) {
+			if (++ i >= argc) {
+				usage();
+			}
+			width = atoi(argv[i]);
+			if (width != 32 && width != 64
+				&& width != 128 && width != 256)
+			{
+				usage();
+			}
+		} else if (strcmp(arg, "-n") == 0) {
+			if (++ i >= argc) {
+				usage();
+			}
+			name = argv[i];
+		} else if (strcmp(arg, "-o") == 0) {
+			if (++ i >= argc) {
+				usage();
+			}
+			out_name = argv[i];
+		} else if (arg[0] == '-' || fname != NULL) {
+			usage();
+		} else {
+			fname = arg;
+		}
+	}
+	if (fname == NULL) {
+		usage();
+	}
+
+	in_name = fname;
+	f = fopen(fname, "rb");
+	if (f == NULL) {
+		die("cannot open '%s'", fname);
+	}
+	len = 0;
+	max_len = 4096;
+	in_buf = xmalloc(max_len);
+	for (;;) {
+		size_t r;
+
+		if (len + 1 >= max_len) {
+			max_len <<= 1;
+			in_buf = xrealloc(in_buf, max_len);
+		}
+		r = fread(in_buf + len, 1, max_len - len - 1, f);
+		if (r == 0) {
+			break;
+		}
+		len += r;
+	}
+	fclose(f);
+	if (memchr(in_buf, 0, len) != NULL) {
+		die("invalid input file");
+	}
+	in_buf[len] = 0;
+	in_ptr = 0;
+	in_line = 1;
+
+	t = first_token();
+	if (t != NULL && strcmp(t, "table") == 0) {
+		parse_table();
+	} else if (t != NULL && strcmp(t, "circuit") == 0) {
+		parse_circuit();
+	} else {
+		die("'table' or 'circuit' expected");
+	}
+
+	if (out_name == NULL) {
+		out = stdout;
+	} else {
+		out = fopen(out_name, "w");
+		if (out == NULL) {
+			die("cannot open '%s'", out_name);
+		}
+	}
+	print_code(name);
+	if (fflush(out) != 0 || ferror(out)) {
+		die("write error");
+	}
+	if (out != stdout) {
+		fclose(out);
+	}
+	return 0;
+}